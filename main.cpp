@@ -4,17 +4,49 @@
 #include <glm/glm.hpp>
 #include <common/shader.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
 #include <random>
+#include <vector>
 #include <X11/X.h>
 
+#include "common/Animation.hpp"
+#include "common/Assets.hpp"
+#include "common/DeferredRenderer.hpp"
+#include "common/DynamicResolution.hpp"
+#include "common/GLExtensions.hpp"
+#include "common/GpuTimer.hpp"
+#include "common/LightClusters.hpp"
+#include "common/Memory.hpp"
+#include "common/Meshes.hpp"
+#include "common/ParticleSystem.hpp"
+#include "common/PostProcess.hpp"
+#include "common/RenderGraph.hpp"
+#include "common/RenderTargetPool.hpp"
+#include "common/ShadowCascades.hpp"
+#include "common/StreamBuffer.hpp"
+#include "common/Terrain.hpp"
 #include "common/Textures.hpp"
+#include "common/VertexQuantization.hpp"
+#include "common/VoxelWorld.hpp"
 
 using namespace glm;
 
 
-int main() {
+int main(int argc, char **argv) {
+    // forward (clustered) shading is the default, --deferred lights the opaque objects from a G-buffer instead,
+    // --native renders at the framebuffer size instead of scaling the resolution to the GPU time
+    bool deferredShading = false, dynamicResolution = true;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--deferred") == 0) deferredShading = true;
+        else if (strcmp(argv[i], "--native") == 0) dynamicResolution = false;
+    }
+
     if( !glfwInit() ) {
         fprintf( stderr, "Failed to initialize GLFW\n" );
         return -1;
@@ -24,13 +56,19 @@ int main() {
     constexpr int WINDOW_HEIGHT = 768;
     constexpr float ASPECT_RATIO = (float)WINDOW_WIDTH / (float)WINDOW_HEIGHT;
 
-    glfwWindowHint(GLFW_SAMPLES, 4);
-    glfwWindowHint( GLFW_CONTEXT_VERSION_MAJOR, 3 );
-    glfwWindowHint( GLFW_CONTEXT_VERSION_MINOR, 3 );
+    // no multisampling: the scene is rendered offscreen and upscaled, the window only receives the present pass
+    glfwWindowHint( GLFW_CONTEXT_VERSION_MAJOR, 4 );
+    glfwWindowHint( GLFW_CONTEXT_VERSION_MINOR, 5 );
     glfwWindowHint( GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE ); // make MaOs happy
     glfwWindowHint( GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE );
 
+    // 4.5 enables the GPU driven paths (see GLExtensions), 3.3 is the minimum, e.g. on macOS
     GLFWwindow* window = glfwCreateWindow(WINDOW_WIDTH , WINDOW_HEIGHT, "Low Level 3d Engine", NULL, NULL);
+    if(window == NULL) {
+        glfwWindowHint( GLFW_CONTEXT_VERSION_MAJOR, 3 );
+        glfwWindowHint( GLFW_CONTEXT_VERSION_MINOR, 3 );
+        window = glfwCreateWindow(WINDOW_WIDTH , WINDOW_HEIGHT, "Low Level 3d Engine", NULL, NULL);
+    }
     if(window == NULL) {
         fprintf( stderr, "Failed to open GLFW window \n" );
         glfwTerminate();
@@ -42,6 +80,14 @@ int main() {
         fprintf( stderr, "Failed to initialize GLAD\n" );
         return -1;
     }
+    GLExtensions::load((GLADloadfunc)glfwGetProcAddress);
+
+    // render targets and light clusters follow the framebuffer, which is larger than the window on high dpi screens
+    int framebufferWidth, framebufferHeight;
+    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+
+    // serve shaders and textures from the packed archive if one was built, loose files are the fallback
+    if (Assets::mount("assets.pak")) printf("Mounted assets.pak\n");
 
     // set input mode for glfw to use
     glfwSetInputMode(window, GLFW_STICKY_KEYS, GL_TRUE);
@@ -82,6 +128,12 @@ int main() {
         0.327f,  0.483f,  0.844f
     };
 
+    // quantize the triangle: unorm16 positions (dequantized in the vertex shader) and unorm8 colors
+    VertexDecode triangle_decode;
+    std::vector<uint16_t> triangle_positions = VertexQuantization::quantizeUnorm16(g_triangle_vertex_buffer_data, 3, 3,
+        triangle_decode.positionScale, triangle_decode.positionOffset);
+    std::vector<uint8_t> triangle_colors = VertexQuantization::quantizeUnorm8(g_triangle_color_buffer_data, 9);
+
     // identifier for buffer
     GLuint triangle_vertexbuffer;
     // generate buffer with identifier
@@ -89,7 +141,7 @@ int main() {
     // bind buffer
     glBindBuffer(GL_ARRAY_BUFFER, triangle_vertexbuffer);
     // Give the defined vertices to OpenGL
-    glBufferData(GL_ARRAY_BUFFER, sizeof(g_triangle_vertex_buffer_data), g_triangle_vertex_buffer_data, GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, triangle_positions.size() * sizeof(uint16_t), triangle_positions.data(), GL_STATIC_DRAW);
 
     // identifier for buffer
     GLuint triangle_colorbuffer;
@@ -98,19 +150,19 @@ int main() {
     // bind buffer
     glBindBuffer(GL_ARRAY_BUFFER, triangle_colorbuffer);
     // Give the defined vertices to OpenGL
-    glBufferData(GL_ARRAY_BUFFER, sizeof(g_triangle_color_buffer_data), g_triangle_color_buffer_data, GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, triangle_colors.size(), triangle_colors.data(), GL_STATIC_DRAW);
 
-    GLuint programID = LoadShaders("src/shaders/TextureShader.vert", "src/shaders/TextureShader.frag");
     GLuint programID_triangle = LoadShaders("src/shaders/ColorShader.vert", "src/shaders/ColorShader.frag");
 
     // get the MVP ID to be used for the shader
-    GLuint MatrixID = glGetUniformLocation(programID, "MVP");
+    GLuint MatrixID = glGetUniformLocation(programID_triangle, "MVP");
 
     // Create the projection Matrix: 45° FOV, Aspect Ratio: Width / Height, display range: 0.1 -> 100.0 units
     mat4 Projection = glm::perspective(glm::radians(45.0f), ASPECT_RATIO, 0.1f, 100.0f);
 
+    vec3 CameraPosition(4, 3, 3);
     mat4 View = glm::lookAt(
-        vec3(4,3,3),            // camera is at (4,3,3)
+        CameraPosition,         // camera is at (4,3,3)
         vec3(0, 0, 0),          // looks ath the world origin
         vec3(0, 1, 0)           // and the head is up
     );
@@ -122,6 +174,8 @@ int main() {
     // construct the project view model matrix
     mat4 MVP_Triangle = Projection * View * Model_Triangle;
     mat4 MVP_Cube = Projection * View * Model_Cube;
+    // the deferred lighting pass reconstructs world positions from the depth buffer
+    mat4 InverseViewProjection = glm::inverse(Projection * View);
 
 
     // cube handling
@@ -165,6 +219,26 @@ int main() {
     };
 
 
+    // quantize the cube positions to unorm16
+    VertexDecode cube_decode;
+    std::vector<uint16_t> cube_positions = VertexQuantization::quantizeUnorm16(g_cube_vertex_buffer_data, 36, 3,
+        cube_decode.positionScale, cube_decode.positionOffset);
+
+    // flat normals for the lit cube, pointing away from its center
+    std::vector<GLfloat> cube_normals(36 * 3);
+    for (int t = 0; t < 12; ++t) {
+        const GLfloat *v = &g_cube_vertex_buffer_data[t * 9];
+        vec3 a(v[0], v[1], v[2]), b(v[3], v[4], v[5]), c(v[6], v[7], v[8]);
+        vec3 normal = normalize(cross(b - a, c - a));
+        if (dot(normal, a + b + c) < 0.0f) normal = -normal;
+        for (int corner = 0; corner < 3; ++corner) memcpy(&cube_normals[(t * 3 + corner) * 3], &normal[0], sizeof(vec3));
+    }
+
+    GLuint cube_normalbuffer;
+    glGenBuffers(1, &cube_normalbuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, cube_normalbuffer);
+    glBufferData(GL_ARRAY_BUFFER, cube_normals.size() * sizeof(GLfloat), cube_normals.data(), GL_STATIC_DRAW);
+
     // identifier for buffer
     GLuint cube_vertexbuffer;
     // generate buffer with identifier
@@ -172,14 +246,334 @@ int main() {
     // bind buffer
     glBindBuffer(GL_ARRAY_BUFFER, cube_vertexbuffer);
     // Give the defined vertices to OpenGL
-    glBufferData(GL_ARRAY_BUFFER, sizeof(g_cube_vertex_buffer_data), g_cube_vertex_buffer_data, GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, cube_positions.size() * sizeof(uint16_t), cube_positions.data(), GL_STATIC_DRAW);
 
     // load texture to be used on cube
     //GLuint Texture = Textures::loadBMP("src/Textures/uvtemplate-2.bmp");
     GLuint Texture = Textures::loadDDS("src/Textures/uvtemplate.DDS");
 
-    // get the location of texture Uniform
-    GLuint TextureID = glGetUniformLocation(programID, "myTextureSampler");
+    // the cube is lit by point lights: clustered forward shading or the G-buffer of the deferred path
+    DeferredRenderer deferred;
+    if (deferredShading && !deferred.create(framebufferWidth, framebufferHeight)) {
+        printf("Falling back to forward shading\n");
+        deferredShading = false;
+    }
+    GLuint programID_cube = deferredShading ? deferred.geometryProgram()
+                                            : LoadShaders("src/shaders/ClusteredShader.vert", "src/shaders/ClusteredShader.frag");
+    GLuint CubeMatrixID = glGetUniformLocation(programID_cube, "MVP");
+    GLuint CubeModelMatrixID = glGetUniformLocation(programID_cube, "M");
+    glUseProgram(programID_cube);
+    glUniform1i(glGetUniformLocation(programID_cube, "myTextureSampler"), 0);
+    glUniform1f(glGetUniformLocation(programID_cube, "specular"), 0.5f);
+    glUniform1f(glGetUniformLocation(programID_cube, "glossiness"), 0.6f);
+    glUniform3fv(glGetUniformLocation(programID_cube, "cameraPosition"), 1, &CameraPosition[0]);
+
+    LightClusters clusters;
+    clusters.setProjection(glm::radians(45.0f), ASPECT_RATIO, 0.1f, 100.0f, framebufferWidth, framebufferHeight);
+
+    // point lights circling the cube on 8 heights, the positions move every frame
+    constexpr int LIGHT_COUNT = 64;
+    std::vector<PointLight> lights(LIGHT_COUNT);
+    for (int i = 0; i < LIGHT_COUNT; ++i) {
+        float hue = float(i) * 0.618034f * 6.2831853f;
+        lights[i].radius = 2.0f;
+        lights[i].color[0] = 0.5f + 0.5f * cosf(hue);
+        lights[i].color[1] = 0.5f + 0.5f * cosf(hue - 2.0943951f);
+        lights[i].color[2] = 0.5f + 0.5f * cosf(hue + 2.0943951f);
+        lights[i].intensity = 1.5f;
+    }
+
+    // ground plane below the cube receiving its shadow: interleaved float position, uv and normal
+    static const GLfloat g_floor_buffer_data[] = {
+        -8.0f, -1.0f, -8.0f,  0.0f, 0.0f,  0.0f, 1.0f, 0.0f,
+        -8.0f, -1.0f,  8.0f,  0.0f, 4.0f,  0.0f, 1.0f, 0.0f,
+         8.0f, -1.0f, -8.0f,  4.0f, 0.0f,  0.0f, 1.0f, 0.0f,
+         8.0f, -1.0f,  8.0f,  4.0f, 4.0f,  0.0f, 1.0f, 0.0f
+    };
+    const VertexDecode floor_decode;
+    mat4 MVP_Floor = Projection * View;
+    mat4 Model_Floor(1.0f);
+
+    GLuint floor_buffer;
+    glGenBuffers(1, &floor_buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, floor_buffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(g_floor_buffer_data), g_floor_buffer_data, GL_STATIC_DRAW);
+
+    // skinned tentacles on a grid around the cube: a chain of TENTACLE_JOINTS joints swaying and curling with two
+    // compressed clips blended per character, evaluated on the job threads into palettes of a stream buffer
+    constexpr int TENTACLE_JOINTS = 8, TENTACLE_SIDES = 12, RINGS_PER_JOINT = 3;
+    constexpr float TENTACLE_SEGMENT = 0.25f, TENTACLE_RADIUS = 0.07f;
+    Skeleton tentacleSkeleton;
+    for (int joint = 0; joint < TENTACLE_JOINTS; ++joint) {
+        JointTransform rest;
+        rest.translation[1] = joint == 0 ? 0.0f : TENTACLE_SEGMENT;
+        tentacleSkeleton.addJoint(joint - 1, rest);
+    }
+    struct SkinnedVertex {
+        float position[3], uv[2], normal[3];
+        uint8_t joints[4], weights[4];
+    };
+    std::vector<SkinnedVertex> tentacleVertices;
+    std::vector<uint16_t> tentacleIndices;
+    constexpr int TENTACLE_RINGS = TENTACLE_JOINTS * RINGS_PER_JOINT + 1;
+    for (int ring = 0; ring < TENTACLE_RINGS; ++ring) {
+        // rings between two joints are weighted by the distance to them, the tentacle thins towards the tip
+        float height = float(ring) / float(RINGS_PER_JOINT) * TENTACLE_SEGMENT;
+        float along = float(ring) / float(RINGS_PER_JOINT);
+        int joint = std::min(int(along), TENTACLE_JOINTS - 1);
+        float blend = std::min(along - float(joint), 1.0f);
+        float radius = TENTACLE_RADIUS * (1.0f - 0.7f * float(ring) / float(TENTACLE_RINGS - 1));
+        for (int side = 0; side <= TENTACLE_SIDES; ++side) {
+            float angle = float(side) / float(TENTACLE_SIDES) * 6.2831853f;
+            SkinnedVertex vertex{};
+            vertex.position[0] = radius * cosf(angle);
+            vertex.position[1] = height;
+            vertex.position[2] = radius * sinf(angle);
+            vertex.uv[0] = float(side) / float(TENTACLE_SIDES);
+            vertex.uv[1] = float(ring) / float(TENTACLE_RINGS - 1);
+            vertex.normal[0] = cosf(angle);
+            vertex.normal[2] = sinf(angle);
+            vertex.joints[0] = uint8_t(joint);
+            vertex.joints[1] = uint8_t(std::min(joint + 1, TENTACLE_JOINTS - 1));
+            vertex.weights[1] = uint8_t(std::lround(blend * 255.0f));
+            vertex.weights[0] = uint8_t(255 - vertex.weights[1]);
+            tentacleVertices.push_back(vertex);
+            if (ring + 1 < TENTACLE_RINGS && side < TENTACLE_SIDES) {
+                uint16_t a = uint16_t(ring * (TENTACLE_SIDES + 1) + side), b = uint16_t(a + TENTACLE_SIDES + 1);
+                tentacleIndices.insert(tentacleIndices.end(),
+                                       {a, b, uint16_t(a + 1), uint16_t(a + 1), b, uint16_t(b + 1)});
+            }
+        }
+    }
+    GLuint tentacle_vertexbuffer, tentacle_indexbuffer;
+    glGenBuffers(1, &tentacle_vertexbuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, tentacle_vertexbuffer);
+    glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(tentacleVertices.size() * sizeof(SkinnedVertex)), tentacleVertices.data(),
+                 GL_STATIC_DRAW);
+    // the element array binding belongs to the vertex array, it is bound again by the draws
+    glGenBuffers(1, &tentacle_indexbuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, tentacle_indexbuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, GLsizeiptr(tentacleIndices.size() * sizeof(uint16_t)), tentacleIndices.data(),
+                 GL_STATIC_DRAW);
+
+    // sway: the chain bends back and forth along its length, curl: it rolls up and opens again
+    CompressedClip tentacleClips[2];
+    for (int c = 0; c < 2; ++c) {
+        AnimationClip clip;
+        clip.frameCount = c == 0 ? 61 : 46;
+        clip.jointCount = TENTACLE_JOINTS;
+        clip.frames.resize(size_t(clip.frameCount) * TENTACLE_JOINTS);
+        for (unsigned int frame = 0; frame < clip.frameCount; ++frame) {
+            float t = float(frame) / float(clip.frameCount - 1) * 6.2831853f;
+            for (int joint = 0; joint < TENTACLE_JOINTS; ++joint) {
+                JointTransform &transform = clip.frames[size_t(frame) * TENTACLE_JOINTS + size_t(joint)];
+                transform = tentacleSkeleton.restPose[size_t(joint)];
+                // sway bends around z, curl around x
+                float angle = c == 0 ? 0.25f * sinf(t - float(joint) * 0.6f)
+                                     : 0.35f * (0.5f - 0.5f * cosf(t)) * float(joint > 0);
+                transform.rotation[c == 0 ? 2 : 0] = sinf(angle * 0.5f);
+                transform.rotation[3] = cosf(angle * 0.5f);
+            }
+        }
+        if (!tentacleClips[c].compress(clip)) printf("Could not compress a tentacle clip\n");
+    }
+    std::vector<AnimationInstance> tentacles;
+    std::vector<mat4> tentacleModels;
+    std::mt19937 tentacleRandom(7);
+    std::uniform_real_distribution<float> tentacleUnit(0.0f, 1.0f);
+    for (int x = 0; x < 12; ++x) {
+        for (int z = 0; z < 12; ++z) {
+            vec3 position(-3.3f + 0.6f * float(x), -1.0f, -3.3f + 0.6f * float(z));
+            if (std::hypot(position.x - Model_Cube[3][0], position.z - Model_Cube[3][2]) < 1.9f) continue;
+            AnimationInstance instance;
+            instance.clip = &tentacleClips[0];
+            instance.time = tentacleUnit(tentacleRandom) * tentacleClips[0].duration();
+            instance.blendClip = &tentacleClips[1];
+            instance.blendTime = tentacleUnit(tentacleRandom) * tentacleClips[1].duration();
+            tentacles.push_back(instance);
+            tentacleModels.push_back(glm::translate(mat4(1.0f), position));
+        }
+    }
+    GLintptr *paletteOffsets = nullptr;     // palette range of every tentacle, in the frame arena
+    StreamBuffer skinningPalettes;
+    if (!skinningPalettes.create(tentacles.size() * (Animation::PALETTE_BYTES + 256))) printf("Skinning is disabled\n");
+    printf("%zu skinned characters of %d joints\n", tentacles.size(), TENTACLE_JOINTS);
+    constexpr GLuint SKINNING_PALETTE_BINDING = 0;
+    GLuint programID_skinned = LoadShaders("src/shaders/SkinnedMesh.vert",
+        deferredShading ? "src/shaders/GBuffer.frag" : "src/shaders/ClusteredShader.frag");
+    GLuint SkinnedMatrixID = glGetUniformLocation(programID_skinned, "MVP");
+    GLuint SkinnedModelMatrixID = glGetUniformLocation(programID_skinned, "M");
+    glUseProgram(programID_skinned);
+    glUniformBlockBinding(programID_skinned, glGetUniformBlockIndex(programID_skinned, "SkinningPalette"),
+                          SKINNING_PALETTE_BINDING);
+    glUniform1i(glGetUniformLocation(programID_skinned, "myTextureSampler"), 0);
+    glUniform1f(glGetUniformLocation(programID_skinned, "specular"), 0.3f);
+    glUniform1f(glGetUniformLocation(programID_skinned, "glossiness"), 0.4f);
+    glUniform3fv(glGetUniformLocation(programID_skinned, "cameraPosition"), 1, &CameraPosition[0]);
+
+    // terrain: ridged mountains around a flat valley just below the floor, built into a .terrain file on the first run
+    constexpr unsigned int TERRAIN_SAMPLES = 2049;
+    TerrainLayout terrainLayout;
+    terrainLayout.origin[0] = -256.0f;
+    terrainLayout.origin[1] = -1.05f;
+    terrainLayout.origin[2] = -256.0f;
+    terrainLayout.spacing = 0.25f;
+    terrainLayout.heightScale = 40.0f;
+    if (FILE *existing = fopen("terrain.terrain", "rb")) {
+        fclose(existing);
+    } else {
+        std::vector<uint16_t> heights(size_t(TERRAIN_SAMPLES) * TERRAIN_SAMPLES);
+        Terrain::fractalHeights(heights.data(), TERRAIN_SAMPLES, 7);
+        const float center = float(TERRAIN_SAMPLES / 2) * terrainLayout.spacing;
+        for (unsigned int y = 0; y < TERRAIN_SAMPLES; ++y) {
+            for (unsigned int x = 0; x < TERRAIN_SAMPLES; ++x) {
+                float distance = std::hypot(float(x) * terrainLayout.spacing - center,
+                                            float(y) * terrainLayout.spacing - center);
+                float t = std::clamp((distance - 12.0f) / 48.0f, 0.0f, 1.0f);
+                uint16_t &height = heights[size_t(y) * TERRAIN_SAMPLES + x];
+                height = uint16_t(float(height) * t * t * (3.0f - 2.0f * t));
+            }
+        }
+        Terrain::build("terrain.terrain", heights.data(), TERRAIN_SAMPLES, TERRAIN_SAMPLES, terrainLayout);
+    }
+    Terrain terrain;
+    if (!terrain.open("terrain.terrain") ||
+        !terrain.createProgram(deferredShading ? "src/shaders/GBuffer.frag" : "src/shaders/ClusteredShader.frag")) {
+        printf("Terrain is disabled\n");
+    } else {
+        terrain.setTriangleBudget(1u << 20);
+        glUseProgram(terrain.program());
+        glUniform1i(glGetUniformLocation(terrain.program(), "myTextureSampler"), 0);
+        glUniform1f(glGetUniformLocation(terrain.program(), "specular"), 0.1f);
+        glUniform1f(glGetUniformLocation(terrain.program(), "glossiness"), 0.3f);
+        glUniform3fv(glGetUniformLocation(terrain.program(), "cameraPosition"), 1, &CameraPosition[0]);
+        printf("Terrain %u x %u quads, %u levels\n", terrain.size(), terrain.size(), terrain.levelCount());
+    }
+    mat4 ViewProjection = Projection * View;
+
+    // voxels: a banded rock of 2 x 1 x 2 chunks behind the cube, a bubble of air wanders through it and the rock
+    // closes up behind it, so a few chunks are remeshed every frame
+    VoxelLayout voxelLayout;
+    voxelLayout.origin[0] = -14.0f;
+    voxelLayout.origin[1] = -1.05f;
+    voxelLayout.origin[2] = -10.0f;
+    voxelLayout.voxelSize = 0.125f;
+    auto rockMaterial = [](int x, int y, int z) -> uint16_t {
+        float dx = float(x) - 32.0f, dy = float(y) * 1.4f, dz = float(z) - 32.0f;
+        float radius = 28.0f + 3.0f * sinf(float(x) * 0.3f) * cosf(float(z) * 0.25f) + 2.0f * sinf(float(y) * 0.4f);
+        if (dx * dx + dy * dy + dz * dz > radius * radius) return 0;
+        return y < 4 ? 1 : uint16_t((y + x / 8) % 3 + 2);
+    };
+    VoxelWorld voxels;
+    if (voxels.create(2, 1, 2, voxelLayout)) {
+        std::vector<uint16_t> rock(VoxelWorld::CHUNK_VOXELS);
+        for (unsigned int chunkZ = 0; chunkZ < 2; ++chunkZ) {
+            for (unsigned int chunkX = 0; chunkX < 2; ++chunkX) {
+                size_t voxel = 0;
+                for (int z = 0; z < 32; ++z)
+                    for (int y = 0; y < 32; ++y)
+                        for (int x = 0; x < 32; ++x)
+                            rock[voxel++] = rockMaterial(int(chunkX) * 32 + x, y, int(chunkZ) * 32 + z);
+                voxels.setChunk(chunkX, 0, chunkZ, rock.data());
+            }
+        }
+    }
+    if (!voxels.createRenderer(deferredShading ? "src/shaders/GBuffer.frag" : "src/shaders/ClusteredShader.frag")) {
+        printf("Voxels are disabled\n");
+    } else {
+        glUseProgram(voxels.program());
+        glUniform1i(glGetUniformLocation(voxels.program(), "myTextureSampler"), 0);
+        glUniform1f(glGetUniformLocation(voxels.program(), "specular"), 0.2f);
+        glUniform1f(glGetUniformLocation(voxels.program(), "glossiness"), 0.3f);
+        glUniform3fv(glGetUniformLocation(voxels.program(), "cameraPosition"), 1, &CameraPosition[0]);
+    }
+    constexpr int BUBBLE_RADIUS = 5;
+    int bubble[3] = {-100, 0, 0};
+
+    // particles: a fountain of sparks filling up to a million particles on the GPU path, embers at random places
+    // around it and smoke rising from the cube. The smoke is alpha blended and sorted, so it gets its own small system
+    ParticleSystem sparks, smoke;
+    const unsigned int SPARK_CAPACITY = GLExtensions::computeShaders() ? 1u << 20 : 1u << 18;
+    if (!sparks.create(SPARK_CAPACITY) || !smoke.create(1u << 14)) printf("Particles are disabled\n");
+    ParticleEmitter fountain;
+    fountain.position[0] = 0.5f;
+    fountain.position[1] = -1.0f;
+    fountain.position[2] = 0.5f;
+    fountain.radius = 0.05f;
+    fountain.spread = 0.35f;
+    fountain.speedMin = 3.0f;
+    fountain.speedMax = 5.0f;
+    fountain.lifetimeMin = 1.6f;
+    fountain.lifetimeMax = 2.4f;
+    // nine tenths of the capacity alive at the mean lifetime of 2 s
+    fountain.rate = 0.45f * float(SPARK_CAPACITY);
+    fountain.sizeStart = 0.012f;
+    fountain.sizeEnd = 0.004f;
+    const float SPARK_START[4] = {4.0f, 2.2f, 0.8f, 1.0f}, SPARK_END[4] = {1.5f, 0.2f, 0.05f, 0.0f};
+    std::copy(SPARK_START, SPARK_START + 4, fountain.colorStart);
+    std::copy(SPARK_END, SPARK_END + 4, fountain.colorEnd);
+    sparks.addEmitter(fountain);
+    for (int i = 0; i < 4; ++i) {
+        ParticleEmitter embers = fountain;
+        embers.position[0] = -3.0f + 6.0f * rand_value();
+        embers.position[2] = -3.0f + 6.0f * rand_value();
+        embers.radius = 0.2f;
+        embers.spread = 0.6f;
+        embers.speedMin = 0.3f;
+        embers.speedMax = 0.8f;
+        embers.rate = 0.01f * float(SPARK_CAPACITY);
+        float hue = rand_value() * 6.2831853f;
+        embers.colorStart[0] = 2.0f + 2.0f * cosf(hue);
+        embers.colorStart[1] = 2.0f + 2.0f * cosf(hue - 2.0943951f);
+        embers.colorStart[2] = 2.0f + 2.0f * cosf(hue + 2.0943951f);
+        sparks.addEmitter(embers);
+    }
+    sparks.setGravity(0.0f, -4.0f, 0.0f);
+    sparks.setDrag(0.3f);
+    ParticleEmitter smokeColumn;
+    smokeColumn.position[0] = Model_Cube[3][0];
+    smokeColumn.position[1] = 1.1f;
+    smokeColumn.radius = 0.3f;
+    smokeColumn.spread = 0.25f;
+    smokeColumn.speedMin = 0.3f;
+    smokeColumn.speedMax = 0.6f;
+    smokeColumn.lifetimeMin = 3.0f;
+    smokeColumn.lifetimeMax = 4.0f;
+    smokeColumn.rate = 1500.0f;
+    smokeColumn.sizeStart = 0.08f;
+    smokeColumn.sizeEnd = 0.4f;
+    const float SMOKE_START[4] = {0.3f, 0.3f, 0.32f, 0.25f}, SMOKE_END[4] = {0.5f, 0.5f, 0.5f, 0.0f};
+    std::copy(SMOKE_START, SMOKE_START + 4, smokeColumn.colorStart);
+    std::copy(SMOKE_END, SMOKE_END + 4, smokeColumn.colorEnd);
+    smokeColumn.additive = false;
+    smoke.addEmitter(smokeColumn);
+    smoke.setGravity(0.0f, 0.2f, 0.0f);
+    smoke.setDrag(0.5f);
+
+    // sun shadows: the cube is static, so the cached far cascades are rendered once
+    const float SUN_DIRECTION[3] = {0.4f, 0.8f, 0.45f};
+    const float CUBE_BOUNDS_CENTER[3] = {-2.0f, 0.0f, 0.0f};
+    const float CUBE_BOUNDS_RADIUS = 1.7320508f;
+    ShadowCascades shadows;
+    if (!shadows.create()) printf("Shadows are disabled\n");
+    shadows.setRange(0.1f, 30.0f);
+    GLuint CasterMatrixID = glGetUniformLocation(shadows.casterProgram(), "MVP");
+
+    // GPU time per pass, printed with the frame time
+    GpuTimer timer;
+    if (deferredShading)
+        timer.create({"shadows", "geometry", "lighting", "unlit", "particles", "bloom", "tonemap", "fxaa", "present"});
+    else timer.create({"shadows", "opaque", "unlit", "particles", "bloom", "tonemap", "fxaa", "present"});
+    constexpr unsigned int SHADOW_PASS = 0, OPAQUE_PASS = 1, LIGHTING_PASS = 2;
+    const unsigned int UNLIT_PASS = deferredShading ? 3 : 2;
+    const unsigned int PARTICLE_PASS = UNLIT_PASS + 1;
+    const unsigned int PRESENT_PASS = PARTICLE_PASS + 1 + PostProcess::TIMER_PASSES;
+    if (deferredShading) {
+        printf("Deferred shading, G-buffer %zu bytes per pixel (%.1f MiB at %dx%d)\n", DeferredRenderer::BYTES_PER_PIXEL,
+               double(deferred.gBufferBytes()) / (1024.0 * 1024.0), framebufferWidth, framebufferHeight);
+    } else {
+        printf("Forward shading\n");
+    }
 
     // UV data for cube
     static GLfloat g_uv_buffer_data[] = {
@@ -222,15 +616,18 @@ int main() {
     };
 
     // transform uv coordinates
-    for(unsigned int i = 1; i < sizeof(g_uv_buffer_data); i += 2) {
+    for(unsigned int i = 1; i < sizeof(g_uv_buffer_data) / sizeof(g_uv_buffer_data[0]); i += 2) {
         g_uv_buffer_data[i] = 1.0f - g_uv_buffer_data[i];
     }
 
+    // quantize the uvs to unorm16 inside their range
+    std::vector<uint16_t> cube_uvs = VertexQuantization::quantizeUnorm16(g_uv_buffer_data, 36, 2,
+        cube_decode.uvScale, cube_decode.uvOffset);
 
     GLuint cube_uvbuffer;
     glGenBuffers(1, &cube_uvbuffer);
     glBindBuffer(GL_ARRAY_BUFFER, cube_uvbuffer);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(g_uv_buffer_data), g_uv_buffer_data, GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, cube_uvs.size() * sizeof(uint16_t), cube_uvs.data(), GL_STATIC_DRAW);
 
 
 
@@ -239,29 +636,156 @@ int main() {
     // set background
     glClearColor(0.2f, 0.0f, 0.7f, 1.0f);
 
-    do {
-        // track the frame time
-        double currentTime = glfwGetTime();
-        nbFrames++;
-        if(currentTime - lastTime >= 1.0) { // more than a second has elapsed
-            // print the current frame time over 1 second and reset the timer
-            printf("Frame Time: %f ms [%i fps]\n", 1000.0/double(nbFrames), nbFrames);
-            lastTime = currentTime;
-            nbFrames = 0;
+    // the frame as a render graph: the scene is drawn into transient targets of the pool and presented at the end,
+    // passes only declare what they read and write, the graph orders them and allocates the targets
+    auto drawShadows = [&]() {
+        // shadow casters: only cascades that changed are rendered, the cube is culled per cascade
+        timer.begin(SHADOW_PASS);
+        shadows.update(&View[0][0], glm::radians(45.0f), ASPECT_RATIO, SUN_DIRECTION);
+        if (shadows.casterProgram()) {
+            glEnableVertexAttribArray(0);
+            glBindBuffer(GL_ARRAY_BUFFER, cube_vertexbuffer);
+            glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, 0, static_cast<void *>(nullptr));
+            for (unsigned int c = 0; c < shadows.count(); ++c) {
+                if (!shadows.needsRender(c)) continue;
+                shadows.beginCascade(c);
+                if (!shadows.castsShadow(c, CUBE_BOUNDS_CENTER, CUBE_BOUNDS_RADIUS, true)) continue;
+                mat4 MVP_Caster = glm::make_mat4(shadows.cascadeMatrix(c)) * Model_Cube;
+                glUniformMatrix4fv(CasterMatrixID, 1, GL_FALSE, &MVP_Caster[0][0]);
+                Meshes::setDecodeUniforms(shadows.casterProgram(), cube_decode);
+                glDrawArrays(GL_TRIANGLES, 0, 12 * 3);
+            }
+            shadows.endCascades();
+            glDisableVertexAttribArray(0);
         }
+        timer.end();
+    };
+    auto drawOpaque = [&]() {
+        // 1st Draw Call: the lit cube and floor, into the G-buffer on the deferred path
+        glEnableVertexAttribArray(0); // 1st Attribute: Vertex data
+        glBindBuffer(GL_ARRAY_BUFFER, cube_vertexbuffer);
+        glVertexAttribPointer(
+        0,          // attribute 0, must match layout in shader
+        3,          //size
+        GL_UNSIGNED_SHORT,   //type
+        GL_TRUE,    //normalized?
+        0,          //stride
+        static_cast<void *>(nullptr)    // array buffer offset
+        );
+
+        glEnableVertexAttribArray(1); // 2nd Attribute: Color data
+        glBindBuffer(GL_ARRAY_BUFFER, cube_uvbuffer);
+        glVertexAttribPointer(
+        1,          // attribute 0, must match layout in shader
+        2,          //size
+        GL_UNSIGNED_SHORT,   //type
+        GL_TRUE,    //normalized?
+        0,          //stride
+        static_cast<void *>(nullptr)    // array buffer offset
+        );
+
+        glEnableVertexAttribArray(2); // 3rd Attribute: Normal data
+        glBindBuffer(GL_ARRAY_BUFFER, cube_normalbuffer);
+        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, static_cast<void *>(nullptr));
+
+        // use the shader, the sampler and material uniforms were set once at startup
+        glUseProgram(programID_cube);
+
+        // give the shader the cube matrices and the dequantization of its positions and uvs
+        glUniformMatrix4fv(CubeMatrixID, 1, GL_FALSE, &MVP_Cube[0][0]);
+        glUniformMatrix4fv(CubeModelMatrixID, 1, GL_FALSE, &Model_Cube[0][0]);
+        Meshes::setDecodeUniforms(programID_cube, cube_decode);
+        if (!deferredShading) {
+            clusters.bind(programID_cube);
+            shadows.bind(programID_cube);
+        }
+
+        // Bind the texture in Texture Unit 0
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, Texture);
+
+        // Draw the cube
+        glDrawArrays(GL_TRIANGLES, 0, 12 * 3);
 
+        // the floor with the same program, its float attributes need the identity decode
+        glBindBuffer(GL_ARRAY_BUFFER, floor_buffer);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), static_cast<void *>(nullptr));
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), reinterpret_cast<void *>(3 * sizeof(GLfloat)));
+        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), reinterpret_cast<void *>(5 * sizeof(GLfloat)));
+        glUniformMatrix4fv(CubeMatrixID, 1, GL_FALSE, &MVP_Floor[0][0]);
+        glUniformMatrix4fv(CubeModelMatrixID, 1, GL_FALSE, &Model_Floor[0][0]);
+        Meshes::setDecodeUniforms(programID_cube, floor_decode);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
 
-        // Clear the screen
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        // the tentacles, every one with its palette range of this frame
+        if (programID_skinned && skinningPalettes.buffer()) {
+            glUseProgram(programID_skinned);
+            if (!deferredShading) {
+                clusters.bind(programID_skinned);
+                shadows.bind(programID_skinned);
+            }
+            glBindBuffer(GL_ARRAY_BUFFER, tentacle_vertexbuffer);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, tentacle_indexbuffer);
+            const GLsizei stride = sizeof(SkinnedVertex);
+            auto offset = [](size_t bytes) { return reinterpret_cast<void *>(bytes); };
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, offset(offsetof(SkinnedVertex, position)));
+            glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, offset(offsetof(SkinnedVertex, uv)));
+            glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, stride, offset(offsetof(SkinnedVertex, normal)));
+            // the joint indices stay integers, the weights are unorm8
+            glEnableVertexAttribArray(5);
+            glEnableVertexAttribArray(6);
+            glVertexAttribIPointer(5, 4, GL_UNSIGNED_BYTE, stride, offset(offsetof(SkinnedVertex, joints)));
+            glVertexAttribPointer(6, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, offset(offsetof(SkinnedVertex, weights)));
+            for (size_t i = 0; i < tentacles.size(); ++i) {
+                if (!tentacles[i].palette) continue;
+                mat4 MVP_Tentacle = Projection * View * tentacleModels[i];
+                glUniformMatrix4fv(SkinnedMatrixID, 1, GL_FALSE, &MVP_Tentacle[0][0]);
+                glUniformMatrix4fv(SkinnedModelMatrixID, 1, GL_FALSE, &tentacleModels[i][0][0]);
+                glBindBufferRange(GL_UNIFORM_BUFFER, SKINNING_PALETTE_BINDING, skinningPalettes.buffer(),
+                                  paletteOffsets[i], GLsizeiptr(Animation::PALETTE_BYTES));
+                glDrawElements(GL_TRIANGLES, GLsizei(tentacleIndices.size()), GL_UNSIGNED_SHORT, nullptr);
+            }
+            glDisableVertexAttribArray(5);
+            glDisableVertexAttribArray(6);
+        }
+        glDisableVertexAttribArray(0);
+        glDisableVertexAttribArray(1);
+        glDisableVertexAttribArray(2);
 
-        // 1st Draw Call: Pass OpenGL the data for the triangle
+        // the terrain chunks selected this frame, with the cube's texture as ground
+        if (terrain.program()) {
+            glUseProgram(terrain.program());
+            if (!deferredShading) {
+                clusters.bind(terrain.program());
+                shadows.bind(terrain.program());
+            }
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, Texture);
+            terrain.draw(&ViewProjection[0][0]);
+        }
+
+        // the voxel chunks in the frustum
+        if (voxels.program()) {
+            glUseProgram(voxels.program());
+            if (!deferredShading) {
+                clusters.bind(voxels.program());
+                shadows.bind(voxels.program());
+            }
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, Texture);
+            voxels.draw(&ViewProjection[0][0]);
+        }
+    };
+    auto drawUnlit = [&]() {
+        // 2nd Draw Call: the unlit triangle, forward shaded on top of the lit scene
+        timer.begin(UNLIT_PASS);
         glEnableVertexAttribArray(0); // 1st attribute: Vertex data triangle
         glBindBuffer(GL_ARRAY_BUFFER, triangle_vertexbuffer);
         glVertexAttribPointer(
             0,          // attribute 0, must match layout in shader
             3,          //size
-            GL_FLOAT,   //type
-            GL_FALSE,   //normalized?
+            GL_UNSIGNED_SHORT,   //type
+            GL_TRUE,    //normalized?
             0,          //stride
             static_cast<void *>(nullptr)    // array buffer offset
         );
@@ -271,8 +795,8 @@ int main() {
         glVertexAttribPointer(
             1,          // attribute 0, must match layout in shader
             3,          //size
-            GL_FLOAT,   //type
-            GL_FALSE,   //normalized?
+            GL_UNSIGNED_BYTE,   //type
+            GL_TRUE,    //normalized?
             0,          //stride
             static_cast<void *>(nullptr)    // array buffer offset
         );
@@ -280,57 +804,256 @@ int main() {
         // use the shader
         glUseProgram(programID_triangle);
 
-        // give the shader the triangle MVP matrix
+        // give the shader the triangle MVP matrix and the dequantization of its positions
         glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &MVP_Triangle[0][0]);
+        Meshes::setDecodeUniforms(programID_triangle, triangle_decode);
 
         // Draw the triangle
         glDrawArrays(GL_TRIANGLES, 0, 3);
         glDisableVertexAttribArray(0);
         glDisableVertexAttribArray(1);
+        timer.end();
+    };
 
-        // 2nd Draw Call: Pass OpenGL the data for the cube
-        glEnableVertexAttribArray(0); // 1st Attribute: Vertex data
-        glBindBuffer(GL_ARRAY_BUFFER, cube_vertexbuffer);
-        glVertexAttribPointer(
-        0,          // attribute 0, must match layout in shader
-        3,          //size
-        GL_FLOAT,   //type
-        GL_FALSE,   //normalized?
-        0,          //stride
-        static_cast<void *>(nullptr)    // array buffer offset
-        );
+    GLuint programID_present = LoadShaders("src/shaders/Fullscreen.vert", "src/shaders/Present.frag");
+    GLuint PresentTargetSizeID = glGetUniformLocation(programID_present, "targetSize");
+    GLuint PresentSourceScaleID = glGetUniformLocation(programID_present, "sourceScale");
+    GLuint PresentSharpnessID = glGetUniformLocation(programID_present, "sharpness");
 
-        glEnableVertexAttribArray(1); // 2nd Attribute: Color data
-        glBindBuffer(GL_ARRAY_BUFFER, cube_uvbuffer);
-        glVertexAttribPointer(
-        1,          // attribute 0, must match layout in shader
-        2,          //size
-        GL_FLOAT,   //type
-        GL_FALSE,   //normalized?
-        0,          //stride
-        static_cast<void *>(nullptr)    // array buffer offset
-        );
+    // dynamic resolution: the scene passes render into the lower left renderWidth x renderHeight pixels of the
+    // full size targets, the scale follows the GPU time of the frame (14 ms leaves headroom at 60 Hz)
+    DynamicResolution resolution(14.0f);
+    unsigned int renderWidth = unsigned(framebufferWidth), renderHeight = unsigned(framebufferHeight);
+    GLuint present_vertexarray;
+    glGenVertexArrays(1, &present_vertexarray);
 
-        // use the shader
-        glUseProgram(programID);
+    // bloom, tonemapping, color grading and FXAA of the HDR scene, the keys 1 to 4 toggle them
+    PostProcess post;
+    if (!post.create()) printf("Post-processing is disabled\n");
+    post.setTimer(&timer, PARTICLE_PASS + 1);
+    const PostEffect POST_EFFECTS[] = {PostEffect::Bloom, PostEffect::Tonemapping, PostEffect::ColorGrading,
+                                       PostEffect::Fxaa};
+    bool postKeysDown[4] = {};
 
-        // give the shader the cube MVP matrix
-        glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &MVP_Cube[0][0]);
+    // the scene is lit in HDR, R11F_G11F_B10F holds it at the size of RGBA8
+    const RenderTargetDescription SCENE_COLOR{unsigned(framebufferWidth), unsigned(framebufferHeight), GL_R11F_G11F_B10F};
+    const RenderTargetDescription SCENE_DEPTH{unsigned(framebufferWidth), unsigned(framebufferHeight), GL_DEPTH24_STENCIL8};
+    RenderTargetPool targetPool;
+    RenderGraph frameGraph;
+    // the image the present pass upscales, the result of the post-processing
+    RenderGraph::Resource presentSource = RenderGraph::INVALID;
+    auto buildFrameGraph = [&]() {
+        frameGraph.clear();
+        RenderGraph::Resource shadowMap = frameGraph.importTexture("shadow map", shadows.texture(),
+            {shadows.mapResolution(), shadows.mapResolution(), GL_DEPTH_COMPONENT24});
+        RenderGraph::Resource sceneColor = frameGraph.createTexture("scene color", SCENE_COLOR);
+        RenderGraph::Resource sceneDepth = frameGraph.createTexture("scene depth", SCENE_DEPTH);
 
-        // Bind the texture in Texture Unit 0
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, Texture);
-        // set the Sampler2D in the shader to use this texture
-        glUniform1i(TextureID, 0);
+        RenderGraph::Pass shadowPass = frameGraph.addPass("shadows", drawShadows);
+        shadowMap = frameGraph.write(shadowPass, shadowMap);
 
-        // Draw the cube
-        glDrawArrays(GL_TRIANGLES, 0, 12 * 3);
-        glDisableVertexAttribArray(0);
-        glDisableVertexAttribArray(1);
+        RenderGraph::Pass opaquePass;
+        if (deferredShading) {
+            // the G-buffer belongs to the DeferredRenderer, which binds its own framebuffer for the geometry
+            unsigned int gBufferWidth = deferred.targetWidth(), gBufferHeight = deferred.targetHeight();
+            RenderGraph::Resource gBuffer[3] = {
+                frameGraph.importTexture("G-buffer albedo", deferred.albedoTarget(),
+                                         {gBufferWidth, gBufferHeight, DeferredRenderer::ALBEDO_FORMAT}),
+                frameGraph.importTexture("G-buffer normal", deferred.normalTarget(),
+                                         {gBufferWidth, gBufferHeight, DeferredRenderer::NORMAL_FORMAT}),
+                frameGraph.importTexture("G-buffer depth", deferred.depthTarget(),
+                                         {gBufferWidth, gBufferHeight, DeferredRenderer::DEPTH_FORMAT})
+            };
+            RenderGraph::Pass geometryPass = frameGraph.addPass("geometry", [&]() {
+                timer.begin(OPAQUE_PASS);
+                deferred.beginGeometry();
+                drawOpaque();
+                deferred.endGeometry();
+                timer.end();
+            });
+            for (RenderGraph::Resource &target : gBuffer) target = frameGraph.write(geometryPass, target);
+            opaquePass = frameGraph.addPass("lighting", [&]() {
+                // pixels without geometry are discarded by the lighting and keep the background
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                glViewport(0, 0, GLsizei(renderWidth), GLsizei(renderHeight));
+                timer.begin(LIGHTING_PASS);
+                deferred.light(&InverseViewProjection[0][0], &CameraPosition[0], clusters, &shadows);
+                timer.end();
+            });
+            for (RenderGraph::Resource target : gBuffer) frameGraph.read(opaquePass, target);
+        } else {
+            opaquePass = frameGraph.addPass("opaque", [&]() {
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                glViewport(0, 0, GLsizei(renderWidth), GLsizei(renderHeight));
+                timer.begin(OPAQUE_PASS);
+                drawOpaque();
+                timer.end();
+            });
+        }
+        frameGraph.read(opaquePass, shadowMap);
+        sceneColor = frameGraph.attach(opaquePass, sceneColor);
+        sceneDepth = frameGraph.attach(opaquePass, sceneDepth);
+
+        RenderGraph::Pass unlitPass = frameGraph.addPass("unlit", [&]() {
+            glViewport(0, 0, GLsizei(renderWidth), GLsizei(renderHeight));
+            drawUnlit();
+        });
+        sceneColor = frameGraph.attach(unlitPass, sceneColor);
+        sceneDepth = frameGraph.attach(unlitPass, sceneDepth);
+
+        // particles are tested against the scene depth, they do not write it
+        RenderGraph::Pass particlePass = frameGraph.addPass("particles", [&]() {
+            glViewport(0, 0, GLsizei(renderWidth), GLsizei(renderHeight));
+            timer.begin(PARTICLE_PASS);
+            sparks.draw(&View[0][0], &Projection[0][0]);
+            smoke.draw(&View[0][0], &Projection[0][0]);
+            timer.end();
+        });
+        sceneColor = frameGraph.attach(particlePass, sceneColor);
+        sceneDepth = frameGraph.attach(particlePass, sceneDepth);
+
+        presentSource = post.addPasses(frameGraph, sceneColor);
+        RenderGraph::Pass presentPass = frameGraph.addPass("present", [&]() {
+            timer.begin(PRESENT_PASS);
+            glDisable(GL_DEPTH_TEST);
+            glUseProgram(programID_present);
+            glUniform2f(PresentTargetSizeID, float(framebufferWidth), float(framebufferHeight));
+            glUniform2f(PresentSourceScaleID, float(renderWidth) / float(framebufferWidth),
+                        float(renderHeight) / float(framebufferHeight));
+            // sharpen more the more the scene is magnified, native frames are copied
+            glUniform1f(PresentSharpnessID, std::min((1.0f - resolution.scale()) * 2.0f, 1.0f));
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, frameGraph.texture(presentSource));
+            glBindVertexArray(present_vertexarray);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+            glBindVertexArray(VertexArrayID);
+            glEnable(GL_DEPTH_TEST);
+            timer.end();
+        });
+        frameGraph.read(presentPass, presentSource);
+        frameGraph.attach(presentPass, frameGraph.importBackbuffer("backbuffer", framebufferWidth, framebufferHeight));
+        return frameGraph.compile();
+    };
+    if (!buildFrameGraph()) {
+        fprintf( stderr, "Failed to compile the frame graph\n" );
+        glfwTerminate();
+        return -1;
+    }
+    frameGraph.print();
+
+    // frames after the warm up must not allocate from the heap, transient memory comes from the Memory arenas
+    constexpr int WARM_UP_FRAMES = 3;
+    int frameNumber = 0;
+    bool reportedFrameAllocations = false;
+
+    do {
+        // toggling an effect rebuilds the graph, before the frame's allocations are counted
+        bool postChanged = false;
+        for (unsigned int i = 0; i < 4; ++i) {
+            bool down = glfwGetKey(window, GLFW_KEY_1 + int(i)) == GLFW_PRESS;
+            if (down && !postKeysDown[i]) {
+                post.toggle(POST_EFFECTS[i]);
+                printf("%s %s\n", PostProcess::effectName(POST_EFFECTS[i]), post.enabled(POST_EFFECTS[i]) ? "on" : "off");
+                postChanged = true;
+            }
+            postKeysDown[i] = down;
+        }
+        if (postChanged && !buildFrameGraph()) fprintf( stderr, "Failed to compile the frame graph\n" );
+
+        Memory::beginFrame();
+        uint64_t frameAllocations = Memory::heapAllocations();
+
+        // track the frame time
+        double currentTime = glfwGetTime();
+        nbFrames++;
+        if(currentTime - lastTime >= 1.0) { // more than a second has elapsed
+            // print the current frame time over 1 second and reset the timer
+            printf("Frame Time: %f ms [%i fps]\n", 1000.0/double(nbFrames), nbFrames);
+            timer.printAverages();
+            printf("Render scale %.3f (%ux%u)\n", double(resolution.scale()), renderWidth, renderHeight);
+            printf("Particles %u sparks, %u smoke\n", sparks.liveCount(), smoke.liveCount());
+            printf("Terrain %u chunks, %u triangles, %u tiles resident\n", terrain.stats().chunks,
+                   terrain.stats().triangles, terrain.stats().residentTiles);
+            printf("Voxels %u chunks, %zu quads drawn\n", voxels.stats().drawnChunks, voxels.stats().drawnQuads);
+            lastTime = currentTime;
+            nbFrames = 0;
+        }
+
+
+        // move the lights and assign them to the clusters of the view
+        for (int i = 0; i < LIGHT_COUNT; ++i) {
+            float angle = float(currentTime) * 0.5f + float(i) * (6.2831853f / LIGHT_COUNT);
+            lights[i].position[0] = -2.0f + 1.8f * cosf(angle);
+            lights[i].position[1] = -1.2f + 2.4f * float(i % 8) / 7.0f;
+            lights[i].position[2] = 1.8f * sinf(angle);
+        }
+        clusters.assign(&View[0][0], lights.data(), lights.size());
+        clusters.upload();
+
+        // the tentacles blend from swaying into curling and back, their palettes are written straight into the
+        // stream buffer by the job threads
+        skinningPalettes.beginFrame();
+        paletteOffsets = Memory::frameArena().allocateArray<GLintptr>(tentacles.size());
+        for (size_t i = 0; i < tentacles.size(); ++i) {
+            StreamBuffer::Allocation palette;
+            if (paletteOffsets) {
+                palette = skinningPalettes.allocate(Animation::PALETTE_BYTES, skinningPalettes.uniformAlignment());
+                paletteOffsets[i] = palette.offset;
+            }
+            tentacles[i].palette = static_cast<float *>(palette.data);
+            tentacles[i].time += TIMESTEP;
+            tentacles[i].blendTime += TIMESTEP;
+            tentacles[i].blendWeight = 0.5f + 0.5f * sinf(float(currentTime) * 0.7f + float(i) * 0.3f);
+        }
+        Animation::evaluate(tentacleSkeleton, tentacles.data(), tentacles.size());
+        skinningPalettes.flush();
+
+        sparks.update(TIMESTEP);
+        smoke.update(TIMESTEP);
+
+        if (terrain.program()) terrain.update(&ViewProjection[0][0], &CameraPosition[0]);
+
+        // the rock grows back where the bubble was, then the bubble moves on along a circle through the rock
+        if (voxels.program()) {
+            float bubbleAngle = float(currentTime) * 0.6f;
+            const int next[3] = {32 + int(20.0f * cosf(bubbleAngle)), 12 + int(6.0f * sinf(bubbleAngle * 1.7f)),
+                                 32 + int(20.0f * sinf(bubbleAngle))};
+            for (int pass = 0; pass < 2; ++pass) {
+                const int *center = pass ? next : bubble;
+                for (int z = -BUBBLE_RADIUS; z <= BUBBLE_RADIUS; ++z)
+                    for (int y = -BUBBLE_RADIUS; y <= BUBBLE_RADIUS; ++y)
+                        for (int x = -BUBBLE_RADIUS; x <= BUBBLE_RADIUS; ++x) {
+                            if (x * x + y * y + z * z > BUBBLE_RADIUS * BUBBLE_RADIUS) continue;
+                            int p[3] = {center[0] + x, center[1] + y, center[2] + z};
+                            voxels.set(p[0], p[1], p[2], pass ? uint16_t(0) : rockMaterial(p[0], p[1], p[2]));
+                        }
+            }
+            std::copy(next, next + 3, bubble);
+            voxels.update();
+        }
+
+        // all drawing happens in the passes of the frame graph
+        frameGraph.execute(targetPool);
+        targetPool.endFrame();
+        skinningPalettes.endFrame();
 
         // Swap buffers
         glfwSwapBuffers(window);
         glfwPollEvents();
+        if (timer.endFrame() && dynamicResolution && resolution.update(timer.frameMilliseconds())) {
+            resolution.renderSize(unsigned(framebufferWidth), unsigned(framebufferHeight), renderWidth, renderHeight);
+            clusters.setViewport(renderWidth, renderHeight);
+            if (deferredShading) deferred.setRenderArea(renderWidth, renderHeight);
+            post.setRenderArea(renderWidth, renderHeight);
+        }
+
+        if (++frameNumber > WARM_UP_FRAMES && !reportedFrameAllocations &&
+            Memory::heapAllocations() != frameAllocations) {
+            printf("Frame %d allocated from the heap %llu times\n", frameNumber,
+                   static_cast<unsigned long long>(Memory::heapAllocations() - frameAllocations));
+            Memory::printStats();
+            reportedFrameAllocations = true;
+        }
     } while (glfwGetKey(window, GLFW_KEY_ESCAPE) != GLFW_PRESS &&
         glfwWindowShouldClose(window) == 0);
 
@@ -0,0 +1,541 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#include "Animation.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define ANIMATION_SSE2
+#endif
+
+#include "JobSystem.hpp"
+#include "Memory.hpp"
+
+namespace {
+    // SoA pose: every component of all joints is one array, rotation x y z w, translation x y z, scale x y z
+    constexpr size_t POSE_COMPONENTS = 10;
+    constexpr size_t TRANSLATION_COMPONENT = 4, SCALE_COMPONENT = 7;
+    // characters per job, a character is a few microseconds of work
+    constexpr unsigned int EVALUATE_BATCH = 4;
+    constexpr float ROTATION_RANGE = 0.70710678f;  // the smallest three components of a unit quaternion are below it
+    constexpr float ROTATION_STEPS = 32767.0f;
+    constexpr float RANGE_STEPS = 65535.0f;
+
+    void normalizeQuaternion(float q[4]) {
+        float length = std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+        float inverse = length > 0.0f ? 1.0f / length : 0.0f;
+        for (int c = 0; c < 4; ++c) q[c] *= inverse;
+        if (length == 0.0f) q[3] = 1.0f;
+    }
+
+    /** Normalized lerp along the shorter arc, the same math as the SIMD kernel */
+    void nlerp(const float a[4], const float b[4], float t, float out[4]) {
+        float dot = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+        float sign = dot < 0.0f ? -1.0f : 1.0f;
+        for (int c = 0; c < 4; ++c) out[c] = a[c] + (b[c] * sign - a[c]) * t;
+        normalizeQuaternion(out);
+    }
+
+    /** Rows of the 3x4 matrix translation * rotation * scale */
+    void transformToMatrix(const JointTransform &transform, float m[12]) {
+        const float *q = transform.rotation, *s = transform.scale;
+        float xx = q[0] * q[0], yy = q[1] * q[1], zz = q[2] * q[2];
+        float xy = q[0] * q[1], xz = q[0] * q[2], yz = q[1] * q[2];
+        float xw = q[0] * q[3], yw = q[1] * q[3], zw = q[2] * q[3];
+        const float matrix[12] = {
+            (1.0f - 2.0f * (yy + zz)) * s[0], 2.0f * (xy - zw) * s[1], 2.0f * (xz + yw) * s[2], transform.translation[0],
+            2.0f * (xy + zw) * s[0], (1.0f - 2.0f * (xx + zz)) * s[1], 2.0f * (yz - xw) * s[2], transform.translation[1],
+            2.0f * (xz - yw) * s[0], 2.0f * (yz + xw) * s[1], (1.0f - 2.0f * (xx + yy)) * s[2], transform.translation[2]};
+        memcpy(m, matrix, sizeof(matrix));
+    }
+
+    /** out = a * b for affine 3x4 matrices (rows), out may be b but not a */
+    void multiplyAffine(const float a[12], const float b[12], float out[12]) {
+#ifdef ANIMATION_SSE2
+        const __m128 b0 = _mm_loadu_ps(b), b1 = _mm_loadu_ps(b + 4), b2 = _mm_loadu_ps(b + 8);
+        const __m128 unitW = _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f);
+        for (int row = 0; row < 3; ++row) {
+            __m128 r = _mm_loadu_ps(a + row * 4);
+            __m128 result = _mm_mul_ps(_mm_shuffle_ps(r, r, _MM_SHUFFLE(0, 0, 0, 0)), b0);
+            result = _mm_add_ps(result, _mm_mul_ps(_mm_shuffle_ps(r, r, _MM_SHUFFLE(1, 1, 1, 1)), b1));
+            result = _mm_add_ps(result, _mm_mul_ps(_mm_shuffle_ps(r, r, _MM_SHUFFLE(2, 2, 2, 2)), b2));
+            result = _mm_add_ps(result, _mm_mul_ps(_mm_shuffle_ps(r, r, _MM_SHUFFLE(3, 3, 3, 3)), unitW));
+            _mm_storeu_ps(out + row * 4, result);
+        }
+#else
+        float result[12];
+        for (int row = 0; row < 3; ++row) {
+            for (int column = 0; column < 4; ++column) {
+                result[row * 4 + column] = a[row * 4] * b[column] + a[row * 4 + 1] * b[4 + column] +
+                                           a[row * 4 + 2] * b[8 + column] + (column == 3 ? a[row * 4 + 3] : 0.0f);
+            }
+        }
+        memcpy(out, result, sizeof(result));
+#endif
+    }
+
+    void invertAffine(const float m[12], float out[12]) {
+        float c00 = m[5] * m[10] - m[6] * m[9], c01 = m[6] * m[8] - m[4] * m[10], c02 = m[4] * m[9] - m[5] * m[8];
+        float determinant = m[0] * c00 + m[1] * c01 + m[2] * c02;
+        float inverse = determinant != 0.0f ? 1.0f / determinant : 0.0f;
+        float r[9] = {c00 * inverse, (m[2] * m[9] - m[1] * m[10]) * inverse, (m[1] * m[6] - m[2] * m[5]) * inverse,
+                      c01 * inverse, (m[0] * m[10] - m[2] * m[8]) * inverse, (m[2] * m[4] - m[0] * m[6]) * inverse,
+                      c02 * inverse, (m[1] * m[8] - m[0] * m[9]) * inverse, (m[0] * m[5] - m[1] * m[4]) * inverse};
+        for (int row = 0; row < 3; ++row) {
+            out[row * 4] = r[row * 3];
+            out[row * 4 + 1] = r[row * 3 + 1];
+            out[row * 4 + 2] = r[row * 3 + 2];
+            out[row * 4 + 3] = -(r[row * 3] * m[3] + r[row * 3 + 1] * m[7] + r[row * 3 + 2] * m[11]);
+        }
+    }
+
+    /** Smallest three: the largest component is dropped (and made positive), its index goes into the top bits */
+    void quantizeRotation(const float rotation[4], uint16_t out[3]) {
+        float q[4] = {rotation[0], rotation[1], rotation[2], rotation[3]};
+        normalizeQuaternion(q);
+        int largest = 0;
+        for (int c = 1; c < 4; ++c) if (std::fabs(q[c]) > std::fabs(q[largest])) largest = c;
+        float sign = q[largest] < 0.0f ? -1.0f : 1.0f;
+        for (int c = 0, i = 0; c < 4; ++c) {
+            if (c == largest) continue;
+            float normalized = std::clamp(q[c] * sign / ROTATION_RANGE * 0.5f + 0.5f, 0.0f, 1.0f);
+            out[i++] = uint16_t(std::lround(normalized * ROTATION_STEPS));
+        }
+        out[0] = uint16_t(out[0] | ((largest & 1) << 15));
+        out[1] = uint16_t(out[1] | ((largest >> 1) << 15));
+    }
+
+    void dequantizeRotation(const uint16_t in[3], float out[4]) {
+        int largest = (in[0] >> 15) | ((in[1] >> 15) << 1);
+        float sum = 0.0f;
+        for (int c = 0, i = 0; c < 4; ++c) {
+            if (c == largest) continue;
+            float value = (float(in[i++] & 0x7fff) / ROTATION_STEPS * 2.0f - 1.0f) * ROTATION_RANGE;
+            out[c] = value;
+            sum += value * value;
+        }
+        out[largest] = std::sqrt(std::max(1.0f - sum, 0.0f));
+    }
+
+    void dequantizeRange(const uint16_t in[3], const float offset[3], const float extent[3], float out[3]) {
+        for (int c = 0; c < 3; ++c) out[c] = offset[c] + float(in[c]) / RANGE_STEPS * extent[c];
+    }
+
+    /** dequantizeRotation() of a SoA pose in place, 4 joints at a time
+     *
+     *  The rotation arrays hold the three stored components without the index bits and, in w, the index of the largest
+     *  component, all as floats.
+     */
+    void dequantizeRotations(float *pose, size_t stride) {
+#ifdef ANIMATION_SSE2
+        const __m128 scale = _mm_set1_ps(2.0f * ROTATION_RANGE / ROTATION_STEPS), bias = _mm_set1_ps(-ROTATION_RANGE);
+        const __m128 one = _mm_set1_ps(1.0f), zero = _mm_setzero_ps();
+        auto select = [](__m128 mask, __m128 a, __m128 b) {
+            return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+        };
+        for (size_t i = 0; i < stride; i += 4) {
+            __m128 v0 = _mm_add_ps(_mm_mul_ps(_mm_load_ps(pose + i), scale), bias);
+            __m128 v1 = _mm_add_ps(_mm_mul_ps(_mm_load_ps(pose + stride + i), scale), bias);
+            __m128 v2 = _mm_add_ps(_mm_mul_ps(_mm_load_ps(pose + 2 * stride + i), scale), bias);
+            __m128 largest = _mm_load_ps(pose + 3 * stride + i);
+            __m128 sum = _mm_add_ps(_mm_add_ps(_mm_mul_ps(v0, v0), _mm_mul_ps(v1, v1)), _mm_mul_ps(v2, v2));
+            __m128 dropped = _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(one, sum), zero));
+            // component c is the dropped one where largest == c, the stored c - 1 where largest < c, else stored c
+            __m128 is0 = _mm_cmpeq_ps(largest, zero), is1 = _mm_cmpeq_ps(largest, one);
+            __m128 is2 = _mm_cmpeq_ps(largest, _mm_set1_ps(2.0f)), is3 = _mm_cmpeq_ps(largest, _mm_set1_ps(3.0f));
+            _mm_store_ps(pose + i, select(is0, dropped, v0));
+            _mm_store_ps(pose + stride + i, select(is0, v0, select(is1, dropped, v1)));
+            _mm_store_ps(pose + 2 * stride + i, select(is2, dropped, select(is3, v2, v1)));
+            _mm_store_ps(pose + 3 * stride + i, select(is3, dropped, v2));
+        }
+#else
+        for (size_t i = 0; i < stride; ++i) {
+            int largest = int(pose[3 * stride + i]);
+            uint16_t quantized[3];
+            for (size_t c = 0; c < 3; ++c) quantized[c] = uint16_t(pose[c * stride + i]);
+            quantized[0] = uint16_t(quantized[0] | ((largest & 1) << 15));
+            quantized[1] = uint16_t(quantized[1] | ((largest >> 1) << 15));
+            float rotation[4];
+            dequantizeRotation(quantized, rotation);
+            for (size_t c = 0; c < 4; ++c) pose[c * stride + i] = rotation[c];
+        }
+#endif
+    }
+
+    float rotationError(const float a[4], const float b[4]) {
+        float dot = std::fabs(a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3]);
+        return 2.0f * std::acos(std::min(dot, 1.0f));
+    }
+
+    const float *channelValue(const JointTransform &transform, int channel) {
+        return channel == 0 ? transform.rotation : channel == 1 ? transform.translation : transform.scale;
+    }
+
+    float *channelValue(JointTransform &transform, int channel) {
+        return channel == 0 ? transform.rotation : channel == 1 ? transform.translation : transform.scale;
+    }
+
+    /** Normalized lerp of the rotations and lerp of translations and scales of two SoA poses, 4 joints at a time
+     *
+     *  @param[in] weights Weight of to per rotation, translation and scale (3 arrays of stride), nullptr to use
+     *             constantWeight for all joints
+     *  @param[out] out May be from or to
+     */
+    void interpolatePoses(const float *from, const float *to, const float *weights, float constantWeight, float *out,
+                          size_t stride) {
+#ifdef ANIMATION_SSE2
+        const __m128 signBit = _mm_set1_ps(-0.0f), one = _mm_set1_ps(1.0f), constant = _mm_set1_ps(constantWeight);
+        for (size_t i = 0; i < stride; i += 4) {
+            __m128 rotationWeight = weights ? _mm_load_ps(weights + i) : constant;
+            __m128 a[4], b[4];
+            for (size_t c = 0; c < 4; ++c) {
+                a[c] = _mm_load_ps(from + c * stride + i);
+                b[c] = _mm_load_ps(to + c * stride + i);
+            }
+            __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a[0], b[0]), _mm_mul_ps(a[1], b[1])),
+                                    _mm_add_ps(_mm_mul_ps(a[2], b[2]), _mm_mul_ps(a[3], b[3])));
+            // b onto the hemisphere of a: flips the sign of b where the dot product is negative
+            __m128 flip = _mm_and_ps(dot, signBit);
+            __m128 r[4];
+            for (int c = 0; c < 4; ++c)
+                r[c] = _mm_add_ps(a[c], _mm_mul_ps(_mm_sub_ps(_mm_xor_ps(b[c], flip), a[c]), rotationWeight));
+            __m128 length2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r[0], r[0]), _mm_mul_ps(r[1], r[1])),
+                                        _mm_add_ps(_mm_mul_ps(r[2], r[2]), _mm_mul_ps(r[3], r[3])));
+            __m128 inverseLength = _mm_div_ps(one, _mm_sqrt_ps(length2));
+            for (size_t c = 0; c < 4; ++c) _mm_store_ps(out + c * stride + i, _mm_mul_ps(r[c], inverseLength));
+
+            for (size_t c = TRANSLATION_COMPONENT; c < POSE_COMPONENTS; ++c) {
+                size_t channel = c < SCALE_COMPONENT ? 1 : 2;
+                __m128 weight = weights ? _mm_load_ps(weights + channel * stride + i) : constant;
+                __m128 va = _mm_load_ps(from + c * stride + i), vb = _mm_load_ps(to + c * stride + i);
+                _mm_store_ps(out + c * stride + i, _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(vb, va), weight)));
+            }
+        }
+#else
+        for (size_t i = 0; i < stride; ++i) {
+            float a[4], b[4], r[4];
+            for (size_t c = 0; c < 4; ++c) {
+                a[c] = from[c * stride + i];
+                b[c] = to[c * stride + i];
+            }
+            nlerp(a, b, weights ? weights[i] : constantWeight, r);
+            for (size_t c = 0; c < 4; ++c) out[c * stride + i] = r[c];
+            for (size_t c = TRANSLATION_COMPONENT; c < POSE_COMPONENTS; ++c) {
+                size_t channel = c < SCALE_COMPONENT ? 1 : 2;
+                float weight = weights ? weights[channel * stride + i] : constantWeight;
+                out[c * stride + i] = from[c * stride + i] + (to[c * stride + i] - from[c * stride + i]) * weight;
+            }
+        }
+#endif
+    }
+
+    /** Turns a SoA pose into one 3x4 matrix (rows) per joint */
+    void poseToMatrices(const float *pose, size_t stride, float *matrices) {
+#ifdef ANIMATION_SSE2
+        const __m128 one = _mm_set1_ps(1.0f), two = _mm_set1_ps(2.0f);
+        for (size_t i = 0; i < stride; i += 4) {
+            __m128 x = _mm_load_ps(pose + i), y = _mm_load_ps(pose + stride + i);
+            __m128 z = _mm_load_ps(pose + 2 * stride + i), w = _mm_load_ps(pose + 3 * stride + i);
+            __m128 sx = _mm_load_ps(pose + 7 * stride + i), sy = _mm_load_ps(pose + 8 * stride + i);
+            __m128 sz = _mm_load_ps(pose + 9 * stride + i);
+            __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+            __m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+            __m128 xw = _mm_mul_ps(x, w), yw = _mm_mul_ps(y, w), zw = _mm_mul_ps(z, w);
+
+            __m128 rows[3][4] = {
+                {_mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx),
+                 _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, zw)), sy),
+                 _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, yw)), sz), _mm_load_ps(pose + 4 * stride + i)},
+                {_mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, zw)), sx),
+                 _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy),
+                 _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, xw)), sz), _mm_load_ps(pose + 5 * stride + i)},
+                {_mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, yw)), sx),
+                 _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, xw)), sy),
+                 _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz),
+                 _mm_load_ps(pose + 6 * stride + i)}};
+            // the registers hold one matrix element of 4 joints, transposed they hold one row of a joint
+            for (int row = 0; row < 3; ++row) {
+                _MM_TRANSPOSE4_PS(rows[row][0], rows[row][1], rows[row][2], rows[row][3]);
+                for (int joint = 0; joint < 4; ++joint)
+                    _mm_store_ps(matrices + (i + size_t(joint)) * 12 + size_t(row) * 4, rows[row][joint]);
+            }
+        }
+#else
+        for (size_t i = 0; i < stride; ++i) {
+            JointTransform transform;
+            for (size_t c = 0; c < 4; ++c) transform.rotation[c] = pose[c * stride + i];
+            for (size_t c = 0; c < 3; ++c) {
+                transform.translation[c] = pose[(TRANSLATION_COMPONENT + c) * stride + i];
+                transform.scale[c] = pose[(SCALE_COMPONENT + c) * stride + i];
+            }
+            transformToMatrix(transform, matrices + i * 12);
+        }
+#endif
+    }
+}
+
+int Skeleton::addJoint(int parent, const JointTransform &rest, const float *inverseBindMatrix) {
+    int index = int(parents.size());
+    parents.push_back(int16_t(parent < index ? parent : -1));
+    restPose.push_back(rest);
+    float inverse[12];
+    if (inverseBindMatrix) {
+        for (int row = 0; row < 3; ++row)
+            for (int column = 0; column < 4; ++column) inverse[row * 4 + column] = inverseBindMatrix[column * 4 + row];
+    } else {
+        // bind pose = rest pose: the model matrix of the joint, from the joint up to its root
+        float model[12];
+        transformToMatrix(rest, model);
+        for (int ancestor = parents.back(); ancestor >= 0; ancestor = parents[size_t(ancestor)]) {
+            float local[12];
+            transformToMatrix(restPose[size_t(ancestor)], local);
+            multiplyAffine(local, model, model);
+        }
+        invertAffine(model, inverse);
+    }
+    inverseBind.insert(inverseBind.end(), inverse, inverse + 12);
+    return index;
+}
+
+bool CompressedClip::compress(const AnimationClip &clip, const ClipCompressionSettings &settings) {
+    if (clip.frameCount == 0 || clip.frameCount > 65536 || clip.jointCount == 0 || clip.sampleRate <= 0.0f ||
+        clip.frames.size() != size_t(clip.frameCount) * clip.jointCount) return false;
+    tracks.clear();
+    keyFrames.clear();
+    keyValues.clear();
+    sampleRate = clip.sampleRate;
+    frameCount = clip.frameCount;
+    joints = clip.jointCount;
+
+    const float bounds[ChannelCount] = {settings.rotationError, settings.translationError, settings.scaleError};
+    std::vector<float> raw(size_t(frameCount) * 4), decoded(size_t(frameCount) * 4);
+    std::vector<uint16_t> quantized(size_t(frameCount) * 3);
+    std::vector<uint32_t> kept;
+    for (unsigned int joint = 0; joint < joints; ++joint) {
+        for (int channel = 0; channel < ChannelCount; ++channel) {
+            int components = channel == Rotation ? 4 : 3;
+            Track track{};
+            for (unsigned int frame = 0; frame < frameCount; ++frame) {
+                const float *value = channelValue(clip.frames[size_t(frame) * joints + joint], channel);
+                for (int c = 0; c < components; ++c) raw[frame * 4 + c] = value[c];
+                if (channel == Rotation) normalizeQuaternion(&raw[frame * 4]);
+            }
+            if (channel != Rotation) {
+                for (int c = 0; c < 3; ++c) {
+                    float low = raw[size_t(c)], high = raw[size_t(c)];
+                    for (unsigned int frame = 1; frame < frameCount; ++frame) {
+                        low = std::min(low, raw[frame * 4 + c]);
+                        high = std::max(high, raw[frame * 4 + c]);
+                    }
+                    track.offset[c] = low;
+                    track.extent[c] = high - low;
+                }
+            }
+
+            // every frame is quantized first, the reduction measures the error of what will be decoded
+            for (unsigned int frame = 0; frame < frameCount; ++frame) {
+                uint16_t *q = &quantized[frame * 3];
+                if (channel == Rotation) {
+                    quantizeRotation(&raw[frame * 4], q);
+                    dequantizeRotation(q, &decoded[frame * 4]);
+                    continue;
+                }
+                for (int c = 0; c < 3; ++c) {
+                    float normalized = track.extent[c] > 0.0f ? (raw[frame * 4 + c] - track.offset[c]) / track.extent[c]
+                                                              : 0.0f;
+                    q[c] = uint16_t(std::lround(std::clamp(normalized, 0.0f, 1.0f) * RANGE_STEPS));
+                }
+                dequantizeRange(q, track.offset, track.extent, &decoded[frame * 4]);
+            }
+
+            auto error = [&](unsigned int frame, const float *value) {
+                if (channel == Rotation) return rotationError(value, &raw[frame * 4]);
+                float largest = 0.0f;
+                for (int c = 0; c < 3; ++c) largest = std::max(largest, std::fabs(value[c] - raw[frame * 4 + c]));
+                return largest;
+            };
+            auto interpolated = [&](unsigned int first, unsigned int second, unsigned int frame, float *value) {
+                float t = float(frame - first) / float(second - first);
+                if (channel == Rotation) {
+                    nlerp(&decoded[first * 4], &decoded[second * 4], t, value);
+                } else {
+                    for (int c = 0; c < 3; ++c)
+                        value[c] = decoded[first * 4 + c] + (decoded[second * 4 + c] - decoded[first * 4 + c]) * t;
+                }
+            };
+            // a segment fits if every frame inside it is interpolated from its ends within the bound
+            auto fits = [&](unsigned int first, unsigned int second) {
+                float value[4];
+                for (unsigned int frame = first + 1; frame < second; ++frame) {
+                    interpolated(first, second, frame, value);
+                    if (error(frame, value) > bounds[channel]) return false;
+                }
+                return true;
+            };
+
+            // constant tracks keep their first key, the others grow every segment as far as it fits
+            kept.assign(1, 0);
+            bool constant = true;
+            for (unsigned int frame = 1; frame < frameCount && constant; ++frame)
+                constant = error(frame, &decoded[0]) <= bounds[channel];
+            if (!constant) {
+                unsigned int start = 0;
+                for (unsigned int end = start + 2; end < frameCount; ++end) {
+                    if (fits(start, end)) continue;
+                    start = end - 1;
+                    kept.push_back(start);
+                }
+                kept.push_back(frameCount - 1);
+            }
+
+            track.firstKey = uint32_t(keyFrames.size());
+            track.keyCount = uint32_t(kept.size());
+            for (uint32_t frame : kept) {
+                keyFrames.push_back(uint16_t(frame));
+                keyValues.insert(keyValues.end(), &quantized[frame * 3], &quantized[frame * 3] + 3);
+            }
+            tracks.push_back(track);
+        }
+    }
+    return true;
+}
+
+size_t CompressedClip::bytes() const {
+    return tracks.size() * sizeof(Track) + keyFrames.size() * sizeof(uint16_t) + keyValues.size() * sizeof(uint16_t);
+}
+
+float CompressedClip::framePosition(float time, bool loop) const {
+    if (frameCount <= 1) return 0.0f;
+    float length = duration();
+    if (loop) {
+        time = std::fmod(time, length);
+        if (time < 0.0f) time += length;
+    }
+    return std::clamp(time * sampleRate, 0.0f, float(frameCount - 1));
+}
+
+float CompressedClip::findKeys(const Track &track, float frame, uint32_t &first, uint32_t &second) const {
+    const uint16_t *begin = keyFrames.data() + track.firstKey, *end = begin + track.keyCount;
+    // the last key at or before the frame
+    const uint16_t *found = std::upper_bound(begin, end, frame, [](float value, uint16_t key) {
+        return value < float(key);
+    });
+    uint32_t index = found == begin ? 0 : uint32_t(found - begin) - 1;
+    first = track.firstKey + index;
+    if (index + 1 >= track.keyCount) {
+        second = first;
+        return 0.0f;
+    }
+    second = first + 1;
+    float from = float(keyFrames[first]), to = float(keyFrames[second]);
+    return std::clamp((frame - from) / (to - from), 0.0f, 1.0f);
+}
+
+void CompressedClip::decode(const Track &track, Channel channel, uint32_t key, float *value) const {
+    const uint16_t *quantized = &keyValues[size_t(key) * 3];
+    if (channel == Rotation) dequantizeRotation(quantized, value);
+    else dequantizeRange(quantized, track.offset, track.extent, value);
+}
+
+void CompressedClip::sample(float time, bool loop, JointTransform *pose) const {
+    float frame = framePosition(time, loop);
+    for (unsigned int joint = 0; joint < joints; ++joint) {
+        for (int channel = 0; channel < ChannelCount; ++channel) {
+            const Track &track = tracks[size_t(joint) * ChannelCount + size_t(channel)];
+            uint32_t first, second;
+            float t = findKeys(track, frame, first, second);
+            float a[4], b[4];
+            decode(track, Channel(channel), first, a);
+            decode(track, Channel(channel), second, b);
+            float *out = channelValue(pose[joint], channel);
+            if (channel == Rotation) nlerp(a, b, t, out);
+            else for (int c = 0; c < 3; ++c) out[c] = a[c] + (b[c] - a[c]) * t;
+        }
+    }
+}
+
+void Animation::evaluate(const Skeleton &skeleton, const AnimationInstance *instances, size_t count) {
+    JobSystem::parallelFor(unsigned(count), EVALUATE_BATCH, [&](unsigned int begin, unsigned int end) {
+        for (unsigned int i = begin; i < end; ++i) evaluate(skeleton, instances[i]);
+    });
+}
+
+void Animation::evaluate(const Skeleton &skeleton, const AnimationInstance &instance) {
+    const size_t jointCount = skeleton.jointCount();
+    if (!instance.clip || !instance.palette || instance.clip->jointCount() != jointCount) return;
+    const size_t stride = (jointCount + 3) & ~size_t(3);
+    ScratchScope scratch;
+    auto allocate = [&](size_t floats) { return static_cast<float *>(scratch.allocate(floats * sizeof(float), 16)); };
+    float *from = allocate(POSE_COMPONENTS * stride), *to = allocate(POSE_COMPONENTS * stride);
+    float *weights = allocate(CompressedClip::ChannelCount * stride);
+    float *pose = allocate(POSE_COMPONENTS * stride), *matrices = allocate(12 * stride);
+
+    // the keys around the time of every track: the rotations are copied quantized and decoded 4 at a time, the
+    // translations and scales decoded right away, the padding joints are identities
+    auto sample = [&](const CompressedClip &clip, float time, float *out) {
+        float frame = clip.framePosition(time, instance.loop);
+        for (size_t joint = 0; joint < jointCount; ++joint) {
+            const CompressedClip::Track *tracks = &clip.tracks[joint * CompressedClip::ChannelCount];
+            uint32_t keys[2];
+            weights[joint] = clip.findKeys(tracks[0], frame, keys[0], keys[1]);
+            for (int k = 0; k < 2; ++k) {
+                float *target = k == 0 ? from : to;
+                const uint16_t *quantized = &clip.keyValues[size_t(keys[k]) * 3];
+                target[joint] = float(quantized[0] & 0x7fff);
+                target[stride + joint] = float(quantized[1] & 0x7fff);
+                target[2 * stride + joint] = float(quantized[2]);
+                target[3 * stride + joint] = float((quantized[0] >> 15) | ((quantized[1] >> 15) << 1));
+            }
+            for (size_t channel = 1; channel < CompressedClip::ChannelCount; ++channel) {
+                size_t first = channel == 1 ? TRANSLATION_COMPONENT : SCALE_COMPONENT;
+                weights[channel * stride + joint] = clip.findKeys(tracks[channel], frame, keys[0], keys[1]);
+                for (int k = 0; k < 2; ++k) {
+                    float value[3];
+                    dequantizeRange(&clip.keyValues[size_t(keys[k]) * 3], tracks[channel].offset,
+                                    tracks[channel].extent, value);
+                    for (size_t c = 0; c < 3; ++c) (k == 0 ? from : to)[(first + c) * stride + joint] = value[c];
+                }
+            }
+        }
+        for (size_t joint = jointCount; joint < stride; ++joint) {
+            for (size_t c = 0; c < POSE_COMPONENTS; ++c) {
+                // quantized (0, 0, 0) with w the largest component, about the identity
+                float value = c < 3 ? 0.5f * ROTATION_STEPS : c == 3 ? 3.0f : c < SCALE_COMPONENT ? 0.0f : 1.0f;
+                from[c * stride + joint] = to[c * stride + joint] = value;
+            }
+            for (size_t channel = 0; channel < CompressedClip::ChannelCount; ++channel)
+                weights[channel * stride + joint] = 0.0f;
+        }
+        dequantizeRotations(from, stride);
+        dequantizeRotations(to, stride);
+        interpolatePoses(from, to, weights, 0.0f, out, stride);
+    };
+
+    sample(*instance.clip, instance.time, pose);
+    if (instance.blendClip && instance.blendWeight > 0.0f && instance.blendClip->jointCount() == jointCount) {
+        float *blended = allocate(POSE_COMPONENTS * stride);
+        sample(*instance.blendClip, instance.blendTime, blended);
+        interpolatePoses(pose, blended, nullptr, std::min(instance.blendWeight, 1.0f), pose, stride);
+    }
+    poseToMatrices(pose, stride, matrices);
+
+    // parents come first, so every joint is composed with the model matrix of its parent in place
+    for (size_t joint = 0; joint < jointCount; ++joint) {
+        int parent = skeleton.parents[joint];
+        if (parent >= 0) multiplyAffine(matrices + size_t(parent) * 12, matrices + joint * 12, matrices + joint * 12);
+        multiplyAffine(matrices + joint * 12, &skeleton.inverseBind[joint * 12], instance.palette + joint * 12);
+    }
+}
+
+void Animation::modelMatrices(const Skeleton &skeleton, const JointTransform *pose, float *matrices) {
+    for (size_t joint = 0; joint < skeleton.jointCount(); ++joint) {
+        transformToMatrix(pose[joint], matrices + joint * 12);
+        int parent = skeleton.parents[joint];
+        if (parent >= 0) multiplyAffine(matrices + size_t(parent) * 12, matrices + joint * 12, matrices + joint * 12);
+    }
+}
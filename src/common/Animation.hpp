@@ -0,0 +1,149 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#ifndef ANIMATION_H
+#define ANIMATION_H
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+/** Transform of a joint relative to its parent */
+struct JointTransform {
+    float rotation[4] = {0, 0, 0, 1};   // unit quaternion x, y, z, w
+    float translation[3] = {0, 0, 0};
+    float scale[3] = {1, 1, 1};
+};
+
+/** Joint hierarchy of a skinned mesh */
+struct Skeleton {
+    std::vector<int16_t> parents;       // -1 for roots, every parent comes before its children
+    std::vector<JointTransform> restPose;
+    std::vector<float> inverseBind;     // 12 floats per joint: the rows of the affine 3x4 inverse bind matrix
+
+    /** Appends a joint
+     *
+     *  @param[in] parent Index of an earlier joint, -1 for a root
+     *  @param[in] inverseBindMatrix Column major 4x4 matrix (as in glTF skins), nullptr to invert the rest pose
+     *  @returns Index of the joint
+     */
+    int addJoint(int parent, const JointTransform &rest, const float *inverseBindMatrix = nullptr);
+    size_t jointCount() const { return parents.size(); }
+};
+
+/** Uncompressed clip: the local transforms of all joints sampled at a fixed rate, the authoring format */
+struct AnimationClip {
+    float sampleRate = 30.0f;
+    unsigned int frameCount = 0;
+    unsigned int jointCount = 0;
+    std::vector<JointTransform> frames; // frames[frame * jointCount + joint]
+
+    float duration() const { return frameCount > 1 ? float(frameCount - 1) / sampleRate : 0.0f; }
+};
+
+/** Error bounds of the keyframe reduction, in the joint's local space */
+struct ClipCompressionSettings {
+    float rotationError = 0.001f;       // radians
+    float translationError = 0.0005f;   // units of the skeleton
+    float scaleError = 0.0005f;
+};
+
+/** Compressed clip, what the runtime samples
+ *
+ *  Every joint has a rotation, translation and scale track. A track keeps only the keys that linear interpolation
+ *  (normalized for rotations) can not reproduce within the error bounds, constant tracks keep a single key. Keys are
+ *  quantized:
+ *  - rotations with the smallest three components at 15 bits each, the index of the dropped largest one in the two
+ *    spare bits, 6 bytes instead of 16
+ *  - translations and scales at 16 bits per component within the range of their track, 6 bytes instead of 12
+ *  - key times as 16 bit frame indices
+ *
+ *  The error bounds are checked against the quantized keys, so they hold for what is played back. Errors add up along
+ *  the hierarchy, the model space error of a joint grows with its depth.
+ */
+class CompressedClip {
+public:
+    /** @returns false if the clip is empty, has more than 65535 frames or its frames do not match its size */
+    bool compress(const AnimationClip &clip, const ClipCompressionSettings &settings = {});
+
+    float duration() const { return frameCount > 1 ? float(frameCount - 1) / sampleRate : 0.0f; }
+    unsigned int jointCount() const { return joints; }
+    size_t keyCount() const { return keyFrames.size(); }
+    /** @returns Memory of the tracks, key times and key values */
+    size_t bytes() const;
+
+    /** Samples all joints at a time, scalar and one joint at a time, the reference of Animation's SIMD kernels
+     *
+     *  @param[in] loop Wraps the time into the clip, otherwise it is clamped to it
+     *  @param[out] pose jointCount() transforms
+     */
+    void sample(float time, bool loop, JointTransform *pose) const;
+
+private:
+    friend class Animation;
+    enum Channel : uint8_t { Rotation, Translation, Scale, ChannelCount };
+    struct Track {
+        uint32_t firstKey;
+        uint32_t keyCount;
+        float offset[3], extent[3];     // range of the quantized translation or scale values
+    };
+
+    /** Finds the keys around a frame position
+     *
+     *  @param[out] first Index of the key at or before the position, second the one after it (or the same key)
+     *  @returns Interpolation weight of the second key
+     */
+    float findKeys(const Track &track, float frame, uint32_t &first, uint32_t &second) const;
+    void decode(const Track &track, Channel channel, uint32_t key, float *value) const;
+    float framePosition(float time, bool loop) const;
+
+    std::vector<Track> tracks;          // ChannelCount per joint
+    std::vector<uint16_t> keyFrames;
+    std::vector<uint16_t> keyValues;    // 3 per key
+    float sampleRate = 30.0f;
+    unsigned int frameCount = 0, joints = 0;
+};
+
+/** One animated character: the clips it plays and where its skinning matrices go */
+struct AnimationInstance {
+    const CompressedClip *clip = nullptr;
+    float time = 0.0f;
+    /** Second clip blended over the first with blendWeight (0: first clip only), nullptr for none */
+    const CompressedClip *blendClip = nullptr;
+    float blendTime = 0.0f;
+    float blendWeight = 0.0f;
+    bool loop = true;
+    /** 12 floats per joint: the rows of the 3x4 matrices from the bind pose to the animated model space pose */
+    float *palette = nullptr;
+};
+
+/** Pose evaluation of many characters
+ *
+ *  A character is evaluated in structure of arrays form, 4 joints per SSE register:
+ *  - the keys around the sample time are decoded into two poses (scalar, one track after the other)
+ *  - the poses are interpolated and the blend clip is blended in (normalized lerp for the rotations)
+ *  - the local transforms are turned into 3x4 matrices and transposed into one matrix per joint
+ *  - the hierarchy is composed joint by joint into model space and multiplied by the inverse bind matrices
+ *
+ *  evaluate() spreads the characters over the JobSystem, the intermediate poses come from the scratch stack of the
+ *  thread, so evaluating does not allocate from the heap.
+ */
+class Animation {
+public:
+    /** Joints of the SkinnedMesh.vert palette, a palette uniform block holds PALETTE_BYTES */
+    static constexpr unsigned int MAX_PALETTE_JOINTS = 64;
+    static constexpr size_t PALETTE_BYTES = MAX_PALETTE_JOINTS * 12 * sizeof(float);
+
+    /** Evaluates the characters on all threads, the clips must have the joint count of the skeleton */
+    static void evaluate(const Skeleton &skeleton, const AnimationInstance *instances, size_t count);
+    /** Evaluates one character on the calling thread */
+    static void evaluate(const Skeleton &skeleton, const AnimationInstance &instance);
+
+    /** Model space 3x4 matrices (rows) of the joints of a pose, scalar, for tools and tests */
+    static void modelMatrices(const Skeleton &skeleton, const JointTransform *pose, float *matrices);
+};
+
+
+
+#endif //ANIMATION_H
@@ -0,0 +1,248 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#include "AssetArchive.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <unordered_set>
+
+#include "JobSystem.hpp"
+
+namespace {
+    constexpr char MAGIC[4] = {'L', 'L', 'P', 'K'};
+    constexpr size_t HEADER_SIZE = 32;
+
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint32_t entryCount;
+        uint32_t flags;
+        uint64_t tocOffset;
+        uint64_t namesOffset;
+    };
+    static_assert(sizeof(Header) == HEADER_SIZE, "the header layout is part of the file format");
+
+    bool writePadding(FILE *file, uint64_t &position, uint64_t alignment) {
+        static const unsigned char zeros[4096] = {};
+        uint64_t padding = (alignment - position % alignment) % alignment;
+        position += padding;
+        return fwrite(zeros, 1, size_t(padding), file) == padding;
+    }
+
+    /** @returns true if the stored bytes are inside the file and the decompressed size is one the codec can reach */
+    bool entryInside(const AssetArchive::Entry &entry, uint64_t fileSize) {
+        return entry.offset <= fileSize && entry.storedSize <= fileSize - entry.offset &&
+               entry.size <= Compression::decompressedBound(Compression::Codec(entry.codec), entry.storedSize);
+    }
+}
+
+std::string AssetArchive::normalize(const char *path) {
+    std::string name(path);
+    std::replace(name.begin(), name.end(), '\\', '/');
+    while (name.compare(0, 2, "./") == 0) name.erase(0, 2);
+    return name;
+}
+
+uint64_t AssetArchive::hashName(const std::string &name) {
+    uint64_t hash = 14695981039346656037ull;
+    for (char c : name) {
+        hash ^= uint64_t(static_cast<unsigned char>(c));
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+bool AssetArchive::open(const char *filename, bool quiet) {
+    entries = nullptr;
+    names = nullptr;
+    count = 0;
+    if (!file.open(filename)) {
+        if (!quiet) printf("Archive %s could not be opened\n", filename);
+        return false;
+    }
+
+    Header header{};
+    if (file.size() < HEADER_SIZE || (memcpy(&header, file.data(), HEADER_SIZE), memcmp(header.magic, MAGIC, 4) != 0)) {
+        printf("%s is not an asset archive\n", filename);
+        file.close();
+        return false;
+    }
+    if (header.version != VERSION) {
+        printf("%s has unsupported archive version %u\n", filename, header.version);
+        file.close();
+        return false;
+    }
+
+    // the toc and the name table are used in place, check that they and every blob are inside the file
+    uint64_t tocSize = uint64_t(header.entryCount) * sizeof(Entry);
+    bool valid = header.tocOffset % alignof(Entry) == 0 && header.tocOffset <= file.size() &&
+                 tocSize <= file.size() - header.tocOffset && header.namesOffset <= file.size();
+    if (valid) {
+        const Entry *toc = reinterpret_cast<const Entry *>(file.data() + header.tocOffset);
+        uint64_t namesSize = file.size() - header.namesOffset;
+        for (uint32_t i = 0; i < header.entryCount && valid; ++i) {
+            const Entry &entry = toc[i];
+            valid = entryInside(entry, file.size()) && uint64_t(entry.nameOffset) + entry.nameLength <= namesSize &&
+                    (i == 0 || toc[i - 1].hash <= entry.hash);
+        }
+    }
+    if (!valid) {
+        printf("%s has a corrupt table of contents\n", filename);
+        file.close();
+        return false;
+    }
+
+    entries = reinterpret_cast<const Entry *>(file.data() + header.tocOffset);
+    names = reinterpret_cast<const char *>(file.data() + header.namesOffset);
+    count = header.entryCount;
+    return true;
+}
+
+const AssetArchive::Entry *AssetArchive::find(const char *path) const {
+    std::string name = normalize(path);
+    uint64_t hash = hashName(name);
+
+    const Entry *end = entries + count;
+    const Entry *entry = std::lower_bound(entries, end, hash, [](const Entry &e, uint64_t h) { return e.hash < h; });
+    for (; entry != end && entry->hash == hash; ++entry) {
+        if (entry->nameLength == name.size() && memcmp(names + entry->nameOffset, name.data(), name.size()) == 0)
+            return entry;
+    }
+    return nullptr;
+}
+
+bool AssetArchive::read(const Entry &entry, const std::shared_ptr<const AssetArchive> &owner, AssetData &data) const {
+    if (!entryInside(entry, file.size())) {
+        printf("Archive entry %.*s is corrupt\n", int(entry.nameLength), names + entry.nameOffset);
+        return false;
+    }
+    const unsigned char *stored = file.data() + entry.offset;
+    auto codec = Compression::Codec(entry.codec);
+    if (codec == Compression::Codec::None) {
+        data = AssetData(owner, stored, size_t(entry.storedSize));
+        return true;
+    }
+
+    std::vector<unsigned char> buffer(size_t(entry.size));
+    if (!Compression::decompress(codec, stored, size_t(entry.storedSize), buffer.data(), buffer.size())) {
+        printf("Archive entry %.*s could not be decompressed\n", int(entry.nameLength), names + entry.nameOffset);
+        return false;
+    }
+    data = AssetData::fromBuffer(std::move(buffer));
+    return true;
+}
+
+bool AssetArchive::write(const char *filename, const std::vector<Source> &sources, Compression::Codec codec) {
+    if (!Compression::available(codec)) {
+        printf("Compression codec %u is not available in this build\n", unsigned(codec));
+        return false;
+    }
+
+    // drop duplicate names, the first source wins
+    struct Pending {
+        std::string name;
+        const Source *source = nullptr;
+        uint64_t hash = 0;
+        std::vector<unsigned char> stored;
+        Compression::Codec codec = Compression::Codec::None;
+        uint64_t size = 0;
+        bool failed = false;
+    };
+    std::vector<Pending> pending;
+    std::unordered_set<std::string> seen;
+    for (const Source &source : sources) {
+        std::string name = normalize(source.name.c_str());
+        if (name.size() > UINT16_MAX) {
+            printf("Asset name %s is too long\n", name.c_str());
+            return false;
+        }
+        if (!seen.insert(name).second) {
+            printf("Skipping duplicate asset %s\n", name.c_str());
+            continue;
+        }
+        Pending entry;
+        entry.name = name;
+        entry.source = &source;
+        entry.hash = hashName(name);
+        pending.push_back(std::move(entry));
+    }
+
+    // the toc counts the entries in 32 bits, which also covers the item count of parallelFor
+    if (pending.size() > UINT32_MAX) {
+        printf("%zu assets do not fit into one archive\n", pending.size());
+        return false;
+    }
+
+    // read and compress the entries on the worker threads
+    JobSystem::parallelFor(unsigned(pending.size()), 1, [&](unsigned int begin, unsigned int end) {
+        for (unsigned int i = begin; i < end; ++i) {
+            Pending &entry = pending[i];
+            MappedFile input;
+            if (!input.open(entry.source->filename.c_str())) {
+                entry.failed = true;
+                continue;
+            }
+            entry.size = input.size();
+            if (codec != Compression::Codec::None &&
+                Compression::compress(codec, input.data(), input.size(), entry.stored) && entry.stored.size() < input.size()) {
+                entry.codec = codec;
+            } else {
+                entry.stored.assign(input.data(), input.data() + input.size());
+            }
+        }
+    });
+    for (const Pending &entry : pending) {
+        if (entry.failed) {
+            printf("%s could not be read\n", entry.source->filename.c_str());
+            return false;
+        }
+    }
+
+    std::sort(pending.begin(), pending.end(), [](const Pending &a, const Pending &b) { return a.hash < b.hash; });
+
+    FILE *file = fopen(filename, "wb");
+    if (!file) {printf("%s could not be created\n", filename); return false;}
+
+    Header header{};
+    memcpy(header.magic, MAGIC, 4);
+    header.version = VERSION;
+    header.entryCount = uint32_t(pending.size());
+    bool written = fwrite(&header, 1, HEADER_SIZE, file) == HEADER_SIZE;
+    uint64_t position = HEADER_SIZE;
+
+    std::vector<Entry> toc(pending.size());
+    std::string nameTable;
+    for (size_t i = 0; i < pending.size() && written; ++i) {
+        written = writePadding(file, position, ALIGNMENT);
+        const Pending &source = pending[i];
+        Entry &entry = toc[i];
+        entry.hash = source.hash;
+        entry.offset = position;
+        entry.storedSize = source.stored.size();
+        entry.size = source.size;
+        entry.nameOffset = uint32_t(nameTable.size());
+        entry.nameLength = uint16_t(source.name.size());
+        entry.codec = uint8_t(source.codec);
+        entry.reserved = 0;
+        nameTable += source.name;
+
+        written = written && fwrite(source.stored.data(), 1, source.stored.size(), file) == source.stored.size();
+        position += source.stored.size();
+    }
+
+    written = written && writePadding(file, position, alignof(Entry));
+    header.tocOffset = position;
+    written = written && fwrite(toc.data(), sizeof(Entry), toc.size(), file) == toc.size();
+    position += toc.size() * sizeof(Entry);
+    header.namesOffset = position;
+    written = written && fwrite(nameTable.data(), 1, nameTable.size(), file) == nameTable.size();
+
+    // patch the offsets into the header
+    written = written && fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, 1, HEADER_SIZE, file) == HEADER_SIZE;
+    written = fclose(file) == 0 && written;
+    if (!written) printf("%s could not be written\n", filename);
+    return written;
+}
@@ -0,0 +1,90 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#ifndef ASSETARCHIVE_H
+#define ASSETARCHIVE_H
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Assets.hpp"
+#include "Compression.hpp"
+#include "MappedFile.hpp"
+
+
+/** Memory mapped .pak archive
+ *
+ *  Layout (little endian):
+ *    header   "LLPK", version, entry count, flags, offset of the table of contents, offset of the name table
+ *    data     one blob per entry, every blob starts on a 4 KiB boundary
+ *    toc      entries sorted by the 64 bit FNV-1a hash of their normalized name
+ *    names    the normalized names (no terminators), referenced by offset and length from the toc
+ *
+ *  Lookups are a binary search over the mapped toc followed by a name compare, nothing is parsed up front.
+ */
+class AssetArchive {
+public:
+    static constexpr uint32_t VERSION = 1;
+    static constexpr uint64_t ALIGNMENT = 4096;
+
+    struct Entry {
+        uint64_t hash;
+        uint64_t offset;
+        uint64_t storedSize;
+        uint64_t size;        // decompressed size
+        uint32_t nameOffset;
+        uint16_t nameLength;
+        uint8_t codec;        // Compression::Codec
+        uint8_t reserved;
+    };
+    static_assert(sizeof(Entry) == 40, "the toc entry layout is part of the file format");
+
+    struct Source {
+        std::string name;     // path the asset will be looked up by
+        std::string filename; // file the content is read from
+    };
+
+    /** Maps and validates an archive
+     *
+     *  @param[in] filename The path to the .pak file
+     *  @param[in] quiet Do not report a missing file
+     *  @returns false if the file could not be mapped or is not a valid archive
+     */
+    bool open(const char *filename, bool quiet = false);
+
+    /** @returns The toc entry for the path or nullptr */
+    const Entry *find(const char *path) const;
+
+    /** Returns a view of an entry, uncompressed entries point straight into the mapping
+     *
+     *  @param[in] owner Shared handle of this archive, kept alive by the returned view
+     */
+    bool read(const Entry &entry, const std::shared_ptr<const AssetArchive> &owner, AssetData &data) const;
+
+    uint32_t entryCount() const { return count; }
+    const Entry &entry(uint32_t index) const { return entries[index]; }
+
+    /** Writes an archive, entries are compressed with the codec when that makes them smaller
+     *
+     *  @param[in] filename The path to the .pak file
+     *  @param[in] sources The files to pack, duplicate names keep the first source
+     *  @param[in] codec Codec tried for every entry
+     *  @returns false if a source could not be read or the archive could not be written
+     */
+    static bool write(const char *filename, const std::vector<Source> &sources, Compression::Codec codec);
+
+    /** @returns The name as stored in the archive: '/' separators, no leading "./" */
+    static std::string normalize(const char *path);
+    static uint64_t hashName(const std::string &name);
+
+private:
+    MappedFile file;
+    const Entry *entries = nullptr;
+    const char *names = nullptr;
+    uint32_t count = 0;
+};
+
+
+
+#endif //ASSETARCHIVE_H
@@ -0,0 +1,107 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#include "Assets.hpp"
+
+#include <mutex>
+#include <string>
+
+#include "AssetArchive.hpp"
+#include "MappedFile.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+    std::mutex mutex;
+    std::vector<std::shared_ptr<const AssetArchive>> archives;
+    std::vector<std::string> searchPaths;
+
+    /** @returns Directory of the running executable with a trailing separator, empty if unknown */
+    std::string executableDirectory() {
+        std::string path;
+#ifdef _WIN32
+        char buffer[MAX_PATH];
+        DWORD length = GetModuleFileNameA(nullptr, buffer, MAX_PATH);
+        if (length > 0 && length < MAX_PATH) path.assign(buffer, length);
+#elif defined(__linux__)
+        char buffer[4096];
+        ssize_t length = readlink("/proc/self/exe", buffer, sizeof(buffer));
+        if (length > 0 && size_t(length) < sizeof(buffer)) path.assign(buffer, size_t(length));
+#endif
+        size_t separator = path.find_last_of("/\\");
+        return separator == std::string::npos ? std::string() : path.substr(0, separator + 1);
+    }
+
+    bool openLooseFile(const std::string &filename, AssetData &data) {
+        auto file = std::make_shared<MappedFile>();
+        if (!file->open(filename.c_str())) return false;
+        const unsigned char *pointer = file->data();
+        size_t size = file->size();
+        data = AssetData(std::move(file), pointer, size);
+        return true;
+    }
+}
+
+AssetData AssetData::fromBuffer(std::vector<unsigned char> &&buffer) {
+    auto storage = std::make_shared<std::vector<unsigned char>>(std::move(buffer));
+    const unsigned char *pointer = storage->data();
+    size_t size = storage->size();
+    return {std::move(storage), pointer, size};
+}
+
+AssetData AssetData::slice(size_t offset, size_t count) const {
+    offset = offset < length ? offset : length;
+    count = count < length - offset ? count : length - offset;
+    return {owner, pointer + offset, count};
+}
+
+bool Assets::mount(const char *filename) {
+    auto archive = std::make_shared<AssetArchive>();
+    if (!archive->open(filename, true)) return false;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    archives.push_back(std::move(archive));
+    return true;
+}
+
+void Assets::unmountAll() {
+    std::lock_guard<std::mutex> lock(mutex);
+    archives.clear(); // views handed out earlier keep their archive mapped
+}
+
+void Assets::addSearchPath(const char *directory) {
+    std::string path(directory);
+    if (!path.empty() && path.back() != '/' && path.back() != '\\') path += '/';
+
+    std::lock_guard<std::mutex> lock(mutex);
+    searchPaths.push_back(std::move(path));
+}
+
+bool Assets::open(const char *path, AssetData &data) {
+    std::vector<std::shared_ptr<const AssetArchive>> mounted;
+    std::vector<std::string> directories;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        mounted = archives;
+        directories = searchPaths;
+    }
+
+    // archives mounted later override earlier ones
+    for (auto archive = mounted.rbegin(); archive != mounted.rend(); ++archive) {
+        if (const AssetArchive::Entry *entry = (*archive)->find(path)) return (*archive)->read(*entry, *archive, data);
+    }
+
+    if (openLooseFile(path, data)) return true;
+    for (const std::string &directory : directories) {
+        if (openLooseFile(directory + path, data)) return true;
+    }
+
+    static const std::string executableDir = executableDirectory();
+    return !executableDir.empty() && openLooseFile(executableDir + path, data);
+}
@@ -0,0 +1,69 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#ifndef ASSETS_H
+#define ASSETS_H
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+
+/** Read only view of an asset's bytes
+ *
+ *  The view keeps its backing storage (a mapped archive, a mapped loose file or a decompressed buffer) alive,
+ *  so it can be handed to worker threads and outlive the call that opened it. Copies are cheap.
+ */
+class AssetData {
+public:
+    AssetData() = default;
+    AssetData(std::shared_ptr<const void> owner, const unsigned char *pointer, size_t length)
+        : owner(std::move(owner)), pointer(pointer), length(length) {}
+
+    /** @returns A view owning the given bytes */
+    static AssetData fromBuffer(std::vector<unsigned char> &&buffer);
+
+    const unsigned char *data() const { return pointer; }
+    size_t size() const { return length; }
+    bool empty() const { return length == 0; }
+
+    /** @returns A view of [offset, offset + count) sharing this view's storage, clamped to the view */
+    AssetData slice(size_t offset, size_t count) const;
+
+private:
+    std::shared_ptr<const void> owner;
+    const unsigned char *pointer = nullptr;
+    size_t length = 0;
+};
+
+/** Access to game data by relative path ("src/Textures/uvtemplate.DDS")
+ *
+ *  Paths are looked up in the mounted .pak archives first (last mounted wins), then as loose files relative to
+ *  the working directory, the registered search paths and the directory of the executable. Loose files are
+ *  memory mapped as well, so both sources return zero-copy views.
+ */
+class Assets {
+public:
+    /** Maps an archive written by AssetPacker and adds it to the lookup
+     *
+     *  @param[in] filename The path to the .pak file
+     *  @returns false if the file does not exist or is not a valid archive
+     */
+    static bool mount(const char *filename);
+    static void unmountAll();
+
+    /** Adds a directory loose files are searched in */
+    static void addSearchPath(const char *directory);
+
+    /** Opens an asset
+     *
+     *  @param[in] path Relative path of the asset, '/' or '\' separated
+     *  @param[out] data View of the (decompressed) content
+     *  @returns false if the asset exists nowhere or could not be decompressed
+     */
+    static bool open(const char *path, AssetData &data);
+};
+
+
+
+#endif //ASSETS_H
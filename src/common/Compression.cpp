@@ -0,0 +1,207 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#include "Compression.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+#ifdef ENGINE_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+namespace {
+    // LZ4 block format constants
+    constexpr size_t MIN_MATCH = 4;
+    constexpr size_t LAST_LITERALS = 5;   // the last 5 bytes are always literals
+    constexpr size_t MATCH_FIND_LIMIT = 12; // no match may start within the last 12 bytes
+    constexpr unsigned int HASH_BITS = 14;
+    constexpr size_t MAX_OFFSET = 65535;
+
+    uint32_t read32(const unsigned char *pointer) {
+        uint32_t value;
+        memcpy(&value, pointer, 4);
+        return value;
+    }
+
+    uint32_t hashSequence(uint32_t sequence) {
+        return (sequence * 2654435761u) >> (32 - HASH_BITS);
+    }
+
+    void writeLength(std::vector<unsigned char> &output, size_t length) {
+        while (length >= 255) {
+            output.push_back(255);
+            length -= 255;
+        }
+        output.push_back((unsigned char)length);
+    }
+
+    void emitSequence(std::vector<unsigned char> &output, const unsigned char *literals, size_t literalLength,
+                      size_t offset, size_t matchLength) {
+        size_t matchCode = matchLength - MIN_MATCH;
+        unsigned char token = (unsigned char)((literalLength < 15 ? literalLength : 15) << 4);
+        if (offset) token |= (unsigned char)(matchCode < 15 ? matchCode : 15);
+        output.push_back(token);
+        if (literalLength >= 15) writeLength(output, literalLength - 15);
+        output.insert(output.end(), literals, literals + literalLength);
+        if (!offset) return; // the last sequence only carries literals
+
+        output.push_back((unsigned char)(offset & 0xFF));
+        output.push_back((unsigned char)(offset >> 8));
+        if (matchCode >= 15) writeLength(output, matchCode - 15);
+    }
+
+    /** Greedy single pass LZ4 compressor (comparable to the reference "fast" mode) */
+    void compressLZ4(const unsigned char *input, size_t inputSize, std::vector<unsigned char> &output) {
+        output.clear();
+        output.reserve(inputSize + inputSize / 255 + 16);
+
+        size_t anchor = 0;
+        if (inputSize > MATCH_FIND_LIMIT) {
+            std::vector<uint32_t> table(size_t(1) << HASH_BITS, UINT32_MAX);
+            size_t position = 0;
+            size_t limit = inputSize - MATCH_FIND_LIMIT;
+            while (position < limit) {
+                uint32_t sequence = read32(input + position);
+                uint32_t &slot = table[hashSequence(sequence)];
+                size_t candidate = slot;
+                slot = uint32_t(position);
+
+                if (candidate == UINT32_MAX || position - candidate > MAX_OFFSET || read32(input + candidate) != sequence) {
+                    ++position;
+                    continue;
+                }
+
+                size_t matchLength = MIN_MATCH;
+                size_t matchLimit = inputSize - LAST_LITERALS;
+                while (position + matchLength < matchLimit && input[candidate + matchLength] == input[position + matchLength])
+                    ++matchLength;
+
+                emitSequence(output, input + anchor, position - anchor, position - candidate, matchLength);
+                position += matchLength;
+                anchor = position;
+            }
+        }
+        emitSequence(output, input + anchor, inputSize - anchor, 0, MIN_MATCH);
+    }
+
+    bool readLength(const unsigned char *input, size_t inputSize, size_t &position, size_t &length) {
+        unsigned char byte;
+        do {
+            if (position >= inputSize) return false;
+            byte = input[position++];
+            length += byte;
+        } while (byte == 255);
+        return true;
+    }
+
+    bool decompressLZ4(const unsigned char *input, size_t inputSize, unsigned char *output, size_t outputSize) {
+        size_t in = 0, out = 0;
+        while (in < inputSize) {
+            unsigned char token = input[in++];
+
+            size_t literalLength = token >> 4;
+            if (literalLength == 15 && !readLength(input, inputSize, in, literalLength)) return false;
+            if (literalLength > inputSize - in || literalLength > outputSize - out) return false;
+            memcpy(output + out, input + in, literalLength);
+            in += literalLength;
+            out += literalLength;
+            if (in == inputSize) break; // last sequence
+
+            if (inputSize - in < 2) return false;
+            size_t offset = input[in] | (input[in + 1] << 8);
+            in += 2;
+            if (offset == 0 || offset > out) return false;
+
+            size_t matchLength = token & 15;
+            if (matchLength == 15 && !readLength(input, inputSize, in, matchLength)) return false;
+            matchLength += MIN_MATCH;
+            if (matchLength > outputSize - out) return false;
+
+            const unsigned char *match = output + out - offset;
+            if (offset >= matchLength) {
+                memcpy(output + out, match, matchLength);
+            } else {
+                // overlapping copy repeats the last offset bytes
+                for (size_t i = 0; i < matchLength; ++i) output[out + i] = match[i];
+            }
+            out += matchLength;
+        }
+        return out == outputSize;
+    }
+}
+
+bool Compression::available(Codec codec) {
+    switch (codec) {
+        case Codec::None:
+        case Codec::LZ4:
+            return true;
+        case Codec::Zstd:
+#ifdef ENGINE_WITH_ZSTD
+            return true;
+#else
+            return false;
+#endif
+    }
+    return false;
+}
+
+bool Compression::compress(Codec codec, const unsigned char *input, size_t inputSize,
+                           std::vector<unsigned char> &output) {
+    switch (codec) {
+        case Codec::None:
+            output.assign(input, input + inputSize);
+            return true;
+        case Codec::LZ4:
+            compressLZ4(input, inputSize, output);
+            return true;
+        case Codec::Zstd: {
+#ifdef ENGINE_WITH_ZSTD
+            output.resize(ZSTD_compressBound(inputSize));
+            size_t result = ZSTD_compress(output.data(), output.size(), input, inputSize, 19);
+            if (ZSTD_isError(result)) return false;
+            output.resize(result);
+            return true;
+#else
+            return false;
+#endif
+        }
+    }
+    return false;
+}
+
+bool Compression::decompress(Codec codec, const unsigned char *input, size_t inputSize, unsigned char *output,
+                             size_t outputSize) {
+    switch (codec) {
+        case Codec::None:
+            if (inputSize != outputSize) return false;
+            memcpy(output, input, inputSize);
+            return true;
+        case Codec::LZ4:
+            return decompressLZ4(input, inputSize, output, outputSize);
+        case Codec::Zstd: {
+#ifdef ENGINE_WITH_ZSTD
+            size_t result = ZSTD_decompress(output, outputSize, input, inputSize);
+            return !ZSTD_isError(result) && result == outputSize;
+#else
+            return false;
+#endif
+        }
+    }
+    return false;
+}
+
+uint64_t Compression::decompressedBound(Codec codec, uint64_t inputSize) {
+    switch (codec) {
+        case Codec::None:
+            return inputSize;
+        case Codec::LZ4:
+            // a length byte adds at most 255 bytes to a literal run or a match
+            return inputSize * 255;
+        case Codec::Zstd:
+            // every block has a 3 byte header and decodes to at most 128 KB
+            return (inputSize / 3 + 1) * (128 << 10);
+    }
+    return 0;
+}
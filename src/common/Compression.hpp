@@ -0,0 +1,48 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+/** Byte stream codecs used by the asset pipeline
+ *
+ *  LZ4 (block format, compatible with the reference implementation) is built in, Zstandard is available
+ *  when the engine is built with ENGINE_WITH_ZSTD.
+ */
+class Compression {
+public:
+    enum class Codec : unsigned int {
+        None = 0,
+        LZ4 = 1,
+        Zstd = 2
+    };
+
+    /** @returns true if the codec can be used in this build */
+    static bool available(Codec codec);
+
+    /** Compresses a buffer
+     *
+     *  @param[out] output Compressed bytes (replaces the content)
+     *  @returns false if the codec is not available
+     */
+    static bool compress(Codec codec, const unsigned char *input, size_t inputSize, std::vector<unsigned char> &output);
+
+    /** Decompresses a buffer of known decompressed size
+     *
+     *  @returns false on corrupt input or if the output does not have exactly outputSize bytes
+     */
+    static bool decompress(Codec codec, const unsigned char *input, size_t inputSize, unsigned char *output,
+                           size_t outputSize);
+
+    /** @returns Largest size inputSize bytes of the codec can decompress to, 0 for an unknown codec */
+    static uint64_t decompressedBound(Codec codec, uint64_t inputSize);
+};
+
+
+
+#endif //COMPRESSION_H
@@ -0,0 +1,206 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#include "CookedMesh.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+
+#include "VertexQuantization.hpp"
+
+namespace {
+    constexpr char MAGIC[4] = {'L', 'L', 'M', 'S'};
+
+    bool writePadding(FILE *file, uint64_t &position, uint64_t alignment) {
+        static const unsigned char zeros[16] = {};
+        uint64_t padding = (alignment - position % alignment) % alignment;
+        position += padding;
+        return fwrite(zeros, 1, size_t(padding), file) == padding;
+    }
+
+    /** Attribute pointers of a vertex format, locations like Meshes::upload */
+    void setupAttributes(CookedMesh::VertexFormat format, GLsizei stride) {
+        switch (format) {
+            case CookedMesh::VertexFormat::Float32:
+                glEnableVertexAttribArray(0);
+                glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void *>(offsetof(Vertex, position)));
+                glEnableVertexAttribArray(1);
+                glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void *>(offsetof(Vertex, uv)));
+                glEnableVertexAttribArray(2);
+                glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void *>(offsetof(Vertex, normal)));
+                break;
+            case CookedMesh::VertexFormat::Quantized16:
+                // normalized to [0, 1] by the fetch, VertexDecode maps them back
+                glEnableVertexAttribArray(0);
+                glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride, reinterpret_cast<void *>(offsetof(QuantizedVertex, position)));
+                glEnableVertexAttribArray(1);
+                glVertexAttribPointer(1, 2, GL_UNSIGNED_SHORT, GL_TRUE, stride, reinterpret_cast<void *>(offsetof(QuantizedVertex, uv)));
+                glEnableVertexAttribArray(2);
+                glVertexAttribPointer(2, 2, GL_UNSIGNED_SHORT, GL_TRUE, stride, reinterpret_cast<void *>(offsetof(QuantizedVertex, normal)));
+                break;
+        }
+    }
+
+    uint32_t strideOf(CookedMesh::VertexFormat format) {
+        switch (format) {
+            case CookedMesh::VertexFormat::Float32: return sizeof(Vertex);
+            case CookedMesh::VertexFormat::Quantized16: return sizeof(QuantizedVertex);
+        }
+        return 0;
+    }
+}
+
+bool CookedMesh::open(const char *filename) {
+    file = AssetData();
+    AssetData source;
+    if (!Assets::open(filename, source)) {printf("Mesh file %s could not be opened\n", filename); return false;}
+    if (source.size() < sizeof(Header) || memcmp(source.data(), MAGIC, 4) != 0) {
+        printf("%s is not a cooked mesh\n", filename);
+        return false;
+    }
+
+    Header header;
+    memcpy(&header, source.data(), sizeof(Header));
+    if (header.version != VERSION) {
+        printf("%s has unsupported mesh version %u, cook it again\n", filename, header.version);
+        return false;
+    }
+    if (header.vertexFormat > uint32_t(VertexFormat::Quantized16) ||
+        header.vertexStride != strideOf(VertexFormat(header.vertexFormat))) {
+        printf("%s has an unknown vertex format\n", filename);
+        return false;
+    }
+    uint64_t indexSize = header.indexType == GL_UNSIGNED_SHORT ? 2 : header.indexType == GL_UNSIGNED_INT ? 4 : 0;
+    bool valid = indexSize != 0 && header.lodCount > 0 &&
+                 sizeof(Header) + uint64_t(header.lodCount) * sizeof(Lod) <= source.size() &&
+                 header.vertexSize == uint64_t(header.vertexCount) * header.vertexStride &&
+                 header.indexSize == uint64_t(header.indexCount) * indexSize &&
+                 header.vertexOffset % ALIGNMENT == 0 && header.indexOffset % ALIGNMENT == 0 &&
+                 header.vertexOffset <= source.size() && header.vertexSize <= source.size() - header.vertexOffset &&
+                 header.indexOffset <= source.size() && header.indexSize <= source.size() - header.indexOffset &&
+                 header.meshletOffset % ALIGNMENT == 0 && header.meshletOffset <= source.size() &&
+                 uint64_t(header.meshletCount) * sizeof(Meshlet) <= source.size() - header.meshletOffset;
+    for (uint32_t i = 0; valid && i < header.lodCount; ++i) {
+        Lod lod;
+        memcpy(&lod, source.data() + sizeof(Header) + i * sizeof(Lod), sizeof(Lod));
+        valid = lod.firstIndex <= header.indexCount && lod.indexCount <= header.indexCount - lod.firstIndex;
+    }
+    for (uint32_t i = 0; valid && i < header.meshletCount; ++i) {
+        Meshlet meshlet;
+        memcpy(&meshlet, source.data() + header.meshletOffset + i * sizeof(Meshlet), sizeof(Meshlet));
+        valid = meshlet.firstIndex <= header.indexCount && meshlet.indexCount <= header.indexCount - meshlet.firstIndex;
+    }
+    if (!valid) {printf("%s is corrupt\n", filename); return false;}
+
+    file = source;
+    return true;
+}
+
+GpuMesh CookedMesh::upload() const {
+    const Header &info = header();
+    GpuMesh gpu;
+    glGenVertexArrays(1, &gpu.vertexArray);
+    glBindVertexArray(gpu.vertexArray);
+
+    // one call per blob, the driver copies straight out of the mapping
+    glGenBuffers(1, &gpu.vertexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, gpu.vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(info.vertexSize), vertices(), GL_STATIC_DRAW);
+
+    glGenBuffers(1, &gpu.indexBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gpu.indexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, GLsizeiptr(info.indexSize), indices(), GL_STATIC_DRAW);
+
+    setupAttributes(VertexFormat(info.vertexFormat), GLsizei(info.vertexStride));
+    glBindVertexArray(0);
+
+    gpu.indexCount = GLsizei(info.indexCount);
+    gpu.indexType = info.indexType;
+    for (uint32_t i = 0; i < info.lodCount; ++i) gpu.lods.push_back({lod(i).firstIndex, lod(i).indexCount, lod(i).error});
+    std::copy(info.boundsMin, info.boundsMin + 3, gpu.boundsMin);
+    std::copy(info.boundsMax, info.boundsMax + 3, gpu.boundsMax);
+    if (VertexFormat(info.vertexFormat) == VertexFormat::Quantized16) {
+        for (int axis = 0; axis < 3; ++axis) {
+            gpu.decode.positionOffset[axis] = info.boundsMin[axis];
+            gpu.decode.positionScale[axis] = info.boundsMax[axis] - info.boundsMin[axis];
+        }
+        std::copy(info.uvOffset, info.uvOffset + 2, gpu.decode.uvOffset);
+        std::copy(info.uvScale, info.uvScale + 2, gpu.decode.uvScale);
+        gpu.decode.octahedralNormals = true;
+    }
+    return gpu;
+}
+
+bool CookedMesh::load(const char *filename, GpuMesh &mesh) {
+    CookedMesh cooked;
+    if (!cooked.open(filename)) return false;
+    mesh = cooked.upload();
+    return true;
+}
+
+bool CookedMesh::write(const char *filename, const MeshData &mesh, const std::vector<MeshLod> &lods, VertexFormat format,
+                       const std::vector<Meshlet> &meshlets) {
+    std::vector<Lod> table;
+    for (const MeshLod &lod : lods) table.push_back({lod.firstIndex, lod.indexCount, lod.error, 0});
+    if (table.empty()) table.push_back({0, uint32_t(mesh.indices.size()), 0.0f, 0});
+
+    Header header{};
+    memcpy(header.magic, MAGIC, 4);
+    header.version = VERSION;
+    header.vertexFormat = uint32_t(format);
+    header.vertexStride = strideOf(format);
+    header.vertexCount = uint32_t(mesh.vertices.size());
+    header.indexCount = uint32_t(mesh.indices.size());
+    header.indexType = mesh.vertices.size() <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    header.lodCount = uint32_t(table.size());
+    header.meshletCount = uint32_t(meshlets.size());
+    std::copy(mesh.boundsMin, mesh.boundsMin + 3, header.boundsMin);
+    std::copy(mesh.boundsMax, mesh.boundsMax + 3, header.boundsMax);
+    header.uvScale[0] = header.uvScale[1] = 1.0f;
+    header.vertexSize = uint64_t(mesh.vertices.size()) * header.vertexStride;
+
+    const void *vertexData = mesh.vertices.data();
+    std::vector<QuantizedVertex> quantized;
+    if (format == VertexFormat::Quantized16) {
+        VertexDecode decode = VertexQuantization::decodeFor(mesh);
+        VertexQuantization::quantize(mesh, decode, quantized);
+        std::copy(decode.uvOffset, decode.uvOffset + 2, header.uvOffset);
+        std::copy(decode.uvScale, decode.uvScale + 2, header.uvScale);
+        vertexData = quantized.data();
+    }
+
+    // 16 bit indices halve the index blob for everything below 64k vertices
+    std::vector<uint16_t> shortIndices;
+    const void *indexData = mesh.indices.data();
+    if (header.indexType == GL_UNSIGNED_SHORT) {
+        shortIndices.assign(mesh.indices.begin(), mesh.indices.end());
+        indexData = shortIndices.data();
+        header.indexSize = shortIndices.size() * sizeof(uint16_t);
+    } else {
+        header.indexSize = mesh.indices.size() * sizeof(unsigned int);
+    }
+
+    FILE *file = fopen(filename, "wb");
+    if (!file) {printf("%s could not be created\n", filename); return false;}
+    uint64_t position = sizeof(Header) + table.size() * sizeof(Lod);
+    header.vertexOffset = (position + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    header.indexOffset = (header.vertexOffset + header.vertexSize + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    header.meshletOffset = (header.indexOffset + header.indexSize + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+
+    bool written = fwrite(&header, 1, sizeof(Header), file) == sizeof(Header) &&
+                   fwrite(table.data(), sizeof(Lod), table.size(), file) == table.size() &&
+                   writePadding(file, position, ALIGNMENT) &&
+                   fwrite(vertexData, 1, size_t(header.vertexSize), file) == header.vertexSize;
+    position += header.vertexSize;
+    written = written && writePadding(file, position, ALIGNMENT) &&
+              fwrite(indexData, 1, size_t(header.indexSize), file) == header.indexSize;
+    position += header.indexSize;
+    written = written && writePadding(file, position, ALIGNMENT) &&
+              fwrite(meshlets.data(), sizeof(Meshlet), meshlets.size(), file) == meshlets.size();
+    written = fclose(file) == 0 && written;
+    if (!written) printf("%s could not be written\n", filename);
+    return written;
+}
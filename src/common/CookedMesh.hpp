@@ -0,0 +1,106 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#ifndef COOKEDMESH_H
+#define COOKEDMESH_H
+#include <cstdint>
+#include <vector>
+
+#include "Assets.hpp"
+#include "Meshes.hpp"
+#include "Meshlets.hpp"
+
+
+/** Engine native mesh file (.mesh), written by MeshTool cook
+ *
+ *  Layout (little endian):
+ *    header     "LLMS", version, vertex format and stride, counts, index type, bounds, uv range, blob offsets and sizes
+ *    lods       lodCount entries, index ranges into the shared index blob, LOD 0 first
+ *    vertices   interleaved vertices in the layout of the vertex format, 16 byte aligned
+ *    indices    16 or 32 bit triangle lists of all LODs back to back, 16 byte aligned
+ *    meshlets   meshletCount Meshlet entries (bounds and index ranges of LOD 0 clusters), 16 byte aligned
+ *
+ *  The blobs are stored exactly as OpenGL consumes them: loading maps the file and hands each blob to a single
+ *  glBufferData call, nothing is parsed or converted at runtime.
+ */
+class CookedMesh {
+public:
+    static constexpr uint32_t VERSION = 3;
+    static constexpr uint64_t ALIGNMENT = 16;
+
+    enum class VertexFormat : uint32_t {
+        Float32 = 0,    // Vertex: float position[3], normal[3], uv[2]
+        Quantized16 = 1 // QuantizedVertex: unorm16 position relative to the bounds, octahedral normal, uv in the uv range
+    };
+
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint32_t vertexFormat;
+        uint32_t vertexStride;
+        uint32_t vertexCount;
+        uint32_t indexCount;  // all LODs
+        uint32_t indexType;   // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+        uint32_t lodCount;
+        float boundsMin[3];
+        float boundsMax[3];
+        float uvOffset[2];    // dequantization of Quantized16 uvs
+        float uvScale[2];
+        uint32_t meshletCount; // 0 if cooked without --meshlets
+        uint32_t reserved;
+        uint64_t vertexOffset;
+        uint64_t vertexSize;
+        uint64_t indexOffset;
+        uint64_t indexSize;
+        uint64_t meshletOffset;
+    };
+    static_assert(sizeof(Header) == 120, "the header layout is part of the file format");
+
+    struct Lod {
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        float error;
+        uint32_t reserved;
+    };
+    static_assert(sizeof(Lod) == 16, "the lod layout is part of the file format");
+
+    /** Maps and validates a .mesh file
+     *
+     *  @param[in] filename The path to the file (loose or inside a mounted archive)
+     *  @returns false if the file is missing, truncated or has an unknown version or vertex format
+     */
+    bool open(const char *filename);
+
+    const Header &header() const { return *reinterpret_cast<const Header *>(file.data()); }
+    const Lod &lod(uint32_t index) const { return reinterpret_cast<const Lod *>(file.data() + sizeof(Header))[index]; }
+    const unsigned char *vertices() const { return file.data() + header().vertexOffset; }
+    const unsigned char *indices() const { return file.data() + header().indexOffset; }
+    /** Feed to MeshletCullData::assign to cull the clusters of LOD 0 */
+    const Meshlet *meshlets() const { return reinterpret_cast<const Meshlet *>(file.data() + header().meshletOffset); }
+
+    /** Creates the vertex array and one buffer per blob straight from the mapping */
+    GpuMesh upload() const;
+
+    /** Shorthand for open() followed by upload() */
+    static bool load(const char *filename, GpuMesh &mesh);
+
+    /** Writes a mesh, optimize it (MeshOptimizer) before
+     *
+     *  @param[in] filename The path to the .mesh file
+     *  @param[in] mesh Vertices, indices of all LODs and bounds
+     *  @param[in] lods Index ranges of the LODs in mesh.indices, empty for a single LOD with all indices
+     *  @param[in] format Vertex layout of the file, Quantized16 halves the vertex blob
+     *  @param[in] meshlets Clusters of LOD 0 (Meshlets::build), may be empty
+     *  @returns false if the file could not be written
+     */
+    static bool write(const char *filename, const MeshData &mesh, const std::vector<MeshLod> &lods,
+                      VertexFormat format = VertexFormat::Float32, const std::vector<Meshlet> &meshlets = {});
+
+private:
+    AssetData file;
+};
+
+
+
+#endif //COOKEDMESH_H
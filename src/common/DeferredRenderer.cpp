@@ -0,0 +1,144 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#include "DeferredRenderer.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "shader.hpp"
+
+DeferredRenderer::~DeferredRenderer() {
+    destroy();
+}
+
+bool DeferredRenderer::create(unsigned int targetWidth, unsigned int targetHeight) {
+    destroy();
+    gBufferProgram = LoadShaders("src/shaders/MeshShader.vert", "src/shaders/GBuffer.frag");
+    lightProgram = LoadShaders("src/shaders/Fullscreen.vert", "src/shaders/DeferredLighting.frag");
+    if (!gBufferProgram || !lightProgram) {
+        printf("Deferred shading programs could not be loaded\n");
+        destroy();
+        return false;
+    }
+
+    glUseProgram(lightProgram);
+    glUniform1i(glGetUniformLocation(lightProgram, "albedoMaterialBuffer"), ALBEDO_TEXTURE_UNIT);
+    glUniform1i(glGetUniformLocation(lightProgram, "normalBuffer"), NORMAL_TEXTURE_UNIT);
+    glUniform1i(glGetUniformLocation(lightProgram, "depthBuffer"), DEPTH_TEXTURE_UNIT);
+    // samplers of different types must not share a unit, even while the shadows are off
+    glUniform1i(glGetUniformLocation(lightProgram, "shadowMap"), ShadowCascades::SHADOW_TEXTURE_UNIT);
+    glUseProgram(0);
+
+    // core profiles need a bound vertex array even for draws without attributes
+    glGenVertexArrays(1, &emptyVertexArray);
+    return resize(targetWidth, targetHeight);
+}
+
+bool DeferredRenderer::resize(unsigned int targetWidth, unsigned int targetHeight) {
+    destroyTargets();
+    width = targetWidth > 0 ? targetWidth : 1;
+    height = targetHeight > 0 ? targetHeight : 1;
+    areaWidth = width;
+    areaHeight = height;
+    return createTargets();
+}
+
+void DeferredRenderer::setRenderArea(unsigned int renderWidth, unsigned int renderHeight) {
+    areaWidth = std::clamp(renderWidth, 1u, width);
+    areaHeight = std::clamp(renderHeight, 1u, height);
+}
+
+bool DeferredRenderer::createTargets() {
+    const GLenum internalFormats[3] = {ALBEDO_FORMAT, NORMAL_FORMAT, DEPTH_FORMAT};
+    const GLenum formats[3] = {GL_RGBA, GL_RG, GL_DEPTH_STENCIL};
+    const GLenum types[3] = {GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT, GL_UNSIGNED_INT_24_8};
+    GLuint *textures[3] = {&albedoTexture, &normalTexture, &depthTexture};
+    for (int i = 0; i < 3; ++i) {
+        glGenTextures(1, textures[i]);
+        glBindTexture(GL_TEXTURE_2D, *textures[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GLint(internalFormats[i]), GLsizei(width), GLsizei(height), 0, formats[i],
+                     types[i], nullptr);
+        // read with texelFetch only, but a sampler without mipmaps must not use a mipmap filter to be complete
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    GLint bound = 0;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &bound);
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedoTexture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normalTexture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+    const GLenum drawBuffers[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+    glDrawBuffers(2, drawBuffers);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, GLuint(bound));
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        printf("G-buffer framebuffer is incomplete: 0x%x\n", status);
+        return false;
+    }
+    return true;
+}
+
+void DeferredRenderer::beginGeometry() {
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+    glGetIntegerv(GL_VIEWPORT, previousViewport);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, GLsizei(areaWidth), GLsizei(areaHeight));
+    // albedo and normals of uncovered pixels are never read, the lighting pass skips depth 1
+    glClear(GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+}
+
+void DeferredRenderer::endGeometry() {
+    glBindFramebuffer(GL_FRAMEBUFFER, GLuint(previousFramebuffer));
+    glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+}
+
+void DeferredRenderer::light(const float inverseViewProjection[16], const float cameraPosition[3],
+                             const LightClusters &clusters, const ShadowCascades *shadows) {
+    glUseProgram(lightProgram);
+    glUniformMatrix4fv(glGetUniformLocation(lightProgram, "inverseViewProjection"), 1, GL_FALSE, inverseViewProjection);
+    glUniform3fv(glGetUniformLocation(lightProgram, "cameraPosition"), 1, cameraPosition);
+    glUniform2f(glGetUniformLocation(lightProgram, "viewportSize"), float(areaWidth), float(areaHeight));
+    clusters.bind(lightProgram);
+    if (shadows) shadows->bind(lightProgram);
+    else glUniform1i(glGetUniformLocation(lightProgram, "cascadeCount"), 0);
+
+    const GLint units[3] = {ALBEDO_TEXTURE_UNIT, NORMAL_TEXTURE_UNIT, DEPTH_TEXTURE_UNIT};
+    const GLuint textures[3] = {albedoTexture, normalTexture, depthTexture};
+    for (int i = 0; i < 3; ++i) {
+        glActiveTexture(GL_TEXTURE0 + units[i]);
+        glBindTexture(GL_TEXTURE_2D, textures[i]);
+    }
+    glActiveTexture(GL_TEXTURE0);
+
+    // the fullscreen triangle writes the G-buffer depth as is
+    GLint depthFunction = GL_LESS, vertexArray = 0;
+    glGetIntegerv(GL_DEPTH_FUNC, &depthFunction);
+    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &vertexArray);
+    glDepthFunc(GL_ALWAYS);
+    glBindVertexArray(emptyVertexArray);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(GLuint(vertexArray));
+    glDepthFunc(GLenum(depthFunction));
+}
+
+void DeferredRenderer::destroyTargets() {
+    if (framebuffer) glDeleteFramebuffers(1, &framebuffer);
+    GLuint textures[3] = {albedoTexture, normalTexture, depthTexture};
+    glDeleteTextures(3, textures);
+    framebuffer = albedoTexture = normalTexture = depthTexture = 0;
+}
+
+void DeferredRenderer::destroy() {
+    if (framebuffer || albedoTexture) destroyTargets();
+    if (gBufferProgram) glDeleteProgram(gBufferProgram);
+    if (lightProgram) glDeleteProgram(lightProgram);
+    if (emptyVertexArray) glDeleteVertexArrays(1, &emptyVertexArray);
+    gBufferProgram = lightProgram = emptyVertexArray = 0;
+}
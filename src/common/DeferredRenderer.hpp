@@ -0,0 +1,102 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#ifndef DEFERREDRENDERER_H
+#define DEFERREDRENDERER_H
+#include <glad/gl.h>
+#include <cstddef>
+
+#include "LightClusters.hpp"
+#include "ShadowCascades.hpp"
+
+
+/** Deferred shading: opaque geometry is written into a G-buffer once, the lighting is one fullscreen pass
+ *
+ *  The G-buffer is kept small, 12 bytes per pixel:
+ *  - RGBA8 albedo, alpha holds the material (4 bit specular, 4 bit glossiness)
+ *  - RG16 octahedral world space normal
+ *  - 24 bit depth (with stencil), the position is reconstructed from it instead of being stored
+ *
+ *  The lighting pass (DeferredLighting.frag) finds the pixel's cluster of a LightClusters and only evaluates its
+ *  lights, so the cost per pixel is the same tiled accumulation as the forward path (ClusteredShader.frag). It writes
+ *  the scene depth into the target framebuffer, forward passes drawn afterwards depth test against the opaque scene.
+ *
+ *  Per frame: beginGeometry(), draw the opaque objects with geometryProgram() (MeshShader.vert and GBuffer.frag),
+ *  endGeometry(), then light().
+ */
+class DeferredRenderer {
+public:
+    /** Texture units of the G-buffer during light(), next to the material texture on unit 0 */
+    static constexpr GLint ALBEDO_TEXTURE_UNIT = 1;
+    static constexpr GLint NORMAL_TEXTURE_UNIT = 2;
+    static constexpr GLint DEPTH_TEXTURE_UNIT = 3;
+    static constexpr size_t BYTES_PER_PIXEL = 12;
+    /** Internal formats of the G-buffer targets */
+    static constexpr GLenum ALBEDO_FORMAT = GL_RGBA8;
+    static constexpr GLenum NORMAL_FORMAT = GL_RG16;
+    static constexpr GLenum DEPTH_FORMAT = GL_DEPTH24_STENCIL8;
+
+    DeferredRenderer() = default;
+    DeferredRenderer(const DeferredRenderer &) = delete;
+    DeferredRenderer &operator=(const DeferredRenderer &) = delete;
+    ~DeferredRenderer();
+
+    /** Loads the programs and creates the G-buffer
+     *
+     *  @returns false if a program does not link or the G-buffer framebuffer is incomplete
+     */
+    bool create(unsigned int width, unsigned int height);
+    /** Recreates the G-buffer for a new framebuffer size, the render area becomes the whole size */
+    bool resize(unsigned int width, unsigned int height);
+    /** Renders and lights the lower left width x height pixels only (dynamic resolution), the viewport of light() has
+     *  to match it
+     */
+    void setRenderArea(unsigned int width, unsigned int height);
+
+    /** Binds and clears the G-buffer, the framebuffer and viewport of before are restored by endGeometry() */
+    void beginGeometry();
+    void endGeometry();
+
+    /** Lights the G-buffer into the framebuffer bound at beginGeometry()
+     *
+     *  @param[in] inverseViewProjection Column major inverse of projection * view
+     *  @param[in] clusters Lights assigned with the same view and projection, already uploaded
+     *  @param[in] shadows Cascades of the sun rendered this frame, nullptr for no sun shadows
+     */
+    void light(const float inverseViewProjection[16], const float cameraPosition[3], const LightClusters &clusters,
+               const ShadowCascades *shadows = nullptr);
+
+    /** @returns Program of the geometry pass: MVP, M, decode and material uniforms like MeshShader */
+    GLuint geometryProgram() const { return gBufferProgram; }
+    GLuint lightingProgram() const { return lightProgram; }
+
+    /** @returns G-buffer targets, resize() replaces them */
+    GLuint albedoTarget() const { return albedoTexture; }
+    GLuint normalTarget() const { return normalTexture; }
+    GLuint depthTarget() const { return depthTexture; }
+    unsigned int targetWidth() const { return width; }
+    unsigned int targetHeight() const { return height; }
+
+    /** @returns Memory of the G-buffer targets */
+    size_t gBufferBytes() const { return size_t(width) * height * BYTES_PER_PIXEL; }
+
+    void destroy();
+
+private:
+    bool createTargets();
+    void destroyTargets();
+
+    unsigned int width = 0, height = 0;
+    unsigned int areaWidth = 0, areaHeight = 0;
+    GLuint gBufferProgram = 0, lightProgram = 0;
+    GLuint framebuffer = 0;
+    GLuint albedoTexture = 0, normalTexture = 0, depthTexture = 0;
+    GLuint emptyVertexArray = 0;
+    GLint previousFramebuffer = 0;
+    GLint previousViewport[4] = {0, 0, 1, 1};
+};
+
+
+
+#endif //DEFERREDRENDERER_H
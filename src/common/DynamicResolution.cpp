@@ -0,0 +1,72 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#include "DynamicResolution.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // a single frame this far over the target is a spike and lowers the scale without waiting
+    constexpr double SPIKE_RATIO = 1.25;
+    // the smoothed time is aimed at this fraction of the target, it goes up only below RAISE_RATIO
+    constexpr double HEADROOM_RATIO = 0.9;
+    constexpr double RAISE_RATIO = 0.85;
+    // the scale grows by at most this much per check, a wrong guess upwards costs frames
+    constexpr float MAXIMUM_RAISE = 0.05f;
+    constexpr unsigned int CHECK_INTERVAL = 8;
+    constexpr double SMOOTHING = 0.2;
+}
+
+DynamicResolution::DynamicResolution(float targetMilliseconds, float minimumScale, float maximumScale,
+                                     unsigned int measurementLatency)
+    : target(targetMilliseconds), minimumScale(std::clamp(minimumScale, SCALE_STEP, 1.0f)),
+      maximumScale(std::clamp(maximumScale, this->minimumScale, 1.0f)), currentScale(this->maximumScale),
+      latency(measurementLatency) {
+}
+
+bool DynamicResolution::update(double gpuMilliseconds) {
+    if (gpuMilliseconds <= 0.0 || target <= 0.0f) return false;
+    // frames still in flight at the last change were rendered at the old scale
+    if (ignoredFrames > 0) {
+        --ignoredFrames;
+        return false;
+    }
+    float previous = currentScale;
+
+    // the cost per pixel follows the time, the scale the square root of the pixel count
+    if (gpuMilliseconds > target * SPIKE_RATIO) {
+        setScale(currentScale * float(std::sqrt(target * HEADROOM_RATIO / gpuMilliseconds)));
+    } else {
+        smoothedMilliseconds = smoothedMilliseconds > 0.0
+                               ? smoothedMilliseconds + (gpuMilliseconds - smoothedMilliseconds) * SMOOTHING
+                               : gpuMilliseconds;
+        if (++framesSinceCheck < CHECK_INTERVAL) return false;
+        framesSinceCheck = 0;
+        float ideal = currentScale * float(std::sqrt(target * HEADROOM_RATIO / smoothedMilliseconds));
+        if (smoothedMilliseconds > target) setScale(ideal);
+        else if (smoothedMilliseconds < target * RAISE_RATIO) setScale(std::min(ideal, currentScale + MAXIMUM_RAISE));
+    }
+
+    if (currentScale == previous) return false;
+    // measurements of the old scale are no longer meaningful
+    smoothedMilliseconds *= double(currentScale * currentScale) / double(previous * previous);
+    ignoredFrames = latency;
+    framesSinceCheck = 0;
+    return true;
+}
+
+void DynamicResolution::setScale(float scale) {
+    // down to the step below when lowering, so one change is enough for a spike
+    float steps = scale < currentScale ? std::floor(scale / SCALE_STEP) : std::round(scale / SCALE_STEP);
+    currentScale = std::clamp(steps * SCALE_STEP, minimumScale, maximumScale);
+}
+
+void DynamicResolution::renderSize(unsigned int outputWidth, unsigned int outputHeight, unsigned int &width,
+                                   unsigned int &height) const {
+    width = std::max(1u, unsigned(std::lround(float(outputWidth) * currentScale)));
+    height = std::max(1u, unsigned(std::lround(float(outputHeight) * currentScale)));
+    width = std::min(width, outputWidth);
+    height = std::min(height, outputHeight);
+}
@@ -0,0 +1,55 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#ifndef DYNAMICRESOLUTION_H
+#define DYNAMICRESOLUTION_H
+
+
+/** Scales the render resolution to hold a GPU frame time
+ *
+ *  The GPU time of the scene is taken to grow with its pixel count, the square of the scale. update() is fed the
+ *  measured GPU time of every collected frame:
+ *  - a frame far over the target (a load spike) drops the scale at once
+ *  - otherwise a smoothed time is checked every few frames, the scale goes down when it is over the target and up
+ *    in small steps when it is well under it, the band in between keeps the scale from oscillating
+ *  - after a change, frames measured at the old scale (the timer latency) are ignored
+ *
+ *  Scales are quantized to SCALE_STEP, small changes of the measured time leave the render size as it is.
+ */
+class DynamicResolution {
+public:
+    /** @param[in] targetMilliseconds GPU time per frame to hold, e.g. 14 for 60 Hz with headroom */
+    explicit DynamicResolution(float targetMilliseconds, float minimumScale = 0.5f, float maximumScale = 1.0f,
+                               unsigned int measurementLatency = 3);
+
+    void setTarget(float targetMilliseconds) { target = targetMilliseconds; }
+    float targetMilliseconds() const { return target; }
+
+    /** Feeds the GPU time of a finished frame
+     *
+     *  @returns true if the scale changed
+     */
+    bool update(double gpuMilliseconds);
+
+    /** @returns Scale of the width and height of the render area */
+    float scale() const { return currentScale; }
+    /** Size of the render area for an output size, at least 1 x 1 pixels */
+    void renderSize(unsigned int outputWidth, unsigned int outputHeight, unsigned int &width, unsigned int &height) const;
+
+    /** Scale steps: 1/32 of the output size */
+    static constexpr float SCALE_STEP = 1.0f / 32.0f;
+
+private:
+    void setScale(float scale);
+
+    float target, minimumScale, maximumScale;
+    float currentScale;
+    unsigned int latency;
+    double smoothedMilliseconds = 0.0;
+    unsigned int ignoredFrames = 0, framesSinceCheck = 0;
+};
+
+
+
+#endif //DYNAMICRESOLUTION_H
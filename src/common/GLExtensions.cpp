@@ -0,0 +1,65 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#include "GLExtensions.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+GLExtensions::DispatchComputeProc GLExtensions::dispatchCompute = nullptr;
+GLExtensions::MemoryBarrierProc GLExtensions::memoryBarrier = nullptr;
+GLExtensions::DrawArraysIndirectProc GLExtensions::drawArraysIndirect = nullptr;
+GLExtensions::MultiDrawElementsIndirectProc GLExtensions::multiDrawElementsIndirect = nullptr;
+GLExtensions::MultiDrawElementsIndirectCountProc GLExtensions::multiDrawElementsIndirectCount = nullptr;
+GLExtensions::BufferStorageProc GLExtensions::bufferStorageFunction = nullptr;
+GLExtensions::BindImageTextureProc GLExtensions::bindImageTexture = nullptr;
+
+namespace {
+    int contextVersion = 0;
+
+    /** Loads a core entry point if the context version has it, else the extension variant if the extension exists */
+    template<typename Proc>
+    Proc loadFunction(GLADloadfunc load, int coreVersion, const char *coreName, const char *extension, const char *extensionName) {
+        if (contextVersion >= coreVersion) return reinterpret_cast<Proc>(load(coreName));
+        if (extension && GLExtensions::hasExtension(extension)) return reinterpret_cast<Proc>(load(extensionName));
+        return nullptr;
+    }
+}
+
+void GLExtensions::load(GLADloadfunc load) {
+    GLint major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    contextVersion = major * 10 + minor;
+
+    dispatchCompute = loadFunction<DispatchComputeProc>(load, 43, "glDispatchCompute", nullptr, nullptr);
+    memoryBarrier = loadFunction<MemoryBarrierProc>(load, 43, "glMemoryBarrier", nullptr, nullptr);
+    drawArraysIndirect = loadFunction<DrawArraysIndirectProc>(
+            load, 40, "glDrawArraysIndirect", "GL_ARB_draw_indirect", "glDrawArraysIndirect");
+    multiDrawElementsIndirect = loadFunction<MultiDrawElementsIndirectProc>(
+            load, 43, "glMultiDrawElementsIndirect", "GL_ARB_multi_draw_indirect", "glMultiDrawElementsIndirect");
+    multiDrawElementsIndirectCount = loadFunction<MultiDrawElementsIndirectCountProc>(
+            load, 46, "glMultiDrawElementsIndirectCount", "GL_ARB_indirect_parameters", "glMultiDrawElementsIndirectCountARB");
+    bufferStorageFunction = loadFunction<BufferStorageProc>(load, 44, "glBufferStorage", "GL_ARB_buffer_storage", "glBufferStorage");
+    bindImageTexture = loadFunction<BindImageTextureProc>(
+            load, 42, "glBindImageTexture", "GL_ARB_shader_image_load_store", "glBindImageTexture");
+
+    printf("OpenGL %d.%d: compute %s, multi draw indirect %s, indirect count %s, buffer storage %s, image load store %s\n",
+           major, minor, computeShaders() ? "yes" : "no", multiDrawIndirect() ? "yes" : "no",
+           indirectCount() ? "yes" : "no", bufferStorage() ? "yes" : "no", imageLoadStore() ? "yes" : "no");
+}
+
+int GLExtensions::version() {
+    return contextVersion;
+}
+
+bool GLExtensions::hasExtension(const char *name) {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; ++i) {
+        const char *extension = reinterpret_cast<const char *>(glGetStringi(GL_EXTENSIONS, GLuint(i)));
+        if (extension && strcmp(extension, name) == 0) return true;
+    }
+    return false;
+}
@@ -0,0 +1,106 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#ifndef GLEXTENSIONS_H
+#define GLEXTENSIONS_H
+#include <glad/gl.h>
+
+// GL 4.x enums used by the optional render paths, the glad header only covers 3.3
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+#ifndef GL_PARAMETER_BUFFER
+#define GL_PARAMETER_BUFFER 0x80EE
+#endif
+#ifndef GL_SHADER_STORAGE_BUFFER
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#endif
+#ifndef GL_COMPUTE_SHADER
+#define GL_COMPUTE_SHADER 0x91B9
+#endif
+#ifndef GL_TEXTURE_FETCH_BARRIER_BIT
+#define GL_TEXTURE_FETCH_BARRIER_BIT 0x00000008
+#endif
+#ifndef GL_SHADER_IMAGE_ACCESS_BARRIER_BIT
+#define GL_SHADER_IMAGE_ACCESS_BARRIER_BIT 0x00000020
+#endif
+#ifndef GL_FRAMEBUFFER_BARRIER_BIT
+#define GL_FRAMEBUFFER_BARRIER_BIT 0x00000400
+#endif
+#ifndef GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT
+#define GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT 0x00000001
+#endif
+#ifndef GL_COMMAND_BARRIER_BIT
+#define GL_COMMAND_BARRIER_BIT 0x00000040
+#endif
+#ifndef GL_SHADER_STORAGE_BARRIER_BIT
+#define GL_SHADER_STORAGE_BARRIER_BIT 0x00002000
+#endif
+#ifndef GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT
+#define GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT 0x00004000
+#endif
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+#ifndef GL_DYNAMIC_STORAGE_BIT
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#endif
+
+
+/** Entry points above GL 3.3, loaded at runtime because the context may be a 3.3 one (see main.cpp)
+ *
+ *  Every feature query checks the context version and the matching ARB extension, the pointers of missing features
+ *  stay null. Render paths pick their implementation from the queries, e.g. GpuCulling falls back to CPU culling.
+ */
+class GLExtensions {
+public:
+    typedef void (GLAD_API_PTR *DispatchComputeProc)(GLuint groupsX, GLuint groupsY, GLuint groupsZ);
+    typedef void (GLAD_API_PTR *MemoryBarrierProc)(GLbitfield barriers);
+    typedef void (GLAD_API_PTR *DrawArraysIndirectProc)(GLenum mode, const void *indirect);
+    typedef void (GLAD_API_PTR *MultiDrawElementsIndirectProc)(GLenum mode, GLenum type, const void *indirect,
+                                                                GLsizei drawCount, GLsizei stride);
+    typedef void (GLAD_API_PTR *MultiDrawElementsIndirectCountProc)(GLenum mode, GLenum type, const void *indirect,
+                                                                     GLintptr drawCount, GLsizei maxDrawCount, GLsizei stride);
+    typedef void (GLAD_API_PTR *BufferStorageProc)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+    typedef void (GLAD_API_PTR *BindImageTextureProc)(GLuint unit, GLuint texture, GLint level, GLboolean layered,
+                                                      GLint layer, GLenum access, GLenum format);
+
+    /** Queries the context and loads the entry points, call after gladLoadGL with the same loader
+     *
+     *  @param[in] load e.g. glfwGetProcAddress
+     */
+    static void load(GLADloadfunc load);
+
+    /** @returns Context version as major * 10 + minor, e.g. 45 */
+    static int version();
+    static bool hasExtension(const char *name);
+
+    /** glDispatchCompute, glMemoryBarrier and shader storage buffers (4.3) */
+    static bool computeShaders() { return dispatchCompute && memoryBarrier; }
+    /** glDrawArraysIndirect, the draw parameters read from a buffer (4.0 or ARB_draw_indirect) */
+    static bool drawIndirect() { return drawArraysIndirect != nullptr; }
+    /** glMultiDrawElementsIndirect (4.3 or ARB_multi_draw_indirect) */
+    static bool multiDrawIndirect() { return multiDrawElementsIndirect != nullptr; }
+    /** glMultiDrawElementsIndirectCount, draw count read from a buffer (4.6 or ARB_indirect_parameters) */
+    static bool indirectCount() { return multiDrawElementsIndirectCount != nullptr; }
+    /** glBufferStorage, immutable and persistently mappable buffers (4.4 or ARB_buffer_storage) */
+    static bool bufferStorage() { return bufferStorageFunction != nullptr; }
+    /** glBindImageTexture, image load and store in shaders (4.2 or ARB_shader_image_load_store) */
+    static bool imageLoadStore() { return bindImageTexture != nullptr; }
+
+    static DispatchComputeProc dispatchCompute;
+    static MemoryBarrierProc memoryBarrier;
+    static DrawArraysIndirectProc drawArraysIndirect;
+    static MultiDrawElementsIndirectProc multiDrawElementsIndirect;
+    static MultiDrawElementsIndirectCountProc multiDrawElementsIndirectCount;
+    static BufferStorageProc bufferStorageFunction;
+    static BindImageTextureProc bindImageTexture;
+};
+
+
+
+#endif //GLEXTENSIONS_H
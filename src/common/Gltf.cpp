@@ -0,0 +1,545 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#include "Gltf.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+#include "Assets.hpp"
+#include "JobSystem.hpp"
+#include "Json.hpp"
+#include "KTX2Stream.hpp"
+#include "Textures.hpp"
+
+namespace {
+    constexpr uint32_t GLB_MAGIC = 0x46546C67;  // "glTF"
+    constexpr uint32_t CHUNK_JSON = 0x4E4F534A; // "JSON"
+    constexpr uint32_t CHUNK_BIN = 0x004E4942;  // "BIN\0"
+    constexpr unsigned char KTX2_IDENTIFIER[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+    struct BufferView {
+        size_t buffer = 0;
+        size_t offset = 0;
+        const unsigned char *data = nullptr;
+        size_t length = 0;
+        size_t stride = 0; // 0 for tightly packed
+    };
+
+    struct Accessor {
+        int view = -1;
+        size_t offset = 0;
+        GLenum componentType = 0;
+        int components = 0;
+        size_t count = 0;
+        size_t stride = 0;
+        bool normalized = false;
+    };
+
+    enum class ImageKind { Unsupported, BMP, DDS, KTX2 };
+
+    struct PendingImage {
+        std::string name;
+        AssetData source;
+        ImageKind kind = ImageKind::Unsupported;
+        Image pixels;
+        CompressedImage blocks;
+        bool decoded = false;
+        std::unique_ptr<KTX2Stream> stream;
+    };
+
+    uint32_t readUInt32(const unsigned char *in) {
+        uint32_t value;
+        memcpy(&value, in, 4);
+        return value;
+    }
+
+    bool decodeBase64(const char *text, size_t length, std::vector<unsigned char> &out) {
+        auto value = [](char c) -> int {
+            if (c >= 'A' && c <= 'Z') return c - 'A';
+            if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+            if (c >= '0' && c <= '9') return c - '0' + 52;
+            if (c == '+' || c == '-') return 62;
+            if (c == '/' || c == '_') return 63;
+            return -1;
+        };
+        out.clear();
+        out.reserve(length / 4 * 3);
+        unsigned int bits = 0;
+        int bitCount = 0;
+        for (size_t i = 0; i < length && text[i] != '='; ++i) {
+            int v = value(text[i]);
+            if (v < 0) return false;
+            bits = (bits << 6) | unsigned(v);
+            bitCount += 6;
+            if (bitCount >= 8) {
+                bitCount -= 8;
+                out.push_back((unsigned char)((bits >> bitCount) & 0xFF));
+            }
+        }
+        return true;
+    }
+
+    /** Resolves a buffer or image uri: data URIs are decoded, everything else is a path relative to the file */
+    bool openUri(const std::string &uri, const std::string &directory, AssetData &data) {
+        if (uri.compare(0, 5, "data:") == 0) {
+            size_t marker = uri.find(";base64,");
+            if (marker == std::string::npos) return false;
+            std::vector<unsigned char> bytes;
+            if (!decodeBase64(uri.data() + marker + 8, uri.size() - marker - 8, bytes)) return false;
+            data = AssetData::fromBuffer(std::move(bytes));
+            return true;
+        }
+
+        // undo the percent encoding of the relative path
+        std::string path = directory;
+        for (size_t i = 0; i < uri.size(); ++i) {
+            if (uri[i] == '%' && i + 2 < uri.size()) {
+                path += char(strtol(uri.substr(i + 1, 2).c_str(), nullptr, 16));
+                i += 2;
+            } else {
+                path += uri[i];
+            }
+        }
+        return Assets::open(path.c_str(), data);
+    }
+
+    size_t componentSize(GLenum type) {
+        switch (type) {
+            case GL_BYTE: case GL_UNSIGNED_BYTE: return 1;
+            case GL_SHORT: case GL_UNSIGNED_SHORT: return 2;
+            case GL_UNSIGNED_INT: case GL_FLOAT: return 4;
+            default: return 0;
+        }
+    }
+
+    int componentCount(const std::string &type) {
+        if (type == "SCALAR") return 1;
+        if (type == "VEC2") return 2;
+        if (type == "VEC3") return 3;
+        if (type == "VEC4" || type == "MAT2") return 4;
+        if (type == "MAT3") return 9;
+        if (type == "MAT4") return 16;
+        return 0;
+    }
+
+    /** Validates an accessor against its buffer view, false if it is unusable for a vertex or index buffer */
+    bool resolveAccessor(const JsonValue &json, const std::vector<BufferView> &views, Accessor &accessor) {
+        if (!json.isObject() || json.contains("sparse")) return false;
+        accessor.view = json["bufferView"].asInt(-1);
+        accessor.offset = size_t(json["byteOffset"].asNumber(0));
+        accessor.componentType = GLenum(json["componentType"].asInt());
+        accessor.components = componentCount(json["type"].asString());
+        accessor.count = size_t(json["count"].asNumber(0));
+        accessor.normalized = json["normalized"].asBool();
+        if (accessor.view < 0 || size_t(accessor.view) >= views.size() || accessor.components == 0 ||
+            componentSize(accessor.componentType) == 0 || accessor.count == 0)
+            return false;
+
+        const BufferView &view = views[accessor.view];
+        size_t elementSize = componentSize(accessor.componentType) * accessor.components;
+        accessor.stride = view.stride ? view.stride : elementSize;
+        return accessor.offset <= view.length && elementSize <= view.length - accessor.offset &&
+               (accessor.count - 1) <= (view.length - accessor.offset - elementSize) / accessor.stride;
+    }
+
+    /** out = a * b, column major 4x4 */
+    void multiply(const float *a, const float *b, float *out) {
+        float result[16];
+        for (int column = 0; column < 4; ++column) {
+            for (int row = 0; row < 4; ++row) {
+                float sum = 0;
+                for (int k = 0; k < 4; ++k) sum += a[k * 4 + row] * b[column * 4 + k];
+                result[column * 4 + row] = sum;
+            }
+        }
+        memcpy(out, result, sizeof(result));
+    }
+
+    void localMatrix(const JsonValue &node, float *out) {
+        const JsonValue &matrix = node["matrix"];
+        if (matrix.size() == 16) {
+            for (unsigned int i = 0; i < 16; ++i) out[i] = float(matrix[i].asNumber());
+            return;
+        }
+
+        // T * R * S
+        float t[3] = {0, 0, 0}, r[4] = {0, 0, 0, 1}, s[3] = {1, 1, 1};
+        for (unsigned int i = 0; i < 3; ++i) t[i] = float(node["translation"][i].asNumber(t[i]));
+        for (unsigned int i = 0; i < 4; ++i) r[i] = float(node["rotation"][i].asNumber(r[i]));
+        for (unsigned int i = 0; i < 3; ++i) s[i] = float(node["scale"][i].asNumber(s[i]));
+        float x = r[0], y = r[1], z = r[2], w = r[3];
+        float rotation[9] = {
+            1 - 2 * (y * y + z * z), 2 * (x * y + z * w), 2 * (x * z - y * w),
+            2 * (x * y - z * w), 1 - 2 * (x * x + z * z), 2 * (y * z + x * w),
+            2 * (x * z + y * w), 2 * (y * z - x * w), 1 - 2 * (x * x + y * y)
+        };
+        for (int column = 0; column < 3; ++column) {
+            for (int row = 0; row < 3; ++row) out[column * 4 + row] = rotation[column * 3 + row] * s[column];
+            out[column * 4 + 3] = 0;
+        }
+        out[12] = t[0];
+        out[13] = t[1];
+        out[14] = t[2];
+        out[15] = 1;
+    }
+
+    ImageKind imageKind(const std::string &mimeType, const AssetData &data) {
+        if (mimeType == "image/vnd-ms.dds") return ImageKind::DDS;
+        if (mimeType == "image/ktx2") return ImageKind::KTX2;
+        if (mimeType == "image/bmp") return ImageKind::BMP;
+        // external files carry no mime type, look at the content
+        if (data.size() >= 4 && memcmp(data.data(), "DDS ", 4) == 0) return ImageKind::DDS;
+        if (data.size() >= 12 && memcmp(data.data(), KTX2_IDENTIFIER, 12) == 0) return ImageKind::KTX2;
+        if (data.size() >= 2 && data.data()[0] == 'B' && data.data()[1] == 'M') return ImageKind::BMP;
+        return ImageKind::Unsupported;
+    }
+
+    void parseMaterial(const JsonValue &json, size_t textureCount, GltfMaterial &material) {
+        auto texture = [textureCount](const JsonValue &info) {
+            int index = info["index"].asInt(-1);
+            return index >= 0 && size_t(index) < textureCount ? index : -1;
+        };
+        const JsonValue &pbr = json["pbrMetallicRoughness"];
+
+        material.name = json["name"].asString();
+        for (unsigned int i = 0; i < 4; ++i) material.baseColorFactor[i] = float(pbr["baseColorFactor"][i].asNumber(1.0));
+        for (unsigned int i = 0; i < 3; ++i) material.emissiveFactor[i] = float(json["emissiveFactor"][i].asNumber(0.0));
+        material.metallicFactor = float(pbr["metallicFactor"].asNumber(1.0));
+        material.roughnessFactor = float(pbr["roughnessFactor"].asNumber(1.0));
+        material.baseColorTexture = texture(pbr["baseColorTexture"]);
+        material.metallicRoughnessTexture = texture(pbr["metallicRoughnessTexture"]);
+        material.normalTexture = texture(json["normalTexture"]);
+        material.occlusionTexture = texture(json["occlusionTexture"]);
+        material.emissiveTexture = texture(json["emissiveTexture"]);
+        const std::string &alphaMode = json["alphaMode"].asString();
+        material.alphaMode = alphaMode == "MASK" ? GltfMaterial::AlphaMode::Mask
+                           : alphaMode == "BLEND" ? GltfMaterial::AlphaMode::Blend : GltfMaterial::AlphaMode::Opaque;
+        material.alphaCutoff = float(json["alphaCutoff"].asNumber(0.5));
+        material.doubleSided = json["doubleSided"].asBool();
+    }
+}
+
+bool Gltf::load(const char *filename, GltfScene &scene) {
+    destroy(scene);
+
+    AssetData file;
+    if (!Assets::open(filename, file)) {printf("Model file could not be opened\n"); return false;}
+    std::string path(filename);
+    size_t separator = path.find_last_of("/\\");
+    std::string directory = separator == std::string::npos ? std::string() : path.substr(0, separator + 1);
+
+    // .glb: 12 byte header, JSON chunk, optional BIN chunk; everything else is treated as .gltf text
+    const char *jsonText = reinterpret_cast<const char *>(file.data());
+    size_t jsonLength = file.size();
+    AssetData binaryChunk;
+    if (file.size() >= 12 && readUInt32(file.data()) == GLB_MAGIC) {
+        const unsigned char *data = file.data();
+        size_t length = std::min(size_t(readUInt32(data + 8)), file.size());
+        if (readUInt32(data + 4) != 2 || length < 20 || readUInt32(data + 16) != CHUNK_JSON ||
+            readUInt32(data + 12) > length - 20) {
+            printf("Not a valid glTF 2.0 binary file\n");
+            return false;
+        }
+        jsonText = reinterpret_cast<const char *>(data + 20);
+        jsonLength = readUInt32(data + 12);
+        size_t binaryOffset = 20 + ((jsonLength + 3) & ~size_t(3));
+        if (binaryOffset + 8 <= length && readUInt32(data + binaryOffset + 4) == CHUNK_BIN) {
+            size_t binaryLength = std::min(size_t(readUInt32(data + binaryOffset)), length - binaryOffset - 8);
+            binaryChunk = file.slice(binaryOffset + 8, binaryLength);
+        }
+    }
+
+    JsonValue json;
+    if (!JsonValue::parse(jsonText, jsonLength, json) || !json.isObject()) {
+        printf("%s: invalid glTF JSON\n", filename);
+        return false;
+    }
+    if (json["asset"]["version"].asString().compare(0, 2, "2.") != 0) {
+        printf("%s: only glTF 2.0 is supported\n", filename);
+        return false;
+    }
+    for (size_t i = 0; i < json["extensionsRequired"].size(); ++i) {
+        const std::string &extension = json["extensionsRequired"][i].asString();
+        if (extension != "MSFT_texture_dds" && extension != "KHR_materials_emissive_strength")
+            printf("%s: required extension %s is ignored\n", filename, extension.c_str());
+    }
+
+    // buffers stay mapped until the load finished, views point into them
+    const JsonValue &buffersJson = json["buffers"];
+    std::vector<AssetData> buffers(buffersJson.size());
+    for (size_t i = 0; i < buffers.size(); ++i) {
+        const JsonValue &buffer = buffersJson[i];
+        bool opened = buffer.contains("uri") ? openUri(buffer["uri"].asString(), directory, buffers[i])
+                                             : (buffers[i] = binaryChunk, !binaryChunk.empty());
+        if (!opened || buffers[i].size() < size_t(buffer["byteLength"].asNumber())) {
+            printf("%s: buffer %zu could not be loaded\n", filename, i);
+            return false;
+        }
+    }
+
+    const JsonValue &viewsJson = json["bufferViews"];
+    std::vector<BufferView> views(viewsJson.size());
+    for (size_t i = 0; i < views.size(); ++i) {
+        const JsonValue &view = viewsJson[i];
+        size_t buffer = size_t(view["buffer"].asInt(-1));
+        size_t offset = size_t(view["byteOffset"].asNumber(0));
+        size_t length = size_t(view["byteLength"].asNumber(0));
+        if (buffer >= buffers.size() || offset > buffers[buffer].size() || length > buffers[buffer].size() - offset) {
+            printf("%s: buffer view %zu is out of range\n", filename, i);
+            return false;
+        }
+        views[i] = {buffer, offset, buffers[buffer].data() + offset, length, size_t(view["byteStride"].asNumber(0))};
+    }
+
+    // start decoding the images right away, they are the slowest part
+    const JsonValue &imagesJson = json["images"];
+    std::vector<PendingImage> images(imagesJson.size());
+    JobCounter imagesDecoded;
+    for (size_t i = 0; i < images.size(); ++i) {
+        const JsonValue &image = imagesJson[i];
+        PendingImage &pending = images[i];
+        pending.name = image.contains("uri") ? image["uri"].asString().substr(0, 64) : "image " + std::to_string(i);
+        bool opened;
+        if (image.contains("uri")) {
+            opened = openUri(image["uri"].asString(), directory, pending.source);
+        } else {
+            size_t view = size_t(image["bufferView"].asInt(-1));
+            opened = view < views.size();
+            if (opened) pending.source = buffers[views[view].buffer].slice(views[view].offset, views[view].length);
+        }
+        if (!opened) {
+            printf("%s: %s could not be opened\n", filename, pending.name.c_str());
+            continue;
+        }
+
+        pending.kind = imageKind(image["mimeType"].asString(), pending.source);
+        switch (pending.kind) {
+            case ImageKind::BMP:
+                JobSystem::submit([&pending] { pending.decoded = Textures::decodeBMP(pending.source, pending.pixels); }, &imagesDecoded);
+                break;
+            case ImageKind::DDS:
+                JobSystem::submit([&pending] { pending.decoded = Textures::decodeDDS(pending.source, pending.blocks); }, &imagesDecoded);
+                break;
+            case ImageKind::KTX2:
+                // the stream decodes its levels on the workers by itself
+                pending.stream = std::make_unique<KTX2Stream>();
+                pending.decoded = pending.stream->open(pending.source, pending.name.c_str());
+                break;
+            default:
+                printf("%s: %s is not a .dds, .ktx2 or .bmp image and is skipped\n", filename, pending.name.c_str());
+                break;
+        }
+    }
+
+    // accessors referenced by the meshes decide which buffer views become GL buffers
+    const JsonValue &accessorsJson = json["accessors"];
+    std::vector<Accessor> accessors(accessorsJson.size());
+    std::vector<bool> accessorValid(accessors.size());
+    for (size_t i = 0; i < accessors.size(); ++i) accessorValid[i] = resolveAccessor(accessorsJson[i], views, accessors[i]);
+
+    static const char *const ATTRIBUTES[] = {"POSITION", "TEXCOORD_0", "NORMAL", "TANGENT", "COLOR_0", "JOINTS_0", "WEIGHTS_0"};
+    const JsonValue &meshesJson = json["meshes"];
+    scene.buffers.assign(views.size(), 0);
+    for (size_t m = 0; m < meshesJson.size(); ++m) {
+        const JsonValue &primitives = meshesJson[m]["primitives"];
+        for (size_t p = 0; p < primitives.size(); ++p) {
+            const JsonValue &primitive = primitives[p];
+            std::vector<int> used;
+            for (const char *attribute : ATTRIBUTES) used.push_back(primitive["attributes"][attribute].asInt(-1));
+            used.push_back(primitive["indices"].asInt(-1));
+            for (int accessor : used) {
+                if (accessor < 0 || size_t(accessor) >= accessors.size() || !accessorValid[accessor]) continue;
+                GLuint &buffer = scene.buffers[accessors[accessor].view];
+                if (buffer) continue;
+
+                // straight from the mapped file into the driver
+                const BufferView &view = views[accessors[accessor].view];
+                glGenBuffers(1, &buffer);
+                glBindBuffer(GL_ARRAY_BUFFER, buffer);
+                glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(view.length), view.data, GL_STATIC_DRAW);
+            }
+        }
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    scene.meshes.resize(meshesJson.size());
+    for (size_t m = 0; m < meshesJson.size(); ++m) {
+        GltfMesh &mesh = scene.meshes[m];
+        mesh.name = meshesJson[m]["name"].asString();
+        const JsonValue &primitives = meshesJson[m]["primitives"];
+        for (size_t p = 0; p < primitives.size(); ++p) {
+            const JsonValue &primitiveJson = primitives[p];
+            int positionIndex = primitiveJson["attributes"]["POSITION"].asInt(-1);
+            if (positionIndex < 0 || size_t(positionIndex) >= accessors.size() || !accessorValid[positionIndex]) {
+                printf("%s: primitive %zu of mesh %zu has no usable positions\n", filename, p, m);
+                continue;
+            }
+
+            GltfPrimitive primitive;
+            primitive.mode = GLenum(primitiveJson["mode"].asInt(GL_TRIANGLES));
+            primitive.material = primitiveJson["material"].asInt(-1);
+            const JsonValue &positionJson = accessorsJson[size_t(positionIndex)];
+            for (unsigned int i = 0; i < 3; ++i) {
+                primitive.boundsMin[i] = float(positionJson["min"][i].asNumber());
+                primitive.boundsMax[i] = float(positionJson["max"][i].asNumber());
+            }
+
+            glGenVertexArrays(1, &primitive.vertexArray);
+            glBindVertexArray(primitive.vertexArray);
+            for (GLuint location = 0; location < sizeof(ATTRIBUTES) / sizeof(ATTRIBUTES[0]); ++location) {
+                int index = primitiveJson["attributes"][ATTRIBUTES[location]].asInt(-1);
+                if (index < 0 || size_t(index) >= accessors.size() || !accessorValid[index]) continue;
+                const Accessor &accessor = accessors[index];
+                glBindBuffer(GL_ARRAY_BUFFER, scene.buffers[accessor.view]);
+                glEnableVertexAttribArray(location);
+                const void *offset = reinterpret_cast<const void *>(accessor.offset);
+                bool integer = location == 5 && accessor.componentType != GL_FLOAT && !accessor.normalized;
+                if (integer) glVertexAttribIPointer(location, accessor.components, accessor.componentType, GLsizei(accessor.stride), offset);
+                else glVertexAttribPointer(location, accessor.components, accessor.componentType, accessor.normalized, GLsizei(accessor.stride), offset);
+            }
+
+            int indices = primitiveJson["indices"].asInt(-1);
+            if (indices >= 0 && size_t(indices) < accessors.size() && accessorValid[indices] &&
+                accessors[indices].components == 1 && accessors[indices].componentType != GL_FLOAT) {
+                const Accessor &accessor = accessors[indices];
+                glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, scene.buffers[accessor.view]);
+                primitive.indexType = accessor.componentType;
+                primitive.indexOffset = accessor.offset;
+                primitive.count = GLsizei(accessor.count);
+            } else {
+                primitive.count = GLsizei(accessors[positionIndex].count);
+            }
+            glBindVertexArray(0);
+            mesh.primitives.push_back(primitive);
+        }
+    }
+
+    // samplers, the last one is the default for textures without a sampler
+    const JsonValue &samplersJson = json["samplers"];
+    scene.samplers.resize(samplersJson.size() + 1);
+    glGenSamplers(GLsizei(scene.samplers.size()), scene.samplers.data());
+    for (size_t i = 0; i < scene.samplers.size(); ++i) {
+        const JsonValue &sampler = samplersJson[i];
+        glSamplerParameteri(scene.samplers[i], GL_TEXTURE_MAG_FILTER, sampler["magFilter"].asInt(GL_LINEAR));
+        glSamplerParameteri(scene.samplers[i], GL_TEXTURE_MIN_FILTER, sampler["minFilter"].asInt(GL_LINEAR_MIPMAP_LINEAR));
+        glSamplerParameteri(scene.samplers[i], GL_TEXTURE_WRAP_S, sampler["wrapS"].asInt(GL_REPEAT));
+        glSamplerParameteri(scene.samplers[i], GL_TEXTURE_WRAP_T, sampler["wrapT"].asInt(GL_REPEAT));
+    }
+
+    // the node hierarchy, world matrices are resolved from the roots down
+    const JsonValue &nodesJson = json["nodes"];
+    scene.nodes.resize(nodesJson.size());
+    for (size_t i = 0; i < scene.nodes.size(); ++i) {
+        GltfNode &node = scene.nodes[i];
+        node.name = nodesJson[i]["name"].asString();
+        node.mesh = nodesJson[i]["mesh"].asInt(-1);
+        if (node.mesh >= int(scene.meshes.size())) node.mesh = -1;
+        localMatrix(nodesJson[i], node.local);
+        const JsonValue &children = nodesJson[i]["children"];
+        for (size_t c = 0; c < children.size(); ++c) {
+            int child = children[c].asInt(-1);
+            if (child < 0 || size_t(child) >= scene.nodes.size() || size_t(child) == i) continue;
+            node.children.push_back(child);
+        }
+    }
+    for (size_t i = 0; i < scene.nodes.size(); ++i) {
+        for (int child : scene.nodes[i].children) {
+            if (scene.nodes[child].parent != -1) {
+                printf("%s: node %d has more than one parent\n", filename, child);
+                // the decode jobs write into images and the counter, both live on this stack frame
+                JobSystem::wait(imagesDecoded);
+                // the KTX2 streams created their textures in open(), the scene deletes them with the rest
+                scene.images.assign(images.size(), 0);
+                for (size_t image = 0; image < images.size(); ++image)
+                    if (images[image].stream) scene.images[image] = images[image].stream->texture();
+                destroy(scene);
+                return false;
+            }
+            scene.nodes[child].parent = int(i);
+        }
+    }
+    const JsonValue &sceneNodes = json["scenes"][json["scene"].asInt(0)]["nodes"];
+    for (size_t i = 0; i < sceneNodes.size(); ++i) {
+        int node = sceneNodes[i].asInt(-1);
+        if (node >= 0 && size_t(node) < scene.nodes.size() && scene.nodes[node].parent == -1) scene.roots.push_back(node);
+    }
+    if (!json.contains("scenes")) {
+        for (size_t i = 0; i < scene.nodes.size(); ++i)
+            if (scene.nodes[i].parent == -1) scene.roots.push_back(int(i));
+    }
+    std::vector<int> stack;
+    for (size_t i = 0; i < scene.nodes.size(); ++i) {
+        if (scene.nodes[i].parent != -1) continue;
+        memcpy(scene.nodes[i].world, scene.nodes[i].local, sizeof(scene.nodes[i].world));
+        stack.push_back(int(i));
+        while (!stack.empty()) {
+            const GltfNode &parent = scene.nodes[stack.back()];
+            stack.pop_back();
+            for (int child : parent.children) {
+                multiply(parent.world, scene.nodes[child].local, scene.nodes[child].world);
+                stack.push_back(child);
+            }
+        }
+    }
+
+    // images are created once their decode jobs are done
+    JobSystem::wait(imagesDecoded);
+    scene.images.assign(images.size(), 0);
+    for (size_t i = 0; i < images.size(); ++i) {
+        PendingImage &image = images[i];
+        if (!image.decoded) continue;
+        switch (image.kind) {
+            case ImageKind::BMP: scene.images[i] = Textures::createTexture(image.pixels); break;
+            case ImageKind::DDS: scene.images[i] = Textures::createTexture(image.blocks); break;
+            case ImageKind::KTX2:
+                image.stream->upload(0, true);
+                scene.images[i] = image.stream->texture();
+                break;
+            default: break;
+        }
+    }
+
+    // textures pair an image with a sampler, MSFT_texture_dds points at the .dds variant of an image
+    const JsonValue &texturesJson = json["textures"];
+    scene.textures.resize(texturesJson.size());
+    for (size_t i = 0; i < scene.textures.size(); ++i) {
+        const JsonValue &texture = texturesJson[i];
+        int source = texture["extensions"]["MSFT_texture_dds"]["source"].asInt(texture["source"].asInt(-1));
+        int sampler = texture["sampler"].asInt(-1);
+        if (source >= 0 && size_t(source) < scene.images.size()) scene.textures[i].texture = scene.images[source];
+        scene.textures[i].sampler = sampler >= 0 && size_t(sampler) < samplersJson.size() ? scene.samplers[sampler] : scene.samplers.back();
+    }
+
+    const JsonValue &materialsJson = json["materials"];
+    scene.materials.resize(materialsJson.size());
+    for (size_t i = 0; i < scene.materials.size(); ++i) parseMaterial(materialsJson[i], scene.textures.size(), scene.materials[i]);
+    for (GltfMesh &mesh : scene.meshes) {
+        for (GltfPrimitive &primitive : mesh.primitives)
+            if (primitive.material >= int(scene.materials.size())) primitive.material = -1;
+    }
+    return true;
+}
+
+void Gltf::draw(const GltfPrimitive &primitive) {
+    glBindVertexArray(primitive.vertexArray);
+    if (primitive.indexType) {
+        glDrawElements(primitive.mode, primitive.count, primitive.indexType, reinterpret_cast<const void *>(primitive.indexOffset));
+    } else {
+        glDrawArrays(primitive.mode, 0, primitive.count);
+    }
+}
+
+void Gltf::destroy(GltfScene &scene) {
+    for (GltfMesh &mesh : scene.meshes) {
+        for (GltfPrimitive &primitive : mesh.primitives) glDeleteVertexArrays(1, &primitive.vertexArray);
+    }
+    for (GLuint buffer : scene.buffers) if (buffer) glDeleteBuffers(1, &buffer);
+    for (GLuint image : scene.images) if (image) glDeleteTextures(1, &image);
+    if (!scene.samplers.empty()) glDeleteSamplers(GLsizei(scene.samplers.size()), scene.samplers.data());
+    scene = GltfScene();
+}
@@ -0,0 +1,108 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#ifndef GLTF_H
+#define GLTF_H
+#include <glad/gl.h>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+
+/** One draw call of a glTF mesh
+ *
+ *  Attribute locations: 0 POSITION, 1 TEXCOORD_0, 2 NORMAL (like Meshes::upload), 3 TANGENT, 4 COLOR_0,
+ *  5 JOINTS_0 (integer attribute), 6 WEIGHTS_0
+ */
+struct GltfPrimitive {
+    GLuint vertexArray = 0;
+    GLenum mode = GL_TRIANGLES;
+    GLsizei count = 0;          // number of indices, or vertices for non indexed primitives
+    GLenum indexType = 0;       // GL_UNSIGNED_BYTE/SHORT/INT, 0 for non indexed primitives
+    size_t indexOffset = 0;     // byte offset into the element buffer
+    int material = -1;          // index into GltfScene::materials, -1 for the default material
+    float boundsMin[3] = {0, 0, 0};
+    float boundsMax[3] = {0, 0, 0};
+};
+
+struct GltfMesh {
+    std::string name;
+    std::vector<GltfPrimitive> primitives;
+};
+
+/** Texture reference of a material: GL texture plus the sampler object of the glTF sampler */
+struct GltfTexture {
+    GLuint texture = 0;
+    GLuint sampler = 0;
+};
+
+/** Metallic roughness material, texture members are indices into GltfScene::textures or -1 */
+struct GltfMaterial {
+    enum class AlphaMode { Opaque, Mask, Blend };
+
+    std::string name;
+    float baseColorFactor[4] = {1, 1, 1, 1};
+    float metallicFactor = 1.0f;
+    float roughnessFactor = 1.0f;
+    float emissiveFactor[3] = {0, 0, 0};
+    int baseColorTexture = -1;
+    int metallicRoughnessTexture = -1;
+    int normalTexture = -1;
+    int occlusionTexture = -1;
+    int emissiveTexture = -1;
+    AlphaMode alphaMode = AlphaMode::Opaque;
+    float alphaCutoff = 0.5f;
+    bool doubleSided = false;
+};
+
+/** Scene graph node, matrices are column major like OpenGL expects them */
+struct GltfNode {
+    std::string name;
+    int parent = -1;
+    std::vector<int> children;
+    int mesh = -1;
+    float local[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+    float world[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+};
+
+/** GPU resident glTF scene, owns every GL object in it (release with Gltf::destroy) */
+struct GltfScene {
+    std::vector<GLuint> buffers;     // one per buffer view that holds geometry, 0 for the others
+    std::vector<GLuint> images;      // one per image, 0 if it could not be loaded
+    std::vector<GLuint> samplers;    // one per sampler plus the default sampler at the end
+    std::vector<GltfTexture> textures;
+    std::vector<GltfMaterial> materials;
+    std::vector<GltfMesh> meshes;
+    std::vector<GltfNode> nodes;
+    std::vector<int> roots;          // root nodes of the default scene
+};
+
+/** glTF 2.0 loader for .glb and .gltf files
+ *
+ *  The file (and external .bin buffers) are memory mapped through Assets, buffer views holding vertex or index
+ *  data are handed to glBufferData straight from the mapping without an intermediate copy. Images are decoded
+ *  through Textures on the JobSystem workers while the geometry is uploaded.
+ *
+ *  Images have to be .dds, .ktx2 or .bmp (external files, data URIs or buffer views), PNG/JPEG images are skipped.
+ *  Sparse accessors and morph targets are not supported.
+ */
+class Gltf {
+public:
+    /** Loads a scene and creates all GL objects
+     *
+     *  @param[in] filename The path to the .glb or .gltf file
+     *  @param[out] scene Meshes, materials, textures and the node hierarchy with world matrices
+     *  @returns false if the file is not valid glTF 2.0 or references missing buffers
+     */
+    static bool load(const char *filename, GltfScene &scene);
+
+    /** Issues the draw call of a primitive, the caller binds program, uniforms and textures */
+    static void draw(const GltfPrimitive &primitive);
+
+    static void destroy(GltfScene &scene);
+};
+
+
+
+#endif //GLTF_H
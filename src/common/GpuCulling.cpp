@@ -0,0 +1,221 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#include "GpuCulling.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "GLExtensions.hpp"
+#include "shader.hpp"
+
+namespace {
+    /** Layout of DrawElementsIndirectCommand */
+    struct IndirectCommand {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint baseVertex;
+        GLuint baseInstance;
+    };
+
+    constexpr GLuint LOCAL_SIZE = 64; // local_size_x of CullObjects.comp
+
+    void multiply(const float a[16], const float b[16], float result[16]) {
+        for (int column = 0; column < 4; ++column) {
+            for (int row = 0; row < 4; ++row) {
+                float sum = 0.0f;
+                for (int k = 0; k < 4; ++k) sum += a[k * 4 + row] * b[column * 4 + k];
+                result[column * 4 + row] = sum;
+            }
+        }
+    }
+
+    /** false if all corners of the box are outside one clip plane, like isVisible() in CullObjects.comp */
+    bool insideFrustum(const float transform[16], const float boundsMin[3], const float boundsMax[3]) {
+        int below[3] = {0, 0, 0}, above[3] = {0, 0, 0};
+        for (int corner = 0; corner < 8; ++corner) {
+            float p[3] = {corner & 1 ? boundsMax[0] : boundsMin[0], corner & 2 ? boundsMax[1] : boundsMin[1],
+                          corner & 4 ? boundsMax[2] : boundsMin[2]};
+            float clip[4];
+            for (int row = 0; row < 4; ++row)
+                clip[row] = transform[row] * p[0] + transform[4 + row] * p[1] + transform[8 + row] * p[2] + transform[12 + row];
+            for (int axis = 0; axis < 3; ++axis) {
+                below[axis] += clip[axis] < -clip[3];
+                above[axis] += clip[axis] > clip[3];
+            }
+        }
+        for (int axis = 0; axis < 3; ++axis) if (below[axis] == 8 || above[axis] == 8) return false;
+        return true;
+    }
+
+    GLuint createBuffer(GLenum target, GLsizeiptr size, const void *data, GLenum usage) {
+        GLuint buffer;
+        glGenBuffers(1, &buffer);
+        glBindBuffer(target, buffer);
+        glBufferData(target, size, data, usage);
+        return buffer;
+    }
+}
+
+GpuCulling::~GpuCulling() {
+    destroy();
+}
+
+bool GpuCulling::initialize(GLuint array, GLenum type, const std::vector<CullMesh> &meshList,
+                            const std::vector<CullObject> &objectList, bool allowGpu) {
+    destroy();
+    vertexArray = array;
+    indexType = type;
+    meshes = meshList;
+    objects = objectList;
+    for (const CullObject &object : objects) {
+        if (object.mesh >= meshes.size()) {printf("Culled object refers to mesh %u of %zu\n", object.mesh, meshes.size()); return false;}
+    }
+
+    if (allowGpu && GLExtensions::computeShaders() && GLExtensions::multiDrawIndirect() && !objects.empty()) {
+        cullProgram = LoadComputeShader("src/shaders/CullObjects.comp");
+        if (cullProgram && !createGpuBuffers()) {
+            printf("Culling buffers could not be created\n");
+            destroy();
+            glBindVertexArray(vertexArray);
+            glDisableVertexAttribArray(OBJECT_INDEX_LOCATION);
+            glBindVertexArray(0);
+        }
+    }
+    printf("Culling %zu objects on the %s\n", objects.size(), gpuPath() ? "GPU" : "CPU");
+    return true;
+}
+
+bool GpuCulling::createGpuBuffers() {
+    while (glGetError() != GL_NO_ERROR) {}
+    objectBuffer = createBuffer(GL_SHADER_STORAGE_BUFFER, GLsizeiptr(objects.size() * sizeof(CullObject)), objects.data(), GL_DYNAMIC_DRAW);
+    meshBuffer = createBuffer(GL_SHADER_STORAGE_BUFFER, GLsizeiptr(meshes.size() * sizeof(CullMesh)), meshes.data(), GL_STATIC_DRAW);
+    commandBuffer = createBuffer(GL_SHADER_STORAGE_BUFFER, GLsizeiptr(objects.size() * sizeof(IndirectCommand)), nullptr, GL_DYNAMIC_COPY);
+    instanceBuffer = createBuffer(GL_SHADER_STORAGE_BUFFER, GLsizeiptr(objects.size() * sizeof(GLuint)), nullptr, GL_DYNAMIC_COPY);
+    counterBuffer = createBuffer(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    // the instance attribute starts at baseInstance, so instance i of command n reads instances[n]
+    glBindVertexArray(vertexArray);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    glEnableVertexAttribArray(OBJECT_INDEX_LOCATION);
+    glVertexAttribIPointer(OBJECT_INDEX_LOCATION, 1, GL_UNSIGNED_INT, sizeof(GLuint), nullptr);
+    glVertexAttribDivisor(OBJECT_INDEX_LOCATION, 1);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return glGetError() == GL_NO_ERROR;
+}
+
+void GpuCulling::setTransform(size_t object, const float model[16]) {
+    if (object >= objects.size()) return;
+    std::copy(model, model + 16, objects[object].model);
+    if (!gpuPath()) return;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, objectBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, GLintptr(object * sizeof(CullObject)), sizeof(objects[object].model), model);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void GpuCulling::setOcclusion(const OcclusionCuller *culler) {
+    occlusion = culler;
+    if (!gpuPath() || !culler) return;
+
+    if (!hizTexture) glGenTextures(1, &hizTexture);
+    glBindTexture(GL_TEXTURE_2D, hizTexture);
+    // the pyramid rounds sizes up, GL mip chains round down: stop at the first level GL would consider incomplete
+    size_t levels = 1;
+    while (levels < culler->levelCount() &&
+           culler->levelWidth(levels) == std::max(1u, culler->levelWidth(levels - 1) / 2) &&
+           culler->levelHeight(levels) == std::max(1u, culler->levelHeight(levels - 1) / 2)) ++levels;
+    for (size_t level = 0; level < levels; ++level) {
+        glTexImage2D(GL_TEXTURE_2D, GLint(level), GL_R32F, GLsizei(culler->levelWidth(level)),
+                     GLsizei(culler->levelHeight(level)), 0, GL_RED, GL_FLOAT, culler->level(level));
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, GLint(levels - 1));
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void GpuCulling::draw(const float viewProjection[16], GLuint program) {
+    if (objects.empty()) return;
+    if (gpuPath()) drawGpu(viewProjection, program);
+    else drawCpu(viewProjection, program);
+}
+
+void GpuCulling::drawGpu(const float viewProjection[16], GLuint program) {
+    bool compact = GLExtensions::indirectCount();
+    const GLuint zero = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, counterBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), &zero);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glUseProgram(cullProgram);
+    glUniformMatrix4fv(glGetUniformLocation(cullProgram, "viewProjection"), 1, GL_FALSE, viewProjection);
+    glUniform1ui(glGetUniformLocation(cullProgram, "objectCount"), GLuint(objects.size()));
+    glUniform1i(glGetUniformLocation(cullProgram, "compact"), compact);
+    glUniform1i(glGetUniformLocation(cullProgram, "useHiZ"), occlusion != nullptr);
+    if (occlusion) {
+        glActiveTexture(GL_TEXTURE0 + HIZ_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_2D, hizTexture);
+        glActiveTexture(GL_TEXTURE0);
+        glUniform1i(glGetUniformLocation(cullProgram, "hiz"), HIZ_TEXTURE_UNIT);
+    }
+    GLuint buffers[5] = {objectBuffer, meshBuffer, commandBuffer, instanceBuffer, counterBuffer};
+    for (GLuint binding = 0; binding < 5; ++binding) glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, buffers[binding]);
+    GLExtensions::dispatchCompute((GLuint(objects.size()) + LOCAL_SIZE - 1) / LOCAL_SIZE, 1, 1);
+    // the commands, the count and the instance attribute are consumed by the draw below
+    GLExtensions::memoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+
+    glUseProgram(program);
+    glUniformMatrix4fv(glGetUniformLocation(program, "viewProjection"), 1, GL_FALSE, viewProjection);
+    glBindVertexArray(vertexArray);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    if (compact) {
+        glBindBuffer(GL_PARAMETER_BUFFER, counterBuffer);
+        GLExtensions::multiDrawElementsIndirectCount(GL_TRIANGLES, indexType, nullptr, 0, GLsizei(objects.size()), 0);
+        glBindBuffer(GL_PARAMETER_BUFFER, 0);
+    } else {
+        GLExtensions::multiDrawElementsIndirect(GL_TRIANGLES, indexType, nullptr, GLsizei(objects.size()), 0);
+    }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void GpuCulling::drawCpu(const float viewProjection[16], GLuint program) {
+    GLint mvpLocation = glGetUniformLocation(program, "MVP");
+    GLint modelLocation = glGetUniformLocation(program, "M");
+    size_t indexSize = indexType == GL_UNSIGNED_SHORT ? 2 : 4;
+    glBindVertexArray(vertexArray);
+    cpuVisible = 0;
+    for (const CullObject &object : objects) {
+        float mvp[16];
+        multiply(viewProjection, object.model, mvp);
+        bool visible = occlusion ? occlusion->isVisible(object.boundsMin, object.boundsMax, object.model)
+                                 : insideFrustum(mvp, object.boundsMin, object.boundsMax);
+        if (!visible) continue;
+        ++cpuVisible;
+        const CullMesh &mesh = meshes[object.mesh];
+        glUniformMatrix4fv(mvpLocation, 1, GL_FALSE, mvp);
+        glUniformMatrix4fv(modelLocation, 1, GL_FALSE, object.model);
+        glDrawElementsBaseVertex(GL_TRIANGLES, GLsizei(mesh.indexCount), indexType,
+                                 reinterpret_cast<const void *>(mesh.firstIndex * indexSize), mesh.baseVertex);
+    }
+}
+
+unsigned int GpuCulling::visibleCount() const {
+    if (!gpuPath()) return cpuVisible;
+    GLuint count = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, counterBuffer);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), &count);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    return count;
+}
+
+void GpuCulling::destroy() {
+    if (cullProgram) glDeleteProgram(cullProgram);
+    GLuint buffers[5] = {objectBuffer, meshBuffer, commandBuffer, instanceBuffer, counterBuffer};
+    for (GLuint buffer : buffers) if (buffer) glDeleteBuffers(1, &buffer);
+    if (hizTexture) glDeleteTextures(1, &hizTexture);
+    cullProgram = objectBuffer = meshBuffer = commandBuffer = instanceBuffer = counterBuffer = hizTexture = 0;
+}
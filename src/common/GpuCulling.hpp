@@ -0,0 +1,107 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#ifndef GPUCULLING_H
+#define GPUCULLING_H
+#include <glad/gl.h>
+#include <cstdint>
+#include <vector>
+
+#include "OcclusionCuller.hpp"
+
+
+/** Object of a culled scene, laid out like the Objects buffer of CullObjects.comp (std430) */
+struct CullObject {
+    float model[16];      // column major, uniform scale
+    float boundsMin[3];   // object space
+    uint32_t mesh;        // index into the CullMesh list
+    float boundsMax[3];
+    uint32_t reserved;
+};
+static_assert(sizeof(CullObject) == 96, "CullObject is uploaded as is");
+
+/** Index range of one mesh inside the shared vertex and index buffers */
+struct CullMesh {
+    uint32_t indexCount;
+    uint32_t firstIndex;
+    int32_t baseVertex;
+    uint32_t reserved;
+};
+
+/** Frustum (and optionally Hi-Z) culling and submission of many objects sharing one vertex array
+ *
+ *  GPU path (GL 4.3 compute and multi draw indirect): objects and meshes live in shader storage buffers,
+ *  CullObjects.comp writes one indirect command and instance entry per visible object and the frame is a single
+ *  glMultiDrawElementsIndirectCount (or glMultiDrawElementsIndirect with zero instance commands for culled objects
+ *  when indirect count is missing). Draw with ObjectShader.vert, it reads the model matrix of the instance's object.
+ *
+ *  CPU path (3.3 contexts): the same tests on the CPU and one glDrawElementsBaseVertex per visible object with the
+ *  MVP and M uniforms of MeshShader.vert.
+ */
+class GpuCulling {
+public:
+    /** Vertex attribute with the object index of an instance, added to the vertex array by initialize() */
+    static constexpr GLuint OBJECT_INDEX_LOCATION = 8;
+    /** Texture unit of the Hi-Z pyramid during the culling dispatch, kept clear of the material textures */
+    static constexpr GLint HIZ_TEXTURE_UNIT = 7;
+
+    GpuCulling() = default;
+    GpuCulling(const GpuCulling &) = delete;
+    GpuCulling &operator=(const GpuCulling &) = delete;
+    ~GpuCulling();
+
+    /** Uploads the scene, the GPU path is used if the context supports it and CullObjects.comp compiles
+     *
+     *  @param[in] vertexArray Vertex array with the shared vertex and element buffers bound
+     *  @param[in] indexType Type of the shared element buffer
+     *  @param[in] allowGpu false forces the CPU path, to compare both paths on one context
+     */
+    bool initialize(GLuint vertexArray, GLenum indexType, const std::vector<CullMesh> &meshes,
+                    const std::vector<CullObject> &objects, bool allowGpu = true);
+
+    /** @returns true if draw() culls in a compute shader, the program passed to draw() must match */
+    bool gpuPath() const { return cullProgram != 0; }
+
+    /** Replaces the model matrix of one object */
+    void setTransform(size_t object, const float model[16]);
+
+    /** Adds a Hi-Z test against a rasterized OcclusionCuller of the current frame, nullptr disables it
+     *
+     *  The GPU path uploads the pyramid into a R32F mip chain, the CPU path calls isVisible().
+     */
+    void setOcclusion(const OcclusionCuller *culler);
+
+    /** Culls and draws all objects
+     *
+     *  @param[in] viewProjection Column major projection * view matrix
+     *  @param[in] program Bound program: ObjectShader (viewProjection uniform) on the GPU path, MeshShader (MVP and
+     *             M uniforms) on the CPU path
+     */
+    void draw(const float viewProjection[16], GLuint program);
+
+    /** @returns Objects drawn by the last draw(), reads the GPU counter back (stalls, for statistics only) */
+    unsigned int visibleCount() const;
+
+    void destroy();
+
+private:
+    bool createGpuBuffers();
+    void drawGpu(const float viewProjection[16], GLuint program);
+    void drawCpu(const float viewProjection[16], GLuint program);
+
+    GLuint vertexArray = 0;
+    GLenum indexType = GL_UNSIGNED_INT;
+    std::vector<CullMesh> meshes;
+    std::vector<CullObject> objects;
+    const OcclusionCuller *occlusion = nullptr;
+    unsigned int cpuVisible = 0;
+
+    GLuint cullProgram = 0;
+    GLuint objectBuffer = 0, meshBuffer = 0, commandBuffer = 0, instanceBuffer = 0, counterBuffer = 0;
+    GLuint hizTexture = 0;
+};
+
+
+
+#endif //GPUCULLING_H
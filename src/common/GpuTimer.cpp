@@ -0,0 +1,89 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#include "GpuTimer.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+GpuTimer::~GpuTimer() {
+    destroy();
+}
+
+bool GpuTimer::create(std::initializer_list<const char *> passNames, unsigned int frameLatency) {
+    destroy();
+    names.assign(passNames.begin(), passNames.end());
+    passCount = unsigned(names.size());
+    latency = std::max(frameLatency, 1u);
+    if (passCount == 0) {printf("GpuTimer needs at least one pass\n"); return false;}
+
+    queries.resize(size_t(passCount) * latency);
+    glGenQueries(GLsizei(queries.size()), queries.data());
+    issued.assign(queries.size(), 0);
+    totalNanoseconds.assign(passCount, 0);
+    samples.assign(passCount, 0);
+    frame = 0;
+    activePass = -1;
+    return glGetError() == GL_NO_ERROR;
+}
+
+void GpuTimer::begin(unsigned int pass) {
+    if (pass >= passCount || activePass >= 0) return;
+    size_t query = size_t(frame) * passCount + pass;
+    glBeginQuery(GL_TIME_ELAPSED, queries[query]);
+    issued[query] = 1;
+    activePass = int(pass);
+}
+
+void GpuTimer::end() {
+    if (activePass < 0) return;
+    glEndQuery(GL_TIME_ELAPSED);
+    activePass = -1;
+}
+
+bool GpuTimer::endFrame() {
+    if (queries.empty()) return false;
+    frame = (frame + 1) % latency;
+    bool collected = false;
+    uint64_t frameNanoseconds = 0;
+
+    // the queries of the next frame were issued latency frames ago, reading them only blocks if the GPU lags behind
+    for (unsigned int pass = 0; pass < passCount; ++pass) {
+        size_t query = size_t(frame) * passCount + pass;
+        if (!issued[query]) continue;
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(queries[query], GL_QUERY_RESULT, &nanoseconds);
+        totalNanoseconds[pass] += nanoseconds;
+        ++samples[pass];
+        issued[query] = 0;
+        frameNanoseconds += nanoseconds;
+        collected = true;
+    }
+    if (collected) lastFrameNanoseconds = frameNanoseconds;
+    return collected;
+}
+
+double GpuTimer::averageMilliseconds(unsigned int pass) const {
+    if (pass >= passCount || samples[pass] == 0) return 0.0;
+    return double(totalNanoseconds[pass]) / samples[pass] * 1e-6;
+}
+
+void GpuTimer::resetAverages() {
+    std::fill(totalNanoseconds.begin(), totalNanoseconds.end(), 0);
+    std::fill(samples.begin(), samples.end(), 0);
+}
+
+void GpuTimer::printAverages() {
+    printf("GPU:");
+    for (unsigned int pass = 0; pass < passCount; ++pass)
+        printf(" %s %.3f ms%s", names[pass], averageMilliseconds(pass), pass + 1 < passCount ? "," : "\n");
+    resetAverages();
+}
+
+void GpuTimer::destroy() {
+    if (!queries.empty()) glDeleteQueries(GLsizei(queries.size()), queries.data());
+    queries.clear();
+    issued.clear();
+    passCount = 0;
+}
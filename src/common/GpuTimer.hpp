@@ -0,0 +1,63 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#ifndef GPUTIMER_H
+#define GPUTIMER_H
+#include <glad/gl.h>
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+
+/** GPU time of the passes of a frame, measured with GL_TIME_ELAPSED queries (core since 3.3)
+ *
+ *  Every pass gets one query per frame in flight. The results of a frame are read frameLatency frames later, when
+ *  the GPU is normally done with them, so measuring does not stall the pipeline. Elapsed time queries can not be
+ *  nested: begin() and end() of different passes must not overlap.
+ *
+ *  @note Tiling software rasterizers (e.g. llvmpipe) run the draws of a pass when its framebuffer is flushed, their
+ *        time can show up in a later pass
+ */
+class GpuTimer {
+public:
+    GpuTimer() = default;
+    GpuTimer(const GpuTimer &) = delete;
+    GpuTimer &operator=(const GpuTimer &) = delete;
+    ~GpuTimer();
+
+    /** @param[in] passNames Names used by printAverages(), the strings must outlive the timer */
+    bool create(std::initializer_list<const char *> passNames, unsigned int frameLatency = 3);
+
+    void begin(unsigned int pass);
+    void end();
+    /** Collects the results of the frame whose queries are reused next, call once at the end of every frame
+     *
+     *  @returns true if a frame was collected, its time is frameMilliseconds()
+     */
+    bool endFrame();
+    /** @returns GPU time of all passes of the frame collected last, frameLatency - 1 frames old */
+    double frameMilliseconds() const { return double(lastFrameNanoseconds) * 1e-6; }
+
+    /** @returns Mean GPU time of a pass over the frames collected since the last resetAverages() */
+    double averageMilliseconds(unsigned int pass) const;
+    void resetAverages();
+    /** Prints the mean time of every pass on one line and resets the averages */
+    void printAverages();
+
+    void destroy();
+
+private:
+    std::vector<const char *> names;
+    std::vector<GLuint> queries;     // frame major: queries[frame * passCount + pass]
+    std::vector<uint8_t> issued;
+    std::vector<uint64_t> totalNanoseconds;
+    std::vector<uint32_t> samples;
+    uint64_t lastFrameNanoseconds = 0;
+    unsigned int passCount = 0, latency = 0, frame = 0;
+    int activePass = -1;
+};
+
+
+
+#endif //GPUTIMER_H
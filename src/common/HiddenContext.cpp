@@ -0,0 +1,55 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#include "HiddenContext.hpp"
+
+#include <cstdio>
+#include <glad/gl.h>
+#include <GLFW/glfw3.h>
+
+#include "GLExtensions.hpp"
+
+HiddenContext::~HiddenContext() {
+    destroy();
+}
+
+bool HiddenContext::create(bool modern) {
+    destroy();
+    if (!glfwInit()) {printf("Failed to initialize GLFW\n"); return false;}
+
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    if (modern) {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+        window = glfwCreateWindow(64, 64, "", nullptr, nullptr);
+    }
+    if (!window) {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        window = glfwCreateWindow(64, 64, "", nullptr, nullptr);
+    }
+    if (!window) {
+        printf("Failed to create an OpenGL context\n");
+        glfwTerminate();
+        return false;
+    }
+
+    glfwMakeContextCurrent(window);
+    if (!gladLoadGL((GLADloadfunc)glfwGetProcAddress)) {
+        printf("Failed to initialize GLAD\n");
+        destroy();
+        return false;
+    }
+    GLExtensions::load((GLADloadfunc)glfwGetProcAddress);
+    return true;
+}
+
+void HiddenContext::destroy() {
+    if (!window) return;
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    window = nullptr;
+}
@@ -0,0 +1,37 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#ifndef HIDDENCONTEXT_H
+#define HIDDENCONTEXT_H
+
+struct GLFWwindow;
+
+
+/** OpenGL context of an invisible GLFW window, for tools and benchmarks that check GPU code paths
+ *
+ *  Asks for the same contexts as main.cpp (4.5 core, 3.3 core as fallback) and loads glad and GLExtensions, so the
+ *  checks run the paths the engine would pick on this machine.
+ */
+class HiddenContext {
+public:
+    HiddenContext() = default;
+    HiddenContext(const HiddenContext &) = delete;
+    HiddenContext &operator=(const HiddenContext &) = delete;
+    ~HiddenContext();
+
+    /** Creates the window and makes its context current
+     *
+     *  @param[in] modern Try a 4.5 context first, false goes straight to 3.3 (the fallback paths)
+     *  @returns false if GLFW or OpenGL can not be initialized
+     */
+    bool create(bool modern = true);
+    void destroy();
+
+private:
+    GLFWwindow *window = nullptr;
+};
+
+
+
+#endif //HIDDENCONTEXT_H
@@ -0,0 +1,180 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#include "JobSystem.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+    struct QueuedJob {
+        std::function<void()> job;
+        // parallelFor batches skip the std::function, it would allocate for their captures
+        JobSystem::RangeFunction range = nullptr;
+        const void *context = nullptr;
+        unsigned int begin = 0, end = 0;
+        JobCounter *counter = nullptr;
+    };
+
+    /** FIFO over a power of two ring, grows by doubling and never shrinks so steady state submits do not allocate */
+    class JobQueue {
+    public:
+        bool empty() const { return count == 0; }
+
+        void push(QueuedJob &&job) {
+            if (count == jobs.size()) grow();
+            jobs[(first + count) & (jobs.size() - 1)] = std::move(job);
+            ++count;
+        }
+
+        QueuedJob pop() {
+            QueuedJob job = std::move(jobs[first]);
+            first = (first + 1) & (jobs.size() - 1);
+            --count;
+            return job;
+        }
+
+    private:
+        void grow() {
+            std::vector<QueuedJob> larger(std::max<size_t>(jobs.size() * 2, 64));
+            for (size_t i = 0; i < count; ++i) larger[i] = std::move(jobs[(first + i) & (jobs.size() - 1)]);
+            jobs.swap(larger);
+            first = 0;
+        }
+
+        std::vector<QueuedJob> jobs;
+        size_t first = 0, count = 0;
+    };
+
+    std::mutex queueMutex;
+    std::condition_variable queueCondition;
+    JobQueue queue;
+    std::vector<std::thread> workers;
+    bool running = false;
+
+    void runJob(QueuedJob &queued) {
+        if (queued.range) queued.range(queued.context, queued.begin, queued.end);
+        else queued.job();
+        if (queued.counter) queued.counter->pending.fetch_sub(1, std::memory_order_release);
+    }
+
+    void workerLoop() {
+        while (true) {
+            QueuedJob queued;
+            {
+                std::unique_lock lock(queueMutex);
+                queueCondition.wait(lock, [] { return !queue.empty() || !running; });
+                if (queue.empty()) return; // shutdown requested and nothing left to do
+                queued = queue.pop();
+            }
+            runJob(queued);
+        }
+    }
+
+    // pops a single job without blocking, used by waiting threads to help out
+    bool tryRunOne() {
+        QueuedJob queued;
+        {
+            std::lock_guard lock(queueMutex);
+            if (queue.empty()) return false;
+            queued = queue.pop();
+        }
+        runJob(queued);
+        return true;
+    }
+
+    void ensureInitialized() {
+        {
+            std::lock_guard lock(queueMutex);
+            if (running) return;
+        }
+        JobSystem::initialize();
+    }
+
+    void enqueue(QueuedJob &&queued) {
+        ensureInitialized();
+        if (queued.counter) queued.counter->pending.fetch_add(1, std::memory_order_relaxed);
+
+        // no workers (single core machine): run inline so waiting never dead locks
+        if (workers.empty()) {
+            runJob(queued);
+            return;
+        }
+
+        {
+            std::lock_guard lock(queueMutex);
+            queue.push(std::move(queued));
+        }
+        queueCondition.notify_one();
+    }
+}
+
+void JobSystem::initialize(unsigned int threadCount) {
+    std::lock_guard lock(queueMutex);
+    if (running) return;
+
+    if (threadCount == 0) {
+        unsigned int hardwareThreads = std::thread::hardware_concurrency();
+        threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+    }
+
+    running = true;
+    workers.reserve(threadCount);
+    for (unsigned int i = 0; i < threadCount; ++i) workers.emplace_back(workerLoop);
+}
+
+void JobSystem::shutdown() {
+    {
+        std::lock_guard lock(queueMutex);
+        if (!running) return;
+        running = false;
+    }
+    queueCondition.notify_all();
+    for (std::thread &worker : workers) worker.join();
+    workers.clear();
+}
+
+unsigned int JobSystem::threadCount() {
+    ensureInitialized();
+    return static_cast<unsigned int>(workers.size()) + 1;
+}
+
+void JobSystem::submit(std::function<void()> job, JobCounter *counter) {
+    QueuedJob queued;
+    queued.job = std::move(job);
+    queued.counter = counter;
+    enqueue(std::move(queued));
+}
+
+void JobSystem::wait(const JobCounter &counter) {
+    while (counter.pending.load(std::memory_order_acquire) != 0) {
+        if (!tryRunOne()) std::this_thread::yield();
+    }
+}
+
+void JobSystem::parallelFor(unsigned int count, unsigned int batchSize, RangeFunction function, const void *context) {
+    if (count == 0) return;
+    batchSize = std::max(batchSize, 1u);
+
+    // small workloads are not worth the queue round trip
+    if (count <= batchSize) {
+        function(context, 0, count);
+        return;
+    }
+
+    JobCounter counter;
+    for (unsigned int begin = 0; begin < count; begin += batchSize) {
+        QueuedJob queued;
+        queued.range = function;
+        queued.context = context;
+        queued.begin = begin;
+        queued.end = std::min(begin + batchSize, count);
+        queued.counter = &counter;
+        enqueue(std::move(queued));
+    }
+    wait(counter);
+}
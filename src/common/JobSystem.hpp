@@ -0,0 +1,56 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#ifndef JOBSYSTEM_H
+#define JOBSYSTEM_H
+#include <atomic>
+#include <functional>
+
+
+/** Counter tracking a group of submitted jobs, reaches zero once all of them have finished */
+struct JobCounter {
+    std::atomic<unsigned int> pending{0};
+};
+
+/** Minimal worker thread pool used by the engine for data parallel work (texture compression, mesh import, ...)
+ *
+ *  The pool is created lazily on first use with one worker per hardware thread (minus the calling thread).
+ */
+class JobSystem {
+public:
+    /** Starts the worker threads
+     *
+     *  @param[in] threadCount Number of workers, 0 selects hardware_concurrency() - 1
+     */
+    static void initialize(unsigned int threadCount = 0);
+    static void shutdown();
+    /** @returns Number of threads working on a parallelFor, including the calling thread */
+    static unsigned int threadCount();
+
+    /** Queues a job, the counter (if given) is incremented now and decremented once the job has run */
+    static void submit(std::function<void()> job, JobCounter *counter = nullptr);
+    /** Blocks until the counter reaches zero, the calling thread executes queued jobs while waiting */
+    static void wait(const JobCounter &counter);
+
+    /** Splits [0, count) into batches and runs them on all threads, returns once every batch is done
+     *
+     *  @param[in] count Number of items
+     *  @param[in] batchSize Number of items handed to one invocation of func
+     *  @param[in] func Called with the half open item range [begin, end)
+     */
+    template<typename Func>
+    static void parallelFor(unsigned int count, unsigned int batchSize, const Func &func) {
+        parallelFor(count, batchSize, [](const void *context, unsigned int begin, unsigned int end) {
+            (*static_cast<const Func *>(context))(begin, end);
+        }, &func);
+    }
+
+    /** Type erased parallelFor, batches are queued without allocating */
+    typedef void (*RangeFunction)(const void *context, unsigned int begin, unsigned int end);
+    static void parallelFor(unsigned int count, unsigned int batchSize, RangeFunction function, const void *context);
+};
+
+
+
+#endif //JOBSYSTEM_H
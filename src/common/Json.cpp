@@ -0,0 +1,221 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#include "Json.hpp"
+
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+    const JsonValue NULL_VALUE;
+    constexpr unsigned int MAX_DEPTH = 256;
+}
+
+/** Recursive descent parser, kept out of the header */
+class JsonParser {
+public:
+    JsonParser(const char *text, size_t length) : p(text), begin(text), end(text + length) {}
+
+    bool parseDocument(JsonValue &value) {
+        if (!parseValue(value, 0)) return fail();
+        skipWhitespace();
+        return p == end || fail();
+    }
+
+private:
+    const char *p;
+    const char *begin;
+    const char *end;
+
+    bool fail() const {
+        printf("JSON syntax error at offset %zu\n", size_t(p - begin));
+        return false;
+    }
+
+    void skipWhitespace() {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) ++p;
+    }
+
+    bool consume(const char *literal) {
+        size_t length = strlen(literal);
+        if (size_t(end - p) < length || memcmp(p, literal, length) != 0) return false;
+        p += length;
+        return true;
+    }
+
+    bool parseValue(JsonValue &value, unsigned int depth) {
+        skipWhitespace();
+        if (p >= end || depth > MAX_DEPTH) return false;
+        switch (*p) {
+            case '{': return parseObject(value, depth);
+            case '[': return parseArray(value, depth);
+            case '"':
+                value.kind = JsonValue::Type::String;
+                return parseString(value.string);
+            case 't':
+                value.kind = JsonValue::Type::Bool;
+                value.boolean = true;
+                return consume("true");
+            case 'f':
+                value.kind = JsonValue::Type::Bool;
+                value.boolean = false;
+                return consume("false");
+            case 'n':
+                value.kind = JsonValue::Type::Null;
+                return consume("null");
+            default:
+                return parseNumber(value);
+        }
+    }
+
+    bool parseNumber(JsonValue &value) {
+        std::from_chars_result result = std::from_chars(p, end, value.number);
+        if (result.ec != std::errc() || result.ptr == p) return false;
+        value.kind = JsonValue::Type::Number;
+        p = result.ptr;
+        return true;
+    }
+
+    static void appendUtf8(std::string &out, unsigned int codePoint) {
+        if (codePoint < 0x80) {
+            out += char(codePoint);
+        } else if (codePoint < 0x800) {
+            out += char(0xC0 | (codePoint >> 6));
+            out += char(0x80 | (codePoint & 0x3F));
+        } else if (codePoint < 0x10000) {
+            out += char(0xE0 | (codePoint >> 12));
+            out += char(0x80 | ((codePoint >> 6) & 0x3F));
+            out += char(0x80 | (codePoint & 0x3F));
+        } else {
+            out += char(0xF0 | (codePoint >> 18));
+            out += char(0x80 | ((codePoint >> 12) & 0x3F));
+            out += char(0x80 | ((codePoint >> 6) & 0x3F));
+            out += char(0x80 | (codePoint & 0x3F));
+        }
+    }
+
+    bool parseHex4(unsigned int &value) {
+        if (end - p < 4) return false;
+        value = 0;
+        for (int i = 0; i < 4; ++i, ++p) {
+            char c = *p;
+            value <<= 4;
+            if (c >= '0' && c <= '9') value |= unsigned(c - '0');
+            else if (c >= 'a' && c <= 'f') value |= unsigned(c - 'a' + 10);
+            else if (c >= 'A' && c <= 'F') value |= unsigned(c - 'A' + 10);
+            else return false;
+        }
+        return true;
+    }
+
+    bool parseString(std::string &out) {
+        ++p; // opening quote
+        out.clear();
+        while (p < end) {
+            // copy runs without escapes in one go
+            const char *run = p;
+            while (p < end && *p != '"' && *p != '\\') ++p;
+            out.append(run, size_t(p - run));
+            if (p >= end) return false;
+            if (*p++ == '"') return true;
+
+            if (p >= end) return false;
+            char escape = *p++;
+            switch (escape) {
+                case '"': out += '"'; break;
+                case '\\': out += '\\'; break;
+                case '/': out += '/'; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'u': {
+                    unsigned int codePoint;
+                    if (!parseHex4(codePoint)) return false;
+                    // surrogate pair
+                    if (codePoint >= 0xD800 && codePoint < 0xDC00 && consume("\\u")) {
+                        unsigned int low;
+                        if (!parseHex4(low) || low < 0xDC00 || low >= 0xE000) return false;
+                        codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+                    }
+                    appendUtf8(out, codePoint);
+                    break;
+                }
+                default:
+                    return false;
+            }
+        }
+        return false;
+    }
+
+    bool parseArray(JsonValue &value, unsigned int depth) {
+        ++p;
+        value.kind = JsonValue::Type::Array;
+        skipWhitespace();
+        if (p < end && *p == ']') {++p; return true;}
+        while (true) {
+            value.elements.emplace_back();
+            if (!parseValue(value.elements.back(), depth + 1)) return false;
+            skipWhitespace();
+            if (p >= end) return false;
+            if (*p == ']') {++p; return true;}
+            if (*p++ != ',') return false;
+        }
+    }
+
+    bool parseObject(JsonValue &value, unsigned int depth) {
+        ++p;
+        value.kind = JsonValue::Type::Object;
+        skipWhitespace();
+        if (p < end && *p == '}') {++p; return true;}
+        while (true) {
+            skipWhitespace();
+            if (p >= end || *p != '"') return false;
+            value.objectMembers.emplace_back();
+            auto &member = value.objectMembers.back();
+            if (!parseString(member.first)) return false;
+            skipWhitespace();
+            if (p >= end || *p++ != ':') return false;
+            if (!parseValue(member.second, depth + 1)) return false;
+            skipWhitespace();
+            if (p >= end) return false;
+            if (*p == '}') {++p; return true;}
+            if (*p++ != ',') return false;
+        }
+    }
+};
+
+bool JsonValue::parse(const char *text, size_t length, JsonValue &value) {
+    value = JsonValue();
+    JsonParser parser(text, length);
+    return parser.parseDocument(value);
+}
+
+size_t JsonValue::size() const {
+    if (kind == Type::Array) return elements.size();
+    if (kind == Type::Object) return objectMembers.size();
+    return 0;
+}
+
+const JsonValue &JsonValue::operator[](size_t index) const {
+    return kind == Type::Array && index < elements.size() ? elements[index] : NULL_VALUE;
+}
+
+const JsonValue &JsonValue::operator[](const char *key) const {
+    if (kind != Type::Object) return NULL_VALUE;
+    for (const auto &member : objectMembers) {
+        if (member.first == key) return member.second;
+    }
+    return NULL_VALUE;
+}
+
+bool JsonValue::contains(const char *key) const {
+    if (kind != Type::Object) return false;
+    for (const auto &member : objectMembers) {
+        if (member.first == key) return true;
+    }
+    return false;
+}
@@ -0,0 +1,67 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#ifndef JSON_H
+#define JSON_H
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+/** Parsed JSON document node (RFC 8259), used for glTF and tool manifests
+ *
+ *  Lookups of missing keys or indices return a shared null value, so chained access like
+ *  json["materials"][2]["pbrMetallicRoughness"]["baseColorFactor"] never needs intermediate checks.
+ */
+class JsonValue {
+public:
+    enum class Type { Null, Bool, Number, String, Array, Object };
+
+    /** Parses a complete document
+     *
+     *  @param[in] text The JSON text, not necessarily null terminated
+     *  @param[in] length Length of the text in bytes
+     *  @param[out] value The document root
+     *  @returns false on a syntax error (the error position is printed)
+     */
+    static bool parse(const char *text, size_t length, JsonValue &value);
+
+    Type type() const { return kind; }
+    bool isNull() const { return kind == Type::Null; }
+    bool isNumber() const { return kind == Type::Number; }
+    bool isString() const { return kind == Type::String; }
+    bool isArray() const { return kind == Type::Array; }
+    bool isObject() const { return kind == Type::Object; }
+
+    /** @returns Number of array elements or object members */
+    size_t size() const;
+
+    const JsonValue &operator[](size_t index) const;
+    const JsonValue &operator[](int index) const { return (*this)[size_t(index < 0 ? size() : index)]; }
+    const JsonValue &operator[](unsigned int index) const { return (*this)[size_t(index)]; }
+    const JsonValue &operator[](const char *key) const;
+    bool contains(const char *key) const;
+    /** @returns The object members in document order */
+    const std::vector<std::pair<std::string, JsonValue>> &members() const { return objectMembers; }
+
+    double asNumber(double fallback = 0.0) const { return kind == Type::Number ? number : fallback; }
+    int asInt(int fallback = 0) const { return kind == Type::Number ? int(number) : fallback; }
+    bool asBool(bool fallback = false) const { return kind == Type::Bool ? boolean : fallback; }
+    const std::string &asString() const { return string; }
+
+private:
+    friend class JsonParser;
+
+    Type kind = Type::Null;
+    bool boolean = false;
+    double number = 0.0;
+    std::string string;
+    std::vector<JsonValue> elements;
+    std::vector<std::pair<std::string, JsonValue>> objectMembers;
+};
+
+
+
+#endif //JSON_H
@@ -0,0 +1,362 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#include "KTX2Stream.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#ifdef ENGINE_WITH_ZSTD
+#include <zstd.h>
+#endif
+#ifdef ENGINE_WITH_ZLIB
+#include <zlib.h>
+#endif
+
+#include "TextureDecoder.hpp"
+#include "Textures.hpp"
+
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT 0x8C4D
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT 0x8C4E
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C // core since OpenGL 4.2 / ARB_texture_compression_bptc
+#define GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM 0x8E8D
+#define GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT 0x8E8E
+#define GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT 0x8E8F
+#endif
+#ifndef GL_TEXTURE_CUBE_MAP_ARRAY
+#define GL_TEXTURE_CUBE_MAP_ARRAY 0x9009 // core since OpenGL 4.0
+#endif
+
+namespace {
+    constexpr unsigned char KTX2_IDENTIFIER[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+    constexpr unsigned int SUPERCOMPRESSION_NONE = 0;
+    constexpr unsigned int SUPERCOMPRESSION_ZSTD = 2;
+    constexpr unsigned int SUPERCOMPRESSION_ZLIB = 3;
+
+    /** OpenGL upload parameters for a VkFormat */
+    struct FormatInfo {
+        uint32_t vkFormat;
+        GLenum internalFormat;
+        GLenum format; // 0 for block compressed formats
+        GLenum type;
+        unsigned int blockSize; // bytes per 4x4 block, or per pixel for uncompressed formats
+    };
+
+    constexpr FormatInfo FORMATS[] = {
+        {9,   GL_R8,                                    GL_RED,  GL_UNSIGNED_BYTE, 1},  // R8_UNORM
+        {16,  GL_RG8,                                   GL_RG,   GL_UNSIGNED_BYTE, 2},  // R8G8_UNORM
+        {37,  GL_RGBA8,                                 GL_RGBA, GL_UNSIGNED_BYTE, 4},  // R8G8B8A8_UNORM
+        {43,  GL_SRGB8_ALPHA8,                          GL_RGBA, GL_UNSIGNED_BYTE, 4},  // R8G8B8A8_SRGB
+        {97,  GL_RGBA16F,                               GL_RGBA, GL_HALF_FLOAT,    8},  // R16G16B16A16_SFLOAT
+        {131, GL_COMPRESSED_RGB_S3TC_DXT1_EXT,          0, 0, 8},                       // BC1_RGB_UNORM
+        {132, GL_COMPRESSED_SRGB_S3TC_DXT1_EXT,         0, 0, 8},                       // BC1_RGB_SRGB
+        {133, GL_COMPRESSED_RGBA_S3TC_DXT1_EXT,         0, 0, 8},                       // BC1_RGBA_UNORM
+        {134, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT,   0, 0, 8},                       // BC1_RGBA_SRGB
+        {135, GL_COMPRESSED_RGBA_S3TC_DXT3_EXT,         0, 0, 16},                      // BC2_UNORM
+        {136, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT,   0, 0, 16},                      // BC2_SRGB
+        {137, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT,         0, 0, 16},                      // BC3_UNORM
+        {138, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT,   0, 0, 16},                      // BC3_SRGB
+        {139, GL_COMPRESSED_RED_RGTC1,                  0, 0, 8},                       // BC4_UNORM
+        {140, GL_COMPRESSED_SIGNED_RED_RGTC1,           0, 0, 8},                       // BC4_SNORM
+        {141, GL_COMPRESSED_RG_RGTC2,                   0, 0, 16},                      // BC5_UNORM
+        {142, GL_COMPRESSED_SIGNED_RG_RGTC2,            0, 0, 16},                      // BC5_SNORM
+        {143, GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT,    0, 0, 16},                      // BC6H_UFLOAT
+        {144, GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT,      0, 0, 16},                      // BC6H_SFLOAT
+        {145, GL_COMPRESSED_RGBA_BPTC_UNORM,            0, 0, 16},                      // BC7_UNORM
+        {146, GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM,      0, 0, 16},                      // BC7_SRGB
+    };
+
+    const FormatInfo *findFormat(uint32_t vkFormat) {
+        for (const FormatInfo &info : FORMATS) if (info.vkFormat == vkFormat) return &info;
+        return nullptr;
+    }
+
+    // maps the sRGB and RGB-only S3TC variants onto the formats understood by TextureDecoder
+    GLenum decoderFormat(GLenum format) {
+        switch (format) {
+            case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+            case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+            case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
+                return GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+            case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT:
+                return GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
+            case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+                return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+            default:
+                return format;
+        }
+    }
+
+    uint32_t readUInt32(const unsigned char *in) {
+        uint32_t value;
+        memcpy(&value, in, 4);
+        return value;
+    }
+
+    uint64_t readUInt64(const unsigned char *in) {
+        uint64_t value;
+        memcpy(&value, in, 8);
+        return value;
+    }
+}
+
+KTX2Stream::~KTX2Stream() {
+    for (const std::unique_ptr<Level> &level : levels) JobSystem::wait(level->done);
+}
+
+bool KTX2Stream::open(const char *filename) {
+    AssetData source;
+    if (!Assets::open(filename, source)) {printf("Image file could not be opened\n"); return false;}
+    return open(source, filename);
+}
+
+bool KTX2Stream::open(const AssetData &source, const char *name) {
+    // identifier, header (9 x uint32) and index (4 x uint32, 2 x uint64)
+    constexpr size_t HEADER_SIZE = 12 + 36 + 32;
+    if (source.size() < HEADER_SIZE || memcmp(source.data(), KTX2_IDENTIFIER, 12) != 0) {
+        printf("Not a valid KTX2 file\n");
+        return false;
+    }
+    const unsigned char *header = source.data();
+
+    uint32_t vkFormat = readUInt32(header + 12);
+    width = readUInt32(header + 20);
+    height = readUInt32(header + 24);
+    unsigned int pixelDepth = readUInt32(header + 28);
+    unsigned int layerCount = readUInt32(header + 32);
+    faces = readUInt32(header + 36);
+    unsigned int levelCount = readUInt32(header + 40);
+    supercompression = readUInt32(header + 44);
+
+    const FormatInfo *info = findFormat(vkFormat);
+    if (!info) {
+        printf("Unsupported KTX2 format (VkFormat %u)\n", vkFormat);
+        return false;
+    }
+
+    bool supercompressionSupported = supercompression == SUPERCOMPRESSION_NONE;
+#ifdef ENGINE_WITH_ZSTD
+    supercompressionSupported |= supercompression == SUPERCOMPRESSION_ZSTD;
+#endif
+#ifdef ENGINE_WITH_ZLIB
+    supercompressionSupported |= supercompression == SUPERCOMPRESSION_ZLIB;
+#endif
+    if (!supercompressionSupported) {
+        printf("Unsupported KTX2 supercompression scheme %u\n", supercompression);
+        return false;
+    }
+
+    if (width == 0 || height == 0 || (faces != 1 && faces != 6)) {
+        printf("Unsupported KTX2 layout (1D textures or partial cube maps)\n");
+        return false;
+    }
+
+    // a level count of 0 asks the loader to build the mip chain
+    generateMipmaps = levelCount == 0;
+    levelCount = std::max(levelCount, 1u);
+
+    if (source.size() - HEADER_SIZE < size_t(levelCount) * 24) {
+        printf("KTX2 level index is truncated\n");
+        return false;
+    }
+    const unsigned char *levelIndex = source.data() + HEADER_SIZE;
+
+    path = name;
+    file = source;
+    depth = std::max(pixelDepth, 1u);
+    layers = std::max(layerCount, 1u);
+    compressed = info->format == 0;
+    internalFormat = info->internalFormat;
+    pixelFormat = info->format;
+    pixelType = info->type;
+    blockSize = info->blockSize;
+
+    if (pixelDepth > 0) textureTarget = GL_TEXTURE_3D;
+    else if (faces == 6) textureTarget = layerCount > 0 ? GL_TEXTURE_CUBE_MAP_ARRAY : GL_TEXTURE_CUBE_MAP;
+    else if (layerCount > 0) textureTarget = GL_TEXTURE_2D_ARRAY;
+    else textureTarget = GL_TEXTURE_2D;
+
+    // the blocks get decoded on the worker threads if the driver cannot sample them
+    s3tcFormat = decoderFormat(internalFormat);
+    transcodeS3TC = TextureDecoder::isS3TC(s3tcFormat) && !Textures::hasS3TC();
+    if (transcodeS3TC) {
+        bool opaque = internalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT || internalFormat == GL_COMPRESSED_SRGB_S3TC_DXT1_EXT;
+        bool srgb = s3tcFormat != internalFormat && internalFormat != GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        internalFormat = srgb ? (opaque ? GL_SRGB8 : GL_SRGB8_ALPHA8) : (opaque ? GL_RGB8 : GL_RGBA8);
+        pixelFormat = GL_RGBA;
+        pixelType = GL_UNSIGNED_BYTE;
+    }
+
+    // glGenerateMipmap can not fill block compressed levels, such a texture only has its base level
+    if (generateMipmaps && compressed && !transcodeS3TC) generateMipmaps = false;
+
+    glGenTextures(1, &textureID);
+    glBindTexture(textureTarget, textureID);
+    glTexParameteri(textureTarget, GL_TEXTURE_MIN_FILTER, levelCount > 1 || generateMipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(textureTarget, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(textureTarget, GL_TEXTURE_BASE_LEVEL, levelCount - 1);
+    if (!generateMipmaps) glTexParameteri(textureTarget, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+
+    levels.clear();
+    nextLevel = 0;
+    for (unsigned int i = 0; i < levelCount; ++i) {
+        auto level = std::make_unique<Level>();
+        level->fileOffset = readUInt64(&levelIndex[i * 24]);
+        level->byteLength = readUInt64(&levelIndex[i * 24 + 8]);
+        level->uncompressedByteLength = readUInt64(&levelIndex[i * 24 + 16]);
+        levels.push_back(std::move(level));
+    }
+
+    // queue the smallest levels first, they are uploaded first
+    for (unsigned int i = levelCount; i-- > 0;) {
+        Level *level = levels[i].get();
+        JobSystem::submit([this, level, i] { decodeLevel(*level, i); }, &level->done);
+    }
+    return true;
+}
+
+void KTX2Stream::decodeLevel(Level &level, unsigned int index) const {
+    unsigned int levelWidth = std::max(width >> index, 1u);
+    unsigned int levelHeight = std::max(height >> index, 1u);
+    unsigned int levelDepth = textureTarget == GL_TEXTURE_3D ? std::max(depth >> index, 1u) : 1;
+    size_t imageSize = compressed ? size_t((levelWidth + 3) / 4) * ((levelHeight + 3) / 4) * blockSize
+                                  : size_t(levelWidth) * levelHeight * blockSize;
+    size_t images = size_t(levelDepth) * layers * faces;
+    size_t expectedSize = imageSize * images;
+
+    // the level is a view into the mapped file, supercompressed levels are inflated into their own buffer
+    if (level.fileOffset > file.size() || level.byteLength > file.size() - level.fileOffset) {
+        level.failed = true;
+        return;
+    }
+    // the inflated size follows from the format and the dimensions, allocating whatever the file claims could throw
+    if (supercompression != SUPERCOMPRESSION_NONE && level.uncompressedByteLength != expectedSize) {
+        level.failed = true;
+        return;
+    }
+    AssetData fileData = file.slice(size_t(level.fileOffset), size_t(level.byteLength));
+
+    AssetData data;
+    std::vector<unsigned char> inflated;
+    switch (supercompression) {
+#ifdef ENGINE_WITH_ZSTD
+        case SUPERCOMPRESSION_ZSTD: {
+            inflated.resize(level.uncompressedByteLength);
+            size_t result = ZSTD_decompress(inflated.data(), inflated.size(), fileData.data(), fileData.size());
+            if (ZSTD_isError(result) || result != inflated.size()) level.failed = true;
+            data = AssetData::fromBuffer(std::move(inflated));
+            break;
+        }
+#endif
+#ifdef ENGINE_WITH_ZLIB
+        case SUPERCOMPRESSION_ZLIB: {
+            inflated.resize(level.uncompressedByteLength);
+            uLongf length = inflated.size();
+            if (uncompress(inflated.data(), &length, fileData.data(), fileData.size()) != Z_OK || length != inflated.size())
+                level.failed = true;
+            data = AssetData::fromBuffer(std::move(inflated));
+            break;
+        }
+#endif
+        default:
+            data = std::move(fileData);
+            break;
+    }
+    if (level.failed || data.size() < expectedSize) {
+        level.failed = true;
+        return;
+    }
+
+    if (!transcodeS3TC) {
+        level.data = data.slice(0, expectedSize);
+        return;
+    }
+
+    // every layer, face and slice is an independent block image
+    size_t decodedImageSize = size_t(levelWidth) * levelHeight * 4;
+    std::vector<unsigned char> decoded(decodedImageSize * images);
+    for (size_t image = 0; image < images; ++image) {
+        TextureDecoder::decode(s3tcFormat, data.data() + image * imageSize, levelWidth, levelHeight,
+                               decoded.data() + image * decodedImageSize);
+    }
+    level.data = AssetData::fromBuffer(std::move(decoded));
+}
+
+void KTX2Stream::uploadLevel(const Level &level, unsigned int index) const {
+    GLsizei levelWidth = GLsizei(std::max(width >> index, 1u));
+    GLsizei levelHeight = GLsizei(std::max(height >> index, 1u));
+    GLsizei levelDepth = textureTarget == GL_TEXTURE_3D ? GLsizei(std::max(depth >> index, 1u)) : GLsizei(layers * faces);
+    GLsizei size = GLsizei(level.data.size());
+    const unsigned char *data = level.data.data();
+    bool blocks = compressed && !transcodeS3TC;
+
+    switch (textureTarget) {
+        case GL_TEXTURE_2D:
+            if (blocks) glCompressedTexImage2D(textureTarget, index, internalFormat, levelWidth, levelHeight, 0, size, data);
+            else glTexImage2D(textureTarget, index, internalFormat, levelWidth, levelHeight, 0, pixelFormat, pixelType, data);
+            break;
+        case GL_TEXTURE_CUBE_MAP: {
+            GLsizei faceSize = size / 6;
+            for (unsigned int face = 0; face < 6; ++face) {
+                GLenum faceTarget = GL_TEXTURE_CUBE_MAP_POSITIVE_X + face;
+                if (blocks) glCompressedTexImage2D(faceTarget, index, internalFormat, levelWidth, levelHeight, 0, faceSize, data + face * faceSize);
+                else glTexImage2D(faceTarget, index, internalFormat, levelWidth, levelHeight, 0, pixelFormat, pixelType, data + face * faceSize);
+            }
+            break;
+        }
+        default:
+            // arrays, cube map arrays (layer-faces) and 3D textures are stored as one contiguous block per level
+            if (blocks) glCompressedTexImage3D(textureTarget, index, internalFormat, levelWidth, levelHeight, levelDepth, 0, size, data);
+            else glTexImage3D(textureTarget, index, internalFormat, levelWidth, levelHeight, levelDepth, 0, pixelFormat, pixelType, data);
+            break;
+    }
+}
+
+unsigned int KTX2Stream::upload(unsigned int maxLevels, bool block) {
+    if (maxLevels == 0) maxLevels = levelCount();
+
+    GLint unpackAlignment;
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpackAlignment);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // KTX2 rows are tightly packed
+    glBindTexture(textureTarget, textureID);
+
+    unsigned int uploaded = 0;
+    while (uploaded < maxLevels && nextLevel < levelCount()) {
+        unsigned int index = levelCount() - 1 - nextLevel;
+        Level &level = *levels[index];
+        if (level.done.pending.load(std::memory_order_acquire) != 0) {
+            if (!block) break;
+            JobSystem::wait(level.done);
+        }
+        if (level.failed) {
+            // keep the levels that made it, the texture stays complete from the current base level on
+            printf("KTX2 level %u of %s could not be decoded\n", index, path.c_str());
+            nextLevel = levelCount();
+            break;
+        }
+
+        uploadLevel(level, index);
+        glTexParameteri(textureTarget, GL_TEXTURE_BASE_LEVEL, index);
+        level.data = AssetData(); // release the memory right away
+        ++nextLevel;
+        ++uploaded;
+
+        if (nextLevel == levelCount() && generateMipmaps) glGenerateMipmap(textureTarget);
+    }
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, unpackAlignment);
+    return uploaded;
+}
+
+bool KTX2Stream::finished() const {
+    return nextLevel == levelCount();
+}
@@ -0,0 +1,98 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#ifndef KTX2STREAM_H
+#define KTX2STREAM_H
+#include <glad/gl.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Assets.hpp"
+#include "JobSystem.hpp"
+
+
+/** Progressive loader for .ktx2 textures
+ *
+ *  open() maps the file (loose or from an archive), parses the header and queues one job per mip level which
+ *  slices the level out of the mapping, undoes the supercompression (Zstandard or zlib) and, if needed,
+ *  transcodes S3TC blocks to RGBA8. upload() then
+ *  hands finished levels to OpenGL starting with the smallest one and lowers GL_TEXTURE_BASE_LEVEL with
+ *  every level, so the texture can be sampled after the first upload while the large levels stream in.
+ *
+ *  Supports 2D, 2D array, cube map (array) and 3D textures in all BCn formats plus a few uncompressed ones.
+ *  A file without levels (level count 0) gets its mip chain from glGenerateMipmap, except for block compressed data
+ *  which OpenGL can not generate mips for: such a texture is limited to its base level.
+ */
+class KTX2Stream {
+public:
+    KTX2Stream() = default;
+    KTX2Stream(const KTX2Stream &) = delete;
+    KTX2Stream &operator=(const KTX2Stream &) = delete;
+    /** Waits for outstanding level jobs, the texture object stays alive (it is owned by the caller) */
+    ~KTX2Stream();
+
+    /** Reads the header, creates the texture object and starts decoding all levels on the worker threads
+     *
+     *  @param[in] filename The path to the .ktx2 file
+     *  @returns false if the file is not a supported .ktx2 file
+     */
+    bool open(const char *filename);
+
+    /** Same as open(filename) for a file that is already in memory (e.g. an image embedded in a model)
+     *
+     *  @param[in] source The whole .ktx2 file, referenced until all levels are decoded
+     *  @param[in] name Used in error messages
+     */
+    bool open(const AssetData &source, const char *name);
+
+    /** Uploads decoded levels, smallest first
+     *
+     *  @param[in] maxLevels Upper bound of levels handed to OpenGL in this call, 0 uploads everything that is ready
+     *  @param[in] block Wait for the next level if it is not decoded yet
+     *  @returns Number of uploaded levels
+     */
+    unsigned int upload(unsigned int maxLevels = 1, bool block = false);
+
+    /** @returns true once every level is resident */
+    bool finished() const;
+
+    GLuint texture() const { return textureID; }
+    GLenum target() const { return textureTarget; }
+    unsigned int levelCount() const { return static_cast<unsigned int>(levels.size()); }
+
+private:
+    struct Level {
+        unsigned long long fileOffset = 0;
+        unsigned long long byteLength = 0;
+        unsigned long long uncompressedByteLength = 0;
+        AssetData data; // filled by the level job
+        bool failed = false;
+        JobCounter done;
+    };
+
+    void decodeLevel(Level &level, unsigned int index) const;
+    void uploadLevel(const Level &level, unsigned int index) const;
+
+    std::string path;
+    AssetData file;              // the whole mapped file, levels are sliced out of it
+    GLuint textureID = 0;
+    GLenum textureTarget = 0;
+    GLenum internalFormat = 0;
+    GLenum pixelFormat = 0;      // uncompressed upload format, 0 for block compressed data
+    GLenum pixelType = 0;
+    bool compressed = false;
+    bool transcodeS3TC = false;  // S3TC data on a context without EXT_texture_compression_s3tc
+    GLenum s3tcFormat = 0;       // format handed to TextureDecoder when transcoding
+    bool generateMipmaps = false;
+    unsigned int blockSize = 0;  // bytes per 4x4 block or per pixel for uncompressed formats
+    unsigned int width = 0, height = 0, depth = 0, layers = 0, faces = 0;
+    unsigned int supercompression = 0;
+    unsigned int nextLevel = 0;  // number of levels already uploaded (counted from the smallest)
+    std::vector<std::unique_ptr<Level>> levels;
+};
+
+
+
+#endif //KTX2STREAM_H
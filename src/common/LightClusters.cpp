@@ -0,0 +1,281 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#include "LightClusters.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define LIGHT_CLUSTERS_SSE2
+#endif
+
+#include "JobSystem.hpp"
+#include "Memory.hpp"
+
+namespace {
+    /** Squared distance between a point and a box, 0 inside */
+    float distanceSquared(const float point[3], const float low[3], const float high[3]) {
+        float sum = 0.0f;
+        for (int axis = 0; axis < 3; ++axis) {
+            float d = std::max(std::max(low[axis] - point[axis], point[axis] - high[axis]), 0.0f);
+            sum += d * d;
+        }
+        return sum;
+    }
+
+    /** Light spheres as SoA with the squared radius, padded to a multiple of 4 with spheres that touch nothing */
+    struct SphereList {
+        float *x, *y, *z, *radius2;
+        uint32_t *index;
+        size_t count;
+
+        static SphereList allocate(ScratchScope &scratch, size_t capacity) {
+            return {scratch.allocateArray<float>(capacity), scratch.allocateArray<float>(capacity),
+                    scratch.allocateArray<float>(capacity), scratch.allocateArray<float>(capacity),
+                    scratch.allocateArray<uint32_t>(capacity), 0};
+        }
+
+        void push(float px, float py, float pz, float r2, uint32_t i) {
+            x[count] = px;
+            y[count] = py;
+            z[count] = pz;
+            radius2[count] = r2;
+            index[count] = i;
+            ++count;
+        }
+
+        void pad() {
+            for (size_t i = count; i < ((count + 3) & ~size_t(3)); ++i) {
+                x[i] = y[i] = z[i] = 0.0f;
+                radius2[i] = -1.0f;
+                index[i] = 0;
+            }
+        }
+    };
+
+    /** Calls emit(i) for every sphere of the list touching the box */
+    template<typename Emit>
+    void touchingSpheres(const float low[3], const float high[3], const SphereList &spheres, const Emit &emit) {
+#ifdef LIGHT_CLUSTERS_SSE2
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 minX = _mm_set1_ps(low[0]), minY = _mm_set1_ps(low[1]), minZ = _mm_set1_ps(low[2]);
+        const __m128 maxX = _mm_set1_ps(high[0]), maxY = _mm_set1_ps(high[1]), maxZ = _mm_set1_ps(high[2]);
+        for (size_t i = 0; i < spheres.count; i += 4) {
+            __m128 x = _mm_loadu_ps(spheres.x + i), y = _mm_loadu_ps(spheres.y + i), z = _mm_loadu_ps(spheres.z + i);
+            __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minX, x), _mm_sub_ps(x, maxX)), zero);
+            __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minY, y), _mm_sub_ps(y, maxY)), zero);
+            __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minZ, z), _mm_sub_ps(z, maxZ)), zero);
+            __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+            int mask = _mm_movemask_ps(_mm_cmple_ps(d2, _mm_loadu_ps(spheres.radius2 + i)));
+            if (!mask) continue;
+            for (int lane = 0; lane < 4; ++lane) if (mask & (1 << lane)) emit(i + lane);
+        }
+#else
+        for (size_t i = 0; i < spheres.count; ++i) {
+            const float center[3] = {spheres.x[i], spheres.y[i], spheres.z[i]};
+            if (distanceSquared(center, low, high) <= spheres.radius2[i]) emit(i);
+        }
+#endif
+    }
+}
+
+LightClusters::LightClusters(unsigned int tilesX, unsigned int tilesY, unsigned int slices)
+    : tilesX(std::max(tilesX, 1u)), tilesY(std::max(tilesY, 1u)), slices(std::max(slices, 1u)) {
+    sliceIndices.resize(this->slices);
+    ranges.assign(size_t(clusterCount()) * 2, 0);
+}
+
+LightClusters::~LightClusters() {
+    destroy();
+}
+
+void LightClusters::setViewport(unsigned int width, unsigned int height) {
+    viewportWidth = std::max(width, 1u);
+    viewportHeight = std::max(height, 1u);
+}
+
+void LightClusters::setProjection(float fovY, float aspect, float nearPlane, float farPlane, unsigned int width,
+                                  unsigned int height) {
+    zNear = nearPlane;
+    zFar = farPlane;
+    viewportWidth = std::max(width, 1u);
+    viewportHeight = std::max(height, 1u);
+    float logRatio = std::log(zFar / zNear);
+    sliceScale = float(slices) / logRatio;
+    sliceBias = -float(slices) * std::log(zNear) / logRatio;
+
+    sliceNear.resize(slices);
+    sliceFar.resize(slices);
+    for (unsigned int s = 0; s < slices; ++s) {
+        sliceNear[s] = zNear * std::pow(zFar / zNear, float(s) / float(slices));
+        sliceFar[s] = zNear * std::pow(zFar / zNear, float(s + 1) / float(slices));
+    }
+
+    // a tile spans [ndc0, ndc1] on screen, at depth d that is [ndc0, ndc1] * d * tanHalf in view space
+    float tanHalfY = std::tan(fovY * 0.5f), tanHalfX = tanHalfY * aspect;
+    size_t count = clusterCount();
+    for (std::vector<float> *bounds : {&boundsMinX, &boundsMinY, &boundsMinZ, &boundsMaxX, &boundsMaxY, &boundsMaxZ})
+        bounds->resize(count);
+    for (unsigned int s = 0; s < slices; ++s) {
+        for (unsigned int y = 0; y < tilesY; ++y) {
+            float y0 = (float(y) / float(tilesY) * 2.0f - 1.0f) * tanHalfY;
+            float y1 = (float(y + 1) / float(tilesY) * 2.0f - 1.0f) * tanHalfY;
+            for (unsigned int x = 0; x < tilesX; ++x) {
+                float x0 = (float(x) / float(tilesX) * 2.0f - 1.0f) * tanHalfX;
+                float x1 = (float(x + 1) / float(tilesX) * 2.0f - 1.0f) * tanHalfX;
+                size_t c = (size_t(s) * tilesY + y) * tilesX + x;
+                float n = sliceNear[s], f = sliceFar[s];
+                boundsMinX[c] = std::min(x0 * n, x0 * f);
+                boundsMaxX[c] = std::max(x1 * n, x1 * f);
+                boundsMinY[c] = std::min(y0 * n, y0 * f);
+                boundsMaxY[c] = std::max(y1 * n, y1 * f);
+                boundsMinZ[c] = -f;
+                boundsMaxZ[c] = -n;
+            }
+        }
+    }
+}
+
+void LightClusters::assign(const float view[16], const PointLight *lightList, size_t count) {
+    lights = lightList;
+    lightCount = count;
+
+    // view space positions, padding lights have a negative radius and never touch anything
+    size_t padded = (count + 3) & ~size_t(3);
+    paddedCount = padded;
+    lightX = Memory::frameArena().allocateArray<float>(padded * 4);
+    if (!lightX) {
+        lightFallback.resize(padded * 4);
+        lightX = lightFallback.data();
+    }
+    lightY = lightX + padded;
+    lightZ = lightY + padded;
+    lightRadius = lightZ + padded;
+    for (size_t i = 0; i < count; ++i) {
+        const float *p = lightList[i].position;
+        lightX[i] = view[0] * p[0] + view[4] * p[1] + view[8] * p[2] + view[12];
+        lightY[i] = view[1] * p[0] + view[5] * p[1] + view[9] * p[2] + view[13];
+        lightZ[i] = view[2] * p[0] + view[6] * p[1] + view[10] * p[2] + view[14];
+        lightRadius[i] = lightList[i].radius;
+    }
+    for (size_t i = count; i < padded; ++i) {
+        lightX[i] = lightY[i] = lightZ[i] = 0.0f;
+        lightRadius[i] = -1.0f;
+    }
+
+    JobSystem::parallelFor(slices, 1, [&](unsigned int begin, unsigned int end) {
+        for (unsigned int s = begin; s < end; ++s) assignSlice(s);
+    });
+
+    // concatenate the slice lists, the ranges were written relative to their slice
+    size_t total = 0;
+    for (const std::vector<uint32_t> &list : sliceIndices) total += list.size();
+    indexCount = total;
+    indices = Memory::frameArena().allocateArray<uint32_t>(std::max<size_t>(total, 1));
+    if (!indices) {
+        indexFallback.resize(std::max<size_t>(total, 1));
+        indices = indexFallback.data();
+    }
+    size_t base = 0;
+    unsigned int clustersPerSlice = tilesX * tilesY;
+    for (unsigned int s = 0; s < slices; ++s) {
+        const std::vector<uint32_t> &list = sliceIndices[s];
+        if (!list.empty()) memcpy(indices + base, list.data(), list.size() * sizeof(uint32_t));
+        for (unsigned int c = s * clustersPerSlice; c < (s + 1) * clustersPerSlice; ++c) ranges[size_t(c) * 2] += uint32_t(base);
+        base += list.size();
+    }
+}
+
+void LightClusters::assignSlice(unsigned int slice) {
+    std::vector<uint32_t> &list = sliceIndices[slice];
+    list.clear();
+    float nearDepth = sliceNear[slice], farDepth = sliceFar[slice];
+
+    // lights overlapping the depth range of the slice, then the ones overlapping a row of tiles, then the tiles
+    ScratchScope scratch;
+    size_t padded = paddedCount + 4;
+    SphereList sliceLights = SphereList::allocate(scratch, padded), rowLights = SphereList::allocate(scratch, padded);
+    for (size_t i = 0; i < lightCount; ++i) {
+        float depth = -lightZ[i], radius = lightRadius[i];
+        if (depth + radius < nearDepth || depth - radius > farDepth) continue;
+        sliceLights.push(lightX[i], lightY[i], lightZ[i], radius * radius, uint32_t(i));
+    }
+    sliceLights.pad();
+
+    for (unsigned int y = 0; y < tilesY; ++y) {
+        size_t rowFirst = (size_t(slice) * tilesY + y) * tilesX, rowLast = rowFirst + tilesX - 1;
+        const float rowLow[3] = {boundsMinX[rowFirst], boundsMinY[rowFirst], boundsMinZ[rowFirst]};
+        const float rowHigh[3] = {boundsMaxX[rowLast], boundsMaxY[rowFirst], boundsMaxZ[rowFirst]};
+        rowLights.count = 0;
+        touchingSpheres(rowLow, rowHigh, sliceLights, [&](size_t i) {
+            rowLights.push(sliceLights.x[i], sliceLights.y[i], sliceLights.z[i], sliceLights.radius2[i], sliceLights.index[i]);
+        });
+        rowLights.pad();
+
+        for (size_t c = rowFirst; c <= rowLast; ++c) {
+            size_t first = list.size();
+            const float low[3] = {boundsMinX[c], boundsMinY[c], boundsMinZ[c]};
+            const float high[3] = {boundsMaxX[c], boundsMaxY[c], boundsMaxZ[c]};
+            touchingSpheres(low, high, rowLights, [&](size_t i) { list.push_back(rowLights.index[i]); });
+            ranges[c * 2] = uint32_t(first);
+            ranges[c * 2 + 1] = uint32_t(list.size() - first);
+        }
+    }
+}
+
+bool LightClusters::touches(unsigned int cluster, const float center[3], float radius) const {
+    const float low[3] = {boundsMinX[cluster], boundsMinY[cluster], boundsMinZ[cluster]};
+    const float high[3] = {boundsMaxX[cluster], boundsMaxY[cluster], boundsMaxZ[cluster]};
+    return radius >= 0.0f && distanceSquared(center, low, high) <= radius * radius;
+}
+
+void LightClusters::upload() {
+    if (!buffers[0]) {
+        glGenBuffers(3, buffers);
+        glGenTextures(3, textures);
+    }
+    // the buffers are orphaned every frame, the texture buffer objects keep pointing at them
+    const GLenum formats[3] = {GL_RGBA32F, GL_RG32UI, GL_R32UI};
+    const void *data[3] = {lights, ranges.data(), indices};
+    size_t sizes[3] = {lightCount * sizeof(PointLight), ranges.size() * sizeof(uint32_t), indexCount * sizeof(uint32_t)};
+    for (int i = 0; i < 3; ++i) {
+        glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+        // empty buffers are replaced by one zero texel so the sampler stays complete
+        static const uint32_t EMPTY[4] = {0, 0, 0, 0};
+        glBufferData(GL_TEXTURE_BUFFER, GLsizeiptr(sizes[i] ? sizes[i] : sizeof(EMPTY)), sizes[i] ? data[i] : EMPTY, GL_STREAM_DRAW);
+        glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+        glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers[i]);
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+void LightClusters::bind(GLuint program) const {
+    const GLint units[3] = {LIGHT_TEXTURE_UNIT, CLUSTER_TEXTURE_UNIT, INDEX_TEXTURE_UNIT};
+    const char *samplers[3] = {"lights", "clusterRanges", "lightIndices"};
+    for (int i = 0; i < 3; ++i) {
+        glActiveTexture(GL_TEXTURE0 + units[i]);
+        glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+        glUniform1i(glGetUniformLocation(program, samplers[i]), units[i]);
+    }
+    glActiveTexture(GL_TEXTURE0);
+
+    glUniform3ui(glGetUniformLocation(program, "clusterGrid"), tilesX, tilesY, slices);
+    glUniform2f(glGetUniformLocation(program, "tileScale"), float(tilesX) / float(viewportWidth),
+                float(tilesY) / float(viewportHeight));
+    glUniform2f(glGetUniformLocation(program, "sliceTransform"), sliceScale, sliceBias);
+    glUniform2f(glGetUniformLocation(program, "depthRange"), zNear, zFar);
+}
+
+void LightClusters::destroy() {
+    if (buffers[0]) {
+        glDeleteBuffers(3, buffers);
+        glDeleteTextures(3, textures);
+    }
+    std::fill(buffers, buffers + 3, 0);
+    std::fill(textures, textures + 3, 0);
+}
@@ -0,0 +1,108 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#ifndef LIGHTCLUSTERS_H
+#define LIGHTCLUSTERS_H
+#include <glad/gl.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+/** Point light as uploaded to the lights buffer of ClusteredShader.frag (two RGBA32F texels) */
+struct PointLight {
+    float position[3];  // world space
+    float radius;       // the light has no influence beyond it
+    float color[3];
+    float intensity;
+};
+static_assert(sizeof(PointLight) == 32, "PointLight is uploaded as is");
+
+/** Clustered forward lighting: the view frustum is split into tilesX x tilesY screen tiles and slices depth slices
+ *  (exponentially spaced between zNear and zFar), every cluster gets the list of point lights touching it
+ *
+ *  assign() runs on the CPU: one job per depth slice, lights are narrowed down to the slice, then to each row of tiles
+ *  and finally tested four at a time (SSE2) against the view space bounding box of every cluster of the row. The result is a compact
+ *  index list plus (first index, count) per cluster, upload() copies both and the lights into texture buffers
+ *  (core since 3.1, so the clustered path also runs on 3.3 contexts) that ClusteredShader.frag reads.
+ *
+ *  The view space lights and the index list of assign() live in Memory::frameArena(), call it once per frame after
+ *  Memory::beginFrame(). They fall back to member vectors when the arena is exhausted.
+ */
+class LightClusters {
+public:
+    /** Texture units used by bind(): lights, cluster ranges and light indices */
+    static constexpr GLint LIGHT_TEXTURE_UNIT = 4;
+    static constexpr GLint CLUSTER_TEXTURE_UNIT = 5;
+    static constexpr GLint INDEX_TEXTURE_UNIT = 6;
+
+    explicit LightClusters(unsigned int tilesX = 16, unsigned int tilesY = 9, unsigned int slices = 24);
+    LightClusters(const LightClusters &) = delete;
+    LightClusters &operator=(const LightClusters &) = delete;
+    ~LightClusters();
+
+    /** Builds the cluster bounds, call whenever the projection or the viewport changes
+     *
+     *  @param[in] fovY Vertical field of view in radians
+     */
+    void setProjection(float fovY, float aspect, float nearPlane, float farPlane, unsigned int viewportWidth,
+                       unsigned int viewportHeight);
+    /** Changes the viewport size only, the cluster bounds do not depend on it (dynamic resolution) */
+    void setViewport(unsigned int width, unsigned int height);
+
+    /** Assigns the lights to the clusters
+     *
+     *  @param[in] view Column major world to view matrix (rigid, looking down -z)
+     */
+    void assign(const float view[16], const PointLight *lights, size_t lightCount);
+
+    /** Uploads the lights of the last assign() and the cluster lists into the texture buffers */
+    void upload();
+    /** Binds the texture buffers and sets the cluster uniforms of a program using ClusteredShader.frag */
+    void bind(GLuint program) const;
+
+    unsigned int clusterCount() const { return tilesX * tilesY * slices; }
+    /** @returns First index and count of the lights of a cluster, clusters are ordered x fastest, then y, then slice */
+    const uint32_t *clusterRange(unsigned int cluster) const { return &ranges[size_t(cluster) * 2]; }
+    /** @returns Light indices of all clusters, valid until the next frame ends */
+    const uint32_t *lightIndices() const { return indices; }
+    size_t lightIndexCount() const { return indexCount; }
+
+    /** @returns true if the light (view space center, radius) touches the cluster, the test assign() runs */
+    bool touches(unsigned int cluster, const float center[3], float radius) const;
+
+    void destroy();
+
+private:
+    void assignSlice(unsigned int slice);
+
+    unsigned int tilesX, tilesY, slices;
+    float zNear = 0.1f, zFar = 100.0f;
+    float sliceScale = 0.0f, sliceBias = 0.0f;   // slice = log(depth) * sliceScale + sliceBias
+    unsigned int viewportWidth = 1, viewportHeight = 1;
+    std::vector<float> sliceNear, sliceFar;      // view space depth range (positive) of every slice
+    // view space bounds of every cluster, same order as the ranges
+    std::vector<float> boundsMinX, boundsMinY, boundsMinZ, boundsMaxX, boundsMaxY, boundsMaxZ;
+
+    // lights of the current assign() in view space, padded to a multiple of 4, in the frame arena
+    float *lightX = nullptr, *lightY = nullptr, *lightZ = nullptr, *lightRadius = nullptr;
+    size_t paddedCount = 0;
+    const PointLight *lights = nullptr;
+    size_t lightCount = 0;
+
+    std::vector<std::vector<uint32_t>> sliceIndices;  // per slice, reused between frames
+    std::vector<uint32_t> ranges;                     // first index and count per cluster
+    uint32_t *indices = nullptr;                      // in the frame arena
+    size_t indexCount = 0;
+    // used instead of the frame arena when it is exhausted
+    std::vector<float> lightFallback;
+    std::vector<uint32_t> indexFallback;
+
+    GLuint buffers[3] = {0, 0, 0};    // lights, ranges, indices
+    GLuint textures[3] = {0, 0, 0};
+};
+
+
+
+#endif //LIGHTCLUSTERS_H
@@ -0,0 +1,85 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#include "MappedFile.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const char *filename) {
+    close();
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize)) {
+        CloseHandle(file);
+        return false;
+    }
+    fileHandle = file;
+    length = size_t(fileSize.QuadPart);
+    if (length == 0) return true;
+
+    mappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mappingHandle) {
+        close();
+        return false;
+    }
+    pointer = static_cast<const unsigned char *>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+    if (!pointer) {
+        close();
+        return false;
+    }
+    return true;
+#else
+    int file = ::open(filename, O_RDONLY);
+    if (file < 0) return false;
+
+    struct stat status{};
+    if (fstat(file, &status) != 0 || !S_ISREG(status.st_mode)) {
+        ::close(file);
+        return false;
+    }
+    length = size_t(status.st_size);
+    if (length == 0) {
+        ::close(file);
+        return true;
+    }
+
+    void *mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, file, 0);
+    ::close(file); // the mapping keeps its own reference to the file
+    if (mapping == MAP_FAILED) {
+        length = 0;
+        return false;
+    }
+    pointer = static_cast<const unsigned char *>(mapping);
+    return true;
+#endif
+}
+
+void MappedFile::close() {
+#ifdef _WIN32
+    if (pointer) UnmapViewOfFile(pointer);
+    if (mappingHandle) CloseHandle(mappingHandle);
+    if (fileHandle) CloseHandle(fileHandle);
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+#else
+    if (pointer) munmap(const_cast<unsigned char *>(pointer), length);
+#endif
+    pointer = nullptr;
+    length = 0;
+}
@@ -0,0 +1,40 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+#include <cstddef>
+
+
+/** Read only memory mapping of a whole file, unmapped on destruction */
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    ~MappedFile();
+
+    /** Maps the file into memory
+     *
+     *  @param[in] filename The path to the file
+     *  @returns false if the file could not be opened or mapped (empty files map to a null view)
+     */
+    bool open(const char *filename);
+    void close();
+
+    const unsigned char *data() const { return pointer; }
+    size_t size() const { return length; }
+
+private:
+    const unsigned char *pointer = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    void *fileHandle = nullptr;
+    void *mappingHandle = nullptr;
+#endif
+};
+
+
+
+#endif //MAPPEDFILE_H
@@ -0,0 +1,230 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#include "Memory.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+namespace {
+    struct TagCounters {
+        std::atomic<size_t> bytes{0};
+        std::atomic<size_t> peakBytes{0};
+        std::atomic<size_t> allocations{0};
+        std::atomic<uint64_t> totalAllocations{0};
+    };
+
+    TagCounters counters[size_t(MemoryTag::Count)];
+    std::atomic<uint64_t> heapAllocationCount{0};
+
+    const char *const TAG_NAMES[size_t(MemoryTag::Count)] = {
+        "General", "Shaders", "Textures", "Meshes", "Culling", "Particles", "Voxels", "Jobs", "Scratch", "Frame"
+    };
+
+    size_t alignUp(size_t value, size_t alignment) {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    void *heapAllocate(size_t size, size_t alignment = alignof(std::max_align_t)) {
+        heapAllocationCount.fetch_add(1, std::memory_order_relaxed);
+        size = std::max<size_t>(size, 1);
+        if (alignment <= alignof(std::max_align_t)) return std::malloc(size);
+#ifdef _WIN32
+        return _aligned_malloc(size, alignment);
+#else
+        // aligned_alloc wants a multiple of the alignment
+        return std::aligned_alloc(alignment, alignUp(size, alignment));
+#endif
+    }
+
+    void heapFree(void *pointer, size_t alignment) {
+#ifdef _WIN32
+        if (alignment > alignof(std::max_align_t)) {
+            _aligned_free(pointer);
+            return;
+        }
+#endif
+        (void) alignment;
+        std::free(pointer);
+    }
+
+    LinearArena &scratchArena() {
+        thread_local LinearArena arena(Memory::SCRATCH_SIZE, MemoryTag::Scratch);
+        return arena;
+    }
+
+    // the arena of the current frame and the one of the previous frame, which may still be read
+    LinearArena *frameArenas[2] = {nullptr, nullptr};
+    unsigned int frameArenaIndex = 0;
+}
+
+// every global allocation is counted so steady state frames can be checked for heap traffic
+void *operator new(size_t size) {
+    void *pointer = heapAllocate(size);
+    if (!pointer) throw std::bad_alloc();
+    return pointer;
+}
+
+void *operator new[](size_t size) {
+    void *pointer = heapAllocate(size);
+    if (!pointer) throw std::bad_alloc();
+    return pointer;
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+    return heapAllocate(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+    return heapAllocate(size);
+}
+
+void operator delete(void *pointer) noexcept { std::free(pointer); }
+void operator delete[](void *pointer) noexcept { std::free(pointer); }
+void operator delete(void *pointer, size_t) noexcept { std::free(pointer); }
+void operator delete[](void *pointer, size_t) noexcept { std::free(pointer); }
+void operator delete(void *pointer, const std::nothrow_t &) noexcept { std::free(pointer); }
+void operator delete[](void *pointer, const std::nothrow_t &) noexcept { std::free(pointer); }
+
+// over-aligned types and Memory::allocate() come through here, counted like the rest
+void *operator new(size_t size, std::align_val_t alignment) {
+    void *pointer = heapAllocate(size, size_t(alignment));
+    if (!pointer) throw std::bad_alloc();
+    return pointer;
+}
+
+void *operator new[](size_t size, std::align_val_t alignment) {
+    void *pointer = heapAllocate(size, size_t(alignment));
+    if (!pointer) throw std::bad_alloc();
+    return pointer;
+}
+
+void *operator new(size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+    return heapAllocate(size, size_t(alignment));
+}
+
+void *operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+    return heapAllocate(size, size_t(alignment));
+}
+
+void operator delete(void *pointer, std::align_val_t alignment) noexcept { heapFree(pointer, size_t(alignment)); }
+void operator delete[](void *pointer, std::align_val_t alignment) noexcept { heapFree(pointer, size_t(alignment)); }
+void operator delete(void *pointer, size_t, std::align_val_t alignment) noexcept {
+    heapFree(pointer, size_t(alignment));
+}
+void operator delete[](void *pointer, size_t, std::align_val_t alignment) noexcept {
+    heapFree(pointer, size_t(alignment));
+}
+void operator delete(void *pointer, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+    heapFree(pointer, size_t(alignment));
+}
+void operator delete[](void *pointer, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+    heapFree(pointer, size_t(alignment));
+}
+
+void *Memory::allocate(size_t size, MemoryTag tag, size_t alignment) {
+    TagCounters &counter = counters[size_t(tag)];
+    size_t bytes = counter.bytes.fetch_add(size, std::memory_order_relaxed) + size;
+    size_t peak = counter.peakBytes.load(std::memory_order_relaxed);
+    while (bytes > peak && !counter.peakBytes.compare_exchange_weak(peak, bytes, std::memory_order_relaxed)) {}
+    counter.allocations.fetch_add(1, std::memory_order_relaxed);
+    counter.totalAllocations.fetch_add(1, std::memory_order_relaxed);
+    return ::operator new(size > 0 ? size : 1, std::align_val_t(std::max(alignment, sizeof(void *))));
+}
+
+void Memory::free(void *pointer, size_t size, MemoryTag tag, size_t alignment) {
+    if (!pointer) return;
+    TagCounters &counter = counters[size_t(tag)];
+    counter.bytes.fetch_sub(size, std::memory_order_relaxed);
+    counter.allocations.fetch_sub(1, std::memory_order_relaxed);
+    ::operator delete(pointer, std::align_val_t(std::max(alignment, sizeof(void *))));
+}
+
+MemoryStats Memory::stats(MemoryTag tag) {
+    const TagCounters &counter = counters[size_t(tag)];
+    MemoryStats result;
+    result.bytes = counter.bytes.load(std::memory_order_relaxed);
+    result.peakBytes = counter.peakBytes.load(std::memory_order_relaxed);
+    result.allocations = counter.allocations.load(std::memory_order_relaxed);
+    result.totalAllocations = counter.totalAllocations.load(std::memory_order_relaxed);
+    return result;
+}
+
+const char *Memory::tagName(MemoryTag tag) {
+    return tag < MemoryTag::Count ? TAG_NAMES[size_t(tag)] : "Unknown";
+}
+
+void Memory::printStats() {
+    printf("Heap allocations: %llu\n", static_cast<unsigned long long>(heapAllocations()));
+    for (size_t i = 0; i < size_t(MemoryTag::Count); ++i) {
+        MemoryStats tagStats = stats(MemoryTag(i));
+        if (tagStats.totalAllocations == 0) continue;
+        printf("  %-8s %10zu bytes in %zu allocations (peak %zu bytes, %llu allocations in total)\n",
+               tagName(MemoryTag(i)), tagStats.bytes, tagStats.allocations, tagStats.peakBytes,
+               static_cast<unsigned long long>(tagStats.totalAllocations));
+    }
+}
+
+uint64_t Memory::heapAllocations() {
+    return heapAllocationCount.load(std::memory_order_relaxed);
+}
+
+void Memory::beginFrame() {
+    frameArenaIndex ^= 1;
+    frameArena().reset();
+}
+
+LinearArena &Memory::frameArena() {
+    LinearArena *&arena = frameArenas[frameArenaIndex];
+    if (!arena) {
+        static LinearArena arenas[2] = {{FRAME_ARENA_SIZE, MemoryTag::Frame}, {FRAME_ARENA_SIZE, MemoryTag::Frame}};
+        frameArenas[0] = &arenas[0];
+        frameArenas[1] = &arenas[1];
+    }
+    return *arena;
+}
+
+LinearArena::LinearArena(size_t capacity, MemoryTag tag)
+    : block(static_cast<unsigned char *>(Memory::allocate(capacity, tag, 64))), size(capacity), tag(tag) {}
+
+LinearArena::~LinearArena() {
+    Memory::free(block, size, tag, 64);
+}
+
+void *LinearArena::allocate(size_t bytes, size_t alignment) {
+    size_t offset = alignUp(head, alignment);
+    if (offset + bytes > size) return nullptr;
+    head = offset + bytes;
+    peakUsed = std::max(peakUsed, head);
+    return block + offset;
+}
+
+ScratchScope::ScratchScope() : arena(scratchArena()), marker(arena.marker()) {}
+
+ScratchScope::~ScratchScope() {
+    arena.rewind(marker);
+    while (overflow) {
+        Overflow *next = overflow->next;
+        Memory::free(overflow, overflow->size, MemoryTag::Scratch, 64);
+        overflow = next;
+    }
+}
+
+void *ScratchScope::allocate(size_t size, size_t alignment) {
+    if (void *pointer = arena.allocate(size, alignment)) return pointer;
+
+    // the header is padded to the alignment so the returned memory stays aligned (up to 64 bytes)
+    size_t header = alignUp(sizeof(Overflow), std::max<size_t>(alignment, 16));
+    Overflow *block = static_cast<Overflow *>(Memory::allocate(header + size, MemoryTag::Scratch, 64));
+    block->next = overflow;
+    block->size = header + size;
+    overflow = block;
+    return reinterpret_cast<unsigned char *>(block) + header;
+}
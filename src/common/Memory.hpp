@@ -0,0 +1,230 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#ifndef MEMORY_H
+#define MEMORY_H
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+
+/** Subsystem an allocation is accounted to */
+enum class MemoryTag : uint8_t {
+    General,
+    Shaders,
+    Textures,
+    Meshes,
+    Culling,
+    Particles,
+    Voxels,
+    Jobs,
+    Scratch,    // per thread scratch stacks and their overflow
+    Frame,      // per frame arenas
+    Count
+};
+
+class LinearArena;
+
+/** Counters of one MemoryTag */
+struct MemoryStats {
+    size_t bytes = 0;          // currently allocated
+    size_t peakBytes = 0;
+    size_t allocations = 0;    // currently live
+    uint64_t totalAllocations = 0;
+};
+
+/** Tracked allocations, frame arenas and scratch stacks
+ *
+ *  Long lived engine memory goes through allocate() and free() (or TrackingAllocator), transient memory comes from
+ *  the frame arena (reset by beginFrame()) or a ScratchScope. heapAllocations() counts every global operator new as
+ *  well, a steady state frame should not change it.
+ */
+class Memory {
+public:
+    static void *allocate(size_t size, MemoryTag tag, size_t alignment = alignof(std::max_align_t));
+    static void free(void *pointer, size_t size, MemoryTag tag, size_t alignment = alignof(std::max_align_t));
+
+    static MemoryStats stats(MemoryTag tag);
+    static const char *tagName(MemoryTag tag);
+    /** Prints the counters of all tags with live or past allocations */
+    static void printStats();
+
+    /** @returns Heap allocations since program start: global operator new (plain and aligned, allocate() uses the
+     *           latter) of all threads
+     *  @note Drivers written in C++ (e.g. the LLVM of Mesa's llvmpipe) go through the same operator new
+     */
+    static uint64_t heapAllocations();
+
+    /** Starts a new frame, the frame arena of two frames ago is reset (main thread only) */
+    static void beginFrame();
+    /** @returns Bump arena of the current frame, its memory stays valid until the next frame ends */
+    static LinearArena &frameArena();
+
+    /** Capacity of the frame arenas and of each thread's scratch stack, allocated on first use */
+    static constexpr size_t FRAME_ARENA_SIZE = 1 << 20;
+    static constexpr size_t SCRATCH_SIZE = 4 << 20;
+};
+
+/** Bump allocator over one fixed block, freed all at once by reset() or down to a marker by rewind() */
+class LinearArena {
+public:
+    LinearArena(size_t capacity, MemoryTag tag);
+    LinearArena(const LinearArena &) = delete;
+    LinearArena &operator=(const LinearArena &) = delete;
+    ~LinearArena();
+
+    /** @returns nullptr if the block is exhausted */
+    void *allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+    /** Uninitialized storage for count objects */
+    template<typename T>
+    T *allocateArray(size_t count) { return static_cast<T *>(allocate(count * sizeof(T), alignof(T))); }
+
+    size_t marker() const { return head; }
+    void rewind(size_t position) { if (position < head) head = position; }
+    void reset() { head = 0; }
+
+    size_t used() const { return head; }
+    size_t peak() const { return peakUsed; }
+    size_t capacity() const { return size; }
+
+private:
+    unsigned char *block;
+    size_t size;
+    size_t head = 0;
+    size_t peakUsed = 0;
+    MemoryTag tag;
+};
+
+/** Stack allocation from the calling thread's scratch arena, everything allocated through it is released by its
+ *  destructor. Requests that do not fit the arena go to the heap (tagged Scratch) instead of failing.
+ */
+class ScratchScope {
+public:
+    ScratchScope();
+    ScratchScope(const ScratchScope &) = delete;
+    ScratchScope &operator=(const ScratchScope &) = delete;
+    ~ScratchScope();
+
+    void *allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+    template<typename T>
+    T *allocateArray(size_t count) { return static_cast<T *>(allocate(count * sizeof(T), alignof(T))); }
+
+private:
+    struct Overflow {
+        Overflow *next;
+        size_t size;
+    };
+
+    LinearArena &arena;
+    size_t marker;
+    Overflow *overflow = nullptr;
+};
+
+/** Fixed size slots for objects of one type, handed out from a free list and grown in chunks
+ *
+ *  create() and destroy() do not touch the heap once enough chunks exist. Objects still alive when the pool is
+ *  destroyed are not destructed.
+ */
+template<typename T>
+class ObjectPool {
+public:
+    explicit ObjectPool(size_t objectsPerChunk = 64, MemoryTag tag = MemoryTag::General)
+        : objectsPerChunk(objectsPerChunk > 0 ? objectsPerChunk : 1), tag(tag) {}
+    ObjectPool(const ObjectPool &) = delete;
+    ObjectPool &operator=(const ObjectPool &) = delete;
+
+    ~ObjectPool() {
+        while (chunks) {
+            Chunk *next = chunks->next;
+            Memory::free(chunks, chunkBytes(), tag, chunkAlignment());
+            chunks = next;
+        }
+    }
+
+    template<typename... Args>
+    T *create(Args &&... args) {
+        if (!freeList) grow();
+        Slot *slot = freeList;
+        freeList = slot->next;
+        ++live;
+        return new(slot->storage) T(std::forward<Args>(args)...);
+    }
+
+    void destroy(T *object) {
+        if (!object) return;
+        object->~T();
+        Slot *slot = reinterpret_cast<Slot *>(object);
+        slot->next = freeList;
+        freeList = slot;
+        --live;
+    }
+
+    /** Makes room for at least count live objects */
+    void reserve(size_t count) {
+        while (capacityCount < count) grow();
+    }
+
+    size_t size() const { return live; }
+    size_t capacity() const { return capacityCount; }
+
+private:
+    union Slot {
+        Slot *next;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+    struct Chunk {
+        Chunk *next;
+    };
+
+    static size_t chunkAlignment() { return alignof(Slot) > alignof(Chunk) ? alignof(Slot) : alignof(Chunk); }
+    // the chunk header is padded so the slots after it stay aligned
+    static size_t headerBytes() { return (sizeof(Chunk) + alignof(Slot) - 1) / alignof(Slot) * alignof(Slot); }
+    size_t chunkBytes() const { return headerBytes() + objectsPerChunk * sizeof(Slot); }
+
+    void grow() {
+        Chunk *chunk = static_cast<Chunk *>(Memory::allocate(chunkBytes(), tag, chunkAlignment()));
+        chunk->next = chunks;
+        chunks = chunk;
+        Slot *slots = reinterpret_cast<Slot *>(reinterpret_cast<unsigned char *>(chunk) + headerBytes());
+        for (size_t i = objectsPerChunk; i-- > 0;) {
+            slots[i].next = freeList;
+            freeList = &slots[i];
+        }
+        capacityCount += objectsPerChunk;
+    }
+
+    size_t objectsPerChunk;
+    MemoryTag tag;
+    Chunk *chunks = nullptr;
+    Slot *freeList = nullptr;
+    size_t live = 0;
+    size_t capacityCount = 0;
+};
+
+/** Standard library allocator accounting to a MemoryTag, e.g. std::vector<float, TrackingAllocator<float, MemoryTag::Meshes>> */
+template<typename T, MemoryTag Tag>
+struct TrackingAllocator {
+    typedef T value_type;
+    template<typename U>
+    struct rebind {
+        typedef TrackingAllocator<U, Tag> other;
+    };
+
+    TrackingAllocator() = default;
+    template<typename U>
+    TrackingAllocator(const TrackingAllocator<U, Tag> &) {}
+
+    T *allocate(size_t count) { return static_cast<T *>(Memory::allocate(count * sizeof(T), Tag, alignof(T))); }
+    void deallocate(T *pointer, size_t count) { Memory::free(pointer, count * sizeof(T), Tag, alignof(T)); }
+
+    template<typename U>
+    bool operator==(const TrackingAllocator<U, Tag> &) const { return true; }
+    template<typename U>
+    bool operator!=(const TrackingAllocator<U, Tag> &) const { return false; }
+};
+
+
+
+#endif //MEMORY_H
@@ -0,0 +1,406 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#include "MeshOptimizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+
+namespace {
+    // modelled LRU cache, large enough for every GPU since ~2008
+    constexpr unsigned int CACHE_SIZE = 32;
+    constexpr size_t NONE = ~size_t(0);
+
+    /** Forsyth's vertex score: recently used vertices and vertices with few remaining triangles score high */
+    float vertexScore(int cachePosition, unsigned int remaining) {
+        if (remaining == 0) return -1.0f;
+        float score = 0.0f;
+        if (cachePosition >= 0) {
+            // the last triangle's vertices get a fixed score so its neighbours do not win by a tiny margin
+            score = cachePosition < 3 ? 0.75f
+                  : std::pow(1.0f - float(cachePosition - 3) / float(CACHE_SIZE - 3), 1.5f);
+        }
+        return score + 2.0f / std::sqrt(float(remaining));
+    }
+
+    /** Symmetric 4x4 error quadric plus the accumulated area, evaluate() / weight is a squared distance */
+    struct Quadric {
+        double a00 = 0, a01 = 0, a02 = 0, a03 = 0, a11 = 0, a12 = 0, a13 = 0, a22 = 0, a23 = 0, a33 = 0;
+        double weight = 0;
+
+        void addPlane(double x, double y, double z, double d, double w) {
+            a00 += w * x * x; a01 += w * x * y; a02 += w * x * z; a03 += w * x * d;
+            a11 += w * y * y; a12 += w * y * z; a13 += w * y * d;
+            a22 += w * z * z; a23 += w * z * d;
+            a33 += w * d * d;
+            weight += w;
+        }
+
+        void add(const Quadric &q) {
+            a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+            a11 += q.a11; a12 += q.a12; a13 += q.a13;
+            a22 += q.a22; a23 += q.a23;
+            a33 += q.a33;
+            weight += q.weight;
+        }
+
+        double evaluate(double x, double y, double z) const {
+            return a00 * x * x + 2 * a01 * x * y + 2 * a02 * x * z + 2 * a03 * x
+                 + a11 * y * y + 2 * a12 * y * z + 2 * a13 * y
+                 + a22 * z * z + 2 * a23 * z + a33;
+        }
+    };
+
+    struct Collapse {
+        unsigned int from;
+        unsigned int to;
+        double cost;
+    };
+
+    /** Bitwise float tuple as hash map key, used to weld vertices */
+    template <size_t N>
+    struct FloatKey {
+        float values[N];
+        bool operator==(const FloatKey &other) const { return memcmp(values, other.values, sizeof(values)) == 0; }
+    };
+
+    template <size_t N>
+    struct FloatKeyHash {
+        size_t operator()(const FloatKey<N> &key) const {
+            uint64_t hash = 14695981039346656037ull;
+            const unsigned char *bytes = reinterpret_cast<const unsigned char *>(key.values);
+            for (size_t i = 0; i < sizeof(key.values); ++i) {
+                hash ^= bytes[i];
+                hash *= 1099511628211ull;
+            }
+            return size_t(hash);
+        }
+    };
+
+    void cross(const float *a, const float *b, const float *c, double *normal) {
+        double e1[3], e2[3];
+        for (int axis = 0; axis < 3; ++axis) {
+            e1[axis] = double(b[axis]) - a[axis];
+            e2[axis] = double(c[axis]) - a[axis];
+        }
+        normal[0] = e1[1] * e2[2] - e1[2] * e2[1];
+        normal[1] = e1[2] * e2[0] - e1[0] * e2[2];
+        normal[2] = e1[0] * e2[1] - e1[1] * e2[0];
+    }
+}
+
+void MeshOptimizer::optimizeVertexCache(unsigned int *indices, size_t indexCount, size_t vertexCount) {
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0) return;
+
+    // triangles per vertex, emitted triangles are swapped behind the remaining ones
+    std::vector<unsigned int> remaining(vertexCount, 0);
+    for (size_t i = 0; i < triangleCount * 3; ++i) ++remaining[indices[i]];
+    std::vector<size_t> offsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; ++v) offsets[v + 1] = offsets[v] + remaining[v];
+    std::vector<unsigned int> adjacency(triangleCount * 3);
+    {
+        std::vector<size_t> cursor(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < triangleCount * 3; ++i) adjacency[cursor[indices[i]]++] = unsigned(i / 3);
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> score(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v) score[v] = vertexScore(-1, remaining[v]);
+    std::vector<float> triangleScore(triangleCount);
+    std::vector<bool> emitted(triangleCount, false);
+    size_t best = 0;
+    for (size_t t = 0; t < triangleCount; ++t) {
+        triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+        if (triangleScore[t] > triangleScore[best]) best = t;
+    }
+
+    std::vector<unsigned int> output(triangleCount * 3);
+    unsigned int cache[CACHE_SIZE + 3];
+    unsigned int cacheCount = 0;
+    size_t scanCursor = 0;
+    for (size_t out = 0; out < triangleCount; ++out) {
+        if (best == NONE) {
+            // nothing in the cache touches a remaining triangle, continue with the next unused one
+            while (emitted[scanCursor]) ++scanCursor;
+            best = scanCursor;
+        }
+        emitted[best] = true;
+        const unsigned int *triangle = indices + best * 3;
+        memcpy(output.data() + out * 3, triangle, 3 * sizeof(unsigned int));
+
+        // the triangle's vertices move to the front of the cache
+        unsigned int next[CACHE_SIZE + 3];
+        unsigned int nextCount = 0;
+        for (int k = 0; k < 3; ++k) {
+            unsigned int v = triangle[k];
+            unsigned int *first = adjacency.data() + offsets[v];
+            unsigned int *last = first + remaining[v];
+            std::iter_swap(std::find(first, last, unsigned(best)), last - 1);
+            --remaining[v];
+            if (std::find(next, next + nextCount, v) == next + nextCount) next[nextCount++] = v;
+        }
+        unsigned int triangleVertices = nextCount;
+        for (unsigned int i = 0; i < cacheCount; ++i) {
+            unsigned int v = cache[i];
+            if (std::find(next, next + triangleVertices, v) == next + triangleVertices) next[nextCount++] = v;
+        }
+
+        // rescore everything that moved, including the vertices that just fell out of the cache
+        for (unsigned int i = 0; i < nextCount; ++i) {
+            unsigned int v = next[i];
+            cachePosition[v] = i < CACHE_SIZE ? int(i) : -1;
+            float updated = vertexScore(cachePosition[v], remaining[v]);
+            float delta = updated - score[v];
+            score[v] = updated;
+            for (size_t a = offsets[v]; a < offsets[v] + remaining[v]; ++a) triangleScore[adjacency[a]] += delta;
+        }
+        cacheCount = std::min(nextCount, CACHE_SIZE);
+        std::copy(next, next + cacheCount, cache);
+
+        best = NONE;
+        float bestScore = -1e30f;
+        for (unsigned int i = 0; i < cacheCount; ++i) {
+            unsigned int v = cache[i];
+            for (size_t a = offsets[v]; a < offsets[v] + remaining[v]; ++a) {
+                if (triangleScore[adjacency[a]] > bestScore) {
+                    bestScore = triangleScore[adjacency[a]];
+                    best = adjacency[a];
+                }
+            }
+        }
+    }
+    std::copy(output.begin(), output.end(), indices);
+}
+
+void MeshOptimizer::optimizeVertexFetch(MeshData &mesh) {
+    std::vector<unsigned int> remap(mesh.vertices.size(), ~0u);
+    std::vector<Vertex> vertices;
+    vertices.reserve(mesh.vertices.size());
+    for (unsigned int &index : mesh.indices) {
+        if (remap[index] == ~0u) {
+            remap[index] = unsigned(vertices.size());
+            vertices.push_back(mesh.vertices[index]);
+        }
+        index = remap[index];
+    }
+    mesh.vertices = std::move(vertices);
+}
+
+double MeshOptimizer::averageCacheMissRatio(const unsigned int *indices, size_t indexCount, size_t vertexCount,
+                                            unsigned int cacheSize) {
+    if (indexCount < 3) return 0.0;
+    // a vertex is still in the FIFO while fewer than cacheSize misses happened after it was inserted
+    std::vector<size_t> inserted(vertexCount, 0);
+    size_t misses = 0;
+    for (size_t i = 0; i < indexCount; ++i) {
+        size_t &stamp = inserted[indices[i]];
+        if (stamp == 0 || misses - stamp >= cacheSize) stamp = ++misses;
+    }
+    return double(misses) / double(indexCount / 3);
+}
+
+float MeshOptimizer::simplify(const MeshData &mesh, const unsigned int *indices, size_t indexCount, size_t targetIndexCount,
+                              float targetError, std::vector<unsigned int> &result) {
+    result.assign(indices, indices + indexCount / 3 * 3);
+    if (result.size() <= targetIndexCount) return 0.0f;
+    const std::vector<Vertex> &vertices = mesh.vertices;
+    size_t vertexCount = vertices.size();
+
+    // weld vertices with identical position and uv, lock uv seams and hard normal edges
+    std::vector<unsigned int> wedge(vertexCount, ~0u);
+    std::vector<bool> locked(vertexCount, false);
+    {
+        std::unordered_map<FloatKey<5>, unsigned int, FloatKeyHash<5>> wedges;
+        std::unordered_map<FloatKey<3>, unsigned int, FloatKeyHash<3>> positions;
+        wedges.reserve(result.size() / 2);
+        positions.reserve(result.size() / 2);
+        for (unsigned int index : result) {
+            if (wedge[index] != ~0u) continue;
+            const Vertex &vertex = vertices[index];
+            FloatKey<5> key = {{vertex.position[0], vertex.position[1], vertex.position[2], vertex.uv[0], vertex.uv[1]}};
+            auto [found, inserted] = wedges.try_emplace(key, index);
+            unsigned int representative = found->second;
+            wedge[index] = representative;
+            if (!inserted) {
+                const float *n = vertices[representative].normal;
+                if (n[0] * vertex.normal[0] + n[1] * vertex.normal[1] + n[2] * vertex.normal[2] < 0.9f) locked[representative] = true;
+                continue;
+            }
+            FloatKey<3> position = {{vertex.position[0], vertex.position[1], vertex.position[2]}};
+            auto [first, unique] = positions.try_emplace(position, representative);
+            if (!unique) locked[representative] = locked[first->second] = true;
+        }
+        for (unsigned int &index : result) index = wedge[index];
+    }
+
+    // area weighted plane quadrics
+    std::vector<Quadric> quadrics(vertexCount);
+    for (size_t i = 0; i < result.size(); i += 3) {
+        const float *p0 = vertices[result[i]].position;
+        double normal[3];
+        cross(p0, vertices[result[i + 1]].position, vertices[result[i + 2]].position, normal);
+        double length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        if (length == 0.0) continue;
+        for (double &n : normal) n /= length;
+        double d = -(normal[0] * p0[0] + normal[1] * p0[1] + normal[2] * p0[2]);
+        for (int k = 0; k < 3; ++k) quadrics[result[i + k]].addPlane(normal[0], normal[1], normal[2], d, length * 0.5);
+    }
+
+    auto cost = [&](unsigned int from, unsigned int to) {
+        Quadric q = quadrics[from];
+        q.add(quadrics[to]);
+        const Vertex &a = vertices[from], &b = vertices[to];
+        double distance = q.weight > 0.0 ? std::max(q.evaluate(b.position[0], b.position[1], b.position[2]) / q.weight, 0.0) : 0.0;
+
+        // attributes that differ along a long edge smear visibly when it collapses
+        double length = 0.0, dot = 0.0;
+        for (int axis = 0; axis < 3; ++axis) {
+            length += double(a.position[axis] - b.position[axis]) * (a.position[axis] - b.position[axis]);
+            dot += double(a.normal[axis]) * b.normal[axis];
+        }
+        double uv = double(a.uv[0] - b.uv[0]) * (a.uv[0] - b.uv[0]) + double(a.uv[1] - b.uv[1]) * (a.uv[1] - b.uv[1]);
+        return distance + length * (uv + std::max(1.0 - dot, 0.0));
+    };
+
+    // triangles around each vertex of the current result
+    std::vector<size_t> offsets(vertexCount + 1);
+    std::vector<unsigned int> adjacency;
+    auto buildAdjacency = [&] {
+        std::fill(offsets.begin(), offsets.end(), 0);
+        for (unsigned int index : result) ++offsets[index + 1];
+        for (size_t v = 0; v < vertexCount; ++v) offsets[v + 1] += offsets[v];
+        adjacency.resize(result.size());
+        std::vector<size_t> cursor(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < result.size(); ++i) adjacency[cursor[result[i]]++] = unsigned(i / 3);
+    };
+
+    // open borders: an edge a -> b without a triangle holding b -> a
+    buildAdjacency();
+    for (size_t i = 0; i < result.size(); i += 3) {
+        for (int e = 0; e < 3; ++e) {
+            unsigned int a = result[i + e], b = result[i + (e + 1) % 3];
+            bool shared = false;
+            for (size_t n = offsets[b]; n < offsets[b + 1] && !shared; ++n) {
+                const unsigned int *triangle = result.data() + size_t(adjacency[n]) * 3;
+                for (int k = 0; k < 3; ++k) shared = shared || (triangle[k] == b && triangle[(k + 1) % 3] == a);
+            }
+            if (!shared) locked[a] = locked[b] = true;
+        }
+    }
+
+    std::vector<unsigned int> remap(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v) remap[v] = unsigned(v);
+    std::vector<bool> touched(vertexCount);
+    std::vector<Collapse> collapses, best(vertexCount);
+    double limit = double(targetError) * targetError;
+    double maxCost = 0.0;
+
+    // passes of independent collapses, cheapest first
+    for (bool first = true; result.size() > targetIndexCount; first = false) {
+        if (!first) buildAdjacency();
+
+        // cheapest collapse per vertex, sorting one candidate per vertex instead of one per edge direction
+        std::fill(best.begin(), best.end(), Collapse{0, 0, -1.0});
+        for (size_t i = 0; i < result.size(); i += 3) {
+            for (int e = 0; e < 3; ++e) {
+                unsigned int a = result[i + e], b = result[i + (e + 1) % 3];
+                if (!locked[a]) {
+                    double c = cost(a, b);
+                    if (best[a].cost < 0.0 || c < best[a].cost) best[a] = {a, b, c};
+                }
+                if (!locked[b]) {
+                    double c = cost(b, a);
+                    if (best[b].cost < 0.0 || c < best[b].cost) best[b] = {b, a, c};
+                }
+            }
+        }
+        collapses.clear();
+        for (const Collapse &collapse : best) if (collapse.cost >= 0.0 && collapse.cost <= limit) collapses.push_back(collapse);
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse &a, const Collapse &b) { return a.cost < b.cost; });
+
+        std::fill(touched.begin(), touched.end(), false);
+        size_t removable = (result.size() - targetIndexCount) / 3, removed = 0, collapsed = 0;
+        for (const Collapse &collapse : collapses) {
+            if (collapse.cost > limit || removed >= removable) break;
+            if (touched[collapse.from] || touched[collapse.to]) continue;
+
+            // reject the collapse if a remaining triangle around the vertex would turn over
+            const float *target = vertices[collapse.to].position;
+            bool flips = false;
+            size_t degenerate = 0;
+            for (size_t a = offsets[collapse.from]; a < offsets[collapse.from + 1] && !flips; ++a) {
+                const unsigned int *triangle = result.data() + size_t(adjacency[a]) * 3;
+                unsigned int corners[3] = {remap[triangle[0]], remap[triangle[1]], remap[triangle[2]]};
+                if (corners[0] == collapse.to || corners[1] == collapse.to || corners[2] == collapse.to) {
+                    ++degenerate;
+                    continue;
+                }
+                const float *before[3], *after[3];
+                for (int k = 0; k < 3; ++k) {
+                    before[k] = vertices[corners[k]].position;
+                    after[k] = corners[k] == collapse.from ? target : before[k];
+                }
+                double n0[3], n1[3];
+                cross(before[0], before[1], before[2], n0);
+                cross(after[0], after[1], after[2], n1);
+                flips = n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2] <= 0.0;
+            }
+            if (flips) continue;
+
+            remap[collapse.from] = collapse.to;
+            touched[collapse.from] = touched[collapse.to] = true;
+            quadrics[collapse.to].add(quadrics[collapse.from]);
+            maxCost = std::max(maxCost, collapse.cost);
+            removed += degenerate;
+            ++collapsed;
+        }
+        if (collapsed == 0) break;
+
+        size_t written = 0;
+        for (size_t i = 0; i < result.size(); i += 3) {
+            unsigned int a = remap[result[i]], b = remap[result[i + 1]], c = remap[result[i + 2]];
+            if (a == b || b == c || a == c) continue;
+            result[written++] = a;
+            result[written++] = b;
+            result[written++] = c;
+        }
+        result.resize(written);
+    }
+    return float(std::sqrt(maxCost));
+}
+
+std::vector<MeshLod> MeshOptimizer::buildLods(MeshData &mesh, unsigned int maxLods, float ratio, float maxError) {
+    if (maxError <= 0.0f) {
+        float diagonal = 0.0f;
+        for (int axis = 0; axis < 3; ++axis) diagonal += (mesh.boundsMax[axis] - mesh.boundsMin[axis]) * (mesh.boundsMax[axis] - mesh.boundsMin[axis]);
+        maxError = 0.05f * std::sqrt(diagonal);
+    }
+
+    // every level starts from the previous one, the errors add up
+    std::vector<std::vector<unsigned int>> levels(1, mesh.indices);
+    std::vector<float> errors(1, 0.0f);
+    while (levels.size() < maxLods) {
+        const std::vector<unsigned int> &previous = levels.back();
+        size_t target = size_t(double(previous.size() / 3) * ratio) * 3;
+        std::vector<unsigned int> simplified;
+        float error = simplify(mesh, previous.data(), previous.size(), target, std::max(maxError - errors.back(), 0.0f), simplified);
+        if (simplified.empty() || simplified.size() > previous.size() / 5 * 4) break;
+        levels.push_back(std::move(simplified));
+        errors.push_back(errors.back() + error);
+    }
+
+    std::vector<MeshLod> lods;
+    mesh.indices.clear();
+    for (size_t i = 0; i < levels.size(); ++i) {
+        optimizeVertexCache(levels[i].data(), levels[i].size(), mesh.vertices.size());
+        lods.push_back({unsigned(mesh.indices.size()), unsigned(levels[i].size()), errors[i]});
+        mesh.indices.insert(mesh.indices.end(), levels[i].begin(), levels[i].end());
+    }
+    optimizeVertexFetch(mesh);
+    return lods;
+}
@@ -0,0 +1,66 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#ifndef MESHOPTIMIZER_H
+#define MESHOPTIMIZER_H
+#include <cstddef>
+#include <vector>
+
+#include "Meshes.hpp"
+
+
+/** Import time processing of triangle meshes for the GPU
+ *
+ *  optimizeVertexCache reorders triangles so the post transform cache is hit more often (Forsyth's linear speed
+ *  vertex cache optimisation), optimizeVertexFetch then sorts the vertices by first use so the vertex fetch walks
+ *  the vertex buffer front to back. Neither changes what is drawn.
+ *
+ *  simplify and buildLods reduce the triangle count with quadric error metrics (Garland & Heckbert) by collapsing
+ *  edges onto existing vertices, so all LODs share one vertex buffer.
+ */
+class MeshOptimizer {
+public:
+    /** Reorders the triangles of an index range in place
+     *
+     *  @param[in,out] indices Triangle list
+     *  @param[in] vertexCount Number of vertices the indices refer to
+     */
+    static void optimizeVertexCache(unsigned int *indices, size_t indexCount, size_t vertexCount);
+
+    /** Sorts the vertices by first use in mesh.indices and drops unreferenced ones, the indices are remapped */
+    static void optimizeVertexFetch(MeshData &mesh);
+
+    /** @returns Average number of vertex shader invocations per triangle for a FIFO cache of the given size */
+    static double averageCacheMissRatio(const unsigned int *indices, size_t indexCount, size_t vertexCount,
+                                        unsigned int cacheSize = 16);
+
+    /** Simplifies a triangle list by edge collapses
+     *
+     *  Vertices on open borders, uv seams and hard normal edges are locked, the remaining collapses are ranked by
+     *  the area weighted plane distance plus a penalty for the uv and normal difference along the edge. Collapses
+     *  that would flip a triangle are rejected.
+     *
+     *  @param[in] mesh Vertices the indices refer to
+     *  @param[in] indices Source triangle list (any index range of mesh, e.g. the previous LOD)
+     *  @param[in] targetIndexCount Stop once the result has at most this many indices
+     *  @param[in] targetError Stop before a collapse would move the surface further than this (object space units)
+     *  @param[out] result Simplified triangle list referring to mesh.vertices
+     *  @returns The error of the result in object space units
+     */
+    static float simplify(const MeshData &mesh, const unsigned int *indices, size_t indexCount, size_t targetIndexCount,
+                          float targetError, std::vector<unsigned int> &result);
+
+    /** Appends a LOD chain to mesh.indices and optimizes every LOD for the vertex cache and the whole mesh for fetch
+     *
+     *  Each LOD has about ratio times the triangles of the previous one. The chain ends after maxLods levels, when a
+     *  level would save less than 20% or exceed maxError (object space units, default 5% of the bounds diagonal).
+     *
+     *  @returns The index ranges, LOD 0 is the original mesh
+     */
+    static std::vector<MeshLod> buildLods(MeshData &mesh, unsigned int maxLods = 6, float ratio = 0.5f, float maxError = 0.0f);
+};
+
+
+
+#endif //MESHOPTIMIZER_H
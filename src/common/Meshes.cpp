@@ -0,0 +1,771 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#include "Meshes.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "Assets.hpp"
+#include "JobSystem.hpp"
+
+namespace {
+    constexpr int MISSING = -1;
+
+    /** Open addressing map from a (position, uv, normal) index triple to the vertex created for it */
+    class VertexCache {
+    public:
+        explicit VertexCache(size_t expected) {
+            size_t capacity = 64;
+            while (capacity < expected * 2) capacity *= 2;
+            slots.assign(capacity, Slot{MISSING, 0, 0, 0});
+        }
+
+        /** @returns The vertex index for the triple, inserted is set if the triple was not seen yet */
+        unsigned int find(int position, int uv, int normal, unsigned int next, bool &inserted) {
+            uint32_t hash = uint32_t(position) * 0x9E3779B1u ^ uint32_t(uv) * 0x85EBCA77u ^ uint32_t(normal) * 0xC2B2AE3Du;
+            size_t mask = slots.size() - 1;
+            for (size_t i = hash & mask;; i = (i + 1) & mask) {
+                Slot &slot = slots[i];
+                if (slot.position == MISSING) {
+                    slot = {position, uv, normal, next};
+                    inserted = true;
+                    return next;
+                }
+                if (slot.position == position && slot.uv == uv && slot.normal == normal) {
+                    inserted = false;
+                    return slot.vertex;
+                }
+            }
+        }
+
+    private:
+        struct Slot {
+            int position, uv, normal;
+            unsigned int vertex;
+        };
+        std::vector<Slot> slots;
+    };
+
+    /** Splits [0, size) into pieces of roughly chunkSize bytes that end after a newline */
+    std::vector<size_t> splitLines(const unsigned char *data, size_t size, size_t chunkSize) {
+        std::vector<size_t> starts{0};
+        size_t position = chunkSize;
+        while (position < size) {
+            const void *newline = memchr(data + position, '\n', size - position);
+            if (!newline) break;
+            position = size_t(static_cast<const unsigned char *>(newline) - data) + 1;
+            if (position < size) starts.push_back(position);
+            position += chunkSize;
+        }
+        starts.push_back(size);
+        return starts;
+    }
+
+    size_t chunkSizeFor(size_t size) {
+        // a few chunks per thread balance the load, but each chunk has to amortize its bookkeeping
+        size_t chunkSize = size / (size_t(JobSystem::threadCount()) * 4);
+        return std::max(chunkSize, size_t(1) << 20);
+    }
+
+    // ---------------------------------------------------------------------------------------------
+    // OBJ
+
+    /** Relative corners are stored as RELATIVE + (index counted from the first attribute of the chunk), far below
+     *  MISSING. The chunk local index is negative when the corner refers to an attribute of an earlier chunk.
+     */
+    constexpr int64_t RELATIVE = INT64_MIN / 2;
+
+    /** Output of one parsed piece of an .obj file
+     *
+     *  Corner indices are 0 based and global, relative (negative) indices can only be resolved once the number of
+     *  attributes in the preceding chunks is known and are stored relative to the chunk (see RELATIVE).
+     */
+    struct ObjChunk {
+        std::vector<float> positions;
+        std::vector<float> uvs;
+        std::vector<float> normals;
+        std::vector<int64_t> corners; // 3 per triangle corner: position, uv, normal
+        size_t positionBase = 0, uvBase = 0, normalBase = 0;
+        std::vector<Vertex> vertices;
+        std::vector<unsigned int> indices;
+        size_t vertexBase = 0;
+        unsigned int line = 0;    // first line that could not be parsed, 0 if none
+        bool missingNormals = false;
+    };
+
+    bool isBlank(unsigned char c) {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    const char *skipBlanks(const char *p, const char *end) {
+        while (p < end && isBlank(*p)) ++p;
+        return p;
+    }
+
+    bool parseFloats(const char *&p, const char *end, float *values, int count) {
+        for (int i = 0; i < count; ++i) {
+            p = skipBlanks(p, end);
+            if (p < end && *p == '+') ++p;
+            std::from_chars_result result = std::from_chars(p, end, values[i]);
+            if (result.ec != std::errc()) return false;
+            p = result.ptr;
+        }
+        return true;
+    }
+
+    bool parseIndex(const char *&p, const char *end, long long &value) {
+        bool negative = p < end && *p == '-';
+        if (negative || (p < end && *p == '+')) ++p;
+        if (p >= end || *p < '0' || *p > '9') return false;
+        long long result = 0;
+        while (p < end && *p >= '0' && *p <= '9') result = result * 10 + (*p++ - '0');
+        value = negative ? -result : result;
+        return value != 0;
+    }
+
+    /** Converts a 1 based (or negative, relative) OBJ index into the chunk encoding, MISSING for 0 */
+    int64_t encodeIndex(long long index, size_t localCount, bool &valid) {
+        if (index > 0 && index <= INT32_MAX) return index - 1;
+        // the range of the chunk local index is checked once the attributes of the earlier chunks are counted
+        if (index < 0 && index >= -INT32_MAX) return RELATIVE + static_cast<long long>(localCount) + index;
+        valid = false;
+        return MISSING;
+    }
+
+    void parseObjChunk(const char *begin, const char *end, ObjChunk &chunk) {
+        std::vector<int64_t> polygon;
+        unsigned int line = 0;
+        for (const char *p = begin; p < end; ++line) {
+            const char *lineEnd = static_cast<const char *>(memchr(p, '\n', size_t(end - p)));
+            if (!lineEnd) lineEnd = end;
+            p = skipBlanks(p, lineEnd);
+
+            bool valid = true;
+            if (p + 1 < lineEnd && p[0] == 'v' && isBlank(p[1])) {
+                float position[3];
+                valid = parseFloats(++p, lineEnd, position, 3);
+                chunk.positions.insert(chunk.positions.end(), position, position + 3);
+            } else if (p + 2 < lineEnd && p[0] == 'v' && p[1] == 't' && isBlank(p[2])) {
+                float uv[2] = {0, 0};
+                p += 2;
+                valid = parseFloats(p, lineEnd, uv, 1);
+                parseFloats(p, lineEnd, uv + 1, 1); // the v coordinate is optional
+                chunk.uvs.insert(chunk.uvs.end(), uv, uv + 2);
+            } else if (p + 2 < lineEnd && p[0] == 'v' && p[1] == 'n' && isBlank(p[2])) {
+                float normal[3];
+                p += 2;
+                valid = parseFloats(p, lineEnd, normal, 3);
+                chunk.normals.insert(chunk.normals.end(), normal, normal + 3);
+            } else if (p + 1 < lineEnd && p[0] == 'f' && isBlank(p[1])) {
+                // corners are v, v/vt, v//vn or v/vt/vn
+                polygon.clear();
+                ++p;
+                while (valid && (p = skipBlanks(p, lineEnd)) < lineEnd) {
+                    long long index = 0;
+                    int64_t corner[3] = {MISSING, MISSING, MISSING};
+                    valid = parseIndex(p, lineEnd, index);
+                    corner[0] = encodeIndex(index, chunk.positions.size() / 3, valid);
+                    for (int attribute = 1; attribute < 3 && valid && p < lineEnd && *p == '/'; ++attribute) {
+                        ++p;
+                        if (p < lineEnd && *p == '/') continue;
+                        valid = parseIndex(p, lineEnd, index);
+                        size_t count = attribute == 1 ? chunk.uvs.size() / 2 : chunk.normals.size() / 3;
+                        corner[attribute] = encodeIndex(index, count, valid);
+                    }
+                    polygon.insert(polygon.end(), corner, corner + 3);
+                }
+                valid = valid && polygon.size() >= 9;
+                // triangle fan around the first corner
+                for (size_t i = 6; valid && i < polygon.size(); i += 3) {
+                    chunk.corners.insert(chunk.corners.end(), polygon.begin(), polygon.begin() + 3);
+                    chunk.corners.insert(chunk.corners.end(), polygon.begin() + i - 3, polygon.begin() + i + 3);
+                }
+            }
+            // everything else (comments, groups, materials, smoothing groups, lines) is skipped
+
+            if (!valid) {
+                chunk.line = line + 1;
+                return;
+            }
+            p = lineEnd + 1;
+        }
+    }
+
+    /** Resolves the corner indices and builds the chunk's vertices, returns false for out of range indices */
+    bool buildObjVertices(ObjChunk &chunk, const std::vector<float> &positions, const std::vector<float> &uvs,
+                          const std::vector<float> &normals) {
+        auto resolve = [](int64_t index, size_t base, size_t count) -> long long {
+            if (index == MISSING) return MISSING;
+            long long global = index >= 0 ? index : static_cast<long long>(base) + (index - RELATIVE);
+            return global >= 0 && global < static_cast<long long>(count) ? global : -2;
+        };
+
+        size_t cornerCount = chunk.corners.size() / 3;
+        VertexCache cache(cornerCount);
+        chunk.indices.resize(cornerCount);
+        for (size_t i = 0; i < cornerCount; ++i) {
+            const int64_t *corner = &chunk.corners[i * 3];
+            long long position = resolve(corner[0], chunk.positionBase, positions.size() / 3);
+            long long uv = resolve(corner[1], chunk.uvBase, uvs.size() / 2);
+            long long normal = resolve(corner[2], chunk.normalBase, normals.size() / 3);
+            if (position < 0 || uv < MISSING || normal < MISSING) return false;
+            chunk.missingNormals |= normal == MISSING;
+
+            bool inserted;
+            unsigned int vertex = cache.find(int(position), int(uv), int(normal), unsigned(chunk.vertices.size()), inserted);
+            chunk.indices[i] = vertex;
+            if (!inserted) continue;
+
+            Vertex v{};
+            memcpy(v.position, &positions[size_t(position) * 3], sizeof(v.position));
+            if (uv != MISSING) memcpy(v.uv, &uvs[size_t(uv) * 2], sizeof(v.uv));
+            if (normal != MISSING) memcpy(v.normal, &normals[size_t(normal) * 3], sizeof(v.normal));
+            chunk.vertices.push_back(v);
+        }
+        std::vector<int64_t>().swap(chunk.corners);
+        return true;
+    }
+
+    // ---------------------------------------------------------------------------------------------
+    // PLY
+
+    enum class PlyType { Invalid, Int8, UInt8, Int16, UInt16, Int32, UInt32, Float32, Float64 };
+
+    struct PlyProperty {
+        std::string name;
+        PlyType type = PlyType::Invalid;
+        PlyType countType = PlyType::Invalid; // set for list properties
+        size_t offset = 0;                    // byte offset inside the element, fixed size elements only
+    };
+
+    struct PlyElement {
+        std::string name;
+        size_t count = 0;
+        std::vector<PlyProperty> properties;
+        bool hasLists = false;
+        size_t stride = 0; // bytes per item if there are no lists
+    };
+
+    PlyType plyType(const std::string &name) {
+        if (name == "char" || name == "int8") return PlyType::Int8;
+        if (name == "uchar" || name == "uint8") return PlyType::UInt8;
+        if (name == "short" || name == "int16") return PlyType::Int16;
+        if (name == "ushort" || name == "uint16") return PlyType::UInt16;
+        if (name == "int" || name == "int32") return PlyType::Int32;
+        if (name == "uint" || name == "uint32") return PlyType::UInt32;
+        if (name == "float" || name == "float32") return PlyType::Float32;
+        if (name == "double" || name == "float64") return PlyType::Float64;
+        return PlyType::Invalid;
+    }
+
+    size_t plySize(PlyType type) {
+        switch (type) {
+            case PlyType::Int8: case PlyType::UInt8: return 1;
+            case PlyType::Int16: case PlyType::UInt16: return 2;
+            case PlyType::Int32: case PlyType::UInt32: case PlyType::Float32: return 4;
+            case PlyType::Float64: return 8;
+            default: return 0;
+        }
+    }
+
+    template<typename T>
+    T readPly(const unsigned char *p, bool bigEndian) {
+        unsigned char bytes[sizeof(T)];
+        memcpy(bytes, p, sizeof(T));
+        if (bigEndian) std::reverse(bytes, bytes + sizeof(T));
+        T value;
+        memcpy(&value, bytes, sizeof(T));
+        return value;
+    }
+
+    double readPlyValue(const unsigned char *p, PlyType type, bool bigEndian) {
+        switch (type) {
+            case PlyType::Int8: return double(int8_t(*p));
+            case PlyType::UInt8: return double(*p);
+            case PlyType::Int16: return readPly<int16_t>(p, bigEndian);
+            case PlyType::UInt16: return readPly<uint16_t>(p, bigEndian);
+            case PlyType::Int32: return readPly<int32_t>(p, bigEndian);
+            case PlyType::UInt32: return readPly<uint32_t>(p, bigEndian);
+            case PlyType::Float32: return readPly<float>(p, bigEndian);
+            case PlyType::Float64: return readPly<double>(p, bigEndian);
+            default: return 0;
+        }
+    }
+
+    long long readPlyIndex(const unsigned char *p, PlyType type, bool bigEndian) {
+        switch (type) {
+            case PlyType::Int8: return int8_t(*p);
+            case PlyType::UInt8: return *p;
+            case PlyType::Int16: return readPly<int16_t>(p, bigEndian);
+            case PlyType::UInt16: return readPly<uint16_t>(p, bigEndian);
+            case PlyType::Int32: return readPly<int32_t>(p, bigEndian);
+            case PlyType::UInt32: return readPly<uint32_t>(p, bigEndian);
+            default: return -1;
+        }
+    }
+
+    /** Skips one item of an element with list properties, returns nullptr if it runs past the end */
+    const unsigned char *skipPlyItem(const PlyElement &element, const unsigned char *p, const unsigned char *end,
+                                     bool bigEndian) {
+        for (const PlyProperty &property : element.properties) {
+            if (property.countType == PlyType::Invalid) {
+                p += plySize(property.type);
+            } else {
+                size_t countSize = plySize(property.countType);
+                if (size_t(end - p) < countSize) return nullptr;
+                long long count = readPlyIndex(p, property.countType, bigEndian);
+                if (count < 0) return nullptr;
+                p += countSize;
+                if (size_t(end - p) / plySize(property.type) < size_t(count)) return nullptr;
+                p += size_t(count) * plySize(property.type);
+            }
+            if (p > end) return nullptr;
+        }
+        return p;
+    }
+
+    bool parsePlyHeader(const unsigned char *data, size_t size, std::vector<PlyElement> &elements, bool &bigEndian,
+                        size_t &headerSize) {
+        static const char END_HEADER[] = "end_header";
+        const char *text = reinterpret_cast<const char *>(data);
+        size_t position = 0;
+        bool formatFound = false;
+        unsigned int lineIndex = 0;
+        while (position < size) {
+            const void *newline = memchr(text + position, '\n', size - position);
+            if (!newline) return false;
+            size_t lineEnd = size_t(static_cast<const char *>(newline) - text);
+            std::string line(text + position, lineEnd - position);
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            position = lineEnd + 1;
+
+            std::vector<std::string> words;
+            for (size_t begin = 0; begin < line.size();) {
+                size_t wordEnd = line.find(' ', begin);
+                if (wordEnd == std::string::npos) wordEnd = line.size();
+                if (wordEnd > begin) words.emplace_back(line, begin, wordEnd - begin);
+                begin = wordEnd + 1;
+            }
+            if (lineIndex++ == 0) {
+                if (line != "ply") return false;
+                continue;
+            }
+            if (words.empty() || words[0] == "comment" || words[0] == "obj_info") continue;
+
+            if (words[0] == "format" && words.size() >= 2) {
+                if (words[1] == "binary_little_endian") bigEndian = false;
+                else if (words[1] == "binary_big_endian") bigEndian = true;
+                else {printf("Only binary PLY files are supported\n"); return false;}
+                formatFound = true;
+            } else if (words[0] == "element" && words.size() >= 3) {
+                PlyElement element;
+                element.name = words[1];
+                element.count = size_t(strtoull(words[2].c_str(), nullptr, 10));
+                elements.push_back(element);
+            } else if (words[0] == "property" && !elements.empty()) {
+                PlyProperty property;
+                if (words.size() >= 5 && words[1] == "list") {
+                    property.countType = plyType(words[2]);
+                    property.type = plyType(words[3]);
+                    property.name = words[4];
+                    if (property.countType == PlyType::Invalid || property.countType == PlyType::Float32 ||
+                        property.countType == PlyType::Float64)
+                        return false;
+                } else if (words.size() >= 3) {
+                    property.type = plyType(words[1]);
+                    property.name = words[2];
+                }
+                if (property.type == PlyType::Invalid) return false;
+                elements.back().properties.push_back(property);
+            } else if (line == END_HEADER) {
+                headerSize = position;
+                break;
+            }
+        }
+        if (!formatFound || headerSize == 0) return false;
+
+        for (PlyElement &element : elements) {
+            for (PlyProperty &property : element.properties) {
+                property.offset = element.stride;
+                element.hasLists |= property.countType != PlyType::Invalid;
+                element.stride += plySize(property.type);
+            }
+        }
+        return true;
+    }
+
+    const PlyProperty *findProperty(const PlyElement &element, std::initializer_list<const char *> names) {
+        for (const char *name : names) {
+            for (const PlyProperty &property : element.properties)
+                if (property.name == name && property.countType == PlyType::Invalid) return &property;
+        }
+        return nullptr;
+    }
+
+    bool parsePlyVertices(const PlyElement &element, const unsigned char *data, bool bigEndian, MeshData &mesh,
+                          bool &hasNormals) {
+        const PlyProperty *attributes[8] = {
+            findProperty(element, {"x"}), findProperty(element, {"y"}), findProperty(element, {"z"}),
+            findProperty(element, {"nx"}), findProperty(element, {"ny"}), findProperty(element, {"nz"}),
+            findProperty(element, {"u", "s", "texture_u", "texture_s"}),
+            findProperty(element, {"v", "t", "texture_v", "texture_t"})
+        };
+        if (!attributes[0] || !attributes[1] || !attributes[2]) {
+            printf("PLY vertices have no position\n");
+            return false;
+        }
+        hasNormals = attributes[3] && attributes[4] && attributes[5];
+
+        // fixed stride, every vertex can be converted independently
+        mesh.vertices.resize(element.count);
+        JobSystem::parallelFor(unsigned(element.count), 16384, [&](unsigned int begin, unsigned int end) {
+            for (unsigned int i = begin; i < end; ++i) {
+                const unsigned char *item = data + size_t(i) * element.stride;
+                float values[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+                for (int a = 0; a < 8; ++a) {
+                    if (attributes[a]) values[a] = float(readPlyValue(item + attributes[a]->offset, attributes[a]->type, bigEndian));
+                }
+                Vertex &vertex = mesh.vertices[i];
+                memcpy(vertex.position, values, sizeof(vertex.position));
+                memcpy(vertex.normal, values + 3, sizeof(vertex.normal));
+                memcpy(vertex.uv, values + 6, sizeof(vertex.uv));
+            }
+        });
+        return true;
+    }
+
+    bool parsePlyFaces(const PlyElement &element, const unsigned char *data, const unsigned char *end, bool bigEndian,
+                       MeshData &mesh) {
+        size_t listIndex = element.properties.size();
+        for (size_t i = 0; i < element.properties.size(); ++i) {
+            const std::string &name = element.properties[i].name;
+            if (element.properties[i].countType != PlyType::Invalid && (name == "vertex_indices" || name == "vertex_index"))
+                listIndex = i;
+        }
+        if (listIndex == element.properties.size()) {
+            printf("PLY faces have no vertex_indices\n");
+            return false;
+        }
+        const PlyProperty &list = element.properties[listIndex];
+        size_t countSize = plySize(list.countType), indexSize = plySize(list.type);
+        size_t vertexCount = mesh.vertices.size();
+
+        // fast path: the list is the only property and every face is a triangle, so the stride is fixed
+        size_t triangleStride = countSize + 3 * indexSize;
+        if (element.properties.size() == 1 && size_t(end - data) / triangleStride >= element.count) {
+            mesh.indices.resize(element.count * 3);
+            std::atomic<bool> triangles{true};
+            std::atomic<bool> inRange{true};
+            JobSystem::parallelFor(unsigned(element.count), 16384, [&](unsigned int begin, unsigned int last) {
+                for (unsigned int i = begin; i < last; ++i) {
+                    const unsigned char *item = data + size_t(i) * triangleStride;
+                    if (readPlyIndex(item, list.countType, bigEndian) != 3) {
+                        triangles.store(false, std::memory_order_relaxed);
+                        return;
+                    }
+                    for (int corner = 0; corner < 3; ++corner) {
+                        long long index = readPlyIndex(item + countSize + corner * indexSize, list.type, bigEndian);
+                        if (index < 0 || size_t(index) >= vertexCount) inRange.store(false, std::memory_order_relaxed);
+                        mesh.indices[size_t(i) * 3 + corner] = unsigned(index);
+                    }
+                }
+            });
+            // once a polygon shows up the later faces were read at the wrong stride, so their indices mean nothing
+            if (triangles) {
+                if (!inRange) {printf("PLY face index out of range\n"); return false;}
+                return true;
+            }
+            mesh.indices.clear();
+        }
+
+        // polygons or additional properties, walk the faces in order
+        const unsigned char *p = data;
+        for (size_t face = 0; face < element.count; ++face) {
+            for (size_t i = 0; i < element.properties.size(); ++i) {
+                const PlyProperty &property = element.properties[i];
+                if (property.countType == PlyType::Invalid) {
+                    if (size_t(end - p) < plySize(property.type)) return false;
+                    p += plySize(property.type);
+                    continue;
+                }
+                if (size_t(end - p) < plySize(property.countType)) return false;
+                long long count = readPlyIndex(p, property.countType, bigEndian);
+                p += plySize(property.countType);
+                if (count < 0 || size_t(end - p) / plySize(property.type) < size_t(count)) return false;
+                if (i == listIndex) {
+                    for (long long corner = 2; corner < count; ++corner) {
+                        long long fan[3] = {readPlyIndex(p, property.type, bigEndian),
+                                            readPlyIndex(p + (corner - 1) * indexSize, property.type, bigEndian),
+                                            readPlyIndex(p + corner * indexSize, property.type, bigEndian)};
+                        for (long long index : fan) {
+                            if (index < 0 || size_t(index) >= vertexCount) {printf("PLY face index out of range\n"); return false;}
+                            mesh.indices.push_back(unsigned(index));
+                        }
+                    }
+                }
+                p += size_t(count) * plySize(property.type);
+            }
+        }
+        return true;
+    }
+}
+
+void MeshData::computeBounds() {
+    if (vertices.empty()) {
+        std::fill(boundsMin, boundsMin + 3, 0.0f);
+        std::fill(boundsMax, boundsMax + 3, 0.0f);
+        return;
+    }
+    for (int axis = 0; axis < 3; ++axis) boundsMin[axis] = boundsMax[axis] = vertices[0].position[axis];
+    for (const Vertex &vertex : vertices) {
+        for (int axis = 0; axis < 3; ++axis) {
+            boundsMin[axis] = std::min(boundsMin[axis], vertex.position[axis]);
+            boundsMax[axis] = std::max(boundsMax[axis], vertex.position[axis]);
+        }
+    }
+}
+
+void MeshData::computeNormals() {
+    for (Vertex &vertex : vertices) std::fill(vertex.normal, vertex.normal + 3, 0.0f);
+
+    // the cross product length is twice the triangle area, which gives the area weighting for free
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        Vertex &a = vertices[indices[i]], &b = vertices[indices[i + 1]], &c = vertices[indices[i + 2]];
+        float e1[3], e2[3];
+        for (int axis = 0; axis < 3; ++axis) {
+            e1[axis] = b.position[axis] - a.position[axis];
+            e2[axis] = c.position[axis] - a.position[axis];
+        }
+        float normal[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+        for (int axis = 0; axis < 3; ++axis) {
+            a.normal[axis] += normal[axis];
+            b.normal[axis] += normal[axis];
+            c.normal[axis] += normal[axis];
+        }
+    }
+
+    JobSystem::parallelFor(unsigned(vertices.size()), 65536, [&](unsigned int begin, unsigned int end) {
+        for (unsigned int i = begin; i < end; ++i) {
+            float *normal = vertices[i].normal;
+            float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+            if (length > 0) for (int axis = 0; axis < 3; ++axis) normal[axis] /= length;
+            else normal[1] = 1.0f;
+        }
+    });
+}
+
+bool Meshes::load(const char *filename, MeshData &mesh) {
+    size_t length = strlen(filename);
+    auto hasExtension = [&](const char *lower, const char *upper) {
+        return length > 4 && (strcmp(filename + length - 4, lower) == 0 || strcmp(filename + length - 4, upper) == 0);
+    };
+    if (hasExtension(".obj", ".OBJ")) return loadOBJ(filename, mesh);
+    if (hasExtension(".ply", ".PLY")) return loadPLY(filename, mesh);
+    printf("Unknown mesh format: %s\n", filename);
+    return false;
+}
+
+bool Meshes::loadOBJ(const char *filename, MeshData &mesh) {
+    AssetData file;
+    if (!Assets::open(filename, file)) {printf("Mesh file could not be opened\n"); return false;}
+
+    // parse the chunks independently
+    const char *text = reinterpret_cast<const char *>(file.data());
+    std::vector<size_t> starts = splitLines(file.data(), file.size(), chunkSizeFor(file.size()));
+    std::vector<ObjChunk> chunks(starts.size() - 1);
+    JobSystem::parallelFor(unsigned(chunks.size()), 1, [&](unsigned int begin, unsigned int end) {
+        for (unsigned int i = begin; i < end; ++i) parseObjChunk(text + starts[i], text + starts[i + 1], chunks[i]);
+    });
+
+    // concatenate the attributes, every chunk learns how many attributes precede it
+    size_t positionCount = 0, uvCount = 0, normalCount = 0;
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        ObjChunk &chunk = chunks[i];
+        if (chunk.line) {
+            // count the lines of the previous chunks to report the absolute line number
+            size_t line = std::count(text, text + starts[i], '\n') + chunk.line;
+            printf("OBJ file %s could not be parsed (line %zu)\n", filename, line);
+            return false;
+        }
+        chunk.positionBase = positionCount;
+        chunk.uvBase = uvCount;
+        chunk.normalBase = normalCount;
+        positionCount += chunk.positions.size() / 3;
+        uvCount += chunk.uvs.size() / 2;
+        normalCount += chunk.normals.size() / 3;
+    }
+    std::vector<float> positions(positionCount * 3), uvs(uvCount * 2), normals(normalCount * 3);
+    JobSystem::parallelFor(unsigned(chunks.size()), 1, [&](unsigned int begin, unsigned int end) {
+        for (unsigned int i = begin; i < end; ++i) {
+            ObjChunk &chunk = chunks[i];
+            std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + chunk.positionBase * 3);
+            std::copy(chunk.uvs.begin(), chunk.uvs.end(), uvs.begin() + chunk.uvBase * 2);
+            std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + chunk.normalBase * 3);
+            std::vector<float>().swap(chunk.positions);
+            std::vector<float>().swap(chunk.uvs);
+            std::vector<float>().swap(chunk.normals);
+        }
+    });
+
+    // deduplicate the corners per chunk, a vertex used by faces in several chunks is stored once per chunk
+    std::atomic<bool> inRange{true};
+    JobSystem::parallelFor(unsigned(chunks.size()), 1, [&](unsigned int begin, unsigned int end) {
+        for (unsigned int i = begin; i < end; ++i) {
+            if (!buildObjVertices(chunks[i], positions, uvs, normals)) inRange.store(false);
+        }
+    });
+    if (!inRange) {
+        printf("OBJ file %s references a vertex that does not exist\n", filename);
+        return false;
+    }
+
+    size_t vertexCount = 0, indexCount = 0;
+    bool missingNormals = false;
+    for (ObjChunk &chunk : chunks) {
+        chunk.vertexBase = vertexCount;
+        vertexCount += chunk.vertices.size();
+        indexCount += chunk.indices.size();
+        missingNormals |= chunk.missingNormals;
+    }
+    mesh.vertices.resize(vertexCount);
+    mesh.indices.resize(indexCount);
+    std::vector<size_t> indexBases(chunks.size(), 0);
+    for (size_t i = 1; i < chunks.size(); ++i) indexBases[i] = indexBases[i - 1] + chunks[i - 1].indices.size();
+    JobSystem::parallelFor(unsigned(chunks.size()), 1, [&](unsigned int begin, unsigned int end) {
+        for (unsigned int i = begin; i < end; ++i) {
+            const ObjChunk &chunk = chunks[i];
+            std::copy(chunk.vertices.begin(), chunk.vertices.end(), mesh.vertices.begin() + chunk.vertexBase);
+            for (size_t j = 0; j < chunk.indices.size(); ++j)
+                mesh.indices[indexBases[i] + j] = unsigned(chunk.vertexBase) + chunk.indices[j];
+        }
+    });
+
+    if (missingNormals) mesh.computeNormals();
+    mesh.computeBounds();
+    return true;
+}
+
+bool Meshes::loadPLY(const char *filename, MeshData &mesh) {
+    AssetData file;
+    if (!Assets::open(filename, file)) {printf("Mesh file could not be opened\n"); return false;}
+
+    std::vector<PlyElement> elements;
+    bool bigEndian = false;
+    size_t headerSize = 0;
+    if (!parsePlyHeader(file.data(), file.size(), elements, bigEndian, headerSize)) {
+        printf("Not a valid binary PLY file\n");
+        return false;
+    }
+
+    mesh.vertices.clear();
+    mesh.indices.clear();
+    const unsigned char *p = file.data() + headerSize;
+    const unsigned char *end = file.data() + file.size();
+    bool hasVertices = false, hasNormals = false;
+    for (const PlyElement &element : elements) {
+        if (element.name == "vertex") {
+            if (element.hasLists || size_t(end - p) / std::max(element.stride, size_t(1)) < element.count) break;
+            if (!parsePlyVertices(element, p, bigEndian, mesh, hasNormals)) return false;
+            hasVertices = true;
+        } else if (element.name == "face") {
+            if (!hasVertices) {printf("PLY faces precede the vertices\n"); return false;}
+            if (!parsePlyFaces(element, p, end, bigEndian, mesh)) {printf("PLY face data is truncated\n"); return false;}
+        }
+
+        // advance to the next element
+        if (!element.hasLists) {
+            if (size_t(end - p) / std::max(element.stride, size_t(1)) < element.count) {
+                printf("PLY file is truncated\n");
+                return false;
+            }
+            p += element.count * element.stride;
+        } else {
+            for (size_t i = 0; i < element.count && p; ++i) p = skipPlyItem(element, p, end, bigEndian);
+            if (!p) {
+                printf("PLY file is truncated\n");
+                return false;
+            }
+        }
+    }
+    if (!hasVertices) {
+        printf("PLY file has no vertex element\n");
+        return false;
+    }
+
+    if (!hasNormals) mesh.computeNormals();
+    mesh.computeBounds();
+    return true;
+}
+
+GpuMesh Meshes::upload(const MeshData &mesh) {
+    GpuMesh gpu;
+    glGenVertexArrays(1, &gpu.vertexArray);
+    glBindVertexArray(gpu.vertexArray);
+
+    glGenBuffers(1, &gpu.vertexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, gpu.vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(mesh.vertices.size() * sizeof(Vertex)), mesh.vertices.data(), GL_STATIC_DRAW);
+
+    glGenBuffers(1, &gpu.indexBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gpu.indexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, GLsizeiptr(mesh.indices.size() * sizeof(unsigned int)), mesh.indices.data(), GL_STATIC_DRAW);
+    gpu.indexCount = GLsizei(mesh.indices.size());
+    gpu.lods.push_back({0, unsigned(mesh.indices.size()), 0.0f});
+    std::copy(mesh.boundsMin, mesh.boundsMin + 3, gpu.boundsMin);
+    std::copy(mesh.boundsMax, mesh.boundsMax + 3, gpu.boundsMax);
+
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void *>(offsetof(Vertex, position)));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void *>(offsetof(Vertex, uv)));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void *>(offsetof(Vertex, normal)));
+
+    glBindVertexArray(0);
+    return gpu;
+}
+
+void Meshes::draw(const GpuMesh &mesh, size_t lod) {
+    if (mesh.lods.empty()) return;
+    const MeshLod &range = mesh.lods[std::min(lod, mesh.lods.size() - 1)];
+    size_t indexSize = mesh.indexType == GL_UNSIGNED_SHORT ? 2 : 4;
+    glBindVertexArray(mesh.vertexArray);
+    glDrawElements(GL_TRIANGLES, GLsizei(range.indexCount), mesh.indexType,
+                   reinterpret_cast<const void *>(range.firstIndex * indexSize));
+}
+
+size_t Meshes::selectLod(const GpuMesh &mesh, float distance, float pixelsPerUnit, float maxPixelError) {
+    // inside the bounds the full mesh is always right
+    if (distance <= 0.0f) return 0;
+    for (size_t lod = mesh.lods.size(); lod-- > 1;) {
+        if (mesh.lods[lod].error * pixelsPerUnit / distance <= maxPixelError) return lod;
+    }
+    return 0;
+}
+
+float Meshes::pixelsPerUnit(float fovY, float viewportHeight) {
+    return viewportHeight / (2.0f * std::tan(fovY * 0.5f));
+}
+
+void Meshes::setDecodeUniforms(GLuint program, const VertexDecode &decode) {
+    glUniform3fv(glGetUniformLocation(program, "positionScale"), 1, decode.positionScale);
+    glUniform3fv(glGetUniformLocation(program, "positionOffset"), 1, decode.positionOffset);
+    glUniform2fv(glGetUniformLocation(program, "uvScale"), 1, decode.uvScale);
+    glUniform2fv(glGetUniformLocation(program, "uvOffset"), 1, decode.uvOffset);
+    glUniform1i(glGetUniformLocation(program, "octahedralNormals"), decode.octahedralNormals);
+}
+
+void Meshes::destroy(GpuMesh &mesh) {
+    glDeleteVertexArrays(1, &mesh.vertexArray);
+    glDeleteBuffers(1, &mesh.vertexBuffer);
+    glDeleteBuffers(1, &mesh.indexBuffer);
+    mesh = GpuMesh();
+}
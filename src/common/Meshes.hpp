@@ -0,0 +1,117 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#ifndef MESHES_H
+#define MESHES_H
+#include <glad/gl.h>
+#include <cstddef>
+#include <vector>
+
+
+/** Interleaved vertex as uploaded by Meshes::upload (32 bytes) */
+struct Vertex {
+    float position[3];
+    float normal[3];
+    float uv[2];
+};
+
+/** CPU side indexed triangle mesh */
+struct MeshData {
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices; // triangle list
+    float boundsMin[3] = {0, 0, 0};
+    float boundsMax[3] = {0, 0, 0};
+
+    /** Recomputes boundsMin/boundsMax from the vertex positions */
+    void computeBounds();
+    /** Replaces the vertex normals by the area weighted average of the adjacent face normals */
+    void computeNormals();
+};
+
+/** Index range of one level of detail, LOD 0 is the full resolution mesh */
+struct MeshLod {
+    unsigned int firstIndex = 0;
+    unsigned int indexCount = 0;
+    float error = 0.0f; // object space deviation from LOD 0
+};
+
+/** Shader uniforms that turn quantized attributes back into object space values, identity for float vertices
+ *
+ *  position = positionOffset + attribute * positionScale, uv = uvOffset + attribute * uvScale
+ */
+struct VertexDecode {
+    float positionScale[3] = {1, 1, 1};
+    float positionOffset[3] = {0, 0, 0};
+    float uvScale[2] = {1, 1};
+    float uvOffset[2] = {0, 0};
+    bool octahedralNormals = false; // normal attribute holds two unorm16 octahedral coordinates
+};
+
+/** Vertex array with one interleaved vertex buffer and one index buffer
+ *
+ *  Attribute locations: 0 position (vec3), 1 uv (vec2), 2 normal (vec3), matching MeshShader.vert and ClusteredShader.vert
+ */
+struct GpuMesh {
+    GLuint vertexArray = 0;
+    GLuint vertexBuffer = 0;
+    GLuint indexBuffer = 0;
+    GLsizei indexCount = 0;
+    GLenum indexType = GL_UNSIGNED_INT;
+    std::vector<MeshLod> lods;
+    float boundsMin[3] = {0, 0, 0};
+    float boundsMax[3] = {0, 0, 0};
+    VertexDecode decode;
+};
+
+/** Mesh import from .obj (Wavefront) and binary .ply files
+ *
+ *  The files are memory mapped (see Assets) and split into chunks that are parsed on the JobSystem workers.
+ *  Polygons are triangulated as fans, identical position/uv/normal combinations share one vertex.
+ */
+class Meshes {
+public:
+    /** Loads a mesh, the format is chosen by the file extension (.obj or .ply) */
+    static bool load(const char * filename, MeshData &mesh);
+
+    /** Reads an .obj file (v, vt, vn and f statements, negative indices, polygons), other statements are ignored
+     *
+     *  @param[in] filename The path to the file
+     *  @param[out] mesh Vertices, triangle indices and bounds, normals are generated if the file has none
+     *  @returns true if the file could be parsed
+     */
+    static bool loadOBJ(const char * filename, MeshData &mesh);
+
+    /** Reads a binary (little or big endian) .ply file with a vertex and a face element
+     *
+     *  @param[in] filename The path to the file
+     *  @param[out] mesh Vertices, triangle indices and bounds, normals are generated if the file has none
+     *  @returns true if the file could be parsed
+     */
+    static bool loadPLY(const char * filename, MeshData &mesh);
+
+    /** Creates the vertex array and buffers for a mesh with a single LOD */
+    static GpuMesh upload(const MeshData &mesh);
+
+    /** Draws one LOD of a mesh (clamped to the coarsest one), the caller binds program, uniforms and textures */
+    static void draw(const GpuMesh &mesh, size_t lod = 0);
+
+    /** Picks the coarsest LOD whose error, projected to the screen, stays below maxPixelError
+     *
+     *  @param[in] distance Distance from the camera to the closest point of the bounds (same units as the LOD errors)
+     *  @param[in] pixelsPerUnit Size in pixels of one unit at distance 1, see pixelsPerUnit()
+     *  @param[in] maxPixelError Allowed deviation in pixels
+     */
+    static size_t selectLod(const GpuMesh &mesh, float distance, float pixelsPerUnit, float maxPixelError = 1.0f);
+
+    /** @returns viewportHeight / (2 tan(fovY / 2)), the projection factor of a perspective camera */
+    static float pixelsPerUnit(float fovY, float viewportHeight);
+
+    /** Sets the positionScale, positionOffset, uvScale, uvOffset and octahedralNormals uniforms of a bound program */
+    static void setDecodeUniforms(GLuint program, const VertexDecode &decode);
+    static void destroy(GpuMesh &mesh);
+};
+
+
+
+#endif //MESHES_H
@@ -0,0 +1,326 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#include "Meshlets.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MESHLETS_SSE2
+#endif
+
+#include "JobSystem.hpp"
+
+namespace {
+    /** Normal cones wider than this (minimum dot product to the axis) can be seen from the back and the front */
+    constexpr float MIN_CONE_DOT = 0.1f;
+
+    /** Computes the bounding sphere and normal cone of a meshlet from its vertices and triangles */
+    void computeBounds(const MeshData &mesh, const unsigned int *indices, const unsigned int *meshletVertices,
+                       unsigned int vertexCount, size_t indexCount, Meshlet &meshlet) {
+        float low[3], high[3];
+        for (int axis = 0; axis < 3; ++axis) low[axis] = high[axis] = mesh.vertices[meshletVertices[0]].position[axis];
+        for (unsigned int i = 1; i < vertexCount; ++i) {
+            const float *position = mesh.vertices[meshletVertices[i]].position;
+            for (int axis = 0; axis < 3; ++axis) {
+                low[axis] = std::min(low[axis], position[axis]);
+                high[axis] = std::max(high[axis], position[axis]);
+            }
+        }
+        float radius = 0.0f;
+        for (int axis = 0; axis < 3; ++axis) meshlet.center[axis] = (low[axis] + high[axis]) * 0.5f;
+        for (unsigned int i = 0; i < vertexCount; ++i) {
+            const float *position = mesh.vertices[meshletVertices[i]].position;
+            float distance = 0.0f;
+            for (int axis = 0; axis < 3; ++axis) distance += (position[axis] - meshlet.center[axis]) * (position[axis] - meshlet.center[axis]);
+            radius = std::max(radius, distance);
+        }
+        meshlet.radius = std::sqrt(radius);
+
+        // the axis is the area weighted average normal, the cutoff comes from the normal furthest away from it
+        float normals[Meshlets::MAX_TRIANGLES][3];
+        unsigned int normalCount = 0;
+        float axis[3] = {0, 0, 0};
+        for (size_t i = 0; i < indexCount; i += 3) {
+            const float *a = mesh.vertices[indices[i]].position;
+            const float *b = mesh.vertices[indices[i + 1]].position;
+            const float *c = mesh.vertices[indices[i + 2]].position;
+            float e1[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+            float e2[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+            float n[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+            float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            if (length == 0.0f) continue;
+            for (int k = 0; k < 3; ++k) {
+                axis[k] += n[k];
+                normals[normalCount][k] = n[k] / length;
+            }
+            ++normalCount;
+        }
+        float axisLength = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+        float minDot = 1.0f;
+        for (int k = 0; k < 3; ++k) meshlet.coneAxis[k] = axisLength > 0.0f ? axis[k] / axisLength : 0.0f;
+        for (unsigned int i = 0; i < normalCount; ++i)
+            minDot = std::min(minDot, normals[i][0] * meshlet.coneAxis[0] + normals[i][1] * meshlet.coneAxis[1] +
+                                      normals[i][2] * meshlet.coneAxis[2]);
+        meshlet.coneCutoff = axisLength == 0.0f || normalCount == 0 || minDot <= MIN_CONE_DOT ? 1.0f : std::sqrt(1.0f - minDot * minDot);
+    }
+
+    void normalizePlane(float plane[4]) {
+        float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+        if (length > 0.0f) for (int i = 0; i < 4; ++i) plane[i] /= length;
+    }
+
+    /** Model matrix terms shared by both culling paths */
+    struct Transform {
+        const float *m;
+        float radiusScale; // largest axis scale
+        float axisScale;   // 1 / uniform scale, 0 disables the cone test
+    };
+
+    Transform transformOf(const float model[16]) {
+        float scale[3];
+        for (int column = 0; column < 3; ++column) {
+            const float *c = model + column * 4;
+            scale[column] = std::sqrt(c[0] * c[0] + c[1] * c[1] + c[2] * c[2]);
+        }
+        float low = std::min({scale[0], scale[1], scale[2]}), high = std::max({scale[0], scale[1], scale[2]});
+        // normals of non uniformly scaled meshes do not transform like the cone axis, mirrored ones flip the winding
+        float determinant = model[0] * (model[5] * model[10] - model[6] * model[9]) -
+                            model[4] * (model[1] * model[10] - model[2] * model[9]) +
+                            model[8] * (model[1] * model[6] - model[2] * model[5]);
+        bool uniform = low > 0.0f && high <= low * 1.01f && determinant > 0.0f;
+        return {model, high, uniform ? 1.0f / low : 0.0f};
+    }
+
+    /** Writes 1 for every visible meshlet in [begin, end), begin and end are multiples of 4 */
+    void cullRange(const MeshletCullData &data, const Transform &transform, const MeshletCullView &view,
+                   unsigned int begin, unsigned int end, uint8_t *visible) {
+        const float *m = transform.m;
+#ifdef MESHLETS_SSE2
+        const __m128 m0 = _mm_set1_ps(m[0]), m1 = _mm_set1_ps(m[1]), m2 = _mm_set1_ps(m[2]);
+        const __m128 m4 = _mm_set1_ps(m[4]), m5 = _mm_set1_ps(m[5]), m6 = _mm_set1_ps(m[6]);
+        const __m128 m8 = _mm_set1_ps(m[8]), m9 = _mm_set1_ps(m[9]), m10 = _mm_set1_ps(m[10]);
+        const __m128 m12 = _mm_set1_ps(m[12]), m13 = _mm_set1_ps(m[13]), m14 = _mm_set1_ps(m[14]);
+        const __m128 radiusScale = _mm_set1_ps(transform.radiusScale), axisScale = _mm_set1_ps(transform.axisScale);
+        const __m128 cameraX = _mm_set1_ps(view.cameraPosition[0]);
+        const __m128 cameraY = _mm_set1_ps(view.cameraPosition[1]);
+        const __m128 cameraZ = _mm_set1_ps(view.cameraPosition[2]);
+
+        for (unsigned int i = begin; i < end; i += 4) {
+            // four meshlets per register, centers and radii to world space
+            __m128 x = _mm_loadu_ps(&data.centerX[i]), y = _mm_loadu_ps(&data.centerY[i]), z = _mm_loadu_ps(&data.centerZ[i]);
+            __m128 wx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m0, x), _mm_mul_ps(m4, y)), _mm_add_ps(_mm_mul_ps(m8, z), m12));
+            __m128 wy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m1, x), _mm_mul_ps(m5, y)), _mm_add_ps(_mm_mul_ps(m9, z), m13));
+            __m128 wz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m2, x), _mm_mul_ps(m6, y)), _mm_add_ps(_mm_mul_ps(m10, z), m14));
+            __m128 radius = _mm_mul_ps(_mm_loadu_ps(&data.radius[i]), radiusScale);
+            __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), radius);
+
+            __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (const float *plane : view.planes) {
+                __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane[0]), wx), _mm_mul_ps(_mm_set1_ps(plane[1]), wy)),
+                                             _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane[2]), wz), _mm_set1_ps(plane[3])));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+            }
+
+            if (transform.axisScale != 0.0f) {
+                // back facing if the whole sphere lies inside the cone behind the surface
+                __m128 ax = _mm_loadu_ps(&data.axisX[i]), ay = _mm_loadu_ps(&data.axisY[i]), az = _mm_loadu_ps(&data.axisZ[i]);
+                __m128 wax = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m0, ax), _mm_mul_ps(m4, ay)), _mm_mul_ps(m8, az)), axisScale);
+                __m128 way = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m1, ax), _mm_mul_ps(m5, ay)), _mm_mul_ps(m9, az)), axisScale);
+                __m128 waz = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m2, ax), _mm_mul_ps(m6, ay)), _mm_mul_ps(m10, az)), axisScale);
+                __m128 dx = _mm_sub_ps(wx, cameraX), dy = _mm_sub_ps(wy, cameraY), dz = _mm_sub_ps(wz, cameraZ);
+                __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+                __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, wax), _mm_mul_ps(dy, way)), _mm_mul_ps(dz, waz));
+                __m128 limit = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&data.cutoff[i]), length), radius);
+                inside = _mm_andnot_ps(_mm_cmpge_ps(dot, limit), inside);
+            }
+
+            int mask = _mm_movemask_ps(inside);
+            for (unsigned int k = 0; k < 4; ++k) visible[i + k] = uint8_t((mask >> k) & 1);
+        }
+#else
+        for (unsigned int i = begin; i < end; ++i) {
+            float x = data.centerX[i], y = data.centerY[i], z = data.centerZ[i];
+            float world[3] = {m[0] * x + m[4] * y + m[8] * z + m[12],
+                              m[1] * x + m[5] * y + m[9] * z + m[13],
+                              m[2] * x + m[6] * y + m[10] * z + m[14]};
+            float radius = data.radius[i] * transform.radiusScale;
+            bool inside = true;
+            for (const float *plane : view.planes)
+                inside = inside && plane[0] * world[0] + plane[1] * world[1] + plane[2] * world[2] + plane[3] >= -radius;
+
+            if (inside && transform.axisScale != 0.0f) {
+                float ax = data.axisX[i], ay = data.axisY[i], az = data.axisZ[i];
+                float dot = 0.0f, length = 0.0f;
+                for (int k = 0; k < 3; ++k) {
+                    float axis = (m[k] * ax + m[4 + k] * ay + m[8 + k] * az) * transform.axisScale;
+                    float d = world[k] - view.cameraPosition[k];
+                    dot += d * axis;
+                    length += d * d;
+                }
+                inside = dot < data.cutoff[i] * std::sqrt(length) + radius;
+            }
+            visible[i] = uint8_t(inside);
+        }
+#endif
+    }
+}
+
+void MeshletCullData::assign(const Meshlet *meshlets, size_t meshletCount) {
+    count = meshletCount;
+    size_t padded = (meshletCount + 3) / 4 * 4;
+    for (std::vector<float> *array : {&centerX, &centerY, &centerZ, &radius, &axisX, &axisY, &axisZ, &cutoff})
+        array->assign(padded, 0.0f);
+    firstIndex.assign(padded, 0);
+    indexCount.assign(padded, 0);
+    for (size_t i = 0; i < meshletCount; ++i) {
+        const Meshlet &meshlet = meshlets[i];
+        centerX[i] = meshlet.center[0];
+        centerY[i] = meshlet.center[1];
+        centerZ[i] = meshlet.center[2];
+        radius[i] = meshlet.radius;
+        axisX[i] = meshlet.coneAxis[0];
+        axisY[i] = meshlet.coneAxis[1];
+        axisZ[i] = meshlet.coneAxis[2];
+        cutoff[i] = meshlet.coneCutoff;
+        firstIndex[i] = meshlet.firstIndex;
+        indexCount[i] = meshlet.indexCount;
+    }
+}
+
+MeshletCullView MeshletCullView::fromViewProjection(const float viewProjection[16], const float cameraPosition[3]) {
+    // Gribb/Hartmann: the planes are sums and differences of the fourth row with the other rows
+    MeshletCullView view;
+    for (int i = 0; i < 3; ++i) {
+        for (int k = 0; k < 4; ++k) {
+            float row = viewProjection[k * 4 + i], w = viewProjection[k * 4 + 3];
+            view.planes[i * 2][k] = w + row;
+            view.planes[i * 2 + 1][k] = w - row;
+        }
+        normalizePlane(view.planes[i * 2]);
+        normalizePlane(view.planes[i * 2 + 1]);
+    }
+    std::copy(cameraPosition, cameraPosition + 3, view.cameraPosition);
+    return view;
+}
+
+std::vector<Meshlet> Meshlets::build(MeshData &mesh, size_t firstIndex, size_t indexCount) {
+    std::vector<Meshlet> meshlets;
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0) return meshlets;
+    unsigned int *range = mesh.indices.data() + firstIndex;
+    std::vector<unsigned int> source(range, range + triangleCount * 3);
+    size_t vertexCount = mesh.vertices.size();
+
+    // vertex -> triangles of the range
+    std::vector<unsigned int> adjacencyOffsets(vertexCount + 1, 0);
+    for (unsigned int index : source) ++adjacencyOffsets[index + 1];
+    for (size_t v = 0; v < vertexCount; ++v) adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+    std::vector<unsigned int> adjacency(source.size());
+    std::vector<unsigned int> liveTriangles(vertexCount);
+    {
+        std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (size_t i = 0; i < source.size(); ++i) adjacency[fill[source[i]]++] = unsigned(i / 3);
+        for (size_t v = 0; v < vertexCount; ++v) liveTriangles[v] = adjacencyOffsets[v + 1] - adjacencyOffsets[v];
+    }
+
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<bool> inMeshlet(vertexCount, false);
+    unsigned int meshletVertices[MAX_VERTICES];
+    unsigned int meshletVertexCount = 0, meshletTriangleCount = 0;
+    size_t written = 0, seed = 0;
+
+    auto finish = [&]() {
+        Meshlet meshlet{};
+        meshlet.firstIndex = uint32_t(firstIndex + written - meshletTriangleCount * 3);
+        meshlet.indexCount = meshletTriangleCount * 3;
+        meshlet.vertexCount = meshletVertexCount;
+        computeBounds(mesh, range + written - meshletTriangleCount * 3, meshletVertices, meshletVertexCount,
+                      meshletTriangleCount * 3, meshlet);
+        meshlets.push_back(meshlet);
+        for (unsigned int i = 0; i < meshletVertexCount; ++i) inMeshlet[meshletVertices[i]] = false;
+        meshletVertexCount = meshletTriangleCount = 0;
+    };
+
+    for (size_t emittedCount = 0; emittedCount < triangleCount; ++emittedCount) {
+        // grow across shared vertices, preferring the triangle that adds the fewest new vertices
+        size_t best = triangleCount;
+        unsigned int bestNew = 4;
+        for (unsigned int i = 0; i < meshletVertexCount && bestNew > 0; ++i) {
+            unsigned int vertex = meshletVertices[i];
+            if (liveTriangles[vertex] == 0) continue;
+            for (unsigned int a = adjacencyOffsets[vertex]; a < adjacencyOffsets[vertex + 1]; ++a) {
+                unsigned int triangle = adjacency[a];
+                if (emitted[triangle]) continue;
+                const unsigned int *t = &source[triangle * 3];
+                unsigned int added = !inMeshlet[t[0]] + !inMeshlet[t[1]] + (t[2] != t[0] && t[2] != t[1] && !inMeshlet[t[2]]);
+                if (meshletVertexCount + added > MAX_VERTICES) continue;
+                if (added < bestNew || (added == bestNew && triangle < best)) {
+                    best = triangle;
+                    bestNew = added;
+                }
+            }
+        }
+        if (best == triangleCount) {
+            // nothing adjacent fits, start over at the next triangle in cache order
+            if (meshletTriangleCount > 0) finish();
+            while (emitted[seed]) ++seed;
+            best = seed;
+        }
+
+        emitted[best] = true;
+        for (unsigned int k = 0; k < 3; ++k) {
+            unsigned int vertex = source[best * 3 + k];
+            range[written++] = vertex;
+            --liveTriangles[vertex];
+            if (!inMeshlet[vertex]) {
+                inMeshlet[vertex] = true;
+                meshletVertices[meshletVertexCount++] = vertex;
+            }
+        }
+        if (++meshletTriangleCount == MAX_TRIANGLES) finish();
+    }
+    if (meshletTriangleCount > 0) finish();
+    return meshlets;
+}
+
+void Meshlets::cull(const MeshletCullData &meshlets, const float model[16], const MeshletCullView &view,
+                    GLenum indexType, MeshletDrawList &draws) {
+    draws.counts.clear();
+    draws.offsets.clear();
+    draws.visibleMeshlets = draws.visibleTriangles = 0;
+    if (meshlets.count == 0) return;
+
+    unsigned int padded = unsigned(meshlets.centerX.size());
+    draws.visible.resize(padded);
+    Transform transform = transformOf(model);
+    // 1024 meshlets (~100k triangles) per job, smaller meshes are culled on the calling thread
+    JobSystem::parallelFor(padded / 4, 256, [&](unsigned int begin, unsigned int end) {
+        cullRange(meshlets, transform, view, begin * 4, end * 4, draws.visible.data());
+    });
+
+    // meshlets are contiguous in the index buffer, runs of visible ones become one draw
+    size_t indexSize = indexType == GL_UNSIGNED_SHORT ? 2 : 4;
+    uint32_t end = 0;
+    for (size_t i = 0; i < meshlets.count; ++i) {
+        if (!draws.visible[i]) continue;
+        ++draws.visibleMeshlets;
+        draws.visibleTriangles += meshlets.indexCount[i] / 3;
+        if (!draws.counts.empty() && meshlets.firstIndex[i] == end) {
+            draws.counts.back() += GLsizei(meshlets.indexCount[i]);
+        } else {
+            draws.counts.push_back(GLsizei(meshlets.indexCount[i]));
+            draws.offsets.push_back(reinterpret_cast<const void *>(meshlets.firstIndex[i] * indexSize));
+        }
+        end = meshlets.firstIndex[i] + meshlets.indexCount[i];
+    }
+}
+
+void Meshlets::draw(const GpuMesh &mesh, const MeshletDrawList &draws) {
+    if (draws.counts.empty()) return;
+    glBindVertexArray(mesh.vertexArray);
+    glMultiDrawElements(GL_TRIANGLES, draws.counts.data(), mesh.indexType, draws.offsets.data(), GLsizei(draws.counts.size()));
+}
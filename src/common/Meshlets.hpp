@@ -0,0 +1,92 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#ifndef MESHLETS_H
+#define MESHLETS_H
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Meshes.hpp"
+
+
+/** Cluster of up to 64 vertices and 124 triangles, a contiguous range of the mesh index buffer */
+struct Meshlet {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    uint32_t vertexCount; // unique vertices
+    uint32_t reserved;
+    float center[3];      // bounding sphere, object space
+    float radius;
+    float coneAxis[3];    // average normal direction
+    float coneCutoff;     // sine of the normal cone half angle, 1 if the cone is too wide to ever be back facing
+};
+static_assert(sizeof(Meshlet) == 48, "Meshlet is stored as is in .mesh files");
+
+/** Meshlet bounds in structure of arrays layout for the SIMD culling, padded to a multiple of 4 */
+struct MeshletCullData {
+    std::vector<float> centerX, centerY, centerZ, radius;
+    std::vector<float> axisX, axisY, axisZ, cutoff;
+    std::vector<uint32_t> firstIndex, indexCount;
+    size_t count = 0;
+
+    void assign(const Meshlet *meshlets, size_t meshletCount);
+};
+
+/** Camera of a culling pass, planes point inwards (Ax + By + Cz + D >= 0 inside) */
+struct MeshletCullView {
+    float planes[6][4];
+    float cameraPosition[3];
+
+    /** Extracts the frustum planes of a column major view projection matrix */
+    static MeshletCullView fromViewProjection(const float viewProjection[16], const float cameraPosition[3]);
+};
+
+/** Visible index ranges of one culling pass, adjacent visible meshlets are merged into one range */
+struct MeshletDrawList {
+    std::vector<GLsizei> counts;
+    std::vector<const void *> offsets; // byte offsets into the element buffer
+    size_t visibleMeshlets = 0;
+    size_t visibleTriangles = 0;
+    std::vector<uint8_t> visible; // per meshlet result of the last pass, kept to reuse the allocation
+};
+
+/** Meshlet builder (import time) and per meshlet frustum and back face culling (runtime)
+ *
+ *  The culling tests four meshlets per SSE register on the JobSystem workers, the surviving ranges are drawn with
+ *  one glMultiDrawElements call.
+ */
+class Meshlets {
+public:
+    static constexpr unsigned int MAX_VERTICES = 64;
+    static constexpr unsigned int MAX_TRIANGLES = 124;
+
+    /** Splits an index range into meshlets, the triangles of the range are reordered so each meshlet is contiguous
+     *
+     *  Meshlets grow across shared edges from the triangle order of the range (run optimizeVertexCache before),
+     *  which keeps them compact and their normal cones narrow.
+     *
+     *  @param[in,out] mesh The mesh, only mesh.indices[firstIndex, firstIndex + indexCount) is reordered
+     *  @returns The meshlets in index buffer order
+     */
+    static std::vector<Meshlet> build(MeshData &mesh, size_t firstIndex, size_t indexCount);
+
+    /** Culls the meshlets of one mesh instance
+     *
+     *  @param[in] meshlets Bounds of the mesh's meshlets
+     *  @param[in] model Column major model matrix, the cone test is skipped for non uniform scales
+     *  @param[in] view Frustum and camera position in world space
+     *  @param[in] indexType Index type of the element buffer the meshlets refer to
+     *  @param[out] draws Merged visible ranges
+     */
+    static void cull(const MeshletCullData &meshlets, const float model[16], const MeshletCullView &view,
+                     GLenum indexType, MeshletDrawList &draws);
+
+    /** Draws the visible ranges of a mesh with a single glMultiDrawElements call */
+    static void draw(const GpuMesh &mesh, const MeshletDrawList &draws);
+};
+
+
+
+#endif //MESHLETS_H
@@ -0,0 +1,328 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#include "OcclusionCuller.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define OCCLUSION_CULLER_SSE2
+#endif
+
+#include "JobSystem.hpp"
+#include "Memory.hpp"
+
+namespace {
+    /** result = a * b, column major 4x4 */
+    void multiply(const float a[16], const float b[16], float result[16]) {
+        for (int column = 0; column < 4; ++column) {
+            for (int row = 0; row < 4; ++row) {
+                float sum = 0.0f;
+                for (int k = 0; k < 4; ++k) sum += a[k * 4 + row] * b[column * 4 + k];
+                result[column * 4 + row] = sum;
+            }
+        }
+    }
+
+    void transformPoint(const float m[16], const float *p, float clip[4]) {
+        for (int row = 0; row < 4; ++row) clip[row] = m[row] * p[0] + m[4 + row] * p[1] + m[8 + row] * p[2] + m[12 + row];
+    }
+
+    /** Float to int for bounding boxes of triangles reaching far outside the screen */
+    int clampToInt(float value, int low, int high) {
+        return int(std::clamp(value, float(low), float(high)));
+    }
+}
+
+OcclusionCuller::OcclusionCuller(unsigned int width, unsigned int height)
+    : bufferWidth((std::max(width, 8u) + 7) / 8 * 8), bufferHeight((std::max(height, 8u) + 7) / 8 * 8) {
+    tilesX = (bufferWidth + TILE_WIDTH - 1) / TILE_WIDTH;
+    tilesY = (bufferHeight + TILE_HEIGHT - 1) / TILE_HEIGHT;
+    bins.resize(size_t(tilesX) * tilesY);
+
+    size_t size = 0;
+    for (unsigned int w = bufferWidth, h = bufferHeight;; w = (w + 1) / 2, h = (h + 1) / 2) {
+        levelOffsets.push_back(size);
+        levelWidths.push_back(w);
+        levelHeights.push_back(h);
+        size += size_t(w) * h;
+        if (w == 1 && h == 1) break;
+    }
+    hiz.assign(size, 1.0f);
+    static constexpr float IDENTITY[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+    memcpy(viewProjection, IDENTITY, sizeof(viewProjection));
+}
+
+void OcclusionCuller::beginFrame(const float matrix[16]) {
+    memcpy(viewProjection, matrix, sizeof(viewProjection));
+    occluders.clear();
+}
+
+void OcclusionCuller::addOccluder(const float *positions, size_t stride, size_t vertexCount, const unsigned int *indices,
+                                  size_t indexCount, const float model[16]) {
+    Occluder occluder{positions, stride, vertexCount, indices, indexCount / 3 * 3, {}};
+    multiply(viewProjection, model, occluder.transform);
+    occluders.push_back(occluder);
+}
+
+void OcclusionCuller::transformOccluder(const Occluder &occluder, std::vector<ScreenTriangle> &result) const {
+    result.clear();
+    // clip space -> pixels, NDC z stays as is
+    float halfWidth = float(bufferWidth) * 0.5f, halfHeight = float(bufferHeight) * 0.5f;
+    // per frame temporaries from the scratch stack of the worker running this occluder
+    ScratchScope scratch;
+    float *screen = scratch.allocateArray<float>(occluder.vertexCount * 3);
+    uint8_t *inFront = scratch.allocateArray<uint8_t>(occluder.vertexCount);
+    const unsigned char *base = reinterpret_cast<const unsigned char *>(occluder.positions);
+    for (size_t v = 0; v < occluder.vertexCount; ++v) {
+        float clip[4];
+        transformPoint(occluder.transform, reinterpret_cast<const float *>(base + v * occluder.stride), clip);
+        inFront[v] = clip[3] > 0.0f && clip[2] >= -clip[3];
+        if (!inFront[v]) continue;
+        screen[v * 3] = (clip[0] / clip[3] + 1.0f) * halfWidth;
+        screen[v * 3 + 1] = (clip[1] / clip[3] + 1.0f) * halfHeight;
+        screen[v * 3 + 2] = clip[2] / clip[3];
+    }
+
+    for (size_t i = 0; i < occluder.indexCount; i += 3) {
+        const unsigned int *t = occluder.indices + i;
+        if (t[0] >= occluder.vertexCount || t[1] >= occluder.vertexCount || t[2] >= occluder.vertexCount) continue;
+        if (!inFront[t[0]] || !inFront[t[1]] || !inFront[t[2]]) continue;
+        const float *p0 = &screen[t[0] * 3], *p1 = &screen[t[1] * 3], *p2 = &screen[t[2] * 3];
+        float area = (p1[0] - p0[0]) * (p2[1] - p0[1]) - (p2[0] - p0[0]) * (p1[1] - p0[1]);
+        if (area == 0.0f || !std::isfinite(area)) continue;
+        // occluders are drawn from both sides, counter clockwise order makes the edge functions positive inside
+        if (area < 0.0f) {
+            std::swap(p1, p2);
+            area = -area;
+        }
+
+        // pixel centers at x + 0.5, covered if the center is inside
+        float minX = std::min({p0[0], p1[0], p2[0]}), maxX = std::max({p0[0], p1[0], p2[0]});
+        float minY = std::min({p0[1], p1[1], p2[1]}), maxY = std::max({p0[1], p1[1], p2[1]});
+        ScreenTriangle triangle;
+        triangle.minX = clampToInt(std::floor(minX), 0, int(bufferWidth));
+        triangle.maxX = clampToInt(std::ceil(maxX), -1, int(bufferWidth) - 1);
+        triangle.minY = clampToInt(std::floor(minY), 0, int(bufferHeight));
+        triangle.maxY = clampToInt(std::ceil(maxY), -1, int(bufferHeight) - 1);
+        if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY) continue;
+
+        const float *corners[3] = {p0, p1, p2};
+        for (int e = 0; e < 3; ++e) {
+            const float *a = corners[e], *b = corners[(e + 1) % 3];
+            triangle.edge[e][0] = a[1] - b[1];
+            triangle.edge[e][1] = b[0] - a[0];
+            triangle.edge[e][2] = a[0] * b[1] - a[1] * b[0];
+        }
+        float dzdx = ((p1[2] - p0[2]) * (p2[1] - p0[1]) - (p2[2] - p0[2]) * (p1[1] - p0[1])) / area;
+        float dzdy = ((p2[2] - p0[2]) * (p1[0] - p0[0]) - (p1[2] - p0[2]) * (p2[0] - p0[0])) / area;
+        triangle.depth[0] = dzdx;
+        triangle.depth[1] = dzdy;
+        triangle.depth[2] = p0[2] - dzdx * p0[0] - dzdy * p0[1];
+        result.push_back(triangle);
+    }
+}
+
+void OcclusionCuller::rasterize() {
+    occluderTriangles.resize(std::max(occluderTriangles.size(), occluders.size()));
+    JobSystem::parallelFor(unsigned(occluders.size()), 1, [&](unsigned int begin, unsigned int end) {
+        for (unsigned int i = begin; i < end; ++i) transformOccluder(occluders[i], occluderTriangles[i]);
+    });
+
+    triangles.clear();
+    for (size_t i = 0; i < occluders.size(); ++i)
+        triangles.insert(triangles.end(), occluderTriangles[i].begin(), occluderTriangles[i].end());
+    for (std::vector<uint32_t> &bin : bins) bin.clear();
+    for (size_t i = 0; i < triangles.size(); ++i) {
+        const ScreenTriangle &triangle = triangles[i];
+        for (unsigned int ty = unsigned(triangle.minY) / TILE_HEIGHT; ty <= unsigned(triangle.maxY) / TILE_HEIGHT; ++ty)
+            for (unsigned int tx = unsigned(triangle.minX) / TILE_WIDTH; tx <= unsigned(triangle.maxX) / TILE_WIDTH; ++tx)
+                bins[ty * tilesX + tx].push_back(uint32_t(i));
+    }
+
+    // tiles do not share pixels, every job clears and fills its own
+    JobSystem::parallelFor(tilesX * tilesY, 1, [&](unsigned int begin, unsigned int end) {
+        for (unsigned int tile = begin; tile < end; ++tile) rasterizeTile(tile);
+    });
+    buildHiZ();
+}
+
+void OcclusionCuller::rasterizeTile(unsigned int tile) {
+    int tileX = int(tile % tilesX * TILE_WIDTH), tileY = int(tile / tilesX * TILE_HEIGHT);
+    int tileMaxX = std::min(tileX + int(TILE_WIDTH), int(bufferWidth)) - 1;
+    int tileMaxY = std::min(tileY + int(TILE_HEIGHT), int(bufferHeight)) - 1;
+    float *depth = hiz.data();
+    for (int y = tileY; y <= tileMaxY; ++y)
+        std::fill(depth + size_t(y) * bufferWidth + tileX, depth + size_t(y) * bufferWidth + tileMaxX + 1, 1.0f);
+
+    for (uint32_t index : bins[tile]) {
+        const ScreenTriangle &t = triangles[index];
+        // spans start at multiples of 4, the buffer width is a multiple of 8
+        int minX = std::max(t.minX, tileX) & ~3, maxX = std::min(t.maxX, tileMaxX);
+        int minY = std::max(t.minY, tileY), maxY = std::min(t.maxY, tileMaxY);
+#ifdef OCCLUSION_CULLER_SSE2
+        const __m128 a0 = _mm_set1_ps(t.edge[0][0]), a1 = _mm_set1_ps(t.edge[1][0]), a2 = _mm_set1_ps(t.edge[2][0]);
+        const __m128 depthA = _mm_set1_ps(t.depth[0]);
+        const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+        for (int y = minY; y <= maxY; ++y) {
+            float centerY = float(y) + 0.5f;
+            __m128 row0 = _mm_set1_ps(t.edge[0][1] * centerY + t.edge[0][2]);
+            __m128 row1 = _mm_set1_ps(t.edge[1][1] * centerY + t.edge[1][2]);
+            __m128 row2 = _mm_set1_ps(t.edge[2][1] * centerY + t.edge[2][2]);
+            __m128 rowDepth = _mm_set1_ps(t.depth[1] * centerY + t.depth[2]);
+            float *line = depth + size_t(y) * bufferWidth;
+            for (int x = minX; x <= maxX; x += 4) {
+                __m128 centerX = _mm_add_ps(_mm_set1_ps(float(x)), offsets);
+                __m128 e0 = _mm_add_ps(_mm_mul_ps(a0, centerX), row0);
+                __m128 e1 = _mm_add_ps(_mm_mul_ps(a1, centerX), row1);
+                __m128 e2 = _mm_add_ps(_mm_mul_ps(a2, centerX), row2);
+                // inside where all three edge functions are >= 0
+                __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, _mm_setzero_ps()), _mm_cmpge_ps(e1, _mm_setzero_ps())),
+                                           _mm_cmpge_ps(e2, _mm_setzero_ps()));
+                if (_mm_movemask_ps(inside) == 0) continue;
+                __m128 z = _mm_add_ps(_mm_mul_ps(depthA, centerX), rowDepth);
+                __m128 previous = _mm_loadu_ps(line + x);
+                __m128 nearest = _mm_min_ps(previous, z);
+                _mm_storeu_ps(line + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, previous)));
+            }
+        }
+#else
+        for (int y = minY; y <= maxY; ++y) {
+            float centerY = float(y) + 0.5f;
+            float *line = depth + size_t(y) * bufferWidth;
+            for (int x = minX; x < maxX + 1; ++x) {
+                float centerX = float(x) + 0.5f;
+                bool inside = true;
+                for (const float *edge : t.edge) inside = inside && edge[0] * centerX + edge[1] * centerY + edge[2] >= 0.0f;
+                if (!inside) continue;
+                float z = t.depth[0] * centerX + t.depth[1] * centerY + t.depth[2];
+                line[x] = std::min(line[x], z);
+            }
+        }
+#endif
+    }
+}
+
+void OcclusionCuller::buildHiZ() {
+    // every texel keeps the farthest depth of the (up to) 2x2 texels below it
+    for (size_t level = 1; level < levelOffsets.size(); ++level) {
+        const float *source = hiz.data() + levelOffsets[level - 1];
+        float *target = hiz.data() + levelOffsets[level];
+        unsigned int sourceWidth = levelWidths[level - 1], sourceHeight = levelHeights[level - 1];
+        for (unsigned int y = 0; y < levelHeights[level]; ++y) {
+            unsigned int y0 = y * 2, y1 = std::min(y0 + 1, sourceHeight - 1);
+            for (unsigned int x = 0; x < levelWidths[level]; ++x) {
+                unsigned int x0 = x * 2, x1 = std::min(x0 + 1, sourceWidth - 1);
+                target[size_t(y) * levelWidths[level] + x] =
+                        std::max(std::max(source[size_t(y0) * sourceWidth + x0], source[size_t(y0) * sourceWidth + x1]),
+                                 std::max(source[size_t(y1) * sourceWidth + x0], source[size_t(y1) * sourceWidth + x1]));
+            }
+        }
+    }
+}
+
+bool OcclusionCuller::isVisible(const float boundsMin[3], const float boundsMax[3], const float model[16]) const {
+    float transform[16];
+    multiply(viewProjection, model, transform);
+
+    // corners as the transformed minimum plus the transformed box edges
+    float base[4], edges[3][4];
+    transformPoint(transform, boundsMin, base);
+    for (int axis = 0; axis < 3; ++axis)
+        for (int row = 0; row < 4; ++row) edges[axis][row] = transform[axis * 4 + row] * (boundsMax[axis] - boundsMin[axis]);
+
+    float minX, minY, maxX, maxY, nearest;
+#ifdef OCCLUSION_CULLER_SSE2
+    // clip[row][half] holds one clip space component of corners 0-3 and 4-7
+    const __m128 select0 = _mm_setr_ps(0, 1, 0, 1), select1 = _mm_setr_ps(0, 0, 1, 1);
+    __m128 clip[4][2];
+    for (int row = 0; row < 4; ++row) {
+        clip[row][0] = _mm_add_ps(_mm_add_ps(_mm_set1_ps(base[row]), _mm_mul_ps(select0, _mm_set1_ps(edges[0][row]))),
+                                  _mm_mul_ps(select1, _mm_set1_ps(edges[1][row])));
+        clip[row][1] = _mm_add_ps(clip[row][0], _mm_set1_ps(edges[2][row]));
+    }
+    // all corners outside one frustum plane
+    for (int axis = 0; axis < 3; ++axis) {
+        __m128 negativeW0 = _mm_sub_ps(_mm_setzero_ps(), clip[3][0]), negativeW1 = _mm_sub_ps(_mm_setzero_ps(), clip[3][1]);
+        if ((_mm_movemask_ps(_mm_cmplt_ps(clip[axis][0], negativeW0)) & _mm_movemask_ps(_mm_cmplt_ps(clip[axis][1], negativeW1))) == 15 ||
+            (_mm_movemask_ps(_mm_cmpgt_ps(clip[axis][0], clip[3][0])) & _mm_movemask_ps(_mm_cmpgt_ps(clip[axis][1], clip[3][1]))) == 15)
+            return false;
+    }
+    // the box reaches behind the camera, its projection is unbounded
+    for (int half = 0; half < 2; ++half) {
+        __m128 behind = _mm_or_ps(_mm_cmple_ps(clip[3][half], _mm_setzero_ps()),
+                                  _mm_cmplt_ps(clip[2][half], _mm_sub_ps(_mm_setzero_ps(), clip[3][half])));
+        if (_mm_movemask_ps(behind)) return true;
+    }
+
+    __m128 reciprocal[2] = {_mm_div_ps(_mm_set1_ps(1.0f), clip[3][0]), _mm_div_ps(_mm_set1_ps(1.0f), clip[3][1])};
+    __m128 x[2], y[2], z[2];
+    for (int half = 0; half < 2; ++half) {
+        x[half] = _mm_mul_ps(clip[0][half], reciprocal[half]);
+        y[half] = _mm_mul_ps(clip[1][half], reciprocal[half]);
+        z[half] = _mm_mul_ps(clip[2][half], reciprocal[half]);
+    }
+    auto horizontalMin = [](__m128 v) {
+        v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+        return _mm_cvtss_f32(_mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1))));
+    };
+    auto horizontalMax = [](__m128 v) {
+        v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+        return _mm_cvtss_f32(_mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1))));
+    };
+    minX = horizontalMin(_mm_min_ps(x[0], x[1]));
+    maxX = horizontalMax(_mm_max_ps(x[0], x[1]));
+    minY = horizontalMin(_mm_min_ps(y[0], y[1]));
+    maxY = horizontalMax(_mm_max_ps(y[0], y[1]));
+    nearest = horizontalMin(_mm_min_ps(z[0], z[1]));
+#else
+    minX = minY = nearest = 1e30f;
+    maxX = maxY = -1e30f;
+    int outside[6] = {0, 0, 0, 0, 0, 0};
+    bool crossesNear = false;
+    for (int corner = 0; corner < 8; ++corner) {
+        float clip[4];
+        for (int row = 0; row < 4; ++row)
+            clip[row] = base[row] + (corner & 1 ? edges[0][row] : 0.0f) + (corner & 2 ? edges[1][row] : 0.0f) +
+                        (corner & 4 ? edges[2][row] : 0.0f);
+        for (int axis = 0; axis < 3; ++axis) {
+            outside[axis * 2] += clip[axis] < -clip[3];
+            outside[axis * 2 + 1] += clip[axis] > clip[3];
+        }
+        if (clip[3] <= 0.0f || clip[2] < -clip[3]) {
+            crossesNear = true;
+            continue;
+        }
+        minX = std::min(minX, clip[0] / clip[3]);
+        maxX = std::max(maxX, clip[0] / clip[3]);
+        minY = std::min(minY, clip[1] / clip[3]);
+        maxY = std::max(maxY, clip[1] / clip[3]);
+        nearest = std::min(nearest, clip[2] / clip[3]);
+    }
+    // all corners outside one frustum plane
+    for (int count : outside) if (count == 8) return false;
+    // the box reaches behind the camera, its projection is unbounded
+    if (crossesNear) return true;
+#endif
+    // NDC -> pixels
+    minX = (minX + 1.0f) * 0.5f * float(bufferWidth);
+    maxX = (maxX + 1.0f) * 0.5f * float(bufferWidth);
+    minY = (minY + 1.0f) * 0.5f * float(bufferHeight);
+    maxY = (maxY + 1.0f) * 0.5f * float(bufferHeight);
+
+    // texels touched by the screen rectangle, at the first level where that is at most 3x3
+    int x0 = clampToInt(std::floor(minX), 0, int(bufferWidth) - 1), x1 = clampToInt(std::floor(maxX), 0, int(bufferWidth) - 1);
+    int y0 = clampToInt(std::floor(minY), 0, int(bufferHeight) - 1), y1 = clampToInt(std::floor(maxY), 0, int(bufferHeight) - 1);
+    size_t level = 0;
+    while (level + 1 < levelOffsets.size() && ((x1 >> level) - (x0 >> level) > 2 || (y1 >> level) - (y0 >> level) > 2)) ++level;
+
+    const float *texels = hiz.data() + levelOffsets[level];
+    for (int y = y0 >> level; y <= y1 >> level; ++y)
+        for (int x = x0 >> level; x <= x1 >> level; ++x)
+            if (texels[size_t(y) * levelWidths[level] + x] >= nearest) return true;
+    return false;
+}
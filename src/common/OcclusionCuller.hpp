@@ -0,0 +1,109 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#ifndef OCCLUSIONCULLER_H
+#define OCCLUSIONCULLER_H
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Meshes.hpp"
+
+
+/** Software depth buffer for CPU occlusion culling
+ *
+ *  Occluders (walls, floors, large props) are rasterized into a low resolution depth buffer, one job per screen tile
+ *  with four pixels per SSE register. A Hi-Z pyramid keeps the farthest depth of every 2x2 block so a bounding box is
+ *  tested against at most 3x3 texels of the level matching its screen size.
+ *
+ *  Depths are NDC z in [-1, 1] (far is 1), rows go bottom to top like the viewport. Occluder triangles crossing the
+ *  near plane are dropped, which can only make more objects visible.
+ *
+ *  Per frame: beginFrame(), addOccluder() for each occluder, rasterize(), then isVisible() for each object.
+ */
+class OcclusionCuller {
+public:
+    static constexpr unsigned int TILE_WIDTH = 64;
+    static constexpr unsigned int TILE_HEIGHT = 32;
+
+    /** @param[in] width, height Depth buffer size, rounded up to multiples of 8 */
+    explicit OcclusionCuller(unsigned int width = 256, unsigned int height = 192);
+
+    /** Starts a frame, the occluders of the previous one are dropped
+     *
+     *  @param[in] viewProjection Column major projection * view matrix of the camera
+     */
+    void beginFrame(const float viewProjection[16]);
+
+    /** Queues an occluder, the vertex and index data must stay alive until rasterize() returns
+     *
+     *  @param[in] positions First vertex position (3 floats), the following ones are stride bytes apart
+     *  @param[in] indices Triangle list, winding does not matter
+     *  @param[in] model Column major model matrix
+     */
+    void addOccluder(const float *positions, size_t stride, size_t vertexCount, const unsigned int *indices,
+                     size_t indexCount, const float model[16]);
+    void addOccluder(const MeshData &mesh, const float model[16]) {
+        if (mesh.vertices.empty()) return;
+        addOccluder(mesh.vertices.data()->position, sizeof(Vertex), mesh.vertices.size(), mesh.indices.data(),
+                    mesh.indices.size(), model);
+    }
+
+    /** Transforms and bins the occluder triangles, rasterizes all tiles and builds the Hi-Z pyramid on the workers */
+    void rasterize();
+
+    /** Tests an object space bounding box against the rasterized occluders
+     *
+     *  @returns false if the box is outside the view or behind the occluders, true if any part might be seen
+     */
+    bool isVisible(const float boundsMin[3], const float boundsMax[3], const float model[16]) const;
+
+    unsigned int width() const { return bufferWidth; }
+    unsigned int height() const { return bufferHeight; }
+    /** @returns Depth of level 0, width() * height() floats */
+    const float *depth() const { return hiz.data(); }
+    /** Hi-Z pyramid, level 0 is depth(), every level halves the size (rounded up) down to 1x1 */
+    size_t levelCount() const { return levelOffsets.size(); }
+    const float *level(size_t index) const { return hiz.data() + levelOffsets[index]; }
+    unsigned int levelWidth(size_t index) const { return levelWidths[index]; }
+    unsigned int levelHeight(size_t index) const { return levelHeights[index]; }
+    /** @returns Number of occluder triangles rasterized by the last rasterize() */
+    size_t triangleCount() const { return triangles.size(); }
+
+private:
+    struct Occluder {
+        const float *positions;
+        size_t stride;
+        size_t vertexCount;
+        const unsigned int *indices;
+        size_t indexCount;
+        float transform[16]; // viewProjection * model
+    };
+
+    /** Triangle set up for rasterization: edge and depth plane equations in pixel coordinates */
+    struct ScreenTriangle {
+        float edge[3][3];   // a * x + b * y + c >= 0 inside
+        float depth[3];     // z = a * x + b * y + c
+        int minX, minY, maxX, maxY;
+    };
+
+    void transformOccluder(const Occluder &occluder, std::vector<ScreenTriangle> &result) const;
+    void rasterizeTile(unsigned int tile);
+    void buildHiZ();
+
+    unsigned int bufferWidth, bufferHeight;
+    unsigned int tilesX, tilesY;
+    float viewProjection[16];
+    std::vector<Occluder> occluders;
+    std::vector<std::vector<ScreenTriangle>> occluderTriangles;
+    std::vector<ScreenTriangle> triangles;
+    std::vector<std::vector<uint32_t>> bins;   // triangle indices per tile
+    std::vector<float> hiz;                    // all levels, level 0 first
+    std::vector<size_t> levelOffsets;
+    std::vector<unsigned int> levelWidths, levelHeights;
+};
+
+
+
+#endif //OCCLUSIONCULLER_H
@@ -0,0 +1,602 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#include "ParticleSystem.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define PARTICLES_SSE2
+#endif
+
+#include "GLExtensions.hpp"
+#include "JobSystem.hpp"
+#include "Memory.hpp"
+#include "shader.hpp"
+
+#ifndef GL_BUFFER_UPDATE_BARRIER_BIT
+#define GL_BUFFER_UPDATE_BARRIER_BIT 0x00000200
+#endif
+
+namespace {
+    /** Layout of the Counters buffer of the particle shaders, starting with a DrawArraysIndirectCommand */
+    struct Counters {
+        GLuint vertexCount;
+        GLuint instanceCount;
+        GLuint firstVertex;
+        GLuint baseInstance;
+        GLint freeCount;
+        GLuint liveCount[2];
+        GLuint reserved;
+    };
+
+    // CPU path arrays, each one stride floats
+    enum Array : size_t { PositionX, PositionY, PositionZ, VelocityX, VelocityY, VelocityZ, Age, Lifetime, ArrayCount };
+
+    /** Instance attributes of ParticleBillboard.vert */
+    struct BillboardInstance {
+        float position[3];
+        float life;
+        uint8_t emitter;
+        uint8_t reserved[3];
+    };
+
+    constexpr GLuint SIMULATE_LOCAL_SIZE = 256;   // local_size_x of ParticleSimulate.comp
+    constexpr GLuint EMIT_LOCAL_SIZE = 64;        // local_size_x of ParticleEmit.comp
+    constexpr GLuint SORT_BLOCK = 1024;           // keys per workgroup of ParticleSort.comp
+    // particles per job of the CPU path, a multiple of 4
+    constexpr unsigned int SIMULATE_BATCH = 16384;
+    constexpr unsigned int INSTANCE_BATCH = 16384;
+
+    /** PCG32 (O'Neill, pcg-random.org): 64 bit LCG state, permuted 32 bit output */
+    uint32_t nextRandom(uint64_t &state) {
+        uint64_t old = state;
+        state = old * 6364136223846793005ull + 1442695040888963407ull;
+        auto shifted = uint32_t(((old >> 18u) ^ old) >> 27u);
+        auto rotation = uint32_t(old >> 59u);
+        return (shifted >> rotation) | (shifted << ((32u - rotation) & 31u));
+    }
+
+    float random(uint64_t &state) {
+        return float(nextRandom(state) >> 8u) * (1.0f / 16777216.0f);
+    }
+
+    /** Position, velocity and lifetime of a new particle, same math as ParticleEmit.comp */
+    void spawnParticle(const ParticleEmitter &emitter, uint64_t &state, float position[3], float velocity[3],
+                       float &lifetime) {
+        const float *axis = emitter.direction;
+        float cosTheta = std::cos(emitter.spread) + (1.0f - std::cos(emitter.spread)) * random(state);
+        float sinTheta = std::sqrt(std::max(1.0f - cosTheta * cosTheta, 0.0f));
+        float phi = 6.2831853f * random(state);
+        // tangent = normalize(cross(axis, up or x)), bitangent = cross(axis, tangent)
+        float tangent[3] = {-axis[2], 0.0f, axis[0]};
+        if (std::fabs(axis[1]) >= 0.99f) {
+            tangent[0] = 0.0f;
+            tangent[1] = axis[2];
+            tangent[2] = -axis[1];
+        }
+        float tangentLength = std::sqrt(tangent[0] * tangent[0] + tangent[1] * tangent[1] + tangent[2] * tangent[2]);
+        for (float &c : tangent) c /= tangentLength;
+        float bitangent[3] = {axis[1] * tangent[2] - axis[2] * tangent[1], axis[2] * tangent[0] - axis[0] * tangent[2],
+                              axis[0] * tangent[1] - axis[1] * tangent[0]};
+
+        float z = random(state) * 2.0f - 1.0f;
+        float angle = 6.2831853f * random(state);
+        float radius = emitter.radius * std::cbrt(random(state));
+        float ring = std::sqrt(std::max(1.0f - z * z, 0.0f));
+        float offset[3] = {ring * std::cos(angle) * radius, ring * std::sin(angle) * radius, z * radius};
+
+        float speed = emitter.speedMin + (emitter.speedMax - emitter.speedMin) * random(state);
+        const float cosPhi = std::cos(phi), sinPhi = std::sin(phi);
+        for (int c = 0; c < 3; ++c) {
+            float direction = (tangent[c] * cosPhi + bitangent[c] * sinPhi) * sinTheta + axis[c] * cosTheta;
+            position[c] = emitter.position[c] + offset[c];
+            velocity[c] = direction * speed;
+        }
+        lifetime = emitter.lifetimeMin + (emitter.lifetimeMax - emitter.lifetimeMin) * random(state);
+    }
+
+    void multiply(const float a[16], const float b[16], float result[16]) {
+        for (int column = 0; column < 4; ++column) {
+            for (int row = 0; row < 4; ++row) {
+                float sum = 0.0f;
+                for (int k = 0; k < 4; ++k) sum += a[k * 4 + row] * b[column * 4 + k];
+                result[column * 4 + row] = sum;
+            }
+        }
+    }
+
+    GLuint createBuffer(GLsizeiptr size, const void *data) {
+        GLuint buffer;
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, size, data, GL_DYNAMIC_COPY);
+        return buffer;
+    }
+}
+
+ParticleSystem::~ParticleSystem() {
+    destroy();
+}
+
+bool ParticleSystem::create(unsigned int capacity) {
+    destroy();
+    maxParticles = std::max(capacity, 4u);
+    glGenVertexArrays(1, &vertexArray);
+
+    if (GLExtensions::computeShaders() && GLExtensions::drawIndirect()) {
+        simulateProgram = LoadComputeShader("src/shaders/ParticleSimulate.comp");
+        emitProgram = LoadComputeShader("src/shaders/ParticleEmit.comp");
+        sortProgram = LoadComputeShader("src/shaders/ParticleSort.comp");
+        gpuDrawProgram = LoadShaders("src/shaders/ParticleBillboardStorage.vert", "src/shaders/Particle.frag");
+        if (!simulateProgram || !emitProgram || !sortProgram || !gpuDrawProgram || !createGpuBuffers()) {
+            printf("Particles fall back to the CPU\n");
+            GLuint *programs[4] = {&simulateProgram, &emitProgram, &sortProgram, &gpuDrawProgram};
+            for (GLuint *program : programs) {
+                if (*program) glDeleteProgram(*program);
+                *program = 0;
+            }
+        }
+    }
+
+    if (!gpuPath()) {
+        cpuDrawProgram = LoadShaders("src/shaders/ParticleBillboard.vert", "src/shaders/Particle.frag");
+        if (!cpuDrawProgram) return false;
+        stride = (size_t(maxParticles) + 3) & ~size_t(3);
+        blockBytes = ArrayCount * stride * sizeof(float) + stride;
+        arrays = static_cast<float *>(Memory::allocate(blockBytes, MemoryTag::Particles, 16));
+        particleEmitters = reinterpret_cast<uint8_t *>(arrays + ArrayCount * stride);
+        batchSurvivors.resize((maxParticles + SIMULATE_BATCH - 1) / SIMULATE_BATCH);
+        for (int i = 0; i < 2; ++i) {
+            sortKeys[i].resize(maxParticles);
+            sortIndices[i].resize(maxParticles);
+        }
+        if (!instances.create(size_t(maxParticles) * sizeof(BillboardInstance))) return false;
+
+        glBindVertexArray(vertexArray);
+        glEnableVertexAttribArray(0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribDivisor(0, 1);
+        glVertexAttribDivisor(1, 1);
+        glBindVertexArray(0);
+    }
+    printf("Particles: %u on the %s\n", maxParticles, gpuPath() ? "GPU" : "CPU");
+    return true;
+}
+
+bool ParticleSystem::createGpuBuffers() {
+    while (glGetError() != GL_NO_ERROR) {}
+    auto size = GLsizeiptr(maxParticles);
+    positionBuffer = createBuffer(size * GLsizeiptr(4 * sizeof(float)), nullptr);
+    velocityBuffer = createBuffer(size * GLsizeiptr(4 * sizeof(float)), nullptr);
+    emitterBuffer = createBuffer(size * GLsizeiptr(sizeof(GLuint)), nullptr);
+    liveBuffers[0] = createBuffer(size * GLsizeiptr(sizeof(GLuint)), nullptr);
+    liveBuffers[1] = createBuffer(size * GLsizeiptr(sizeof(GLuint)), nullptr);
+
+    // every slot starts on the free list
+    std::vector<GLuint> slots(maxParticles);
+    for (unsigned int i = 0; i < maxParticles; ++i) slots[i] = i;
+    freeBuffer = createBuffer(size * GLsizeiptr(sizeof(GLuint)), slots.data());
+    const Counters counters{4, 0, 0, 0, GLint(maxParticles), {0, 0}, 0};
+    counterBuffer = createBuffer(sizeof(Counters), &counters);
+
+    // the bitonic sort works on a power of two of whole blocks, the slots past the live particles sort last
+    sortSize = SORT_BLOCK;
+    while (sortSize < maxParticles) sortSize *= 2;
+    sortBuffer = createBuffer(GLsizeiptr(sortSize) * GLsizeiptr(2 * sizeof(GLuint)), nullptr);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    glGenBuffers(1, &readbackBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, readbackBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, READBACK_SLOTS * sizeof(GLuint), nullptr, GL_STREAM_READ);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    return glGetError() == GL_NO_ERROR;
+}
+
+int ParticleSystem::addEmitter(const ParticleEmitter &emitter) {
+    if (emitters.size() >= MAX_EMITTERS) return -1;
+    emitters.push_back(emitter);
+    emitterCarry.push_back(0.0f);
+    return int(emitters.size() - 1);
+}
+
+void ParticleSystem::setGravity(float x, float y, float z) {
+    gravity[0] = x;
+    gravity[1] = y;
+    gravity[2] = z;
+}
+
+bool ParticleSystem::sorted() const {
+    return std::any_of(emitters.begin(), emitters.end(), [](const ParticleEmitter &e) { return !e.additive; });
+}
+
+unsigned int ParticleSystem::spawnCount(size_t emitter, float seconds) {
+    // fractions of a particle carry over, so low rates at high frame rates still emit
+    float wanted = std::max(emitters[emitter].rate * seconds, 0.0f) + emitterCarry[emitter];
+    auto count = unsigned(std::min(wanted, float(maxParticles)));
+    emitterCarry[emitter] = wanted - float(count);
+    return count;
+}
+
+void ParticleSystem::update(float seconds) {
+    if (seconds <= 0.0f || maxParticles == 0) return;
+    ++frame;
+    if (gpuPath()) updateGpu(seconds);
+    else if (arrays) updateCpu(seconds);
+}
+
+void ParticleSystem::updateGpu(float seconds) {
+    const unsigned int source = live, target = 1 - live;
+    const GLuint zero = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, counterBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, GLintptr(offsetof(Counters, liveCount) + target * sizeof(GLuint)),
+                    sizeof(GLuint), &zero);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, positionBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, velocityBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, emitterBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, liveBuffers[source]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, liveBuffers[target]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, freeBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, counterBuffer);
+
+    // the live count stays on the GPU, every slot is dispatched and the ones past it return right away
+    glUseProgram(simulateProgram);
+    glUniform1ui(glGetUniformLocation(simulateProgram, "sourceList"), source);
+    glUniform1f(glGetUniformLocation(simulateProgram, "timeStep"), seconds);
+    glUniform3fv(glGetUniformLocation(simulateProgram, "gravity"), 1, gravity);
+    glUniform1f(glGetUniformLocation(simulateProgram, "damping"), std::exp(-dragPerSecond * seconds));
+    GLExtensions::dispatchCompute((maxParticles + SIMULATE_LOCAL_SIZE - 1) / SIMULATE_LOCAL_SIZE, 1, 1);
+    GLExtensions::memoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    GLuint spawnEnd[MAX_EMITTERS] = {};
+    float positions[MAX_EMITTERS * 4], directions[MAX_EMITTERS * 4], ranges[MAX_EMITTERS * 4];
+    unsigned int total = 0;
+    for (size_t i = 0; i < emitters.size(); ++i) {
+        const ParticleEmitter &e = emitters[i];
+        total = std::min(total + spawnCount(i, seconds), maxParticles);
+        spawnEnd[i] = total;
+        const float values[3][4] = {{e.position[0], e.position[1], e.position[2], e.radius},
+                                    {e.direction[0], e.direction[1], e.direction[2], std::cos(e.spread)},
+                                    {e.speedMin, e.speedMax, e.lifetimeMin, e.lifetimeMax}};
+        memcpy(positions + i * 4, values[0], sizeof(values[0]));
+        memcpy(directions + i * 4, values[1], sizeof(values[1]));
+        memcpy(ranges + i * 4, values[2], sizeof(values[2]));
+    }
+    if (total > 0) {
+        glUseProgram(emitProgram);
+        auto count = GLsizei(emitters.size());
+        glUniform1ui(glGetUniformLocation(emitProgram, "targetList"), target);
+        glUniform1ui(glGetUniformLocation(emitProgram, "emitterCount"), GLuint(count));
+        glUniform1ui(glGetUniformLocation(emitProgram, "seed"), frame * 0x9e3779b9u);
+        glUniform1uiv(glGetUniformLocation(emitProgram, "spawnEnd"), count, spawnEnd);
+        glUniform4fv(glGetUniformLocation(emitProgram, "emitterPositions"), count, positions);
+        glUniform4fv(glGetUniformLocation(emitProgram, "emitterDirections"), count, directions);
+        glUniform4fv(glGetUniformLocation(emitProgram, "emitterRanges"), count, ranges);
+        GLExtensions::dispatchCompute((total + EMIT_LOCAL_SIZE - 1) / EMIT_LOCAL_SIZE, 1, 1);
+    }
+    GLExtensions::memoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    // the new live count becomes the instance count of the indirect draw
+    glBindBuffer(GL_COPY_READ_BUFFER, counterBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, counterBuffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                        GLintptr(offsetof(Counters, liveCount) + target * sizeof(GLuint)),
+                        GLintptr(offsetof(Counters, instanceCount)), sizeof(GLuint));
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    live = target;
+    readBackLiveCount();
+}
+
+void ParticleSystem::readBackLiveCount() {
+    // collect the copies that landed, oldest first, so the newest one is reported
+    for (unsigned int age = READBACK_SLOTS; age > 0; --age) {
+        const unsigned int slot = (frame + READBACK_SLOTS - age) % READBACK_SLOTS;
+        GLsync &fence = readbackFences[slot];
+        if (!fence) continue;
+        GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if (result == GL_TIMEOUT_EXPIRED) continue;
+        if (result != GL_WAIT_FAILED) {
+            glBindBuffer(GL_COPY_READ_BUFFER, readbackBuffer);
+            glGetBufferSubData(GL_COPY_READ_BUFFER, GLintptr(slot * sizeof(GLuint)), sizeof(GLuint), &readbackLive);
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        }
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    // a slot whose copy is still in flight is skipped this update instead of waiting for it
+    const unsigned int slot = frame % READBACK_SLOTS;
+    if (readbackFences[slot]) return;
+    glBindBuffer(GL_COPY_READ_BUFFER, counterBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, readbackBuffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, GLintptr(offsetof(Counters, instanceCount)),
+                        GLintptr(slot * sizeof(GLuint)), sizeof(GLuint));
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    readbackFences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void ParticleSystem::updateCpu(float seconds) {
+    // every batch integrates its particles and closes its own gaps
+    const unsigned int batches = (liveParticles + SIMULATE_BATCH - 1) / SIMULATE_BATCH;
+    const float damping = std::exp(-dragPerSecond * seconds);
+    JobSystem::parallelFor(batches, 1, [&](unsigned int begin, unsigned int end) {
+        float *p[ArrayCount];
+        for (size_t a = 0; a < ArrayCount; ++a) p[a] = arrays + a * stride;
+        for (unsigned int batch = begin; batch < end; ++batch) {
+            const size_t first = size_t(batch) * SIMULATE_BATCH;
+            const size_t last = std::min(first + SIMULATE_BATCH, size_t(liveParticles));
+            size_t kept = first;
+            // the lanes past the live particles are in the padding of the arrays and count as dead
+            for (size_t i = first; i < last; i += 4) {
+                int alive;
+#ifdef PARTICLES_SSE2
+                const __m128 dt = _mm_set1_ps(seconds), decay = _mm_set1_ps(damping);
+                __m128 age = _mm_add_ps(_mm_load_ps(p[Age] + i), dt);
+                _mm_store_ps(p[Age] + i, age);
+                alive = _mm_movemask_ps(_mm_cmplt_ps(age, _mm_load_ps(p[Lifetime] + i)));
+                for (size_t axis = 0; axis < 3; ++axis) {
+                    __m128 velocity = _mm_load_ps(p[VelocityX + axis] + i);
+                    velocity = _mm_mul_ps(_mm_add_ps(velocity, _mm_set1_ps(gravity[axis] * seconds)), decay);
+                    _mm_store_ps(p[VelocityX + axis] + i, velocity);
+                    _mm_store_ps(p[PositionX + axis] + i,
+                                 _mm_add_ps(_mm_load_ps(p[PositionX + axis] + i), _mm_mul_ps(velocity, dt)));
+                }
+#else
+                alive = 0;
+                for (size_t lane = 0; lane < 4; ++lane) {
+                    p[Age][i + lane] += seconds;
+                    alive |= int(p[Age][i + lane] < p[Lifetime][i + lane]) << lane;
+                    for (size_t axis = 0; axis < 3; ++axis) {
+                        float &velocity = p[VelocityX + axis][i + lane];
+                        velocity = (velocity + gravity[axis] * seconds) * damping;
+                        p[PositionX + axis][i + lane] += velocity * seconds;
+                    }
+                }
+#endif
+                if (last - i < 4) alive &= (1 << (last - i)) - 1;
+                // nothing moves until the first particle died
+                if (alive == 0xf && kept == i) {
+                    kept += 4;
+                    continue;
+                }
+                for (size_t lane = 0; lane < 4; ++lane) {
+                    if (!(alive & (1 << lane))) continue;
+                    for (size_t a = 0; a < ArrayCount; ++a) p[a][kept] = p[a][i + lane];
+                    particleEmitters[kept++] = particleEmitters[i + lane];
+                }
+            }
+            batchSurvivors[batch] = unsigned(kept - first);
+        }
+    });
+
+    // the batches are moved together
+    size_t count = batches > 0 ? batchSurvivors[0] : 0;
+    for (unsigned int batch = 1; batch < batches; ++batch) {
+        size_t first = size_t(batch) * SIMULATE_BATCH, survivors = batchSurvivors[batch];
+        if (survivors == 0) continue;
+        for (size_t a = 0; a < ArrayCount; ++a)
+            memmove(arrays + a * stride + count, arrays + a * stride + first, survivors * sizeof(float));
+        memmove(particleEmitters + count, particleEmitters + first, survivors);
+        count += survivors;
+    }
+    liveParticles = unsigned(count);
+    emitCpu(seconds);
+}
+
+void ParticleSystem::emitCpu(float seconds) {
+    for (size_t e = 0; e < emitters.size(); ++e) {
+        unsigned int count = std::min(spawnCount(e, seconds), maxParticles - liveParticles);
+        for (unsigned int n = 0; n < count; ++n) {
+            const size_t i = liveParticles++;
+            float position[3], velocity[3], lifetime;
+            spawnParticle(emitters[e], randomState, position, velocity, lifetime);
+            for (size_t axis = 0; axis < 3; ++axis) {
+                arrays[(PositionX + axis) * stride + i] = position[axis];
+                arrays[(VelocityX + axis) * stride + i] = velocity[axis];
+            }
+            arrays[Age * stride + i] = 0.0f;
+            arrays[Lifetime * stride + i] = lifetime;
+            particleEmitters[i] = uint8_t(e);
+        }
+    }
+}
+
+void ParticleSystem::setEmitterUniforms(GLuint program) const {
+    float startColors[MAX_EMITTERS * 4], endColors[MAX_EMITTERS * 4], sizes[MAX_EMITTERS * 4];
+    for (size_t i = 0; i < emitters.size(); ++i) {
+        const ParticleEmitter &e = emitters[i];
+        memcpy(startColors + i * 4, e.colorStart, sizeof(e.colorStart));
+        memcpy(endColors + i * 4, e.colorEnd, sizeof(e.colorEnd));
+        const float size[4] = {e.sizeStart, e.sizeEnd, e.additive ? 1.0f : 0.0f, 0.0f};
+        memcpy(sizes + i * 4, size, sizeof(size));
+    }
+    auto count = GLsizei(emitters.size());
+    glUniform4fv(glGetUniformLocation(program, "emitterStartColors"), count, startColors);
+    glUniform4fv(glGetUniformLocation(program, "emitterEndColors"), count, endColors);
+    glUniform4fv(glGetUniformLocation(program, "emitterSizes"), count, sizes);
+}
+
+void ParticleSystem::draw(const float view[16], const float projection[16]) {
+    if (emitters.empty() || (!gpuPath() && !arrays)) return;
+    float viewProjection[16];
+    multiply(projection, view, viewProjection);
+    GLuint program = gpuPath() ? gpuDrawProgram : cpuDrawProgram;
+    glUseProgram(program);
+    glUniformMatrix4fv(glGetUniformLocation(program, "viewProjection"), 1, GL_FALSE, viewProjection);
+    // the rows of the view rotation are the camera axes in world space
+    glUniform3f(glGetUniformLocation(program, "cameraRight"), view[0], view[4], view[8]);
+    glUniform3f(glGetUniformLocation(program, "cameraUp"), view[1], view[5], view[9]);
+    setEmitterUniforms(program);
+
+    GLboolean blending = glIsEnabled(GL_BLEND), depthWrites = GL_TRUE;
+    glGetBooleanv(GL_DEPTH_WRITEMASK, &depthWrites);
+    GLint sourceFactor, destinationFactor, vertexArrayBinding;
+    glGetIntegerv(GL_BLEND_SRC_RGB, &sourceFactor);
+    glGetIntegerv(GL_BLEND_DST_RGB, &destinationFactor);
+    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &vertexArrayBinding);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    glDepthMask(GL_FALSE);
+    glBindVertexArray(vertexArray);
+
+    if (gpuPath()) drawGpu(view);
+    else drawCpu(view);
+
+    glBindVertexArray(GLuint(vertexArrayBinding));
+    glDepthMask(depthWrites);
+    glBlendFunc(GLenum(sourceFactor), GLenum(destinationFactor));
+    if (!blending) glDisable(GL_BLEND);
+}
+
+void ParticleSystem::sortGpu(const float view[16]) {
+    glUseProgram(sortProgram);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, positionBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, liveBuffers[live]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, counterBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, sortBuffer);
+    glUniform4f(glGetUniformLocation(sortProgram, "depthRow"), view[2], view[6], view[10], view[14]);
+    GLint passLocation = glGetUniformLocation(sortProgram, "sortPass");
+    GLint mergeLocation = glGetUniformLocation(sortProgram, "mergeSize");
+    GLint spanLocation = glGetUniformLocation(sortProgram, "spanSize");
+
+    // blocks of SORT_BLOCK keys are sorted in shared memory, then merged: the steps wider than a block compare in
+    // the buffer, the rest of each merge runs in shared memory again
+    glUniform1ui(passLocation, 0);
+    GLExtensions::dispatchCompute(sortSize / SORT_BLOCK, 1, 1);
+    GLExtensions::memoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    for (GLuint merge = SORT_BLOCK * 2; merge <= sortSize; merge *= 2) {
+        glUniform1ui(mergeLocation, merge);
+        glUniform1ui(passLocation, 1);
+        for (GLuint span = merge / 2; span >= SORT_BLOCK; span /= 2) {
+            glUniform1ui(spanLocation, span);
+            GLExtensions::dispatchCompute(sortSize / SORT_BLOCK, 1, 1);
+            GLExtensions::memoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        }
+        glUniform1ui(passLocation, 2);
+        GLExtensions::dispatchCompute(sortSize / SORT_BLOCK, 1, 1);
+        GLExtensions::memoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+}
+
+void ParticleSystem::drawGpu(const float view[16]) {
+    bool sort = sorted();
+    if (sort) {
+        sortGpu(view);
+        glUseProgram(gpuDrawProgram);
+    }
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, positionBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, velocityBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, emitterBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, sort ? sortBuffer : liveBuffers[live]);
+    glUniform1ui(glGetUniformLocation(gpuDrawProgram, "drawStride"), sort ? 2 : 1);
+    GLExtensions::memoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, counterBuffer);
+    GLExtensions::drawArraysIndirect(GL_TRIANGLE_STRIP, nullptr);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void ParticleSystem::drawCpu(const float view[16]) {
+    if (liveParticles == 0) return;
+    const unsigned int count = liveParticles;
+    const float *p = arrays;
+
+    // back to front: 16 bit keys of the distance along the view direction, radix sorted a byte at a time
+    const uint32_t *order = nullptr;
+    if (sorted()) {
+        float farthest = 1e-6f;
+        for (unsigned int i = 0; i < count; ++i) {
+            float depth = -(view[2] * p[PositionX * stride + i] + view[6] * p[PositionY * stride + i] +
+                            view[10] * p[PositionZ * stride + i] + view[14]);
+            farthest = std::max(farthest, depth);
+        }
+        const float scale = 65535.0f / farthest;
+        for (unsigned int i = 0; i < count; ++i) {
+            float depth = -(view[2] * p[PositionX * stride + i] + view[6] * p[PositionY * stride + i] +
+                            view[10] * p[PositionZ * stride + i] + view[14]);
+            sortKeys[0][i] = uint16_t(65535.0f - std::clamp(depth * scale, 0.0f, 65535.0f));
+            sortIndices[0][i] = i;
+        }
+        for (unsigned int pass = 0; pass < 2; ++pass) {
+            const uint16_t *keys = sortKeys[pass].data();
+            const uint32_t *indices = sortIndices[pass].data();
+            unsigned int offsets[256] = {};
+            for (unsigned int i = 0; i < count; ++i) ++offsets[(keys[i] >> (pass * 8)) & 0xff];
+            for (unsigned int digit = 0, sum = 0; digit < 256; ++digit) {
+                unsigned int digitCount = offsets[digit];
+                offsets[digit] = sum;
+                sum += digitCount;
+            }
+            for (unsigned int i = 0; i < count; ++i) {
+                unsigned int slot = offsets[(keys[i] >> (pass * 8)) & 0xff]++;
+                sortKeys[1 - pass][slot] = keys[i];
+                sortIndices[1 - pass][slot] = indices[i];
+            }
+        }
+        order = sortIndices[0].data();
+    }
+
+    // the instance attributes go straight into the stream buffer, a batch per job
+    instances.beginFrame();
+    StreamBuffer::Allocation allocation = instances.allocate(size_t(count) * sizeof(BillboardInstance));
+    if (allocation.data) {
+        auto *instanceData = static_cast<BillboardInstance *>(allocation.data);
+        const unsigned int batches = (count + INSTANCE_BATCH - 1) / INSTANCE_BATCH;
+        JobSystem::parallelFor(batches, 1, [&](unsigned int begin, unsigned int end) {
+            const size_t last = std::min(size_t(end) * INSTANCE_BATCH, size_t(count));
+            for (size_t i = size_t(begin) * INSTANCE_BATCH; i < last; ++i) {
+                size_t particle = order ? order[i] : i;
+                BillboardInstance instance{};
+                for (size_t axis = 0; axis < 3; ++axis)
+                    instance.position[axis] = p[(PositionX + axis) * stride + particle];
+                instance.life = p[Age * stride + particle] / p[Lifetime * stride + particle];
+                instance.emitter = particleEmitters[particle];
+                instanceData[i] = instance;
+            }
+        });
+        instances.flush();
+
+        glBindBuffer(GL_ARRAY_BUFFER, instances.buffer());
+        glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(BillboardInstance),
+                              reinterpret_cast<void *>(allocation.offset + offsetof(BillboardInstance, position)));
+        glVertexAttribIPointer(1, 1, GL_UNSIGNED_BYTE, sizeof(BillboardInstance),
+                               reinterpret_cast<void *>(allocation.offset + offsetof(BillboardInstance, emitter)));
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, GLsizei(count));
+    }
+    instances.endFrame();
+}
+
+void ParticleSystem::destroy() {
+    GLuint *programs[5] = {&simulateProgram, &emitProgram, &sortProgram, &gpuDrawProgram, &cpuDrawProgram};
+    for (GLuint *program : programs) {
+        if (*program) glDeleteProgram(*program);
+        *program = 0;
+    }
+    for (GLsync &fence : readbackFences) {
+        if (fence) glDeleteSync(fence);
+        fence = nullptr;
+    }
+    GLuint *buffers[9] = {&positionBuffer, &velocityBuffer, &emitterBuffer, &liveBuffers[0], &liveBuffers[1],
+                          &freeBuffer, &counterBuffer, &sortBuffer, &readbackBuffer};
+    for (GLuint *buffer : buffers) {
+        if (*buffer) glDeleteBuffers(1, buffer);
+        *buffer = 0;
+    }
+    if (vertexArray) glDeleteVertexArrays(1, &vertexArray);
+    vertexArray = 0;
+    instances.destroy();
+    if (arrays) Memory::free(arrays, blockBytes, MemoryTag::Particles, 16);
+    arrays = nullptr;
+    particleEmitters = nullptr;
+    liveParticles = 0;
+    live = 0;
+    readbackLive = 0;
+    maxParticles = 0;
+}
@@ -0,0 +1,141 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#ifndef PARTICLESYSTEM_H
+#define PARTICLESYSTEM_H
+#include <glad/gl.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "StreamBuffer.hpp"
+
+
+/** Source of particles: where they spawn, how they move off and how they look over their life */
+struct ParticleEmitter {
+    float position[3] = {0, 0, 0};
+    float radius = 0.0f;                // particles spawn inside a sphere around position
+    float direction[3] = {0, 1, 0};     // unit axis of the emission cone
+    float spread = 0.3f;                // half angle of the cone, radians
+    float speedMin = 1.0f, speedMax = 2.0f;
+    float lifetimeMin = 1.0f, lifetimeMax = 2.0f;
+    float rate = 1000.0f;               // particles per second
+    float sizeStart = 0.05f, sizeEnd = 0.02f;
+    float colorStart[4] = {1, 1, 1, 1}; // linear (HDR) color and opacity, interpolated over the life
+    float colorEnd[4] = {1, 1, 1, 0};
+    /** true: added to the scene, order independent; false: alpha blended, drawn back to front */
+    bool additive = true;
+};
+
+/** Emitters and the particles they spawned, simulated and drawn as camera facing billboards
+ *
+ *  GPU path (GL 4.3 compute and draw indirect): the particles live in shader storage buffers as structure of arrays
+ *  (position and age, velocity and lifetime, emitter). ParticleSimulate.comp integrates the live list and appends the
+ *  survivors to the other live list, the dead go onto a free list that ParticleEmit.comp takes new particles from.
+ *  The live count becomes the instance count of the indirect draw on the GPU, liveCount() gets fenced copies of it.
+ *
+ *  CPU path (3.3 contexts): the same arrays in memory, integrated 4 particles per SSE register on the job threads.
+ *  Every batch closes its own gaps, then the batches are moved together. The random numbers of the emission come
+ *  from a PCG generator, the billboards are written into a StreamBuffer as instance attributes.
+ *
+ *  Both paths draw premultiplied: additive particles write zero alpha, so one back to front sorted draw covers both
+ *  kinds. The sort only runs if an emitter is alpha blended: a bitonic sort (ParticleSort.comp) or a radix sort of 16
+ *  bit depth keys on the CPU. Particles are depth tested against the scene but do not write depth.
+ *
+ *  Per frame: update() with the time step, draw() inside the pass of the scene color and depth.
+ */
+class ParticleSystem {
+public:
+    static constexpr unsigned int MAX_EMITTERS = 16;
+
+    ParticleSystem() = default;
+    ParticleSystem(const ParticleSystem &) = delete;
+    ParticleSystem &operator=(const ParticleSystem &) = delete;
+    ~ParticleSystem();
+
+    /** Allocates room for capacity particles, the GPU path is used if the context supports it and the shaders compile
+     *
+     *  @returns false if the drawing programs do not link
+     */
+    bool create(unsigned int capacity);
+
+    /** @returns true if the particles are simulated and sorted in compute shaders */
+    bool gpuPath() const { return simulateProgram != 0; }
+    unsigned int capacity() const { return maxParticles; }
+
+    /** @returns Index of the emitter, -1 if there are MAX_EMITTERS already */
+    int addEmitter(const ParticleEmitter &emitter);
+    /** @returns The emitter, changes apply from the next update() */
+    ParticleEmitter &emitter(int index) { return emitters[size_t(index)]; }
+
+    /** Acceleration of all particles */
+    void setGravity(float x, float y, float z);
+    /** Air resistance of all particles, velocities decay by exp(-drag * seconds) */
+    void setDrag(float drag) { dragPerSecond = drag; }
+
+    /** Ages, moves and retires the particles and spawns the new ones of the time step */
+    void update(float seconds);
+
+    /** Sorts (if an emitter is alpha blended) and draws the particles into the bound framebuffer
+     *
+     *  @param[in] view Column major view matrix, its rows give the billboard axes and the sort depth
+     *  @param[in] projection Column major projection matrix
+     */
+    void draw(const float view[16], const float projection[16]);
+
+    /** @returns Live particles. The GPU path copies its counter into a ring of READBACK_SLOTS fenced buffers every
+     *           update() and reports the newest copy that has landed, usually one or two updates old, without stalling
+     */
+    unsigned int liveCount() const { return gpuPath() ? readbackLive : liveParticles; }
+
+    /** Updates the GPU counter copies may be in flight before one is skipped */
+    static constexpr unsigned int READBACK_SLOTS = 3;
+
+    void destroy();
+
+private:
+    bool createGpuBuffers();
+    bool sorted() const;
+    unsigned int spawnCount(size_t emitter, float seconds);
+    void setEmitterUniforms(GLuint program) const;
+    void updateGpu(float seconds);
+    void readBackLiveCount();
+    void updateCpu(float seconds);
+    void emitCpu(float seconds);
+    void sortGpu(const float view[16]);
+    void drawGpu(const float view[16]);
+    void drawCpu(const float view[16]);
+
+    std::vector<ParticleEmitter> emitters;
+    std::vector<float> emitterCarry;    // fraction of a particle each emitter still owes
+    float gravity[3] = {0, -9.81f, 0};
+    float dragPerSecond = 0.0f;
+    unsigned int maxParticles = 0;
+    uint64_t randomState = 0x853c49e6748fea9bull;
+    uint32_t frame = 0;
+
+    // GPU path: the live lists swap every update, live is the one of the last update
+    GLuint simulateProgram = 0, emitProgram = 0, sortProgram = 0, gpuDrawProgram = 0;
+    GLuint positionBuffer = 0, velocityBuffer = 0, emitterBuffer = 0, liveBuffers[2] = {}, freeBuffer = 0;
+    GLuint counterBuffer = 0, sortBuffer = 0;
+    unsigned int live = 0, sortSize = 0;
+    GLuint readbackBuffer = 0;                  // READBACK_SLOTS copies of the live count
+    GLsync readbackFences[READBACK_SLOTS] = {};
+    unsigned int readbackLive = 0;
+
+    // CPU path: structure of arrays in one block, the first liveParticles of every array are live
+    float *arrays = nullptr;
+    uint8_t *particleEmitters = nullptr;
+    size_t stride = 0, blockBytes = 0;
+    unsigned int liveParticles = 0;
+    std::vector<unsigned int> batchSurvivors;
+    std::vector<uint16_t> sortKeys[2];
+    std::vector<uint32_t> sortIndices[2];
+    StreamBuffer instances;
+    GLuint cpuDrawProgram = 0, vertexArray = 0;
+};
+
+
+
+#endif //PARTICLESYSTEM_H
@@ -0,0 +1,364 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#include "PostProcess.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "Assets.hpp"
+#include "GLExtensions.hpp"
+#include "shader.hpp"
+
+namespace {
+    constexpr GLenum BLOOM_FORMAT = GL_R11F_G11F_B10F;
+    // scene luma where the bloom starts, lit surfaces stay below it and only highlights and lamps glow
+    constexpr float BLOOM_THRESHOLD = 1.0f;
+    constexpr unsigned int BLUR_GROUP_SIZE = 128;
+    constexpr int DEFAULT_LUT_SIZE = 32;
+    constexpr GLint SOURCE_TEXTURE_UNIT = 0, BLOOM_TEXTURE_UNIT = 1, LUT_TEXTURE_UNIT = 2;
+
+    unsigned int half(unsigned int size) {
+        return std::max(1u, (size + 1) / 2);
+    }
+
+    /** Uploads a size^3 table of RGB values, red varies fastest */
+    GLuint createLut(const float *rgb, int size) {
+        GLuint texture = 0;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_3D, texture);
+        glTexImage3D(GL_TEXTURE_3D, 0, GL_RGB16F, size, size, size, 0, GL_RGB, GL_FLOAT, rgb);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAX_LEVEL, 0);
+        glBindTexture(GL_TEXTURE_3D, 0);
+        return texture;
+    }
+
+    /** Default grade: a little contrast around mid gray, saturation and warmth */
+    GLuint createDefaultLut() {
+        std::vector<float> table(size_t(DEFAULT_LUT_SIZE) * DEFAULT_LUT_SIZE * DEFAULT_LUT_SIZE * 3);
+        float *out = table.data();
+        for (int b = 0; b < DEFAULT_LUT_SIZE; ++b) {
+            for (int g = 0; g < DEFAULT_LUT_SIZE; ++g) {
+                for (int r = 0; r < DEFAULT_LUT_SIZE; ++r) {
+                    float color[3] = {float(r) / float(DEFAULT_LUT_SIZE - 1), float(g) / float(DEFAULT_LUT_SIZE - 1),
+                                      float(b) / float(DEFAULT_LUT_SIZE - 1)};
+                    float luma = 0.2126f * color[0] + 0.7152f * color[1] + 0.0722f * color[2];
+                    const float warmth[3] = {1.03f, 1.0f, 0.96f};
+                    for (int c = 0; c < 3; ++c) {
+                        float value = luma + (color[c] - luma) * 1.1f;
+                        // smoothstep blended in by a quarter keeps black and white where they are
+                        value = std::clamp(value, 0.0f, 1.0f);
+                        value += (value * value * (3.0f - 2.0f * value) - value) * 0.25f;
+                        *out++ = std::clamp(value * warmth[c], 0.0f, 1.0f);
+                    }
+                }
+            }
+        }
+        return createLut(table.data(), DEFAULT_LUT_SIZE);
+    }
+}
+
+PostProcess::~PostProcess() {
+    destroy();
+}
+
+const char *PostProcess::effectName(PostEffect effect) {
+    switch (effect) {
+        case PostEffect::Bloom: return "bloom";
+        case PostEffect::Tonemapping: return "tonemapping";
+        case PostEffect::ColorGrading: return "color grading";
+        case PostEffect::Fxaa: return "FXAA";
+        default: return "?";
+    }
+}
+
+bool PostProcess::create() {
+    destroy();
+    downsampleProgram = LoadShaders("src/shaders/Fullscreen.vert", "src/shaders/PostBloomDownsample.frag");
+    upsampleProgram = LoadShaders("src/shaders/Fullscreen.vert", "src/shaders/PostBloomUpsample.frag");
+    compositeProgram = LoadShaders("src/shaders/Fullscreen.vert", "src/shaders/PostComposite.frag");
+    fxaaProgram = LoadShaders("src/shaders/Fullscreen.vert", "src/shaders/PostFxaa.frag");
+    // image stores into the pool's textures need glBindImageTexture next to the compute shaders
+    if (GLExtensions::computeShaders() && GLExtensions::imageLoadStore())
+        blurCompute = LoadComputeShader("src/shaders/PostBlur.comp");
+    if (!blurCompute) blurProgram = LoadShaders("src/shaders/Fullscreen.vert", "src/shaders/PostBlur.frag");
+    if (!downsampleProgram || !upsampleProgram || !compositeProgram || !fxaaProgram || (!blurCompute && !blurProgram)) {
+        printf("Post-processing programs could not be loaded\n");
+        destroy();
+        return false;
+    }
+
+    glUseProgram(compositeProgram);
+    glUniform1i(glGetUniformLocation(compositeProgram, "scene"), SOURCE_TEXTURE_UNIT);
+    glUniform1i(glGetUniformLocation(compositeProgram, "bloom"), BLOOM_TEXTURE_UNIT);
+    glUniform1i(glGetUniformLocation(compositeProgram, "gradingLut"), LUT_TEXTURE_UNIT);
+    glUseProgram(0);
+
+    gradingLut = createDefaultLut();
+    // core profiles need a bound vertex array even for draws without attributes
+    glGenVertexArrays(1, &emptyVertexArray);
+    printf("Post-processing: bloom blur in %s shaders\n", blurCompute ? "compute" : "fragment");
+    return true;
+}
+
+bool PostProcess::loadGradingLut(const char *path) {
+    AssetData file;
+    if (!Assets::open(path, file)) {printf("Grading table %s could not be opened\n", path); return false;}
+    std::string text(reinterpret_cast<const char *>(file.data()), file.size());
+
+    int size = 0;
+    std::vector<float> table;
+    size_t position = 0;
+    while (position < text.size()) {
+        size_t end = text.find('\n', position);
+        if (end == std::string::npos) end = text.size();
+        std::string line = text.substr(position, end - position);
+        position = end + 1;
+        if (line.empty() || line[0] == '#' || line[0] == '\r') continue;
+        if (line.compare(0, 11, "LUT_3D_SIZE") == 0) {
+            size = atoi(line.c_str() + 11);
+            if (size < 2 || size > 256) break;
+            table.reserve(size_t(size) * size * size * 3);
+            continue;
+        }
+        // TITLE, DOMAIN_MIN, DOMAIN_MAX and LUT_1D_SIZE are not used
+        if (!(line[0] == '-' || line[0] == '.' || (line[0] >= '0' && line[0] <= '9'))) continue;
+        const char *cursor = line.c_str();
+        for (int c = 0; c < 3; ++c) {
+            char *next = nullptr;
+            table.push_back(strtof(cursor, &next));
+            cursor = next;
+        }
+    }
+    if (size < 2 || size > 256 || table.size() != size_t(size) * size * size * 3) {
+        printf("Grading table %s is not a 3D .cube table\n", path);
+        return false;
+    }
+
+    if (gradingLut) glDeleteTextures(1, &gradingLut);
+    gradingLut = createLut(table.data(), size);
+    return true;
+}
+
+void PostProcess::setRenderArea(unsigned int renderWidth, unsigned int renderHeight) {
+    areaWidth = std::max(renderWidth, 1u);
+    areaHeight = std::max(renderHeight, 1u);
+    if (fullWidth > 0) {
+        areaWidth = std::min(areaWidth, fullWidth);
+        areaHeight = std::min(areaHeight, fullHeight);
+    }
+    // the levels halve the area the way they halve the target size, so a level's area never exceeds it
+    unsigned int width = areaWidth, height = areaHeight;
+    for (unsigned int level = 0; level < BLOOM_LEVELS; ++level) {
+        width = levelWidth[level] = half(width);
+        height = levelHeight[level] = half(height);
+    }
+}
+
+void PostProcess::setTimer(GpuTimer *gpuTimer, unsigned int firstPass) {
+    timer = gpuTimer;
+    timerPass = firstPass;
+}
+
+RenderGraph::Resource PostProcess::addPasses(RenderGraph &graph, RenderGraph::Resource hdr) {
+    bool bloom = enabled(PostEffect::Bloom), tonemapping = enabled(PostEffect::Tonemapping);
+    bool grading = enabled(PostEffect::ColorGrading) && gradingLut, antialiasing = enabled(PostEffect::Fxaa);
+    if (!compositeProgram || (!bloom && !tonemapping && !grading && !antialiasing)) return hdr;
+
+    const RenderTargetDescription &scene = graph.description(hdr);
+    if (scene.width != fullWidth || scene.height != fullHeight) {
+        fullWidth = scene.width;
+        fullHeight = scene.height;
+        setRenderArea(fullWidth, fullHeight);
+    }
+
+    RenderGraph::Resource bloomLevels[BLOOM_LEVELS];
+    if (bloom) {
+        RenderTargetDescription levels[BLOOM_LEVELS];
+        unsigned int width = fullWidth, height = fullHeight;
+        for (unsigned int level = 0; level < BLOOM_LEVELS; ++level) {
+            width = half(width);
+            height = half(height);
+            levels[level] = {width, height, BLOOM_FORMAT};
+            bloomLevels[level] = graph.createTexture("bloom", levels[level]);
+        }
+
+        // down the pyramid: every level is blurred before the next one is taken from it, so the glow widens with
+        // every level at the cost of one blur per level
+        for (unsigned int level = 0; level < BLOOM_LEVELS; ++level) {
+            RenderGraph::Resource source = level == 0 ? hdr : bloomLevels[level - 1];
+            RenderGraph::Pass down = graph.addPass(level == 0 ? "bloom threshold" : "bloom down",
+                [this, &graph, source, level]() {
+                    if (level == 0) {
+                        beginTimer(0);
+                        downsample(graph.texture(source), areaWidth, areaHeight, level, true);
+                    } else {
+                        downsample(graph.texture(source), levelWidth[level - 1], levelHeight[level - 1], level, false);
+                    }
+                });
+            graph.read(down, source);
+            bloomLevels[level] = graph.attach(down, bloomLevels[level]);
+
+            RenderGraph::Resource temporary = graph.createTexture("bloom blur", levels[level]);
+            RenderGraph::Resource blurred = bloomLevels[level];
+            RenderGraph::Pass blurX = graph.addPass("bloom blur x", [this, &graph, blurred, temporary, level]() {
+                blur(graph, blurred, temporary, level, true);
+            });
+            graph.read(blurX, blurred);
+            temporary = blurCompute ? graph.write(blurX, temporary) : graph.attach(blurX, temporary);
+            RenderGraph::Pass blurY = graph.addPass("bloom blur y", [this, &graph, temporary, blurred, level]() {
+                blur(graph, temporary, blurred, level, false);
+            });
+            graph.read(blurY, temporary);
+            bloomLevels[level] = blurCompute ? graph.write(blurY, bloomLevels[level])
+                                             : graph.attach(blurY, bloomLevels[level]);
+        }
+
+        // up the pyramid: every level is added to the next larger one
+        for (unsigned int level = BLOOM_LEVELS - 1; level > 0; --level) {
+            RenderGraph::Resource source = bloomLevels[level];
+            RenderGraph::Pass up = graph.addPass("bloom up", [this, &graph, source, level]() {
+                upsample(graph.texture(source), level - 1);
+                if (level == 1) endTimer();
+            });
+            graph.read(up, source);
+            bloomLevels[level - 1] = graph.attach(up, bloomLevels[level - 1]);
+        }
+    }
+
+    RenderGraph::Resource ldr = graph.createTexture("post ldr", {fullWidth, fullHeight, GL_RGBA8});
+    RenderGraph::Resource bloomResult = bloom ? bloomLevels[0] : RenderGraph::INVALID;
+    RenderGraph::Pass tonemap = graph.addPass("tonemap", [this, &graph, hdr, bloomResult]() {
+        beginTimer(1);
+        composite(graph.texture(hdr), bloomResult != RenderGraph::INVALID ? graph.texture(bloomResult) : 0);
+        endTimer();
+    });
+    graph.read(tonemap, hdr);
+    if (bloom) graph.read(tonemap, bloomResult);
+    ldr = graph.attach(tonemap, ldr);
+    if (!antialiasing) return ldr;
+
+    RenderGraph::Resource antialiased = graph.createTexture("post fxaa", {fullWidth, fullHeight, GL_RGBA8});
+    RenderGraph::Pass fxaaPass = graph.addPass("fxaa", [this, &graph, ldr]() {
+        beginTimer(2);
+        fxaa(graph.texture(ldr));
+        endTimer();
+    });
+    graph.read(fxaaPass, ldr);
+    return graph.attach(fxaaPass, antialiased);
+}
+
+void PostProcess::downsample(GLuint source, unsigned int sourceWidth, unsigned int sourceHeight, unsigned int level,
+                             bool threshold) {
+    glUseProgram(downsampleProgram);
+    glUniform2f(glGetUniformLocation(downsampleProgram, "sourceArea"), float(sourceWidth), float(sourceHeight));
+    glUniform2f(glGetUniformLocation(downsampleProgram, "targetArea"), float(levelWidth[level]),
+                float(levelHeight[level]));
+    glUniform1f(glGetUniformLocation(downsampleProgram, "threshold"), threshold ? BLOOM_THRESHOLD : -1.0f);
+    glActiveTexture(GL_TEXTURE0 + SOURCE_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, source);
+    drawFullscreen(GLsizei(levelWidth[level]), GLsizei(levelHeight[level]));
+}
+
+void PostProcess::blur(RenderGraph &graph, RenderGraph::Resource source, RenderGraph::Resource target,
+                       unsigned int level, bool horizontal) {
+    GLint direction[2] = {horizontal ? 1 : 0, horizontal ? 0 : 1};
+    GLint area[2] = {GLint(levelWidth[level]), GLint(levelHeight[level])};
+    GLuint program = blurCompute ? blurCompute : blurProgram;
+    glUseProgram(program);
+    glUniform2iv(glGetUniformLocation(program, "direction"), 1, direction);
+    glUniform2iv(glGetUniformLocation(program, "area"), 1, area);
+    glActiveTexture(GL_TEXTURE0 + SOURCE_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, graph.texture(source));
+    if (!blurCompute) {
+        drawFullscreen(area[0], area[1]);
+        return;
+    }
+
+    // one workgroup per 128 pixels of a row (column), the rows (columns) of the area are the second dimension
+    GLuint extent = GLuint(horizontal ? area[0] : area[1]), across = GLuint(horizontal ? area[1] : area[0]);
+    GLExtensions::bindImageTexture(0, graph.texture(target), 0, GL_FALSE, 0, GL_WRITE_ONLY, BLOOM_FORMAT);
+    GLExtensions::dispatchCompute((extent + BLUR_GROUP_SIZE - 1) / BLUR_GROUP_SIZE, across, 1);
+    // the stores are read by the next blur (texelFetch) and the next down or up pass (sampled or attached)
+    GLExtensions::memoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT |
+                                GL_FRAMEBUFFER_BARRIER_BIT);
+}
+
+void PostProcess::upsample(GLuint source, unsigned int level) {
+    glUseProgram(upsampleProgram);
+    glUniform2f(glGetUniformLocation(upsampleProgram, "sourceArea"), float(levelWidth[level + 1]),
+                float(levelHeight[level + 1]));
+    glUniform2f(glGetUniformLocation(upsampleProgram, "targetArea"), float(levelWidth[level]),
+                float(levelHeight[level]));
+    glActiveTexture(GL_TEXTURE0 + SOURCE_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, source);
+    GLboolean blending = glIsEnabled(GL_BLEND);
+    GLint sourceFactor = GL_ONE, destinationFactor = GL_ZERO;
+    glGetIntegerv(GL_BLEND_SRC_RGB, &sourceFactor);
+    glGetIntegerv(GL_BLEND_DST_RGB, &destinationFactor);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+    drawFullscreen(GLsizei(levelWidth[level]), GLsizei(levelHeight[level]));
+    glBlendFunc(GLenum(sourceFactor), GLenum(destinationFactor));
+    if (!blending) glDisable(GL_BLEND);
+}
+
+void PostProcess::composite(GLuint scene, GLuint bloom) {
+    glUseProgram(compositeProgram);
+    glUniform2f(glGetUniformLocation(compositeProgram, "sceneArea"), float(areaWidth), float(areaHeight));
+    glUniform2f(glGetUniformLocation(compositeProgram, "bloomArea"), float(levelWidth[0]), float(levelHeight[0]));
+    glUniform1f(glGetUniformLocation(compositeProgram, "bloomIntensity"), bloom ? bloomIntensity : 0.0f);
+    glUniform1f(glGetUniformLocation(compositeProgram, "exposure"), exposure);
+    glUniform1i(glGetUniformLocation(compositeProgram, "tonemapping"), enabled(PostEffect::Tonemapping));
+    glUniform1i(glGetUniformLocation(compositeProgram, "grading"), enabled(PostEffect::ColorGrading) && gradingLut);
+    glActiveTexture(GL_TEXTURE0 + SOURCE_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, scene);
+    glActiveTexture(GL_TEXTURE0 + BLOOM_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, bloom);
+    glActiveTexture(GL_TEXTURE0 + LUT_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_3D, gradingLut);
+    glActiveTexture(GL_TEXTURE0);
+    drawFullscreen(GLsizei(areaWidth), GLsizei(areaHeight));
+}
+
+void PostProcess::fxaa(GLuint source) {
+    glUseProgram(fxaaProgram);
+    glUniform2f(glGetUniformLocation(fxaaProgram, "area"), float(areaWidth), float(areaHeight));
+    glActiveTexture(GL_TEXTURE0 + SOURCE_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D, source);
+    drawFullscreen(GLsizei(areaWidth), GLsizei(areaHeight));
+}
+
+void PostProcess::drawFullscreen(GLsizei width, GLsizei height) {
+    // the graph set the viewport to the whole target, only the render area is processed
+    glViewport(0, 0, width, height);
+    GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+    GLint vertexArray = 0;
+    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &vertexArray);
+    glDisable(GL_DEPTH_TEST);
+    glBindVertexArray(emptyVertexArray);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(GLuint(vertexArray));
+    if (depthTest) glEnable(GL_DEPTH_TEST);
+}
+
+void PostProcess::destroy() {
+    GLuint *programs[6] = {&downsampleProgram, &upsampleProgram, &blurProgram, &blurCompute, &compositeProgram,
+                           &fxaaProgram};
+    for (GLuint *program : programs) {
+        if (*program) glDeleteProgram(*program);
+        *program = 0;
+    }
+    if (gradingLut) glDeleteTextures(1, &gradingLut);
+    if (emptyVertexArray) glDeleteVertexArrays(1, &emptyVertexArray);
+    gradingLut = emptyVertexArray = 0;
+}
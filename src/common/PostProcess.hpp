@@ -0,0 +1,100 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#ifndef POSTPROCESS_H
+#define POSTPROCESS_H
+#include <glad/gl.h>
+#include <cstdint>
+
+#include "GpuTimer.hpp"
+#include "RenderGraph.hpp"
+
+
+enum class PostEffect : uint8_t { Bloom, Tonemapping, ColorGrading, Fxaa, Count };
+
+/** Post-processing of the HDR scene into the LDR image that is presented
+ *
+ *  The effects are passes of the frame's RenderGraph, in this order:
+ *  - bloom: the bright part of the scene is downsampled into a pyramid of BLOOM_LEVELS levels starting at half
+ *    resolution, every level is blurred with a separable gaussian and the levels are added back up the pyramid. The
+ *    blur is a compute shader (PostBlur.comp) that loads a row of pixels into shared memory once per workgroup, with
+ *    a fragment shader fallback on contexts without compute shaders
+ *  - tonemapping (ACES fit) and color grading with a 3D lookup table, both in the pass that adds the bloom
+ *  - FXAA, the cheap replacement for multisampling the offscreen targets can not use
+ *
+ *  Disabled effects are left out of the graph, rebuild it after toggling one. All passes honour the render area of
+ *  dynamic resolution: they only process and read its lower left pixels.
+ */
+class PostProcess {
+public:
+    static constexpr unsigned int BLOOM_LEVELS = 5;
+    /** GPU timer passes: bloom, tonemap (with grading) and fxaa */
+    static constexpr unsigned int TIMER_PASSES = 3;
+
+    PostProcess() = default;
+    PostProcess(const PostProcess &) = delete;
+    PostProcess &operator=(const PostProcess &) = delete;
+    ~PostProcess();
+
+    /** Loads the programs and creates the default grading table
+     *
+     *  @returns false if a program does not link
+     */
+    bool create();
+    /** Replaces the grading table with a 3D table of an Adobe .cube file
+     *
+     *  @returns false if the file can not be opened or is not a 3D table, the table of before is kept
+     */
+    bool loadGradingLut(const char *path);
+
+    void setEnabled(PostEffect effect, bool enabled) { effects[unsigned(effect)] = enabled; }
+    bool enabled(PostEffect effect) const { return effects[unsigned(effect)]; }
+    void toggle(PostEffect effect) { setEnabled(effect, !enabled(effect)); }
+    static const char *effectName(PostEffect effect);
+    /** @returns true if the bloom blur runs as compute passes */
+    bool computeBlur() const { return blurCompute != 0; }
+
+    /** Processes the lower left width x height pixels of the scene only (dynamic resolution) */
+    void setRenderArea(unsigned int width, unsigned int height);
+    /** Measures the effects as the passes firstPass to firstPass + TIMER_PASSES - 1 of the timer */
+    void setTimer(GpuTimer *gpuTimer, unsigned int firstPass);
+    void setBloomIntensity(float intensity) { bloomIntensity = intensity; }
+    void setExposure(float value) { exposure = value; }
+
+    /** Adds the passes of the enabled effects to the graph
+     *
+     *  @param[in] hdr Scene color, the render area of it is processed
+     *  @returns Handle of the processed image, hdr itself if all effects are disabled or create() failed
+     */
+    RenderGraph::Resource addPasses(RenderGraph &graph, RenderGraph::Resource hdr);
+
+    void destroy();
+
+private:
+    void downsample(GLuint source, unsigned int sourceWidth, unsigned int sourceHeight, unsigned int level,
+                    bool threshold);
+    void blur(RenderGraph &graph, RenderGraph::Resource source, RenderGraph::Resource target, unsigned int level,
+              bool horizontal);
+    void upsample(GLuint source, unsigned int level);
+    void composite(GLuint scene, GLuint bloom);
+    void fxaa(GLuint source);
+    void drawFullscreen(GLsizei width, GLsizei height);
+    void beginTimer(unsigned int pass) { if (timer) timer->begin(timerPass + pass); }
+    void endTimer() { if (timer) timer->end(); }
+
+    bool effects[unsigned(PostEffect::Count)] = {true, true, true, true};
+    GLuint downsampleProgram = 0, upsampleProgram = 0, blurProgram = 0, blurCompute = 0;
+    GLuint compositeProgram = 0, fxaaProgram = 0;
+    GLuint gradingLut = 0, emptyVertexArray = 0;
+    unsigned int areaWidth = 1, areaHeight = 1;
+    unsigned int levelWidth[BLOOM_LEVELS] = {}, levelHeight[BLOOM_LEVELS] = {};
+    unsigned int fullWidth = 0, fullHeight = 0;
+    float bloomIntensity = 0.6f, exposure = 1.0f;
+    GpuTimer *timer = nullptr;
+    unsigned int timerPass = 0;
+};
+
+
+
+#endif //POSTPROCESS_H
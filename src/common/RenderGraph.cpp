@@ -0,0 +1,331 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#include "RenderGraph.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <queue>
+
+RenderGraph::Resource RenderGraph::addResource(const char *name, Kind kind, bool imported,
+                                               const RenderTargetDescription &description, GLuint object) {
+    resources.push_back({name, kind, imported, description, object, INVALID, INVALID, INVALID});
+    versions.push_back({uint32_t(resources.size() - 1), INVALID, INVALID, false, {}});
+    compiled = false;
+    return Resource(versions.size() - 1);
+}
+
+RenderGraph::Resource RenderGraph::createTexture(const char *name, const RenderTargetDescription &description) {
+    return addResource(name, Kind::Texture, false, description, 0);
+}
+
+RenderGraph::Resource RenderGraph::importTexture(const char *name, GLuint texture,
+                                                 const RenderTargetDescription &description) {
+    return addResource(name, Kind::Texture, true, description, texture);
+}
+
+RenderGraph::Resource RenderGraph::importBuffer(const char *name, GLuint buffer) {
+    return addResource(name, Kind::Buffer, true, RenderTargetDescription{}, buffer);
+}
+
+RenderGraph::Resource RenderGraph::importBackbuffer(const char *name, unsigned int width, unsigned int height) {
+    return addResource(name, Kind::Backbuffer, true, RenderTargetDescription{width, height, GL_RGBA8}, 0);
+}
+
+RenderGraph::Pass RenderGraph::addPass(const char *name, std::function<void()> execute) {
+    passes.emplace_back();
+    passes.back().name = name;
+    passes.back().execute = std::move(execute);
+    compiled = false;
+    return Pass(passes.size() - 1);
+}
+
+bool RenderGraph::valid(Pass pass, Resource resource) {
+    if (pass < passes.size() && resource < versions.size()) return true;
+    printf("Render graph: invalid pass %u or resource %u\n", pass, resource);
+    broken = true;
+    return false;
+}
+
+void RenderGraph::read(Pass pass, Resource resource) {
+    if (!valid(pass, resource)) return;
+    passes[pass].reads.push_back(resource);
+    versions[resource].readers.push_back(pass);
+    compiled = false;
+}
+
+RenderGraph::Resource RenderGraph::newVersion(Pass pass, Resource resource) {
+    if (versions[resource].next != INVALID) {
+        printf("Render graph: %s is written by %s and %s from the same contents\n",
+               resources[versions[resource].resource].name, passes[versions[versions[resource].next].writer].name,
+               passes[pass].name);
+        broken = true;
+        return INVALID;
+    }
+    uint32_t resourceIndex = versions[resource].resource;
+    versions.push_back({resourceIndex, pass, INVALID, false, {}});
+    versions[resource].next = Resource(versions.size() - 1);
+    passes[pass].writes.push_back(resource);
+    compiled = false;
+    return Resource(versions.size() - 1);
+}
+
+RenderGraph::Resource RenderGraph::write(Pass pass, Resource resource) {
+    if (!valid(pass, resource)) return INVALID;
+    return newVersion(pass, resource);
+}
+
+RenderGraph::Resource RenderGraph::attach(Pass pass, Resource resource) {
+    if (!valid(pass, resource)) return INVALID;
+    if (resources[versions[resource].resource].kind == Kind::Buffer) {
+        printf("Render graph: buffer %s can not be attached by %s\n", resources[versions[resource].resource].name,
+               passes[pass].name);
+        broken = true;
+        return INVALID;
+    }
+    Resource written = newVersion(pass, resource);
+    if (written != INVALID) passes[pass].attachments.push_back(written);
+    return written;
+}
+
+void RenderGraph::setSideEffect(Pass pass) {
+    if (pass < passes.size()) passes[pass].sideEffect = true;
+    compiled = false;
+}
+
+void RenderGraph::output(Resource resource) {
+    if (resource < versions.size()) versions[resource].output = true;
+    compiled = false;
+}
+
+bool RenderGraph::compile() {
+    compiled = false;
+    passOrder.clear();
+    slots.clear();
+    if (broken) return false;
+
+    // what the backbuffer holds at the end of the frame is always shown
+    for (Version &version : versions) {
+        if (resources[version.resource].kind == Kind::Backbuffer && version.writer != INVALID &&
+            version.next == INVALID) version.output = true;
+    }
+
+    // culling: walk from the outputs and side effects to the passes producing what they use, a write depends on the
+    // contents before it since a pass may only update parts of a target
+    std::vector<Pass> stack;
+    for (PassData &pass : passes) pass.alive = false;
+    for (Pass p = 0; p < passes.size(); ++p) if (passes[p].sideEffect) stack.push_back(p);
+    for (const Version &version : versions) if (version.output && version.writer != INVALID) stack.push_back(version.writer);
+    for (Pass p : stack) passes[p].alive = true;
+    while (!stack.empty()) {
+        Pass p = stack.back();
+        stack.pop_back();
+        auto produce = [&](Resource used) {
+            Pass writer = versions[used].writer;
+            if (writer == INVALID || passes[writer].alive) return;
+            passes[writer].alive = true;
+            stack.push_back(writer);
+        };
+        for (Resource used : passes[p].reads) produce(used);
+        for (Resource used : passes[p].writes) produce(used);
+    }
+
+    // ordering: a pass runs after the writer of everything it uses and after the readers of what it overwrites
+    std::vector<std::vector<Pass>> successors(passes.size());
+    std::vector<uint32_t> predecessorCount(passes.size(), 0);
+    auto depend = [&](Pass before, Pass after) {
+        if (before == INVALID || before == after || !passes[before].alive) return;
+        successors[before].push_back(after);
+        ++predecessorCount[after];
+    };
+    for (Pass p = 0; p < passes.size(); ++p) {
+        if (!passes[p].alive) continue;
+        for (Resource used : passes[p].reads) depend(versions[used].writer, p);
+        for (Resource used : passes[p].writes) {
+            depend(versions[used].writer, p);
+            for (Pass reader : versions[used].readers) depend(reader, p);
+        }
+    }
+    std::priority_queue<Pass, std::vector<Pass>, std::greater<>> ready;
+    size_t aliveCount = 0;
+    for (Pass p = 0; p < passes.size(); ++p) {
+        if (!passes[p].alive) continue;
+        ++aliveCount;
+        if (predecessorCount[p] == 0) ready.push(p);
+    }
+    while (!ready.empty()) {
+        Pass p = ready.top();
+        ready.pop();
+        passOrder.push_back(p);
+        for (Pass after : successors[p]) if (--predecessorCount[after] == 0) ready.push(after);
+    }
+    if (passOrder.size() != aliveCount) {
+        printf("Render graph: cycle between the passes");
+        for (Pass p = 0; p < passes.size(); ++p) if (passes[p].alive && predecessorCount[p] > 0) printf(" %s", passes[p].name);
+        printf("\n");
+        passOrder.clear();
+        return false;
+    }
+
+    // framebuffers: up to MAX_COLOR_ATTACHMENTS colors and one depth of one size, or the backbuffer alone
+    for (Pass p : passOrder) {
+        unsigned int colors = 0, depths = 0, backbuffers = 0;
+        const std::vector<Resource> &attachments = passes[p].attachments;
+        for (Resource attached : attachments) {
+            const ResourceData &resource = resources[versions[attached].resource];
+            if (resource.kind == Kind::Backbuffer) ++backbuffers;
+            else if (RenderTargetPool::isDepthFormat(resource.description.format)) ++depths;
+            else ++colors;
+            const RenderTargetDescription &first = resources[versions[attachments[0]].resource].description;
+            if (resource.description.width != first.width || resource.description.height != first.height) {
+                printf("Render graph: attachments of %s differ in size\n", passes[p].name);
+                passOrder.clear();
+                return false;
+            }
+        }
+        if (colors > RenderTargetPool::MAX_COLOR_ATTACHMENTS || depths > 1 ||
+            (backbuffers > 0 && attachments.size() > 1)) {
+            printf("Render graph: %s has attachments no framebuffer can hold\n", passes[p].name);
+            passOrder.clear();
+            return false;
+        }
+    }
+
+    // lifetimes of the transient textures in execution order
+    for (ResourceData &resource : resources) resource.first = resource.last = resource.slot = INVALID;
+    for (uint32_t position = 0; position < passOrder.size(); ++position) {
+        const PassData &pass = passes[passOrder[position]];
+        for (const std::vector<Resource> *used : {&pass.reads, &pass.writes, &pass.attachments}) {
+            for (Resource version : *used) {
+                ResourceData &resource = resources[versions[version].resource];
+                if (resource.imported) continue;
+                if (resource.first == INVALID || position < resource.first) resource.first = position;
+                if (resource.last == INVALID || position > resource.last) resource.last = position;
+            }
+        }
+    }
+
+    // aliasing: in order of first use, a texture takes the first physical texture of its description that is no
+    // longer used by then
+    std::vector<uint32_t> transient;
+    for (uint32_t r = 0; r < resources.size(); ++r) if (resources[r].first != INVALID) transient.push_back(r);
+    std::stable_sort(transient.begin(), transient.end(),
+                     [&](uint32_t a, uint32_t b) { return resources[a].first < resources[b].first; });
+    for (uint32_t r : transient) {
+        ResourceData &resource = resources[r];
+        for (uint32_t s = 0; s < slots.size() && resource.slot == INVALID; ++s) {
+            if (slots[s].description == resource.description && slots[s].last < resource.first) resource.slot = s;
+        }
+        if (resource.slot == INVALID) {
+            slots.push_back({resource.description, 0, 0});
+            resource.slot = uint32_t(slots.size() - 1);
+        }
+        slots[resource.slot].last = resource.last;
+    }
+
+    compiled = true;
+    return true;
+}
+
+void RenderGraph::execute(RenderTargetPool &pool) {
+    if (!compiled) return;
+    for (Slot &slot : slots) slot.texture = pool.acquire(slot.description);
+
+    for (Pass p : passOrder) {
+        PassData &pass = passes[p];
+        if (!pass.attachments.empty()) {
+            GLuint colors[RenderTargetPool::MAX_COLOR_ATTACHMENTS], depth = 0, framebuffer = 0;
+            unsigned int colorCount = 0;
+            const RenderTargetDescription &size = resources[versions[pass.attachments[0]].resource].description;
+            if (resources[versions[pass.attachments[0]].resource].kind != Kind::Backbuffer) {
+                for (Resource attached : pass.attachments) {
+                    if (RenderTargetPool::isDepthFormat(description(attached).format)) depth = texture(attached);
+                    else colors[colorCount++] = texture(attached);
+                }
+                framebuffer = pool.framebuffer(colors, colorCount, depth);
+            }
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+            glViewport(0, 0, GLsizei(size.width), GLsizei(size.height));
+        }
+        if (pass.execute) pass.execute();
+    }
+
+    for (Slot &slot : slots) {
+        pool.release(slot.texture);
+        slot.texture = 0;
+    }
+}
+
+void RenderGraph::clear() {
+    resources.clear();
+    versions.clear();
+    passes.clear();
+    passOrder.clear();
+    slots.clear();
+    broken = compiled = false;
+}
+
+GLuint RenderGraph::texture(Resource resource) const {
+    if (resource >= versions.size()) return 0;
+    const ResourceData &data = resources[versions[resource].resource];
+    if (data.kind != Kind::Texture) return 0;
+    if (data.imported) return data.object;
+    return data.slot < slots.size() ? slots[data.slot].texture : 0;
+}
+
+GLuint RenderGraph::buffer(Resource resource) const {
+    if (resource >= versions.size()) return 0;
+    const ResourceData &data = resources[versions[resource].resource];
+    return data.kind == Kind::Buffer ? data.object : 0;
+}
+
+const RenderTargetDescription &RenderGraph::description(Resource resource) const {
+    return resources[versions[resource].resource].description;
+}
+
+uint32_t RenderGraph::physicalTexture(Resource resource) const {
+    return resource < versions.size() ? resources[versions[resource].resource].slot : INVALID;
+}
+
+uint32_t RenderGraph::firstUse(Resource resource) const {
+    return resource < versions.size() ? resources[versions[resource].resource].first : INVALID;
+}
+
+uint32_t RenderGraph::lastUse(Resource resource) const {
+    return resource < versions.size() ? resources[versions[resource].resource].last : INVALID;
+}
+
+size_t RenderGraph::transientBytes() const {
+    size_t total = 0;
+    for (const ResourceData &resource : resources) {
+        if (resource.slot == INVALID) continue;
+        total += size_t(resource.description.width) * resource.description.height *
+                 RenderTargetPool::bytesPerPixel(resource.description.format);
+    }
+    return total;
+}
+
+size_t RenderGraph::allocatedBytes() const {
+    size_t total = 0;
+    for (const Slot &slot : slots)
+        total += size_t(slot.description.width) * slot.description.height * RenderTargetPool::bytesPerPixel(slot.description.format);
+    return total;
+}
+
+void RenderGraph::print() const {
+    printf("Render graph: %zu of %zu passes:", passOrder.size(), passes.size());
+    for (Pass p : passOrder) printf(" %s", passes[p].name);
+    printf("\n");
+    for (Pass p = 0; p < passes.size(); ++p) if (!passes[p].alive) printf("  culled %s\n", passes[p].name);
+    for (uint32_t s = 0; s < slots.size(); ++s) {
+        printf("  texture %u (%ux%u):", s, slots[s].description.width, slots[s].description.height);
+        for (const ResourceData &resource : resources) {
+            if (resource.slot == s) printf(" %s [%u, %u]", resource.name, resource.first, resource.last);
+        }
+        printf("\n");
+    }
+    printf("  transient textures %.1f MiB, allocated %.1f MiB\n", double(transientBytes()) / (1024.0 * 1024.0),
+           double(allocatedBytes()) / (1024.0 * 1024.0));
+}
@@ -0,0 +1,151 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#ifndef RENDERGRAPH_H
+#define RENDERGRAPH_H
+#include <glad/gl.h>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "RenderTargetPool.hpp"
+
+
+/** Passes of a frame and the textures and buffers they read and write
+ *
+ *  Resources are referenced by versioned handles: every write() or attach() returns the handle of the new contents,
+ *  readers of the old handle run before the writer and readers of the new one after it. compile() then works on the
+ *  CPU only:
+ *  - passes that neither reach an output() nor have a side effect are culled
+ *  - the remaining passes are ordered by their dependencies (declaration order breaks ties)
+ *  - every transient texture gets the lifetime from its first to its last pass, transient textures of the same
+ *    description whose lifetimes do not overlap share one physical texture
+ *
+ *  execute() takes the physical textures from a RenderTargetPool, binds the framebuffer of the attachments of every
+ *  pass, sets the viewport to their size and runs the pass. The content of a transient texture is undefined when its
+ *  first pass starts. A graph is built once and executed every frame, rebuild it with clear() when the passes or
+ *  target sizes change.
+ */
+class RenderGraph {
+public:
+    /** Versioned resource handle */
+    using Resource = uint32_t;
+    using Pass = uint32_t;
+    static constexpr uint32_t INVALID = UINT32_MAX;
+
+    RenderGraph() = default;
+    RenderGraph(const RenderGraph &) = delete;
+    RenderGraph &operator=(const RenderGraph &) = delete;
+
+    /** Texture allocated by the graph, its memory can be shared with other transient textures */
+    Resource createTexture(const char *name, const RenderTargetDescription &description);
+    /** Texture owned by someone else, it is never culled away when it is an output */
+    Resource importTexture(const char *name, GLuint texture, const RenderTargetDescription &description);
+    /** Buffer owned by someone else, only used to order its writers and readers */
+    Resource importBuffer(const char *name, GLuint buffer);
+    /** The default framebuffer, passes can only attach it alone */
+    Resource importBackbuffer(const char *name, unsigned int width, unsigned int height);
+
+    /** @param[in] execute Issues the GL commands of the pass, the graph's framebuffer and viewport are bound */
+    Pass addPass(const char *name, std::function<void()> execute);
+    void read(Pass pass, Resource resource);
+    /** Writes the resource outside of the pass framebuffer (own framebuffers, buffer updates)
+     *
+     *  @returns Handle of the new contents
+     */
+    Resource write(Pass pass, Resource resource);
+    /** Renders into the texture as an attachment of the pass framebuffer, color attachments in the order of the calls
+     *
+     *  @returns Handle of the new contents
+     */
+    Resource attach(Pass pass, Resource resource);
+    /** Keeps the pass even if nothing reads its results (readbacks, queries) */
+    void setSideEffect(Pass pass);
+    /** Marks contents that are used after the frame, their writers are never culled */
+    void output(Resource resource);
+
+    /** Culls, orders and allocates the passes
+     *
+     *  @returns false if the graph has a cycle or an invalid handle was used, the reason is printed
+     */
+    bool compile();
+    /** Runs the compiled passes, the textures go back to the pool afterwards */
+    void execute(RenderTargetPool &pool);
+    /** Removes all passes and resources */
+    void clear();
+
+    /** @returns Texture of the handle, physical textures of transient ones are only known during execute() */
+    GLuint texture(Resource resource) const;
+    GLuint buffer(Resource resource) const;
+    const RenderTargetDescription &description(Resource resource) const;
+
+    /** @returns Compiled passes in execution order, culled passes are not listed */
+    const std::vector<Pass> &order() const { return passOrder; }
+    bool culled(Pass pass) const { return !passes[pass].alive; }
+    const char *passName(Pass pass) const { return passes[pass].name; }
+    size_t passCount() const { return passes.size(); }
+    /** @returns Number of handles, every handle below it is valid */
+    size_t handleCount() const { return versions.size(); }
+    /** @returns Index of the texture or buffer the handle is a version of */
+    uint32_t resourceIndex(Resource resource) const { return versions[resource].resource; }
+    /** @returns Physical texture index of a transient texture, INVALID if it is imported or unused */
+    uint32_t physicalTexture(Resource resource) const;
+    /** @returns First and last position in order() of a transient texture */
+    uint32_t firstUse(Resource resource) const;
+    uint32_t lastUse(Resource resource) const;
+    size_t physicalTextureCount() const { return slots.size(); }
+    /** @returns Memory of all transient textures, without sharing */
+    size_t transientBytes() const;
+    /** @returns Memory of the physical textures */
+    size_t allocatedBytes() const;
+
+    /** Prints the execution order, culled passes and the texture sharing */
+    void print() const;
+
+private:
+    enum class Kind : uint8_t { Texture, Buffer, Backbuffer };
+    struct ResourceData {
+        const char *name;
+        Kind kind;
+        bool imported;
+        RenderTargetDescription description;
+        GLuint object;      // imported texture or buffer
+        uint32_t first, last, slot;
+    };
+    struct Version {
+        uint32_t resource;
+        Pass writer;
+        uint32_t next;      // version written from this one, INVALID while it is the latest
+        bool output;
+        std::vector<Pass> readers;
+    };
+    struct PassData {
+        const char *name;
+        std::function<void()> execute;
+        std::vector<Resource> reads, writes, attachments;
+        bool sideEffect = false, alive = false;
+    };
+    struct Slot {
+        RenderTargetDescription description;
+        uint32_t last;
+        GLuint texture;
+    };
+
+    Resource addResource(const char *name, Kind kind, bool imported, const RenderTargetDescription &description,
+                         GLuint object);
+    Resource newVersion(Pass pass, Resource resource);
+    bool valid(Pass pass, Resource resource);
+
+    std::vector<ResourceData> resources;
+    std::vector<Version> versions;
+    std::vector<PassData> passes;
+    std::vector<Pass> passOrder;
+    std::vector<Slot> slots;
+    bool broken = false, compiled = false;
+};
+
+
+
+#endif //RENDERGRAPH_H
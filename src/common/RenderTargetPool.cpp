@@ -0,0 +1,163 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#include "RenderTargetPool.hpp"
+
+#include <cstdio>
+
+namespace {
+    /** Pixel transfer format and type glTexImage2D accepts for the internal format, no data is uploaded */
+    void transferFormat(GLenum internalFormat, GLenum &format, GLenum &type) {
+        switch (internalFormat) {
+            case GL_DEPTH24_STENCIL8: format = GL_DEPTH_STENCIL; type = GL_UNSIGNED_INT_24_8; return;
+            case GL_DEPTH32F_STENCIL8: format = GL_DEPTH_STENCIL; type = GL_FLOAT_32_UNSIGNED_INT_24_8_REV; return;
+            case GL_DEPTH_COMPONENT16:
+            case GL_DEPTH_COMPONENT24:
+            case GL_DEPTH_COMPONENT32F: format = GL_DEPTH_COMPONENT; type = GL_FLOAT; return;
+            case GL_R8:
+            case GL_R16F:
+            case GL_R32F: format = GL_RED; type = GL_FLOAT; return;
+            case GL_RG8:
+            case GL_RG16:
+            case GL_RG16F: format = GL_RG; type = GL_FLOAT; return;
+            case GL_R11F_G11F_B10F: format = GL_RGB; type = GL_FLOAT; return;
+            default: format = GL_RGBA; type = GL_UNSIGNED_BYTE; return;
+        }
+    }
+}
+
+RenderTargetPool::~RenderTargetPool() {
+    destroy();
+}
+
+bool RenderTargetPool::isDepthFormat(GLenum format) {
+    return format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8 || format == GL_DEPTH_COMPONENT16 ||
+           format == GL_DEPTH_COMPONENT24 || format == GL_DEPTH_COMPONENT32F;
+}
+
+size_t RenderTargetPool::bytesPerPixel(GLenum format) {
+    switch (format) {
+        case GL_R8: return 1;
+        case GL_RG8: case GL_R16F: case GL_DEPTH_COMPONENT16: return 2;
+        case GL_RGBA16F: return 8;
+        case GL_DEPTH32F_STENCIL8: return 8;
+        case GL_RGBA32F: return 16;
+        default: return 4;
+    }
+}
+
+GLuint RenderTargetPool::acquire(const RenderTargetDescription &description) {
+    for (Target &target : targets) {
+        if (target.inUse || !(target.description == description)) continue;
+        target.inUse = true;
+        target.unusedFrames = 0;
+        return target.texture;
+    }
+
+    GLuint texture = 0;
+    GLenum format, type;
+    transferFormat(description.format, format, type);
+    bool depth = isDepthFormat(description.format);
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GLint(description.format), GLsizei(description.width), GLsizei(description.height),
+                 0, format, type, nullptr);
+    // colors are resampled by upscaling and post passes, depth is only fetched
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, depth ? GL_NEAREST : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, depth ? GL_NEAREST : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    targets.push_back({description, texture, true, 0});
+    return texture;
+}
+
+void RenderTargetPool::release(GLuint texture) {
+    for (Target &target : targets) {
+        if (target.texture == texture) {
+            target.inUse = false;
+            return;
+        }
+    }
+}
+
+GLuint RenderTargetPool::framebuffer(const GLuint *colorTextures, unsigned int colorCount, GLuint depthTexture) {
+    if (colorCount > MAX_COLOR_ATTACHMENTS) return 0;
+    GLuint attachments[MAX_COLOR_ATTACHMENTS + 1] = {};
+    for (unsigned int i = 0; i < colorCount; ++i) attachments[i] = colorTextures[i];
+    attachments[MAX_COLOR_ATTACHMENTS] = depthTexture;
+
+    for (const Framebuffer &cached : framebuffers) {
+        bool same = true;
+        for (unsigned int i = 0; i <= MAX_COLOR_ATTACHMENTS; ++i) same &= cached.attachments[i] == attachments[i];
+        if (same) return cached.framebuffer;
+    }
+
+    Framebuffer created{};
+    for (unsigned int i = 0; i <= MAX_COLOR_ATTACHMENTS; ++i) created.attachments[i] = attachments[i];
+    GLint bound = 0;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &bound);
+    glGenFramebuffers(1, &created.framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, created.framebuffer);
+    GLenum drawBuffers[MAX_COLOR_ATTACHMENTS];
+    for (unsigned int i = 0; i < colorCount; ++i) {
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, colorTextures[i], 0);
+        drawBuffers[i] = GL_COLOR_ATTACHMENT0 + i;
+    }
+    if (depthTexture) {
+        GLenum depthFormat = GL_DEPTH_COMPONENT24;
+        for (const Target &target : targets) if (target.texture == depthTexture) depthFormat = target.description.format;
+        GLenum attachment = depthFormat == GL_DEPTH24_STENCIL8 || depthFormat == GL_DEPTH32F_STENCIL8
+                            ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+        glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, depthTexture, 0);
+    }
+    if (colorCount > 0) glDrawBuffers(GLsizei(colorCount), drawBuffers);
+    else glDrawBuffer(GL_NONE);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, GLuint(bound));
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        printf("Render target framebuffer is incomplete: 0x%x\n", status);
+        glDeleteFramebuffers(1, &created.framebuffer);
+        return 0;
+    }
+    framebuffers.push_back(created);
+    return created.framebuffer;
+}
+
+void RenderTargetPool::endFrame() {
+    for (size_t i = targets.size(); i-- > 0;) {
+        if (targets[i].inUse) continue;
+        if (++targets[i].unusedFrames > unusedFrameLimit) deleteTarget(i);
+    }
+}
+
+size_t RenderTargetPool::bytes() const {
+    size_t total = 0;
+    for (const Target &target : targets)
+        total += size_t(target.description.width) * target.description.height * bytesPerPixel(target.description.format);
+    return total;
+}
+
+void RenderTargetPool::deleteTarget(size_t index) {
+    GLuint texture = targets[index].texture;
+    for (size_t i = framebuffers.size(); i-- > 0;) {
+        bool attached = false;
+        for (GLuint attachment : framebuffers[i].attachments) attached |= attachment == texture;
+        if (!attached) continue;
+        glDeleteFramebuffers(1, &framebuffers[i].framebuffer);
+        framebuffers[i] = framebuffers.back();
+        framebuffers.pop_back();
+    }
+    glDeleteTextures(1, &texture);
+    targets[index] = targets.back();
+    targets.pop_back();
+}
+
+void RenderTargetPool::destroy() {
+    for (const Framebuffer &cached : framebuffers) glDeleteFramebuffers(1, &cached.framebuffer);
+    for (const Target &target : targets) glDeleteTextures(1, &target.texture);
+    framebuffers.clear();
+    targets.clear();
+}
@@ -0,0 +1,81 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#ifndef RENDERTARGETPOOL_H
+#define RENDERTARGETPOOL_H
+#include <glad/gl.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+/** Size and internal format of a 2D render target */
+struct RenderTargetDescription {
+    unsigned int width = 1, height = 1;
+    GLenum format = GL_RGBA8;
+
+    bool operator==(const RenderTargetDescription &) const = default;
+};
+
+/** 2D render target textures and the framebuffers built from them, reused across frames and render graphs
+ *
+ *  acquire() hands out a free texture of the exact description or creates one, release() returns it. Textures that
+ *  were not acquired for unusedFrameLimit calls of endFrame() are deleted together with their framebuffers, so targets
+ *  of an old resolution go away after a resize.
+ */
+class RenderTargetPool {
+public:
+    /** Color attachments a framebuffer of the pool can have, next to one depth (stencil) attachment */
+    static constexpr unsigned int MAX_COLOR_ATTACHMENTS = 4;
+
+    explicit RenderTargetPool(unsigned int unusedFrameLimit = 3) : unusedFrameLimit(unusedFrameLimit) {}
+    RenderTargetPool(const RenderTargetPool &) = delete;
+    RenderTargetPool &operator=(const RenderTargetPool &) = delete;
+    ~RenderTargetPool();
+
+    /** @returns Texture nobody else holds until it is released, linear filtered colors and nearest filtered depth */
+    GLuint acquire(const RenderTargetDescription &description);
+    void release(GLuint texture);
+
+    /** @returns Cached framebuffer drawing into the textures (color attachments in order), 0 if it is incomplete
+     *
+     *  @param[in] depthTexture Depth or depth stencil texture of the pool, 0 for none
+     */
+    GLuint framebuffer(const GLuint *colorTextures, unsigned int colorCount, GLuint depthTexture);
+
+    /** Ages the free textures and deletes the ones over the limit */
+    void endFrame();
+
+    /** @returns Memory of all textures of the pool */
+    size_t bytes() const;
+    size_t textureCount() const { return targets.size(); }
+
+    static bool isDepthFormat(GLenum format);
+    /** @returns Bytes per pixel of the formats render targets are created with, 4 for unknown ones */
+    static size_t bytesPerPixel(GLenum format);
+
+    void destroy();
+
+private:
+    struct Target {
+        RenderTargetDescription description;
+        GLuint texture;
+        bool inUse;
+        unsigned int unusedFrames;
+    };
+    struct Framebuffer {
+        GLuint attachments[MAX_COLOR_ATTACHMENTS + 1];    // colors, then depth, unused ones are 0
+        GLuint framebuffer;
+    };
+
+    void deleteTarget(size_t index);
+
+    unsigned int unusedFrameLimit;
+    std::vector<Target> targets;
+    std::vector<Framebuffer> framebuffers;
+};
+
+
+
+#endif //RENDERTARGETPOOL_H
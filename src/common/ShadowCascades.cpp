@@ -0,0 +1,246 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#include "ShadowCascades.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include "shader.hpp"
+
+namespace {
+    // cached cascades cover their slice with this much room, the camera can move that far before they are refitted
+    constexpr float CACHE_MARGIN = 1.25f;
+
+    float dot(const float a[3], const float b[3]) {
+        return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+    }
+
+    void normalize(float v[3]) {
+        float length = std::sqrt(dot(v, v));
+        if (length > 0.0f) for (int i = 0; i < 3; ++i) v[i] /= length;
+    }
+
+    void cross(const float a[3], const float b[3], float result[3]) {
+        result[0] = a[1] * b[2] - a[2] * b[1];
+        result[1] = a[2] * b[0] - a[0] * b[2];
+        result[2] = a[0] * b[1] - a[1] * b[0];
+    }
+}
+
+ShadowCascades::ShadowCascades(unsigned int resolution, unsigned int cascadeCount, unsigned int cachedCascades)
+    : resolution(std::max(resolution, 16u)), cascadeCount(std::clamp(cascadeCount, 1u, MAX_CASCADES)),
+      cachedCount(std::min(cachedCascades, this->cascadeCount - 1)) {
+    setRange(nearDepth, shadowDistance, lambda);
+}
+
+ShadowCascades::~ShadowCascades() {
+    destroy();
+}
+
+bool ShadowCascades::create() {
+    destroy();
+    glGenTextures(1, &depthTexture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, depthTexture);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, GLsizei(resolution), GLsizei(resolution),
+                 GLsizei(cascadeCount), 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, nullptr);
+    // hardware 2x2 percentage closer filtering, everything outside the cascade is lit
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    const float border[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+    glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, border);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    GLint bound = 0;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &bound);
+    glGenFramebuffers(GLsizei(cascadeCount), framebuffers);
+    bool complete = true;
+    for (unsigned int c = 0; c < cascadeCount; ++c) {
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[c]);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture, 0, GLint(c));
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        complete = complete && glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, GLuint(bound));
+    if (!complete) {
+        printf("Shadow cascade framebuffer is incomplete\n");
+        destroy();
+        return false;
+    }
+
+    program = LoadShaders("src/shaders/ShadowDepth.vert", "src/shaders/ShadowDepth.frag");
+    if (!program) {
+        destroy();
+        return false;
+    }
+    std::fill(dirty, dirty + MAX_CASCADES, true);
+    return true;
+}
+
+void ShadowCascades::setRange(float nearPlane, float distance, float splitLambda) {
+    nearDepth = nearPlane;
+    shadowDistance = std::max(distance, nearPlane * 1.01f);
+    lambda = std::clamp(splitLambda, 0.0f, 1.0f);
+    for (unsigned int c = 0; c <= cascadeCount; ++c) {
+        float part = float(c) / float(cascadeCount);
+        float logarithmic = nearDepth * std::pow(shadowDistance / nearDepth, part);
+        float uniform = nearDepth + (shadowDistance - nearDepth) * part;
+        splits[c] = lambda * logarithmic + (1.0f - lambda) * uniform;
+    }
+    fitted = false;
+}
+
+void ShadowCascades::update(const float view[16], float fovY, float aspect, const float lightDirection[3]) {
+    float direction[3] = {lightDirection[0], lightDirection[1], lightDirection[2]};
+    normalize(direction);
+    bool lightChanged = !fitted || dot(direction, light) < 0.99999f;
+    if (lightChanged) {
+        std::copy(direction, direction + 3, light);
+        // any fixed axis not parallel to the light, the basis must only change with the light to keep the snapping
+        const float reference[3] = {0.0f, std::abs(light[1]) < 0.99f ? 1.0f : 0.0f, std::abs(light[1]) < 0.99f ? 0.0f : 1.0f};
+        cross(reference, light, right);
+        normalize(right);
+        cross(light, right, up);
+    }
+
+    // camera position and forward axis of the rigid view matrix
+    float eye[3], forward[3];
+    for (int i = 0; i < 3; ++i) {
+        eye[i] = -(view[i * 4] * view[12] + view[i * 4 + 1] * view[13] + view[i * 4 + 2] * view[14]);
+        forward[i] = -view[i * 4 + 2];
+    }
+
+    // squared slope of the frustum's corner edges, the bounding sphere of a slice only depends on it and the depths
+    float tanHalfY = std::tan(fovY * 0.5f);
+    float slope2 = tanHalfY * tanHalfY * (1.0f + aspect * aspect);
+    for (unsigned int c = 0; c < cascadeCount; ++c) {
+        float sliceNear = splits[c], sliceFar = splits[c + 1];
+        float depth = std::min(0.5f * (sliceNear + sliceFar) * (1.0f + slope2), sliceFar);
+        float radius = std::max(std::sqrt((depth - sliceNear) * (depth - sliceNear) + sliceNear * sliceNear * slope2),
+                                std::sqrt((sliceFar - depth) * (sliceFar - depth) + sliceFar * sliceFar * slope2));
+        // quantized so rounding noise can not change the texel size from frame to frame
+        radius = std::ceil(radius * 16.0f) / 16.0f;
+        const float center[3] = {eye[0] + forward[0] * depth, eye[1] + forward[1] * depth, eye[2] + forward[2] * depth};
+
+        if (!cached(c)) {
+            fitCascade(c, center, radius);
+            dirty[c] = true;
+            continue;
+        }
+        // a cached cascade is kept as long as the slice stays inside it
+        const float offset[3] = {dot(center, right) - centers[c][0], dot(center, up) - centers[c][1],
+                                 dot(center, light) - centers[c][2]};
+        if (lightChanged || std::sqrt(dot(offset, offset)) + radius > radii[c]) {
+            fitCascade(c, center, radius * CACHE_MARGIN);
+            dirty[c] = true;
+        }
+    }
+    fitted = true;
+}
+
+void ShadowCascades::fitCascade(unsigned int cascade, const float center[3], float radius) {
+    // snapping the center to whole texels moves the shadow map in texel steps, the rasterization stays the same
+    float texel = 2.0f * radius / float(resolution);
+    float x = std::floor(dot(center, right) / texel) * texel;
+    float y = std::floor(dot(center, up) / texel) * texel;
+    float z = dot(center, light);
+    centers[cascade][0] = x;
+    centers[cascade][1] = y;
+    centers[cascade][2] = z;
+    radii[cascade] = radius;
+    // casters up to the shadow distance towards the light are kept in front of the near plane
+    depthNear[cascade] = z + radius + shadowDistance;
+    depthFar[cascade] = z - radius;
+
+    float depthScale = -2.0f / (depthNear[cascade] - depthFar[cascade]);
+    float *m = matrices[cascade];
+    for (int i = 0; i < 3; ++i) {
+        m[i * 4] = right[i] / radius;
+        m[i * 4 + 1] = up[i] / radius;
+        m[i * 4 + 2] = light[i] * depthScale;
+        m[i * 4 + 3] = 0.0f;
+    }
+    m[12] = -x / radius;
+    m[13] = -y / radius;
+    m[14] = -depthNear[cascade] * depthScale - 1.0f;
+    m[15] = 1.0f;
+}
+
+void ShadowCascades::invalidateStatic() {
+    for (unsigned int c = 0; c < cascadeCount; ++c) dirty[c] = true;
+}
+
+void ShadowCascades::beginCascade(unsigned int cascade) {
+    if (cascade >= cascadeCount || !depthTexture) return;
+    if (!rendering) {
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+        glGetIntegerv(GL_VIEWPORT, previousViewport);
+        // slope scaled bias against acne on surfaces facing away from the light
+        glEnable(GL_POLYGON_OFFSET_FILL);
+        glPolygonOffset(2.0f, 4.0f);
+        rendering = true;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[cascade]);
+    glViewport(0, 0, GLsizei(resolution), GLsizei(resolution));
+    glClear(GL_DEPTH_BUFFER_BIT);
+    glUseProgram(program);
+    dirty[cascade] = false;
+    ++renderCount;
+}
+
+void ShadowCascades::endCascades() {
+    if (!rendering) return;
+    glDisable(GL_POLYGON_OFFSET_FILL);
+    glBindFramebuffer(GL_FRAMEBUFFER, GLuint(previousFramebuffer));
+    glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+    rendering = false;
+}
+
+bool ShadowCascades::castsShadow(unsigned int cascade, const float center[3], float radius, bool staticGeometry) const {
+    if (cascade >= cascadeCount || (cached(cascade) && !staticGeometry)) return false;
+    float reach = radii[cascade] + radius;
+    if (std::abs(dot(center, right) - centers[cascade][0]) > reach) return false;
+    if (std::abs(dot(center, up) - centers[cascade][1]) > reach) return false;
+    float z = dot(center, light);
+    return z - radius <= depthNear[cascade] && z + radius >= depthFar[cascade];
+}
+
+uint64_t ShadowCascades::takeRenderCount() {
+    uint64_t count = renderCount;
+    renderCount = 0;
+    return count;
+}
+
+void ShadowCascades::bind(GLuint receiver) const {
+    glActiveTexture(GL_TEXTURE0 + SHADOW_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, depthTexture);
+    glActiveTexture(GL_TEXTURE0);
+    glUniform1i(glGetUniformLocation(receiver, "shadowMap"), SHADOW_TEXTURE_UNIT);
+    glUniform1i(glGetUniformLocation(receiver, "cascadeCount"), depthTexture ? GLint(cascadeCount) : 0);
+    glUniformMatrix4fv(glGetUniformLocation(receiver, "cascadeMatrices"), GLsizei(cascadeCount), GL_FALSE, matrices[0]);
+
+    // receivers are pushed along their normal by 1.5 texels before the lookup
+    float farDepths[MAX_CASCADES] = {}, normalOffsets[MAX_CASCADES] = {};
+    for (unsigned int c = 0; c < cascadeCount; ++c) {
+        farDepths[c] = splitDepth(c);
+        normalOffsets[c] = 1.5f * texelSize(c);
+    }
+    glUniform4fv(glGetUniformLocation(receiver, "cascadeSplits"), 1, farDepths);
+    glUniform4fv(glGetUniformLocation(receiver, "cascadeNormalOffsets"), 1, normalOffsets);
+    glUniform3fv(glGetUniformLocation(receiver, "lightDirection"), 1, light);
+}
+
+void ShadowCascades::destroy() {
+    if (framebuffers[0]) glDeleteFramebuffers(GLsizei(cascadeCount), framebuffers);
+    if (depthTexture) glDeleteTextures(1, &depthTexture);
+    if (program) glDeleteProgram(program);
+    std::fill(framebuffers, framebuffers + MAX_CASCADES, 0);
+    depthTexture = program = 0;
+}
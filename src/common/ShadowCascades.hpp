@@ -0,0 +1,120 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#ifndef SHADOWCASCADES_H
+#define SHADOWCASCADES_H
+#include <glad/gl.h>
+#include <cstdint>
+
+
+/** Cascaded shadow maps of a directional light (the sun)
+ *
+ *  The view frustum up to the shadow distance is split with the practical split scheme (a blend of logarithmic and
+ *  uniform splits). Every cascade is fitted to the bounding sphere of its frustum slice, so its size does not change
+ *  when the camera turns, and its center is snapped to whole shadow map texels in light space, so the rasterized
+ *  shadow does not shimmer when the camera moves.
+ *
+ *  The far cascades are cached: they are fitted with a margin, hold static casters only and are re-rendered only
+ *  when the camera leaves the margin, the light direction changes or invalidateStatic() is called. The near
+ *  cascades take all casters and are rendered every frame.
+ *
+ *  Per frame: update(), then for every cascade with needsRender() beginCascade(), draw the casters for which
+ *  castsShadow() is true with casterProgram() and the MVP cascadeMatrix() * model, and endCascades() after the last
+ *  one. bind() sets the receiver uniforms of ClusteredShader.frag and DeferredLighting.frag.
+ */
+class ShadowCascades {
+public:
+    static constexpr unsigned int MAX_CASCADES = 4;
+    /** Texture unit of the shadow map array in bind(), clear of the G-buffer, cluster and Hi-Z units */
+    static constexpr GLint SHADOW_TEXTURE_UNIT = 8;
+
+    /** @param[in] cachedCascades Number of far cascades that are cached */
+    explicit ShadowCascades(unsigned int resolution = 2048, unsigned int cascadeCount = 4, unsigned int cachedCascades = 2);
+    ShadowCascades(const ShadowCascades &) = delete;
+    ShadowCascades &operator=(const ShadowCascades &) = delete;
+    ~ShadowCascades();
+
+    /** Creates the depth texture array and loads the caster program
+     *
+     *  @returns false if the framebuffer is incomplete or ShadowDepth does not link
+     */
+    bool create();
+
+    /** Sets the view depth range covered by the cascades
+     *
+     *  @param[in] lambda 0 uniform, 1 logarithmic splits
+     */
+    void setRange(float nearPlane, float shadowDistance, float lambda = 0.75f);
+
+    /** Fits the cascades to the view and light of this frame
+     *
+     *  @param[in] view Column major world to view matrix (rigid, looking down -z)
+     *  @param[in] fovY Vertical field of view in radians
+     *  @param[in] lightDirection World space direction towards the light
+     */
+    void update(const float view[16], float fovY, float aspect, const float lightDirection[3]);
+
+    /** @returns true if the cascade has to be rendered this frame */
+    bool needsRender(unsigned int cascade) const { return cascade < cascadeCount && dirty[cascade]; }
+    /** Marks the cached cascades for re-rendering, call when static geometry changed */
+    void invalidateStatic();
+
+    /** Binds the cascade's layer as depth target, clears it and binds the caster program */
+    void beginCascade(unsigned int cascade);
+    /** Restores the framebuffer, viewport and rasterizer state of before the first beginCascade() */
+    void endCascades();
+
+    /** @returns true if a caster with the world space bounding sphere can cast into the cascade, cached cascades only
+     *           take static casters
+     */
+    bool castsShadow(unsigned int cascade, const float center[3], float radius, bool staticGeometry) const;
+
+    /** @returns Column major world to clip matrix of the cascade */
+    const float *cascadeMatrix(unsigned int cascade) const { return matrices[cascade]; }
+    /** @returns Far view depth of the cascade */
+    float splitDepth(unsigned int cascade) const { return splits[cascade + 1]; }
+    /** @returns World size of one shadow map texel in the cascade */
+    float texelSize(unsigned int cascade) const { return 2.0f * radii[cascade] / float(resolution); }
+    bool cached(unsigned int cascade) const { return cascade >= cascadeCount - cachedCount; }
+    unsigned int count() const { return cascadeCount; }
+    /** @returns Cascades rendered since the counter was last read */
+    uint64_t takeRenderCount();
+
+    /** @returns Depth texture array with one layer per cascade */
+    GLuint texture() const { return depthTexture; }
+    unsigned int mapResolution() const { return resolution; }
+    /** @returns Program for the casters: MVP and the position decode uniforms of MeshShader.vert */
+    GLuint casterProgram() const { return program; }
+    /** Binds the shadow map and sets the cascade uniforms of a receiving program */
+    void bind(GLuint receiver) const;
+
+    void destroy();
+
+private:
+    void fitCascade(unsigned int cascade, const float center[3], float radius);
+
+    unsigned int resolution, cascadeCount, cachedCount;
+    float nearDepth = 0.1f, shadowDistance = 100.0f, lambda = 0.75f;
+    float splits[MAX_CASCADES + 1] = {};
+    float light[3] = {0.0f, 1.0f, 0.0f};
+    float right[3] = {1.0f, 0.0f, 0.0f}, up[3] = {0.0f, 0.0f, -1.0f};   // light space axes
+
+    // light space placement of every cascade: snapped center, half size and depth range along the light
+    float centers[MAX_CASCADES][3] = {};
+    float radii[MAX_CASCADES] = {};
+    float depthFar[MAX_CASCADES] = {}, depthNear[MAX_CASCADES] = {};
+    float matrices[MAX_CASCADES][16] = {};
+    bool dirty[MAX_CASCADES] = {};
+    bool fitted = false;
+    uint64_t renderCount = 0;
+
+    GLuint depthTexture = 0, program = 0;
+    GLuint framebuffers[MAX_CASCADES] = {};
+    bool rendering = false;
+    GLint previousFramebuffer = 0, previousViewport[4] = {0, 0, 1, 1};
+};
+
+
+
+#endif //SHADOWCASCADES_H
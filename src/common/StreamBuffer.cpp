@@ -0,0 +1,151 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#include "StreamBuffer.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "GLExtensions.hpp"
+
+namespace {
+    size_t alignUp(size_t value, size_t alignment) {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+}
+
+StreamBuffer::~StreamBuffer() {
+    destroy();
+}
+
+bool StreamBuffer::create(size_t frameSize, unsigned int frameCount, bool allowPersistent) {
+    destroy();
+    GLint alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    uniformOffsetAlignment = std::max<size_t>(16, size_t(alignment));
+    // every region starts at an offset usable for any binding
+    regionSize = alignUp(std::max<size_t>(frameSize, 1), uniformOffsetAlignment);
+    regionCount = std::max(frameCount, 1u);
+    bufferSize = regionSize * regionCount;
+
+    // GL_COPY_WRITE_BUFFER leaves the vertex array and element bindings alone
+    glGenBuffers(1, &bufferObject);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, bufferObject);
+    if (allowPersistent && GLExtensions::bufferStorage()) {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        GLExtensions::bufferStorageFunction(GL_COPY_WRITE_BUFFER, GLsizeiptr(bufferSize), nullptr, flags);
+        mapping = static_cast<unsigned char *>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, GLsizeiptr(bufferSize), flags));
+        if (!mapping) {
+            printf("Stream buffer of %zu bytes could not be mapped\n", bufferSize);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+            destroy();
+            return false;
+        }
+        persistentMapping = true;
+        fences.assign(regionCount, nullptr);
+    } else {
+        glBufferData(GL_COPY_WRITE_BUFFER, GLsizeiptr(bufferSize), nullptr, GL_STREAM_DRAW);
+        staging.resize(regionSize);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    region = 0;
+    regionStart = head = flushed = 0;
+    regionEnd = regionSize;
+    return true;
+}
+
+void StreamBuffer::beginFrame() {
+    if (!bufferObject) return;
+    if (persistentMapping) {
+        regionStart = head = size_t(region) * regionSize;
+        regionEnd = regionStart + regionSize;
+        GLsync &fence = fences[region];
+        if (!fence) return;
+        GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if (result == GL_TIMEOUT_EXPIRED) {
+            ++stalls;
+            do {
+                result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1 ms
+            } while (result == GL_TIMEOUT_EXPIRED);
+        }
+        if (result == GL_WAIT_FAILED) printf("Waiting for stream buffer region %u failed\n", region);
+        glDeleteSync(fence);
+        fence = nullptr;
+    } else {
+        // continue behind the last frame, orphan the storage once the ring is used up
+        regionStart = head = flushed = alignUp(head, uniformOffsetAlignment);
+        if (regionStart + regionSize > bufferSize) {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, bufferObject);
+            glBufferData(GL_COPY_WRITE_BUFFER, GLsizeiptr(bufferSize), nullptr, GL_STREAM_DRAW);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+            regionStart = head = flushed = 0;
+        }
+        regionEnd = regionStart + regionSize;
+    }
+}
+
+StreamBuffer::Allocation StreamBuffer::allocate(size_t size, size_t alignment) {
+    Allocation allocation;
+    size_t offset = alignUp(head, std::max<size_t>(alignment, 1));
+    if (!bufferObject || offset + size > regionEnd) return allocation;
+    head = offset + size;
+    allocation.offset = GLintptr(offset);
+    allocation.size = size;
+    allocation.data = persistentMapping ? mapping + offset : staging.data() + (offset - regionStart);
+    return allocation;
+}
+
+StreamBuffer::Allocation StreamBuffer::write(const void *data, size_t size, size_t alignment) {
+    Allocation allocation = allocate(size, alignment);
+    if (allocation.data) memcpy(allocation.data, data, size);
+    return allocation;
+}
+
+void StreamBuffer::flush() {
+    // coherent mapping: writes are visible to commands issued after them
+    if (persistentMapping || !bufferObject || head == flushed) return;
+    // the range was never written since the last orphaning, no need to synchronize with pending draws
+    glBindBuffer(GL_COPY_WRITE_BUFFER, bufferObject);
+    void *target = glMapBufferRange(GL_COPY_WRITE_BUFFER, GLintptr(flushed), GLsizeiptr(head - flushed),
+                                    GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+    if (target) {
+        memcpy(target, staging.data() + (flushed - regionStart), head - flushed);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    } else {
+        glBufferSubData(GL_COPY_WRITE_BUFFER, GLintptr(flushed), GLsizeiptr(head - flushed),
+                        staging.data() + (flushed - regionStart));
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    flushed = head;
+}
+
+void StreamBuffer::endFrame() {
+    if (!bufferObject) return;
+    flush();
+    if (!persistentMapping) return;
+    fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    region = (region + 1) % regionCount;
+}
+
+void StreamBuffer::destroy() {
+    for (GLsync fence : fences) if (fence) glDeleteSync(fence);
+    fences.clear();
+    if (bufferObject) {
+        if (mapping) {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, bufferObject);
+            glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        }
+        glDeleteBuffers(1, &bufferObject);
+    }
+    bufferObject = 0;
+    mapping = nullptr;
+    persistentMapping = false;
+    staging.clear();
+    regionSize = bufferSize = 0;
+    regionCount = region = 0;
+    regionStart = regionEnd = head = flushed = 0;
+}
@@ -0,0 +1,98 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#ifndef STREAMBUFFER_H
+#define STREAMBUFFER_H
+#include <glad/gl.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+/** Ring buffer for data written by the CPU every frame: dynamic vertices and indices, uniform blocks, indirect commands
+ *
+ *  With glBufferStorage (4.4 or ARB_buffer_storage) the buffer is mapped once, persistently and coherently, and split
+ *  into frameCount regions. Allocations return a pointer straight into GPU visible memory, a fence per region keeps
+ *  the CPU from overwriting data of a frame the GPU has not finished yet. With frameCount >= 3 the wait is normally
+ *  already signaled.
+ *
+ *  On 3.3 contexts allocations are written into a CPU copy and flush() uploads them with an unsynchronized
+ *  glMapBufferRange. The buffer is orphaned (glBufferData with nullptr) whenever the ring wraps, so the driver hands
+ *  out fresh storage instead of waiting for pending draws.
+ *
+ *  Per frame: beginFrame(), allocate() and write, flush() before the draws reading the data, endFrame() after them.
+ *  The buffer can be bound to any target, allocations report their offset into it.
+ */
+class StreamBuffer {
+public:
+    struct Allocation {
+        void *data = nullptr;   // write only, nullptr if the frame region is full
+        GLintptr offset = 0;    // byte offset into buffer()
+        size_t size = 0;
+    };
+
+    StreamBuffer() = default;
+    StreamBuffer(const StreamBuffer &) = delete;
+    StreamBuffer &operator=(const StreamBuffer &) = delete;
+    ~StreamBuffer();
+
+    /** Creates the buffer, persistent if the context supports buffer storage
+     *
+     *  @param[in] frameSize Bytes available to the allocations of one frame
+     *  @param[in] frameCount Frames in flight, every one gets its own region
+     *  @param[in] allowPersistent false forces the orphaning path, to check it on contexts with buffer storage
+     *  @returns false if the buffer could not be created or mapped
+     */
+    bool create(size_t frameSize, unsigned int frameCount = 3, bool allowPersistent = true);
+
+    /** Waits until the GPU is done with the region of this frame (the one used frameCount frames ago) */
+    void beginFrame();
+
+    /** Suballocates from the current frame's region
+     *
+     *  @param[in] alignment Power of two, e.g. uniformAlignment() for glBindBufferRange(GL_UNIFORM_BUFFER, ...)
+     */
+    Allocation allocate(size_t size, size_t alignment = 16);
+
+    /** Copies data into a new allocation, see allocate() */
+    Allocation write(const void *data, size_t size, size_t alignment = 16);
+
+    /** Makes the allocations since the last flush() visible to the GPU, no-op on the persistent path */
+    void flush();
+
+    /** Fences the region of this frame, call after the last draw reading from it */
+    void endFrame();
+
+    GLuint buffer() const { return bufferObject; }
+    bool persistent() const { return persistentMapping; }
+    /** @returns GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT of the context */
+    size_t uniformAlignment() const { return uniformOffsetAlignment; }
+    /** @returns Bytes allocated in the current frame */
+    size_t frameUsage() const { return head - regionStart; }
+    /** @returns Number of beginFrame() calls that had to wait for the GPU */
+    uint64_t stallCount() const { return stalls; }
+
+    void destroy();
+
+private:
+    GLuint bufferObject = 0;
+    bool persistentMapping = false;
+    unsigned char *mapping = nullptr;      // persistent path: the whole buffer
+    std::vector<unsigned char> staging;    // fallback path: CPU copy of one frame
+    std::vector<GLsync> fences;            // persistent path: one per region
+
+    size_t regionSize = 0;
+    size_t bufferSize = 0;
+    size_t uniformOffsetAlignment = 256;
+    unsigned int regionCount = 0;
+    unsigned int region = 0;
+    size_t regionStart = 0, regionEnd = 0; // byte range of the current frame
+    size_t head = 0;                       // next free byte
+    size_t flushed = 0;                    // fallback path: end of the uploaded bytes
+    uint64_t stalls = 0;
+};
+
+
+
+#endif //STREAMBUFFER_H
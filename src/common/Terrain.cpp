@@ -0,0 +1,682 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#include "Terrain.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "shader.hpp"
+
+namespace {
+    constexpr char MAGIC[4] = {'L', 'L', 'T', 'R'};
+    constexpr uint32_t VERSION = 1;
+
+    /** Start of a .terrain file, followed by the chunk bounds of all levels and, from the next page on, the tiles */
+    struct FileHeader {
+        char magic[4];
+        uint32_t version;
+        uint32_t size;              // quads per side of level 0
+        uint32_t levels;
+        TerrainLayout layout;
+        uint32_t reserved[3];
+    };
+    static_assert(sizeof(FileHeader) == 48, "FileHeader is stored as is in .terrain files");
+
+    constexpr size_t PAGE_SIZE = 4096;
+    constexpr size_t TILE_BYTES = size_t(Terrain::TILE_SAMPLES) * Terrain::TILE_SAMPLES * sizeof(uint16_t);
+    // every tile starts on a page, streaming one touches only its own pages
+    constexpr size_t TILE_STRIDE = (TILE_BYTES + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+    constexpr unsigned int CHUNKS_PER_TILE = Terrain::TILE_QUADS / Terrain::CHUNK_QUADS;
+    constexpr unsigned int GRID_SAMPLES = Terrain::CHUNK_QUADS + 1;
+    constexpr unsigned int ROOT_CHUNKS = CHUNKS_PER_TILE * CHUNKS_PER_TILE;
+    constexpr unsigned int MAX_LOADS = 16;      // tiles streaming at once, also the most uploads of one draw()
+    constexpr unsigned int MAX_REQUESTS = 64;
+
+    enum NodeState : uint8_t { Unrefined, Refined, Culled };
+
+    /** Heights of the levels of a heightfield, every level takes every other sample of the one below */
+    struct Pyramid {
+        const uint16_t *heights;
+        unsigned int width, height, size;
+
+        /** @returns Raw height of sample (x, y) of a level, clamped to the terrain and to the heightfield */
+        uint16_t at(unsigned int level, int x, int y) const {
+            int last = int(size >> level);
+            auto sourceX = std::min(unsigned(std::clamp(x, 0, last)) << level, width - 1);
+            auto sourceY = std::min(unsigned(std::clamp(y, 0, last)) << level, height - 1);
+            return heights[size_t(sourceY) * width + sourceX];
+        }
+    };
+
+    uint32_t hashLattice(int x, int y, uint32_t seed) {
+        uint32_t h = uint32_t(x) * 0x8da6b343u ^ uint32_t(y) * 0xd8163841u ^ seed * 0xcb1ab31fu;
+        h = (h ^ (h >> 15)) * 0x2c1b3c6du;
+        h = (h ^ (h >> 12)) * 0x297a2d39u;
+        return h ^ (h >> 15);
+    }
+
+    /** Value noise in [-1, 1], smoothstep interpolated between random lattice values */
+    float valueNoise(float x, float y, uint32_t seed) {
+        float floorX = std::floor(x), floorY = std::floor(y);
+        int ix = int(floorX), iy = int(floorY);
+        float tx = x - floorX, ty = y - floorY;
+        tx = tx * tx * (3.0f - 2.0f * tx);
+        ty = ty * ty * (3.0f - 2.0f * ty);
+        constexpr float SCALE = 2.0f / 4294967295.0f;
+        float a = float(hashLattice(ix, iy, seed)) * SCALE - 1.0f;
+        float b = float(hashLattice(ix + 1, iy, seed)) * SCALE - 1.0f;
+        float c = float(hashLattice(ix, iy + 1, seed)) * SCALE - 1.0f;
+        float d = float(hashLattice(ix + 1, iy + 1, seed)) * SCALE - 1.0f;
+        return a + (b - a) * tx + (c - a) * ty + (a - b - c + d) * tx * ty;
+    }
+
+    /** Triangles of the chunk grid, 2x2 quad blocks fanned around their center vertex
+     *
+     *  The sides of the blocks on the edges in the stitch mask get one triangle instead of two, skipping the middle
+     *  vertex, so the edge only uses the vertices of the coarser neighbour. Counter clockwise seen from above.
+     */
+    void appendGrid(unsigned int stitch, std::vector<uint16_t> &indices) {
+        // ring around the center, side by side: +x, -z, -x, +z
+        constexpr int RING[9][2] = {{1, 1}, {1, 0}, {1, -1}, {0, -1}, {-1, -1}, {-1, 0}, {-1, 1}, {0, 1}, {1, 1}};
+        constexpr int BLOCKS = Terrain::CHUNK_QUADS / 2;
+        for (int by = 0; by < BLOCKS; ++by) {
+            for (int bx = 0; bx < BLOCKS; ++bx) {
+                int cx = bx * 2 + 1, cy = by * 2 + 1;
+                auto vertex = [&](const int *offset) {
+                    return uint16_t((cy + offset[1]) * int(GRID_SAMPLES) + cx + offset[0]);
+                };
+                const bool stitched[4] = {bx == BLOCKS - 1 && (stitch & 2), by == 0 && (stitch & 4),
+                                          bx == 0 && (stitch & 1), by == BLOCKS - 1 && (stitch & 8)};
+                const int center[2] = {0, 0};
+                for (int side = 0; side < 4; ++side) {
+                    const int *first = RING[side * 2], *middle = RING[side * 2 + 1], *last = RING[side * 2 + 2];
+                    if (stitched[side]) {
+                        indices.insert(indices.end(), {vertex(center), vertex(first), vertex(last)});
+                    } else {
+                        indices.insert(indices.end(), {vertex(center), vertex(first), vertex(middle)});
+                        indices.insert(indices.end(), {vertex(center), vertex(middle), vertex(last)});
+                    }
+                }
+            }
+        }
+    }
+}
+
+Terrain::~Terrain() {
+    destroy();
+}
+
+bool Terrain::build(const char *path, const uint16_t *heights, unsigned int width, unsigned int height,
+                    const TerrainLayout &layout) {
+    if (width < 2 || height < 2) {printf("Terrain %s needs at least 2 x 2 samples\n", path); return false;}
+    unsigned int size = TILE_QUADS, levelCount = 1;
+    while (size < std::max(width, height) - 1) {
+        size *= 2;
+        ++levelCount;
+    }
+    const Pyramid pyramid = {heights, width, height, size};
+
+    // chunk bounds: level 0 over its samples, every level above is the union of its four children
+    std::vector<size_t> firstBounds(levelCount);
+    size_t boundsCount = 0;
+    for (unsigned int level = 0; level < levelCount; ++level) {
+        firstBounds[level] = boundsCount;
+        size_t side = (size / CHUNK_QUADS) >> level;
+        boundsCount += side * side;
+    }
+    std::vector<uint16_t> bounds(boundsCount * 2);
+    const unsigned int baseChunks = size / CHUNK_QUADS;
+    JobSystem::parallelFor(baseChunks, 4, [&](unsigned int begin, unsigned int end) {
+        for (unsigned int y = begin; y < end; ++y) {
+            for (unsigned int x = 0; x < baseChunks; ++x) {
+                uint16_t low = 65535, high = 0;
+                for (unsigned int j = 0; j < GRID_SAMPLES; ++j) {
+                    for (unsigned int i = 0; i < GRID_SAMPLES; ++i) {
+                        uint16_t value = pyramid.at(0, int(x * CHUNK_QUADS + i), int(y * CHUNK_QUADS + j));
+                        low = std::min(low, value);
+                        high = std::max(high, value);
+                    }
+                }
+                bounds[(size_t(y) * baseChunks + x) * 2] = low;
+                bounds[(size_t(y) * baseChunks + x) * 2 + 1] = high;
+            }
+        }
+    });
+    for (unsigned int level = 1; level < levelCount; ++level) {
+        unsigned int side = baseChunks >> level;
+        for (unsigned int y = 0; y < side; ++y) {
+            for (unsigned int x = 0; x < side; ++x) {
+                uint16_t *node = &bounds[(firstBounds[level] + size_t(y) * side + x) * 2];
+                node[0] = 65535;
+                node[1] = 0;
+                for (unsigned int child = 0; child < 4; ++child) {
+                    const uint16_t *range = &bounds[(firstBounds[level - 1] + size_t(y * 2 + child / 2) * side * 2 +
+                                                     x * 2 + child % 2) * 2];
+                    node[0] = std::min(node[0], range[0]);
+                    node[1] = std::max(node[1], range[1]);
+                }
+            }
+        }
+    }
+
+    FILE *file = fopen(path, "wb");
+    if (!file) {printf("%s could not be created\n", path); return false;}
+    FileHeader header = {};
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.size = size;
+    header.levels = levelCount;
+    header.layout = layout;
+    bool written = fwrite(&header, 1, sizeof(header), file) == sizeof(header) &&
+                   fwrite(bounds.data(), sizeof(uint16_t), bounds.size(), file) == bounds.size();
+    size_t position = sizeof(header) + bounds.size() * sizeof(uint16_t);
+    const std::vector<unsigned char> padding((PAGE_SIZE - position % PAGE_SIZE) % PAGE_SIZE);
+    written = written && fwrite(padding.data(), 1, padding.size(), file) == padding.size();
+
+    // tiles, level by level and row by row, the tiles of a row are filled in parallel
+    std::vector<uint16_t> row(size_t(size / TILE_QUADS) * TILE_STRIDE / sizeof(uint16_t));
+    for (unsigned int level = 0; level < levelCount && written; ++level) {
+        unsigned int side = (size / TILE_QUADS) >> level;
+        for (unsigned int tileY = 0; tileY < side && written; ++tileY) {
+            JobSystem::parallelFor(side, 1, [&](unsigned int begin, unsigned int end) {
+                for (unsigned int tileX = begin; tileX < end; ++tileX) {
+                    uint16_t *tile = row.data() + tileX * (TILE_STRIDE / sizeof(uint16_t));
+                    // sample -1 to TILE_QUADS + 1: the shared edge and the apron around it
+                    for (unsigned int j = 0; j < TILE_SAMPLES; ++j) {
+                        for (unsigned int i = 0; i < TILE_SAMPLES; ++i) {
+                            tile[j * TILE_SAMPLES + i] = pyramid.at(level, int(tileX * TILE_QUADS + i) - 1,
+                                                                    int(tileY * TILE_QUADS + j) - 1);
+                        }
+                    }
+                }
+            });
+            written = fwrite(row.data(), TILE_STRIDE, side, file) == side;
+        }
+    }
+    written = fclose(file) == 0 && written;
+    if (!written) printf("%s could not be written\n", path);
+    return written;
+}
+
+void Terrain::fractalHeights(uint16_t *heights, unsigned int samples, unsigned int seed) {
+    unsigned int octaves = 1;
+    while (octaves < 10 && (16u << octaves) < samples) ++octaves;
+    JobSystem::parallelFor(samples, 16, [&](unsigned int begin, unsigned int end) {
+        for (unsigned int y = begin; y < end; ++y) {
+            for (unsigned int x = 0; x < samples; ++x) {
+                // ridged multifractal: sharp crests where the noise crosses zero, detail where the octave below is high
+                float frequency = 4.0f / float(samples), amplitude = 0.5f, weight = 1.0f, sum = 0.0f;
+                for (unsigned int octave = 0; octave < octaves; ++octave) {
+                    float noise = valueNoise(float(x) * frequency, float(y) * frequency, seed + octave);
+                    float ridge = 1.0f - std::fabs(noise);
+                    ridge *= ridge * weight;
+                    weight = std::min(ridge * 2.0f, 1.0f);
+                    sum += ridge * amplitude;
+                    frequency *= 2.0f;
+                    amplitude *= 0.5f;
+                }
+                heights[size_t(y) * samples + x] = uint16_t(std::clamp(sum, 0.0f, 1.0f) * 65535.0f);
+            }
+        }
+    });
+}
+
+bool Terrain::open(const char *path, unsigned int cacheTiles) {
+    destroy();
+    if (!file.open(path)) {printf("Terrain %s could not be opened\n", path); return false;}
+    FileHeader header;
+    if (file.size() < sizeof(FileHeader) || memcmp(file.data(), MAGIC, sizeof(MAGIC)) != 0) {
+        printf("%s is not a terrain file\n", path);
+        file.close();
+        return false;
+    }
+    memcpy(&header, file.data(), sizeof(header));
+    if (header.version != VERSION) {
+        printf("%s has unsupported terrain version %u, build it again\n", path, header.version);
+        file.close();
+        return false;
+    }
+    bool valid = header.levels >= 1 && header.levels <= 16 && header.size >= TILE_QUADS &&
+                 (header.size & (header.size - 1)) == 0 &&
+                 (TILE_QUADS << (header.levels - 1)) == header.size;
+    terrainSize = header.size;
+    levels = valid ? header.levels : 0;
+    levelBounds.resize(levels);
+    levelTiles.resize(levels);
+    levelNodes.resize(levels);
+    size_t chunkCount = 0;
+    uint32_t tileCount = 0;
+    for (unsigned int level = 0; level < levels; ++level) {
+        levelBounds[level] = chunkCount;
+        levelNodes[level] = chunkCount;
+        levelTiles[level] = tileCount;
+        chunkCount += size_t(chunksPerSide(level)) * chunksPerSide(level);
+        tileCount += tilesPerSide(level) * tilesPerSide(level);
+    }
+    size_t boundsEnd = sizeof(FileHeader) + chunkCount * 2 * sizeof(uint16_t);
+    tilesOffset = (boundsEnd + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+    if (!valid || file.size() < tilesOffset + size_t(tileCount) * TILE_STRIDE) {
+        printf("%s is corrupt\n", path);
+        destroy();
+        return false;
+    }
+    terrainLayout = header.layout;
+    bounds = reinterpret_cast<const uint16_t *>(file.data() + sizeof(FileHeader));
+
+    // the top level is a single tile, it stays in slot 0
+    slotCount = std::clamp(cacheTiles, 8u, 2048u);
+    slots.reset(new TileSlot[slotCount]);
+    tileSlots.assign(tileCount, -1);
+    slots[0].tile = levelTiles[levels - 1];
+    slots[0].pinned = true;
+    slots[0].state = SlotState::Resident;
+    loadTile(0);
+    tileSlots[slots[0].tile] = 0;
+
+    // selection state, sized for the largest budget so update() never grows it
+    nodeStates.assign(chunkCount, Unrefined);
+    heap.reserve(MAX_CHUNKS + ROOT_CHUNKS);
+    selection.reserve(MAX_CHUNKS + ROOT_CHUNKS);
+    touchedNodes.reserve(MAX_CHUNKS * 8);
+    requests.reserve(MAX_REQUESTS);
+    frame = 0;
+    return true;
+}
+
+bool Terrain::createProgram(const char *fragmentShader) {
+    if (!levels) {printf("No terrain is open\n"); return false;}
+    if (terrainProgram) glDeleteProgram(terrainProgram);
+    terrainProgram = LoadShaders("src/shaders/Terrain.vert", fragmentShader);
+    if (!terrainProgram) return false;
+    glUseProgram(terrainProgram);
+    viewProjectionID = glGetUniformLocation(terrainProgram, "viewProjection");
+    glUniform1i(glGetUniformLocation(terrainProgram, "heights"), HEIGHT_TEXTURE_UNIT);
+    glUniform3fv(glGetUniformLocation(terrainProgram, "origin"), 1, terrainLayout.origin);
+    glUniform1f(glGetUniformLocation(terrainProgram, "spacing"), terrainLayout.spacing);
+    glUniform1f(glGetUniformLocation(terrainProgram, "heightScale"), terrainLayout.heightScale);
+
+    if (!vertexArray) {
+        // the 16 stitch variants of the grid in one element buffer, the vertices come from gl_VertexID
+        std::vector<uint16_t> indices;
+        for (unsigned int stitch = 0; stitch < 16; ++stitch) {
+            indexOffsets[stitch] = unsigned(indices.size());
+            appendGrid(stitch, indices);
+            indexCounts[stitch] = unsigned(indices.size()) - indexOffsets[stitch];
+        }
+        GLint previousVertexArray = 0;
+        glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousVertexArray);
+        glGenVertexArrays(1, &vertexArray);
+        glBindVertexArray(vertexArray);
+        glGenBuffers(1, &indexBuffer);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, GLsizeiptr(indices.size() * sizeof(uint16_t)), indices.data(),
+                     GL_STATIC_DRAW);
+        // per chunk: node x, node y, level, tile layer
+        glEnableVertexAttribArray(0);
+        glVertexAttribDivisor(0, 1);
+        glBindVertexArray(GLuint(previousVertexArray));
+
+        GLint maxLayers = 256;
+        glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+        slotCount = std::min(slotCount, unsigned(maxLayers));
+        glGenTextures(1, &heightTexture);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, heightTexture);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_R16, TILE_SAMPLES, TILE_SAMPLES, GLsizei(slotCount), 0, GL_RED,
+                     GL_UNSIGNED_SHORT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        if (!instances.create(MAX_CHUNKS * 4 * sizeof(uint16_t))) {printf("Terrain can not be drawn\n"); return false;}
+    }
+    for (unsigned int slot = 0; slot < slotCount; ++slot) slots[slot].uploaded = false;
+    return true;
+}
+
+void Terrain::setTriangleBudget(unsigned int triangles) {
+    maxChunks = std::clamp(triangles / TRIANGLES_PER_CHUNK, 1u, MAX_CHUNKS);
+}
+
+uint32_t Terrain::tileIndex(unsigned int level, unsigned int chunkX, unsigned int chunkY) const {
+    return levelTiles[level] + chunkY / CHUNKS_PER_TILE * tilesPerSide(level) + chunkX / CHUNKS_PER_TILE;
+}
+
+const uint16_t *Terrain::tileData(uint32_t tile) const {
+    return reinterpret_cast<const uint16_t *>(file.data() + tilesOffset + size_t(tile) * TILE_STRIDE);
+}
+
+void Terrain::nodeBounds(unsigned int level, unsigned int x, unsigned int y, float boundsMin[3],
+                         float boundsMax[3]) const {
+    const uint16_t *range = bounds + (levelBounds[level] + size_t(y) * chunksPerSide(level) + x) * 2;
+    float extent = terrainLayout.spacing * float(CHUNK_QUADS << level);
+    const float *origin = terrainLayout.origin;
+    boundsMin[0] = origin[0] + float(x) * extent;
+    boundsMin[1] = origin[1] + float(range[0]) * (terrainLayout.heightScale / 65535.0f);
+    boundsMin[2] = origin[2] + float(y) * extent;
+    boundsMax[0] = boundsMin[0] + extent;
+    boundsMax[1] = origin[1] + float(range[1]) * (terrainLayout.heightScale / 65535.0f);
+    boundsMax[2] = boundsMin[2] + extent;
+}
+
+bool Terrain::makeCandidate(unsigned int level, unsigned int x, unsigned int y, bool parentInside,
+                            const float cameraPosition[3], Candidate &candidate) const {
+    float boundsMin[3], boundsMax[3];
+    nodeBounds(level, x, y, boundsMin, boundsMax);
+    bool inside = true;
+    if (!parentInside) {
+        for (const float *plane : planes) {
+            // corner farthest along the plane normal decides outside, the nearest one inside
+            float farthest = plane[3], nearest = plane[3];
+            for (int axis = 0; axis < 3; ++axis) {
+                farthest += plane[axis] * (plane[axis] > 0.0f ? boundsMax[axis] : boundsMin[axis]);
+                nearest += plane[axis] * (plane[axis] > 0.0f ? boundsMin[axis] : boundsMax[axis]);
+            }
+            if (farthest < 0.0f) return false;
+            inside = inside && nearest >= 0.0f;
+        }
+    }
+    float squared = 0.0f;
+    for (int axis = 0; axis < 3; ++axis) {
+        float outside = std::max({boundsMin[axis] - cameraPosition[axis], cameraPosition[axis] - boundsMax[axis],
+                                  0.0f});
+        squared += outside * outside;
+    }
+    float extent = boundsMax[0] - boundsMin[0];
+    candidate.priority = extent / std::max(std::sqrt(squared), extent * 1e-3f);
+    candidate.x = uint16_t(x);
+    candidate.y = uint16_t(y);
+    candidate.level = uint8_t(level);
+    candidate.inside = inside;
+    return true;
+}
+
+bool Terrain::neighbourResolved(unsigned int level, int x, int y) const {
+    auto side = int(chunksPerSide(level));
+    if (x < 0 || y < 0 || x >= side || y >= side) return true;
+    // the node exists if its parent was split, it does not matter if an ancestor was culled
+    for (unsigned int ancestor = level + 1; ancestor < levels; ++ancestor) {
+        unsigned int shift = ancestor - level;
+        uint8_t state = nodeStates[nodeIndex(ancestor, unsigned(x) >> shift, unsigned(y) >> shift)];
+        if (state == Culled) return true;
+        if (state == Refined) return ancestor == level + 1;
+    }
+    return level + 1 == levels;
+}
+
+void Terrain::markNode(unsigned int level, unsigned int x, unsigned int y, uint8_t state) {
+    size_t index = nodeIndex(level, x, y);
+    nodeStates[index] = state;
+    touchedNodes.push_back(uint32_t(index));
+}
+
+void Terrain::update(const float viewProjection[16], const float cameraPosition[3]) {
+    if (!levels) return;
+    ++frame;
+    finishLoads();
+
+    // Gribb/Hartmann: the planes are sums and differences of the fourth row with the other rows
+    for (int i = 0; i < 3; ++i) {
+        for (int k = 0; k < 4; ++k) {
+            float row = viewProjection[k * 4 + i], w = viewProjection[k * 4 + 3];
+            planes[i * 2][k] = w + row;
+            planes[i * 2 + 1][k] = w - row;
+        }
+    }
+    for (float *plane : planes) {
+        float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+        if (length > 0.0f) for (int k = 0; k < 4; ++k) plane[k] /= length;
+    }
+
+    for (uint32_t node : touchedNodes) nodeStates[node] = Unrefined;
+    touchedNodes.clear();
+    heap.clear();
+    selection.clear();
+    requests.clear();
+    frameStats = {};
+
+    auto lowerPriority = [](const Candidate &a, const Candidate &b) { return a.priority < b.priority; };
+    const unsigned int top = levels - 1;
+    for (unsigned int y = 0; y < CHUNKS_PER_TILE; ++y) {
+        for (unsigned int x = 0; x < CHUNKS_PER_TILE; ++x) {
+            Candidate root;
+            if (makeCandidate(top, x, y, false, cameraPosition, root)) heap.push_back(root);
+            else {
+                markNode(top, x, y, Culled);
+                ++frameStats.culledNodes;
+            }
+        }
+    }
+    std::make_heap(heap.begin(), heap.end(), lowerPriority);
+
+    // split the most important node until nothing is close enough or the budget is spent
+    const unsigned int budget = std::max(maxChunks, unsigned(heap.size()));
+    unsigned int count = unsigned(heap.size());
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), lowerPriority);
+        const Candidate node = heap.back();
+        heap.pop_back();
+        const unsigned int level = node.level, x = node.x, y = node.y;
+
+        bool split = level > 0 && node.priority * lodDistance > 1.0f;
+        if (split) {
+            uint32_t childTile = tileIndex(level - 1, x * 2, y * 2);
+            int32_t slot = tileSlots[childTile];
+            if (slot < 0 || slots[slot].state != SlotState::Resident) {
+                if (slot < 0 && requests.size() < MAX_REQUESTS) requests.push_back(childTile);
+                ++frameStats.waitingNodes;
+                split = false;
+            }
+        }
+        // restricted quadtree: the neighbours must exist, so the children end up at most one level finer than them
+        split = split && neighbourResolved(level, int(x) - 1, int(y)) && neighbourResolved(level, int(x) + 1, int(y)) &&
+                neighbourResolved(level, int(x), int(y) - 1) && neighbourResolved(level, int(x), int(y) + 1);
+        Candidate children[4];
+        bool visible[4] = {};
+        unsigned int visibleCount = 0;
+        if (split) {
+            for (unsigned int child = 0; child < 4; ++child) {
+                visible[child] = makeCandidate(level - 1, x * 2 + child % 2, y * 2 + child / 2, node.inside,
+                                               cameraPosition, children[child]);
+                visibleCount += visible[child];
+            }
+            split = count - 1 + visibleCount <= budget;
+        }
+
+        if (split) {
+            markNode(level, x, y, Refined);
+            for (unsigned int child = 0; child < 4; ++child) {
+                if (visible[child]) {
+                    heap.push_back(children[child]);
+                    std::push_heap(heap.begin(), heap.end(), lowerPriority);
+                } else {
+                    markNode(level - 1, x * 2 + child % 2, y * 2 + child / 2, Culled);
+                    ++frameStats.culledNodes;
+                }
+            }
+            count = count - 1 + visibleCount;
+            continue;
+        }
+        TileSlot &slot = slots[tileSlots[tileIndex(level, x, y)]];
+        slot.lastUsed = frame;
+        selection.push_back({uint16_t(x), uint16_t(y), uint8_t(level), 0,
+                             uint16_t(&slot - slots.get())});
+    }
+
+    // a missing neighbour is one level coarser, the edge towards it skips every other vertex
+    for (TerrainChunk &chunk : selection) {
+        int x = chunk.x, y = chunk.y;
+        chunk.stitch = uint8_t((neighbourResolved(chunk.level, x - 1, y) ? 0 : 1) |
+                               (neighbourResolved(chunk.level, x + 1, y) ? 0 : 2) |
+                               (neighbourResolved(chunk.level, x, y - 1) ? 0 : 4) |
+                               (neighbourResolved(chunk.level, x, y + 1) ? 0 : 8));
+        frameStats.triangles += TRIANGLES_PER_CHUNK - unsigned(std::popcount(chunk.stitch)) * CHUNK_QUADS / 2;
+    }
+    frameStats.chunks = unsigned(selection.size());
+
+    startLoads();
+    for (unsigned int slot = 0; slot < slotCount; ++slot) {
+        frameStats.residentTiles += slots[slot].state == SlotState::Resident;
+        frameStats.loadingTiles += slots[slot].state == SlotState::Loading;
+    }
+}
+
+void Terrain::finishLoads() {
+    for (unsigned int slot = 0; slot < slotCount; ++slot) {
+        TileSlot &tile = slots[slot];
+        if (tile.state != SlotState::Loading || tile.loaded.pending.load(std::memory_order_acquire) != 0) continue;
+        tile.state = SlotState::Resident;
+        tile.uploaded = false;
+    }
+}
+
+void Terrain::startLoads() {
+    unsigned int loading = 0;
+    for (unsigned int slot = 0; slot < slotCount; ++slot) loading += slots[slot].state == SlotState::Loading;
+    for (uint32_t tile : requests) {
+        if (loading >= MAX_LOADS) break;
+        if (tileSlots[tile] >= 0) continue; // requested by another node
+        // an empty slot, otherwise the least recently used one the selection of this frame does not draw from
+        int victim = -1;
+        for (unsigned int slot = 0; slot < slotCount; ++slot) {
+            const TileSlot &candidate = slots[slot];
+            if (candidate.pinned || candidate.state == SlotState::Loading) continue;
+            if (candidate.state == SlotState::Empty) {
+                victim = int(slot);
+                break;
+            }
+            bool older = victim < 0 || candidate.lastUsed < slots[victim].lastUsed;
+            if (candidate.lastUsed < frame && older) victim = int(slot);
+        }
+        if (victim < 0) break;
+        TileSlot &slot = slots[victim];
+        if (slot.state == SlotState::Resident) tileSlots[slot.tile] = -1;
+        slot.tile = tile;
+        slot.state = SlotState::Loading;
+        slot.uploaded = false;
+        slot.lastUsed = frame;
+        tileSlots[tile] = victim;
+        ++loading;
+        // the job only faults the pages in, the upload reads them straight from the mapping
+        JobSystem::submit([this, victim] { loadTile(uint32_t(victim)); }, &slot.loaded);
+    }
+}
+
+void Terrain::loadTile(uint32_t slot) const {
+    const volatile unsigned char *data = file.data() + tilesOffset + size_t(slots[slot].tile) * TILE_STRIDE;
+    unsigned int sum = 0;
+    for (size_t offset = 0; offset < TILE_BYTES; offset += PAGE_SIZE) sum += data[offset];
+    (void) sum;
+}
+
+void Terrain::draw(const float viewProjection[16]) {
+    if (!terrainProgram || !vertexArray || selection.empty()) return;
+    GLint previousVertexArray = 0, unpackAlignment = 4;
+    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousVertexArray);
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpackAlignment);
+
+    // tiles that finished streaming since the last draw, the rows of a tile are 2 byte aligned
+    glActiveTexture(GL_TEXTURE0 + HEIGHT_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, heightTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+    for (unsigned int slot = 0; slot < slotCount; ++slot) {
+        TileSlot &tile = slots[slot];
+        if (tile.state != SlotState::Resident || tile.uploaded) continue;
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, GLint(slot), TILE_SAMPLES, TILE_SAMPLES, 1, GL_RED,
+                        GL_UNSIGNED_SHORT, tileData(tile.tile));
+        tile.uploaded = true;
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, unpackAlignment);
+    glActiveTexture(GL_TEXTURE0);
+
+    // instances grouped by their stitched edges, one instanced draw per group
+    unsigned int first[17] = {};
+    for (const TerrainChunk &chunk : selection) ++first[chunk.stitch + 1];
+    for (unsigned int stitch = 0; stitch < 16; ++stitch) first[stitch + 1] += first[stitch];
+    instances.beginFrame();
+    StreamBuffer::Allocation allocation = instances.allocate(selection.size() * 4 * sizeof(uint16_t));
+    if (allocation.data) {
+        auto *data = static_cast<uint16_t *>(allocation.data);
+        unsigned int next[16];
+        std::copy(first, first + 16, next);
+        for (const TerrainChunk &chunk : selection) {
+            uint16_t *instance = data + size_t(next[chunk.stitch]++) * 4;
+            instance[0] = chunk.x;
+            instance[1] = chunk.y;
+            instance[2] = chunk.level;
+            instance[3] = chunk.layer;
+        }
+        instances.flush();
+
+        glUseProgram(terrainProgram);
+        glUniformMatrix4fv(viewProjectionID, 1, GL_FALSE, viewProjection);
+        glBindVertexArray(vertexArray);
+        glBindBuffer(GL_ARRAY_BUFFER, instances.buffer());
+        for (unsigned int stitch = 0; stitch < 16; ++stitch) {
+            GLsizei count = GLsizei(first[stitch + 1] - first[stitch]);
+            if (!count) continue;
+            glVertexAttribIPointer(0, 4, GL_UNSIGNED_SHORT, 4 * sizeof(uint16_t),
+                                   reinterpret_cast<void *>(allocation.offset + GLintptr(first[stitch]) * 8));
+            glDrawElementsInstanced(GL_TRIANGLES, GLsizei(indexCounts[stitch]), GL_UNSIGNED_SHORT,
+                                    reinterpret_cast<void *>(size_t(indexOffsets[stitch]) * sizeof(uint16_t)), count);
+        }
+        glBindVertexArray(GLuint(previousVertexArray));
+    }
+    instances.endFrame();
+}
+
+uint16_t Terrain::sample(unsigned int level, unsigned int x, unsigned int y) const {
+    unsigned int last = terrainSize >> level, tiles = tilesPerSide(level);
+    x = std::min(x, last);
+    y = std::min(y, last);
+    unsigned int tileX = std::min(x / TILE_QUADS, tiles - 1), tileY = std::min(y / TILE_QUADS, tiles - 1);
+    const uint16_t *tile = tileData(levelTiles[level] + tileY * tiles + tileX);
+    return tile[(y - tileY * TILE_QUADS + 1) * TILE_SAMPLES + x - tileX * TILE_QUADS + 1];
+}
+
+uint16_t Terrain::vertexHeight(const TerrainChunk &chunk, unsigned int gridX, unsigned int gridY) const {
+    const uint16_t *tile = tileData(tileIndex(chunk.level, chunk.x, chunk.y));
+    unsigned int texelX = chunk.x % CHUNKS_PER_TILE * CHUNK_QUADS + gridX + 1;
+    unsigned int texelY = chunk.y % CHUNKS_PER_TILE * CHUNK_QUADS + gridY + 1;
+    return tile[texelY * TILE_SAMPLES + texelX];
+}
+
+float Terrain::heightAt(float x, float z) const {
+    if (!levels) return 0.0f;
+    float sampleX = std::clamp((x - terrainLayout.origin[0]) / terrainLayout.spacing, 0.0f, float(terrainSize));
+    float sampleZ = std::clamp((z - terrainLayout.origin[2]) / terrainLayout.spacing, 0.0f, float(terrainSize));
+    auto ix = std::min(unsigned(sampleX), terrainSize - 1), iz = std::min(unsigned(sampleZ), terrainSize - 1);
+    float tx = sampleX - float(ix), tz = sampleZ - float(iz);
+    float a = sample(0, ix, iz), b = sample(0, ix + 1, iz), c = sample(0, ix, iz + 1), d = sample(0, ix + 1, iz + 1);
+    float raw = (a + (b - a) * tx) * (1.0f - tz) + (c + (d - c) * tx) * tz;
+    return terrainLayout.origin[1] + raw * (terrainLayout.heightScale / 65535.0f);
+}
+
+void Terrain::destroy() {
+    // loads in flight read the mapping
+    for (unsigned int slot = 0; slot < slotCount; ++slot) JobSystem::wait(slots[slot].loaded);
+    if (terrainProgram) glDeleteProgram(terrainProgram);
+    terrainProgram = 0;
+    if (heightTexture) glDeleteTextures(1, &heightTexture);
+    heightTexture = 0;
+    if (indexBuffer) glDeleteBuffers(1, &indexBuffer);
+    indexBuffer = 0;
+    if (vertexArray) glDeleteVertexArrays(1, &vertexArray);
+    vertexArray = 0;
+    instances.destroy();
+    slots.reset();
+    slotCount = 0;
+    tileSlots.clear();
+    nodeStates.clear();
+    touchedNodes.clear();
+    selection.clear();
+    bounds = nullptr;
+    levels = 0;
+    terrainSize = 0;
+    file.close();
+}
@@ -0,0 +1,203 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#ifndef TERRAIN_H
+#define TERRAIN_H
+#include <glad/gl.h>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "JobSystem.hpp"
+#include "MappedFile.hpp"
+#include "StreamBuffer.hpp"
+
+
+/** Placement of a heightfield in the world */
+struct TerrainLayout {
+    float origin[3] = {0, 0, 0};    // world position of sample (0, 0) at the raw height 0
+    float spacing = 1.0f;           // distance between neighbouring samples
+    float heightScale = 1000.0f;    // world height of the raw height 65535
+};
+
+/** Chunk of the last selection: a quadtree node drawn with the shared grid */
+struct TerrainChunk {
+    uint16_t x, y;                  // node position in the chunk grid of its level
+    uint8_t level;                  // 0 is full resolution, every level doubles the size of the chunk
+    uint8_t stitch;                 // edges bordering the next coarser level: 1 -x, 2 +x, 4 -z, 8 +z
+    uint16_t layer;                 // tile cache slot holding the heights
+};
+
+/** Counters of the last update() */
+struct TerrainStats {
+    unsigned int chunks = 0, triangles = 0;
+    unsigned int culledNodes = 0;   // nodes outside the frustum, their subtrees were skipped
+    unsigned int residentTiles = 0, loadingTiles = 0;
+    unsigned int waitingNodes = 0;  // nodes not split because the tile of their children is still streaming
+};
+
+/** Chunked heightmap terrain with a quadtree level of detail
+ *
+ *  The .terrain file holds a pyramid of levels, each one decimated by two from the one below (every other sample, so
+ *  the samples a coarse chunk shares with a fine one have the same height). Every level is cut into tiles of
+ *  TILE_QUADS x TILE_QUADS quads, stored with a one sample apron for the normals and padded to whole pages, plus the
+ *  height bounds of every chunk of every level. The file is memory mapped, a tile is streamed in by a job that touches
+ *  its pages and then uploaded into a slot of an R16 texture array. Slots are recycled least recently used first, the
+ *  tiles of the top level stay resident.
+ *
+ *  update() selects the chunks of a frame: starting from the chunks of the top level, the node with the highest
+ *  priority (size over distance to the camera) is split into its four children while it is closer than lodDistance
+ *  times its size, its children's tile is resident and the triangle budget allows it. Nodes outside the frustum are
+ *  culled with their subtree. A node is only split if its neighbours on the same level exist, so neighbouring chunks
+ *  differ by at most one level and the finer one stitches its edge: every chunk is drawn with one of 16 index ranges
+ *  of a shared element buffer that leave out the odd vertices of the edges bordering a coarser chunk.
+ *
+ *  Per frame: update() with the camera, draw() inside a pass with the scene's depth. Neither allocates.
+ */
+class Terrain {
+public:
+    static constexpr unsigned int CHUNK_QUADS = 32;
+    static constexpr unsigned int TILE_QUADS = 256;
+    static constexpr unsigned int TILE_SAMPLES = TILE_QUADS + 3;
+    static constexpr unsigned int TRIANGLES_PER_CHUNK = CHUNK_QUADS * CHUNK_QUADS * 2;
+    /** Upper bound of the triangle budget in chunks */
+    static constexpr unsigned int MAX_CHUNKS = 4096;
+    /** Texture unit of the tile texture array */
+    static constexpr GLint HEIGHT_TEXTURE_UNIT = 9;
+
+    Terrain() = default;
+    Terrain(const Terrain &) = delete;
+    Terrain &operator=(const Terrain &) = delete;
+    ~Terrain();
+
+    /** Writes a .terrain file of a heightfield
+     *
+     *  The terrain is square with a power of two number of quads per side (at least TILE_QUADS), smaller heightfields
+     *  repeat their last row and column.
+     *
+     *  @param[in] heights width * height raw heights, rows along x
+     *  @returns false if the file can not be written
+     */
+    static bool build(const char *path, const uint16_t *heights, unsigned int width, unsigned int height,
+                      const TerrainLayout &layout);
+
+    /** Fills a samples x samples heightfield with ridged fractal noise, for demos and benchmarks */
+    static void fractalHeights(uint16_t *heights, unsigned int samples, unsigned int seed);
+
+    /** Maps a .terrain file and loads the tiles of the top level
+     *
+     *  @param[in] cacheTiles Slots of the tile cache, 134 KB of texture memory each
+     *  @returns false if the file can not be mapped or is not a .terrain file
+     */
+    bool open(const char *path, unsigned int cacheTiles = 256);
+
+    /** Creates the program (Terrain.vert with the given fragment shader), the shared grid and the tile texture array
+     *
+     *  @note Call after open(), the program gets the layout of the file
+     *  @returns false if no terrain is open or the program does not link
+     */
+    bool createProgram(const char *fragmentShader);
+    /** @returns The program, for the uniforms of the fragment shader */
+    GLuint program() const { return terrainProgram; }
+
+    /** Triangles of a selection at most, rounded down to whole chunks (the top level chunks are always drawn) */
+    void setTriangleBudget(unsigned int triangles);
+    /** Nodes closer than distance times their size are split */
+    void setLodDistance(float distance) { lodDistance = distance; }
+
+    /** Selects the chunks of a frame and starts streaming the tiles it is missing
+     *
+     *  @param[in] viewProjection Column major projection * view matrix of the camera
+     */
+    void update(const float viewProjection[16], const float cameraPosition[3]);
+
+    /** Uploads the tiles that finished streaming and draws the chunks of the last update() */
+    void draw(const float viewProjection[16]);
+
+    /** @returns World height at a position, bilinear between the samples of level 0, reads the mapping */
+    float heightAt(float x, float z) const;
+    /** @returns Raw height of a sample of a level, reads the mapping */
+    uint16_t sample(unsigned int level, unsigned int x, unsigned int y) const;
+    /** @returns Raw height of a grid vertex (0 to CHUNK_QUADS) of a selected chunk, from its tile like Terrain.vert */
+    uint16_t vertexHeight(const TerrainChunk &chunk, unsigned int gridX, unsigned int gridY) const;
+
+    const std::vector<TerrainChunk> &chunks() const { return selection; }
+    const TerrainStats &stats() const { return frameStats; }
+    const TerrainLayout &layout() const { return terrainLayout; }
+    /** @returns Quads per side of level 0 */
+    unsigned int size() const { return terrainSize; }
+    unsigned int levelCount() const { return levels; }
+
+    void destroy();
+
+private:
+    enum class SlotState : uint8_t { Empty, Loading, Resident };
+    struct TileSlot {
+        uint32_t tile = 0;              // index of the tile in the file, all levels counted
+        uint32_t lastUsed = 0;          // frame of the last selection drawing from it
+        SlotState state = SlotState::Empty;
+        bool uploaded = false;
+        bool pinned = false;
+        JobCounter loaded;
+    };
+    struct Candidate {
+        float priority;
+        uint16_t x, y;
+        uint8_t level;
+        bool inside;                    // completely inside the frustum, the children skip the test
+    };
+
+    unsigned int chunksPerSide(unsigned int level) const { return (terrainSize / CHUNK_QUADS) >> level; }
+    unsigned int tilesPerSide(unsigned int level) const { return (terrainSize / TILE_QUADS) >> level; }
+    uint32_t tileIndex(unsigned int level, unsigned int chunkX, unsigned int chunkY) const;
+    const uint16_t *tileData(uint32_t tile) const;
+    void nodeBounds(unsigned int level, unsigned int x, unsigned int y, float boundsMin[3], float boundsMax[3]) const;
+    bool makeCandidate(unsigned int level, unsigned int x, unsigned int y, bool parentInside,
+                       const float cameraPosition[3], Candidate &candidate) const;
+    bool neighbourResolved(unsigned int level, int x, int y) const;
+    size_t nodeIndex(unsigned int level, unsigned int x, unsigned int y) const {
+        return levelNodes[level] + size_t(y) * chunksPerSide(level) + x;
+    }
+    void markNode(unsigned int level, unsigned int x, unsigned int y, uint8_t state);
+    void finishLoads();
+    void startLoads();
+    void loadTile(uint32_t slot) const;
+
+    MappedFile file;
+    TerrainLayout terrainLayout;
+    unsigned int terrainSize = 0, levels = 0;
+    std::vector<size_t> levelBounds;    // index of the first chunk bounds of every level
+    std::vector<uint32_t> levelTiles;   // index of the first tile of every level
+    const uint16_t *bounds = nullptr;   // min and max raw height per chunk, in the mapping
+    size_t tilesOffset = 0;
+
+    // tile cache
+    std::unique_ptr<TileSlot[]> slots;
+    unsigned int slotCount = 0;
+    std::vector<int32_t> tileSlots;     // slot of every tile, -1 if not cached
+    std::vector<uint32_t> requests;    // tiles the selection is waiting for, highest priority first
+
+    // selection
+    float planes[6][4] = {};
+    unsigned int maxChunks = 512;
+    float lodDistance = 2.5f;
+    uint32_t frame = 0;
+    std::vector<Candidate> heap;
+    std::vector<uint8_t> nodeStates;    // Refined or Culled per node of every level, reset after every selection
+    std::vector<size_t> levelNodes;     // index of the first node state of every level
+    std::vector<uint32_t> touchedNodes;
+    std::vector<TerrainChunk> selection;
+    TerrainStats frameStats;
+
+    // drawing
+    GLuint terrainProgram = 0, heightTexture = 0, indexBuffer = 0, vertexArray = 0;
+    GLint viewProjectionID = -1;
+    unsigned int indexCounts[16] = {}, indexOffsets[16] = {};
+    StreamBuffer instances;
+};
+
+
+
+#endif //TERRAIN_H
@@ -0,0 +1,119 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#include "TextureArrayPool.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "TextureDecoder.hpp"
+
+TextureArrayPool::TextureArrayPool(unsigned int layersPerArray) : layersPerArray(std::max(layersPerArray, 1u)) {
+}
+
+TextureArrayPool::~TextureArrayPool() {
+    for (const Array &array : arrays) glDeleteTextures(1, &array.texture);
+}
+
+TextureArrayPool::Array &TextureArrayPool::findArray(GLenum format, unsigned int width, unsigned int height,
+                                                     unsigned int levels, bool compressed, unsigned int blockSize) {
+    for (Array &array : arrays) {
+        if (array.format == format && array.width == width && array.height == height && array.levels == levels &&
+            array.usedLayers < layersPerArray)
+            return array;
+    }
+
+    Array array;
+    array.format = format;
+    array.width = width;
+    array.height = height;
+    array.levels = levels;
+    glGenTextures(1, &array.texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, array.texture);
+
+    // allocate every level of every layer, layers are filled with glTex(Compressed)SubImage3D
+    for (unsigned int level = 0; level < levels; ++level) {
+        GLsizei levelWidth = GLsizei(std::max(width >> level, 1u));
+        GLsizei levelHeight = GLsizei(std::max(height >> level, 1u));
+        if (compressed) {
+            GLsizei size = GLsizei(((levelWidth + 3) / 4) * ((levelHeight + 3) / 4) * blockSize * layersPerArray);
+            glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, format, levelWidth, levelHeight, layersPerArray, 0, size, nullptr);
+        } else {
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, level, format, levelWidth, levelHeight, layersPerArray, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        }
+    }
+
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels - 1);
+
+    arrays.push_back(array);
+    return arrays.back();
+}
+
+TextureArrayPool::Entry TextureArrayPool::add(const Image &image) {
+    unsigned int levels = 1;
+    while ((std::max(image.width, image.height) >> levels) != 0) ++levels;
+
+    Array &array = findArray(GL_RGBA8, image.width, image.height, levels, false, 0);
+    Entry entry{array.texture, array.usedLayers++};
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, array.texture);
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, entry.layer, image.width, image.height, 1, GL_RGBA, GL_UNSIGNED_BYTE,
+                    image.pixels.data());
+    array.dirty = true;
+    return entry;
+}
+
+TextureArrayPool::Entry TextureArrayPool::add(const CompressedImage &image) {
+    // without S3TC support the layers are stored decoded
+    if (TextureDecoder::isS3TC(image.format) && !Textures::hasS3TC()) {
+        Image decoded;
+        decoded.width = image.width;
+        decoded.height = image.height;
+        decoded.pixels.resize(size_t(image.width) * image.height * 4);
+        TextureDecoder::decode(image.format, image.data.data(), image.width, image.height, decoded.pixels.data());
+        return add(decoded);
+    }
+
+    Array &array = findArray(image.format, image.width, image.height, image.mipMapCount, true, image.blockSize);
+    Entry entry{array.texture, array.usedLayers++};
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, array.texture);
+    size_t offset = 0;
+    for (unsigned int level = 0; level < image.mipMapCount; ++level) {
+        GLsizei levelWidth = GLsizei(std::max(image.width >> level, 1u));
+        GLsizei levelHeight = GLsizei(std::max(image.height >> level, 1u));
+        GLsizei size = GLsizei(image.levelSize(level));
+        glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, entry.layer, levelWidth, levelHeight, 1, image.format,
+                                  size, image.data.data() + offset);
+        offset += size;
+    }
+    return entry;
+}
+
+TextureArrayPool::Entry TextureArrayPool::load(const char *filename) {
+    size_t length = strlen(filename);
+    bool dds = length > 4 && (strcmp(filename + length - 4, ".DDS") == 0 || strcmp(filename + length - 4, ".dds") == 0);
+    if (dds) {
+        CompressedImage image;
+        if (!Textures::decodeDDS(filename, image)) return {};
+        return add(image);
+    }
+
+    Image image;
+    if (!Textures::decodeBMP(filename, image)) return {};
+    return add(image);
+}
+
+void TextureArrayPool::generateMipmaps() {
+    for (Array &array : arrays) {
+        if (!array.dirty) continue;
+        glBindTexture(GL_TEXTURE_2D_ARRAY, array.texture);
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+        array.dirty = false;
+    }
+}
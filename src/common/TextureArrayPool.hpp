@@ -0,0 +1,62 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#ifndef TEXTUREARRAYPOOL_H
+#define TEXTUREARRAYPOOL_H
+#include <glad/gl.h>
+#include <vector>
+
+#include "Textures.hpp"
+
+
+/** Collects textures of equal size and format into GL_TEXTURE_2D_ARRAY objects
+ *
+ *  Objects sharing an array can be drawn in one instanced call, the layer is passed per instance
+ *  (see TextureArrayShader.vert). A new array is started once an array reaches its layer capacity.
+ */
+class TextureArrayPool {
+public:
+    /** Location of a texture inside the pool */
+    struct Entry {
+        GLuint texture = 0; // GL_TEXTURE_2D_ARRAY object
+        unsigned int layer = 0;
+    };
+
+    /** @param[in] layersPerArray Layer capacity of every array, the storage of all layers is allocated up front */
+    explicit TextureArrayPool(unsigned int layersPerArray = 16);
+    TextureArrayPool(const TextureArrayPool &) = delete;
+    TextureArrayPool &operator=(const TextureArrayPool &) = delete;
+    ~TextureArrayPool();
+
+    /** Adds an RGBA8 image, mipmaps are built by generateMipmaps() */
+    Entry add(const Image &image);
+    /** Adds a block compressed image (e.g. from Textures::decodeDDS) including all of its mip levels */
+    Entry add(const CompressedImage &image);
+    /** Loads a .BMP or .DDS file (picked by extension) into the pool, texture is 0 on failure */
+    Entry load(const char *filename);
+
+    /** Rebuilds the mip chains of arrays that received uncompressed layers since the last call */
+    void generateMipmaps();
+
+    unsigned int arrayCount() const { return static_cast<unsigned int>(arrays.size()); }
+
+private:
+    struct Array {
+        GLuint texture = 0;
+        GLenum format = 0; // internal format
+        unsigned int width = 0, height = 0, levels = 0;
+        unsigned int usedLayers = 0;
+        bool dirty = false;
+    };
+
+    Array &findArray(GLenum format, unsigned int width, unsigned int height, unsigned int levels, bool compressed,
+                     unsigned int blockSize);
+
+    unsigned int layersPerArray;
+    std::vector<Array> arrays;
+};
+
+
+
+#endif //TEXTUREARRAYPOOL_H
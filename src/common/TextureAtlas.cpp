@@ -0,0 +1,134 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#include "TextureAtlas.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+TextureAtlas::TextureAtlas(unsigned int width, unsigned int height, unsigned int padding, unsigned int alignment)
+    : padding(padding), alignment(std::max(alignment, 1u)) {
+    atlas.width = width;
+    atlas.height = height;
+    atlas.pixels.assign(size_t(width) * height * 4, 0);
+    skyline.push_back({0, 0, width});
+}
+
+bool TextureAtlas::findPosition(unsigned int width, unsigned int height, unsigned int &x, unsigned int &y,
+                                size_t &segment) const {
+    unsigned int bestTop = UINT_MAX, bestX = UINT_MAX;
+    for (size_t i = 0; i < skyline.size(); ++i) {
+        unsigned int candidateX = skyline[i].x;
+        if (candidateX + width > atlas.width) break; // segments are sorted by x
+
+        // the slot rests on the highest segment below its span
+        unsigned int candidateY = 0, widthLeft = width;
+        for (size_t j = i; widthLeft > 0; ++j) {
+            candidateY = std::max(candidateY, skyline[j].y);
+            if (skyline[j].width >= widthLeft) break;
+            widthLeft -= skyline[j].width;
+        }
+        if (candidateY + height > atlas.height) continue;
+
+        // bottom left rule: lowest top edge first, then leftmost
+        unsigned int top = candidateY + height;
+        if (top < bestTop || (top == bestTop && candidateX < bestX)) {
+            bestTop = top;
+            bestX = candidateX;
+            x = candidateX;
+            y = candidateY;
+            segment = i;
+        }
+    }
+    return bestTop != UINT_MAX;
+}
+
+void TextureAtlas::insertSegment(size_t index, unsigned int x, unsigned int y, unsigned int width,
+                                 unsigned int height) {
+    skyline.insert(skyline.begin() + index, {x, y + height, width});
+
+    // cut away the part of the following segments now covered by the slot
+    size_t next = index + 1;
+    while (next < skyline.size() && skyline[next].x < x + width) {
+        unsigned int overlap = x + width - skyline[next].x;
+        if (skyline[next].width <= overlap) {
+            skyline.erase(skyline.begin() + next);
+        } else {
+            skyline[next].x += overlap;
+            skyline[next].width -= overlap;
+            break;
+        }
+    }
+
+    // merge neighbours of equal height
+    for (size_t i = 0; i + 1 < skyline.size();) {
+        if (skyline[i].y == skyline[i + 1].y) {
+            skyline[i].width += skyline[i + 1].width;
+            skyline.erase(skyline.begin() + i + 1);
+        } else {
+            ++i;
+        }
+    }
+}
+
+bool TextureAtlas::add(const Image &image, Region &region) {
+    if (image.width == 0 || image.height == 0) return false;
+
+    unsigned int slotWidth = (image.width + 2 * padding + alignment - 1) / alignment * alignment;
+    unsigned int slotHeight = (image.height + 2 * padding + alignment - 1) / alignment * alignment;
+    unsigned int slotX, slotY;
+    size_t segment;
+    if (!findPosition(slotWidth, slotHeight, slotX, slotY, segment)) return false;
+    insertSegment(segment, slotX, slotY, slotWidth, slotHeight);
+    usedArea += (unsigned long long)slotWidth * slotHeight;
+
+    // copy the image and extrude its edges into the whole slot
+    for (unsigned int y = 0; y < slotHeight; ++y) {
+        unsigned int sourceY = unsigned(std::clamp(int(y) - int(padding), 0, int(image.height) - 1));
+        unsigned char *target = &atlas.pixels[(size_t(slotY + y) * atlas.width + slotX) * 4];
+        const unsigned char *sourceRow = &image.pixels[size_t(sourceY) * image.width * 4];
+        for (unsigned int x = 0; x < slotWidth; ++x) {
+            unsigned int sourceX = unsigned(std::clamp(int(x) - int(padding), 0, int(image.width) - 1));
+            memcpy(target + x * 4, sourceRow + sourceX * 4, 4);
+        }
+    }
+
+    region.x = slotX + padding;
+    region.y = slotY + padding;
+    region.width = image.width;
+    region.height = image.height;
+    region.uvOffset[0] = float(region.x) / float(atlas.width);
+    region.uvOffset[1] = float(region.y) / float(atlas.height);
+    region.uvScale[0] = float(region.width) / float(atlas.width);
+    region.uvScale[1] = float(region.height) / float(atlas.height);
+    return true;
+}
+
+float TextureAtlas::occupancy() const {
+    return float(double(usedArea) / (double(atlas.width) * atlas.height));
+}
+
+GLuint TextureAtlas::upload() const {
+    GLuint textureID;
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, atlas.width, atlas.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, atlas.pixels.data());
+
+    // wrapping would sample the opposite border, which belongs to another image
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    return textureID;
+}
+
+void TextureAtlas::remapUVs(float *uvs, size_t count, size_t stride, const Region &region) {
+    for (size_t i = 0; i < count; ++i) {
+        float *uv = uvs + i * stride;
+        uv[0] = region.uvOffset[0] + uv[0] * region.uvScale[0];
+        uv[1] = region.uvOffset[1] + uv[1] * region.uvScale[1];
+    }
+}
@@ -0,0 +1,77 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#ifndef TEXTUREATLAS_H
+#define TEXTUREATLAS_H
+#include <cstddef>
+#include <vector>
+
+#include "Textures.hpp"
+
+
+/** Packs many small images into one RGBA8 image with a skyline bottom-left bin packer
+ *
+ *  Every image gets a border of extruded edge pixels (padding) and slots are aligned, so bilinear filtering
+ *  and the first mip levels (up to 2^level <= padding) do not bleed into the neighbours and block
+ *  compression (alignment 4) never mixes two images in one block.
+ *  UVs of the atlas follow the OpenGL convention of the images (origin bottom left).
+ */
+class TextureAtlas {
+public:
+    /** Position of one packed image inside the atlas */
+    struct Region {
+        unsigned int x = 0, y = 0;          // pixel position of the image (without padding)
+        unsigned int width = 0, height = 0;
+        float uvOffset[2] = {0.0f, 0.0f};   // uv = uvOffset + uv * uvScale
+        float uvScale[2] = {1.0f, 1.0f};
+    };
+
+    /**
+     *  @param[in] width Width of the atlas in pixels
+     *  @param[in] height Height of the atlas in pixels
+     *  @param[in] padding Extruded border around every image in pixels
+     *  @param[in] alignment Slot positions and sizes are multiples of this value
+     */
+    TextureAtlas(unsigned int width, unsigned int height, unsigned int padding = 4, unsigned int alignment = 4);
+
+    /** Finds a free slot for the image and copies it (including the border) into the atlas
+     *
+     *  @returns false if the atlas has no room left for the image
+     */
+    bool add(const Image &image, Region &region);
+
+    /** Creates an OpenGL texture (clamped, trilinear filtered) from the atlas image */
+    GLuint upload() const;
+
+    const Image &image() const { return atlas; }
+    /** @returns Fraction of the atlas covered by slots */
+    float occupancy() const;
+
+    /** Moves texture coordinates of a mesh into the region of its image
+     *
+     *  @param[in,out] uvs First u of the mesh, v follows directly after it
+     *  @param[in] count Number of vertices
+     *  @param[in] stride Distance between two vertices in floats (2 for a plain uv array)
+     *  @note Coordinates outside of [0, 1] (GL_REPEAT wrapping) can not be represented inside an atlas
+     */
+    static void remapUVs(float *uvs, size_t count, size_t stride, const Region &region);
+
+private:
+    struct SkylineSegment {
+        unsigned int x, y, width;
+    };
+
+    bool findPosition(unsigned int width, unsigned int height, unsigned int &x, unsigned int &y, size_t &segment) const;
+    void insertSegment(size_t index, unsigned int x, unsigned int y, unsigned int width, unsigned int height);
+
+    Image atlas;
+    unsigned int padding;
+    unsigned int alignment;
+    unsigned long long usedArea = 0;
+    std::vector<SkylineSegment> skyline;
+};
+
+
+
+#endif //TEXTUREATLAS_H
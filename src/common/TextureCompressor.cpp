@@ -0,0 +1,720 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#include "TextureCompressor.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TEXTURE_COMPRESSOR_SSE2
+#endif
+
+#include "JobSystem.hpp"
+#include "TextureDecoder.hpp"
+
+namespace {
+    /** 16 pixels of a 4x4 block in structure of arrays layout, so 4 pixels can be handled per SSE register */
+    struct BlockPixels {
+        alignas(16) float r[16];
+        alignas(16) float g[16];
+        alignas(16) float b[16];
+        alignas(16) float a[16];
+        alignas(16) float weight[16]; // 0 excludes a pixel from the color fit (transparent pixels in BC1)
+    };
+
+    struct Color {
+        float r, g, b, a;
+    };
+
+    // fetches the 4x4 block at (blockX, blockY), blockY counts from the top of the image like .DDS files do
+    void loadBlock(const Image &image, unsigned int blockX, unsigned int blockY, BlockPixels &block) {
+        for (unsigned int py = 0; py < 4; ++py) {
+            // clamp to the image border for sizes that are not a multiple of 4
+            unsigned int topRow = std::min(blockY * 4 + py, image.height - 1);
+            unsigned int row = image.height - 1 - topRow;
+            for (unsigned int px = 0; px < 4; ++px) {
+                unsigned int column = std::min(blockX * 4 + px, image.width - 1);
+                const unsigned char *pixel = &image.pixels[(size_t(row) * image.width + column) * 4];
+                unsigned int i = py * 4 + px;
+                block.r[i] = pixel[0];
+                block.g[i] = pixel[1];
+                block.b[i] = pixel[2];
+                block.a[i] = pixel[3];
+                block.weight[i] = 1.0f;
+            }
+        }
+    }
+
+    void storeBlock(Image &image, unsigned int blockX, unsigned int blockY, const unsigned char rgba[64]) {
+        for (unsigned int py = 0; py < 4; ++py) {
+            unsigned int topRow = blockY * 4 + py;
+            if (topRow >= image.height) break;
+            unsigned int row = image.height - 1 - topRow;
+            for (unsigned int px = 0; px < 4; ++px) {
+                unsigned int column = blockX * 4 + px;
+                if (column >= image.width) break;
+                memcpy(&image.pixels[(size_t(row) * image.width + column) * 4], &rgba[(py * 4 + px) * 4], 4);
+            }
+        }
+    }
+
+    /** Principal axis of the weighted pixel colors (power iteration on the covariance matrix)
+     *
+     *  @param[in] channels 3 fits RGB only, 4 includes alpha
+     */
+    void principalAxis(const BlockPixels &block, unsigned int channels, Color &mean, Color &axis) {
+        const float *data[4] = {block.r, block.g, block.b, block.a};
+        float weightSum = 0.0f;
+        float sum[4] = {0, 0, 0, 0};
+        for (unsigned int i = 0; i < 16; ++i) {
+            weightSum += block.weight[i];
+            for (unsigned int c = 0; c < channels; ++c) sum[c] += block.weight[i] * data[c][i];
+        }
+        float m[4] = {0, 0, 0, 0};
+        if (weightSum > 0.0f) for (unsigned int c = 0; c < channels; ++c) m[c] = sum[c] / weightSum;
+
+        float covariance[4][4] = {};
+        for (unsigned int i = 0; i < 16; ++i) {
+            float d[4] = {0, 0, 0, 0};
+            for (unsigned int c = 0; c < channels; ++c) d[c] = data[c][i] - m[c];
+            for (unsigned int c0 = 0; c0 < channels; ++c0)
+                for (unsigned int c1 = c0; c1 < channels; ++c1)
+                    covariance[c0][c1] += block.weight[i] * d[c0] * d[c1];
+        }
+        for (unsigned int c0 = 0; c0 < channels; ++c0)
+            for (unsigned int c1 = 0; c1 < c0; ++c1) covariance[c0][c1] = covariance[c1][c0];
+
+        // start with the row of the largest variance, converges within a few iterations for 4x4 blocks
+        unsigned int largest = 0;
+        for (unsigned int c = 1; c < channels; ++c) if (covariance[c][c] > covariance[largest][largest]) largest = c;
+        float v[4] = {0, 0, 0, 0};
+        for (unsigned int c = 0; c < channels; ++c) v[c] = covariance[largest][c];
+
+        for (unsigned int iteration = 0; iteration < 8; ++iteration) {
+            float next[4] = {0, 0, 0, 0};
+            for (unsigned int c0 = 0; c0 < channels; ++c0)
+                for (unsigned int c1 = 0; c1 < channels; ++c1) next[c0] += covariance[c0][c1] * v[c1];
+            float length = 0.0f;
+            for (unsigned int c = 0; c < channels; ++c) length += next[c] * next[c];
+            if (length < 1e-12f) break;
+            length = 1.0f / std::sqrt(length);
+            for (unsigned int c = 0; c < channels; ++c) v[c] = next[c] * length;
+        }
+
+        float length = 0.0f;
+        for (unsigned int c = 0; c < channels; ++c) length += v[c] * v[c];
+        if (length < 1e-12f) {
+            // all pixels share one color, any axis works
+            for (unsigned int c = 0; c < channels; ++c) v[c] = 1.0f;
+            length = float(channels);
+        }
+        length = 1.0f / std::sqrt(length);
+
+        mean = {m[0], m[1], m[2], m[3]};
+        axis = {v[0] * length, v[1] * length, v[2] * length, channels == 4 ? v[3] * length : 0.0f};
+    }
+
+    /** Projects all weighted pixels onto the axis and returns the extreme positions along it */
+    void projectExtremes(const BlockPixels &block, const Color &mean, const Color &axis, float &minT, float &maxT) {
+#ifdef TEXTURE_COMPRESSOR_SSE2
+        __m128 meanR = _mm_set1_ps(mean.r), meanG = _mm_set1_ps(mean.g), meanB = _mm_set1_ps(mean.b);
+        __m128 meanA = _mm_set1_ps(mean.a);
+        __m128 axisR = _mm_set1_ps(axis.r), axisG = _mm_set1_ps(axis.g), axisB = _mm_set1_ps(axis.b);
+        __m128 axisA = _mm_set1_ps(axis.a);
+        __m128 minimum = _mm_set1_ps(1e30f), maximum = _mm_set1_ps(-1e30f);
+        for (unsigned int i = 0; i < 16; i += 4) {
+            __m128 t = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(block.r + i), meanR), axisR);
+            t = _mm_add_ps(t, _mm_mul_ps(_mm_sub_ps(_mm_load_ps(block.g + i), meanG), axisG));
+            t = _mm_add_ps(t, _mm_mul_ps(_mm_sub_ps(_mm_load_ps(block.b + i), meanB), axisB));
+            t = _mm_add_ps(t, _mm_mul_ps(_mm_sub_ps(_mm_load_ps(block.a + i), meanA), axisA));
+            // excluded pixels must not widen the range
+            __m128 used = _mm_cmpgt_ps(_mm_load_ps(block.weight + i), _mm_setzero_ps());
+            minimum = _mm_min_ps(minimum, _mm_or_ps(_mm_and_ps(used, t), _mm_andnot_ps(used, _mm_set1_ps(1e30f))));
+            maximum = _mm_max_ps(maximum, _mm_or_ps(_mm_and_ps(used, t), _mm_andnot_ps(used, _mm_set1_ps(-1e30f))));
+        }
+        alignas(16) float minLanes[4], maxLanes[4];
+        _mm_store_ps(minLanes, minimum);
+        _mm_store_ps(maxLanes, maximum);
+        minT = std::min(std::min(minLanes[0], minLanes[1]), std::min(minLanes[2], minLanes[3]));
+        maxT = std::max(std::max(maxLanes[0], maxLanes[1]), std::max(maxLanes[2], maxLanes[3]));
+#else
+        minT = 1e30f;
+        maxT = -1e30f;
+        for (unsigned int i = 0; i < 16; ++i) {
+            if (block.weight[i] <= 0.0f) continue;
+            float t = (block.r[i] - mean.r) * axis.r + (block.g[i] - mean.g) * axis.g +
+                      (block.b[i] - mean.b) * axis.b + (block.a[i] - mean.a) * axis.a;
+            minT = std::min(minT, t);
+            maxT = std::max(maxT, t);
+        }
+#endif
+        if (minT > maxT) minT = maxT = 0.0f;
+    }
+
+    /** Picks the closest RGB palette entry for every pixel
+     *
+     *  @param[in] paletteSize Number of used entries (3 or 4)
+     *  @param[out] indices Palette index per pixel
+     *  @returns Weighted squared error of the block
+     */
+    float selectColorIndices(const BlockPixels &block, const Color *palette, unsigned int paletteSize,
+                             unsigned int indices[16]) {
+#ifdef TEXTURE_COMPRESSOR_SSE2
+        __m128 errorSum = _mm_setzero_ps();
+        for (unsigned int i = 0; i < 16; i += 4) {
+            __m128 r = _mm_load_ps(block.r + i), g = _mm_load_ps(block.g + i), b = _mm_load_ps(block.b + i);
+            __m128 bestDistance = _mm_set1_ps(1e30f);
+            __m128i bestIndex = _mm_setzero_si128();
+            for (unsigned int k = 0; k < paletteSize; ++k) {
+                __m128 dr = _mm_sub_ps(r, _mm_set1_ps(palette[k].r));
+                __m128 dg = _mm_sub_ps(g, _mm_set1_ps(palette[k].g));
+                __m128 db = _mm_sub_ps(b, _mm_set1_ps(palette[k].b));
+                __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)), _mm_mul_ps(db, db));
+                __m128i closer = _mm_castps_si128(_mm_cmplt_ps(distance, bestDistance));
+                bestIndex = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(int(k))),
+                                         _mm_andnot_si128(closer, bestIndex));
+                bestDistance = _mm_min_ps(bestDistance, distance);
+            }
+            errorSum = _mm_add_ps(errorSum, _mm_mul_ps(bestDistance, _mm_load_ps(block.weight + i)));
+            alignas(16) int lanes[4];
+            _mm_store_si128(reinterpret_cast<__m128i *>(lanes), bestIndex);
+            for (unsigned int lane = 0; lane < 4; ++lane) indices[i + lane] = lanes[lane];
+        }
+        alignas(16) float errors[4];
+        _mm_store_ps(errors, errorSum);
+        return errors[0] + errors[1] + errors[2] + errors[3];
+#else
+        float error = 0.0f;
+        for (unsigned int i = 0; i < 16; ++i) {
+            float bestDistance = 1e30f;
+            for (unsigned int k = 0; k < paletteSize; ++k) {
+                float dr = block.r[i] - palette[k].r, dg = block.g[i] - palette[k].g, db = block.b[i] - palette[k].b;
+                float distance = dr * dr + dg * dg + db * db;
+                if (distance < bestDistance) {
+                    bestDistance = distance;
+                    indices[i] = k;
+                }
+            }
+            error += bestDistance * block.weight[i];
+        }
+        return error;
+#endif
+    }
+
+    uint16_t packRGB565(const Color &color) {
+        int r = std::clamp(int(std::lround(color.r * 31.0f / 255.0f)), 0, 31);
+        int g = std::clamp(int(std::lround(color.g * 63.0f / 255.0f)), 0, 63);
+        int b = std::clamp(int(std::lround(color.b * 31.0f / 255.0f)), 0, 31);
+        return uint16_t((r << 11) | (g << 5) | b);
+    }
+
+    Color unpackRGB565(uint16_t packed) {
+        int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+        return {float((r << 3) | (r >> 2)), float((g << 2) | (g >> 4)), float((b << 3) | (b >> 2)), 255.0f};
+    }
+
+    /** Builds the palette the hardware derives from two 565 endpoints */
+    void colorPalette(uint16_t color0, uint16_t color1, bool fourColors, Color palette[4]) {
+        Color c0 = unpackRGB565(color0), c1 = unpackRGB565(color1);
+        palette[0] = c0;
+        palette[1] = c1;
+        if (fourColors) {
+            palette[2] = {(2 * c0.r + c1.r) / 3, (2 * c0.g + c1.g) / 3, (2 * c0.b + c1.b) / 3, 255.0f};
+            palette[3] = {(c0.r + 2 * c1.r) / 3, (c0.g + 2 * c1.g) / 3, (c0.b + 2 * c1.b) / 3, 255.0f};
+        } else {
+            palette[2] = {(c0.r + c1.r) / 2, (c0.g + c1.g) / 2, (c0.b + c1.b) / 2, 255.0f};
+            palette[3] = {0.0f, 0.0f, 0.0f, 0.0f};
+        }
+    }
+
+    /** Least squares endpoints for fixed indices, returns false if the system is singular */
+    bool fitEndpoints(const BlockPixels &block, const unsigned int indices[16], bool fourColors,
+                      Color &endpoint0, Color &endpoint1) {
+        static constexpr float FOUR_COLOR_WEIGHTS[4] = {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+        static constexpr float THREE_COLOR_WEIGHTS[4] = {1.0f, 0.0f, 0.5f, 0.0f};
+        const float *weights = fourColors ? FOUR_COLOR_WEIGHTS : THREE_COLOR_WEIGHTS;
+
+        float aa = 0, ab = 0, bb = 0;
+        Color ax = {0, 0, 0, 0}, bx = {0, 0, 0, 0};
+        for (unsigned int i = 0; i < 16; ++i) {
+            if (block.weight[i] <= 0.0f || (!fourColors && indices[i] == 3)) continue;
+            float alpha = weights[indices[i]], beta = 1.0f - alpha;
+            aa += alpha * alpha;
+            ab += alpha * beta;
+            bb += beta * beta;
+            ax.r += alpha * block.r[i]; ax.g += alpha * block.g[i]; ax.b += alpha * block.b[i];
+            bx.r += beta * block.r[i]; bx.g += beta * block.g[i]; bx.b += beta * block.b[i];
+        }
+        float determinant = aa * bb - ab * ab;
+        if (std::fabs(determinant) < 1e-6f) return false;
+        float inverse = 1.0f / determinant;
+        endpoint0 = {(bb * ax.r - ab * bx.r) * inverse, (bb * ax.g - ab * bx.g) * inverse,
+                     (bb * ax.b - ab * bx.b) * inverse, 255.0f};
+        endpoint1 = {(aa * bx.r - ab * ax.r) * inverse, (aa * bx.g - ab * ax.g) * inverse,
+                     (aa * bx.b - ab * ax.b) * inverse, 255.0f};
+        return true;
+    }
+
+    /** Encodes the RGB part of a block into the 8 byte BC1 layout
+     *
+     *  @param[in] punchThrough Use the 3 color mode and mark pixels with weight 0 as transparent
+     */
+    void encodeColorBlock(const BlockPixels &block, bool punchThrough, unsigned char *out) {
+        Color mean, axis;
+        principalAxis(block, 3, mean, axis);
+        float minT, maxT;
+        projectExtremes(block, mean, axis, minT, maxT);
+
+        Color endpoint0 = {mean.r + axis.r * maxT, mean.g + axis.g * maxT, mean.b + axis.b * maxT, 255.0f};
+        Color endpoint1 = {mean.r + axis.r * minT, mean.g + axis.g * minT, mean.b + axis.b * minT, 255.0f};
+        bool fourColors = !punchThrough;
+        unsigned int paletteSize = fourColors ? 4 : 3;
+
+        uint16_t bestColor0 = 0, bestColor1 = 0;
+        unsigned int bestIndices[16] = {};
+        float bestError = 1e30f;
+
+        // initial guess from the principal axis, then refine the endpoints against the chosen indices
+        for (unsigned int iteration = 0; iteration < 3; ++iteration) {
+            uint16_t color0 = packRGB565(endpoint0), color1 = packRGB565(endpoint1);
+            Color palette[4];
+            colorPalette(color0, color1, fourColors, palette);
+            unsigned int indices[16];
+            float error = selectColorIndices(block, palette, paletteSize, indices);
+            if (error < bestError) {
+                bestError = error;
+                bestColor0 = color0;
+                bestColor1 = color1;
+                memcpy(bestIndices, indices, sizeof(indices));
+            }
+            if (bestError == 0.0f || !fitEndpoints(block, indices, fourColors, endpoint0, endpoint1)) break;
+        }
+        if (punchThrough) for (unsigned int i = 0; i < 16; ++i) if (block.weight[i] <= 0.0f) bestIndices[i] = 3;
+
+        // the hardware picks the mode from the endpoint order, swap the endpoints to match the wanted mode
+        if (fourColors) {
+            if (bestColor0 < bestColor1) {
+                std::swap(bestColor0, bestColor1);
+                for (unsigned int &index : bestIndices) index ^= 1;
+            } else if (bestColor0 == bestColor1) {
+                for (unsigned int &index : bestIndices) index = 0;
+            }
+        } else if (bestColor0 > bestColor1) {
+            std::swap(bestColor0, bestColor1);
+            for (unsigned int &index : bestIndices) if (index < 2) index ^= 1;
+        }
+
+        uint32_t packedIndices = 0;
+        for (unsigned int i = 0; i < 16; ++i) packedIndices |= bestIndices[i] << (i * 2);
+        out[0] = bestColor0 & 0xFF;
+        out[1] = bestColor0 >> 8;
+        out[2] = bestColor1 & 0xFF;
+        out[3] = bestColor1 >> 8;
+        memcpy(out + 4, &packedIndices, 4);
+    }
+
+    void alphaPalette(unsigned int alpha0, unsigned int alpha1, unsigned int palette[8]) {
+        palette[0] = alpha0;
+        palette[1] = alpha1;
+        if (alpha0 > alpha1) {
+            for (unsigned int k = 1; k < 7; ++k) palette[k + 1] = ((7 - k) * alpha0 + k * alpha1) / 7;
+        } else {
+            for (unsigned int k = 1; k < 5; ++k) palette[k + 1] = ((5 - k) * alpha0 + k * alpha1) / 5;
+            palette[6] = 0;
+            palette[7] = 255;
+        }
+    }
+
+    /** Encodes the alpha channel into the 8 byte BC3 alpha block (8 interpolated values) */
+    void encodeAlphaBlock(const BlockPixels &block, unsigned char *out) {
+        float minimum = 255.0f, maximum = 0.0f;
+        for (float alpha : block.a) {
+            minimum = std::min(minimum, alpha);
+            maximum = std::max(maximum, alpha);
+        }
+        unsigned int alpha0 = unsigned(maximum), alpha1 = unsigned(minimum);
+        unsigned int palette[8];
+        alphaPalette(alpha0, alpha1, palette);
+
+        uint64_t packedIndices = 0;
+        if (alpha0 != alpha1) {
+            for (unsigned int i = 0; i < 16; ++i) {
+                unsigned int bestIndex = 0;
+                float bestDistance = 1e30f;
+                for (unsigned int k = 0; k < 8; ++k) {
+                    float distance = std::fabs(block.a[i] - float(palette[k]));
+                    if (distance < bestDistance) {
+                        bestDistance = distance;
+                        bestIndex = k;
+                    }
+                }
+                packedIndices |= uint64_t(bestIndex) << (i * 3);
+            }
+        }
+        out[0] = alpha0;
+        out[1] = alpha1;
+        for (unsigned int i = 0; i < 6; ++i) out[2 + i] = (packedIndices >> (i * 8)) & 0xFF;
+    }
+
+    // BC7 mode 6: one subset, 7 bit RGBA endpoints with a p-bit each, 4 bit indices
+    constexpr unsigned int BC7_WEIGHTS[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+    struct BitWriter {
+        uint64_t low = 0, high = 0;
+        unsigned int position = 0;
+
+        void write(uint64_t value, unsigned int count) {
+            for (unsigned int i = 0; i < count; ++i, ++position) {
+                uint64_t bit = (value >> i) & 1;
+                if (position < 64) low |= bit << position;
+                else high |= bit << (position - 64);
+            }
+        }
+    };
+
+    struct BitReader {
+        uint64_t low, high;
+        unsigned int position = 0;
+
+        unsigned int read(unsigned int count) {
+            unsigned int value = 0;
+            for (unsigned int i = 0; i < count; ++i, ++position) {
+                uint64_t bit = position < 64 ? (low >> position) & 1 : (high >> (position - 64)) & 1;
+                value |= unsigned(bit) << i;
+            }
+            return value;
+        }
+    };
+
+    unsigned int bc7Interpolate(unsigned int e0, unsigned int e1, unsigned int index) {
+        return ((64 - BC7_WEIGHTS[index]) * e0 + BC7_WEIGHTS[index] * e1 + 32) >> 6;
+    }
+
+    float bc7SelectIndices(const BlockPixels &block, const unsigned int e0[4], const unsigned int e1[4],
+                           unsigned int indices[16]) {
+        float palette[16][4];
+        for (unsigned int k = 0; k < 16; ++k)
+            for (unsigned int c = 0; c < 4; ++c) palette[k][c] = float(bc7Interpolate(e0[c], e1[c], k));
+
+        float error = 0.0f;
+        for (unsigned int i = 0; i < 16; ++i) {
+            float pixel[4] = {block.r[i], block.g[i], block.b[i], block.a[i]};
+            float bestDistance = 1e30f;
+            for (unsigned int k = 0; k < 16; ++k) {
+                float distance = 0.0f;
+                for (unsigned int c = 0; c < 4; ++c) distance += (pixel[c] - palette[k][c]) * (pixel[c] - palette[k][c]);
+                if (distance < bestDistance) {
+                    bestDistance = distance;
+                    indices[i] = k;
+                }
+            }
+            error += bestDistance;
+        }
+        return error;
+    }
+
+    /** Quantizes an endpoint to 7 bits per channel plus the p-bit giving the smallest error */
+    void bc7QuantizeEndpoint(const float endpoint[4], unsigned int quantized[4], unsigned int &pBit) {
+        float bestError = 1e30f;
+        for (unsigned int p = 0; p < 2; ++p) {
+            unsigned int candidate[4];
+            float error = 0.0f;
+            for (unsigned int c = 0; c < 4; ++c) {
+                int value = std::clamp(int(std::lround((endpoint[c] - float(p)) / 2.0f)), 0, 127);
+                candidate[c] = value;
+                float expanded = float((value << 1) | p);
+                error += (expanded - endpoint[c]) * (expanded - endpoint[c]);
+            }
+            if (error < bestError) {
+                bestError = error;
+                pBit = p;
+                memcpy(quantized, candidate, sizeof(candidate));
+            }
+        }
+    }
+
+    void encodeBC7Block(const BlockPixels &block, unsigned char *out) {
+        Color mean, axis;
+        principalAxis(block, 4, mean, axis);
+        float minT, maxT;
+        projectExtremes(block, mean, axis, minT, maxT);
+
+        float endpoint0[4] = {mean.r + axis.r * minT, mean.g + axis.g * minT, mean.b + axis.b * minT, mean.a + axis.a * minT};
+        float endpoint1[4] = {mean.r + axis.r * maxT, mean.g + axis.g * maxT, mean.b + axis.b * maxT, mean.a + axis.a * maxT};
+
+        unsigned int bestQuantized0[4] = {}, bestQuantized1[4] = {}, bestP0 = 0, bestP1 = 0;
+        unsigned int bestIndices[16] = {};
+        float bestError = 1e30f;
+
+        for (unsigned int iteration = 0; iteration < 2; ++iteration) {
+            unsigned int quantized0[4], quantized1[4], p0, p1;
+            bc7QuantizeEndpoint(endpoint0, quantized0, p0);
+            bc7QuantizeEndpoint(endpoint1, quantized1, p1);
+            unsigned int e0[4], e1[4];
+            for (unsigned int c = 0; c < 4; ++c) {
+                e0[c] = (quantized0[c] << 1) | p0;
+                e1[c] = (quantized1[c] << 1) | p1;
+            }
+            unsigned int indices[16];
+            float error = bc7SelectIndices(block, e0, e1, indices);
+            if (error < bestError) {
+                bestError = error;
+                memcpy(bestQuantized0, quantized0, sizeof(quantized0));
+                memcpy(bestQuantized1, quantized1, sizeof(quantized1));
+                bestP0 = p0;
+                bestP1 = p1;
+                memcpy(bestIndices, indices, sizeof(indices));
+            }
+            if (bestError == 0.0f) break;
+
+            // least squares refit of the endpoints for the selected indices
+            float aa = 0, ab = 0, bb = 0, ax[4] = {}, bx[4] = {};
+            const float *data[4] = {block.r, block.g, block.b, block.a};
+            for (unsigned int i = 0; i < 16; ++i) {
+                float beta = float(BC7_WEIGHTS[indices[i]]) / 64.0f, alpha = 1.0f - beta;
+                aa += alpha * alpha;
+                ab += alpha * beta;
+                bb += beta * beta;
+                for (unsigned int c = 0; c < 4; ++c) {
+                    ax[c] += alpha * data[c][i];
+                    bx[c] += beta * data[c][i];
+                }
+            }
+            float determinant = aa * bb - ab * ab;
+            if (std::fabs(determinant) < 1e-6f) break;
+            for (unsigned int c = 0; c < 4; ++c) {
+                endpoint0[c] = std::clamp((bb * ax[c] - ab * bx[c]) / determinant, 0.0f, 255.0f);
+                endpoint1[c] = std::clamp((aa * bx[c] - ab * ax[c]) / determinant, 0.0f, 255.0f);
+            }
+        }
+
+        // the anchor index (pixel 0) only stores 3 bits, so its top bit has to be 0
+        if (bestIndices[0] >= 8) {
+            std::swap(bestQuantized0, bestQuantized1);
+            std::swap(bestP0, bestP1);
+            for (unsigned int &index : bestIndices) index = 15 - index;
+        }
+
+        BitWriter writer;
+        writer.write(1 << 6, 7); // mode 6
+        for (unsigned int c = 0; c < 4; ++c) {
+            writer.write(bestQuantized0[c], 7);
+            writer.write(bestQuantized1[c], 7);
+        }
+        writer.write(bestP0, 1);
+        writer.write(bestP1, 1);
+        writer.write(bestIndices[0], 3);
+        for (unsigned int i = 1; i < 16; ++i) writer.write(bestIndices[i], 4);
+        memcpy(out, &writer.low, 8);
+        memcpy(out + 8, &writer.high, 8);
+    }
+
+    void decodeBC7Block(const unsigned char *in, unsigned char rgba[64]) {
+        BitReader reader{};
+        memcpy(&reader.low, in, 8);
+        memcpy(&reader.high, in + 8, 8);
+        if (reader.read(7) != (1 << 6)) {
+            // only mode 6 is produced by the compressor
+            memset(rgba, 0, 64);
+            return;
+        }
+        unsigned int e0[4], e1[4];
+        for (unsigned int c = 0; c < 4; ++c) {
+            e0[c] = reader.read(7) << 1;
+            e1[c] = reader.read(7) << 1;
+        }
+        unsigned int p0 = reader.read(1), p1 = reader.read(1);
+        for (unsigned int c = 0; c < 4; ++c) {
+            e0[c] |= p0;
+            e1[c] |= p1;
+        }
+        for (unsigned int i = 0; i < 16; ++i) {
+            unsigned int index = reader.read(i == 0 ? 3 : 4);
+            for (unsigned int c = 0; c < 4; ++c) rgba[i * 4 + c] = bc7Interpolate(e0[c], e1[c], index);
+        }
+    }
+
+    // halves the image with a 2x2 box filter
+    void downsample(const Image &source, Image &target) {
+        target.width = std::max(source.width / 2, 1u);
+        target.height = std::max(source.height / 2, 1u);
+        target.pixels.resize(size_t(target.width) * target.height * 4);
+        for (unsigned int y = 0; y < target.height; ++y) {
+            unsigned int y0 = std::min(y * 2, source.height - 1), y1 = std::min(y * 2 + 1, source.height - 1);
+            for (unsigned int x = 0; x < target.width; ++x) {
+                unsigned int x0 = std::min(x * 2, source.width - 1), x1 = std::min(x * 2 + 1, source.width - 1);
+                for (unsigned int c = 0; c < 4; ++c) {
+                    unsigned int sum = source.pixels[(size_t(y0) * source.width + x0) * 4 + c] +
+                                       source.pixels[(size_t(y0) * source.width + x1) * 4 + c] +
+                                       source.pixels[(size_t(y1) * source.width + x0) * 4 + c] +
+                                       source.pixels[(size_t(y1) * source.width + x1) * 4 + c];
+                    target.pixels[(size_t(y) * target.width + x) * 4 + c] = (sum + 2) / 4;
+                }
+            }
+        }
+    }
+}
+
+#define FOURCC_DXT1 0x31545844 // Equivalent to "DXT1" in ASCII
+#define FOURCC_DXT5 0x35545844 // Equivalent to "DXT5" in ASCII
+#define FOURCC_DX10 0x30315844 // Equivalent to "DX10" in ASCII
+#define DXGI_FORMAT_BC7_UNORM 98
+
+unsigned int TextureCompressor::blockSize(Format format) {
+    return format == Format::BC1 ? 8 : 16;
+}
+
+unsigned int TextureCompressor::compress(const Image &image, Format format, std::vector<unsigned char> &blocks) {
+    unsigned int blocksX = (image.width + 3) / 4;
+    unsigned int blocksY = (image.height + 3) / 4;
+    unsigned int size = blockSize(format);
+    blocks.resize(size_t(blocksX) * blocksY * size);
+
+    // every job compresses one row of blocks, rows are independent
+    JobSystem::parallelFor(blocksY, 1, [&](unsigned int begin, unsigned int end) {
+        BlockPixels block;
+        for (unsigned int blockY = begin; blockY < end; ++blockY) {
+            for (unsigned int blockX = 0; blockX < blocksX; ++blockX) {
+                loadBlock(image, blockX, blockY, block);
+                unsigned char *out = &blocks[(size_t(blockY) * blocksX + blockX) * size];
+                switch (format) {
+                    case Format::BC1: {
+                        bool punchThrough = false;
+                        for (unsigned int i = 0; i < 16; ++i) {
+                            if (block.a[i] < 128.0f) {
+                                block.weight[i] = 0.0f;
+                                punchThrough = true;
+                            }
+                        }
+                        encodeColorBlock(block, punchThrough, out);
+                        break;
+                    }
+                    case Format::BC3:
+                        encodeAlphaBlock(block, out);
+                        encodeColorBlock(block, false, out + 8);
+                        break;
+                    case Format::BC7:
+                        encodeBC7Block(block, out);
+                        break;
+                }
+            }
+        }
+    });
+
+    return blocksX * blocksY;
+}
+
+void TextureCompressor::decompress(const unsigned char *blocks, unsigned int width, unsigned int height,
+                                   Format format, Image &image) {
+    unsigned int blocksX = (width + 3) / 4;
+    unsigned int blocksY = (height + 3) / 4;
+    image.width = width;
+    image.height = height;
+    image.pixels.resize(size_t(width) * height * 4);
+
+    if (format == Format::BC7) {
+        JobSystem::parallelFor(blocksY, 1, [&](unsigned int begin, unsigned int end) {
+            unsigned char rgba[64];
+            for (unsigned int blockY = begin; blockY < end; ++blockY) {
+                for (unsigned int blockX = 0; blockX < blocksX; ++blockX) {
+                    decodeBC7Block(&blocks[(size_t(blockY) * blocksX + blockX) * 16], rgba);
+                    storeBlock(image, blockX, blockY, rgba);
+                }
+            }
+        });
+        return;
+    }
+
+    // the S3TC decoder writes rows in block order (top to bottom), flip them into the bottom up image
+    std::vector<unsigned char> decoded(image.pixels.size());
+    TextureDecoder::decode(format == Format::BC1 ? GL_COMPRESSED_RGBA_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT,
+                           blocks, width, height, decoded.data());
+    size_t rowSize = size_t(width) * 4;
+    for (unsigned int y = 0; y < height; ++y)
+        memcpy(&image.pixels[(height - 1 - y) * rowSize], &decoded[y * rowSize], rowSize);
+}
+
+double TextureCompressor::psnr(const Image &reference, const Image &image, bool includeAlpha) {
+    if (reference.width != image.width || reference.height != image.height) return 0.0;
+    unsigned int channels = includeAlpha ? 4 : 3;
+    double squaredError = 0.0;
+    size_t pixelCount = size_t(reference.width) * reference.height;
+    for (size_t i = 0; i < pixelCount; ++i) {
+        for (unsigned int c = 0; c < channels; ++c) {
+            double difference = double(reference.pixels[i * 4 + c]) - double(image.pixels[i * 4 + c]);
+            squaredError += difference * difference;
+        }
+    }
+    if (squaredError == 0.0) return 99.0; // identical images, report a large but finite value
+    double meanSquaredError = squaredError / double(pixelCount * channels);
+    return 10.0 * std::log10(255.0 * 255.0 / meanSquaredError);
+}
+
+bool TextureCompressor::writeDDS(const Image &image, const char *filename, Format format, Stats *stats) {
+    if (image.width == 0 || image.height == 0) return false;
+
+    unsigned int mipMapCount = 1;
+    while ((std::max(image.width, image.height) >> mipMapCount) != 0) ++mipMapCount;
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<unsigned char> data;
+    std::vector<unsigned char> levelBlocks;
+    unsigned int totalBlocks = 0;
+    size_t topLevelSize = 0;
+    Image level = image, nextLevel;
+    for (unsigned int mip = 0; mip < mipMapCount; ++mip) {
+        totalBlocks += compress(level, format, levelBlocks);
+        if (mip == 0) topLevelSize = levelBlocks.size();
+        data.insert(data.end(), levelBlocks.begin(), levelBlocks.end());
+        if (mip + 1 < mipMapCount) {
+            downsample(level, nextLevel);
+            std::swap(level, nextLevel);
+        }
+    }
+
+    auto end = std::chrono::steady_clock::now();
+
+    if (stats) {
+        stats->blocks = totalBlocks;
+        stats->seconds = std::chrono::duration<double>(end - start).count();
+        stats->blocksPerSecond = stats->seconds > 0.0 ? double(totalBlocks) / stats->seconds : 0.0;
+        Image decoded;
+        decompress(data.data(), image.width, image.height, format, decoded);
+        stats->psnr = psnr(image, decoded, format != Format::BC1);
+    }
+
+    // the header follows the layout read by Textures::loadDDS
+    unsigned char header[124] = {};
+    auto writeUInt = [&header](unsigned int offset, unsigned int value) { memcpy(&header[offset], &value, 4); };
+    writeUInt(0, 124);                                   // header size
+    writeUInt(4, 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000); // caps, height, width, pixel format, mip count, linear size
+    writeUInt(8, image.height);
+    writeUInt(12, image.width);
+    writeUInt(16, static_cast<unsigned int>(topLevelSize));
+    writeUInt(24, mipMapCount);
+    writeUInt(72, 32);                                   // pixel format size
+    writeUInt(76, 0x4);                                  // pixel format uses fourCC
+    writeUInt(80, format == Format::BC1 ? FOURCC_DXT1 : format == Format::BC3 ? FOURCC_DXT5 : FOURCC_DX10);
+    writeUInt(104, 0x1000 | 0x400000 | 0x8);             // texture, mipmap, complex
+
+    FILE *file = fopen(filename, "wb");
+    if (!file) {printf("Could not open %s for writing\n", filename); return false;}
+    fwrite("DDS ", 1, 4, file);
+    fwrite(header, 1, sizeof(header), file);
+    if (format == Format::BC7) {
+        // DX10 extension header: format, 2D resource, no flags, array size 1, alpha mode unknown
+        unsigned int dx10Header[5] = {DXGI_FORMAT_BC7_UNORM, 3, 0, 1, 0};
+        fwrite(dx10Header, sizeof(unsigned int), 5, file);
+    }
+    bool written = fwrite(data.data(), 1, data.size(), file) == data.size();
+    fclose(file);
+    return written;
+}
@@ -0,0 +1,65 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#ifndef TEXTURECOMPRESSOR_H
+#define TEXTURECOMPRESSOR_H
+#include <vector>
+
+#include "Textures.hpp"
+
+
+/** CPU block compressor turning RGBA8 images into BC1 (DXT1), BC3 (DXT5) or BC7 blocks
+ *
+ *  Blocks are compressed in parallel, one 4x4 block row per job. The written .DDS files use the same
+ *  top down row order as files produced by other tools, so they are read by Textures::loadDDS.
+ */
+class TextureCompressor {
+public:
+    enum class Format {
+        BC1, // 8 bytes per block, RGB + 1 bit alpha
+        BC3, // 16 bytes per block, RGB + interpolated alpha
+        BC7  // 16 bytes per block, RGBA (mode 6 only)
+    };
+
+    /** Result of a compression run */
+    struct Stats {
+        unsigned int blocks = 0;
+        double seconds = 0.0;
+        double blocksPerSecond = 0.0;
+        double psnr = 0.0; // of the top level, RGB channels (RGBA for BC3/BC7)
+    };
+
+    /** @returns Size of a single 4x4 block in bytes */
+    static unsigned int blockSize(Format format);
+
+    /** Compresses one mip level
+     *
+     *  @param[in] image RGBA8 source, rows bottom to top
+     *  @param[in] format Target block format
+     *  @param[out] blocks Compressed blocks, block rows top to bottom like in a .DDS file
+     *  @returns Number of compressed blocks
+     */
+    static unsigned int compress(const Image &image, Format format, std::vector<unsigned char> &blocks);
+
+    /** Decodes blocks produced by compress() back into an RGBA8 image (rows bottom to top) */
+    static void decompress(const unsigned char *blocks, unsigned int width, unsigned int height, Format format,
+                           Image &image);
+
+    /** Compresses an image including a full box filtered mip chain and writes it as .DDS file
+     *
+     *  @param[in] image RGBA8 source image
+     *  @param[in] filename Output path
+     *  @param[in] format Target block format, BC7 is written with a DX10 header
+     *  @param[out] stats Optional timing and quality report
+     *  @returns true if the file was written
+     */
+    static bool writeDDS(const Image &image, const char *filename, Format format, Stats *stats = nullptr);
+
+    /** @returns Peak signal to noise ratio in dB between two images of the same size */
+    static double psnr(const Image &reference, const Image &image, bool includeAlpha);
+};
+
+
+
+#endif //TEXTURECOMPRESSOR_H
@@ -0,0 +1,259 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#include "TextureDecoder.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TEXTURE_DECODER_SSE2
+#endif
+
+#include "JobSystem.hpp"
+
+namespace {
+    uint16_t readUInt16(const unsigned char *in) {
+        return uint16_t(in[0] | (in[1] << 8));
+    }
+
+    uint32_t readUInt32(const unsigned char *in) {
+        return uint32_t(in[0]) | (uint32_t(in[1]) << 8) | (uint32_t(in[2]) << 16) | (uint32_t(in[3]) << 24);
+    }
+
+    uint64_t readUInt48(const unsigned char *in) {
+        uint64_t value = 0;
+        for (unsigned int i = 0; i < 6; ++i) value |= uint64_t(in[i]) << (i * 8);
+        return value;
+    }
+
+    // writes a decoded 4x4 block (16 RGBA pixels, little endian uint32) into the image, clipped at the border
+    void storeClipped(const uint32_t pixels[16], unsigned int blockX, unsigned int blockY, unsigned int width,
+                      unsigned int height, unsigned char *rgba) {
+        for (unsigned int py = 0; py < 4 && blockY * 4 + py < height; ++py) {
+            unsigned int columns = std::min(4u, width - blockX * 4);
+            memcpy(&rgba[(size_t(blockY * 4 + py) * width + blockX * 4) * 4], &pixels[py * 4], columns * 4);
+        }
+    }
+
+    // ---- reference implementation ----
+
+    void referenceColorBlock(const unsigned char *in, bool alwaysFourColors, uint32_t pixels[16]) {
+        uint16_t color0 = readUInt16(in), color1 = readUInt16(in + 2);
+        uint32_t indices = readUInt32(in + 4);
+
+        unsigned int r[4], g[4], b[4], a[4] = {255, 255, 255, 255};
+        r[0] = ((color0 >> 11) & 31) << 3 | ((color0 >> 11) & 31) >> 2;
+        g[0] = ((color0 >> 5) & 63) << 2 | ((color0 >> 5) & 63) >> 4;
+        b[0] = (color0 & 31) << 3 | (color0 & 31) >> 2;
+        r[1] = ((color1 >> 11) & 31) << 3 | ((color1 >> 11) & 31) >> 2;
+        g[1] = ((color1 >> 5) & 63) << 2 | ((color1 >> 5) & 63) >> 4;
+        b[1] = (color1 & 31) << 3 | (color1 & 31) >> 2;
+
+        if (alwaysFourColors || color0 > color1) {
+            r[2] = (2 * r[0] + r[1]) / 3; g[2] = (2 * g[0] + g[1]) / 3; b[2] = (2 * b[0] + b[1]) / 3;
+            r[3] = (r[0] + 2 * r[1]) / 3; g[3] = (g[0] + 2 * g[1]) / 3; b[3] = (b[0] + 2 * b[1]) / 3;
+        } else {
+            r[2] = (r[0] + r[1]) / 2; g[2] = (g[0] + g[1]) / 2; b[2] = (b[0] + b[1]) / 2;
+            r[3] = g[3] = b[3] = a[3] = 0; // transparent black
+        }
+
+        for (unsigned int i = 0; i < 16; ++i) {
+            unsigned int index = (indices >> (i * 2)) & 3;
+            pixels[i] = r[index] | (g[index] << 8) | (b[index] << 16) | (a[index] << 24);
+        }
+    }
+
+    void referenceExplicitAlpha(const unsigned char *in, uint32_t pixels[16]) {
+        for (unsigned int i = 0; i < 16; ++i) {
+            unsigned int alpha = (in[i / 2] >> ((i & 1) * 4)) & 15;
+            pixels[i] = (pixels[i] & 0x00FFFFFF) | ((alpha * 17) << 24);
+        }
+    }
+
+    void referenceInterpolatedAlpha(const unsigned char *in, uint32_t pixels[16]) {
+        unsigned int alpha[8];
+        alpha[0] = in[0];
+        alpha[1] = in[1];
+        if (alpha[0] > alpha[1]) {
+            for (unsigned int k = 1; k < 7; ++k) alpha[k + 1] = ((7 - k) * alpha[0] + k * alpha[1]) / 7;
+        } else {
+            for (unsigned int k = 1; k < 5; ++k) alpha[k + 1] = ((5 - k) * alpha[0] + k * alpha[1]) / 5;
+            alpha[6] = 0;
+            alpha[7] = 255;
+        }
+        uint64_t indices = readUInt48(in + 2);
+        for (unsigned int i = 0; i < 16; ++i)
+            pixels[i] = (pixels[i] & 0x00FFFFFF) | (alpha[(indices >> (i * 3)) & 7] << 24);
+    }
+
+    // ---- fast implementation ----
+
+    /** Builds the 4 entry color palette as packed RGBA8 */
+    void colorPalette(uint16_t color0, uint16_t color1, bool fourColors, uint32_t palette[4]) {
+#ifdef TEXTURE_DECODER_SSE2
+        // both endpoints expanded to 8 bit channels, held in 16 bit lanes: r0 g0 b0 a0 r1 g1 b1 a1
+        unsigned int r0 = (color0 >> 11) & 31, g0 = (color0 >> 5) & 63, b0 = color0 & 31;
+        unsigned int r1 = (color1 >> 11) & 31, g1 = (color1 >> 5) & 63, b1 = color1 & 31;
+        __m128i endpoints = _mm_setr_epi16(short(r0 << 3 | r0 >> 2), short(g0 << 2 | g0 >> 4), short(b0 << 3 | b0 >> 2), 255,
+                                           short(r1 << 3 | r1 >> 2), short(g1 << 2 | g1 >> 4), short(b1 << 3 | b1 >> 2), 255);
+        // swapped halves: c1 c0
+        __m128i swapped = _mm_shuffle_epi32(endpoints, _MM_SHUFFLE(1, 0, 3, 2));
+
+        __m128i interpolated;
+        if (fourColors) {
+            // (2 * c0 + c1) / 3 and (c0 + 2 * c1) / 3, x * 21846 >> 16 is an exact division by 3 for x <= 765
+            __m128i sum = _mm_add_epi16(_mm_add_epi16(endpoints, endpoints), swapped);
+            interpolated = _mm_mulhi_epu16(sum, _mm_set1_epi16(21846));
+            interpolated = _mm_or_si128(interpolated, _mm_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255));
+        } else {
+            // (c0 + c1) / 2 and transparent black
+            __m128i average = _mm_srli_epi16(_mm_add_epi16(endpoints, swapped), 1);
+            interpolated = _mm_and_si128(average, _mm_setr_epi16(-1, -1, -1, -1, 0, 0, 0, 0));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(palette), _mm_packus_epi16(endpoints, interpolated));
+#else
+        unsigned char block[8] = {(unsigned char)(color0 & 0xFF), (unsigned char)(color0 >> 8),
+                                  (unsigned char)(color1 & 0xFF), (unsigned char)(color1 >> 8),
+                                  0xE4, 0x00, 0x00, 0x00}; // first four pixels use the indices 0, 1, 2, 3
+        uint32_t pixels[16];
+        referenceColorBlock(block, fourColors, pixels);
+        memcpy(palette, pixels, 16);
+#endif
+    }
+
+    /** Builds the 8 entry alpha palette of a DXT5 block */
+    void alphaPalette(unsigned int alpha0, unsigned int alpha1, unsigned char palette[8]) {
+#ifdef TEXTURE_DECODER_SSE2
+        __m128i a0 = _mm_set1_epi16(short(alpha0)), a1 = _mm_set1_epi16(short(alpha1));
+        __m128i result;
+        if (alpha0 > alpha1) {
+            // 7 steps, x * 9363 >> 16 is an exact division by 7 for x <= 1785
+            __m128i sum = _mm_add_epi16(_mm_mullo_epi16(a0, _mm_setr_epi16(7, 0, 6, 5, 4, 3, 2, 1)),
+                                        _mm_mullo_epi16(a1, _mm_setr_epi16(0, 7, 1, 2, 3, 4, 5, 6)));
+            result = _mm_mulhi_epu16(sum, _mm_set1_epi16(9363));
+        } else {
+            // 5 steps plus 0 and 255, x * 13108 >> 16 is an exact division by 5 for x <= 1275
+            __m128i sum = _mm_add_epi16(_mm_mullo_epi16(a0, _mm_setr_epi16(5, 0, 4, 3, 2, 1, 0, 0)),
+                                        _mm_mullo_epi16(a1, _mm_setr_epi16(0, 5, 1, 2, 3, 4, 0, 0)));
+            result = _mm_or_si128(_mm_mulhi_epu16(sum, _mm_set1_epi16(13108)), _mm_setr_epi16(0, 0, 0, 0, 0, 0, 0, 255));
+        }
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(palette), _mm_packus_epi16(result, result));
+#else
+        palette[0] = alpha0;
+        palette[1] = alpha1;
+        if (alpha0 > alpha1) {
+            for (unsigned int k = 1; k < 7; ++k) palette[k + 1] = ((7 - k) * alpha0 + k * alpha1) / 7;
+        } else {
+            for (unsigned int k = 1; k < 5; ++k) palette[k + 1] = ((5 - k) * alpha0 + k * alpha1) / 5;
+            palette[6] = 0;
+            palette[7] = 255;
+        }
+#endif
+    }
+
+    /** Decodes one block, alpha is merged into the color palette lookups row by row */
+    void decodeBlock(GLenum format, const unsigned char *in, unsigned char *out, size_t rowPitch) {
+        const unsigned char *colorBlock = format == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT ? in : in + 8;
+        uint16_t color0 = readUInt16(colorBlock), color1 = readUInt16(colorBlock + 2);
+        uint32_t indices = readUInt32(colorBlock + 4);
+
+        alignas(16) uint32_t palette[4];
+        colorPalette(color0, color1, format != GL_COMPRESSED_RGBA_S3TC_DXT1_EXT || color0 > color1, palette);
+
+        alignas(16) uint32_t alpha[16];
+        bool hasAlpha = format != GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+        if (format == GL_COMPRESSED_RGBA_S3TC_DXT3_EXT) {
+            for (unsigned int i = 0; i < 16; ++i) alpha[i] = uint32_t(((in[i / 2] >> ((i & 1) * 4)) & 15) * 17) << 24;
+        } else if (format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT) {
+            unsigned char alphaValues[8];
+            alphaPalette(in[0], in[1], alphaValues);
+            uint64_t alphaIndices = readUInt48(in + 2);
+            for (unsigned int i = 0; i < 16; ++i) alpha[i] = uint32_t(alphaValues[(alphaIndices >> (i * 3)) & 7]) << 24;
+        }
+
+        for (unsigned int py = 0; py < 4; ++py) {
+            unsigned int rowIndices = indices >> (py * 8);
+#ifdef TEXTURE_DECODER_SSE2
+            __m128i row = _mm_setr_epi32(int(palette[rowIndices & 3]), int(palette[(rowIndices >> 2) & 3]),
+                                         int(palette[(rowIndices >> 4) & 3]), int(palette[(rowIndices >> 6) & 3]));
+            if (hasAlpha) {
+                row = _mm_or_si128(_mm_and_si128(row, _mm_set1_epi32(0x00FFFFFF)),
+                                   _mm_load_si128(reinterpret_cast<const __m128i *>(&alpha[py * 4])));
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + py * rowPitch), row);
+#else
+            uint32_t row[4];
+            for (unsigned int px = 0; px < 4; ++px) {
+                row[px] = palette[(rowIndices >> (px * 2)) & 3];
+                if (hasAlpha) row[px] = (row[px] & 0x00FFFFFF) | alpha[py * 4 + px];
+            }
+            memcpy(out + py * rowPitch, row, 16);
+#endif
+        }
+    }
+}
+
+bool TextureDecoder::isS3TC(GLenum format) {
+    return format == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT || format == GL_COMPRESSED_RGBA_S3TC_DXT3_EXT ||
+           format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+}
+
+void TextureDecoder::decode(GLenum format, const unsigned char *blocks, unsigned int width, unsigned int height,
+                            unsigned char *rgba) {
+    if (!isS3TC(format)) return;
+    unsigned int blocksX = (width + 3) / 4;
+    unsigned int blocksY = (height + 3) / 4;
+    unsigned int blockSize = format == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT ? 8 : 16;
+    size_t rowPitch = size_t(width) * 4;
+
+    // hand out roughly 1024 blocks per job so small mip levels do not drown in scheduling overhead
+    unsigned int rowsPerJob = std::max(1u, 1024u / std::max(blocksX, 1u));
+    JobSystem::parallelFor(blocksY, rowsPerJob, [&](unsigned int begin, unsigned int end) {
+        alignas(16) uint32_t clipped[16];
+        for (unsigned int blockY = begin; blockY < end; ++blockY) {
+            for (unsigned int blockX = 0; blockX < blocksX; ++blockX) {
+                const unsigned char *in = blocks + (size_t(blockY) * blocksX + blockX) * blockSize;
+                if (blockX * 4 + 4 <= width && blockY * 4 + 4 <= height) {
+                    decodeBlock(format, in, rgba + size_t(blockY * 4) * rowPitch + blockX * 16, rowPitch);
+                } else {
+                    // partial block at the right or bottom border
+                    decodeBlock(format, in, reinterpret_cast<unsigned char *>(clipped), 16);
+                    storeClipped(clipped, blockX, blockY, width, height, rgba);
+                }
+            }
+        }
+    });
+}
+
+void TextureDecoder::decodeReference(GLenum format, const unsigned char *blocks, unsigned int width,
+                                     unsigned int height, unsigned char *rgba) {
+    if (!isS3TC(format)) return;
+    unsigned int blocksX = (width + 3) / 4;
+    unsigned int blocksY = (height + 3) / 4;
+    unsigned int blockSize = format == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT ? 8 : 16;
+
+    for (unsigned int blockY = 0; blockY < blocksY; ++blockY) {
+        for (unsigned int blockX = 0; blockX < blocksX; ++blockX) {
+            const unsigned char *in = blocks + (size_t(blockY) * blocksX + blockX) * blockSize;
+            uint32_t pixels[16];
+            switch (format) {
+                case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+                    referenceColorBlock(in, false, pixels);
+                    break;
+                case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+                    referenceColorBlock(in + 8, true, pixels);
+                    referenceExplicitAlpha(in, pixels);
+                    break;
+                default:
+                    referenceColorBlock(in + 8, true, pixels);
+                    referenceInterpolatedAlpha(in, pixels);
+                    break;
+            }
+            storeClipped(pixels, blockX, blockY, width, height, rgba);
+        }
+    }
+}
@@ -0,0 +1,40 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#ifndef TEXTUREDECODER_H
+#define TEXTUREDECODER_H
+#include <glad/gl.h>
+
+
+/** Software decoder for S3TC (DXT1/DXT3/DXT5) blocks
+ *
+ *  Used when the context does not expose EXT_texture_compression_s3tc, the blocks are transcoded to RGBA8
+ *  and uploaded uncompressed. Pixel rows are written in block order (the row order of the .DDS file).
+ */
+class TextureDecoder {
+public:
+    /** @returns true if format is one of the GL_COMPRESSED_RGBA_S3TC_DXT*_EXT formats */
+    static bool isS3TC(GLenum format);
+
+    /** Decodes a full mip level on the worker threads, using SSE2 when available
+     *
+     *  @param[in] format GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, _DXT3_EXT or _DXT5_EXT
+     *  @param[in] blocks Compressed data of the level
+     *  @param[in] width Width of the level in pixels
+     *  @param[in] height Height of the level in pixels
+     *  @param[out] rgba Output buffer of width * height * 4 bytes
+     */
+    static void decode(GLenum format, const unsigned char *blocks, unsigned int width, unsigned int height,
+                       unsigned char *rgba);
+
+    /** Straight forward scalar implementation following the EXT_texture_compression_s3tc spec,
+     *  kept as reference for decode()
+     */
+    static void decodeReference(GLenum format, const unsigned char *blocks, unsigned int width, unsigned int height,
+                                unsigned char *rgba);
+};
+
+
+
+#endif //TEXTUREDECODER_H
@@ -7,146 +7,363 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <algorithm>
+#include <bit>
 
-GLuint Textures::loadBMP(const char *filename) {
-    // Data from the header of the BMP file
-    unsigned char header[54]; // each file has a 54 byte header
-    unsigned int dataPosition; // Position of the actual data in the file
-    unsigned int width, height;
-    unsigned int imageSize; // should just be = width * height * 3
-    unsigned char *data; // Actual RGB data from file
-
-    // Open the file
-    FILE *file = fopen(filename, "rb");
-    if (!file) {printf("Image file could not be opened\n"); return 0;}
-
-    // check if we can read the header section
-    if( fread(header, 1, 54, file) != 54) {printf("Header could not be read. Not a correct BMP file\n"); return 0;}
-
-    // check if the header identifier is correct
-    if (header[0] != 'B' || header[1] != 'M') {
-        printf("Not a valid BMP file\n");
-        return 0;
+#include "Assets.hpp"
+#include "KTX2Stream.hpp"
+#include "Memory.hpp"
+#include "TextureDecoder.hpp"
+
+/** Reads an uncompressed 24 or 32 bit .BMP File into memory
+ *
+ *  @param[in] filename The path to the file
+ *  @param[out] image The decoded RGBA pixels (alpha is 255 for 24 bit files)
+ *  @returns true if the file could be read
+ */
+bool Textures::decodeBMP(const char *filename, Image &image) {
+    AssetData file;
+    if (!Assets::open(filename, file)) {printf("Image file could not be opened\n"); return false;}
+    return decodeBMP(file, image);
+}
+
+namespace {
+    /** Pixel layout of a validated .BMP file */
+    struct BMPLayout {
+        unsigned int dataPosition;
+        int width, height;
+        unsigned int bytesPerPixel;
+        size_t rowSize;
+        bool topDown;
+        bool masked;                // BI_BITFIELDS with a channel order other than BGRA
+        unsigned int masks[4];      // red, green, blue and alpha bits of a masked pixel, alpha may be 0
+    };
+
+    /** Checks that a BI_BITFIELDS mask is one contiguous run of bits, an empty mask reads as 0 */
+    bool validMask(unsigned int mask) {
+        if (mask == 0) return true;
+        unsigned int shifted = mask >> std::countr_zero(mask);
+        return (shifted & (shifted + 1)) == 0;
     }
 
-    // read the header data from the buffer
-    dataPosition = *(int*)&(header[0x0A]);
-    imageSize = *(int*)&(header[0x22]);
-    width = *(int*)&(header[0x12]);
-    height = *(int*)&(header[0x16]);
+    /** Extracts the channel of a mask from a pixel and scales it to 8 bits */
+    unsigned char maskedChannel(unsigned int pixel, unsigned int mask) {
+        if (mask == 0) return 0;
+        unsigned int shift = std::countr_zero(mask);
+        unsigned int bits = std::popcount(mask);
+        unsigned int value = (pixel & mask) >> shift;
+        if (bits >= 8) return (unsigned char)(value >> (bits - 8));
+        return (unsigned char)(value * 255 / ((1u << bits) - 1));
+    }
 
-    // some files are misformatted, so try to guess some values
-    if (imageSize == 0) imageSize = width * height * 3; // one byte for each red, green and blue
-    if (dataPosition == 0) dataPosition = 54;
+    bool readBMPHeader(const AssetData &file, BMPLayout &layout) {
+        // each file has a 54 byte header
+        if (file.size() < 54) {printf("Header could not be read. Not a correct BMP file\n"); return false;}
+        const unsigned char *header = file.data();
 
-    data = new unsigned char[imageSize];
+        // check if the header identifier is correct
+        if (header[0] != 'B' || header[1] != 'M') {
+            printf("Not a valid BMP file\n");
+            return false;
+        }
 
-    fread(data, 1, imageSize, file);
+        // read the header data from the buffer, the fields are not aligned in the mapped file
+        unsigned short bitsPerPixel;
+        unsigned int compression, headerSize;
+        memcpy(&headerSize, header + 0x0E, 4);
+        memcpy(&layout.dataPosition, header + 0x0A, 4);
+        memcpy(&layout.width, header + 0x12, 4);
+        memcpy(&layout.height, header + 0x16, 4);
+        memcpy(&bitsPerPixel, header + 0x1C, 2);
+        memcpy(&compression, header + 0x1E, 4);
 
-    fclose(file);
+        if ((bitsPerPixel != 24 && bitsPerPixel != 32) || (compression != 0 && compression != 3) || layout.width <= 0 ||
+            layout.height == 0) {
+            printf("Only uncompressed 24 and 32 bit BMP files are supported\n");
+            return false;
+        }
 
-    // create an OpenGL texture
-    GLuint textureID;
-    glGenTextures(1, &textureID);
+        // BI_BITFIELDS stores the channel masks behind the info header, the alpha mask only in the V3 header and later
+        layout.masked = false;
+        if (compression == 3) {
+            if (bitsPerPixel != 32 || file.size() < 0x42) {
+                printf("Only 32 bit BMP files are supported with channel masks\n");
+                return false;
+            }
+            memcpy(layout.masks, header + 0x36, 12);
+            layout.masks[3] = 0;
+            if (headerSize >= 56 && file.size() >= 0x46) memcpy(&layout.masks[3], header + 0x42, 4);
+            for (unsigned int mask : layout.masks) {
+                if (!validMask(mask)) {
+                    printf("BMP channel mask 0x%08x is not contiguous\n", mask);
+                    return false;
+                }
+            }
+            // the common layout takes the plain byte copy below
+            layout.masked = layout.masks[0] != 0x00FF0000 || layout.masks[1] != 0x0000FF00 ||
+                            layout.masks[2] != 0x000000FF || layout.masks[3] != 0xFF000000;
+        }
 
-    // Bind the new texture
-    glBindTexture(GL_TEXTURE_2D, textureID);
+        // some files are misformatted, so try to guess some values
+        if (layout.dataPosition == 0) layout.dataPosition = 54;
 
-    // give the image to opengl
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_BGR, GL_UNSIGNED_BYTE, data);
+        // negative height marks a top down image
+        layout.topDown = layout.height < 0;
+        if (layout.topDown) layout.height = -layout.height;
 
-    // delete data has it is no longer needed
-    delete[] data;
+        layout.bytesPerPixel = bitsPerPixel / 8;
+        layout.rowSize = (size_t(layout.width) * layout.bytesPerPixel + 3) & ~size_t(3); // rows are padded to 4 bytes
+        if (layout.dataPosition > file.size() || layout.rowSize * layout.height > file.size() - layout.dataPosition) {
+            printf("BMP pixel data is truncated\n");
+            return false;
+        }
+        return true;
+    }
 
-    // Poor filtering ...
-    //glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    //glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    /** Converts the rows to bottom to top RGBA, pixels holds width * height * 4 bytes */
+    void convertBMP(const AssetData &file, const BMPLayout &layout, unsigned char *pixels) {
+        // the rows are read straight from the mapped file
+        for (int y = 0; y < layout.height; ++y) {
+            const unsigned char *row = file.data() + layout.dataPosition + layout.rowSize * y;
+            unsigned char *dst = pixels + size_t(layout.topDown ? layout.height - 1 - y : y) * layout.width * 4;
+            if (layout.masked) {
+                for (int x = 0; x < layout.width; ++x) {
+                    unsigned int pixel;
+                    memcpy(&pixel, &row[x * 4], 4);
+                    dst[x * 4 + 0] = maskedChannel(pixel, layout.masks[0]);
+                    dst[x * 4 + 1] = maskedChannel(pixel, layout.masks[1]);
+                    dst[x * 4 + 2] = maskedChannel(pixel, layout.masks[2]);
+                    dst[x * 4 + 3] = layout.masks[3] ? maskedChannel(pixel, layout.masks[3]) : 255;
+                }
+                continue;
+            }
+            for (int x = 0; x < layout.width; ++x) {
+                const unsigned char *src = &row[x * layout.bytesPerPixel];
+                dst[x * 4 + 0] = src[2];
+                dst[x * 4 + 1] = src[1];
+                dst[x * 4 + 2] = src[0];
+                dst[x * 4 + 3] = layout.bytesPerPixel == 4 ? src[3] : 255;
+            }
+        }
+    }
 
-    // Far Better Trilinear Filtering
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    // generate mipmaps automatically
-    glGenerateMipmap(GL_TEXTURE_2D);
+    GLuint uploadRGBA(unsigned int width, unsigned int height, const unsigned char *pixels) {
+        // create an OpenGL texture
+        GLuint textureID;
+        glGenTextures(1, &textureID);
 
-    // return the id for the texture
-    return textureID;
+        // Bind the new texture
+        glBindTexture(GL_TEXTURE_2D, textureID);
+
+        // give the image to opengl
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+
+        // Poor filtering ...
+        //glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        //glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+        // Far Better Trilinear Filtering
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        // generate mipmaps automatically
+        glGenerateMipmap(GL_TEXTURE_2D);
+
+        // return the id for the texture
+        return textureID;
+    }
+}
+
+/** Decodes a .BMP file that is already in memory (mapped file, archive entry or a buffer view of a model) */
+bool Textures::decodeBMP(const AssetData &file, Image &image) {
+    BMPLayout layout;
+    if (!readBMPHeader(file, layout)) return false;
+    image.width = layout.width;
+    image.height = layout.height;
+    image.pixels.resize(size_t(layout.width) * layout.height * 4);
+    convertBMP(file, layout, image.pixels.data());
+    return true;
+}
+
+/** Loads a .BMP file into an OpenGL texture, the decoded pixels only live on the scratch stack until the upload */
+GLuint Textures::loadBMP(const char *filename) {
+    AssetData file;
+    if (!Assets::open(filename, file)) {printf("Image file could not be opened\n"); return 0;}
+    BMPLayout layout;
+    if (!readBMPHeader(file, layout)) return 0;
+    ScratchScope scratch;
+    unsigned char *pixels = scratch.allocateArray<unsigned char>(size_t(layout.width) * layout.height * 4);
+    convertBMP(file, layout, pixels);
+    return uploadRGBA(layout.width, layout.height, pixels);
+}
+
+/** Creates an OpenGL texture with a full mip chain from decoded pixels
+ *
+ *  @param[in] image The RGBA pixels
+ *  @returns OpenGL ID for the texture
+ */
+GLuint Textures::createTexture(const Image &image) {
+    return uploadRGBA(image.width, image.height, image.pixels.data());
 }
 
 #define FOURCC_DXT1 0x31545844 // Equivalent to "DXT1" in ASCII
 #define FOURCC_DXT3 0x33545844 // Equivalent to "DXT3" in ASCII
 #define FOURCC_DXT5 0x35545844 // Equivalent to "DXT5" in ASCII
+#define FOURCC_DX10 0x30315844 // Equivalent to "DX10" in ASCII, followed by an extended header
 
-/** Loads OpenGL Texture from .DDS File
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C // core since OpenGL 4.2 / ARB_texture_compression_bptc
+#endif
+
+/** Reads a .DDS File into memory without creating an OpenGL texture
  *
- *  @param[in] filename The absolute path to the file
- *  @returns OpenGL ID for the loaded texture
- *  @note The loaded texture is inverted (DXT compression), to correctly display texture invert all uv.v coordinates
+ *  @param[in] filename The path to the file
+ *  @param[out] image Format, size and the packed block data of all mip levels
+ *  @returns true if the file holds one of the supported block formats (DXT1/3/5, BC7)
  */
-GLuint Textures::loadDDS(const char *filename) {
-    unsigned char header[124];
-    FILE *file = fopen(filename, "rb");
-    if (!file) {printf("Image file could not be opened\n"); return 0;}
-
-    char filecode[4];
-    fread(filecode, 1, 4, file);
-    if(strcmp(filecode, "DDS ") != 0) {
-        fclose(file);
-        return 0;
-    }
+bool Textures::decodeDDS(const char *filename, CompressedImage &image) {
+    AssetData file;
+    if (!Assets::open(filename, file)) {printf("Image file could not be opened\n"); return false;}
+    return decodeDDS(file, image);
+}
 
-    fread(&header, 124, 1, file);
+/** Decodes a .DDS file that is already in memory, image.data keeps referencing the given view */
+bool Textures::decodeDDS(const AssetData &file, CompressedImage &image) {
+    // the magic is not null terminated, compare the raw bytes
+    if (file.size() < 128 || memcmp(file.data(), "DDS ", 4) != 0) {
+        printf("Not a valid DDS file\n");
+        return false;
+    }
+    const unsigned char *header = file.data() + 4;
+    size_t dataPosition = 128;
 
     unsigned int height = *(unsigned int*)&(header[8]);
     unsigned int width = *(unsigned int*)&(header[12]);
-    unsigned int linearSize = *(unsigned int*)&(header[16]);
     unsigned int mipMapCount = *(unsigned int*)&(header[24]);
     unsigned int fourCC = *(unsigned int*)&(header[80]);
 
-    unsigned char* buffer;
-    unsigned int bufferSize;
-
-    bufferSize = mipMapCount > 1 ? linearSize * 2 : linearSize;
-    buffer = (unsigned char*)malloc(bufferSize * sizeof(unsigned char));
-    fread(buffer, 1, bufferSize, file);
-    fclose(file);
-
-    unsigned int components = (fourCC == FOURCC_DXT1) ? 4 : 3;
-    unsigned int format;
+    // the DX10 header stores the format as DXGI_FORMAT, map the block formats we know back to their fourCC
+    unsigned int dxgiFormat = 0;
+    if (fourCC == FOURCC_DX10) {
+        if (file.size() >= dataPosition + 20) dxgiFormat = *(unsigned int*)&(file.data()[dataPosition]);
+        dataPosition += 20;
+        if (dxgiFormat == 71 || dxgiFormat == 72) fourCC = FOURCC_DXT1;
+        else if (dxgiFormat == 74 || dxgiFormat == 75) fourCC = FOURCC_DXT3;
+        else if (dxgiFormat == 77 || dxgiFormat == 78) fourCC = FOURCC_DXT5;
+    }
 
     switch (fourCC) {
         case FOURCC_DXT1:
-            format = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
-        break;
+            image.format = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+            break;
         case FOURCC_DXT3:
-            format = GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
+            image.format = GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
             break;
         case FOURCC_DXT5:
-            format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+            image.format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
             break;
+        case FOURCC_DX10:
+            // BC7 (DXGI_FORMAT_BC7_UNORM) as written by TextureCompressor
+            if (dxgiFormat == 98) {
+                image.format = GL_COMPRESSED_RGBA_BPTC_UNORM;
+                break;
+            }
+            [[fallthrough]];
         default:
-            free(buffer);
-        return 0;
+            printf("Unsupported DDS format\n");
+            return false;
     }
 
+    image.width = width;
+    image.height = height;
+    image.blockSize = (image.format == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT) ? 8 : 16;
+    image.mipMapCount = std::max(mipMapCount, 1u);
+
+    // exactly the levels the header announces, the blocks stay in the mapped file
+    size_t bufferSize = 0;
+    for (unsigned int level = 0; level < image.mipMapCount; ++level) bufferSize += image.levelSize(level);
+    if (dataPosition > file.size() || bufferSize > file.size() - dataPosition) {
+        printf("DDS file is truncated\n");
+        return false;
+    }
+    image.data = file.slice(dataPosition, bufferSize);
+    return true;
+}
+
+size_t CompressedImage::levelSize(unsigned int level) const {
+    unsigned int levelWidth = std::max(width >> level, 1u);
+    unsigned int levelHeight = std::max(height >> level, 1u);
+    return size_t((levelWidth + 3) / 4) * ((levelHeight + 3) / 4) * blockSize;
+}
+
+/** @returns true if the current context can sample DXT1/3/5 textures directly */
+bool Textures::hasS3TC() {
+    return GLAD_GL_EXT_texture_compression_s3tc != 0;
+}
+
+/** Loads OpenGL Texture from .DDS File
+ *
+ *  @param[in] filename The absolute path to the file
+ *  @returns OpenGL ID for the loaded texture
+ *  @note The loaded texture is inverted (DXT compression), to correctly display texture invert all uv.v coordinates
+ *  @note Without EXT_texture_compression_s3tc the blocks are decoded on the CPU and uploaded as RGBA8
+ */
+GLuint Textures::loadDDS(const char *filename) {
+    CompressedImage image;
+    if (!decodeDDS(filename, image)) return 0;
+    return createTexture(image);
+}
+
+/** Creates an OpenGL texture from block compressed data, S3TC is transcoded if the context cannot sample it
+ *
+ *  @param[in] image Format, size and all mip levels
+ *  @returns OpenGL ID for the texture
+ */
+GLuint Textures::createTexture(const CompressedImage &image) {
     // Create OpenGL Texture
     GLuint textureID;
     glGenTextures(1,&textureID);
     glBindTexture(GL_TEXTURE_2D, textureID);
 
-    unsigned int blockSize = (format == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT) ? 8 : 16;
-    unsigned int offset = 0;
+    bool transcode = TextureDecoder::isS3TC(image.format) && !hasS3TC();
+    // level 0 is the largest, the buffer is reused for all levels
+    ScratchScope scratch;
+    unsigned char *decoded = transcode ? scratch.allocateArray<unsigned char>(size_t(image.width) * image.height * 4) : nullptr;
+
+    unsigned int width = image.width;
+    unsigned int height = image.height;
+    size_t offset = 0;
 
     // load the mipmaps
-    for(unsigned int level = 0; level < mipMapCount && (width || height); ++level) {
-        unsigned int size = ((width+3)/4) * ((height+3)/4) * blockSize;
-        glCompressedTexImage2D(GL_TEXTURE_2D, level, format, width, height, 0, size, buffer + offset);
+    for(unsigned int level = 0; level < image.mipMapCount; ++level) {
+        size_t size = image.levelSize(level);
+        if (transcode) {
+            TextureDecoder::decode(image.format, image.data.data() + offset, width, height, decoded);
+            glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, decoded);
+        } else {
+            glCompressedTexImage2D(GL_TEXTURE_2D, level, image.format, width, height, 0, size, image.data.data() + offset);
+        }
         offset += size;
-        width /= 2;
-        height /= 2;
+        width = std::max(width / 2, 1u);
+        height = std::max(height / 2, 1u);
     }
-    free(buffer);
+
+    // files without a full mip chain would otherwise be incomplete with the default minification filter
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, image.mipMapCount - 1);
 
     return textureID;
-}
\ No newline at end of file
+}
+
+/** Loads OpenGL Texture from .KTX2 File
+ *
+ *  @param[in] filename The path to the file
+ *  @returns OpenGL ID for the loaded texture, bound to the target stored in the file (2D, array, cube or 3D)
+ *  @note Blocks until all levels are resident, use KTX2Stream directly to upload the levels over several frames
+ */
+GLuint Textures::loadKTX2(const char *filename) {
+    KTX2Stream stream;
+    if (!stream.open(filename)) return 0;
+    stream.upload(0, true);
+    return stream.texture();
+}
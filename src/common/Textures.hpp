@@ -5,12 +5,49 @@
 #ifndef TEXTURES_H
 #define TEXTURES_H
 #include<glad/gl.h>
+#include <cstddef>
+#include <vector>
 
+#include "Assets.hpp"
+
+
+/** CPU side image, 4 bytes (RGBA) per pixel, rows stored bottom to top like OpenGL expects them */
+struct Image {
+    unsigned int width = 0;
+    unsigned int height = 0;
+    std::vector<unsigned char> pixels;
+};
+
+/** Block compressed image as stored in a .DDS file, the mip levels are packed back to back in data
+ *  (a view into the mapped file or archive entry)
+ */
+struct CompressedImage {
+    GLenum format = 0;
+    unsigned int width = 0;
+    unsigned int height = 0;
+    unsigned int mipMapCount = 0;
+    unsigned int blockSize = 0;
+    AssetData data;
+
+    /** @returns Size in bytes of the given mip level */
+    size_t levelSize(unsigned int level) const;
+};
 
 class Textures {
 public:
     static GLuint loadBMP(const char * filename);
     static GLuint loadDDS(const char * filename);
+    static GLuint loadKTX2(const char * filename);
+
+    static bool decodeBMP(const char * filename, Image &image);
+    static bool decodeDDS(const char * filename, CompressedImage &image);
+    static bool decodeBMP(const AssetData &file, Image &image);
+    static bool decodeDDS(const AssetData &file, CompressedImage &image);
+
+    static GLuint createTexture(const Image &image);
+    static GLuint createTexture(const CompressedImage &image);
+
+    static bool hasS3TC();
 };
 
 
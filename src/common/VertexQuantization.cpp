@@ -0,0 +1,158 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#include "VertexQuantization.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "JobSystem.hpp"
+
+namespace {
+    constexpr double PI = 3.14159265358979323846;
+
+    /** Normalized position of value inside [offset, offset + scale], a zero scale maps everything to 0 */
+    float normalize(float value, float scale, float offset) {
+        return scale != 0.0f ? (value - offset) / scale : 0.0f;
+    }
+}
+
+uint16_t VertexQuantization::toUnorm16(float value) {
+    return uint16_t(std::lround(std::clamp(value, 0.0f, 1.0f) * 65535.0f));
+}
+
+uint8_t VertexQuantization::toUnorm8(float value) {
+    return uint8_t(std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+}
+
+void VertexQuantization::encodeOctahedral(const float normal[3], uint16_t encoded[2]) {
+    // project onto the octahedron |x| + |y| + |z| = 1 and fold the lower half over the diagonals
+    float length = std::fabs(normal[0]) + std::fabs(normal[1]) + std::fabs(normal[2]);
+    float x = length > 0.0f ? normal[0] / length : 0.0f;
+    float y = length > 0.0f ? normal[1] / length : 0.0f;
+    if (length > 0.0f && normal[2] < 0.0f) {
+        float foldedX = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float foldedY = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = foldedX;
+        y = foldedY;
+    }
+    encoded[0] = toUnorm16(x * 0.5f + 0.5f);
+    encoded[1] = toUnorm16(y * 0.5f + 0.5f);
+}
+
+void VertexQuantization::decodeOctahedral(const uint16_t encoded[2], float normal[3]) {
+    // same math as decodeOctahedral() in MeshShader.vert
+    float x = float(encoded[0]) / 65535.0f * 2.0f - 1.0f;
+    float y = float(encoded[1]) / 65535.0f * 2.0f - 1.0f;
+    float z = 1.0f - std::fabs(x) - std::fabs(y);
+    if (z < 0.0f) {
+        float unfoldedX = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float unfoldedY = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = unfoldedX;
+        y = unfoldedY;
+    }
+    float length = std::sqrt(x * x + y * y + z * z);
+    normal[0] = x / length;
+    normal[1] = y / length;
+    normal[2] = z / length;
+}
+
+VertexDecode VertexQuantization::decodeFor(const MeshData &mesh) {
+    VertexDecode decode;
+    decode.octahedralNormals = true;
+    for (int axis = 0; axis < 3; ++axis) {
+        decode.positionOffset[axis] = mesh.boundsMin[axis];
+        decode.positionScale[axis] = mesh.boundsMax[axis] - mesh.boundsMin[axis];
+    }
+    if (mesh.vertices.empty()) return decode;
+
+    float uvMin[2] = {mesh.vertices[0].uv[0], mesh.vertices[0].uv[1]};
+    float uvMax[2] = {uvMin[0], uvMin[1]};
+    for (const Vertex &vertex : mesh.vertices) {
+        for (int i = 0; i < 2; ++i) {
+            uvMin[i] = std::min(uvMin[i], vertex.uv[i]);
+            uvMax[i] = std::max(uvMax[i], vertex.uv[i]);
+        }
+    }
+    for (int i = 0; i < 2; ++i) {
+        decode.uvOffset[i] = uvMin[i];
+        decode.uvScale[i] = uvMax[i] - uvMin[i];
+    }
+    return decode;
+}
+
+void VertexQuantization::quantize(const MeshData &mesh, const VertexDecode &decode, std::vector<QuantizedVertex> &vertices) {
+    vertices.resize(mesh.vertices.size());
+    JobSystem::parallelFor(unsigned(mesh.vertices.size()), 65536, [&](unsigned int begin, unsigned int end) {
+        for (unsigned int i = begin; i < end; ++i) {
+            const Vertex &in = mesh.vertices[i];
+            QuantizedVertex &out = vertices[i];
+            for (int axis = 0; axis < 3; ++axis)
+                out.position[axis] = toUnorm16(normalize(in.position[axis], decode.positionScale[axis], decode.positionOffset[axis]));
+            out.position[3] = 0;
+            encodeOctahedral(in.normal, out.normal);
+            for (int c = 0; c < 2; ++c) out.uv[c] = toUnorm16(normalize(in.uv[c], decode.uvScale[c], decode.uvOffset[c]));
+        }
+    });
+}
+
+void VertexQuantization::dequantize(const QuantizedVertex &in, const VertexDecode &decode, Vertex &out) {
+    for (int axis = 0; axis < 3; ++axis)
+        out.position[axis] = decode.positionOffset[axis] + float(in.position[axis]) / 65535.0f * decode.positionScale[axis];
+    decodeOctahedral(in.normal, out.normal);
+    for (int c = 0; c < 2; ++c) out.uv[c] = decode.uvOffset[c] + float(in.uv[c]) / 65535.0f * decode.uvScale[c];
+}
+
+VertexQuantization::Error VertexQuantization::measureError(const MeshData &mesh, const std::vector<QuantizedVertex> &vertices,
+                                                           const VertexDecode &decode) {
+    Error error;
+    double minDot = 1.0;
+    for (size_t i = 0; i < mesh.vertices.size() && i < vertices.size(); ++i) {
+        const Vertex &reference = mesh.vertices[i];
+        Vertex decoded;
+        dequantize(vertices[i], decode, decoded);
+        double distance = 0.0, dot = 0.0;
+        for (int axis = 0; axis < 3; ++axis) {
+            double d = double(decoded.position[axis]) - reference.position[axis];
+            distance += d * d;
+            dot += double(decoded.normal[axis]) * reference.normal[axis];
+        }
+        error.position = std::max(error.position, std::sqrt(distance));
+        minDot = std::min(minDot, dot);
+        for (int c = 0; c < 2; ++c) error.uv = std::max(error.uv, std::fabs(double(decoded.uv[c]) - reference.uv[c]));
+    }
+
+    double diagonal = 0.0;
+    for (int axis = 0; axis < 3; ++axis) diagonal += double(decode.positionScale[axis]) * decode.positionScale[axis];
+    diagonal = std::sqrt(diagonal);
+    error.positionRelative = diagonal > 0.0 ? error.position / diagonal : 0.0;
+    error.normalDegrees = std::acos(std::clamp(minDot, -1.0, 1.0)) * 180.0 / PI;
+    return error;
+}
+
+std::vector<uint16_t> VertexQuantization::quantizeUnorm16(const float *values, size_t count, unsigned int components,
+                                                          float *scale, float *offset) {
+    for (unsigned int c = 0; c < components; ++c) {
+        float low = count ? values[c] : 0.0f, high = low;
+        for (size_t i = 1; i < count; ++i) {
+            low = std::min(low, values[i * components + c]);
+            high = std::max(high, values[i * components + c]);
+        }
+        offset[c] = low;
+        scale[c] = high - low;
+    }
+
+    std::vector<uint16_t> quantized(count * components);
+    for (size_t i = 0; i < quantized.size(); ++i) {
+        size_t c = i % components;
+        quantized[i] = toUnorm16(normalize(values[i], scale[c], offset[c]));
+    }
+    return quantized;
+}
+
+std::vector<uint8_t> VertexQuantization::quantizeUnorm8(const float *values, size_t count) {
+    std::vector<uint8_t> quantized(count);
+    for (size_t i = 0; i < count; ++i) quantized[i] = toUnorm8(values[i]);
+    return quantized;
+}
@@ -0,0 +1,69 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#ifndef VERTEXQUANTIZATION_H
+#define VERTEXQUANTIZATION_H
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Meshes.hpp"
+
+
+/** Quantized counterpart of Vertex (16 instead of 32 bytes)
+ *
+ *  position  unorm16 x3 relative to the mesh bounds (the 4th component keeps the normal 4 byte aligned)
+ *  normal    unorm16 x2 octahedral encoding
+ *  uv        unorm16 x2 relative to the uv range of the mesh
+ */
+struct QuantizedVertex {
+    uint16_t position[4];
+    uint16_t normal[2];
+    uint16_t uv[2];
+};
+static_assert(sizeof(QuantizedVertex) == 16, "QuantizedVertex is uploaded as is");
+
+/** Conversion of float vertex data to normalized integer formats and back
+ *
+ *  Everything decodes through the fixed function normalization of glVertexAttribPointer plus the VertexDecode
+ *  uniforms, the vertex shader only adds one multiply-add per attribute (and the octahedral decode for normals).
+ */
+class VertexQuantization {
+public:
+    /** Worst case deviation of a quantized mesh from its float source */
+    struct Error {
+        double position = 0.0;         // object space units
+        double positionRelative = 0.0; // position error divided by the bounds diagonal
+        double normalDegrees = 0.0;
+        double uv = 0.0;
+    };
+
+    static uint16_t toUnorm16(float value);
+    static uint8_t toUnorm8(float value);
+    static void encodeOctahedral(const float normal[3], uint16_t encoded[2]);
+    static void decodeOctahedral(const uint16_t encoded[2], float normal[3]);
+
+    /** @returns The decode uniforms mapping the bounds and uv range of a mesh to [0, 1] */
+    static VertexDecode decodeFor(const MeshData &mesh);
+
+    /** Quantizes all vertices of a mesh with the range from decodeFor() */
+    static void quantize(const MeshData &mesh, const VertexDecode &decode, std::vector<QuantizedVertex> &vertices);
+    static void dequantize(const QuantizedVertex &in, const VertexDecode &decode, Vertex &out);
+    static Error measureError(const MeshData &mesh, const std::vector<QuantizedVertex> &vertices, const VertexDecode &decode);
+
+    /** Quantizes a tightly packed float stream (e.g. positions or uvs) to unorm16 relative to its own range
+     *
+     *  @param[in] values count * components floats
+     *  @param[out] scale Per component scale for the decode uniforms
+     *  @param[out] offset Per component offset for the decode uniforms
+     */
+    static std::vector<uint16_t> quantizeUnorm16(const float *values, size_t count, unsigned int components,
+                                                 float *scale, float *offset);
+    /** Quantizes values in [0, 1] (e.g. colors) to unorm8 */
+    static std::vector<uint8_t> quantizeUnorm8(const float *values, size_t count);
+};
+
+
+
+#endif //VERTEXQUANTIZATION_H
@@ -0,0 +1,604 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#include "VoxelWorld.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdio>
+#include <cstring>
+
+#include "JobSystem.hpp"
+#include "shader.hpp"
+
+namespace {
+    constexpr unsigned int N = VoxelWorld::CHUNK_SIZE;
+    // a chunk with the bordering layer of every neighbour around it
+    constexpr unsigned int PADDED = N + 2;
+    constexpr size_t PADDED_VOXELS = size_t(PADDED) * PADDED * PADDED;
+    // the vertex buffer is handed out in multiples of this, so remeshed chunks often fit their old range
+    constexpr uint32_t QUAD_GRANULARITY = 64;
+    constexpr uint32_t NO_ENTRY = 0xffffffffu;
+
+    /** @returns Narrowest index width for a palette: 0, 1, 2, 4, 8 or 16 bits, indices never straddle two words */
+    unsigned int bitsFor(size_t paletteSize) {
+        unsigned int bits = 0;
+        while ((size_t(1) << bits) < paletteSize) bits = bits ? bits * 2 : 1;
+        return bits;
+    }
+
+    size_t wordCount(unsigned int bits) {
+        return size_t(VoxelWorld::CHUNK_VOXELS) * bits / 32;
+    }
+
+    uint32_t readIndex(const uint32_t *words, unsigned int bits, unsigned int voxel) {
+        unsigned int perWord = 32 / bits;
+        return (words[voxel / perWord] >> (voxel % perWord * bits)) & ((1u << bits) - 1u);
+    }
+
+    void writeIndex(uint32_t *words, unsigned int bits, unsigned int voxel, uint32_t entry) {
+        unsigned int perWord = 32 / bits, shift = voxel % perWord * bits;
+        uint32_t &word = words[voxel / perWord];
+        word = (word & ~(((1u << bits) - 1u) << shift)) | (entry << shift);
+    }
+
+    /** Packs CHUNK_VOXELS palette indices into words of bits bits each (bits > 0) */
+    void pack(const uint32_t *entries, unsigned int bits, uint32_t *words) {
+        unsigned int perWord = 32 / bits;
+        for (size_t word = 0; word < wordCount(bits); ++word) {
+            uint32_t packed = 0;
+            for (unsigned int k = 0; k < perWord; ++k) packed |= entries[word * perWord + k] << (k * bits);
+            words[word] = packed;
+        }
+    }
+
+    /** Unpacks a chunk of B bit indices into the interior of a padded block, rows of N voxels along x */
+    template<unsigned int B>
+    void unpackRows(const uint32_t *words, const uint16_t *palette, uint16_t *padded) {
+        constexpr unsigned int PER_WORD = 32 / B;
+        constexpr uint32_t MASK = (1u << B) - 1u;
+        for (unsigned int z = 0; z < N; ++z) {
+            for (unsigned int y = 0; y < N; ++y) {
+                uint16_t *row = padded + (size_t(z + 1) * PADDED + y + 1) * PADDED + 1;
+                for (unsigned int x = 0; x < N; x += PER_WORD) {
+                    uint32_t word = *words++;
+                    for (unsigned int k = 0; k < PER_WORD; ++k) {
+                        row[x + k] = palette[word & MASK];
+                        word >>= B;
+                    }
+                }
+            }
+        }
+    }
+
+    /** Merges the faces of one slice into rectangles of one material, greedily: as wide as possible, then as high
+     *
+     *  @param[in,out] mask N x N materials of the faces (0: no face), cleared
+     *  @param[in] axis Normal axis of the faces, the mask rows run along the next axis, the columns along the one after
+     *  @param[in] plane Position of the slice along the axis, in voxels
+     *  @returns Quads written
+     */
+    unsigned int mergeFaces(uint16_t *mask, unsigned int axis, unsigned int plane, bool positive,
+                            VoxelVertex *vertices) {
+        const unsigned int u = (axis + 1) % 3, v = (axis + 2) % 3;
+        unsigned int quads = 0;
+        for (unsigned int b = 0; b < N; ++b) {
+            uint16_t *row = mask + b * N;
+            for (unsigned int a = 0; a < N;) {
+                uint16_t material = row[a];
+                if (!material) {++a; continue;}
+                unsigned int width = 1, height = 1;
+                while (a + width < N && row[a + width] == material) ++width;
+                for (; b + height < N; ++height) {
+                    const uint16_t *next = row + height * N + a;
+                    unsigned int run = 0;
+                    while (run < width && next[run] == material) ++run;
+                    if (run < width) break;
+                }
+                for (unsigned int line = 0; line < height; ++line) std::fill_n(row + line * N + a, width, uint16_t(0));
+
+                // counter clockwise seen along the normal: u x v is the axis, the negative side goes the other way
+                const unsigned int corners[2][4][2] = {
+                    {{a, b}, {a, b + height}, {a + width, b + height}, {a + width, b}},
+                    {{a, b}, {a + width, b}, {a + width, b + height}, {a, b + height}}
+                };
+                VoxelVertex *quad = vertices + size_t(quads) * 4;
+                for (unsigned int corner = 0; corner < 4; ++corner) {
+                    quad[corner].position[axis] = uint8_t(plane);
+                    quad[corner].position[u] = uint8_t(corners[positive][corner][0]);
+                    quad[corner].position[v] = uint8_t(corners[positive][corner][1]);
+                    quad[corner].face = uint8_t(axis * 2 + positive);
+                    quad[corner].material = material;
+                    quad[corner].reserved = 0;
+                }
+                ++quads;
+                a += width;
+            }
+        }
+        return quads;
+    }
+}
+
+VoxelWorld::~VoxelWorld() {
+    destroy();
+}
+
+bool VoxelWorld::create(unsigned int chunksX, unsigned int chunksY, unsigned int chunksZ,
+                        const VoxelLayout &layout) {
+    destroy();
+    size_t count = size_t(chunksX) * chunksY * chunksZ;
+    if (count == 0 || count > (size_t(1) << 24)) {
+        printf("Voxel world of %u x %u x %u chunks is not supported\n", chunksX, chunksY, chunksZ);
+        return false;
+    }
+    voxelLayout = layout;
+    chunkCounts[0] = chunksX;
+    chunkCounts[1] = chunksY;
+    chunkCounts[2] = chunksZ;
+    chunks.resize(count);
+    for (Chunk &chunk : chunks) chunk.palette.assign(1, 0);
+    chunkDirty.assign(count, 0);
+    // reserved for the worst case, so neither edits nor update() grow them
+    dirtyChunks.reserve(count);
+    results.resize(count);
+    meshes.resize(count);
+    freeQuads.reserve(count + 1);
+    return true;
+}
+
+uint16_t VoxelWorld::get(int x, int y, int z) const {
+    if (x < 0 || y < 0 || z < 0 || unsigned(x) >= chunkCounts[0] * N || unsigned(y) >= chunkCounts[1] * N ||
+        unsigned(z) >= chunkCounts[2] * N) {
+        return 0;
+    }
+    const Chunk &chunk = chunks[chunkIndex(unsigned(x) / N, unsigned(y) / N, unsigned(z) / N)];
+    if (!chunk.bits) return chunk.palette[0];
+    unsigned int voxel = (unsigned(z) % N * N + unsigned(y) % N) * N + unsigned(x) % N;
+    return chunk.palette[readIndex(chunk.indices.data(), chunk.bits, voxel)];
+}
+
+void VoxelWorld::set(int x, int y, int z, uint16_t material) {
+    if (x < 0 || y < 0 || z < 0 || unsigned(x) >= chunkCounts[0] * N || unsigned(y) >= chunkCounts[1] * N ||
+        unsigned(z) >= chunkCounts[2] * N) {
+        return;
+    }
+    const unsigned int position[3] = {unsigned(x), unsigned(y), unsigned(z)};
+    unsigned int chunkPosition[3], local[3];
+    for (int axis = 0; axis < 3; ++axis) {
+        chunkPosition[axis] = position[axis] / N;
+        local[axis] = position[axis] % N;
+    }
+    size_t index = chunkIndex(chunkPosition[0], chunkPosition[1], chunkPosition[2]);
+    Chunk &chunk = chunks[index];
+    unsigned int voxel = (local[2] * N + local[1]) * N + local[0];
+    uint32_t entry = chunk.bits ? readIndex(chunk.indices.data(), chunk.bits, voxel) : 0;
+    if (chunk.palette[entry] == material) return;
+
+    entry = uint32_t(std::find(chunk.palette.begin(), chunk.palette.end(), material) - chunk.palette.begin());
+    if (entry == chunk.palette.size()) {
+        unsigned int bits = bitsFor(chunk.palette.size() + 1);
+        if (bits != chunk.bits) repack(chunk, bits);
+        chunk.palette.push_back(material);
+    }
+    writeIndex(chunk.indices.data(), chunk.bits, voxel, entry);
+
+    // the neighbours mesh their faces against the voxels of this chunk's border
+    markDirty(index);
+    for (int axis = 0; axis < 3; ++axis) {
+        unsigned int neighbour[3] = {chunkPosition[0], chunkPosition[1], chunkPosition[2]};
+        if (local[axis] == 0 && chunkPosition[axis] > 0) {
+            --neighbour[axis];
+            markDirty(chunkIndex(neighbour[0], neighbour[1], neighbour[2]));
+        } else if (local[axis] == N - 1 && chunkPosition[axis] + 1 < chunkCounts[axis]) {
+            ++neighbour[axis];
+            markDirty(chunkIndex(neighbour[0], neighbour[1], neighbour[2]));
+        }
+    }
+}
+
+void VoxelWorld::setChunk(unsigned int chunkX, unsigned int chunkY, unsigned int chunkZ, const uint16_t *voxels) {
+    if (chunkX >= chunkCounts[0] || chunkY >= chunkCounts[1] || chunkZ >= chunkCounts[2]) return;
+    size_t index = chunkIndex(chunkX, chunkY, chunkZ);
+    Chunk &chunk = chunks[index];
+
+    // palette in the order of first appearance, entries maps every material to its palette entry
+    ScratchScope scratch;
+    uint32_t *entries = scratch.allocateArray<uint32_t>(65536);
+    uint32_t *indices = scratch.allocateArray<uint32_t>(CHUNK_VOXELS);
+    std::fill_n(entries, 65536, NO_ENTRY);
+    chunk.palette.clear();
+    for (unsigned int voxel = 0; voxel < CHUNK_VOXELS; ++voxel) {
+        uint32_t &entry = entries[voxels[voxel]];
+        if (entry == NO_ENTRY) {
+            entry = uint32_t(chunk.palette.size());
+            chunk.palette.push_back(voxels[voxel]);
+        }
+        indices[voxel] = entry;
+    }
+    chunk.palette.shrink_to_fit();
+    chunk.bits = uint8_t(bitsFor(chunk.palette.size()));
+    chunk.indices.resize(wordCount(chunk.bits));
+    chunk.indices.shrink_to_fit();
+    if (chunk.bits) pack(indices, chunk.bits, chunk.indices.data());
+
+    markDirty(index);
+    const unsigned int position[3] = {chunkX, chunkY, chunkZ};
+    for (int axis = 0; axis < 3; ++axis) {
+        for (int side = -1; side <= 1; side += 2) {
+            unsigned int neighbour[3] = {chunkX, chunkY, chunkZ};
+            neighbour[axis] = unsigned(int(position[axis]) + side);
+            if (neighbour[axis] < chunkCounts[axis]) markDirty(chunkIndex(neighbour[0], neighbour[1], neighbour[2]));
+        }
+    }
+}
+
+void VoxelWorld::repack(Chunk &chunk, unsigned int bits) {
+    ScratchScope scratch;
+    uint32_t *indices = scratch.allocateArray<uint32_t>(CHUNK_VOXELS);
+    for (unsigned int voxel = 0; voxel < CHUNK_VOXELS; ++voxel) {
+        indices[voxel] = chunk.bits ? readIndex(chunk.indices.data(), chunk.bits, voxel) : 0;
+    }
+    chunk.indices.resize(wordCount(bits));
+    chunk.bits = uint8_t(bits);
+    if (bits) pack(indices, bits, chunk.indices.data());
+}
+
+void VoxelWorld::compact() {
+    for (Chunk &chunk : chunks) {
+        if (chunk.palette.size() < 2) continue;
+        ScratchScope scratch;
+        uint32_t *indices = scratch.allocateArray<uint32_t>(CHUNK_VOXELS);
+        uint32_t *remap = scratch.allocateArray<uint32_t>(chunk.palette.size());
+        uint16_t *palette = scratch.allocateArray<uint16_t>(chunk.palette.size());
+        std::fill_n(remap, chunk.palette.size(), NO_ENTRY);
+        uint32_t used = 0;
+        for (unsigned int voxel = 0; voxel < CHUNK_VOXELS; ++voxel) {
+            uint32_t entry = readIndex(chunk.indices.data(), chunk.bits, voxel);
+            if (remap[entry] == NO_ENTRY) {
+                palette[used] = chunk.palette[entry];
+                remap[entry] = used++;
+            }
+            indices[voxel] = remap[entry];
+        }
+        if (used == chunk.palette.size()) continue;
+        chunk.palette.assign(palette, palette + used);
+        chunk.palette.shrink_to_fit();
+        chunk.bits = uint8_t(bitsFor(used));
+        chunk.indices.resize(wordCount(chunk.bits));
+        chunk.indices.shrink_to_fit();
+        if (chunk.bits) pack(indices, chunk.bits, chunk.indices.data());
+    }
+}
+
+void VoxelWorld::markDirty(size_t chunk) {
+    if (chunkDirty[chunk]) return;
+    chunkDirty[chunk] = 1;
+    dirtyChunks.push_back(uint32_t(chunk));
+}
+
+void VoxelWorld::unpack(const Chunk &chunk, uint16_t *padded) const {
+    const uint16_t *palette = chunk.palette.data();
+    const uint32_t *words = chunk.indices.data();
+    switch (chunk.bits) {
+        case 0:
+            for (unsigned int z = 0; z < N; ++z) {
+                for (unsigned int y = 0; y < N; ++y) {
+                    std::fill_n(padded + (size_t(z + 1) * PADDED + y + 1) * PADDED + 1, N, palette[0]);
+                }
+            }
+            break;
+        case 1: unpackRows<1>(words, palette, padded); break;
+        case 2: unpackRows<2>(words, palette, padded); break;
+        case 4: unpackRows<4>(words, palette, padded); break;
+        case 8: unpackRows<8>(words, palette, padded); break;
+        default: unpackRows<16>(words, palette, padded); break;
+    }
+}
+
+unsigned int VoxelWorld::meshChunk(unsigned int chunkX, unsigned int chunkY, unsigned int chunkZ,
+                                   VoxelVertex *vertices) const {
+    const Chunk &chunk = chunks[chunkIndex(chunkX, chunkY, chunkZ)];
+    if (!chunk.bits && chunk.palette[0] == 0) return 0;
+
+    ScratchScope scratch;
+    uint16_t *padded = scratch.allocateArray<uint16_t>(PADDED_VOXELS);
+    uint16_t *masks = scratch.allocateArray<uint16_t>(2 * N * N);
+    unpack(chunk, padded);
+
+    // the layers of the six neighbours facing this chunk, empty beyond the world. The edges and corners of the
+    // padded block are never read
+    const unsigned int position[3] = {chunkX, chunkY, chunkZ};
+    for (unsigned int axis = 0; axis < 3; ++axis) {
+        const unsigned int u = (axis + 1) % 3, v = (axis + 2) % 3;
+        for (unsigned int side = 0; side < 2; ++side) {
+            unsigned int neighbour[3] = {chunkX, chunkY, chunkZ};
+            neighbour[axis] = side ? position[axis] + 1 : position[axis] - 1;
+            const Chunk *other = neighbour[axis] < chunkCounts[axis] ?
+                                 &chunks[chunkIndex(neighbour[0], neighbour[1], neighbour[2])] : nullptr;
+            for (unsigned int b = 0; b < N; ++b) {
+                for (unsigned int a = 0; a < N; ++a) {
+                    unsigned int target[3], source[3];
+                    target[axis] = side ? PADDED - 1 : 0;
+                    target[u] = a + 1;
+                    target[v] = b + 1;
+                    source[axis] = side ? 0 : N - 1;
+                    source[u] = a;
+                    source[v] = b;
+                    uint16_t material = 0;
+                    if (other) {
+                        material = other->bits ? other->palette[readIndex(other->indices.data(), other->bits,
+                                                                          (source[2] * N + source[1]) * N + source[0])]
+                                               : other->palette[0];
+                    }
+                    padded[(size_t(target[2]) * PADDED + target[1]) * PADDED + target[0]] = material;
+                }
+            }
+        }
+    }
+
+    // a solid voxel has a face towards every empty neighbour, one slice of faces per side at a time
+    const ptrdiff_t strides[3] = {1, PADDED, ptrdiff_t(PADDED) * PADDED};
+    unsigned int quads = 0;
+    for (unsigned int axis = 0; axis < 3; ++axis) {
+        const unsigned int u = (axis + 1) % 3, v = (axis + 2) % 3;
+        const ptrdiff_t step = strides[axis];
+        for (unsigned int slice = 0; slice < N; ++slice) {
+            uint16_t *negative = masks, *positive = masks + N * N;
+            bool faces = false;
+            for (unsigned int b = 0; b < N; ++b) {
+                const uint16_t *cell = padded + (slice + 1) * step + (b + 1) * strides[v] + strides[u];
+                for (unsigned int a = 0; a < N; ++a, cell += strides[u]) {
+                    uint16_t material = *cell;
+                    uint16_t below = cell[-step] ? 0 : material, above = cell[step] ? 0 : material;
+                    negative[b * N + a] = below;
+                    positive[b * N + a] = above;
+                    faces |= (below | above) != 0;
+                }
+            }
+            if (!faces) continue;
+            quads += mergeFaces(negative, axis, slice, false, vertices + size_t(quads) * 4);
+            quads += mergeFaces(positive, axis, slice + 1, true, vertices + size_t(quads) * 4);
+        }
+    }
+    return quads;
+}
+
+bool VoxelWorld::createRenderer(const char *fragmentShader, size_t vertexBytes) {
+    if (chunks.empty()) {printf("No voxel world was created\n"); return false;}
+    if (voxelProgram) glDeleteProgram(voxelProgram);
+    voxelProgram = LoadShaders("src/shaders/Voxel.vert", fragmentShader);
+    if (!voxelProgram) return false;
+    glUseProgram(voxelProgram);
+    viewProjectionID = glGetUniformLocation(voxelProgram, "viewProjection");
+    chunkOriginID = glGetUniformLocation(voxelProgram, "chunkOrigin");
+    glUniform1f(glGetUniformLocation(voxelProgram, "voxelSize"), voxelLayout.voxelSize);
+    if (vertexArray) return true;
+
+    if (!uploads.create(UPLOAD_BYTES)) {printf("Voxel meshes can not be uploaded\n"); return false;}
+    // two triangles per quad over its four consecutive corners
+    std::vector<uint32_t> indices(size_t(MAX_QUADS) * 6);
+    for (uint32_t quad = 0; quad < MAX_QUADS; ++quad) {
+        const uint32_t pattern[6] = {0, 1, 2, 0, 2, 3};
+        for (unsigned int i = 0; i < 6; ++i) indices[size_t(quad) * 6 + i] = quad * 4 + pattern[i];
+    }
+    GLint previousVertexArray = 0;
+    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousVertexArray);
+    glGenVertexArrays(1, &vertexArray);
+    glBindVertexArray(vertexArray);
+    glGenBuffers(1, &indexBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, GLsizeiptr(indices.size() * sizeof(uint32_t)), indices.data(),
+                 GL_STATIC_DRAW);
+    // written by copies from the upload block only
+    glGenBuffers(1, &vertexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(vertexBytes), nullptr, GL_DYNAMIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribIPointer(0, 4, GL_UNSIGNED_BYTE, sizeof(VoxelVertex),
+                           reinterpret_cast<void *>(offsetof(VoxelVertex, position)));
+    glEnableVertexAttribArray(1);
+    glVertexAttribIPointer(1, 1, GL_UNSIGNED_SHORT, sizeof(VoxelVertex),
+                           reinterpret_cast<void *>(offsetof(VoxelVertex, material)));
+    glBindVertexArray(GLuint(previousVertexArray));
+
+    freeQuads.assign(1, {0, uint32_t(std::min(vertexBytes / (4 * sizeof(VoxelVertex)), size_t(NO_ENTRY)))});
+    // meshes made so far were only counted
+    for (size_t chunk = 0; chunk < chunks.size(); ++chunk) {
+        meshes[chunk] = ChunkMesh();
+        markDirty(chunk);
+    }
+    return true;
+}
+
+bool VoxelWorld::allocateQuads(uint32_t quads, ChunkMesh &mesh) {
+    // first fit, the ranges are sorted by position
+    uint32_t size = (quads + QUAD_GRANULARITY - 1) / QUAD_GRANULARITY * QUAD_GRANULARITY;
+    for (auto range = freeQuads.begin(); range != freeQuads.end(); ++range) {
+        if (range->count < size) continue;
+        mesh.first = range->first;
+        mesh.capacity = size;
+        range->first += size;
+        range->count -= size;
+        if (!range->count) freeQuads.erase(range);
+        return true;
+    }
+    return false;
+}
+
+void VoxelWorld::releaseQuads(ChunkMesh &mesh) {
+    if (mesh.capacity) {
+        QuadRange released = {mesh.first, mesh.capacity};
+        auto next = std::lower_bound(freeQuads.begin(), freeQuads.end(), released,
+                                     [](const QuadRange &a, const QuadRange &b) { return a.first < b.first; });
+        // merged with the free ranges right before and after it
+        if (next != freeQuads.end() && released.first + released.count == next->first) {
+            released.count += next->count;
+            next = freeQuads.erase(next);
+        }
+        if (next != freeQuads.begin() && (next - 1)->first + (next - 1)->count == released.first) {
+            (next - 1)->count += released.count;
+        } else {
+            freeQuads.insert(next, released);
+        }
+    }
+    mesh = ChunkMesh();
+}
+
+void VoxelWorld::update() {
+    frameStats.meshedChunks = frameStats.deferredChunks = 0;
+    frameStats.meshedQuads = 0;
+    frameStats.dirtyChunks = unsigned(dirtyChunks.size());
+    if (dirtyChunks.empty()) return;
+
+    // the jobs append their meshes to one block of the stream buffer, the chunks that do not fit stay dirty
+    StreamBuffer::Allocation block;
+    if (vertexArray) {
+        uploads.beginFrame();
+        block = uploads.allocate(UPLOAD_BYTES);
+        if (!block.data) {uploads.endFrame(); return;}
+    }
+    std::atomic<size_t> used{0};
+    auto meshJob = [&](unsigned int begin, unsigned int end) {
+        ScratchScope scratch;
+        auto *vertices = scratch.allocateArray<VoxelVertex>(size_t(MAX_QUADS) * 4);
+        for (unsigned int i = begin; i < end; ++i) {
+            MeshResult &result = results[i];
+            result.chunk = dirtyChunks[i];
+            result.quads = 0;
+            result.uploaded = false;
+            if (block.data && used.load(std::memory_order_relaxed) >= UPLOAD_BYTES) continue;
+            unsigned int x = result.chunk % chunkCounts[0], y = result.chunk / chunkCounts[0] % chunkCounts[1];
+            result.quads = meshChunk(x, y, result.chunk / chunkCounts[0] / chunkCounts[1], vertices);
+            if (!block.data) {result.uploaded = true; continue;}
+            size_t bytes = size_t(result.quads) * 4 * sizeof(VoxelVertex);
+            result.offset = used.fetch_add(bytes);
+            result.uploaded = result.offset + bytes <= UPLOAD_BYTES;
+            if (result.uploaded) memcpy(static_cast<unsigned char *>(block.data) + result.offset, vertices, bytes);
+        }
+    };
+    JobSystem::parallelFor(unsigned(dirtyChunks.size()), 1, meshJob);
+
+    if (block.data) {
+        uploads.flush();
+        glBindBuffer(GL_COPY_READ_BUFFER, uploads.buffer());
+        glBindBuffer(GL_COPY_WRITE_BUFFER, vertexBuffer);
+    }
+    size_t kept = 0;
+    for (size_t i = 0; i < dirtyChunks.size(); ++i) {
+        const MeshResult &result = results[i];
+        if (!result.uploaded) {
+            dirtyChunks[kept++] = result.chunk;
+            ++frameStats.deferredChunks;
+            continue;
+        }
+        chunkDirty[result.chunk] = 0;
+        ++frameStats.meshedChunks;
+        frameStats.meshedQuads += result.quads;
+        ChunkMesh &mesh = meshes[result.chunk];
+        if (!block.data) {
+            mesh.quads = result.quads;
+            continue;
+        }
+        // a mesh stays in its range while it fits
+        if (result.quads > mesh.capacity || result.quads == 0) {
+            releaseQuads(mesh);
+            if (result.quads && !allocateQuads(result.quads, mesh)) {
+                if (!reportedFull) printf("Voxel vertex buffer is full, chunks are left out\n");
+                reportedFull = true;
+                continue;
+            }
+        }
+        mesh.quads = result.quads;
+        if (result.quads) {
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, block.offset + GLintptr(result.offset),
+                                GLintptr(mesh.first) * 4 * GLintptr(sizeof(VoxelVertex)),
+                                GLsizeiptr(result.quads) * 4 * GLsizeiptr(sizeof(VoxelVertex)));
+        }
+    }
+    dirtyChunks.resize(kept);
+    frameStats.dirtyChunks = unsigned(kept);
+    if (block.data) uploads.endFrame();
+}
+
+void VoxelWorld::draw(const float viewProjection[16]) {
+    frameStats.drawnChunks = frameStats.culledChunks = 0;
+    frameStats.drawnQuads = 0;
+    if (!voxelProgram || !vertexArray) return;
+
+    // Gribb/Hartmann: the planes are sums and differences of the fourth row with the other rows
+    float planes[6][4];
+    for (int i = 0; i < 3; ++i) {
+        for (int k = 0; k < 4; ++k) {
+            float row = viewProjection[k * 4 + i], w = viewProjection[k * 4 + 3];
+            planes[i * 2][k] = w + row;
+            planes[i * 2 + 1][k] = w - row;
+        }
+    }
+
+    GLint previousVertexArray = 0;
+    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousVertexArray);
+    glUseProgram(voxelProgram);
+    glUniformMatrix4fv(viewProjectionID, 1, GL_FALSE, viewProjection);
+    glBindVertexArray(vertexArray);
+    const float extent = voxelLayout.voxelSize * float(N);
+    for (unsigned int z = 0; z < chunkCounts[2]; ++z) {
+        for (unsigned int y = 0; y < chunkCounts[1]; ++y) {
+            for (unsigned int x = 0; x < chunkCounts[0]; ++x) {
+                const ChunkMesh &mesh = meshes[chunkIndex(x, y, z)];
+                if (!mesh.quads) continue;
+                const float boundsMin[3] = {voxelLayout.origin[0] + float(x) * extent,
+                                            voxelLayout.origin[1] + float(y) * extent,
+                                            voxelLayout.origin[2] + float(z) * extent};
+                bool outside = false;
+                for (const float *plane : planes) {
+                    // the corner farthest along the plane normal
+                    float farthest = plane[3];
+                    for (int axis = 0; axis < 3; ++axis) {
+                        farthest += plane[axis] * (boundsMin[axis] + (plane[axis] > 0.0f ? extent : 0.0f));
+                    }
+                    outside = outside || farthest < 0.0f;
+                }
+                if (outside) {++frameStats.culledChunks; continue;}
+                glUniform3fv(chunkOriginID, 1, boundsMin);
+                glDrawElementsBaseVertex(GL_TRIANGLES, GLsizei(mesh.quads * 6), GL_UNSIGNED_INT, nullptr,
+                                         GLint(mesh.first * 4));
+                ++frameStats.drawnChunks;
+                frameStats.drawnQuads += mesh.quads;
+            }
+        }
+    }
+    glBindVertexArray(GLuint(previousVertexArray));
+}
+
+VoxelMemory VoxelWorld::memory() const {
+    VoxelMemory memory;
+    memory.chunks = chunks.size();
+    for (size_t chunk = 0; chunk < chunks.size(); ++chunk) {
+        const Chunk &storage = chunks[chunk];
+        memory.bytes += sizeof(Chunk) + storage.palette.capacity() * sizeof(uint16_t) +
+                        storage.indices.capacity() * sizeof(uint32_t);
+        memory.chunksByBits[storage.bits ? std::countr_zero(unsigned(storage.bits)) + 1 : 0]++;
+        if (vertexArray) memory.vertexBytes += size_t(meshes[chunk].capacity) * 4 * sizeof(VoxelVertex);
+    }
+    return memory;
+}
+
+void VoxelWorld::destroy() {
+    if (voxelProgram) glDeleteProgram(voxelProgram);
+    if (vertexBuffer) glDeleteBuffers(1, &vertexBuffer);
+    if (indexBuffer) glDeleteBuffers(1, &indexBuffer);
+    if (vertexArray) glDeleteVertexArrays(1, &vertexArray);
+    voxelProgram = vertexBuffer = indexBuffer = vertexArray = 0;
+    uploads.destroy();
+    chunks.clear();
+    chunkDirty.clear();
+    dirtyChunks.clear();
+    results.clear();
+    meshes.clear();
+    freeQuads.clear();
+    chunkCounts[0] = chunkCounts[1] = chunkCounts[2] = 0;
+    reportedFull = false;
+    frameStats = VoxelStats();
+}
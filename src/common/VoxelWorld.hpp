@@ -0,0 +1,185 @@
+//
+// Created by jonas on 19.10.26.
+//
+
+#ifndef VOXELWORLD_H
+#define VOXELWORLD_H
+#include <glad/gl.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Memory.hpp"
+#include "StreamBuffer.hpp"
+
+
+/** Placement of a voxel world */
+struct VoxelLayout {
+    float origin[3] = {0, 0, 0};    // world position of the lower corner of voxel (0, 0, 0)
+    float voxelSize = 1.0f;
+};
+
+/** Corner of a meshed quad (8 bytes), four per quad */
+struct VoxelVertex {
+    uint8_t position[3];            // in voxels from the lower corner of the chunk, 0 to CHUNK_SIZE
+    uint8_t face;                   // 0 -x, 1 +x, 2 -y, 3 +y, 4 -z, 5 +z
+    uint16_t material;
+    uint16_t reserved;
+};
+
+/** Counters of the last update() and draw() */
+struct VoxelStats {
+    unsigned int meshedChunks = 0;
+    unsigned int deferredChunks = 0;    // left dirty because the upload block was full
+    unsigned int dirtyChunks = 0;       // left for the next update()
+    unsigned int drawnChunks = 0, culledChunks = 0;
+    size_t meshedQuads = 0, drawnQuads = 0;
+};
+
+/** Memory of the voxel storage, see memory() */
+struct VoxelMemory {
+    size_t chunks = 0;
+    size_t bytes = 0;                   // chunk records, palettes and packed indices as allocated
+    size_t chunksByBits[6] = {};        // chunks per index width: 0 (a single material), 1, 2, 4, 8 and 16 bits
+    size_t vertexBytes = 0;             // GPU vertex storage in use by the chunk meshes
+};
+
+/** Chunked voxel volume, greedy meshed on the job threads
+ *
+ *  Every chunk of CHUNK_SIZE^3 voxels stores a palette of the materials it contains and one index per voxel,
+ *  packed with the fewest bits (0, 1, 2, 4, 8 or 16) that address the palette. A chunk of one material holds no
+ *  indices at all. Material 0 is empty, every other material is opaque.
+ *
+ *  Edits mark their chunk dirty, and the neighbours they border. update() meshes the dirty chunks in parallel: each
+ *  job unpacks its chunk and the bordering layers of the six neighbours, finds the faces between solid and empty
+ *  voxels slice by slice and merges equal faces into rectangles (greedy meshing). The quads are appended to an upload
+ *  block in a StreamBuffer and copied into one large vertex buffer, suballocated per chunk. Every chunk is drawn with
+ *  one glDrawElementsBaseVertex over a shared quad index buffer.
+ *
+ *  Without createRenderer() update() only counts the quads of the meshes, for benchmarks and tools.
+ */
+class VoxelWorld {
+public:
+    static constexpr unsigned int CHUNK_SIZE = 32;
+    static constexpr unsigned int CHUNK_VOXELS = CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE;
+    /** Quads of a chunk at most, a 3D checkerboard */
+    static constexpr unsigned int MAX_QUADS = CHUNK_VOXELS * 3;
+    /** Bytes of meshes one update() uploads at most, the largest chunk mesh fits */
+    static constexpr size_t UPLOAD_BYTES = 4 << 20;
+
+    VoxelWorld() = default;
+    VoxelWorld(const VoxelWorld &) = delete;
+    VoxelWorld &operator=(const VoxelWorld &) = delete;
+    ~VoxelWorld();
+
+    /** Allocates an empty world of chunksX x chunksY x chunksZ chunks
+     *
+     *  @returns false if a size is 0 or the world has more than 2^24 chunks
+     */
+    bool create(unsigned int chunksX, unsigned int chunksY, unsigned int chunksZ, const VoxelLayout &layout = {});
+
+    /** @returns Material of a voxel, 0 outside the world */
+    uint16_t get(int x, int y, int z) const;
+    /** Changes a voxel, positions outside the world are ignored */
+    void set(int x, int y, int z, uint16_t material);
+    /** Replaces all voxels of a chunk
+     *
+     *  @param[in] voxels CHUNK_VOXELS materials, x first, then y, then z
+     */
+    void setChunk(unsigned int chunkX, unsigned int chunkY, unsigned int chunkZ, const uint16_t *voxels);
+    /** Drops the palette entries edits left unused and narrows the indices, returns the freed memory to the heap */
+    void compact();
+
+    /** Creates the program (Voxel.vert with the given fragment shader), the vertex storage and the upload buffer
+     *
+     *  @param[in] vertexBytes Size of the vertex buffer shared by all chunk meshes
+     *  @returns false if the program does not link or the buffers can not be created
+     */
+    bool createRenderer(const char *fragmentShader, size_t vertexBytes = size_t(64) << 20);
+    /** @returns The program, for the uniforms of the fragment shader */
+    GLuint program() const { return voxelProgram; }
+
+    /** Meshes the dirty chunks on the job threads and uploads the meshes, allocates nothing */
+    void update();
+    /** Draws the chunks inside the frustum
+     *
+     *  @param[in] viewProjection Column major projection * view matrix of the camera
+     */
+    void draw(const float viewProjection[16]);
+
+    /** Greedy meshes a chunk as it is now, thread safe as long as nothing edits the world
+     *
+     *  @param[out] vertices Room for MAX_QUADS * 4 vertices
+     *  @returns Quads written
+     */
+    unsigned int meshChunk(unsigned int chunkX, unsigned int chunkY, unsigned int chunkZ,
+                           VoxelVertex *vertices) const;
+    /** @returns Quads of the current mesh of a chunk, 0 until it was meshed */
+    unsigned int chunkQuads(unsigned int chunkX, unsigned int chunkY, unsigned int chunkZ) const {
+        return meshes[chunkIndex(chunkX, chunkY, chunkZ)].quads;
+    }
+
+    /** Sums up the storage of all chunks, walks the whole world */
+    VoxelMemory memory() const;
+    const VoxelStats &stats() const { return frameStats; }
+    const VoxelLayout &layout() const { return voxelLayout; }
+    unsigned int chunksX() const { return chunkCounts[0]; }
+    unsigned int chunksY() const { return chunkCounts[1]; }
+    unsigned int chunksZ() const { return chunkCounts[2]; }
+    unsigned int dirtyCount() const { return unsigned(dirtyChunks.size()); }
+
+    void destroy();
+
+private:
+    template<typename T>
+    using VoxelVector = std::vector<T, TrackingAllocator<T, MemoryTag::Voxels>>;
+
+    struct Chunk {
+        VoxelVector<uint16_t> palette;  // materials, index 0 to palette.size() - 1
+        VoxelVector<uint32_t> indices;  // CHUNK_VOXELS palette indices of bits bits, none if bits is 0
+        uint8_t bits = 0;
+    };
+    struct ChunkMesh {
+        uint32_t first = 0;             // first quad in the vertex buffer
+        uint32_t capacity = 0;          // quads reserved there
+        uint32_t quads = 0;
+    };
+    struct MeshResult {
+        uint32_t chunk;
+        uint32_t quads;
+        size_t offset;                  // into the upload block
+        bool uploaded;
+    };
+    struct QuadRange {
+        uint32_t first, count;
+    };
+
+    size_t chunkIndex(unsigned int x, unsigned int y, unsigned int z) const {
+        return (size_t(z) * chunkCounts[1] + y) * chunkCounts[0] + x;
+    }
+    void unpack(const Chunk &chunk, uint16_t *padded) const;
+    void repack(Chunk &chunk, unsigned int bits);
+    void markDirty(size_t chunk);
+    bool allocateQuads(uint32_t quads, ChunkMesh &mesh);
+    void releaseQuads(ChunkMesh &mesh);
+
+    VoxelLayout voxelLayout;
+    unsigned int chunkCounts[3] = {};
+    std::vector<Chunk> chunks;
+    std::vector<uint8_t> chunkDirty;
+    std::vector<uint32_t> dirtyChunks;
+    std::vector<MeshResult> results;
+    VoxelStats frameStats;
+
+    // drawing
+    std::vector<ChunkMesh> meshes;
+    std::vector<QuadRange> freeQuads;           // unused ranges of the vertex buffer, sorted
+    bool reportedFull = false;
+    GLuint voxelProgram = 0, vertexBuffer = 0, indexBuffer = 0, vertexArray = 0;
+    GLint viewProjectionID = -1, chunkOriginID = -1;
+    StreamBuffer uploads;
+};
+
+
+
+#endif //VOXELWORLD_H
@@ -1,12 +1,11 @@
 #include <cstdio>
-#include <string>
-#include <vector>
-#include <fstream>
-#include <sstream>
 using namespace std;
 
 #include <cstring>
 #include "shader.hpp"
+#include "Assets.hpp"
+#include "GLExtensions.hpp"
+#include "Memory.hpp"
 
 GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path){
 
@@ -14,28 +13,18 @@ GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path
 	GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
 	GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
 
-	// Read the Vertex Shader code from the file
-	std::string VertexShaderCode;
-	std::ifstream VertexShaderStream(vertex_file_path, std::ios::in);
-	if(VertexShaderStream.is_open()){
-		std::stringstream sstr;
-		sstr << VertexShaderStream.rdbuf();
-		VertexShaderCode = sstr.str();
-		VertexShaderStream.close();
-	}else{
+	// Read the Vertex Shader code from the archive or file, the views point straight into the mapping
+	AssetData VertexShaderCode;
+	if(!Assets::open(vertex_file_path, VertexShaderCode)){
 		printf("Impossible to open %s. Are you in the right directory ? Don't forget to read the FAQ !\n", vertex_file_path);
 		getchar();
 		return 0;
 	}
 
-	// Read the Fragment Shader code from the file
-	std::string FragmentShaderCode;
-	std::ifstream FragmentShaderStream(fragment_file_path, std::ios::in);
-	if(FragmentShaderStream.is_open()){
-		std::stringstream sstr;
-		sstr << FragmentShaderStream.rdbuf();
-		FragmentShaderCode = sstr.str();
-		FragmentShaderStream.close();
+	// Read the Fragment Shader code from the archive or file
+	AssetData FragmentShaderCode;
+	if(!Assets::open(fragment_file_path, FragmentShaderCode)){
+		printf("Impossible to open %s. Are you in the right directory ? Don't forget to read the FAQ !\n", fragment_file_path);
 	}
 
 	GLint Result = GL_FALSE;
@@ -44,34 +33,42 @@ GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path
 
 	// Compile Vertex Shader
 	printf("Compiling shader : %s\n", vertex_file_path);
-	char const * VertexSourcePointer = VertexShaderCode.c_str();
-	glShaderSource(VertexShaderID, 1, &VertexSourcePointer , NULL);
+	// the mapped source is not null terminated, pass its length
+	char const * VertexSourcePointer = VertexShaderCode.empty() ? "" : reinterpret_cast<const char *>(VertexShaderCode.data());
+	GLint VertexSourceLength = GLint(VertexShaderCode.size());
+	glShaderSource(VertexShaderID, 1, &VertexSourcePointer , &VertexSourceLength);
 	glCompileShader(VertexShaderID);
 
 	// Check Vertex Shader
 	glGetShaderiv(VertexShaderID, GL_COMPILE_STATUS, &Result);
 	glGetShaderiv(VertexShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
 	if ( InfoLogLength > 0 ){
-		std::vector<char> VertexShaderErrorMessage(InfoLogLength+1);
-		glGetShaderInfoLog(VertexShaderID, InfoLogLength, NULL, &VertexShaderErrorMessage[0]);
-		printf("%s\n", &VertexShaderErrorMessage[0]);
+		// info logs are transient, they live on the scratch stack instead of the heap
+		ScratchScope scratch;
+		char * VertexShaderErrorMessage = scratch.allocateArray<char>(InfoLogLength+1);
+		glGetShaderInfoLog(VertexShaderID, InfoLogLength, NULL, VertexShaderErrorMessage);
+		VertexShaderErrorMessage[InfoLogLength] = 0;
+		printf("%s\n", VertexShaderErrorMessage);
 	}
 
 
 
 	// Compile Fragment Shader
 	printf("Compiling shader : %s\n", fragment_file_path);
-	char const * FragmentSourcePointer = FragmentShaderCode.c_str();
-	glShaderSource(FragmentShaderID, 1, &FragmentSourcePointer , NULL);
+	char const * FragmentSourcePointer = FragmentShaderCode.empty() ? "" : reinterpret_cast<const char *>(FragmentShaderCode.data());
+	GLint FragmentSourceLength = GLint(FragmentShaderCode.size());
+	glShaderSource(FragmentShaderID, 1, &FragmentSourcePointer , &FragmentSourceLength);
 	glCompileShader(FragmentShaderID);
 
 	// Check Fragment Shader
 	glGetShaderiv(FragmentShaderID, GL_COMPILE_STATUS, &Result);
 	glGetShaderiv(FragmentShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
 	if ( InfoLogLength > 0 ){
-		std::vector<char> FragmentShaderErrorMessage(InfoLogLength+1);
-		glGetShaderInfoLog(FragmentShaderID, InfoLogLength, NULL, &FragmentShaderErrorMessage[0]);
-		printf("%s\n", &FragmentShaderErrorMessage[0]);
+		ScratchScope scratch;
+		char * FragmentShaderErrorMessage = scratch.allocateArray<char>(InfoLogLength+1);
+		glGetShaderInfoLog(FragmentShaderID, InfoLogLength, NULL, FragmentShaderErrorMessage);
+		FragmentShaderErrorMessage[InfoLogLength] = 0;
+		printf("%s\n", FragmentShaderErrorMessage);
 	}
 
 
@@ -87,9 +84,11 @@ GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path
 	glGetProgramiv(ProgramID, GL_LINK_STATUS, &Result);
 	glGetProgramiv(ProgramID, GL_INFO_LOG_LENGTH, &InfoLogLength);
 	if ( InfoLogLength > 0 ){
-		std::vector<char> ProgramErrorMessage(InfoLogLength+1);
-		glGetProgramInfoLog(ProgramID, InfoLogLength, NULL, &ProgramErrorMessage[0]);
-		printf("%s\n", &ProgramErrorMessage[0]);
+		ScratchScope scratch;
+		char * ProgramErrorMessage = scratch.allocateArray<char>(InfoLogLength+1);
+		glGetProgramInfoLog(ProgramID, InfoLogLength, NULL, ProgramErrorMessage);
+		ProgramErrorMessage[InfoLogLength] = 0;
+		printf("%s\n", ProgramErrorMessage);
 	}
 
 
@@ -102,3 +101,60 @@ GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path
 	return ProgramID;
 }
 
+
+GLuint LoadComputeShader(const char * compute_file_path){
+
+	// Read the Compute Shader code from the archive or file
+	AssetData ComputeShaderCode;
+	if(!Assets::open(compute_file_path, ComputeShaderCode)){
+		printf("Impossible to open %s. Are you in the right directory ?\n", compute_file_path);
+		return 0;
+	}
+
+	GLint Result = GL_FALSE;
+	int InfoLogLength;
+
+	// Compile Compute Shader
+	printf("Compiling shader : %s\n", compute_file_path);
+	GLuint ComputeShaderID = glCreateShader(GL_COMPUTE_SHADER);
+	char const * ComputeSourcePointer = ComputeShaderCode.empty() ? "" : reinterpret_cast<const char *>(ComputeShaderCode.data());
+	GLint ComputeSourceLength = GLint(ComputeShaderCode.size());
+	glShaderSource(ComputeShaderID, 1, &ComputeSourcePointer , &ComputeSourceLength);
+	glCompileShader(ComputeShaderID);
+
+	// Check Compute Shader
+	glGetShaderiv(ComputeShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+	if ( InfoLogLength > 0 ){
+		ScratchScope scratch;
+		char * ComputeShaderErrorMessage = scratch.allocateArray<char>(InfoLogLength+1);
+		glGetShaderInfoLog(ComputeShaderID, InfoLogLength, NULL, ComputeShaderErrorMessage);
+		ComputeShaderErrorMessage[InfoLogLength] = 0;
+		printf("%s\n", ComputeShaderErrorMessage);
+	}
+
+	// Link the program
+	printf("Linking program\n");
+	GLuint ProgramID = glCreateProgram();
+	glAttachShader(ProgramID, ComputeShaderID);
+	glLinkProgram(ProgramID);
+
+	// Check the program, unlike LoadShaders a failed link returns 0 so callers can fall back
+	glGetProgramiv(ProgramID, GL_LINK_STATUS, &Result);
+	glGetProgramiv(ProgramID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+	if ( InfoLogLength > 0 ){
+		ScratchScope scratch;
+		char * ProgramErrorMessage = scratch.allocateArray<char>(InfoLogLength+1);
+		glGetProgramInfoLog(ProgramID, InfoLogLength, NULL, ProgramErrorMessage);
+		ProgramErrorMessage[InfoLogLength] = 0;
+		printf("%s\n", ProgramErrorMessage);
+	}
+
+	glDetachShader(ProgramID, ComputeShaderID);
+	glDeleteShader(ComputeShaderID);
+
+	if (Result != GL_TRUE) {
+		glDeleteProgram(ProgramID);
+		return 0;
+	}
+	return ProgramID;
+}
@@ -3,5 +3,7 @@
 #include <glad/gl.h>
 
 GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path);
+// needs a GL 4.3 context (see GLExtensions::computeShaders), returns 0 if compiling or linking fails
+GLuint LoadComputeShader(const char * compute_file_path);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,89 @@
+#version 330 core
+// clustered forward shading: each fragment only iterates the point lights of its cluster (see LightClusters)
+
+// Interpolated values from the vertex shaders
+in vec2 UV;
+in vec3 Normal_worldspace;
+in vec3 Position_worldspace;
+
+// output color drawn to display
+out vec3 color;
+
+// texture data
+uniform sampler2D myTextureSampler;
+// direction towards the sun in world space, the point lights are added on top
+uniform vec3 lightDirection = vec3(0.4, 0.8, 0.45);
+uniform vec3 sunColor = vec3(0.2);
+uniform vec3 ambient = vec3(0.05);
+// Blinn-Phong highlights of the point lights, glossiness 0..1 maps to exponents 2..2048
+uniform float specular = 0.0;
+uniform float glossiness = 0.5;
+uniform vec3 cameraPosition;
+// cascaded shadow map of the sun (see ShadowCascades), no shadows while cascadeCount is 0
+uniform sampler2DArrayShadow shadowMap;
+uniform int cascadeCount = 0;
+uniform mat4 cascadeMatrices[4];
+// far view depth of every cascade and how far receivers are pushed along their normal
+uniform vec4 cascadeSplits;
+uniform vec4 cascadeNormalOffsets;
+
+// per light two texels: position and radius, color and intensity
+uniform samplerBuffer lights;
+// per cluster first index and count into lightIndices
+uniform usamplerBuffer clusterRanges;
+uniform usamplerBuffer lightIndices;
+// tiles x, tiles y, depth slices
+uniform uvec3 clusterGrid;
+// tiles per pixel
+uniform vec2 tileScale;
+// slice = log(view depth) * x + y
+uniform vec2 sliceTransform;
+// zNear, zFar of the projection
+uniform vec2 depthRange;
+
+// 1 lit, 0 in shadow, filtered over 2x2 shadow map texels
+float sunShadow(vec3 position, vec3 normal, float viewDepth){
+    for (int c = 0; c < cascadeCount; ++c) {
+        if (viewDepth < cascadeSplits[c]) {
+            vec4 shadowPosition = cascadeMatrices[c] * vec4(position + normal * cascadeNormalOffsets[c], 1.0);
+            vec3 coordinates = shadowPosition.xyz * 0.5 + 0.5;
+            return texture(shadowMap, vec4(coordinates.xy, float(c), coordinates.z));
+        }
+    }
+    return 1.0;
+}
+
+void main(){
+    vec3 normal = normalize(Normal_worldspace);
+    vec3 albedo = texture( myTextureSampler, UV).rgb;
+    // view depth from the window depth of a perspective projection
+    float ndcDepth = gl_FragCoord.z * 2.0 - 1.0;
+    float viewDepth = 2.0 * depthRange.x * depthRange.y / (depthRange.y + depthRange.x - ndcDepth * (depthRange.y - depthRange.x));
+
+    float sun = max(dot(normal, normalize(lightDirection)), 0.0) * sunShadow(Position_worldspace, normal, viewDepth);
+    vec3 lighting = ambient + sunColor * sun;
+    vec3 highlights = vec3(0.0);
+    vec3 toCamera = normalize(cameraPosition - Position_worldspace);
+    float exponent = exp2(1.0 + glossiness * 10.0);
+    uvec2 tile = min(uvec2(gl_FragCoord.xy * tileScale), clusterGrid.xy - 1u);
+    uint slice = uint(clamp(log(viewDepth) * sliceTransform.x + sliceTransform.y, 0.0, float(clusterGrid.z - 1u)));
+    uvec2 range = texelFetch(clusterRanges, int((slice * clusterGrid.y + tile.y) * clusterGrid.x + tile.x)).xy;
+
+    for (uint i = range.x; i < range.x + range.y; ++i) {
+        int light = int(texelFetch(lightIndices, int(i)).r);
+        vec4 positionRadius = texelFetch(lights, light * 2);
+        vec4 colorIntensity = texelFetch(lights, light * 2 + 1);
+        vec3 toLight = positionRadius.xyz - Position_worldspace;
+        float distance2 = dot(toLight, toLight);
+        // smooth falloff reaching zero at the radius
+        float falloff = clamp(1.0 - distance2 / (positionRadius.w * positionRadius.w), 0.0, 1.0);
+        falloff *= falloff;
+        vec3 direction = toLight * inversesqrt(max(distance2, 1e-8));
+        float diffuse = max(dot(normal, direction), 0.0);
+        vec3 radiance = colorIntensity.rgb * (colorIntensity.a * falloff);
+        lighting += radiance * diffuse;
+        float highlight = diffuse > 0.0 ? pow(max(dot(normal, normalize(direction + toCamera)), 0.0), exponent) : 0.0;
+        highlights += radiance * (specular * highlight);
+    }
+    color = albedo * lighting + highlights;
+}
\ No newline at end of file
@@ -1,16 +1,19 @@
 #version 330 core
 // vertex location data
 layout(location = 0) in vec3 vertexPosition_modelspace;
-// vertex color data
+// vertex color data (float or unorm8)
 layout(location = 1) in vec3 vertexColor;
 
 out vec3 fragmentColor;
 
 // Model View Projection Matrix
 uniform mat4 MVP;
+// dequantization of unorm16 positions (see VertexDecode), the defaults leave float positions untouched
+uniform vec3 positionScale = vec3(1);
+uniform vec3 positionOffset = vec3(0);
 
 void main(){
     // final position for the vertex: MVP * position
-    gl_Position = MVP * vec4(vertexPosition_modelspace,1);
+    gl_Position = MVP * vec4(positionOffset + vertexPosition_modelspace * positionScale,1);
     fragmentColor = vertexColor;
 }
\ No newline at end of file
@@ -0,0 +1,30 @@
+#version 330 core
+// geometry pass of the deferred path (see DeferredRenderer), used with MeshShader.vert
+
+// Interpolated values from the vertex shaders
+in vec2 UV;
+in vec3 Normal_worldspace;
+
+// RGBA8: albedo and the packed material (specular in the high, glossiness in the low 4 bits)
+layout(location = 0) out vec4 albedoMaterial;
+// RG16: octahedral world space normal, the position is reconstructed from the depth buffer
+layout(location = 1) out vec2 normalOctahedral;
+
+// texture data
+uniform sampler2D myTextureSampler;
+// material, same meaning as in ClusteredShader.frag
+uniform float specular = 0.0;
+uniform float glossiness = 0.5;
+
+// folds a unit normal onto the octahedron, inverse of decodeOctahedral in MeshShader.vert
+vec2 encodeOctahedral(vec3 n){
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 e = n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return e * 0.5 + 0.5;
+}
+
+void main(){
+    float material = round(clamp(specular, 0.0, 1.0) * 15.0) * 16.0 + round(clamp(glossiness, 0.0, 1.0) * 15.0);
+    albedoMaterial = vec4(texture( myTextureSampler, UV).rgb, material / 255.0);
+    normalOctahedral = encodeOctahedral(normalize(Normal_worldspace));
+}
\ No newline at end of file
@@ -0,0 +1,18 @@
+#version 330 core
+
+// Interpolated values from the vertex shaders
+in vec2 UV;
+in vec3 Normal_worldspace;
+
+// output color drawn to display
+out vec3 color;
+
+// texture data
+uniform sampler2D myTextureSampler;
+// direction towards the light in world space
+uniform vec3 lightDirection = vec3(0.4, 0.8, 0.45);
+
+void main(){
+    float diffuse = max(dot(normalize(Normal_worldspace), normalize(lightDirection)), 0.0);
+    color = texture( myTextureSampler, UV).rgb * (0.25 + 0.75 * diffuse);
+}
\ No newline at end of file
@@ -0,0 +1,39 @@
+#version 330 core
+// vertex location data (float or unorm16)
+layout(location = 0) in vec3 vertexPosition_modelspace;
+// vertex texture data (float or unorm16)
+layout(location = 1) in vec2 vertexUV;
+// vertex normal data (float xyz or unorm16 octahedral xy)
+layout(location = 2) in vec3 vertexNormal;
+
+out vec2 UV;
+out vec3 Normal_worldspace;
+
+// Model View Projection Matrix and the Model Matrix alone for the normals (uniform scale only)
+uniform mat4 MVP;
+uniform mat4 M;
+// dequantization of the attributes (see VertexDecode), the defaults leave float attributes untouched
+uniform vec3 positionScale = vec3(1);
+uniform vec3 positionOffset = vec3(0);
+uniform vec2 uvScale = vec2(1);
+uniform vec2 uvOffset = vec2(0);
+uniform bool octahedralNormals = false;
+
+// unfolds a normal stored on the octahedron, same math as VertexQuantization::decodeOctahedral
+vec3 decodeOctahedral(vec2 encoded){
+    vec2 e = encoded * 2.0 - 1.0;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0) {
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return normalize(n);
+}
+
+void main(){
+    // final position for the vertex: MVP * position
+    gl_Position = MVP * vec4(positionOffset + vertexPosition_modelspace * positionScale,1);
+
+    UV = uvOffset + vertexUV * uvScale;
+    vec3 normal = octahedralNormals ? decodeOctahedral(vertexNormal.xy) : vertexNormal;
+    Normal_worldspace = mat3(M) * normal;
+}
\ No newline at end of file
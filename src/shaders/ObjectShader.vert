@@ -0,0 +1,32 @@
+#version 430 core
+// vertex location data
+layout(location = 0) in vec3 vertexPosition_modelspace;
+// vertex texture data
+layout(location = 1) in vec2 vertexUV;
+// vertex normal data
+layout(location = 2) in vec3 vertexNormal;
+// object of the instance, per instance attribute written by CullObjects.comp (see GpuCulling)
+layout(location = 8) in uint objectIndex;
+
+out vec2 UV;
+out vec3 Normal_worldspace;
+
+struct Object {
+    mat4 model;
+    vec3 boundsMin;
+    uint mesh;
+    vec3 boundsMax;
+    uint reserved;
+};
+layout(std430, binding = 0) readonly buffer Objects { Object objects[]; };
+
+// View Projection Matrix, the model matrix (uniform scale only) comes from the object
+uniform mat4 viewProjection;
+
+void main(){
+    mat4 model = objects[objectIndex].model;
+    gl_Position = viewProjection * model * vec4(vertexPosition_modelspace,1);
+
+    UV = vertexUV;
+    Normal_worldspace = mat3(model) * vertexNormal;
+}
\ No newline at end of file
@@ -0,0 +1,12 @@
+#version 330 core
+// round soft particle, premultiplied for glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA)
+in vec2 corner;
+in vec4 premultipliedColor;
+
+out vec4 color;
+
+void main(){
+    float falloff = 1.0 - dot(corner, corner);
+    if (falloff <= 0.0) discard;
+    color = premultipliedColor * (falloff * falloff);
+}
\ No newline at end of file
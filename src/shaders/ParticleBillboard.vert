@@ -0,0 +1,31 @@
+#version 330 core
+// camera facing particle quads, one instance per particle written by the CPU path of ParticleSystem
+// xyz: position, w: age as a fraction of the lifetime
+layout(location = 0) in vec4 particlePositionLife;
+layout(location = 1) in uint particleEmitter;
+
+out vec2 corner;
+out vec4 premultipliedColor;
+
+const int MAX_EMITTERS = 16;
+uniform mat4 viewProjection;
+uniform vec3 cameraRight;
+uniform vec3 cameraUp;
+uniform vec4 emitterStartColors[MAX_EMITTERS];
+uniform vec4 emitterEndColors[MAX_EMITTERS];
+// x: start size, y: end size, z: 1 for additive emitters
+uniform vec4 emitterSizes[MAX_EMITTERS];
+
+void main(){
+    // triangle strip of 4 vertices
+    corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;
+    float life = clamp(particlePositionLife.w, 0.0, 1.0);
+    int emitter = int(particleEmitter);
+    vec4 color = mix(emitterStartColors[emitter], emitterEndColors[emitter], life);
+    vec4 size = emitterSizes[emitter];
+    // additive particles leave the alpha of the blend at zero: ONE, ONE_MINUS_SRC_ALPHA then adds them
+    premultipliedColor = vec4(color.rgb * color.a, size.z > 0.5 ? 0.0 : color.a);
+
+    vec3 offset = (cameraRight * corner.x + cameraUp * corner.y) * mix(size.x, size.y, life);
+    gl_Position = viewProjection * vec4(particlePositionLife.xyz + offset, 1);
+}
\ No newline at end of file
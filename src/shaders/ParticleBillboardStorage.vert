@@ -0,0 +1,36 @@
+#version 430 core
+// camera facing particle quads of the GPU path of ParticleSystem, the particles are read from its storage buffers
+layout(std430, binding = 0) readonly buffer Positions { vec4 positions[]; };    // xyz, age
+layout(std430, binding = 1) readonly buffer Velocities { vec4 velocities[]; };  // xyz, lifetime
+layout(std430, binding = 2) readonly buffer Emitters { uint emitters[]; };
+// live list (drawStride 1) or the sorted keys (drawStride 2, the particle in every second element)
+layout(std430, binding = 3) readonly buffer DrawList { uint drawList[]; };
+
+out vec2 corner;
+out vec4 premultipliedColor;
+
+const int MAX_EMITTERS = 16;
+uniform uint drawStride;
+uniform mat4 viewProjection;
+uniform vec3 cameraRight;
+uniform vec3 cameraUp;
+uniform vec4 emitterStartColors[MAX_EMITTERS];
+uniform vec4 emitterEndColors[MAX_EMITTERS];
+// x: start size, y: end size, z: 1 for additive emitters
+uniform vec4 emitterSizes[MAX_EMITTERS];
+
+void main(){
+    uint particle = drawList[uint(gl_InstanceID) * drawStride + drawStride - 1u];
+    vec4 positionAge = positions[particle];
+
+    // the same billboard as ParticleBillboard.vert
+    corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;
+    float life = clamp(positionAge.w / velocities[particle].w, 0.0, 1.0);
+    int emitter = int(emitters[particle]);
+    vec4 color = mix(emitterStartColors[emitter], emitterEndColors[emitter], life);
+    vec4 size = emitterSizes[emitter];
+    premultipliedColor = vec4(color.rgb * color.a, size.z > 0.5 ? 0.0 : color.a);
+
+    vec3 offset = (cameraRight * corner.x + cameraUp * corner.y) * mix(size.x, size.y, life);
+    gl_Position = viewProjection * vec4(positionAge.xyz + offset, 1);
+}
\ No newline at end of file
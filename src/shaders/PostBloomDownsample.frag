@@ -0,0 +1,45 @@
+#version 330 core
+// one level of the bloom pyramid: a 4 tap (16 texel) box filter halving the source. The first level also keeps only
+// the part of the scene above the threshold and weights its taps by their brightness, so single hot pixels do not
+// flicker
+out vec3 color;
+
+uniform sampler2D source;
+// render area in source and target pixels, the rest of both textures is stale
+uniform vec2 sourceArea;
+uniform vec2 targetArea;
+// brightness where the bloom starts, negative for the levels after the first
+uniform float threshold = -1.0;
+
+vec3 tap(vec2 position) {
+    return texture(source, clamp(position, vec2(0.5), sourceArea - 0.5) / vec2(textureSize(source, 0))).rgb;
+}
+
+float luma(vec3 value) {
+    return dot(value, vec3(0.2126, 0.7152, 0.0722));
+}
+
+void main(){
+    vec2 position = gl_FragCoord.xy / targetArea * sourceArea;
+    vec3 taps[4] = vec3[4](tap(position + vec2(-1.0, -1.0)), tap(position + vec2(1.0, -1.0)),
+                           tap(position + vec2(-1.0, 1.0)), tap(position + vec2(1.0, 1.0)));
+    if (threshold < 0.0) {
+        color = (taps[0] + taps[1] + taps[2] + taps[3]) * 0.25;
+        return;
+    }
+
+    vec3 sum = vec3(0.0);
+    float weights = 0.0;
+    for (int i = 0; i < 4; ++i) {
+        float brightness = luma(taps[i]);
+        // soft knee: the part above the threshold fades in over half the threshold below it
+        float knee = threshold * 0.5;
+        float soft = clamp(brightness - threshold + knee, 0.0, 2.0 * knee);
+        soft = soft * soft / (4.0 * knee + 1e-4);
+        float kept = max(soft, brightness - threshold) / max(brightness, 1e-4);
+        float weight = 1.0 / (1.0 + brightness);
+        sum += taps[i] * kept * weight;
+        weights += weight;
+    }
+    color = sum / weights;
+}
\ No newline at end of file
@@ -0,0 +1,19 @@
+#version 330 core
+// adds the next smaller bloom level to this one (the pass blends additively), 4 bilinear taps form a tent filter that
+// hides the blocks of the lower resolution
+out vec3 color;
+
+uniform sampler2D source;
+// render area in source and target pixels
+uniform vec2 sourceArea;
+uniform vec2 targetArea;
+
+vec3 tap(vec2 position) {
+    return texture(source, clamp(position, vec2(0.5), sourceArea - 0.5) / vec2(textureSize(source, 0))).rgb;
+}
+
+void main(){
+    vec2 position = gl_FragCoord.xy / targetArea * sourceArea;
+    color = (tap(position + vec2(-0.5, -0.5)) + tap(position + vec2(0.5, -0.5)) +
+             tap(position + vec2(-0.5, 0.5)) + tap(position + vec2(0.5, 0.5))) * 0.25;
+}
\ No newline at end of file
@@ -0,0 +1,23 @@
+#version 330 core
+// one direction of the separable bloom blur for contexts without compute shaders, the kernel of PostBlur.comp
+out vec3 color;
+
+uniform sampler2D source;
+// (1, 0) blurs rows, (0, 1) columns
+uniform ivec2 direction;
+// render area in pixels, the same in source and target
+uniform ivec2 area;
+
+const int RADIUS = 6;
+const float WEIGHTS[RADIUS + 1] = float[RADIUS + 1](0.1370, 0.1296, 0.1097, 0.0831, 0.0563, 0.0342, 0.0185);
+
+void main(){
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec3 sum = texelFetch(source, pixel, 0).rgb * WEIGHTS[0];
+    for (int i = 1; i <= RADIUS; ++i) {
+        ivec2 offset = direction * i;
+        sum += (texelFetch(source, clamp(pixel - offset, ivec2(0), area - 1), 0).rgb +
+                texelFetch(source, clamp(pixel + offset, ivec2(0), area - 1), 0).rgb) * WEIGHTS[i];
+    }
+    color = sum;
+}
\ No newline at end of file
@@ -0,0 +1,37 @@
+#version 330 core
+// tonemapping, bloom and color grading of the scene into the low dynamic range target. The luma of the result is kept
+// in alpha for PostFxaa.frag
+out vec4 color;
+
+uniform sampler2D scene;
+uniform sampler2D bloom;
+uniform sampler3D gradingLut;
+// render area in scene and bloom pixels
+uniform vec2 sceneArea;
+uniform vec2 bloomArea;
+// 0 without bloom
+uniform float bloomIntensity = 0.0;
+uniform float exposure = 1.0;
+uniform bool tonemapping = true;
+uniform bool grading = false;
+
+// filmic curve fitted to ACES (Narkowicz 2015)
+vec3 aces(vec3 x) {
+    return clamp((x * (2.51 * x + 0.03)) / (x * (2.43 * x + 0.59) + 0.14), 0.0, 1.0);
+}
+
+void main(){
+    vec3 hdr = texelFetch(scene, ivec2(gl_FragCoord.xy), 0).rgb;
+    if (bloomIntensity > 0.0) {
+        vec2 position = clamp(gl_FragCoord.xy / sceneArea * bloomArea, vec2(0.5), bloomArea - 0.5);
+        hdr += texture(bloom, position / vec2(textureSize(bloom, 0))).rgb * bloomIntensity;
+    }
+    hdr *= exposure;
+    vec3 ldr = tonemapping ? aces(hdr) : clamp(hdr, 0.0, 1.0);
+    // the lookup goes through the texel centers of the first and last LUT entries
+    if (grading) {
+        float size = float(textureSize(gradingLut, 0).x);
+        ldr = texture(gradingLut, ldr * ((size - 1.0) / size) + 0.5 / size).rgb;
+    }
+    color = vec4(ldr, dot(ldr, vec3(0.299, 0.587, 0.114)));
+}
\ No newline at end of file
@@ -0,0 +1,104 @@
+#version 330 core
+// FXAA: finds edges in the luma of the tonemapped image (alpha, see PostComposite.frag), searches along them for
+// their ends and blends across them by the position on the edge. A cheap replacement for multisampling
+out vec4 color;
+
+uniform sampler2D source;
+// render area in pixels
+uniform vec2 area;
+
+const float EDGE_THRESHOLD = 0.125;
+const float EDGE_THRESHOLD_MINIMUM = 0.0312;
+const float SUBPIXEL_QUALITY = 0.75;
+const int SEARCH_STEPS = 8;
+const float SEARCH_STEP_SIZES[SEARCH_STEPS] = float[SEARCH_STEPS](1.0, 1.0, 1.0, 1.5, 2.0, 2.0, 4.0, 8.0);
+
+vec4 at(vec2 position) {
+    return texture(source, clamp(position, vec2(0.5), area - 0.5) / vec2(textureSize(source, 0)));
+}
+
+void main(){
+    vec2 position = gl_FragCoord.xy;
+    vec4 center = at(position);
+    float lumaCenter = center.a;
+    float lumaDown = at(position + vec2(0.0, -1.0)).a;
+    float lumaUp = at(position + vec2(0.0, 1.0)).a;
+    float lumaLeft = at(position + vec2(-1.0, 0.0)).a;
+    float lumaRight = at(position + vec2(1.0, 0.0)).a;
+    float lumaMinimum = min(lumaCenter, min(min(lumaDown, lumaUp), min(lumaLeft, lumaRight)));
+    float lumaMaximum = max(lumaCenter, max(max(lumaDown, lumaUp), max(lumaLeft, lumaRight)));
+    float range = lumaMaximum - lumaMinimum;
+    // no edge, or one too faint to see
+    if (range < max(EDGE_THRESHOLD_MINIMUM, lumaMaximum * EDGE_THRESHOLD)) {
+        color = vec4(center.rgb, 1.0);
+        return;
+    }
+
+    float lumaDownLeft = at(position + vec2(-1.0, -1.0)).a;
+    float lumaUpRight = at(position + vec2(1.0, 1.0)).a;
+    float lumaUpLeft = at(position + vec2(-1.0, 1.0)).a;
+    float lumaDownRight = at(position + vec2(1.0, -1.0)).a;
+    float lumaDownUp = lumaDown + lumaUp;
+    float lumaLeftRight = lumaLeft + lumaRight;
+    float lumaLeftCorners = lumaDownLeft + lumaUpLeft;
+    float lumaDownCorners = lumaDownLeft + lumaDownRight;
+    float lumaRightCorners = lumaDownRight + lumaUpRight;
+    float lumaUpCorners = lumaUpRight + lumaUpLeft;
+
+    // edge orientation from the second derivatives along both axes
+    float edgeHorizontal = abs(-2.0 * lumaLeft + lumaLeftCorners) + abs(-2.0 * lumaCenter + lumaDownUp) * 2.0 +
+                           abs(-2.0 * lumaRight + lumaRightCorners);
+    float edgeVertical = abs(-2.0 * lumaUp + lumaUpCorners) + abs(-2.0 * lumaCenter + lumaLeftRight) * 2.0 +
+                         abs(-2.0 * lumaDown + lumaDownCorners);
+    bool horizontal = edgeHorizontal >= edgeVertical;
+
+    // the side of the pixel the edge is on
+    float luma1 = horizontal ? lumaDown : lumaLeft;
+    float luma2 = horizontal ? lumaUp : lumaRight;
+    float gradient1 = luma1 - lumaCenter;
+    float gradient2 = luma2 - lumaCenter;
+    bool steepest1 = abs(gradient1) >= abs(gradient2);
+    float gradientScaled = 0.25 * max(abs(gradient1), abs(gradient2));
+    float stepLength = steepest1 ? -1.0 : 1.0;
+    float lumaLocalAverage = 0.5 * ((steepest1 ? luma1 : luma2) + lumaCenter);
+
+    // walk along the edge, half a pixel towards it, in both directions until the luma leaves the edge
+    vec2 onEdge = position + (horizontal ? vec2(0.0, stepLength * 0.5) : vec2(stepLength * 0.5, 0.0));
+    vec2 offset = horizontal ? vec2(1.0, 0.0) : vec2(0.0, 1.0);
+    vec2 position1 = onEdge - offset;
+    vec2 position2 = onEdge + offset;
+    float lumaEnd1 = at(position1).a - lumaLocalAverage;
+    float lumaEnd2 = at(position2).a - lumaLocalAverage;
+    bool reached1 = abs(lumaEnd1) >= gradientScaled;
+    bool reached2 = abs(lumaEnd2) >= gradientScaled;
+    for (int i = 1; i < SEARCH_STEPS && !(reached1 && reached2); ++i) {
+        if (!reached1) {
+            position1 -= offset * SEARCH_STEP_SIZES[i];
+            lumaEnd1 = at(position1).a - lumaLocalAverage;
+            reached1 = abs(lumaEnd1) >= gradientScaled;
+        }
+        if (!reached2) {
+            position2 += offset * SEARCH_STEP_SIZES[i];
+            lumaEnd2 = at(position2).a - lumaLocalAverage;
+            reached2 = abs(lumaEnd2) >= gradientScaled;
+        }
+    }
+
+    // blend by the distance to the closer end, if the luma there changes the way it does across the edge
+    float distance1 = horizontal ? position.x - position1.x : position.y - position1.y;
+    float distance2 = horizontal ? position2.x - position.x : position2.y - position.y;
+    bool direction1 = distance1 < distance2;
+    float pixelOffset = 0.5 - min(distance1, distance2) / (distance1 + distance2);
+    bool centerSmaller = lumaCenter < lumaLocalAverage;
+    bool correctVariation = ((direction1 ? lumaEnd1 : lumaEnd2) < 0.0) != centerSmaller;
+    float finalOffset = correctVariation ? pixelOffset : 0.0;
+
+    // thin lines and single pixels get blended by the contrast to their neighbourhood
+    float lumaAverage = (2.0 * (lumaDownUp + lumaLeftRight) + lumaLeftCorners + lumaRightCorners) / 12.0;
+    float subpixel = clamp(abs(lumaAverage - lumaCenter) / range, 0.0, 1.0);
+    subpixel = (-2.0 * subpixel + 3.0) * subpixel * subpixel;
+    finalOffset = max(finalOffset, subpixel * subpixel * SUBPIXEL_QUALITY);
+
+    vec2 blended = position + (horizontal ? vec2(0.0, finalOffset * stepLength) : vec2(finalOffset * stepLength, 0.0));
+    color = vec4(at(blended).rgb, 1.0);
+}
\ No newline at end of file
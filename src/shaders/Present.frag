@@ -0,0 +1,42 @@
+#version 330 core
+// resamples the render area of a render target to the bound framebuffer: a bilinear upscale followed by contrast
+// adaptive sharpening, which brings back some of the detail a lower render resolution loses
+out vec4 color;
+
+uniform sampler2D source;
+uniform vec2 targetSize;
+// size of the render area relative to the source texture
+uniform vec2 sourceScale = vec2(1.0);
+// 0 copies the bilinear result, 1 sharpens the most
+uniform float sharpness = 0.0;
+
+// bilinear tap at a position in source pixels, pixels outside of the render area are stale and never blended in
+vec3 tap(vec2 position, vec2 areaSize, vec2 sourceTexel) {
+    return texture(source, clamp(position, vec2(0.5), areaSize - 0.5) * sourceTexel).rgb;
+}
+
+void main(){
+    vec2 sourceSize = vec2(textureSize(source, 0));
+    vec2 areaSize = sourceSize * sourceScale;
+    vec2 sourceTexel = 1.0 / sourceSize;
+    vec2 position = gl_FragCoord.xy / targetSize * areaSize;
+
+    vec3 center = tap(position, areaSize, sourceTexel);
+    if (sharpness <= 0.0) {
+        color = vec4(center, 1.0);
+        return;
+    }
+
+    // the neighbours one source pixel away limit the sharpening: flat areas are sharpened the most, high contrast
+    // edges less, so it does not ring
+    vec3 north = tap(position + vec2(0.0, 1.0), areaSize, sourceTexel);
+    vec3 south = tap(position - vec2(0.0, 1.0), areaSize, sourceTexel);
+    vec3 east = tap(position + vec2(1.0, 0.0), areaSize, sourceTexel);
+    vec3 west = tap(position - vec2(1.0, 0.0), areaSize, sourceTexel);
+    vec3 minimum = min(center, min(min(north, south), min(east, west)));
+    vec3 maximum = max(center, max(max(north, south), max(east, west)));
+    vec3 amplitude = sqrt(clamp(min(minimum, 1.0 - maximum) / max(maximum, vec3(1e-4)), 0.0, 1.0));
+    vec3 weight = -amplitude * mix(0.125, 0.2, sharpness);
+    vec3 sharpened = (center + (north + south + east + west) * weight) / (1.0 + 4.0 * weight);
+    color = vec4(clamp(sharpened, 0.0, 1.0), 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,5 @@
+#version 330 core
+// depth only, the shadow map has no color attachment
+
+void main(){
+}
\ No newline at end of file
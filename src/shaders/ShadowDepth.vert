@@ -0,0 +1,13 @@
+#version 330 core
+// shadow casters (see ShadowCascades): position only, same attribute layout as MeshShader.vert
+layout(location = 0) in vec3 vertexPosition_modelspace;
+
+// cascade matrix * model matrix
+uniform mat4 MVP;
+// dequantization of unorm16 positions (see VertexDecode), the defaults leave float positions untouched
+uniform vec3 positionScale = vec3(1);
+uniform vec3 positionOffset = vec3(0);
+
+void main(){
+    gl_Position = MVP * vec4(positionOffset + vertexPosition_modelspace * positionScale,1);
+}
\ No newline at end of file
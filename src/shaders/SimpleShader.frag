@@ -1,5 +0,0 @@
-#version 330 core
-out vec3 color;
-void main(){
-    color = vec3(1,0,0);
-}
\ No newline at end of file
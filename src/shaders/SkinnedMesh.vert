@@ -0,0 +1,44 @@
+#version 330 core
+// vertex location data
+layout(location = 0) in vec3 vertexPosition_modelspace;
+// vertex texture data
+layout(location = 1) in vec2 vertexUV;
+// vertex normal data
+layout(location = 2) in vec3 vertexNormal;
+// up to four joints (glTF JOINTS_0) and their weights (WEIGHTS_0), the weights add up to 1
+layout(location = 5) in uvec4 vertexJoints;
+layout(location = 6) in vec4 vertexWeights;
+
+out vec2 UV;
+out vec3 Normal_worldspace;
+out vec3 Position_worldspace;
+
+// Model View Projection Matrix and the Model Matrix alone for the normals (uniform scale only)
+uniform mat4 MVP;
+uniform mat4 M;
+
+// skinning matrices of the character (Animation::evaluate): the rows of a 3x4 matrix per joint, bound as a range of
+// the frame's stream buffer
+layout(std140) uniform SkinningPalette {
+    vec4 jointRows[3 * 64];
+};
+
+void main(){
+    // linear blend skinning: the weighted sum of the joint matrices moves the vertex from the bind pose
+    vec4 rows[3] = vec4[3](vec4(0), vec4(0), vec4(0));
+    for (int i = 0; i < 4; ++i) {
+        int joint = int(vertexJoints[i]) * 3;
+        rows[0] += jointRows[joint] * vertexWeights[i];
+        rows[1] += jointRows[joint + 1] * vertexWeights[i];
+        rows[2] += jointRows[joint + 2] * vertexWeights[i];
+    }
+    vec4 bindPosition = vec4(vertexPosition_modelspace, 1);
+    vec4 position = vec4(dot(rows[0], bindPosition), dot(rows[1], bindPosition), dot(rows[2], bindPosition), 1);
+    gl_Position = MVP * position;
+    Position_worldspace = (M * position).xyz;
+
+    UV = vertexUV;
+    // without non-uniform joint scales the upper 3x3 of the blended matrix turns the normal as well
+    vec3 normal = vec3(dot(rows[0].xyz, vertexNormal), dot(rows[1].xyz, vertexNormal), dot(rows[2].xyz, vertexNormal));
+    Normal_worldspace = mat3(M) * normal;
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+#version 330 core
+// terrain chunks (see Terrain): the shared 33 x 33 vertex grid placed by the instance, heights from the tile cache
+
+// per chunk: x and y of its quadtree node, the level of the node and the texture array layer of its tile
+layout(location = 0) in uvec4 chunk;
+
+out vec2 UV;
+out vec3 Normal_worldspace;
+out vec3 Position_worldspace;
+
+uniform mat4 viewProjection;
+// R16 tiles of 259 x 259 samples: one sample apron, then the 257 samples of the tile
+uniform sampler2DArray heights;
+// world position of sample (0, 0) at height 0, distance between the samples of level 0, world height of 65535
+uniform vec3 origin;
+uniform float spacing;
+uniform float heightScale;
+uniform float uvScale = 0.25;
+
+const int CHUNK_QUADS = 32;
+const int CHUNKS_PER_TILE = 8;
+
+float heightAt(ivec2 texel, int layer){
+    return texelFetch(heights, ivec3(texel, layer), 0).r * heightScale;
+}
+
+void main(){
+    // the element buffer indexes the grid row by row, the index is the grid position
+    ivec2 grid = ivec2(gl_VertexID % (CHUNK_QUADS + 1), gl_VertexID / (CHUNK_QUADS + 1));
+    ivec2 node = ivec2(chunk.xy);
+    int layer = int(chunk.w);
+    float quadSize = spacing * float(1 << int(chunk.z));
+
+    ivec2 texel = (node % CHUNKS_PER_TILE) * CHUNK_QUADS + grid + 1;
+    vec2 planar = vec2(node * CHUNK_QUADS + grid) * quadSize;
+    Position_worldspace = origin + vec3(planar.x, heightAt(texel, layer), planar.y);
+    gl_Position = viewProjection * vec4(Position_worldspace, 1);
+
+    // central differences over the neighbouring samples of the level, the apron covers the tile edges
+    float dx = heightAt(texel + ivec2(1, 0), layer) - heightAt(texel - ivec2(1, 0), layer);
+    float dz = heightAt(texel + ivec2(0, 1), layer) - heightAt(texel - ivec2(0, 1), layer);
+    Normal_worldspace = normalize(vec3(-dx, 2.0 * quadSize, -dz));
+    UV = Position_worldspace.xz * uvScale;
+}
\ No newline at end of file
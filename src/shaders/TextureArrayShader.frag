@@ -0,0 +1,14 @@
+#version 330 core
+
+// Interpolated values from the vertex shaders
+in vec3 UV;
+
+// output color drawn to display
+out vec3 color;
+
+// texture array shared by all instances of the batch
+uniform sampler2DArray myTextureArraySampler;
+
+void main(){
+    color = texture( myTextureArraySampler, UV).rgb;
+}
\ No newline at end of file
@@ -0,0 +1,21 @@
+#version 330 core
+// vertex location data
+layout(location = 0) in vec3 vertexPosition_modelspace;
+// vertex texture data
+layout(location = 1) in vec2 vertexUV;
+// per instance data (glVertexAttribDivisor = 1): texture array layer and model matrix (uses locations 3 - 6)
+layout(location = 2) in float instanceLayer;
+layout(location = 3) in mat4 instanceModel;
+
+out vec3 UV;
+
+// View Projection Matrix, the model matrix comes with the instance
+uniform mat4 VP;
+
+void main(){
+    // final position for the vertex: VP * M * position
+    gl_Position = VP * instanceModel * vec4(vertexPosition_modelspace,1);
+
+    // UV of the vertex, the layer selects the texture inside the array
+    UV = vec3(vertexUV, instanceLayer);
+}
\ No newline at end of file
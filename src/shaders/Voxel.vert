@@ -0,0 +1,29 @@
+#version 330 core
+// voxel chunk quads (see VoxelWorld): corners in voxels from the lower corner of the chunk, one face per quad
+
+// x, y and z of the corner and the face: 0 -x, 1 +x, 2 -y, 3 +y, 4 -z, 5 +z
+layout(location = 0) in uvec4 corner;
+layout(location = 1) in uint material;
+
+out vec2 UV;
+out vec3 Normal_worldspace;
+out vec3 Position_worldspace;
+
+uniform mat4 viewProjection;
+uniform vec3 chunkOrigin;
+uniform float voxelSize;
+uniform float uvScale = 0.5;
+
+const vec3 NORMALS[6] = vec3[6](vec3(-1, 0, 0), vec3(1, 0, 0), vec3(0, -1, 0), vec3(0, 1, 0), vec3(0, 0, -1),
+                                vec3(0, 0, 1));
+
+void main(){
+    int face = int(corner.w);
+    Position_worldspace = chunkOrigin + vec3(corner.xyz) * voxelSize;
+    gl_Position = viewProjection * vec4(Position_worldspace, 1);
+    Normal_worldspace = NORMALS[face];
+
+    // the texture tiles over the plane of the face, every material starts at another place of it
+    vec2 planar = face < 2 ? Position_worldspace.zy : (face < 4 ? Position_worldspace.xz : Position_worldspace.xy);
+    UV = planar * uvScale + vec2(material) * vec2(0.37, 0.61);
+}
\ No newline at end of file
@@ -0,0 +1,69 @@
+//
+// Created by jonas on 19.10.26.
+//
+// Packs loose asset files into one .pak archive that the engine mounts at startup
+//
+//   AssetPacker <output.pak> [--lz4|--zstd] <file|directory>...
+//
+// Directories are packed recursively. Every entry is stored under the path it was given with, so
+// "AssetPacker assets.pak src/shaders src/Textures" serves "src/shaders/MeshShader.vert" from the archive.
+// Entries are only kept compressed if that makes them smaller.
+//
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "common/AssetArchive.hpp"
+
+static void printUsage() {
+    printf("Usage: AssetPacker <output.pak> [--lz4|--zstd] <file|directory>...\n");
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3) {printUsage(); return 1;}
+
+    Compression::Codec codec = Compression::Codec::None;
+    std::vector<AssetArchive::Source> sources;
+    for (int i = 2; i < argc; ++i) {
+        if (strcmp(argv[i], "--lz4") == 0) {codec = Compression::Codec::LZ4; continue;}
+        if (strcmp(argv[i], "--zstd") == 0) {codec = Compression::Codec::Zstd; continue;}
+
+        std::error_code error;
+        std::filesystem::path path(argv[i]);
+        if (std::filesystem::is_directory(path, error)) {
+            for (const auto &file : std::filesystem::recursive_directory_iterator(path, error)) {
+                if (!file.is_regular_file()) continue;
+                std::string name = file.path().generic_string();
+                sources.push_back({name, file.path().string()});
+            }
+        } else if (std::filesystem::is_regular_file(path, error)) {
+            sources.push_back({path.generic_string(), path.string()});
+        } else {
+            printf("%s does not exist\n", argv[i]);
+            return 1;
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    if (!AssetArchive::write(argv[1], sources, codec)) return 1;
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // report what the runtime will see
+    AssetArchive archive;
+    if (!archive.open(argv[1])) return 1;
+    unsigned long long size = 0, stored = 0;
+    unsigned int compressed = 0;
+    for (uint32_t i = 0; i < archive.entryCount(); ++i) {
+        const AssetArchive::Entry &entry = archive.entry(i);
+        size += entry.size;
+        stored += entry.storedSize;
+        compressed += entry.codec != unsigned(Compression::Codec::None);
+    }
+    printf("%s: %u entries (%u compressed) in %.3f s\n", argv[1], archive.entryCount(), compressed, seconds);
+    printf("  %llu -> %llu bytes of asset data\n", size, stored);
+    return 0;
+}
@@ -0,0 +1,1491 @@
+//
+// Created by jonas on 19.10.26.
+//
+// Runtime system benchmarks, the GPU ones render into a hidden window
+//
+//   EngineBench lights [maxLights] [iterations]   clustered light assignment for 256 up to maxLights point lights
+//   EngineBench shadows [frames]                  cascade fitting, texel snapping and caching along a camera path
+//   EngineBench graph [iterations]                render graph culling, ordering and transient texture aliasing
+//   EngineBench resolution [frames]               dynamic resolution controller on a simulated GPU load (frames >= 400)
+//   EngineBench animation [characters] [frames]   clip compression and pose evaluation of blended characters
+//   EngineBench terrain [size] [frames]           heightfield build, tile streaming and chunk selection of a flight
+//   EngineBench voxels [chunks] [edits]           voxel storage, greedy meshing throughput and dirty chunk remeshing
+//   EngineBench culling [objects]                 GpuCulling GPU path against its CPU path, with and without Hi-Z
+//   EngineBench stream [frames]                   StreamBuffer data as the GPU reads it, persistent and orphaning path
+//   EngineBench frame [frames]                    steady state frames of the main.cpp CPU systems must not allocate
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "common/Animation.hpp"
+#include "common/DynamicResolution.hpp"
+#include "common/GLExtensions.hpp"
+#include "common/GpuCulling.hpp"
+#include "common/HiddenContext.hpp"
+#include "common/JobSystem.hpp"
+#include "common/LightClusters.hpp"
+#include "common/Memory.hpp"
+#include "common/RenderGraph.hpp"
+#include "common/ShadowCascades.hpp"
+#include "common/StreamBuffer.hpp"
+#include "common/shader.hpp"
+#include "common/Terrain.hpp"
+#include "common/VoxelWorld.hpp"
+
+/** Shortest resolution run: the checks look at the second half of every quarter of the run and at the 100 frames
+ *  after each spike (frames 250 to 349 of every 500), shorter runs leave too little of either
+ */
+static constexpr unsigned int RESOLUTION_MINIMUM_FRAMES = 400;
+
+static void printUsage() {
+    printf("Usage: EngineBench lights [maxLights] [iterations]\n");
+    printf("       EngineBench shadows [frames]\n");
+    printf("       EngineBench graph [iterations]\n");
+    printf("       EngineBench resolution [frames >= %u]\n", RESOLUTION_MINIMUM_FRAMES);
+    printf("       EngineBench animation [characters] [frames]\n");
+    printf("       EngineBench terrain [size] [frames]\n");
+    printf("       EngineBench voxels [chunks] [edits]\n");
+    printf("       EngineBench culling [objects]\n");
+    printf("       EngineBench stream [frames]\n");
+    printf("       EngineBench frame [frames]\n");
+}
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/** Column major world to view matrix of a camera at eye looking at target, y up */
+static void lookAt(const float eye[3], const float target[3], float view[16]) {
+    float f[3] = {target[0] - eye[0], target[1] - eye[1], target[2] - eye[2]};
+    float length = std::sqrt(f[0] * f[0] + f[1] * f[1] + f[2] * f[2]);
+    for (float &c : f) c /= length;
+    float r[3] = {-f[2], 0.0f, f[0]}; // f x (0, 1, 0)
+    length = std::sqrt(r[0] * r[0] + r[2] * r[2]);
+    for (float &c : r) c /= length;
+    float u[3] = {r[1] * f[2] - r[2] * f[1], r[2] * f[0] - r[0] * f[2], r[0] * f[1] - r[1] * f[0]};
+    const float result[16] = {r[0], u[0], -f[0], 0, r[1], u[1], -f[1], 0, r[2], u[2], -f[2], 0, 0, 0, 0, 1};
+    memcpy(view, result, sizeof(result));
+    for (int i = 0; i < 3; ++i) {
+        view[12] -= r[i] * eye[i];
+        view[13] -= u[i] * eye[i];
+        view[14] += f[i] * eye[i];
+    }
+}
+
+/** Compares the clusters of every light against a brute force test of all cluster and light pairs
+ *
+ *  @returns Number of clusters whose list differs
+ */
+static size_t verifyClusters(const LightClusters &clusters, const float view[16], const std::vector<PointLight> &lights) {
+    size_t mismatches = 0;
+    std::vector<uint32_t> expected, actual;
+    for (unsigned int c = 0; c < clusters.clusterCount(); ++c) {
+        expected.clear();
+        for (size_t i = 0; i < lights.size(); ++i) {
+            const float *p = lights[i].position;
+            float center[3];
+            for (int row = 0; row < 3; ++row)
+                center[row] = view[row] * p[0] + view[4 + row] * p[1] + view[8 + row] * p[2] + view[12 + row];
+            if (clusters.touches(c, center, lights[i].radius)) expected.push_back(uint32_t(i));
+        }
+        const uint32_t *range = clusters.clusterRange(c);
+        actual.assign(clusters.lightIndices() + range[0], clusters.lightIndices() + range[0] + range[1]);
+        std::sort(actual.begin(), actual.end());
+        mismatches += actual != expected;
+    }
+    return mismatches;
+}
+
+static int lights(int argc, char **argv) {
+    size_t maxLights = argc > 2 ? size_t(std::max(atoi(argv[2]), 1)) : 16384;
+    unsigned int iterations = argc > 3 ? std::max(atoi(argv[3]), 1) : 50;
+
+    // a 200 x 200 courtyard, lights between the floor and 20 units up
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> horizontal(-100.0f, 100.0f), vertical(0.0f, 20.0f), radius(3.0f, 10.0f),
+            unit(0.0f, 1.0f);
+    std::vector<PointLight> all(maxLights);
+    for (PointLight &light : all) {
+        light = {{horizontal(random), vertical(random), horizontal(random)}, radius(random),
+                 {unit(random), unit(random), unit(random)}, 1.0f};
+    }
+
+    const unsigned int width = 1920, height = 1080;
+    LightClusters clusters;
+    clusters.setProjection(1.0472f, float(width) / float(height), 0.1f, 300.0f, width, height);
+    printf("%u clusters, %u threads\n", clusters.clusterCount(), JobSystem::threadCount());
+
+    // 256, 1024, 4096, ... and maxLights itself
+    std::vector<size_t> counts;
+    for (size_t count = 256; count < maxLights; count *= 4) counts.push_back(count);
+    counts.push_back(maxLights);
+
+    bool failed = false;
+    for (size_t count : counts) {
+        std::vector<PointLight> scene(all.begin(), all.begin() + ptrdiff_t(count));
+        float view[16];
+        const float eye[3] = {0.0f, 8.0f, -60.0f};
+
+        // the camera turns around its position, every iteration is one frame
+        auto frameView = [&](unsigned int frame) {
+            Memory::beginFrame();
+            float angle = float(frame) * 0.0785398f;
+            const float target[3] = {eye[0] + std::sin(angle), eye[1] - 0.2f, eye[2] + std::cos(angle)};
+            lookAt(eye, target, view);
+        };
+        frameView(0);
+        clusters.assign(view, scene.data(), scene.size());
+        size_t mismatches = verifyClusters(clusters, view, scene);
+
+        // warm up: grow the lists to the largest frame before the steady state is measured
+        for (unsigned int i = 0; i < iterations; ++i) {
+            frameView(i);
+            clusters.assign(view, scene.data(), scene.size());
+        }
+        double total = 0.0, worst = 0.0;
+        size_t indices = 0, busiest = 0;
+        uint64_t allocations = Memory::heapAllocations();
+        for (unsigned int i = 0; i < iterations; ++i) {
+            frameView(i);
+            auto start = std::chrono::steady_clock::now();
+            clusters.assign(view, scene.data(), scene.size());
+            double seconds = secondsSince(start);
+            total += seconds;
+            worst = std::max(worst, seconds);
+            indices += clusters.lightIndexCount();
+            for (unsigned int c = 0; c < clusters.clusterCount(); ++c) busiest = std::max<size_t>(busiest, clusters.clusterRange(c)[1]);
+        }
+        allocations = Memory::heapAllocations() - allocations;
+
+        printf("  %6zu lights: %.3f ms mean, %.3f ms worst, %.1f lights per cluster (max %zu), %llu heap allocations, %s\n",
+               count, total / iterations * 1e3, worst * 1e3, double(indices) / iterations / clusters.clusterCount(), busiest,
+               static_cast<unsigned long long>(allocations), mismatches ? "lists differ" : "lists match");
+        failed = failed || mismatches || allocations;
+    }
+    printf("%s\n", failed ? "light test failed" : "light test passed");
+    return failed ? 1 : 0;
+}
+
+static int shadows(int argc, char **argv) {
+    unsigned int frames = argc > 2 ? std::max(atoi(argv[2]), 2) : 600;
+    const unsigned int resolution = 2048;
+    ShadowCascades cascades(resolution, 4, 2);
+    cascades.setRange(0.1f, 150.0f);
+    const float lightDirection[3] = {0.4f, 0.8f, 0.45f};
+
+    // casters scattered over a 400 x 400 area, every fourth one moves
+    std::mt19937 random(11);
+    std::uniform_real_distribution<float> horizontal(-200.0f, 200.0f), vertical(0.0f, 10.0f), radius(0.5f, 4.0f);
+    struct Caster {
+        float center[3];
+        float radius;
+        bool staticGeometry;
+    };
+    std::vector<Caster> casters(20000);
+    for (size_t i = 0; i < casters.size(); ++i)
+        casters[i] = {{horizontal(random), vertical(random), horizontal(random)}, radius(random), i % 4 != 0};
+
+    // the camera walks forward while turning, texel steps must stay whole and the cached cascades must be reused
+    float previous[ShadowCascades::MAX_CASCADES][16] = {};
+    size_t refits[ShadowCascades::MAX_CASCADES] = {}, casterTests[ShadowCascades::MAX_CASCADES] = {};
+    double worstSnap = 0.0, seconds = 0.0;
+    float firstTexel[ShadowCascades::MAX_CASCADES];
+    bool texelsStable = true;
+    for (unsigned int frame = 0; frame < frames; ++frame) {
+        float angle = float(frame) * 0.01f;
+        const float eye[3] = {float(frame) * 0.05f, 2.0f, float(frame) * 0.03f};
+        const float target[3] = {eye[0] + std::sin(angle), eye[1] - 0.1f, eye[2] + std::cos(angle)};
+        float view[16];
+        lookAt(eye, target, view);
+
+        // without a context nothing is rendered, a cached cascade counts as rendered when its matrix changed
+        auto start = std::chrono::steady_clock::now();
+        cascades.update(view, 1.0472f, 16.0f / 9.0f, lightDirection);
+        for (unsigned int c = 0; c < cascades.count(); ++c) {
+            const float *matrix = cascades.cascadeMatrix(c);
+            bool moved = frame > 0 && memcmp(previous[c], matrix, sizeof(previous[c])) != 0;
+            refits[c] += moved;
+            memcpy(previous[c], matrix, sizeof(previous[c]));
+            if (cascades.cached(c) && !moved && frame > 0) continue;
+            for (const Caster &caster : casters)
+                casterTests[c] += cascades.castsShadow(c, caster.center, caster.radius, caster.staticGeometry);
+        }
+        seconds += secondsSince(start);
+
+        for (unsigned int c = 0; c < cascades.count(); ++c) {
+            const float *matrix = cascades.cascadeMatrix(c);
+            // the light space translation in texels (half the resolution per unit of clip space) is a whole number
+            for (int axis = 0; axis < 2; ++axis) {
+                double texels = double(matrix[12 + axis]) * resolution * 0.5;
+                worstSnap = std::max(worstSnap, std::abs(texels - std::round(texels)));
+            }
+            if (frame == 0) firstTexel[c] = cascades.texelSize(c);
+            texelsStable = texelsStable && (cascades.cached(c) || cascades.texelSize(c) == firstTexel[c]);
+        }
+    }
+
+    printf("%u frames, %zu casters, %.3f ms per frame for fitting and caster culling\n", frames, casters.size(),
+           seconds / frames * 1e3);
+    for (unsigned int c = 0; c < cascades.count(); ++c) {
+        printf("  cascade %u: up to %6.1f, texel %.4f, %s, refitted in %zu frames, %.0f casters per render\n", c,
+               cascades.splitDepth(c), cascades.texelSize(c), cascades.cached(c) ? "cached " : "dynamic", refits[c],
+               double(casterTests[c]) / double(cascades.cached(c) ? refits[c] + 1 : frames));
+    }
+    printf("  worst texel snapping error %.5f texels, texel size %s\n", worstSnap, texelsStable ? "stable" : "changed");
+
+    // cached cascades have to be reused for most frames of a slow walk
+    size_t cachedRefits = 0, cachedCount = 0;
+    for (unsigned int c = 0; c < cascades.count(); ++c) {
+        if (!cascades.cached(c)) continue;
+        cachedRefits += refits[c];
+        ++cachedCount;
+    }
+    bool failed = worstSnap > 0.01 || !texelsStable || cachedRefits * 10 > size_t(frames) * cachedCount;
+    printf("%s\n", failed ? "shadow test failed" : "shadow test passed");
+    return failed ? 1 : 0;
+}
+
+/** Deferred frame with post processing at 1080p, declared the way a renderer would grow it
+ *
+ *  @param[out] dependencies Pairs of passes that have to run in this order
+ *  @param[out] culledPass Pass whose result nobody uses
+ */
+static void buildFrame(RenderGraph &graph, std::vector<std::pair<RenderGraph::Pass, RenderGraph::Pass>> &dependencies,
+                       RenderGraph::Pass &culledPass) {
+    using Pass = RenderGraph::Pass;
+    using Resource = RenderGraph::Resource;
+    const unsigned int width = 1920, height = 1080;
+    const RenderTargetDescription depthTarget{width, height, GL_DEPTH24_STENCIL8};
+    const RenderTargetDescription colorTarget{width, height, GL_RGBA8};
+    const RenderTargetDescription hdrTarget{width, height, GL_RGBA16F};
+    const RenderTargetDescription aoTarget{width, height, GL_R8};
+
+    Resource shadowMap = graph.importTexture("shadow map", 1, {2048, 2048, GL_DEPTH_COMPONENT24});
+    Resource history = graph.importTexture("history", 2, hdrTarget);
+    Resource backbuffer = graph.importBackbuffer("backbuffer", width, height);
+    Resource depth = graph.createTexture("depth", depthTarget);
+    Resource albedo = graph.createTexture("albedo", colorTarget);
+    Resource normal = graph.createTexture("normal", {width, height, GL_RG16});
+    Resource ao = graph.createTexture("ao", aoTarget);
+    Resource aoBlurred = graph.createTexture("ao blurred", aoTarget);
+    Resource hdr = graph.createTexture("hdr", hdrTarget);
+    Resource ldr = graph.createTexture("ldr", colorTarget);
+    Resource debug = graph.createTexture("debug", colorTarget);
+
+    Pass shadows = graph.addPass("shadows", nullptr);
+    shadowMap = graph.write(shadows, shadowMap);
+    Pass prepass = graph.addPass("depth prepass", nullptr);
+    depth = graph.attach(prepass, depth);
+    Pass geometry = graph.addPass("geometry", nullptr);
+    albedo = graph.attach(geometry, albedo);
+    normal = graph.attach(geometry, normal);
+    depth = graph.attach(geometry, depth);
+    Pass ssao = graph.addPass("ssao", nullptr);
+    graph.read(ssao, depth);
+    graph.read(ssao, normal);
+    ao = graph.attach(ssao, ao);
+    Pass blur = graph.addPass("ssao blur", nullptr);
+    graph.read(blur, ao);
+    aoBlurred = graph.attach(blur, aoBlurred);
+    Pass lighting = graph.addPass("lighting", nullptr);
+    for (Resource input : {albedo, normal, depth, aoBlurred, shadowMap}) graph.read(lighting, input);
+    hdr = graph.attach(lighting, hdr);
+    Resource litHdr = hdr;
+    Pass transparent = graph.addPass("transparent", nullptr);
+    graph.read(transparent, depth);
+    hdr = graph.attach(transparent, hdr);
+    // declared after transparent but reads the opaque lighting, has to run before transparent overwrites it
+    Pass exposure = graph.addPass("exposure", nullptr);
+    graph.read(exposure, litHdr);
+    graph.setSideEffect(exposure);
+    Pass debugView = graph.addPass("normal debug view", nullptr);
+    graph.read(debugView, normal);
+    graph.attach(debugView, debug);
+
+    // bloom: threshold and a chain of 4 downsamples, then back up
+    Resource bloom[5];
+    Pass bright = graph.addPass("bloom threshold", nullptr);
+    graph.read(bright, hdr);
+    bloom[0] = graph.attach(bright, graph.createTexture("bloom 0", {width / 2, height / 2, GL_RGBA16F}));
+    std::vector<Pass> chain = {bright};
+    for (int level = 1; level < 5; ++level) {
+        Pass down = graph.addPass("bloom down", nullptr);
+        graph.read(down, bloom[level - 1]);
+        bloom[level] = graph.attach(down, graph.createTexture("bloom", {width >> (level + 1), height >> (level + 1),
+                                                                         GL_RGBA16F}));
+        chain.push_back(down);
+    }
+    for (int level = 3; level >= 0; --level) {
+        Pass up = graph.addPass("bloom up", nullptr);
+        graph.read(up, bloom[level + 1]);
+        bloom[level] = graph.attach(up, bloom[level]);
+        chain.push_back(up);
+    }
+    Pass tonemap = graph.addPass("tonemap", nullptr);
+    graph.read(tonemap, hdr);
+    graph.read(tonemap, bloom[0]);
+    ldr = graph.attach(tonemap, ldr);
+    Pass keepHistory = graph.addPass("history copy", nullptr);
+    graph.read(keepHistory, hdr);
+    graph.output(graph.write(keepHistory, history));
+    Pass present = graph.addPass("present", nullptr);
+    graph.read(present, ldr);
+    graph.attach(present, backbuffer);
+
+    dependencies = {{shadows, lighting}, {prepass, geometry}, {geometry, ssao}, {ssao, blur}, {blur, lighting},
+                    {lighting, exposure}, {exposure, transparent}, {lighting, transparent}, {transparent, bright},
+                    {transparent, tonemap}, {transparent, keepHistory}, {tonemap, present}, {chain.back(), tonemap}};
+    for (size_t i = 1; i < chain.size(); ++i) dependencies.emplace_back(chain[i - 1], chain[i]);
+    culledPass = debugView;
+}
+
+static int graph(int argc, char **argv) {
+    unsigned int iterations = argc > 2 ? std::max(atoi(argv[2]), 1) : 1000;
+    bool failed = false;
+
+    RenderGraph frame;
+    std::vector<std::pair<RenderGraph::Pass, RenderGraph::Pass>> dependencies;
+    RenderGraph::Pass culledPass;
+    buildFrame(frame, dependencies, culledPass);
+    if (!frame.compile()) {
+        printf("graph test failed\n");
+        return 1;
+    }
+    frame.print();
+
+    std::vector<uint32_t> position(frame.passCount(), RenderGraph::INVALID);
+    for (uint32_t i = 0; i < frame.order().size(); ++i) position[frame.order()[i]] = i;
+    for (const auto &[before, after] : dependencies) {
+        if (position[before] == RenderGraph::INVALID || position[after] == RenderGraph::INVALID ||
+            position[before] >= position[after]) {
+            printf("  %s has to run before %s\n", frame.passName(before), frame.passName(after));
+            failed = true;
+        }
+    }
+    if (!frame.culled(culledPass)) {
+        printf("  %s was not culled\n", frame.passName(culledPass));
+        failed = true;
+    }
+
+    // textures sharing a physical texture must not be alive at the same time
+    for (RenderGraph::Resource a = 0; a < frame.handleCount(); ++a) {
+        for (RenderGraph::Resource b = a + 1; b < frame.handleCount(); ++b) {
+            uint32_t slot = frame.physicalTexture(a);
+            if (slot == RenderGraph::INVALID || slot != frame.physicalTexture(b)) continue;
+            if (frame.resourceIndex(a) != frame.resourceIndex(b) && frame.firstUse(a) <= frame.lastUse(b) &&
+                frame.firstUse(b) <= frame.lastUse(a)) {
+                printf("  overlapping textures share physical texture %u\n", slot);
+                failed = true;
+            }
+        }
+    }
+    if (frame.allocatedBytes() >= frame.transientBytes()) {
+        printf("  no transient memory is shared\n");
+        failed = true;
+    }
+
+    // a cycle and two writes of the same contents are reported
+    RenderGraph cyclic;
+    RenderGraph::Resource x = cyclic.createTexture("x", {}), y = cyclic.createTexture("y", {});
+    RenderGraph::Pass first = cyclic.addPass("a", nullptr), second = cyclic.addPass("b", nullptr);
+    x = cyclic.attach(second, x);
+    cyclic.read(first, x);
+    y = cyclic.attach(first, y);
+    cyclic.read(second, y);
+    cyclic.setSideEffect(first);
+    bool cycleFound = !cyclic.compile();
+    RenderGraph doubled;
+    RenderGraph::Resource z = doubled.createTexture("z", {});
+    doubled.attach(doubled.addPass("a", nullptr), z);
+    doubled.attach(doubled.addPass("b", nullptr), z);
+    bool doubleWriteFound = !doubled.compile();
+    if (!cycleFound || !doubleWriteFound) {
+        printf("  invalid graphs compiled\n");
+        failed = true;
+    }
+
+    // compile cost of the frame and of a large random graph
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < iterations; ++i) frame.compile();
+    double frameSeconds = secondsSince(start) / iterations;
+
+    RenderGraph large;
+    std::mt19937 random(5);
+    std::vector<RenderGraph::Resource> latest;
+    for (int r = 0; r < 256; ++r) latest.push_back(large.createTexture("target", {256, 256, GLenum(r % 2 ? GL_RGBA8 : GL_R8)}));
+    for (int p = 0; p < 2000; ++p) {
+        RenderGraph::Pass pass = large.addPass("pass", nullptr);
+        for (int i = 0; i < 3; ++i) large.read(pass, latest[random() % latest.size()]);
+        size_t target = random() % latest.size();
+        latest[target] = large.attach(pass, latest[target]);
+    }
+    for (int r = 0; r < 16; ++r) large.output(latest[r]);
+    start = std::chrono::steady_clock::now();
+    bool largeCompiled = large.compile();
+    double largeSeconds = secondsSince(start);
+
+    printf("compile: frame of %zu passes %.2f us, %u random passes %.2f ms (%zu alive, %zu physical textures)\n",
+           frame.order().size(), frameSeconds * 1e6, 2000u, largeSeconds * 1e3, large.order().size(),
+           large.physicalTextureCount());
+    failed = failed || !largeCompiled;
+    printf("%s\n", failed ? "graph test failed" : "graph test passed");
+    return failed ? 1 : 0;
+}
+
+static int resolution(int argc, char **argv) {
+    unsigned int frames = argc > 2 ? unsigned(std::max(atoi(argv[2]), 0)) : 3000;
+    if (frames < RESOLUTION_MINIMUM_FRAMES) {
+        printf("The resolution run needs at least %u frames\n", RESOLUTION_MINIMUM_FRAMES);
+        return 1;
+    }
+    const float target = 14.0f;
+    const unsigned int latency = 2;   // GpuTimer results of 3 frames in flight are 2 frames old
+
+    // simulated GPU: 1 ms independent of the resolution plus 11 ms of pixels at native resolution under normal load,
+    // the middle half of the run is 1.8 times heavier, with a few single frame spikes and 5% noise
+    std::mt19937 random(17);
+    std::uniform_real_distribution<double> noise(0.95, 1.05);
+    auto load = [&](unsigned int frame) {
+        double heavy = frame >= frames / 4 && frame < frames * 3 / 4 ? 1.8 : 1.0;
+        bool spike = frame % 500 == 250;
+        return heavy * (spike ? 2.5 : 1.0) * noise(random);
+    };
+    auto gpuTime = [](float scale, double load) { return 1.0 + 11.0 * double(scale * scale) * load; };
+
+    DynamicResolution controller(target, 0.5f, 1.0f, latency);
+    std::vector<double> measured;
+    size_t overDynamic = 0, overNative = 0, changes = 0, steadyChanges = 0;
+    double heavyScale = 0.0, lightScale = 0.0;
+    size_t heavyFrames = 0, lightFrames = 0;
+    float lastScale = controller.scale();
+    for (unsigned int frame = 0; frame < frames; ++frame) {
+        double frameLoad = load(frame);
+        double time = gpuTime(controller.scale(), frameLoad);
+        overDynamic += time > target;
+        overNative += gpuTime(1.0f, frameLoad) > target;
+        measured.push_back(time);
+        if (measured.size() > latency) controller.update(measured[measured.size() - 1 - latency]);
+
+        bool changed = controller.scale() != lastScale;
+        lastScale = controller.scale();
+        changes += changed;
+        // the second half of every quarter is settled, apart from the recovery after a spike
+        bool afterSpike = frame % 500 >= 250 && frame % 500 < 350;
+        if (frame % (frames / 4) < frames / 8 || afterSpike) continue;
+        steadyChanges += changed;
+        if (frame >= frames / 4 && frame < frames * 3 / 4) {
+            heavyScale += controller.scale();
+            ++heavyFrames;
+        } else {
+            lightScale += controller.scale();
+            ++lightFrames;
+        }
+    }
+    heavyScale /= double(std::max<size_t>(heavyFrames, 1));
+    lightScale /= double(std::max<size_t>(lightFrames, 1));
+
+    printf("%u frames, target %.1f ms: over the target in %zu frames (native resolution %zu)\n", frames,
+           double(target), overDynamic, overNative);
+    printf("  %zu scale changes, %zu of them in settled phases\n", changes, steadyChanges);
+    printf("  settled scale: heavy load %.3f, normal load %.3f\n", heavyScale, lightScale);
+    // settled phases must not oscillate: at most one change per 500 frames
+    bool failed = overDynamic * 20 > frames || overDynamic * 4 > overNative ||
+                  steadyChanges * 500 > heavyFrames + lightFrames || lightScale < 0.99 || heavyScale > 0.9;
+    printf("%s\n", failed ? "resolution test failed" : "resolution test passed");
+    return failed ? 1 : 0;
+}
+
+/** Humanoid of 64 joints: spine, head with face joints, arms with five fingers of three joints, legs */
+static Skeleton buildSkeleton() {
+    Skeleton skeleton;
+    auto joint = [&](int parent, float x, float y, float z) {
+        JointTransform rest;
+        rest.translation[0] = x;
+        rest.translation[1] = y;
+        rest.translation[2] = z;
+        return skeleton.addJoint(parent, rest);
+    };
+    int pelvis = joint(-1, 0.0f, 1.0f, 0.0f);
+    int spine = pelvis;
+    for (int i = 0; i < 4; ++i) spine = joint(spine, 0.0f, 0.12f, 0.0f);
+    int neck = joint(spine, 0.0f, 0.1f, 0.0f);
+    int head = joint(neck, 0.0f, 0.1f, 0.0f);
+    for (int i = 0; i < 11; ++i) joint(head, 0.03f * float(i % 4) - 0.045f, 0.05f + 0.02f * float(i / 4), 0.08f);
+    for (float side : {-1.0f, 1.0f}) {
+        int arm = joint(spine, side * 0.08f, 0.05f, 0.0f);
+        arm = joint(arm, side * 0.12f, 0.0f, 0.0f);
+        arm = joint(arm, side * 0.28f, 0.0f, 0.0f);
+        int hand = joint(arm, side * 0.25f, 0.0f, 0.0f);
+        for (int finger = 0; finger < 5; ++finger) {
+            int bone = joint(hand, side * 0.06f, 0.0f, 0.02f * float(finger) - 0.04f);
+            for (int i = 0; i < 2; ++i) bone = joint(bone, side * 0.03f, 0.0f, 0.0f);
+        }
+        int leg = joint(pelvis, side * 0.1f, -0.05f, 0.0f);
+        leg = joint(leg, 0.0f, -0.45f, 0.0f);
+        leg = joint(leg, 0.0f, -0.42f, 0.0f);
+        joint(leg, 0.0f, -0.05f, 0.12f);
+    }
+    return skeleton;
+}
+
+/** Cyclic clip: the limbs swing at the base frequency and its harmonics, the face and fingers hold still */
+static AnimationClip buildClip(const Skeleton &skeleton, float seconds, float amplitude, unsigned int seed) {
+    AnimationClip clip;
+    clip.sampleRate = 30.0f;
+    clip.frameCount = unsigned(seconds * clip.sampleRate) + 1;
+    clip.jointCount = unsigned(skeleton.jointCount());
+    clip.frames.resize(size_t(clip.frameCount) * clip.jointCount);
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    for (unsigned int joint = 0; joint < clip.jointCount; ++joint) {
+        float axis[3] = {unit(random), unit(random), unit(random)};
+        float length = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+        float phase = unit(random) * 3.1415927f, harmonic = float(1 + joint % 3);
+        bool still = joint >= 7 && joint < 18;  // face joints
+        for (unsigned int frame = 0; frame < clip.frameCount; ++frame) {
+            JointTransform &transform = clip.frames[size_t(frame) * clip.jointCount + joint];
+            transform = skeleton.restPose[joint];
+            float t = float(frame) / float(clip.frameCount - 1) * 6.2831853f;
+            float angle = still ? 0.0f : amplitude * (std::sin(t + phase) + 0.3f * std::sin(harmonic * t));
+            float s = std::sin(angle * 0.5f) / length;
+            transform.rotation[0] = axis[0] * s;
+            transform.rotation[1] = axis[1] * s;
+            transform.rotation[2] = axis[2] * s;
+            transform.rotation[3] = std::cos(angle * 0.5f);
+            if (joint == 0) transform.translation[1] += 0.05f * std::sin(2.0f * t);
+        }
+    }
+    return clip;
+}
+
+/** out = a * b of 3x4 row matrices */
+static void multiplyRows(const float *a, const float *b, float *out) {
+    for (int row = 0; row < 3; ++row) {
+        for (int column = 0; column < 4; ++column) {
+            out[row * 4 + column] = a[row * 4] * b[column] + a[row * 4 + 1] * b[4 + column] +
+                                    a[row * 4 + 2] * b[8 + column] + (column == 3 ? a[row * 4 + 3] : 0.0f);
+        }
+    }
+}
+
+/** Scalar reference of Animation::evaluate: CompressedClip::sample, nlerp blending, modelMatrices */
+static void referencePalette(const Skeleton &skeleton, const AnimationInstance &instance, float *palette) {
+    size_t joints = skeleton.jointCount();
+    std::vector<JointTransform> pose(joints), blended(joints);
+    std::vector<float> model(joints * 12);
+    instance.clip->sample(instance.time, instance.loop, pose.data());
+    if (instance.blendClip) {
+        instance.blendClip->sample(instance.blendTime, instance.loop, blended.data());
+        float w = instance.blendWeight;
+        for (size_t j = 0; j < joints; ++j) {
+            float *a = pose[j].rotation;
+            const float *b = blended[j].rotation;
+            float dot = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3], sign = dot < 0.0f ? -1.0f : 1.0f;
+            float length = 0.0f;
+            for (int c = 0; c < 4; ++c) {
+                a[c] += (b[c] * sign - a[c]) * w;
+                length += a[c] * a[c];
+            }
+            for (int c = 0; c < 4; ++c) a[c] /= std::sqrt(length);
+            for (int c = 0; c < 3; ++c) {
+                pose[j].translation[c] += (blended[j].translation[c] - pose[j].translation[c]) * w;
+                pose[j].scale[c] += (blended[j].scale[c] - pose[j].scale[c]) * w;
+            }
+        }
+    }
+    Animation::modelMatrices(skeleton, pose.data(), model.data());
+    for (size_t j = 0; j < joints; ++j) multiplyRows(&model[j * 12], &skeleton.inverseBind[j * 12], palette + j * 12);
+}
+
+static int animation(int argc, char **argv) {
+    size_t characters = argc > 2 ? size_t(std::max(atoi(argv[2]), 1)) : 1000;
+    unsigned int frames = argc > 3 ? std::max(atoi(argv[3]), 1) : 100;
+    Skeleton skeleton = buildSkeleton();
+    const size_t joints = skeleton.jointCount();
+    AnimationClip walk = buildClip(skeleton, 1.2f, 0.6f, 3), run = buildClip(skeleton, 0.8f, 1.0f, 5);
+
+    // compression: size, kept keys and the error in model space, where it is seen
+    bool failed = false;
+    CompressedClip clips[2];
+    const AnimationClip *sources[2] = {&walk, &run};
+    const char *names[2] = {"walk", "run"};
+    for (int i = 0; i < 2; ++i) {
+        const AnimationClip &clip = *sources[i];
+        auto start = std::chrono::steady_clock::now();
+        if (!clips[i].compress(clip)) {printf("%s could not be compressed\n", names[i]); return 1;}
+        double seconds = secondsSince(start);
+        std::vector<JointTransform> decoded(joints);
+        std::vector<float> expected(joints * 12), actual(joints * 12);
+        float worst = 0.0f;
+        for (unsigned int frame = 0; frame < clip.frameCount; ++frame) {
+            clips[i].sample(float(frame) / clip.sampleRate, false, decoded.data());
+            Animation::modelMatrices(skeleton, &clip.frames[size_t(frame) * joints], expected.data());
+            Animation::modelMatrices(skeleton, decoded.data(), actual.data());
+            for (size_t j = 0; j < joints; ++j) {
+                float dx = expected[j * 12 + 3] - actual[j * 12 + 3], dy = expected[j * 12 + 7] - actual[j * 12 + 7];
+                float dz = expected[j * 12 + 11] - actual[j * 12 + 11];
+                worst = std::max(worst, std::sqrt(dx * dx + dy * dy + dz * dz));
+            }
+        }
+        size_t rawBytes = clip.frames.size() * sizeof(JointTransform);
+        size_t rawKeys = size_t(clip.frameCount) * joints * 3;
+        printf("%s: %u frames of %zu joints, %zu -> %zu bytes (%.1fx), %.1f%% of the keys kept, compressed in %.2f ms\n",
+               names[i], clip.frameCount, joints, rawBytes, clips[i].bytes(), double(rawBytes) / double(clips[i].bytes()),
+               100.0 * double(clips[i].keyCount()) / double(rawKeys), seconds * 1e3);
+        printf("  largest joint position error in model space: %.3f mm\n", double(worst) * 1e3);
+        failed = failed || worst > 0.005f || clips[i].bytes() * 3 > rawBytes;
+    }
+
+    // every character plays walk blended into run at its own time and weight
+    std::vector<float> palettes(characters * joints * 12);
+    std::vector<AnimationInstance> instances(characters);
+    std::mt19937 random(11);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (size_t i = 0; i < characters; ++i) {
+        instances[i].clip = &clips[0];
+        instances[i].time = unit(random) * clips[0].duration();
+        instances[i].blendClip = &clips[1];
+        instances[i].blendTime = unit(random) * clips[1].duration();
+        instances[i].blendWeight = unit(random);
+        instances[i].palette = &palettes[i * joints * 12];
+    }
+
+    Animation::evaluate(skeleton, instances.data(), instances.size());
+    std::vector<float> reference(joints * 12);
+    float difference = 0.0f;
+    for (size_t i = 0; i < std::min<size_t>(characters, 64); ++i) {
+        referencePalette(skeleton, instances[i], reference.data());
+        for (size_t k = 0; k < joints * 12; ++k)
+            difference = std::max(difference, std::fabs(reference[k] - instances[i].palette[k]));
+    }
+    printf("SIMD palettes against the scalar reference: largest difference %.2e\n", double(difference));
+    failed = failed || difference > 1e-4f;
+
+    auto advance = [&]() {
+        for (AnimationInstance &instance : instances) {
+            instance.time += 1.0f / 60.0f;
+            instance.blendTime += 1.0f / 60.0f;
+        }
+    };
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int frame = 0; frame < frames; ++frame) {
+        advance();
+        for (const AnimationInstance &instance : instances) Animation::evaluate(skeleton, instance);
+    }
+    double single = secondsSince(start) / frames;
+    uint64_t allocations = Memory::heapAllocations();
+    start = std::chrono::steady_clock::now();
+    for (unsigned int frame = 0; frame < frames; ++frame) {
+        advance();
+        Animation::evaluate(skeleton, instances.data(), instances.size());
+    }
+    double parallel = secondsSince(start) / frames;
+    allocations = Memory::heapAllocations() - allocations;
+    printf("%zu characters of %zu joints, 2 clips blended:\n", characters, joints);
+    printf("  1 thread:  %.3f ms per frame, %.0f poses/s, %.1f M joints/s\n", single * 1e3,
+           double(characters) / single, double(characters * joints) / single * 1e-6);
+    printf("  %u threads: %.3f ms per frame, %.0f poses/s, %.1f M joints/s, %llu heap allocations\n",
+           JobSystem::threadCount(), parallel * 1e3, double(characters) / parallel,
+           double(characters * joints) / parallel * 1e-6, static_cast<unsigned long long>(allocations));
+    failed = failed || allocations > 0;
+    printf("%s\n", failed ? "animation test failed" : "animation test passed");
+    return failed ? 1 : 0;
+}
+
+/** Column major perspective projection (OpenGL clip space) */
+static void perspective(float fovY, float aspect, float zNear, float zFar, float projection[16]) {
+    float f = 1.0f / std::tan(fovY * 0.5f);
+    const float result[16] = {f / aspect, 0, 0, 0, 0, f, 0, 0, 0, 0, (zFar + zNear) / (zNear - zFar), -1,
+                              0, 0, 2.0f * zFar * zNear / (zNear - zFar), 0};
+    memcpy(projection, result, sizeof(result));
+}
+
+/** Column major a * b */
+static void multiply(const float *a, const float *b, float *out) {
+    for (int column = 0; column < 4; ++column) {
+        for (int row = 0; row < 4; ++row) {
+            float sum = 0.0f;
+            for (int k = 0; k < 4; ++k) sum += a[k * 4 + row] * b[column * 4 + k];
+            out[column * 4 + row] = sum;
+        }
+    }
+}
+
+/** Checks a selection for cracks: every edge vertex a chunk draws is drawn with the same height by the chunk across
+ *  the edge, neighbours differ by at most one level
+ *
+ *  @param[in,out] owners Scratch grid of level 0 chunk cells
+ *  @returns Number of edge vertices without a matching vertex
+ */
+static size_t verifyStitching(const Terrain &terrain, std::vector<int> &owners, size_t &levelJumps) {
+    const std::vector<TerrainChunk> &chunks = terrain.chunks();
+    const int cells = int(terrain.size() / Terrain::CHUNK_QUADS), quads = int(Terrain::CHUNK_QUADS);
+    std::fill(owners.begin(), owners.end(), -1);
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        int span = 1 << chunks[i].level;
+        for (int y = chunks[i].y * span; y < (chunks[i].y + 1) * span; ++y)
+            for (int x = chunks[i].x * span; x < (chunks[i].x + 1) * span; ++x) owners[size_t(y) * cells + x] = int(i);
+    }
+    // 1 -x, 2 +x, 4 -z, 8 +z: the grid line of the edge and the direction of the neighbour
+    const int edgeX[4] = {0, quads, -1, -1}, edgeY[4] = {-1, -1, 0, quads}, stepX[4] = {-1, 1, 0, 0},
+            stepY[4] = {0, 0, -1, 1};
+    size_t mismatches = 0;
+    levelJumps = 0;
+    for (const TerrainChunk &chunk : chunks) {
+        int shift = chunk.level;
+        for (int edge = 0; edge < 4; ++edge) {
+            int step = chunk.stitch & (1 << edge) ? 2 : 1;
+            for (int along = 0; along <= quads; along += step) {
+                int gridX = edgeX[edge] < 0 ? along : edgeX[edge], gridY = edgeY[edge] < 0 ? along : edgeY[edge];
+                // the vertex in level 0 samples and the cell across the edge
+                int sampleX = (chunk.x * quads + gridX) << shift, sampleY = (chunk.y * quads + gridY) << shift;
+                int cellX = (sampleX >> 5) + std::min(stepX[edge], 0);
+                int cellY = (sampleY >> 5) + std::min(stepY[edge], 0);
+                if (stepX[edge] == 0) cellX = std::min(cellX, cells - 1);
+                if (stepY[edge] == 0) cellY = std::min(cellY, cells - 1);
+                if (cellX < 0 || cellY < 0 || cellX >= cells || cellY >= cells) continue;
+                int owner = owners[size_t(cellY) * cells + cellX];
+                if (owner < 0) continue; // culled
+                const TerrainChunk &other = chunks[size_t(owner)];
+                // corners can touch a diagonal neighbour, only edge neighbours are restricted to one level
+                bool corner = along == 0 || along == quads;
+                levelJumps += !corner && std::abs(int(other.level) - int(chunk.level)) > 1;
+                // the vertex has to be on the other chunk's grid and not skipped by its stitching
+                int otherX = sampleX - ((other.x * quads) << other.level);
+                int otherY = sampleY - ((other.y * quads) << other.level);
+                int mask = (1 << other.level) - 1;
+                bool drawn = (otherX & mask) == 0 && (otherY & mask) == 0;
+                otherX >>= other.level;
+                otherY >>= other.level;
+                int otherEdge = otherX == 0 ? 1 : otherX == quads ? 2 : otherY == 0 ? 4 : otherY == quads ? 8 : 0;
+                if (drawn && (other.stitch & otherEdge)) drawn = ((otherEdge <= 2 ? otherY : otherX) & 1) == 0;
+                if (!drawn || terrain.vertexHeight(other, unsigned(otherX), unsigned(otherY)) !=
+                              terrain.vertexHeight(chunk, unsigned(gridX), unsigned(gridY))) ++mismatches;
+            }
+        }
+    }
+    return mismatches;
+}
+
+static int terrain(int argc, char **argv) {
+    unsigned int size = argc > 2 ? unsigned(std::max(atoi(argv[2]), 256)) : 16384;
+    unsigned int frames = argc > 3 ? std::max(atoi(argv[3]), 1) : 600;
+    const char *path = "EngineBench.terrain";
+
+    // a fractal heightfield, 1 unit between samples and 1500 units between the lowest and the highest one
+    auto start = std::chrono::steady_clock::now();
+    std::vector<uint16_t> heights(size_t(size + 1) * (size + 1));
+    Terrain::fractalHeights(heights.data(), size + 1, 3);
+    double generated = secondsSince(start);
+    TerrainLayout layout;
+    layout.heightScale = 1500.0f;
+    start = std::chrono::steady_clock::now();
+    if (!Terrain::build(path, heights.data(), size + 1, size + 1, layout)) return 1;
+    double built = secondsSince(start);
+    heights = std::vector<uint16_t>();
+
+    Terrain terrain;
+    if (!terrain.open(path)) return 1;
+    FILE *file = fopen(path, "rb");
+    fseek(file, 0, SEEK_END);
+    long bytes = ftell(file);
+    fclose(file);
+    printf("%ux%u heightfield: generated in %.2f s, built in %.2f s, %u levels, %.1f MB\n", size, size, generated,
+           built, terrain.levelCount(), double(bytes) / 1048576.0);
+
+    // flight across the diagonal 60 units above the ground, looking ahead and down, with a level of detail that wants
+    // more triangles than the budget near the ground
+    const unsigned int budget = 1 << 19;
+    terrain.setTriangleBudget(budget);
+    terrain.setLodDistance(8.0f);
+    float projection[16], view[16], viewProjection[16];
+    perspective(1.0472f, 16.0f / 9.0f, 0.5f, 20000.0f, projection);
+    const float extent = float(size) * layout.spacing;
+    std::vector<int> owners(size_t(size / Terrain::CHUNK_QUADS) * (size / Terrain::CHUNK_QUADS));
+    double total = 0.0, worst = 0.0;
+    size_t chunks = 0, triangles = 0, mismatches = 0, jumps = 0, verified = 0;
+    unsigned int largest = 0, waiting = 0;
+    uint64_t allocations = 0;
+    for (unsigned int frame = 0; frame < frames; ++frame) {
+        float t = 0.05f + 0.9f * float(frame) / float(frames);
+        float eye[3] = {t * extent, 0.0f, t * extent * 0.8f + 0.1f * extent};
+        eye[1] = terrain.heightAt(eye[0], eye[2]) + 60.0f;
+        const float target[3] = {eye[0] + 100.0f, eye[1] - 30.0f, eye[2] + 80.0f};
+        lookAt(eye, target, view);
+        multiply(projection, view, viewProjection);
+
+        uint64_t before = Memory::heapAllocations();
+        auto updateStart = std::chrono::steady_clock::now();
+        terrain.update(viewProjection, eye);
+        double seconds = secondsSince(updateStart);
+        if (frame >= frames / 2) allocations += Memory::heapAllocations() - before;
+        total += seconds;
+        worst = std::max(worst, seconds);
+        const TerrainStats &stats = terrain.stats();
+        chunks += stats.chunks;
+        triangles += stats.triangles;
+        largest = std::max(largest, stats.triangles);
+        waiting += stats.waitingNodes;
+        if (frame % 10 == 0) {
+            size_t levelJumps = 0;
+            mismatches += verifyStitching(terrain, owners, levelJumps);
+            jumps += levelJumps;
+            ++verified;
+        }
+    }
+    const TerrainStats &last = terrain.stats();
+    printf("%u frames, budget %u triangles:\n", frames, budget);
+    printf("  selection %.3f ms per frame (worst %.3f ms), %.0f chunks, %.0f triangles, largest %u triangles\n",
+           total / frames * 1e3, worst * 1e3, double(chunks) / frames, double(triangles) / frames, largest);
+    printf("  %u nodes waited for tiles, %u tiles resident at the end, %u culled nodes in the last frame\n", waiting,
+           last.residentTiles, last.culledNodes);
+    printf("  %zu frames checked: %zu edge vertices without a match, %zu level jumps over one\n", verified,
+           mismatches, jumps);
+    printf("  %llu heap allocations in the second half\n", static_cast<unsigned long long>(allocations));
+    terrain.destroy();
+    std::remove(path);
+
+    bool failed = mismatches > 0 || jumps > 0 || largest > budget || allocations > 0;
+    printf("%s\n", failed ? "terrain test failed" : "terrain test passed");
+    return failed ? 1 : 0;
+}
+
+/** Material of a voxel of the benchmark volume: strata below a rolling surface, hollowed out by caves */
+static uint16_t volumeMaterial(int x, int y, int z, int height) {
+    float fx = float(x), fy = float(y), fz = float(z);
+    float surface = float(height) * 0.55f + 18.0f * std::sin(fx * 0.021f) * std::cos(fz * 0.017f) +
+                    7.0f * std::sin((fx + fz) * 0.063f);
+    if (fy > surface) return 0;
+    float cave = std::sin(fx * 0.09f) * std::sin(fy * 0.11f + fz * 0.03f) * std::sin(fz * 0.08f + fx * 0.02f);
+    if (cave > 0.35f) return 0;
+    float depth = surface - fy;
+    return depth < 1.0f ? 1 : depth < 4.0f ? 2 : uint16_t(3 + int(fy / 24.0f) % 4);
+}
+
+/** Checks a chunk mesh against the voxels: every quad covers exposed faces of its material exactly once, wound
+ *  counter clockwise around the face normal, and every exposed face is covered
+ *
+ *  @param[out] faces Exposed voxel faces of the chunk
+ *  @returns Number of errors
+ */
+static size_t verifyVoxelMesh(const VoxelWorld &world, unsigned int chunkX, unsigned int chunkY, unsigned int chunkZ,
+                              const VoxelVertex *vertices, unsigned int quads, std::vector<uint8_t> &covered,
+                              size_t &faces) {
+    constexpr int N = int(VoxelWorld::CHUNK_SIZE);
+    const int base[3] = {int(chunkX) * N, int(chunkY) * N, int(chunkZ) * N};
+    std::fill(covered.begin(), covered.end(), 0);
+    size_t errors = 0;
+    for (unsigned int quad = 0; quad < quads; ++quad) {
+        const VoxelVertex *corners = vertices + size_t(quad) * 4;
+        const int face = corners[0].face, axis = face / 2, u = (axis + 1) % 3, v = (axis + 2) % 3;
+        const int direction = face % 2 ? 1 : -1;
+        int edgeA[3], edgeB[3];
+        for (int k = 0; k < 3; ++k) {
+            edgeA[k] = int(corners[1].position[k]) - int(corners[0].position[k]);
+            edgeB[k] = int(corners[2].position[k]) - int(corners[0].position[k]);
+        }
+        int normal = edgeA[u] * edgeB[v] - edgeA[v] * edgeB[u];
+        if (normal * direction <= 0) ++errors;
+        for (int corner = 1; corner < 4; ++corner) {
+            errors += corners[corner].face != face || corners[corner].material != corners[0].material ||
+                      corners[corner].position[axis] != corners[0].position[axis];
+        }
+        int inside = int(corners[0].position[axis]) - (direction > 0 ? 1 : 0);
+        int minU = std::min(corners[0].position[u], corners[2].position[u]);
+        int maxU = std::max(corners[0].position[u], corners[2].position[u]);
+        int minV = std::min(corners[0].position[v], corners[2].position[v]);
+        int maxV = std::max(corners[0].position[v], corners[2].position[v]);
+        for (int b = minV; b < maxV; ++b) {
+            for (int a = minU; a < maxU; ++a) {
+                int local[3];
+                local[axis] = inside;
+                local[u] = a;
+                local[v] = b;
+                int p[3] = {base[0] + local[0], base[1] + local[1], base[2] + local[2]};
+                int q[3] = {p[0], p[1], p[2]};
+                q[axis] += direction;
+                size_t cell = size_t(face) * VoxelWorld::CHUNK_VOXELS;
+                cell += size_t((local[2] * N + local[1]) * N + local[0]);
+                errors += world.get(p[0], p[1], p[2]) != corners[0].material || world.get(q[0], q[1], q[2]) != 0 ||
+                          covered[cell]++ != 0;
+            }
+        }
+    }
+    for (int z = 0; z < N; ++z) {
+        for (int y = 0; y < N; ++y) {
+            for (int x = 0; x < N; ++x) {
+                int p[3] = {base[0] + x, base[1] + y, base[2] + z};
+                if (!world.get(p[0], p[1], p[2])) continue;
+                for (int face = 0; face < 6; ++face) {
+                    int q[3] = {p[0], p[1], p[2]};
+                    q[face / 2] += face % 2 ? 1 : -1;
+                    if (world.get(q[0], q[1], q[2])) continue;
+                    ++faces;
+                    errors += !covered[size_t(face) * VoxelWorld::CHUNK_VOXELS + size_t((z * N + y) * N + x)];
+                }
+            }
+        }
+    }
+    return errors;
+}
+
+static void printVoxelMemory(const char *label, const VoxelMemory &memory) {
+    printf("%s: %.1f MB, %.0f bytes per chunk (%zu bytes dense), chunks by index bits 0/1/2/4/8/16: "
+           "%zu/%zu/%zu/%zu/%zu/%zu\n", label, double(memory.bytes) / 1048576.0,
+           double(memory.bytes) / double(memory.chunks), size_t(VoxelWorld::CHUNK_VOXELS) * sizeof(uint16_t),
+           memory.chunksByBits[0], memory.chunksByBits[1], memory.chunksByBits[2], memory.chunksByBits[3],
+           memory.chunksByBits[4], memory.chunksByBits[5]);
+}
+
+static int voxels(int argc, char **argv) {
+    unsigned int side = argc > 2 ? unsigned(std::clamp(atoi(argv[2]), 1, 64)) : 16;
+    unsigned int edits = argc > 3 ? unsigned(std::max(atoi(argv[3]), 1)) : 200;
+    constexpr unsigned int N = VoxelWorld::CHUNK_SIZE;
+    VoxelWorld world;
+    if (!world.create(side, std::max(side / 2, 1u), side)) return 1;
+    const unsigned int countX = world.chunksX(), countY = world.chunksY(), countZ = world.chunksZ();
+    const unsigned int count = countX * countY * countZ;
+    const int height = int(countY * N);
+
+    // the volume is generated in batches of chunks on all threads and packed into the world on this one
+    auto start = std::chrono::steady_clock::now();
+    constexpr unsigned int BATCH = 64;
+    std::vector<uint16_t> batch(size_t(BATCH) * VoxelWorld::CHUNK_VOXELS);
+    for (unsigned int first = 0; first < count; first += BATCH) {
+        unsigned int batchSize = std::min(BATCH, count - first);
+        JobSystem::parallelFor(batchSize, 1, [&](unsigned int begin, unsigned int end) {
+            for (unsigned int i = begin; i < end; ++i) {
+                unsigned int chunk = first + i;
+                int x0 = int(chunk % countX * N), y0 = int(chunk / countX % countY * N);
+                int z0 = int(chunk / countX / countY * N);
+                uint16_t *voxels = batch.data() + size_t(i) * VoxelWorld::CHUNK_VOXELS;
+                for (int z = 0; z < int(N); ++z)
+                    for (int y = 0; y < int(N); ++y)
+                        for (int x = 0; x < int(N); ++x)
+                            *voxels++ = volumeMaterial(x0 + x, y0 + y, z0 + z, height);
+            }
+        });
+        for (unsigned int i = 0; i < batchSize; ++i) {
+            unsigned int chunk = first + i;
+            world.setChunk(chunk % countX, chunk / countX % countY, chunk / countX / countY,
+                           batch.data() + size_t(i) * VoxelWorld::CHUNK_VOXELS);
+        }
+    }
+    batch = std::vector<uint16_t>();
+    printf("%ux%ux%u chunks of %u^3 voxels (%.1f M voxels) generated and packed in %.2f s\n", countX, countY, countZ,
+           N, double(count) * VoxelWorld::CHUNK_VOXELS / 1e6, secondsSince(start));
+    printVoxelMemory("storage", world.memory());
+
+    // everything is dirty after loading
+    start = std::chrono::steady_clock::now();
+    world.update();
+    double seconds = secondsSince(start);
+    const VoxelStats &stats = world.stats();
+    printf("meshed %u chunks on %u threads in %.1f ms: %.0f chunks/s, %zu quads (%.0f per chunk, %.1f KB of "
+           "vertices)\n", stats.meshedChunks, JobSystem::threadCount(), seconds * 1e3,
+           double(stats.meshedChunks) / seconds, stats.meshedQuads, double(stats.meshedQuads) / count,
+           double(stats.meshedQuads) * 4 * sizeof(VoxelVertex) / count / 1024.0);
+
+    // carving and filling spheres, only the chunks an edit touches are remeshed
+    std::mt19937 random(5);
+    std::uniform_int_distribution<int> horizontal(0, int(countX * N) - 1), vertical(0, height - 1);
+    constexpr int RADIUS = 5;
+    constexpr unsigned int WARM_UP = 10;
+    double total = 0.0, worst = 0.0;
+    size_t remeshed = 0;
+    uint64_t allocations = 0, editAllocations = 0;
+    for (unsigned int edit = 0; edit < edits; ++edit) {
+        int center[3] = {horizontal(random), vertical(random), int(unsigned(horizontal(random)) % (countZ * N))};
+        uint16_t material = edit % 2 ? 0 : uint16_t(3 + edit % 4);
+        uint64_t before = Memory::heapAllocations();
+        for (int z = -RADIUS; z <= RADIUS; ++z)
+            for (int y = -RADIUS; y <= RADIUS; ++y)
+                for (int x = -RADIUS; x <= RADIUS; ++x)
+                    if (x * x + y * y + z * z <= RADIUS * RADIUS)
+                        world.set(center[0] + x, center[1] + y, center[2] + z, material);
+        uint64_t edited = Memory::heapAllocations();
+        start = std::chrono::steady_clock::now();
+        world.update();
+        seconds = secondsSince(start);
+        if (edit >= WARM_UP) {
+            allocations += Memory::heapAllocations() - edited;
+            editAllocations += edited - before;
+        }
+        total += seconds;
+        worst = std::max(worst, seconds);
+        remeshed += stats.meshedChunks;
+    }
+    printf("%u sphere edits of radius %d: %.1f chunks remeshed per edit, %.3f ms per update (worst %.3f ms), "
+           "%.0f chunks/s\n", edits, RADIUS, double(remeshed) / edits, total / edits * 1e3, worst * 1e3,
+           double(remeshed) / total);
+    printf("  %llu heap allocations in update(), %llu in the edits (palette growth)\n",
+           static_cast<unsigned long long>(allocations), static_cast<unsigned long long>(editAllocations));
+    printVoxelMemory("after the edits", world.memory());
+    world.compact();
+    printVoxelMemory("compacted", world.memory());
+
+    // one thread over the whole world: the remeshed chunks have to match a fresh mesh
+    std::vector<VoxelVertex> vertices(size_t(VoxelWorld::MAX_QUADS) * 4);
+    size_t stale = 0;
+    start = std::chrono::steady_clock::now();
+    for (unsigned int z = 0; z < countZ; ++z)
+        for (unsigned int y = 0; y < countY; ++y)
+            for (unsigned int x = 0; x < countX; ++x)
+                stale += world.meshChunk(x, y, z, vertices.data()) != world.chunkQuads(x, y, z);
+    seconds = secondsSince(start);
+    printf("one thread: %.0f chunks/s, %zu chunks with a stale mesh\n", double(count) / seconds, stale);
+
+    std::vector<uint8_t> covered(size_t(6) * VoxelWorld::CHUNK_VOXELS);
+    size_t faces = 0, quads = 0, errors = 0, checked = 0;
+    for (unsigned int chunk = 0; chunk < count; chunk += 5) {
+        unsigned int x = chunk % countX, y = chunk / countX % countY, z = chunk / countX / countY;
+        unsigned int chunkQuads = world.meshChunk(x, y, z, vertices.data());
+        errors += verifyVoxelMesh(world, x, y, z, vertices.data(), chunkQuads, covered, faces);
+        quads += chunkQuads;
+        ++checked;
+    }
+    printf("%zu chunks checked: %zu exposed faces in %zu quads (%.1fx fewer), %zu errors\n", checked, faces, quads,
+           quads ? double(faces) / double(quads) : 0.0, errors);
+    Memory::printStats();
+
+    bool failed = errors > 0 || stale > 0 || allocations > 0;
+    printf("%s\n", failed ? "voxel test failed" : "voxel test passed");
+    return failed ? 1 : 0;
+}
+
+/** Cube (mesh 0) and ground quad (mesh 1) in shared position, uv, normal buffers, the layout of MeshShader.vert */
+static GLuint buildCullingMeshes(std::vector<CullMesh> &meshes, GLuint buffers[2]) {
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+    auto addVertex = [&](const float p[3], const float n[3]) {
+        vertices.insert(vertices.end(), {p[0], p[1], p[2], 0.5f, 0.5f, n[0], n[1], n[2]});
+    };
+    for (int face = 0; face < 6; ++face) {
+        int axis = face / 2;
+        float side = face % 2 ? 0.5f : -0.5f;
+        auto base = unsigned(vertices.size() / 8);
+        for (int corner = 0; corner < 4; ++corner) {
+            float p[3], n[3] = {0, 0, 0};
+            p[axis] = side;
+            p[(axis + 1) % 3] = corner & 1 ? 0.5f : -0.5f;
+            p[(axis + 2) % 3] = corner & 2 ? 0.5f : -0.5f;
+            n[axis] = side * 2.0f;
+            addVertex(p, n);
+        }
+        indices.insert(indices.end(), {base, base + 1, base + 2, base + 1, base + 3, base + 2});
+    }
+    meshes.push_back({36, 0, 0, 0});
+    meshes.push_back({6, unsigned(indices.size()), int(vertices.size() / 8), 0});
+    const float up[3] = {0, 1, 0};
+    for (int corner = 0; corner < 4; ++corner) {
+        const float p[3] = {corner & 1 ? 1.0f : -1.0f, 0.0f, corner & 2 ? 1.0f : -1.0f};
+        addVertex(p, up);
+    }
+    indices.insert(indices.end(), {0, 2, 1, 1, 2, 3});
+
+    GLuint vertexArray;
+    glGenVertexArrays(1, &vertexArray);
+    glBindVertexArray(vertexArray);
+    glGenBuffers(2, buffers);
+    glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+    glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(vertices.size() * sizeof(float)), vertices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, GLsizeiptr(indices.size() * sizeof(unsigned int)), indices.data(),
+                 GL_STATIC_DRAW);
+    const GLsizei stride = 8 * sizeof(float);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, nullptr);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<const void *>(3 * sizeof(float)));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<const void *>(5 * sizeof(float)));
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return vertexArray;
+}
+
+/** Draws one culled frame into the bound framebuffer
+ *
+ *  @param[out] pixels Color buffer after the draw
+ *  @param[out] triangles Triangles the draw generated
+ *  @returns Milliseconds of the frame, culling included
+ */
+static double drawCulled(GpuCulling &culling, GLuint program, const float viewProjection[16],
+                         std::vector<uint8_t> &pixels, GLsizei width, GLsizei height, GLuint query,
+                         GLuint &triangles) {
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glFinish();
+    auto start = std::chrono::steady_clock::now();
+    glUseProgram(program);
+    glBeginQuery(GL_PRIMITIVES_GENERATED, query);
+    culling.draw(viewProjection, program);
+    glEndQuery(GL_PRIMITIVES_GENERATED);
+    glFinish();
+    double milliseconds = secondsSince(start) * 1e3;
+    glGetQueryObjectuiv(query, GL_QUERY_RESULT, &triangles);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    return milliseconds;
+}
+
+static int culling(int argc, char **argv) {
+    unsigned int side = argc > 2 ? unsigned(std::sqrt(std::max(atoi(argv[2]), 1))) : 100;
+    side = std::max(side, 1u);
+    const GLsizei width = 320, height = 180;
+    const unsigned int views = 8;
+
+    HiddenContext context;
+    if (!context.create()) return 1;
+
+    std::vector<CullMesh> meshes;
+    GLuint buffers[2];
+    GLuint vertexArray = buildCullingMeshes(meshes, buffers);
+
+    // a side x side grid of cubes of varying size two units apart, every seventh object a ground quad
+    std::vector<CullObject> objects;
+    for (unsigned int z = 0; z < side; ++z) {
+        for (unsigned int x = 0; x < side; ++x) {
+            CullObject object{};
+            float scale = 0.5f + 0.1f * float((x * 7 + z * 3) % 5);
+            const float model[16] = {scale, 0, 0, 0, 0, scale, 0, 0, 0, 0, scale, 0,
+                                     float(x) * 2.0f - float(side), 0.5f, float(z) * 2.0f - float(side), 1};
+            memcpy(object.model, model, sizeof(model));
+            object.mesh = (x + z) % 7 == 0;
+            const float extent[3] = {object.mesh ? 1.0f : 0.5f, object.mesh ? 0.0f : 0.5f, object.mesh ? 1.0f : 0.5f};
+            for (int axis = 0; axis < 3; ++axis) {
+                object.boundsMin[axis] = -extent[axis];
+                object.boundsMax[axis] = extent[axis];
+            }
+            objects.push_back(object);
+        }
+    }
+
+    GpuCulling gpu, cpu;
+    if (!gpu.initialize(vertexArray, GL_UNSIGNED_INT, meshes, objects) ||
+        !cpu.initialize(vertexArray, GL_UNSIGNED_INT, meshes, objects, false)) return 1;
+    GLuint meshProgram = LoadShaders("src/shaders/MeshShader.vert", "src/shaders/MeshShader.frag");
+    GLuint objectProgram = gpu.gpuPath() ? LoadShaders("src/shaders/ObjectShader.vert", "src/shaders/MeshShader.frag")
+                                         : meshProgram;
+    if (!meshProgram || !objectProgram) return 1;
+    if (!gpu.gpuPath()) printf("GPU path not available, checking the CPU path only\n");
+
+    GLuint texture, framebuffer, renderbuffers[2], query;
+    const uint8_t color[4] = {255, 200, 100, 255};
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, color);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glGenRenderbuffers(2, renderbuffers);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+    glGenQueries(1, &query);
+    glViewport(0, 0, width, height);
+    glEnable(GL_DEPTH_TEST);
+    glClearColor(0.1f, 0.1f, 0.2f, 1.0f);
+
+    // a wall across the grid in front of every camera, only used as occluder
+    const float wall[12] = {-1, -1, -2, 1, -1, -2, -1, 6, -2, 1, 6, -2};
+    const unsigned int wallIndices[6] = {0, 1, 2, 1, 3, 2};
+    OcclusionCuller occluder(256, 144);
+
+    std::vector<uint8_t> gpuPixels(size_t(width) * height * 4), cpuPixels(gpuPixels.size());
+    size_t mismatches = 0, differingPixels = 0;
+    double gpuTime = 0, cpuTime = 0;
+    unsigned int frames = 0;
+    for (unsigned int view = 0; view < views; ++view) {
+        // cameras circle the grid centre 3 units up and look across it
+        float angle = 6.2831853f * float(view) / float(views);
+        const float eye[3] = {std::cos(angle) * float(side) * 0.3f, 3.0f, std::sin(angle) * float(side) * 0.3f};
+        const float target[3] = {-eye[0], 1.0f, -eye[2]};
+        float viewMatrix[16], projection[16], viewProjection[16];
+        lookAt(eye, target, viewMatrix);
+        perspective(0.785398f, float(width) / float(height), 0.1f, 4.0f * float(side), projection);
+        multiply(projection, viewMatrix, viewProjection);
+
+        for (int occlusion = 0; occlusion < 2; ++occlusion) {
+            if (occlusion) {
+                // the wall stands 5 units in front of the camera, facing it
+                float wallModel[16], inverseView[16] = {viewMatrix[0], viewMatrix[4], viewMatrix[8], 0,
+                                                        viewMatrix[1], viewMatrix[5], viewMatrix[9], 0,
+                                                        viewMatrix[2], viewMatrix[6], viewMatrix[10], 0,
+                                                        eye[0], eye[1], eye[2], 1};
+                const float offset[16] = {3, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, -2, -3, 1};
+                multiply(inverseView, offset, wallModel);
+                occluder.beginFrame(viewProjection);
+                occluder.addOccluder(wall, 3 * sizeof(float), 4, wallIndices, 6, wallModel);
+                occluder.rasterize();
+            }
+            gpu.setOcclusion(occlusion ? &occluder : nullptr);
+            cpu.setOcclusion(occlusion ? &occluder : nullptr);
+
+            GLuint gpuTriangles = 0, cpuTriangles = 0;
+            cpuTime += drawCulled(cpu, meshProgram, viewProjection, cpuPixels, width, height, query, cpuTriangles);
+            unsigned int cpuVisible = cpu.visibleCount();
+            if (gpu.gpuPath()) {
+                gpuTime += drawCulled(gpu, objectProgram, viewProjection, gpuPixels, width, height, query,
+                                      gpuTriangles);
+            }
+            ++frames;
+            unsigned int gpuVisible = gpu.gpuPath() ? gpu.visibleCount() : cpuVisible;
+            size_t differing = 0;
+            if (gpu.gpuPath()) {
+                for (size_t i = 0; i < gpuPixels.size(); i += 4)
+                    differing += memcmp(&gpuPixels[i], &cpuPixels[i], 3) != 0;
+            }
+            printf("view %u%s: %u of %zu objects visible (GPU %u), %u triangles (GPU %u), %zu pixels differ\n", view,
+                   occlusion ? " with Hi-Z" : "", cpuVisible, objects.size(), gpuVisible, cpuTriangles,
+                   gpu.gpuPath() ? gpuTriangles : cpuTriangles, differing);
+            differingPixels += differing;
+            // both paths draw the same triangles, only rounding of MVP against viewProjection * model may differ
+            mismatches += gpu.gpuPath() && (gpuVisible != cpuVisible || gpuTriangles != cpuTriangles ||
+                                            differing * 1000 > size_t(width) * height);
+        }
+    }
+    GLenum error = glGetError();
+    printf("CPU path %.3f ms per frame", cpuTime / frames);
+    if (gpu.gpuPath()) {
+        printf(", GPU path %.3f ms per frame, %zu pixels differ in total", gpuTime / frames, differingPixels);
+    }
+    printf("\n");
+
+    glDeleteQueries(1, &query);
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteRenderbuffers(2, renderbuffers);
+    glDeleteTextures(1, &texture);
+    if (objectProgram != meshProgram) glDeleteProgram(objectProgram);
+    glDeleteProgram(meshProgram);
+    gpu.destroy();
+    cpu.destroy();
+    glDeleteBuffers(2, buffers);
+    glDeleteVertexArrays(1, &vertexArray);
+
+    bool failed = mismatches > 0 || error != GL_NO_ERROR;
+    printf("%s\n", failed ? "culling test failed" : "culling test passed");
+    return failed ? 1 : 0;
+}
+
+/** Word index of allocation part of a frame, different in every frame so data of a reused region shows up */
+static uint32_t streamWord(unsigned int frame, unsigned int part, size_t index) {
+    return uint32_t(frame) * 1000003u + uint32_t(part) * 7919u + uint32_t(index);
+}
+
+static int stream(int argc, char **argv) {
+    unsigned int frames = argc > 2 ? std::max(atoi(argv[2]), 1) : 300;
+    // 50 quads of 4 vertices (position, color, frame: 16 bytes) and one uniform block per frame
+    const size_t vertexBytes = 50 * 4 * 16, blockBytes = 64, frameBytes = vertexBytes + blockBytes;
+
+    HiddenContext context;
+    if (!context.create()) return 1;
+
+    bool failed = false;
+    std::vector<uint32_t> received(frames * frameBytes / sizeof(uint32_t));
+    for (int persistent = 1; persistent >= 0; --persistent) {
+        if (persistent && !GLExtensions::bufferStorage()) {
+            printf("persistent path: buffer storage not available, skipped\n");
+            continue;
+        }
+        // room for two frames per region, so the orphaning path wraps and orphans every few frames
+        StreamBuffer buffer;
+        if (!buffer.create(2 * frameBytes + 256, 3, persistent != 0)) return 1;
+        if (buffer.persistent() != (persistent != 0)) {printf("Stream buffer took the wrong path\n"); return 1;}
+
+        // every frame is copied out by the GPU, a region overwritten before the copy ran leaves newer data behind
+        GLuint copies;
+        glGenBuffers(1, &copies);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, copies);
+        glBufferData(GL_COPY_WRITE_BUFFER, GLsizeiptr(frames * frameBytes), nullptr, GL_STATIC_COPY);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+        size_t missing = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned int frame = 0; frame < frames; ++frame) {
+            buffer.beginFrame();
+            StreamBuffer::Allocation parts[2] = {buffer.allocate(vertexBytes),
+                                                 buffer.allocate(blockBytes, buffer.uniformAlignment())};
+            for (unsigned int part = 0; part < 2; ++part) {
+                if (!parts[part].data) {
+                    ++missing;
+                    continue;
+                }
+                auto *words = static_cast<uint32_t *>(parts[part].data);
+                for (size_t i = 0; i < parts[part].size / sizeof(uint32_t); ++i) words[i] = streamWord(frame, part, i);
+            }
+            buffer.flush();
+            if (parts[0].data && parts[1].data) {
+                glBindBuffer(GL_COPY_READ_BUFFER, buffer.buffer());
+                glBindBuffer(GL_COPY_WRITE_BUFFER, copies);
+                GLintptr target = GLintptr(frame * frameBytes);
+                glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, parts[0].offset, target, vertexBytes);
+                glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, parts[1].offset,
+                                    target + GLintptr(vertexBytes), blockBytes);
+                glBindBuffer(GL_COPY_READ_BUFFER, 0);
+                glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+            }
+            buffer.endFrame();
+        }
+        glFinish();
+        double seconds = secondsSince(start);
+
+        glBindBuffer(GL_COPY_READ_BUFFER, copies);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, 0, GLsizeiptr(frames * frameBytes), received.data());
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glDeleteBuffers(1, &copies);
+        size_t wrong = 0;
+        for (unsigned int frame = 0; frame < frames; ++frame) {
+            const uint32_t *words = received.data() + frame * frameBytes / sizeof(uint32_t);
+            const size_t vertexWords = vertexBytes / sizeof(uint32_t);
+            for (size_t i = 0; i < frameBytes / sizeof(uint32_t); ++i) {
+                uint32_t expected = i < vertexWords ? streamWord(frame, 0, i) : streamWord(frame, 1, i - vertexWords);
+                wrong += words[i] != expected;
+            }
+        }
+        GLenum error = glGetError();
+        printf("%s path: %u frames, %.3f ms per frame, %llu stalls, %zu failed allocations, %zu words wrong\n",
+               persistent ? "persistent" : "orphaning", frames, seconds * 1e3 / frames,
+               static_cast<unsigned long long>(buffer.stallCount()), missing, wrong);
+        failed = failed || missing > 0 || wrong > 0 || error != GL_NO_ERROR;
+    }
+    printf("%s\n", failed ? "stream test failed" : "stream test passed");
+    return failed ? 1 : 0;
+}
+
+/** Rock of the voxel scene of main.cpp */
+static uint16_t rockMaterial(int x, int y, int z) {
+    float dx = float(x) - 32.0f, dy = float(y) * 1.4f, dz = float(z) - 32.0f;
+    float radius = 28.0f + 3.0f * sinf(float(x) * 0.3f) * cosf(float(z) * 0.25f) + 2.0f * sinf(float(y) * 0.4f);
+    if (dx * dx + dy * dy + dz * dz > radius * radius) return 0;
+    return y < 4 ? 1 : uint16_t((y + x / 8) % 3 + 2);
+}
+
+static int frame(int argc, char **argv) {
+    unsigned int frames = argc > 2 ? std::max(atoi(argv[2]), 1) : 600;
+    const unsigned int warmUp = 3;   // as in main.cpp
+
+    // the CPU side of a main.cpp frame: 64 moving point lights, 144 blended tentacles whose palettes and draw queue
+    // live in the frame arena, and a bubble moving through a voxel rock
+    LightClusters clusters;
+    clusters.setProjection(0.785398f, 4.0f / 3.0f, 0.1f, 100.0f, 1024, 768);
+    std::vector<PointLight> lights(64);
+    for (PointLight &light : lights) light = {{0, 0, 0}, 2.0f, {1, 1, 1}, 1.5f};
+    float view[16];
+    const float eye[3] = {4.0f, 3.0f, 3.0f}, target[3] = {0.0f, 0.0f, 0.0f};
+    lookAt(eye, target, view);
+
+    Skeleton skeleton = buildSkeleton();
+    CompressedClip clips[2];
+    if (!clips[0].compress(buildClip(skeleton, 1.2f, 0.6f, 3))) return 1;
+    if (!clips[1].compress(buildClip(skeleton, 0.8f, 1.0f, 5))) return 1;
+    std::vector<AnimationInstance> tentacles(144);
+    for (size_t i = 0; i < tentacles.size(); ++i) {
+        tentacles[i].clip = &clips[0];
+        tentacles[i].blendClip = &clips[1];
+        tentacles[i].time = float(i) * 0.01f;
+    }
+    const size_t paletteFloats = skeleton.jointCount() * 12;
+
+    VoxelWorld voxels;
+    if (!voxels.create(2, 1, 2)) return 1;
+    for (int z = 0; z < 64; ++z)
+        for (int y = 0; y < 32; ++y)
+            for (int x = 0; x < 64; ++x) voxels.set(x, y, z, rockMaterial(x, y, z));
+    voxels.update();
+    const int bubbleRadius = 5;
+    int bubble[3] = {-100, 0, 0};
+
+    uint64_t allocations = 0;
+    unsigned int allocatingFrames = 0, firstAllocatingFrame = 0;
+    size_t arenaPeak = 0, drawn = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int frameNumber = 1; frameNumber <= frames; ++frameNumber) {
+        Memory::beginFrame();
+        uint64_t before = Memory::heapAllocations();
+        float time = float(frameNumber) / 60.0f;
+
+        for (size_t i = 0; i < lights.size(); ++i) {
+            float angle = time * 0.5f + float(i) * (6.2831853f / float(lights.size()));
+            lights[i].position[0] = -2.0f + 1.8f * std::cos(angle);
+            lights[i].position[1] = -1.2f + 2.4f * float(i % 8) / 7.0f;
+            lights[i].position[2] = 1.8f * std::sin(angle);
+        }
+        clusters.assign(view, lights.data(), lights.size());
+
+        // the draw queue: palette of every tentacle, consumed by the draws of the frame
+        LinearArena &arena = Memory::frameArena();
+        auto *queue = arena.allocateArray<float *>(tentacles.size());
+        for (size_t i = 0; i < tentacles.size(); ++i) {
+            tentacles[i].palette = queue ? arena.allocateArray<float>(paletteFloats) : nullptr;
+            if (queue) queue[i] = tentacles[i].palette;
+            tentacles[i].time += 1.0f / 60.0f;
+            tentacles[i].blendTime += 1.0f / 60.0f;
+            tentacles[i].blendWeight = 0.5f + 0.5f * std::sin(time * 0.7f + float(i) * 0.3f);
+        }
+        Animation::evaluate(skeleton, tentacles.data(), tentacles.size());
+        for (size_t i = 0; queue && i < tentacles.size(); ++i) drawn += queue[i] != nullptr;
+
+        float bubbleAngle = time * 0.6f;
+        const int next[3] = {32 + int(20.0f * std::cos(bubbleAngle)), 12 + int(6.0f * std::sin(bubbleAngle * 1.7f)),
+                             32 + int(20.0f * std::sin(bubbleAngle))};
+        for (int pass = 0; pass < 2; ++pass) {
+            const int *center = pass ? next : bubble;
+            for (int z = -bubbleRadius; z <= bubbleRadius; ++z)
+                for (int y = -bubbleRadius; y <= bubbleRadius; ++y)
+                    for (int x = -bubbleRadius; x <= bubbleRadius; ++x) {
+                        if (x * x + y * y + z * z > bubbleRadius * bubbleRadius) continue;
+                        int p[3] = {center[0] + x, center[1] + y, center[2] + z};
+                        voxels.set(p[0], p[1], p[2], pass ? uint16_t(0) : rockMaterial(p[0], p[1], p[2]));
+                    }
+        }
+        std::copy(next, next + 3, bubble);
+        voxels.update();
+
+        arenaPeak = std::max(arenaPeak, arena.used());
+        uint64_t frameAllocations = Memory::heapAllocations() - before;
+        if (frameNumber > warmUp && frameAllocations > 0) {
+            if (!allocatingFrames) firstAllocatingFrame = frameNumber;
+            ++allocatingFrames;
+            allocations += frameAllocations;
+        }
+    }
+    double seconds = secondsSince(start);
+
+    printf("%u frames, %.3f ms per frame: %zu light indices, %zu tentacles drawn per frame, %zu of %zu frame arena "
+           "bytes used at most\n", frames, seconds * 1e3 / frames, clusters.lightIndexCount(), drawn / frames,
+           arenaPeak, Memory::FRAME_ARENA_SIZE);
+    printf("  %u frames after the warm up allocated from the heap (%llu allocations", allocatingFrames,
+           static_cast<unsigned long long>(allocations));
+    if (allocatingFrames) printf(", the first in frame %u", firstAllocatingFrame);
+    printf(")\n");
+    if (allocatingFrames) Memory::printStats();
+
+    bool failed = allocatingFrames > 0 || drawn != size_t(frames) * tentacles.size();
+    printf("%s\n", failed ? "frame test failed" : "frame test passed");
+    return failed ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {printUsage(); return 1;}
+    if (strcmp(argv[1], "lights") == 0) return lights(argc, argv);
+    if (strcmp(argv[1], "shadows") == 0) return shadows(argc, argv);
+    if (strcmp(argv[1], "graph") == 0) return graph(argc, argv);
+    if (strcmp(argv[1], "resolution") == 0) return resolution(argc, argv);
+    if (strcmp(argv[1], "animation") == 0) return animation(argc, argv);
+    if (strcmp(argv[1], "terrain") == 0) return terrain(argc, argv);
+    if (strcmp(argv[1], "voxels") == 0) return voxels(argc, argv);
+    if (strcmp(argv[1], "culling") == 0) return culling(argc, argv);
+    if (strcmp(argv[1], "stream") == 0) return stream(argc, argv);
+    if (strcmp(argv[1], "frame") == 0) return frame(argc, argv);
+    printUsage();
+    return 1;
+}
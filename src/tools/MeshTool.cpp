@@ -0,0 +1,747 @@
+//
+// Created by jonas on 19.10.26.
+//
+// Import time mesh processing
+//
+//   MeshTool bench <input.obj|input.ply|input.mesh> [iterations]   loads the file repeatedly and reports the throughput
+//   MeshTool cook <input.obj|input.ply> <output.mesh> [--quantize] [--lods] [--meshlets] [--atlas <manifest> <image>]
+//       optimizes a mesh and writes the engine format, --quantize stores 16 byte instead of 32 byte vertices,
+//       --lods adds a simplified LOD chain, --meshlets splits LOD 0 into clusters for Meshlets::cull,
+//       --atlas moves the uvs into the region of <image> in a manifest written by TextureTool atlas
+//   MeshTool simplify <input.obj|input.ply> [ratio] [iterations]   reports the simplifier throughput in triangles/s
+//   MeshTool lodtest <input.obj|input.ply> [maxPixelError]         checks the screen space error of the LOD selection
+//   MeshTool meshlets <input.obj|input.ply> [iterations]           reports the meshlet build and the culled triangles
+//   MeshTool occlusion [rooms] [iterations]                        culls boxes in generated rooms with OcclusionCuller
+//   MeshTool objtest [quads]              loads a generated .obj whose relative indices reach across the parser chunks
+//   MeshTool plytest [quads]              loads a generated binary .ply with quad faces and one with triangles
+//   MeshTool gltf <input.gltf|input.glb> [iterations]  loads a glTF scene in a hidden window and reports the load time
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "common/Assets.hpp"
+#include "common/CookedMesh.hpp"
+#include "common/Gltf.hpp"
+#include "common/HiddenContext.hpp"
+#include "common/JobSystem.hpp"
+#include "common/Memory.hpp"
+#include "common/MeshOptimizer.hpp"
+#include "common/Meshes.hpp"
+#include "common/Meshlets.hpp"
+#include "common/OcclusionCuller.hpp"
+#include "common/TextureAtlas.hpp"
+#include "common/VertexQuantization.hpp"
+
+static void printUsage() {
+    printf("Usage: MeshTool bench <input.obj|input.ply|input.mesh> [iterations]\n");
+    printf("       MeshTool cook <input.obj|input.ply> <output.mesh> [--quantize] [--lods] [--meshlets]\n");
+    printf("                     [--atlas <manifest> <image>]\n");
+    printf("       MeshTool simplify <input.obj|input.ply> [ratio] [iterations]\n");
+    printf("       MeshTool lodtest <input.obj|input.ply> [maxPixelError]\n");
+    printf("       MeshTool meshlets <input.obj|input.ply> [iterations]\n");
+    printf("       MeshTool occlusion [rooms] [iterations]\n");
+    printf("       MeshTool objtest [quads]\n");
+    printf("       MeshTool plytest [quads]\n");
+    printf("       MeshTool gltf <input.gltf|input.glb> [iterations]\n");
+}
+
+static bool isCooked(const char *filename) {
+    size_t length = strlen(filename);
+    return length > 5 && strcmp(filename + length - 5, ".mesh") == 0;
+}
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/** Load path of a cooked mesh without a GL context: map, validate and copy the blobs like glBufferData would */
+static bool loadCooked(const char *filename, std::vector<unsigned char> &staging, size_t &vertices, size_t &triangles) {
+    CookedMesh cooked;
+    if (!cooked.open(filename)) return false;
+    const CookedMesh::Header &header = cooked.header();
+    staging.resize(size_t(header.vertexSize + header.indexSize));
+    memcpy(staging.data(), cooked.vertices(), size_t(header.vertexSize));
+    memcpy(staging.data() + header.vertexSize, cooked.indices(), size_t(header.indexSize));
+    vertices = header.vertexCount;
+    triangles = cooked.lod(0).indexCount / 3;
+    return true;
+}
+
+static int bench(int argc, char **argv) {
+    if (argc < 3) {printUsage(); return 1;}
+    unsigned int iterations = argc > 3 ? std::max(atoi(argv[3]), 1) : 5;
+
+    AssetData file;
+    if (!Assets::open(argv[2], file)) {printf("%s could not be opened\n", argv[2]); return 1;}
+    double megaBytes = double(file.size()) / (1024.0 * 1024.0);
+
+    // the first run includes page faults of the mapping, the following ones show the parser itself
+    double first = 0, best = 1e30, total = 0;
+    bool cooked = isCooked(argv[2]);
+    MeshData mesh;
+    std::vector<unsigned char> staging;
+    size_t vertices = 0, triangles = 0;
+    for (unsigned int i = 0; i < iterations; ++i) {
+        mesh = MeshData();
+        auto start = std::chrono::steady_clock::now();
+        if (cooked ? !loadCooked(argv[2], staging, vertices, triangles) : !Meshes::load(argv[2], mesh)) return 1;
+        double seconds = secondsSince(start);
+        if (i == 0) first = seconds;
+        best = std::min(best, seconds);
+        total += seconds;
+    }
+    if (!cooked) {
+        vertices = mesh.vertices.size();
+        triangles = mesh.indices.size() / 3;
+    }
+
+    printf("%s: %.1f MB, %zu vertices, %zu triangles\n", argv[2], megaBytes, vertices, triangles);
+    if (!cooked) {
+        printf("  bounds: (%g %g %g) - (%g %g %g)\n", mesh.boundsMin[0], mesh.boundsMin[1], mesh.boundsMin[2],
+               mesh.boundsMax[0], mesh.boundsMax[1], mesh.boundsMax[2]);
+    }
+    printf("  %s: first %.1f MB/s, best %.1f MB/s, mean %.1f MB/s over %u iterations on %u threads\n",
+           cooked ? "load" : "import", megaBytes / first, megaBytes / best, megaBytes * iterations / total, iterations,
+           JobSystem::threadCount());
+    return 0;
+}
+
+/** Looks up the region of an image in a manifest written by TextureTool atlas */
+static bool readAtlasRegion(const char *manifestPath, const char *name, TextureAtlas::Region &region) {
+    FILE *manifest = fopen(manifestPath, "r");
+    if (!manifest) {printf("Could not open %s\n", manifestPath); return false;}
+    char line[1024], image[1024];
+    bool found = false;
+    while (!found && fgets(line, sizeof(line), manifest)) {
+        if (line[0] == '#') continue;
+        found = sscanf(line, "%1023s %u %u %u %u %f %f %f %f", image, &region.x, &region.y, &region.width,
+                       &region.height, &region.uvOffset[0], &region.uvOffset[1], &region.uvScale[0],
+                       &region.uvScale[1]) == 9 && strcmp(image, name) == 0;
+    }
+    fclose(manifest);
+    if (!found) printf("%s is not in %s\n", name, manifestPath);
+    return found;
+}
+
+static int cook(int argc, char **argv) {
+    if (argc < 4) {printUsage(); return 1;}
+    bool quantize = false, lods = false, clusters = false;
+    const char *atlasManifest = nullptr, *atlasImage = nullptr;
+    for (int i = 4; i < argc; ++i) {
+        if (strcmp(argv[i], "--quantize") == 0) quantize = true;
+        else if (strcmp(argv[i], "--lods") == 0) lods = true;
+        else if (strcmp(argv[i], "--meshlets") == 0) clusters = true;
+        else if (strcmp(argv[i], "--atlas") == 0 && i + 2 < argc) {atlasManifest = argv[++i]; atlasImage = argv[++i];}
+        else {printUsage(); return 1;}
+    }
+    TextureAtlas::Region region;
+    if (atlasManifest && !readAtlasRegion(atlasManifest, atlasImage, region)) return 1;
+
+    auto start = std::chrono::steady_clock::now();
+    MeshData mesh;
+    if (!Meshes::load(argv[2], mesh)) return 1;
+    double importSeconds = secondsSince(start);
+
+    if (atlasManifest) {
+        // a repeating uv would sample the neighbouring images, the mesh has to be unwrapped into [0, 1]
+        size_t outside = 0;
+        for (const Vertex &vertex : mesh.vertices)
+            outside += vertex.uv[0] < 0.0f || vertex.uv[0] > 1.0f || vertex.uv[1] < 0.0f || vertex.uv[1] > 1.0f;
+        if (outside) {
+            printf("%zu vertices of %s have uvs outside of [0, 1] and can not use an atlas\n", outside, argv[2]);
+            return 1;
+        }
+        if (!mesh.vertices.empty())
+            TextureAtlas::remapUVs(mesh.vertices[0].uv, mesh.vertices.size(), sizeof(Vertex) / sizeof(float), region);
+    }
+
+    start = std::chrono::steady_clock::now();
+    double acmrBefore = MeshOptimizer::averageCacheMissRatio(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+    std::vector<MeshLod> chain;
+    if (lods) {
+        chain = MeshOptimizer::buildLods(mesh);
+    } else {
+        MeshOptimizer::optimizeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+        MeshOptimizer::optimizeVertexFetch(mesh);
+        chain.push_back({0, unsigned(mesh.indices.size()), 0.0f});
+    }
+    std::vector<Meshlet> meshlets;
+    if (clusters) {
+        // clusters reorder the triangles of LOD 0, fetch order follows the new triangle order
+        meshlets = Meshlets::build(mesh, chain[0].firstIndex, chain[0].indexCount);
+        MeshOptimizer::optimizeVertexFetch(mesh);
+    }
+    double acmrAfter = MeshOptimizer::averageCacheMissRatio(mesh.indices.data(), chain[0].indexCount, mesh.vertices.size());
+    double optimizeSeconds = secondsSince(start);
+
+    CookedMesh::VertexFormat format = quantize ? CookedMesh::VertexFormat::Quantized16 : CookedMesh::VertexFormat::Float32;
+    if (!CookedMesh::write(argv[3], mesh, chain, format, meshlets)) return 1;
+    AssetData source, cooked;
+    Assets::open(argv[2], source);
+    Assets::open(argv[3], cooked);
+
+    printf("%s: %zu vertices, %u triangles\n", argv[2], mesh.vertices.size(), chain[0].indexCount / 3);
+    printf("  import %.2f s, optimize %.2f s\n", importSeconds, optimizeSeconds);
+    if (atlasManifest) printf("  uvs moved into %s at %u %u (%ux%u)\n", atlasImage, region.x, region.y, region.width,
+                              region.height);
+    for (size_t i = 1; i < chain.size(); ++i) printf("  LOD %zu: %u triangles, error %g\n", i, chain[i].indexCount / 3, chain[i].error);
+    if (clusters) printf("  %zu meshlets\n", meshlets.size());
+    printf("  vertex cache misses per triangle (16 entry FIFO): %.3f -> %.3f\n", acmrBefore, acmrAfter);
+    printf("  %s: %.1f MB -> %s: %.1f MB\n", argv[2], double(source.size()) / (1024.0 * 1024.0), argv[3],
+           double(cooked.size()) / (1024.0 * 1024.0));
+
+    if (quantize) {
+        VertexDecode decode = VertexQuantization::decodeFor(mesh);
+        std::vector<QuantizedVertex> quantized;
+        VertexQuantization::quantize(mesh, decode, quantized);
+        VertexQuantization::Error error = VertexQuantization::measureError(mesh, quantized, decode);
+        printf("  vertices: %.1f MB float -> %.1f MB quantized (%zu -> %zu bytes per vertex)\n",
+               double(mesh.vertices.size() * sizeof(Vertex)) / (1024.0 * 1024.0),
+               double(quantized.size() * sizeof(QuantizedVertex)) / (1024.0 * 1024.0), sizeof(Vertex), sizeof(QuantizedVertex));
+        printf("  max error: position %g (%.2e of the bounds diagonal), normal %.4f degrees, uv %g\n",
+               error.position, error.positionRelative, error.normalDegrees, error.uv);
+    }
+    return 0;
+}
+
+static int simplify(int argc, char **argv) {
+    if (argc < 3) {printUsage(); return 1;}
+    float ratio = argc > 3 ? std::clamp(float(atof(argv[3])), 0.0f, 1.0f) : 0.25f;
+    unsigned int iterations = argc > 4 ? std::max(atoi(argv[4]), 1) : 3;
+
+    MeshData mesh;
+    if (!Meshes::load(argv[2], mesh)) return 1;
+    size_t triangles = mesh.indices.size() / 3;
+    size_t target = size_t(double(triangles) * ratio) * 3;
+
+    double best = 1e30, total = 0;
+    std::vector<unsigned int> result;
+    float error = 0;
+    for (unsigned int i = 0; i < iterations; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        error = MeshOptimizer::simplify(mesh, mesh.indices.data(), mesh.indices.size(), target, 1e30f, result);
+        double seconds = secondsSince(start);
+        best = std::min(best, seconds);
+        total += seconds;
+    }
+
+    printf("%s: %zu -> %zu triangles (target %zu), error %g\n", argv[2], triangles, result.size() / 3, target / 3, error);
+    printf("  simplify: best %.2f M triangles/s, mean %.2f M triangles/s over %u iterations\n",
+           double(triangles) / best * 1e-6, double(triangles) * iterations / total * 1e-6, iterations);
+    return 0;
+}
+
+/** Walks the camera away from the mesh and checks that every selected LOD stays within the pixel error
+ *  and that the next coarser LOD would not have
+ */
+static int lodtest(int argc, char **argv) {
+    if (argc < 3) {printUsage(); return 1;}
+    float maxPixelError = argc > 3 ? float(atof(argv[3])) : 1.0f;
+
+    MeshData mesh;
+    if (!Meshes::load(argv[2], mesh)) return 1;
+    GpuMesh gpu;
+    gpu.lods = MeshOptimizer::buildLods(mesh);
+    for (size_t i = 0; i < gpu.lods.size(); ++i)
+        printf("LOD %zu: %u triangles, error %g\n", i, gpu.lods[i].indexCount / 3, gpu.lods[i].error);
+
+    // 45 degree field of view at 768 pixels, like the main camera
+    float pixelsPerUnit = Meshes::pixelsPerUnit(0.785398f, 768.0f);
+    float size = 0;
+    for (int axis = 0; axis < 3; ++axis) size = std::max(size, mesh.boundsMax[axis] - mesh.boundsMin[axis]);
+    int failures = 0;
+    size_t previous = 0;
+    for (float distance = size * 0.1f; distance < size * 1000.0f; distance *= 1.5f) {
+        size_t lod = Meshes::selectLod(gpu, distance, pixelsPerUnit, maxPixelError);
+        float projected = gpu.lods[lod].error * pixelsPerUnit / distance;
+        bool coarserFits = lod + 1 < gpu.lods.size() && gpu.lods[lod + 1].error * pixelsPerUnit / distance <= maxPixelError;
+        bool ok = projected <= maxPixelError && !coarserFits && lod >= previous;
+        failures += !ok;
+        previous = lod;
+        printf("  distance %10.3f: LOD %zu, %8u triangles, screen error %.3f px%s\n", distance, lod,
+               gpu.lods[lod].indexCount / 3, projected, ok ? "" : "  FAILED");
+    }
+    printf("%s\n", failures ? "screen error test failed" : "screen error test passed");
+    return failures ? 1 : 0;
+}
+
+/** Column major perspective(fovY, aspect, zNear, zFar) * lookAt(eye, target, +y) */
+static void viewProjection(const float eye[3], const float target[3], float fovY, float aspect, float zNear, float zFar,
+                           float result[16]) {
+    float f[3] = {target[0] - eye[0], target[1] - eye[1], target[2] - eye[2]};
+    float length = std::sqrt(f[0] * f[0] + f[1] * f[1] + f[2] * f[2]);
+    for (float &c : f) c /= length;
+    float r[3] = {-f[2], 0.0f, f[0]}; // f x (0, 1, 0)
+    length = std::sqrt(r[0] * r[0] + r[2] * r[2]);
+    for (float &c : r) c /= length;
+    float u[3] = {r[1] * f[2] - r[2] * f[1], r[2] * f[0] - r[0] * f[2], r[0] * f[1] - r[1] * f[0]};
+    float view[16] = {r[0], u[0], -f[0], 0, r[1], u[1], -f[1], 0, r[2], u[2], -f[2], 0, 0, 0, 0, 1};
+    for (int i = 0; i < 3; ++i) {
+        view[12] -= r[i] * eye[i];
+        view[13] -= u[i] * eye[i];
+        view[14] += f[i] * eye[i];
+    }
+    float t = 1.0f / std::tan(fovY * 0.5f);
+    float projection[16] = {t / aspect, 0, 0, 0, 0, t, 0, 0, 0, 0, (zFar + zNear) / (zNear - zFar), -1,
+                            0, 0, 2 * zFar * zNear / (zNear - zFar), 0};
+    for (int column = 0; column < 4; ++column) {
+        for (int row = 0; row < 4; ++row) {
+            float sum = 0;
+            for (int k = 0; k < 4; ++k) sum += projection[k * 4 + row] * view[column * 4 + k];
+            result[column * 4 + row] = sum;
+        }
+    }
+}
+
+/** @returns true if a culled triangle really is invisible: back facing or outside one frustum plane */
+static bool triangleInvisible(const MeshData &mesh, const unsigned int *triangle, const MeshletCullView &view) {
+    const float *p[3] = {mesh.vertices[triangle[0]].position, mesh.vertices[triangle[1]].position,
+                         mesh.vertices[triangle[2]].position};
+    for (const float *plane : view.planes) {
+        bool outside = true;
+        for (const float *v : p) outside = outside && plane[0] * v[0] + plane[1] * v[1] + plane[2] * v[2] + plane[3] < 0.0f;
+        if (outside) return true;
+    }
+    float e1[3], e2[3], toCamera[3];
+    for (int i = 0; i < 3; ++i) {
+        e1[i] = p[1][i] - p[0][i];
+        e2[i] = p[2][i] - p[0][i];
+        toCamera[i] = view.cameraPosition[i] - p[0][i];
+    }
+    float n[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+    return n[0] * toCamera[0] + n[1] * toCamera[1] + n[2] * toCamera[2] <= 0.0f;
+}
+
+/** Builds meshlets, then culls them from cameras around and inside the mesh and checks that no culled triangle
+ *  could have been visible
+ */
+static int meshlets(int argc, char **argv) {
+    if (argc < 3) {printUsage(); return 1;}
+    unsigned int iterations = argc > 3 ? std::max(atoi(argv[3]), 1) : 3;
+
+    MeshData mesh;
+    if (!Meshes::load(argv[2], mesh)) return 1;
+    MeshOptimizer::optimizeVertexCache(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size());
+    size_t triangles = mesh.indices.size() / 3;
+
+    double best = 1e30;
+    std::vector<unsigned int> source = mesh.indices;
+    std::vector<Meshlet> clusters;
+    for (unsigned int i = 0; i < iterations; ++i) {
+        mesh.indices = source;
+        auto start = std::chrono::steady_clock::now();
+        clusters = Meshlets::build(mesh, 0, mesh.indices.size());
+        best = std::min(best, secondsSince(start));
+    }
+    size_t vertices = 0, coneCullable = 0;
+    for (const Meshlet &meshlet : clusters) {
+        vertices += meshlet.vertexCount;
+        coneCullable += meshlet.coneCutoff < 1.0f;
+    }
+    printf("%s: %zu triangles -> %zu meshlets, %.1f vertices and %.1f triangles each, %.0f%% with a usable normal cone\n",
+           argv[2], triangles, clusters.size(), double(vertices) / double(clusters.size()),
+           double(triangles) / double(clusters.size()), 100.0 * double(coneCullable) / double(clusters.size()));
+    printf("  build: %.2f M triangles/s, vertex cache misses per triangle %.3f\n", double(triangles) / best * 1e-6,
+           MeshOptimizer::averageCacheMissRatio(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size()));
+
+    MeshletCullData data;
+    data.assign(clusters.data(), clusters.size());
+    const float identity[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+    float center[3], size = 0;
+    for (int axis = 0; axis < 3; ++axis) {
+        center[axis] = (mesh.boundsMin[axis] + mesh.boundsMax[axis]) * 0.5f;
+        size = std::max(size, mesh.boundsMax[axis] - mesh.boundsMin[axis]);
+    }
+
+    // orbits at two distances plus a camera at the center looking out, 45 degree fov at 1024x768 like main
+    MeshletDrawList draws;
+    size_t visibleTriangles = 0, ranges = 0, views = 0, violations = 0;
+    uint64_t steadyAllocations = 0;
+    double cullSeconds = 0;
+    for (float distance : {size * 1.5f, size * 0.4f, 0.0f}) {
+        for (int step = 0; step < 8; ++step) {
+            float angle = float(step) * 0.785398f;
+            float eye[3] = {center[0] + std::cos(angle) * distance, center[1] + size * 0.2f, center[2] + std::sin(angle) * distance};
+            float target[3] = {center[0], center[1], center[2]};
+            if (distance == 0.0f) {
+                target[0] += std::cos(angle);
+                target[2] += std::sin(angle);
+            }
+            float matrix[16];
+            viewProjection(eye, target, 0.785398f, 1024.0f / 768.0f, size * 0.001f, size * 10.0f, matrix);
+            MeshletCullView view = MeshletCullView::fromViewProjection(matrix, eye);
+
+            auto start = std::chrono::steady_clock::now();
+            for (unsigned int i = 0; i < iterations; ++i) {
+                // repeated passes over the same view are steady state, the draw list must not grow any more
+                uint64_t allocations = Memory::heapAllocations();
+                Meshlets::cull(data, identity, view, GL_UNSIGNED_INT, draws);
+                if (i > 0) steadyAllocations += Memory::heapAllocations() - allocations;
+            }
+            cullSeconds += secondsSince(start);
+            visibleTriangles += draws.visibleTriangles;
+            ranges += draws.counts.size();
+            ++views;
+
+            for (size_t m = 0; m < clusters.size(); ++m) {
+                if (draws.visible[m]) continue;
+                for (uint32_t t = 0; t < clusters[m].indexCount; t += 3)
+                    violations += !triangleInvisible(mesh, &mesh.indices[clusters[m].firstIndex + t], view);
+            }
+        }
+    }
+    double passes = double(views) * iterations;
+    printf("  cull: %.1f M meshlets/s (%.3f ms per pass) on %u threads\n", double(clusters.size()) * passes / cullSeconds * 1e-6,
+           cullSeconds / passes * 1e3, JobSystem::threadCount());
+    printf("  %zu views: %.1f%% of the triangles drawn in %.1f ranges per glMultiDrawElements on average\n", views,
+           100.0 * double(visibleTriangles) / (double(triangles) * double(views)), double(ranges) / double(views));
+    printf("  %llu heap allocations in repeated passes\n", static_cast<unsigned long long>(steadyAllocations));
+    if (violations) printf("culling test failed, visible triangles were culled\n");
+    else if (steadyAllocations) printf("culling test failed, steady state passes allocated\n");
+    else printf("culling test passed\n");
+    return violations || steadyAllocations ? 1 : 0;
+}
+
+/** Appends the 12 triangles of an axis aligned box */
+static void appendBox(const float low[3], const float high[3], std::vector<float> &positions, std::vector<unsigned int> &indices) {
+    static const unsigned int FACES[36] = {0, 2, 1, 1, 2, 3, 4, 5, 6, 5, 7, 6, 0, 1, 4, 1, 5, 4,
+                                           2, 6, 3, 3, 6, 7, 0, 4, 2, 2, 4, 6, 1, 3, 5, 3, 7, 5};
+    unsigned int first = unsigned(positions.size() / 3);
+    for (int corner = 0; corner < 8; ++corner) {
+        positions.push_back(corner & 1 ? high[0] : low[0]);
+        positions.push_back(corner & 2 ? high[1] : low[1]);
+        positions.push_back(corner & 4 ? high[2] : low[2]);
+    }
+    for (unsigned int index : FACES) indices.push_back(first + index);
+}
+
+/** @returns Distance along the ray to the box (0 if the origin is inside), negative if the ray misses it */
+static float intersectBox(const float origin[3], const float direction[3], const float *low, const float *high) {
+    float enter = 0.0f, leave = 1e30f;
+    for (int axis = 0; axis < 3; ++axis) {
+        if (direction[axis] == 0.0f) {
+            if (origin[axis] < low[axis] || origin[axis] > high[axis]) return -1.0f;
+            continue;
+        }
+        float t0 = (low[axis] - origin[axis]) / direction[axis], t1 = (high[axis] - origin[axis]) / direction[axis];
+        enter = std::max(enter, std::min(t0, t1));
+        leave = std::min(leave, std::max(t0, t1));
+    }
+    return enter <= leave ? enter : -1.0f;
+}
+
+/** Builds rooms with doorways, fills them with boxes and culls the boxes against the walls from cameras in several
+ *  rooms. Every occluded box is checked by ray casting through the pixel centers it covers.
+ */
+static int occlusion(int argc, char **argv) {
+    unsigned int rooms = argc > 2 ? unsigned(std::clamp(atoi(argv[2]), 2, 64)) : 8;
+    unsigned int iterations = argc > 3 ? std::max(atoi(argv[3]), 1) : 5;
+    const float roomSize = 8.0f, wallHeight = 3.0f, thickness = 0.2f, door = 1.5f;
+
+    // walls along the cell borders, interior ones with a doorway in the middle
+    std::vector<float> wallPositions;
+    std::vector<unsigned int> wallIndices;
+    float extent = float(rooms) * roomSize;
+    for (unsigned int line = 0; line <= rooms; ++line) {
+        float offset = float(line) * roomSize;
+        bool outer = line == 0 || line == rooms;
+        for (unsigned int cell = 0; cell < rooms; ++cell) {
+            float start = float(cell) * roomSize, middle = start + roomSize * 0.5f;
+            float spans[2][2] = {{start, outer ? start + roomSize : middle - door * 0.5f},
+                                 {middle + door * 0.5f, start + roomSize}};
+            for (int span = 0; span < (outer ? 1 : 2); ++span) {
+                float alongX[2][3] = {{spans[span][0], 0.0f, offset - thickness * 0.5f}, {spans[span][1], wallHeight, offset + thickness * 0.5f}};
+                float alongZ[2][3] = {{offset - thickness * 0.5f, 0.0f, spans[span][0]}, {offset + thickness * 0.5f, wallHeight, spans[span][1]}};
+                appendBox(alongX[0], alongX[1], wallPositions, wallIndices);
+                appendBox(alongZ[0], alongZ[1], wallPositions, wallIndices);
+            }
+        }
+    }
+    size_t wallCount = wallIndices.size() / 36;
+
+    // 24 props per room, seeded so runs are comparable
+    unsigned int seed = 12345;
+    auto random = [&seed]() {
+        seed = seed * 1664525u + 1013904223u;
+        return float(seed >> 8) / float(1 << 24);
+    };
+    std::vector<float> objects; // low xyz, high xyz
+    for (unsigned int room = 0; room < rooms * rooms; ++room) {
+        for (int i = 0; i < 24; ++i) {
+            float size[3] = {0.3f + random() * 1.2f, 0.3f + random() * 1.7f, 0.3f + random() * 1.2f};
+            float x = float(room % rooms) * roomSize + 0.5f + random() * (roomSize - 1.0f - size[0]);
+            float z = float(room / rooms) * roomSize + 0.5f + random() * (roomSize - 1.0f - size[2]);
+            objects.insert(objects.end(), {x, 0.0f, z, x + size[0], size[1], z + size[2]});
+        }
+    }
+    size_t objectCount = objects.size() / 6;
+    printf("%u x %u rooms: %zu wall boxes (%zu occluder triangles), %zu objects\n", rooms, rooms, wallCount,
+           wallIndices.size() / 3, objectCount);
+
+    const float identity[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+    const float fovY = 0.785398f, aspect = 1024.0f / 768.0f, zNear = 0.1f, zFar = extent * 2.0f;
+    OcclusionCuller culler, frustumOnly;
+    std::vector<uint8_t> visible(objectCount);
+    size_t views = 0, inFrustum = 0, drawn = 0, checked = 0, violations = 0;
+    uint64_t steadyAllocations = 0;
+    double rasterSeconds = 0, testSeconds = 0;
+    for (unsigned int camera = 0; camera < 3; ++camera) {
+        unsigned int room = camera == 0 ? rooms / 2 * rooms + rooms / 2 : camera == 1 ? 0 : rooms * rooms - 1;
+        float eye[3] = {(float(room % rooms) + 0.3f) * roomSize, 1.6f, (float(room / rooms) + 0.4f) * roomSize};
+        for (int step = 0; step < 8; ++step) {
+            float angle = float(step) * 0.785398f + 0.2f;
+            float target[3] = {eye[0] + std::cos(angle), eye[1], eye[2] + std::sin(angle)};
+            float matrix[16];
+            viewProjection(eye, target, fovY, aspect, zNear, zFar, matrix);
+
+            for (unsigned int i = 0; i < iterations; ++i) {
+                uint64_t allocations = Memory::heapAllocations();
+                auto start = std::chrono::steady_clock::now();
+                culler.beginFrame(matrix);
+                culler.addOccluder(wallPositions.data(), 3 * sizeof(float), wallPositions.size() / 3, wallIndices.data(),
+                                   wallIndices.size(), identity);
+                culler.rasterize();
+                rasterSeconds += secondsSince(start);
+
+                start = std::chrono::steady_clock::now();
+                for (size_t o = 0; o < objectCount; ++o) visible[o] = culler.isVisible(&objects[o * 6], &objects[o * 6 + 3], identity);
+                testSeconds += secondsSince(start);
+                // the first frame of a view may grow the triangle bins, the following ones must reuse them
+                if (i > 0) steadyAllocations += Memory::heapAllocations() - allocations;
+            }
+            frustumOnly.beginFrame(matrix);
+            frustumOnly.rasterize();
+            ++views;
+
+            // pixel centers inside each occluded box's rectangle: the first wall hit must be in front of the box
+            float forward[3] = {std::cos(angle), 0.0f, std::sin(angle)}, right[3] = {-forward[2], 0.0f, forward[0]};
+            float tanHalf = std::tan(fovY * 0.5f);
+            for (size_t o = 0; o < objectCount; ++o) {
+                bool inside = frustumOnly.isVisible(&objects[o * 6], &objects[o * 6 + 3], identity);
+                inFrustum += inside;
+                drawn += visible[o];
+                if (!inside || visible[o]) continue;
+                ++checked;
+                for (unsigned int y = 0; y < culler.height(); ++y) {
+                    for (unsigned int x = 0; x < culler.width(); ++x) {
+                        float ndcX = (float(x) + 0.5f) / float(culler.width()) * 2.0f - 1.0f;
+                        float ndcY = (float(y) + 0.5f) / float(culler.height()) * 2.0f - 1.0f;
+                        float direction[3];
+                        for (int k = 0; k < 3; ++k)
+                            direction[k] = forward[k] + right[k] * ndcX * tanHalf * aspect + (k == 1 ? ndcY * tanHalf : 0.0f);
+                        float hit = intersectBox(eye, direction, &objects[o * 6], &objects[o * 6 + 3]);
+                        if (hit < zNear) continue;
+                        bool hidden = false;
+                        for (size_t w = 0; w < wallCount && !hidden; ++w) {
+                            const float *corners = &wallPositions[w * 24];
+                            float wall = intersectBox(eye, direction, corners, corners + 21);
+                            hidden = wall >= zNear && wall <= hit;
+                        }
+                        if (!hidden) {
+                            ++violations;
+                            x = culler.width();
+                            y = culler.height();
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    double passes = double(views) * iterations;
+    printf("  %ux%u depth buffer on %u threads: rasterize %.3f ms, test %.1f ns per object\n", culler.width(),
+           culler.height(), JobSystem::threadCount(), rasterSeconds / passes * 1e3,
+           testSeconds / (passes * double(objectCount)) * 1e9);
+    printf("  %zu views: %.1f objects in the frustum, %.1f drawn (%.1f%% of them occluded)\n", views,
+           double(inFrustum) / double(views), double(drawn) / double(views),
+           inFrustum ? 100.0 * double(inFrustum - drawn) / double(inFrustum) : 0.0);
+    printf("  %zu occluded objects ray cast, %zu visible ones culled\n", checked, violations);
+    printf("  %llu heap allocations in repeated frames\n", static_cast<unsigned long long>(steadyAllocations));
+    printf("%s\n", violations || steadyAllocations ? "occlusion test failed" : "occlusion test passed");
+    return violations || steadyAllocations ? 1 : 0;
+}
+
+static int objtest(int argc, char **argv) {
+    unsigned int quads = argc > 2 ? unsigned(std::max(atoi(argv[2]), 2)) : 20000;
+    const char *path = "objtest.obj";
+
+    // every quad writes its corners, uvs and normal before the faces that use them with relative indices, and a
+    // bridge triangle to the previous quad. Several megabytes of these put faces right behind every chunk border.
+    FILE *file = fopen(path, "wb");
+    if (!file) {printf("Could not open %s for writing\n", path); return 1;}
+    std::vector<Vertex> expected;
+    auto corner = [](unsigned int quad, unsigned int index) {
+        Vertex vertex{};
+        vertex.position[0] = float(quad % 256) + float(index & 1);
+        vertex.position[1] = float(quad % 7) * 0.5f;
+        vertex.position[2] = float(quad / 256) + float(index >> 1);
+        vertex.normal[quad % 2 ? 0 : 1] = 1.0f;
+        vertex.uv[0] = float(index & 1) * 0.25f + float(quad % 4);
+        vertex.uv[1] = float(index >> 1) * 0.25f;
+        return vertex;
+    };
+    for (unsigned int quad = 0; quad < quads; ++quad) {
+        for (unsigned int index = 0; index < 4; ++index) {
+            Vertex vertex = corner(quad, index);
+            fprintf(file, "v %g %g %g\n", vertex.position[0], vertex.position[1], vertex.position[2]);
+        }
+        for (unsigned int index = 0; index < 4; ++index) {
+            Vertex vertex = corner(quad, index);
+            fprintf(file, "vt %g %g\n", vertex.uv[0], vertex.uv[1]);
+        }
+        Vertex first = corner(quad, 0);
+        fprintf(file, "vn %g %g %g\n", first.normal[0], first.normal[1], first.normal[2]);
+        fprintf(file, "f -4/-4/-1 -3/-3/-1 -1/-1/-1 -2/-2/-1\n");
+        for (unsigned int index : {0u, 1u, 3u, 0u, 3u, 2u}) expected.push_back(corner(quad, index));
+        if (quad > 0) {
+            fprintf(file, "f -8/-8/-2 -4/-4/-1 -3/-3/-1\n");
+            Vertex previous = corner(quad - 1, 0);
+            expected.push_back(previous);
+            expected.push_back(corner(quad, 0));
+            expected.push_back(corner(quad, 1));
+        }
+    }
+    long fileSize = ftell(file);
+    fclose(file);
+
+    MeshData mesh;
+    auto start = std::chrono::steady_clock::now();
+    bool loaded = Meshes::loadOBJ(path, mesh);
+    double seconds = secondsSince(start);
+    remove(path);
+    if (!loaded) {printf("objtest failed\n"); return 1;}
+
+    // the corners have to come back in order with the attributes they were written with
+    size_t mismatches = mesh.indices.size() == expected.size() ? 0 : std::max(mesh.indices.size(), expected.size());
+    for (size_t i = 0; mismatches == 0 && i < expected.size(); ++i) {
+        const Vertex &vertex = mesh.vertices[mesh.indices[i]];
+        if (memcmp(vertex.position, expected[i].position, sizeof(vertex.position)) != 0 ||
+            memcmp(vertex.uv, expected[i].uv, sizeof(vertex.uv)) != 0 ||
+            memcmp(vertex.normal, expected[i].normal, sizeof(vertex.normal)) != 0)
+            ++mismatches;
+    }
+    printf("%u quads, %.1f MB with relative indices loaded in %.3f s: %zu corners, %zu mismatches\n", quads,
+           double(fileSize) / 1e6, seconds, mesh.indices.size(), mismatches);
+    printf("%s\n", mismatches ? "objtest failed" : "objtest passed");
+    return mismatches ? 1 : 0;
+}
+
+static int plytest(int argc, char **argv) {
+    unsigned int quads = argc > 2 ? unsigned(std::max(atoi(argv[2]), 2)) : 40000;
+    const char *path = "plytest.ply";
+
+    // quads with a uchar count and ushort indices, stored once as quads and once split into triangles. Every quad
+    // starts with the bytes 4, 3, row, 255, so reading it at the triangle stride one byte in sees a count of 3 and an
+    // index past the last vertex. Both files have to come back as the same triangle fan.
+    const unsigned int rows = 200;
+    size_t failures = 0;
+    for (unsigned int corners : {4u, 3u}) {
+        FILE *file = fopen(path, "wb");
+        if (!file) {printf("Could not open %s for writing\n", path); return 1;}
+        unsigned int faceCount = corners == 4 ? quads : quads * 2;
+        fprintf(file, "ply\nformat binary_little_endian 1.0\nelement vertex %u\n", rows * 256);
+        fprintf(file, "property float x\nproperty float y\nproperty float z\n");
+        fprintf(file, "element face %u\nproperty list uchar ushort vertex_indices\nend_header\n", faceCount);
+        for (unsigned int i = 0; i < rows * 256; ++i) {
+            float position[3] = {float(i % 256), float(i % 3) * 0.5f, float(i / 256)};
+            fwrite(position, sizeof(position), 1, file);
+        }
+        std::vector<unsigned int> expected;
+        for (unsigned int quad = 0; quad < quads; ++quad) {
+            unsigned int row = (quad % rows) * 256;
+            unsigned short indices[4] = {static_cast<unsigned short>(row + 3), static_cast<unsigned short>(row + 255),
+                                         static_cast<unsigned short>(row + 254), static_cast<unsigned short>(row + 4)};
+            unsigned char count = static_cast<unsigned char>(corners);
+            if (corners == 4) {
+                fwrite(&count, 1, 1, file);
+                fwrite(indices, sizeof(indices), 1, file);
+            } else {
+                unsigned short second[3] = {indices[0], indices[2], indices[3]};
+                fwrite(&count, 1, 1, file);
+                fwrite(indices, sizeof(unsigned short), 3, file);
+                fwrite(&count, 1, 1, file);
+                fwrite(second, sizeof(second), 1, file);
+            }
+            for (unsigned int index : {0u, 1u, 2u, 0u, 2u, 3u}) expected.push_back(indices[index]);
+        }
+        fclose(file);
+
+        MeshData mesh;
+        auto start = std::chrono::steady_clock::now();
+        bool loaded = Meshes::loadPLY(path, mesh);
+        double seconds = secondsSince(start);
+        remove(path);
+        bool matches = loaded && mesh.vertices.size() == rows * 256 && mesh.indices == expected;
+        printf("%u %s faces loaded in %.3f s: %zu indices, %s\n", faceCount, corners == 4 ? "quad" : "triangle",
+               seconds, mesh.indices.size(), matches ? "as written" : "wrong");
+        if (!matches) ++failures;
+    }
+    printf("%s\n", failures ? "plytest failed" : "plytest passed");
+    return failures ? 1 : 0;
+}
+
+static int gltf(int argc, char **argv) {
+    if (argc < 3) {printUsage(); return 1;}
+    unsigned int iterations = argc > 3 ? std::max(atoi(argv[3]), 1) : 5;
+
+    HiddenContext context;
+    if (!context.create()) return 1;
+
+    // glFinish makes the times include the uploads, the first run also the page faults of the mapping
+    double first = 0, best = 1e30, total = 0;
+    size_t primitives = 0, triangles = 0, images = 0, loadedImages = 0, meshes = 0, nodes = 0;
+    for (unsigned int i = 0; i < iterations; ++i) {
+        GltfScene scene;
+        auto start = std::chrono::steady_clock::now();
+        if (!Gltf::load(argv[2], scene)) return 1;
+        glFinish();
+        double seconds = secondsSince(start);
+        if (i == 0) first = seconds;
+        best = std::min(best, seconds);
+        total += seconds;
+
+        primitives = triangles = 0;
+        for (const GltfMesh &mesh : scene.meshes) {
+            primitives += mesh.primitives.size();
+            for (const GltfPrimitive &primitive : mesh.primitives)
+                if (primitive.mode == GL_TRIANGLES) triangles += size_t(primitive.count) / 3;
+        }
+        images = scene.images.size();
+        loadedImages = size_t(std::count_if(scene.images.begin(), scene.images.end(), [](GLuint image) {
+            return image != 0;
+        }));
+        meshes = scene.meshes.size();
+        nodes = scene.nodes.size();
+        Gltf::destroy(scene);
+    }
+
+    GLenum error = glGetError();
+    printf("%s: %zu meshes (%zu primitives, %zu triangles), %zu nodes, %zu of %zu images\n", argv[2], meshes,
+           primitives, triangles, nodes, loadedImages, images);
+    printf("  load: first %.2f ms, best %.2f ms, mean %.2f ms over %u iterations on %u threads\n", first * 1e3,
+           best * 1e3, total * 1e3 / iterations, iterations, JobSystem::threadCount());
+    if (error != GL_NO_ERROR) {printf("  GL error 0x%x\n", error); return 1;}
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {printUsage(); return 1;}
+    if (strcmp(argv[1], "bench") == 0) return bench(argc, argv);
+    if (strcmp(argv[1], "cook") == 0) return cook(argc, argv);
+    if (strcmp(argv[1], "simplify") == 0) return simplify(argc, argv);
+    if (strcmp(argv[1], "lodtest") == 0) return lodtest(argc, argv);
+    if (strcmp(argv[1], "meshlets") == 0) return meshlets(argc, argv);
+    if (strcmp(argv[1], "occlusion") == 0) return occlusion(argc, argv);
+    if (strcmp(argv[1], "objtest") == 0) return objtest(argc, argv);
+    if (strcmp(argv[1], "plytest") == 0) return plytest(argc, argv);
+    if (strcmp(argv[1], "gltf") == 0) return gltf(argc, argv);
+    printUsage();
+    return 1;
+}
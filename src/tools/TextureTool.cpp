@@ -0,0 +1,455 @@
+//
+// Created by jonas on 19.10.26.
+//
+// Import time texture processing: converts .BMP sources into block compressed .DDS files
+//
+//   TextureTool compress <input.bmp> <output.dds> [bc1|bc3|bc7]
+//   TextureTool decode <input.dds> [iterations]     verifies the S3TC software decoder and reports its throughput
+//   TextureTool atlas <output.dds> <size> <input.bmp>...  packs the inputs into one BC3 atlas, regions go to <output>.atlas
+//       (MeshTool cook --atlas moves the uvs of a mesh into its region)
+//   TextureTool ktx2 <input.dds> <output.ktx2>      writes the levels as .ktx2 and verifies them through KTX2Stream
+//   TextureTool array <instances> <input>...         draws the inputs from a TextureArrayPool in one batch per array
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "common/HiddenContext.hpp"
+#include "common/KTX2Stream.hpp"
+#include "common/TextureArrayPool.hpp"
+#include "common/TextureAtlas.hpp"
+#include "common/TextureCompressor.hpp"
+#include "common/TextureDecoder.hpp"
+#include "common/Textures.hpp"
+#include "common/shader.hpp"
+
+static void printUsage() {
+    printf("Usage: TextureTool compress <input.bmp> <output.dds> [bc1|bc3|bc7]\n");
+    printf("       TextureTool decode <input.dds> [iterations]\n");
+    printf("       TextureTool atlas <output.dds> <size> <input.bmp>...\n");
+    printf("       TextureTool ktx2 <input.dds> <output.ktx2>\n");
+    printf("       TextureTool array <instances> <input.bmp|input.dds>...\n");
+}
+
+static int compress(int argc, char **argv) {
+    if (argc < 4) {printUsage(); return 1;}
+
+    TextureCompressor::Format format = TextureCompressor::Format::BC1;
+    if (argc > 4) {
+        if (strcmp(argv[4], "bc1") == 0) format = TextureCompressor::Format::BC1;
+        else if (strcmp(argv[4], "bc3") == 0) format = TextureCompressor::Format::BC3;
+        else if (strcmp(argv[4], "bc7") == 0) format = TextureCompressor::Format::BC7;
+        else {printUsage(); return 1;}
+    }
+
+    Image image;
+    if (!Textures::decodeBMP(argv[2], image)) return 1;
+
+    TextureCompressor::Stats stats;
+    if (!TextureCompressor::writeDDS(image, argv[3], format, &stats)) return 1;
+
+    size_t sourceSize = image.pixels.size();
+    printf("%s: %ux%u -> %s\n", argv[2], image.width, image.height, argv[3]);
+    printf("  blocks: %u (incl. mipmaps) in %.3f s, %.0f blocks/s\n", stats.blocks, stats.seconds,
+           stats.blocksPerSecond);
+    printf("  PSNR: %.2f dB, top level %zu -> %zu bytes\n", stats.psnr, sourceSize,
+           size_t((image.width + 3) / 4) * ((image.height + 3) / 4) * TextureCompressor::blockSize(format));
+    return 0;
+}
+
+static int decode(int argc, char **argv) {
+    if (argc < 3) {printUsage(); return 1;}
+    unsigned int iterations = argc > 3 ? std::max(atoi(argv[3]), 1) : 20;
+
+    CompressedImage image;
+    if (!Textures::decodeDDS(argv[2], image)) return 1;
+    if (!TextureDecoder::isS3TC(image.format)) {printf("%s is not DXT1/3/5 compressed\n", argv[2]); return 1;}
+
+    // every level has to match the reference decoder bit for bit
+    size_t offset = 0;
+    for (unsigned int level = 0; level < image.mipMapCount; ++level) {
+        unsigned int width = std::max(image.width >> level, 1u), height = std::max(image.height >> level, 1u);
+        std::vector<unsigned char> fast(size_t(width) * height * 4), reference(fast.size());
+        TextureDecoder::decode(image.format, image.data.data() + offset, width, height, fast.data());
+        TextureDecoder::decodeReference(image.format, image.data.data() + offset, width, height, reference.data());
+        if (fast != reference) {
+            printf("Mismatch against the reference decoder in level %u (%ux%u)\n", level, width, height);
+            return 1;
+        }
+        offset += image.levelSize(level);
+    }
+    printf("%s: %u levels match the reference decoder\n", argv[2], image.mipMapCount);
+
+    // throughput of the top level
+    std::vector<unsigned char> rgba(size_t(image.width) * image.height * 4);
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < iterations; ++i)
+        TextureDecoder::decode(image.format, image.data.data(), image.width, image.height, rgba.data());
+    double fastSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < iterations; ++i)
+        TextureDecoder::decodeReference(image.format, image.data.data(), image.width, image.height, rgba.data());
+    double referenceSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    double megaPixels = double(image.width) * image.height * iterations / 1e6;
+    printf("  decode: %.1f MPixel/s (reference %.1f MPixel/s) over %u iterations of %ux%u\n",
+           megaPixels / fastSeconds, megaPixels / referenceSeconds, iterations, image.width, image.height);
+    return 0;
+}
+
+static int atlas(int argc, char **argv) {
+    if (argc < 5) {printUsage(); return 1;}
+    unsigned int size = unsigned(std::max(atoi(argv[3]), 4));
+
+    std::string manifestPath = std::string(argv[2]) + ".atlas";
+    FILE *manifest = fopen(manifestPath.c_str(), "w");
+    if (!manifest) {printf("Could not open %s for writing\n", manifestPath.c_str()); return 1;}
+    fprintf(manifest, "# name x y width height u_offset v_offset u_scale v_scale\n");
+
+    // larger images first gives a tighter packing
+    std::vector<std::pair<std::string, Image>> images;
+    for (int i = 4; i < argc; ++i) {
+        Image image;
+        if (!Textures::decodeBMP(argv[i], image)) {fclose(manifest); return 1;}
+        images.emplace_back(argv[i], std::move(image));
+    }
+    std::stable_sort(images.begin(), images.end(), [](const auto &a, const auto &b) {
+        return a.second.height > b.second.height;
+    });
+
+    TextureAtlas textureAtlas(size, size);
+    for (const auto &[name, image] : images) {
+        TextureAtlas::Region region;
+        if (!textureAtlas.add(image, region)) {
+            printf("%s does not fit into the %ux%u atlas\n", name.c_str(), size, size);
+            fclose(manifest);
+            return 1;
+        }
+        fprintf(manifest, "%s %u %u %u %u %f %f %f %f\n", name.c_str(), region.x, region.y, region.width, region.height,
+                region.uvOffset[0], region.uvOffset[1], region.uvScale[0], region.uvScale[1]);
+    }
+    fclose(manifest);
+
+    TextureCompressor::Stats stats;
+    if (!TextureCompressor::writeDDS(textureAtlas.image(), argv[2], TextureCompressor::Format::BC3, &stats)) return 1;
+    printf("%zu images packed into %s (%ux%u, %.1f%% used), PSNR %.2f dB\n", images.size(), argv[2], size, size,
+           textureAtlas.occupancy() * 100.0f, stats.psnr);
+    return 0;
+}
+
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#endif
+
+/** Writes the block levels of a .DDS file as .ktx2, without data format descriptor and supercompression
+ *
+ *  @param[in] levelCount Levels to store, 0 stores the base level only and leaves the mip chain to the loader
+ */
+static bool writeKTX2(const CompressedImage &image, unsigned int levelCount, const char *filename) {
+    uint32_t vkFormat;
+    switch (image.format) {
+        case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT: vkFormat = 133; break; // BC1_RGBA_UNORM
+        case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT: vkFormat = 135; break; // BC2_UNORM
+        case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: vkFormat = 137; break; // BC3_UNORM
+        case GL_COMPRESSED_RGBA_BPTC_UNORM: vkFormat = 145; break;    // BC7_UNORM
+        default: printf("No KTX2 format for GL format 0x%x\n", image.format); return false;
+    }
+    unsigned int storedLevels = std::max(levelCount, 1u);
+    std::vector<size_t> levelOffsets(storedLevels, 0);
+    for (unsigned int level = 1; level < storedLevels; ++level)
+        levelOffsets[level] = levelOffsets[level - 1] + image.levelSize(level - 1);
+
+    constexpr unsigned char identifier[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+    const uint32_t header[9] = {vkFormat, 1, image.width, image.height, 0, 0, 1, levelCount, 0};
+    const uint32_t index[4] = {}; // no data format descriptor or key/value data, KTX2Stream reads neither
+    const uint64_t globalData[2] = {};
+
+    // the smallest level comes first in the file, every level starts 16 byte aligned
+    size_t dataPosition = 80 + size_t(storedLevels) * 24;
+    std::vector<uint64_t> levelIndex(size_t(storedLevels) * 3);
+    std::vector<unsigned char> data;
+    for (unsigned int level = storedLevels; level-- > 0;) {
+        size_t position = (dataPosition + data.size() + 15) & ~size_t(15);
+        data.resize(position - dataPosition);
+        size_t size = image.levelSize(level);
+        levelIndex[level * 3 + 0] = position;
+        levelIndex[level * 3 + 1] = size;
+        levelIndex[level * 3 + 2] = size;
+        const unsigned char *levelData = image.data.data() + levelOffsets[level];
+        data.insert(data.end(), levelData, levelData + size);
+    }
+
+    FILE *file = fopen(filename, "wb");
+    if (!file) {printf("Could not open %s for writing\n", filename); return false;}
+    fwrite(identifier, 1, sizeof(identifier), file);
+    fwrite(header, sizeof(uint32_t), 9, file);
+    fwrite(index, sizeof(uint32_t), 4, file);
+    fwrite(globalData, sizeof(uint64_t), 2, file);
+    fwrite(levelIndex.data(), sizeof(uint64_t), levelIndex.size(), file);
+    bool written = fwrite(data.data(), 1, data.size(), file) == data.size();
+    fclose(file);
+    return written;
+}
+
+/** Streams a .ktx2 file written by writeKTX2 and compares what OpenGL holds against the .DDS levels
+ *
+ *  @returns Number of problems found, 0 if the texture is complete and every level matches
+ */
+static unsigned int verifyKTX2(const CompressedImage &image, unsigned int levelCount, const char *filename) {
+    KTX2Stream stream;
+    if (!stream.open(filename)) return 1;
+    while (!stream.finished()) stream.upload(0, true);
+
+    unsigned int problems = 0;
+    GLint baseLevel, maxLevel, compressed;
+    glBindTexture(GL_TEXTURE_2D, stream.texture());
+    glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, &baseLevel);
+    glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, &maxLevel);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED, &compressed);
+
+    // every level from base to max has to be defined, otherwise the texture is incomplete and samples black
+    unsigned int chainLength = 1;
+    while ((std::max(image.width, image.height) >> chainLength) != 0) ++chainLength;
+    GLint lastLevel = std::min(maxLevel, GLint(chainLength) - 1);
+    if (baseLevel != 0) {printf("  base level is %d after the upload\n", baseLevel); ++problems;}
+    for (GLint level = baseLevel; level <= lastLevel; ++level) {
+        GLint levelWidth;
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_WIDTH, &levelWidth);
+        if (levelWidth == 0) {printf("  level %d is missing, the texture is incomplete\n", level); ++problems;}
+    }
+    if (compressed && levelCount == 0 && maxLevel != 0) {
+        printf("  max level %d on a block compressed texture without mip chain\n", maxLevel);
+        ++problems;
+    }
+
+    // the stored levels come back bit for bit, or decoded to RGBA8 where the driver lacks S3TC
+    size_t offset = 0;
+    for (unsigned int level = 0; level < std::max(levelCount, 1u); ++level) {
+        unsigned int width = std::max(image.width >> level, 1u), height = std::max(image.height >> level, 1u);
+        std::vector<unsigned char> expected, actual;
+        if (compressed) {
+            GLint size;
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+            expected.assign(image.data.data() + offset, image.data.data() + offset + image.levelSize(level));
+            actual.resize(size_t(std::max(size, 0)));
+            glGetCompressedTexImage(GL_TEXTURE_2D, level, actual.data());
+        } else {
+            expected.resize(size_t(width) * height * 4);
+            actual.resize(expected.size());
+            TextureDecoder::decode(image.format, image.data.data() + offset, width, height, expected.data());
+            glPixelStorei(GL_PACK_ALIGNMENT, 1);
+            glGetTexImage(GL_TEXTURE_2D, level, GL_RGBA, GL_UNSIGNED_BYTE, actual.data());
+        }
+        if (expected != actual) {
+            printf("  level %u (%ux%u) differs from the source\n", level, width, height);
+            ++problems;
+        }
+        offset += image.levelSize(level);
+    }
+
+    if (GLenum error = glGetError(); error != GL_NO_ERROR) {printf("  GL error 0x%x\n", error); ++problems;}
+    GLuint texture = stream.texture();
+    glDeleteTextures(1, &texture);
+    return problems;
+}
+
+static int ktx2(int argc, char **argv) {
+    if (argc < 4) {printUsage(); return 1;}
+
+    CompressedImage image;
+    if (!Textures::decodeDDS(argv[2], image)) return 1;
+    if (!writeKTX2(image, image.mipMapCount, argv[3])) return 1;
+
+    HiddenContext context;
+    if (!context.create()) return 1;
+
+    // the full chain as written, then the base level alone which the loader has to keep complete on its own
+    std::string basePath = std::string(argv[3]) + ".base";
+    unsigned int problems = verifyKTX2(image, image.mipMapCount, argv[3]);
+    printf("%s: %u levels, %u problems\n", argv[3], image.mipMapCount, problems);
+    unsigned int baseProblems = 1;
+    if (writeKTX2(image, 0, basePath.c_str())) {
+        baseProblems = verifyKTX2(image, 0, basePath.c_str());
+        printf("%s: base level only, %u problems\n", basePath.c_str(), baseProblems);
+        remove(basePath.c_str());
+    }
+
+    bool passed = problems == 0 && baseProblems == 0;
+    printf("KTX2 round trip %s\n", passed ? "passed" : "failed");
+    return passed ? 0 : 1;
+}
+
+/** Per instance attributes of TextureArrayShader.vert */
+struct ArrayInstance {
+    float layer;
+    float model[16];
+};
+
+/** Binds the instance attributes (locations 2 to 6) starting at the given instance, GL 3.3 has no base instance */
+static void bindInstances(GLuint buffer, size_t first) {
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    const size_t base = first * sizeof(ArrayInstance);
+    glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(ArrayInstance), reinterpret_cast<void *>(base));
+    for (unsigned int column = 0; column < 4; ++column) {
+        size_t offset = base + offsetof(ArrayInstance, model) + column * 4 * sizeof(float);
+        glVertexAttribPointer(3 + column, 4, GL_FLOAT, GL_FALSE, sizeof(ArrayInstance),
+                              reinterpret_cast<void *>(offset));
+    }
+}
+
+static int textureArray(int argc, char **argv) {
+    if (argc < 4) {printUsage(); return 1;}
+    unsigned int instanceCount = unsigned(std::max(atoi(argv[2]), 1));
+
+    HiddenContext context;
+    if (!context.create()) return 1;
+    GLuint program = LoadShaders("src/shaders/TextureArrayShader.vert", "src/shaders/TextureArrayShader.frag");
+    if (!program) return 1;
+
+    TextureArrayPool pool;
+    std::vector<TextureArrayPool::Entry> entries;
+    for (int i = 3; i < argc; ++i) {
+        TextureArrayPool::Entry entry = pool.load(argv[i]);
+        if (!entry.texture) return 1;
+        entries.push_back(entry);
+    }
+    pool.generateMipmaps();
+
+    // the instances cycle through the inputs on a grid of tiles, sorted by array so every array is one batch
+    unsigned int grid = unsigned(std::ceil(std::sqrt(double(instanceCount))));
+    float tile = 2.0f / float(grid);
+    std::vector<unsigned int> order(instanceCount);
+    for (unsigned int i = 0; i < instanceCount; ++i) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) {
+        return entries[a % entries.size()].texture < entries[b % entries.size()].texture;
+    });
+    std::vector<ArrayInstance> instances(instanceCount);
+    for (unsigned int i = 0; i < instanceCount; ++i) {
+        unsigned int instance = order[i];
+        ArrayInstance &data = instances[i];
+        data.layer = float(entries[instance % entries.size()].layer);
+        const float model[16] = {tile * 0.45f, 0, 0, 0, 0, tile * 0.45f, 0, 0, 0, 0, 1, 0,
+                                 -1.0f + tile * (float(instance % grid) + 0.5f),
+                                 -1.0f + tile * (float(instance / grid) + 0.5f), 0, 1};
+        memcpy(data.model, model, sizeof(model));
+    }
+
+    // unit quad with the whole texture, two triangles
+    const float quad[] = {-1, -1, 0, 0, 0,  1, -1, 0, 1, 0,  1, 1, 0, 1, 1,
+                          -1, -1, 0, 0, 0,  1, 1, 0, 1, 1,  -1, 1, 0, 0, 1};
+    GLuint vertexArray, buffers[2];
+    glGenVertexArrays(1, &vertexArray);
+    glBindVertexArray(vertexArray);
+    glGenBuffers(2, buffers);
+    glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), nullptr);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), reinterpret_cast<void *>(3 * sizeof(float)));
+    glBindBuffer(GL_ARRAY_BUFFER, buffers[1]);
+    glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(instances.size() * sizeof(ArrayInstance)), instances.data(),
+                 GL_STATIC_DRAW);
+    for (unsigned int location = 2; location <= 6; ++location) {
+        glEnableVertexAttribArray(location);
+        glVertexAttribDivisor(location, 1);
+    }
+
+    constexpr GLsizei SIZE = 512;
+    GLuint target, framebuffer;
+    glGenTextures(1, &target);
+    glBindTexture(GL_TEXTURE_2D, target);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, SIZE, SIZE, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target, 0);
+    glViewport(0, 0, SIZE, SIZE);
+
+    const float identity[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+    glUseProgram(program);
+    glUniformMatrix4fv(glGetUniformLocation(program, "VP"), 1, GL_FALSE, identity);
+    glUniform1i(glGetUniformLocation(program, "myTextureArraySampler"), 0);
+    glActiveTexture(GL_TEXTURE0);
+
+    // batched: one instanced draw per array, reference: one draw per instance
+    auto drawBatched = [&]() {
+        unsigned int draws = 0;
+        for (size_t first = 0; first < instances.size();) {
+            GLuint texture = entries[order[first] % entries.size()].texture;
+            size_t last = first;
+            while (last < instances.size() && entries[order[last] % entries.size()].texture == texture) ++last;
+            glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+            bindInstances(buffers[1], first);
+            glDrawArraysInstanced(GL_TRIANGLES, 0, 6, GLsizei(last - first));
+            ++draws;
+            first = last;
+        }
+        return draws;
+    };
+    auto drawSingle = [&]() {
+        for (size_t i = 0; i < instances.size(); ++i) {
+            glBindTexture(GL_TEXTURE_2D_ARRAY, entries[order[i] % entries.size()].texture);
+            bindInstances(buffers[1], i);
+            glDrawArraysInstanced(GL_TRIANGLES, 0, 6, 1);
+        }
+        return unsigned(instances.size());
+    };
+    auto render = [&](auto draw, std::vector<unsigned char> &pixels, unsigned int &draws, double &seconds) {
+        constexpr int ITERATIONS = 20;
+        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+        glFinish();
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < ITERATIONS; ++i) {
+            glClear(GL_COLOR_BUFFER_BIT);
+            draws = draw();
+        }
+        glFinish();
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / ITERATIONS;
+        pixels.resize(size_t(SIZE) * SIZE * 4);
+        glReadPixels(0, 0, SIZE, SIZE, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    };
+
+    std::vector<unsigned char> batched, single;
+    unsigned int batchedDraws, singleDraws;
+    double batchedSeconds, singleSeconds;
+    render(drawBatched, batched, batchedDraws, batchedSeconds);
+    render(drawSingle, single, singleDraws, singleSeconds);
+    GLenum error = glGetError();
+
+    size_t differences = 0;
+    for (size_t i = 0; i < batched.size(); ++i) differences += batched[i] != single[i];
+    printf("%u instances of %zu textures in %u arrays\n", instanceCount, entries.size(), pool.arrayCount());
+    printf("  batched: %u draws, %.3f ms, one draw per instance: %u draws, %.3f ms\n", batchedDraws,
+           batchedSeconds * 1000.0, singleDraws, singleSeconds * 1000.0);
+    if (differences) printf("  %zu bytes of the batched frame differ\n", differences);
+    if (error != GL_NO_ERROR) printf("  GL error 0x%x\n", error);
+
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteTextures(1, &target);
+    glDeleteBuffers(2, buffers);
+    glDeleteVertexArrays(1, &vertexArray);
+    glDeleteProgram(program);
+
+    bool passed = differences == 0 && error == GL_NO_ERROR && batchedDraws == pool.arrayCount();
+    printf("Texture array batch test %s\n", passed ? "passed" : "failed");
+    return passed ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {printUsage(); return 1;}
+    if (strcmp(argv[1], "compress") == 0) return compress(argc, argv);
+    if (strcmp(argv[1], "decode") == 0) return decode(argc, argv);
+    if (strcmp(argv[1], "atlas") == 0) return atlas(argc, argv);
+    if (strcmp(argv[1], "ktx2") == 0) return ktx2(argc, argv);
+    if (strcmp(argv[1], "array") == 0) return textureArray(argc, argv);
+    printUsage();
+    return 1;
+}